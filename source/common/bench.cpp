@@ -0,0 +1,1018 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains microbenchmark harness: cases are calibrated so one
+// sample takes a few milliseconds, then several samples are measured and
+// summarised. Kernels shared by all tools (PNG filters, inflate) are
+// registered here, kernels of tools - by their BenchKernels().
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "thpool.h"		// Goes first: sets up windows.h version
+#ifdef _WIN32
+	#include <psapi.h>
+#else
+	#include <time.h>
+	#include <sys/resource.h>
+#endif
+#include "util.h"
+#include "ps2hl.h"
+#include "fops.h"
+#include "zlib.h"
+#include "ztool.h"
+#include "pngtool.h"
+#include "pngfilt.h"
+#include "checksum.h"
+#include "jobs.h"
+#include "corpus.h"
+#include "bench.h"
+
+////////// Definitions //////////
+#define BENCH_SAMPLES		7			// Samples per case
+#define BENCH_SAMPLE_NS		20000000	// Calibrated time of one sample
+#define BENCH_QUICK_SAMPLES	3			// Same for --quick
+#define BENCH_QUICK_NS		2000000		//
+#define BENCH_MAX_ITERS		(1 << 24)	// Calibration limit
+#define BENCH_MAX_SAMPLES	64			// --runs limit
+#define BENCH_MAX_PATTERNS	32			// Kernel patterns in command line
+#define BENCH_NAME_LEN		32			// Kernel and case name length
+
+////////// Structures //////////
+
+// Result of one case
+struct sBenchResult
+{
+	char Kernel[BENCH_NAME_LEN];
+	char Case[BENCH_NAME_LEN];
+	ulong Iters;				// Runs per sample
+	double Mean;				// ns per run
+	double Dev;					// Standard deviation of samples, ns per run
+	double Best;				//
+	ulong Pixels;				// Work of one run
+	ulong Bytes;				//
+};
+
+// Benchmark session
+struct sBench
+{
+	int Samples;
+	tBenchTime SampleTime;		// Calibration target, ns
+	bool Quick;
+	const char * Patterns[BENCH_MAX_PATTERNS];	// Selected kernels (none - all)
+	int PatternCount;
+	sBenchResult * Results;
+	int Count;
+	int Size;					// Allocated
+	sBenchResult * Base;		// Results of --compare file
+	int BaseCount;
+	int Errors;					// Kernels that gave wrong results
+};
+
+// PNG filter kernels: Data is restored from Source before each run
+struct sBenchPNG
+{
+	sPNGData Data;
+	uchar * Source;
+	ulong SourceSize;
+	uint Width;
+	uint Height;
+	uint BytesPerPixel;
+};
+
+// PNG row kernels: rows of Plain are filtered, rows of Source - unfiltered to Out
+struct sBenchRow
+{
+	uchar * Source;				// Filtered rows (without filter bytes)
+	uchar * Plain;				// Unfiltered rows
+	uchar * Out;				// Row with filter byte
+	uint Stride;
+	uint Height;
+	uint BytesPerPixel;
+	uchar FilterType;
+};
+
+// Unpacking kernels: Count samples (pixels for RGB) of Source go to Out
+struct sBenchUnpack
+{
+	uchar * Source;
+	uchar * Out;
+	ulong Count;
+	uint BitDepth;				// 1, 2, 4 (24 - RGB)
+};
+
+// Deflate and inflate kernels (checksum kernels use Data only)
+struct sBenchZ
+{
+	uchar * Data;
+	uchar * CData;
+	ulong DataSize;
+	ulong CDataSize;
+};
+
+////////// Globals //////////
+const ushort BenchDims[BENCH_DIM_COUNT] = { 8, 32, 128, 512 };
+static const ulong BenchZSizes[] = { 0x400, 0x10000, 0x100000, 0x4000000 };		// 1K - 64M
+#define BENCH_ZSIZE_COUNT (int)(sizeof(BenchZSizes) / sizeof(BenchZSizes[0]))
+static const ulong BenchSumSizes[] = { 0x40, 0x400, 0x10000, 0x1000000 };		// Chunk of small PNG - big PAK
+#define BENCH_SUMSIZE_COUNT (int)(sizeof(BenchSumSizes) / sizeof(BenchSumSizes[0]))
+volatile int BenchSink;
+
+////////// Timing //////////
+#ifdef _WIN32
+
+tBenchTime BenchNow()
+{
+	LARGE_INTEGER Counter, Freq;
+
+	QueryPerformanceCounter(&Counter);
+	QueryPerformanceFrequency(&Freq);
+
+	// Split to avoid overflow
+	return (tBenchTime)(Counter.QuadPart / Freq.QuadPart) * 1000000000ULL +
+		(tBenchTime)(Counter.QuadPart % Freq.QuadPart) * 1000000000ULL / Freq.QuadPart;
+}
+
+tBenchTime BenchCPUTime()
+{
+	FILETIME Create, Exit, Kernel, User;
+
+	if (GetProcessTimes(GetCurrentProcess(), &Create, &Exit, &Kernel, &User) == FALSE)
+		return 0;
+
+	// 100 ns units
+	return ((((tBenchTime)Kernel.dwHighDateTime << 32) | Kernel.dwLowDateTime) +
+		(((tBenchTime)User.dwHighDateTime << 32) | User.dwLowDateTime)) * 100;
+}
+
+ulong BenchPeakRSS(bool Reset)
+{
+	// psapi is loaded at run time, so tools don't need extra libs to link
+	typedef BOOL (WINAPI * tGetMemInfo)(HANDLE, PPROCESS_MEMORY_COUNTERS, DWORD);
+	PROCESS_MEMORY_COUNTERS Info;
+	HMODULE hPsapi;
+	tGetMemInfo GetMemInfo;
+	ulong Result = 0;
+
+	// Peak of working set can't be reset on windows
+	if (Reset == true)
+		return 0;
+
+	hPsapi = LoadLibraryA("psapi.dll");
+	if (hPsapi == NULL)
+		return 0;
+
+	GetMemInfo = (tGetMemInfo)GetProcAddress(hPsapi, "GetProcessMemoryInfo");
+	if (GetMemInfo != NULL && GetMemInfo(GetCurrentProcess(), &Info, sizeof(Info)))
+		Result = Info.PeakWorkingSetSize / 1024;
+
+	FreeLibrary(hPsapi);
+	return Result;
+}
+
+#else // linux
+
+tBenchTime BenchNow()
+{
+	struct timespec Time;
+
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return (tBenchTime)Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
+tBenchTime BenchCPUTime()
+{
+	struct rusage Usage;
+
+	if (getrusage(RUSAGE_SELF, &Usage) != 0)
+		return 0;
+
+	return ((tBenchTime)Usage.ru_utime.tv_sec + Usage.ru_stime.tv_sec) * 1000000000ULL +
+		((tBenchTime)Usage.ru_utime.tv_usec + Usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+ulong BenchPeakRSS(bool Reset)
+{
+	FILE * ptrFile;
+	char Line[128];
+	unsigned long Result = 0;
+
+	// Writing 5 to clear_refs resets VmHWM (linux 4.0+), getrusage() peak can't be reset
+	if (Reset == true)
+	{
+		ptrFile = fopen("/proc/self/clear_refs", "w");
+		if (ptrFile != NULL)
+		{
+			fputs("5", ptrFile);
+			fclose(ptrFile);
+		}
+		return 0;
+	}
+
+	ptrFile = fopen("/proc/self/status", "r");
+	if (ptrFile == NULL)
+		return 0;
+	while (fgets(Line, sizeof(Line), ptrFile) != NULL)
+		if (sscanf(Line, "VmHWM: %lu", &Result) == 1)
+			break;
+	fclose(ptrFile);
+
+	return Result;
+}
+
+#endif
+
+static tBenchTime BenchSample(ulong Iters, tBenchFunc Prepare, tBenchFunc Run, void * Ctx)	// Time of Iters runs, ns
+{
+	tBenchTime Start;
+	tBenchTime Total = 0;
+
+	if (Prepare == NULL)
+	{
+		Start = BenchNow();
+		for (ulong i = 0; i < Iters; i++)
+			Run(Ctx);
+		return BenchNow() - Start;
+	}
+
+	// Setup isn't counted, so every run is timed separately (timer cost is in result)
+	for (ulong i = 0; i < Iters; i++)
+	{
+		Prepare(Ctx);
+		Start = BenchNow();
+		Run(Ctx);
+		Total += BenchNow() - Start;
+	}
+	return Total;
+}
+
+////////// Results //////////
+static const sBenchResult * BenchFindBase(sBench * Bench, const char * Kernel, const char * Case)
+{
+	for (int i = 0; i < Bench->BaseCount; i++)
+		if (!strcmp(Bench->Base[i].Kernel, Kernel) && !strcmp(Bench->Base[i].Case, Case))
+			return &Bench->Base[i];
+
+	return NULL;
+}
+
+static void BenchPrint(sBench * Bench, const sBenchResult * Result)
+{
+	const sBenchResult * Base = BenchFindBase(Bench, Result->Kernel, Result->Case);
+	char PerPixel[16] = "-";
+	char Speed[16] = "-";
+	char Change[16] = "";
+
+	if (Result->Pixels != 0)
+		snprintf(PerPixel, sizeof(PerPixel), "%.3f", Result->Mean / Result->Pixels);
+	if (Result->Bytes != 0 && Result->Mean > 0)
+		snprintf(Speed, sizeof(Speed), "%.1f", Result->Bytes / Result->Mean * 1000.0);
+	if (Base != NULL && Base->Mean > 0)
+		snprintf(Change, sizeof(Change), "%+.1f%%", (Result->Mean - Base->Mean) / Base->Mean * 100.0);
+
+	LibMsg(MSG_INFO, "%-21s %-17s %12.1f %6.1f%% %10s %10s %8s \n", Result->Kernel, Result->Case,
+		Result->Mean, (Result->Mean > 0) ? Result->Dev / Result->Mean * 100.0 : 0.0, PerPixel, Speed, Change);
+}
+
+static sBenchResult * BenchNewResult(sBench * Bench)
+{
+	sBenchResult * NewResults;
+
+	if (Bench->Count == Bench->Size)
+	{
+		NewResults = (sBenchResult *)LibCalloc(Bench->Size ? Bench->Size * 2 : 64, sizeof(sBenchResult));
+		if (NewResults == NULL)
+			return NULL;
+		if (Bench->Results != NULL)
+			memcpy(NewResults, Bench->Results, Bench->Count * sizeof(sBenchResult));
+		LibFree(Bench->Results);
+		Bench->Results = NewResults;
+		Bench->Size = Bench->Size ? Bench->Size * 2 : 64;
+	}
+
+	return &Bench->Results[Bench->Count++];
+}
+
+static int BenchSave(sBench * Bench, const char * FileName)		// One case per line, so --compare can read it back without JSON parser
+{
+	FILE * ptrFile;
+	const sBenchResult * Result;
+
+	if (FileOpen(&ptrFile, FileName, "w") == false)
+		return PS2HL_ERR_OPEN;
+
+	fprintf(ptrFile, "{\n\t\"samples\": %d,\n\t\"bench\": [\n", Bench->Samples);
+	for (int i = 0; i < Bench->Count; i++)
+	{
+		Result = &Bench->Results[i];
+		fprintf(ptrFile, "\t\t{ \"kernel\": \"%s\", \"case\": \"%s\", \"mean_ns\": %.1f, \"stddev_ns\": %.1f, \"best_ns\": %.1f, \"iters\": %lu, \"ns_per_pixel\": %.4f, \"mb_per_s\": %.2f }%s\n",
+			Result->Kernel, Result->Case, Result->Mean, Result->Dev, Result->Best, (unsigned long)Result->Iters,
+			Result->Pixels ? Result->Mean / Result->Pixels : 0.0,
+			(Result->Bytes && Result->Mean > 0) ? Result->Bytes / Result->Mean * 1000.0 : 0.0,
+			(i + 1 < Bench->Count) ? "," : "");
+	}
+	fprintf(ptrFile, "\t]\n}\n");
+	fclose(ptrFile);
+
+	LibMsg(MSG_INFO, "Results saved to %s \n", FileName);
+	return PS2HL_OK;
+}
+
+static int BenchLoad(sBench * Bench, const char * FileName)
+{
+	FILE * ptrFile;
+	char Line[512];
+	const char * Pos;
+	sBenchResult Result;
+
+	if (FileOpen(&ptrFile, FileName, "r") == false)
+		return PS2HL_ERR_OPEN;
+
+	// Results are put to main list for a moment and moved to Base at the end
+	while (fgets(Line, sizeof(Line), ptrFile) != NULL)
+	{
+		Pos = strstr(Line, "{ \"kernel\"");
+		memset(&Result, 0x00, sizeof(Result));
+		if (Pos == NULL || sscanf(Pos, "{ \"kernel\": \"%31[^\"]\", \"case\": \"%31[^\"]\", \"mean_ns\": %lf",
+			Result.Kernel, Result.Case, &Result.Mean) != 3)
+			continue;
+
+		sBenchResult * New = BenchNewResult(Bench);
+		if (New == NULL)
+		{
+			fclose(ptrFile);
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			return PS2HL_ERR_MEMORY;
+		}
+		*New = Result;
+	}
+	fclose(ptrFile);
+
+	if (Bench->Count == 0)
+	{
+		LibMsg(MSG_ERROR, "No results in %s \n", FileName);
+		return PS2HL_ERR_FORMAT;
+	}
+
+	Bench->Base = Bench->Results;
+	Bench->BaseCount = Bench->Count;
+	Bench->Results = NULL;
+	Bench->Count = 0;
+	Bench->Size = 0;
+	return PS2HL_OK;
+}
+
+////////// Harness //////////
+bool BenchWants(sBench * Bench, const char * Kernel)
+{
+	size_t Len = strlen(Kernel);
+
+	if (Bench->PatternCount == 0)
+		return true;
+
+	// Pattern is prefix of kernel name: "mdl." - all kernels of mdl, "PNG" - PNGFilter and PNGUnfilter
+	// (Kernel ending with '.' is a group: it's wanted if any of its kernels may be)
+	for (int i = 0; i < Bench->PatternCount; i++)
+	{
+		if (!strncmp(Kernel, Bench->Patterns[i], strlen(Bench->Patterns[i])))
+			return true;
+		if (Len > 0 && Kernel[Len - 1] == '.' && !strncmp(Kernel, Bench->Patterns[i], Len))
+			return true;
+	}
+
+	return false;
+}
+
+void BenchRun(sBench * Bench, const char * Kernel, const char * Case, ulong Pixels, ulong Bytes, tBenchFunc Prepare, tBenchFunc Run, void * Ctx)
+{
+	sBenchResult * Result;
+	double Times[BENCH_MAX_SAMPLES];
+	double Sum = 0;
+	double SumSq = 0;
+	tBenchTime Time;
+	ulong Iters = 1;
+
+	if (BenchWants(Bench, Kernel) == false)
+		return;
+
+	// Calibrate (first samples also warm up caches and allocator)
+	Time = BenchSample(Iters, Prepare, Run, Ctx);
+	while (Time < Bench->SampleTime && Iters < BENCH_MAX_ITERS)
+	{
+		Iters *= 2;
+		Time = BenchSample(Iters, Prepare, Run, Ctx);
+	}
+
+	for (int i = 0; i < Bench->Samples; i++)
+	{
+		Times[i] = (double)BenchSample(Iters, Prepare, Run, Ctx) / Iters;
+		Sum += Times[i];
+	}
+
+	Result = BenchNewResult(Bench);
+	if (Result == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return;
+	}
+	snprintf(Result->Kernel, sizeof(Result->Kernel), "%s", Kernel);
+	snprintf(Result->Case, sizeof(Result->Case), "%s", Case);
+	Result->Iters = Iters;
+	Result->Mean = Sum / Bench->Samples;
+	Result->Best = Times[0];
+	for (int i = 0; i < Bench->Samples; i++)
+	{
+		SumSq += (Times[i] - Result->Mean) * (Times[i] - Result->Mean);
+		if (Times[i] < Result->Best)
+			Result->Best = Times[i];
+	}
+	Result->Dev = (Bench->Samples > 1) ? sqrt(SumSq / (Bench->Samples - 1)) : 0.0;
+	Result->Pixels = Pixels;
+	Result->Bytes = Bytes;
+
+	BenchPrint(Bench, Result);
+}
+
+void BenchFillImage(uchar * Data, ulong Size, uint Levels, uint Seed)
+{
+	sCorpusSpec Spec;
+
+	// Same generator as synthetic corpus, so timings match what tools see there
+	memset(&Spec, 0x00, sizeof(Spec));
+	Spec.Rng = (Seed != 0) ? Seed : 1;
+	CorpusFill(&Spec, Data, Size, Levels);
+}
+
+////////// Common kernels //////////
+static void BenchPNGPrepare(void * Ctx)
+{
+	sBenchPNG * PNG = (sBenchPNG *)Ctx;
+
+	LibFree(PNG->Data.Data);
+	PNG->Data.Data = (uchar *)LibAlloc(PNG->SourceSize);
+	PNG->Data.DataSize = PNG->SourceSize;
+	if (PNG->Data.Data != NULL)
+		memcpy(PNG->Data.Data, PNG->Source, PNG->SourceSize);
+}
+
+static void BenchPNGFilter(void * Ctx)
+{
+	sBenchPNG * PNG = (sBenchPNG *)Ctx;
+
+	if (PNG->Data.Data != NULL)
+		PNGFilter(&PNG->Data, PNG->Height, PNG->Width, PNG->BytesPerPixel, 4);	// Paeth (PNGWriteBitmap() picks filter per row, see PNGFilterRowBest)
+}
+
+static void BenchPNGUnfilter(void * Ctx)
+{
+	sBenchPNG * PNG = (sBenchPNG *)Ctx;
+
+	if (PNG->Data.Data != NULL)
+		PNGUnfilter(&PNG->Data, PNG->Height, PNG->Width, PNG->BytesPerPixel, 8);
+}
+
+static void BenchPaeth(void * Ctx)
+{
+	sBenchPNG * PNG = (sBenchPNG *)Ctx;
+	uint Stride = PNG->Width * PNG->BytesPerPixel;
+	const uchar * Data = PNG->Source;
+	int Sum = 0;
+
+	// Left, upper and upper left bytes of every byte below first row, as in filters
+	for (ulong i = Stride + PNG->BytesPerPixel; i < PNG->SourceSize; i++)
+		Sum += PaethPredictor(Data[i - PNG->BytesPerPixel], Data[i - Stride], Data[i - Stride - PNG->BytesPerPixel]);
+
+	BenchSink = Sum;
+}
+
+static void BenchRowFilter(void * Ctx)
+{
+	sBenchRow * Row = (sBenchRow *)Ctx;
+
+	for (uint y = 1; y < Row->Height; y++)
+		PNGFilterRow(Row->Out, &Row->Plain[y * Row->Stride], &Row->Plain[(y - 1) * Row->Stride], Row->Stride, Row->BytesPerPixel, Row->FilterType);
+}
+
+static void BenchRowUnfilter(void * Ctx)
+{
+	sBenchRow * Row = (sBenchRow *)Ctx;
+
+	// Out is overwritten by every row, upper rows come from Plain so result stays the same
+	for (uint y = 1; y < Row->Height; y++)
+	{
+		memcpy(Row->Out + 1, &Row->Source[y * Row->Stride], Row->Stride);
+		PNGUnfilterRow(Row->Out + 1, &Row->Plain[(y - 1) * Row->Stride], Row->Stride, Row->BytesPerPixel, Row->FilterType);
+	}
+}
+
+static void BenchRowBest(void * Ctx)
+{
+	sBenchRow * Row = (sBenchRow *)Ctx;
+	int Sum = 0;
+
+	for (uint y = 1; y < Row->Height; y++)
+		Sum += PNGFilterRowBest(Row->Out, Row->Source, &Row->Plain[y * Row->Stride], &Row->Plain[(y - 1) * Row->Stride], Row->Stride, Row->BytesPerPixel)[0];
+
+	BenchSink = Sum;
+}
+
+static void BenchUnpack(void * Ctx)
+{
+	sBenchUnpack * Unpack = (sBenchUnpack *)Ctx;
+
+	if (Unpack->BitDepth == 24)
+		PNGExpandRGB(Unpack->Out, Unpack->Source, Unpack->Count);
+	else
+		PNGUnpackRow(Unpack->Out, Unpack->Source, Unpack->Count, Unpack->BitDepth);
+}
+
+static void BenchZCompress(void * Ctx)
+{
+	sBenchZ * Z = (sBenchZ *)Ctx;
+	uchar * CData;
+	ulong CDataSize;
+
+	if (ZCompress(Z->Data, Z->DataSize, &CData, &CDataSize) == PS2HL_OK)
+		LibFree(CData);
+}
+
+static void BenchZDecompress(void * Ctx)
+{
+	sBenchZ * Z = (sBenchZ *)Ctx;
+	uchar * Data;
+	ulong DataSize;
+
+	// Start size is a guess, as in PAK reading
+	if (ZDecompress(Z->CData, Z->CDataSize, &Data, &DataSize, Z->CDataSize * 2) == PS2HL_OK)
+		LibFree(Data);
+}
+
+static void BenchCRC32(void * Ctx)
+{
+	sBenchZ * Z = (sBenchZ *)Ctx;
+
+	BenchSink = (int)ChecksumCRC32(CHECKSUM_CRC32_INIT, Z->Data, Z->DataSize);
+}
+
+static void BenchAdler32(void * Ctx)
+{
+	sBenchZ * Z = (sBenchZ *)Ctx;
+
+	BenchSink = (int)ChecksumAdler32(CHECKSUM_ADLER32_INIT, Z->Data, Z->DataSize);
+}
+
+static void BenchPNGKernels(sBench * Bench)
+{
+	static const uint Formats[] = { 4, 1 };
+	sBenchPNG PNG;
+	uchar * Filtered;
+	char Case[BENCH_NAME_LEN];
+	ulong Pixels;
+
+	if (BenchWants(Bench, "PNGFilter") == false && BenchWants(Bench, "PNGUnfilter") == false && BenchWants(Bench, "PaethPredictor") == false)
+		return;
+
+	for (int f = 0; f < 2; f++)
+		for (int d = 0; d < BENCH_DIM_COUNT; d++)
+		{
+			memset(&PNG, 0x00, sizeof(PNG));
+			PNG.Width = BenchDims[d];
+			PNG.Height = BenchDims[d];
+			PNG.BytesPerPixel = Formats[f];
+			PNG.SourceSize = PNG.Width * PNG.Height * PNG.BytesPerPixel;
+			PNG.Source = (uchar *)LibAlloc(PNG.SourceSize);
+			if (PNG.Source == NULL)
+			{
+				LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+				return;
+			}
+			BenchFillImage(PNG.Source, PNG.SourceSize, 256, d + 1);
+
+			Pixels = PNG.Width * PNG.Height;
+			snprintf(Case, sizeof(Case), "%ux%u %s", PNG.Width, PNG.Height, (PNG.BytesPerPixel == 4) ? "rgba" : "indexed");
+			BenchRun(Bench, "PNGFilter", Case, Pixels, PNG.SourceSize, BenchPNGPrepare, BenchPNGFilter, &PNG);
+			BenchRun(Bench, "PaethPredictor", Case, Pixels - PNG.Width - 1, PNG.SourceSize, NULL, BenchPaeth, &PNG);
+
+			// Unfilter gets what filter made
+			BenchPNGPrepare(&PNG);
+			BenchPNGFilter(&PNG);
+			Filtered = PNG.Data.Data;
+			PNG.Data.Data = NULL;
+			if (Filtered != NULL)
+			{
+				LibFree(PNG.Source);
+				PNG.Source = Filtered;
+				PNG.SourceSize = PNG.Width * PNG.Height * PNG.BytesPerPixel + PNG.Height;
+				BenchRun(Bench, "PNGUnfilter", Case, Pixels, PNG.Width * PNG.Height * PNG.BytesPerPixel, BenchPNGPrepare, BenchPNGUnfilter, &PNG);
+			}
+
+			LibFree(PNG.Data.Data);
+			LibFree(PNG.Source);
+		}
+}
+
+static bool BenchRowCheck(sBenchRow * Row, uchar * Expected)	// Compare current SIMD level with scalar code on all rows
+{
+	for (uint y = 1; y < Row->Height; y++)
+	{
+		const uchar * Current = &Row->Plain[y * Row->Stride];
+		const uchar * Upper = &Row->Plain[(y - 1) * Row->Stride];
+
+		PNGFilterRowScalar(Expected, Current, Upper, Row->Stride, Row->BytesPerPixel, Row->FilterType);
+		PNGFilterRow(Row->Out, Current, Upper, Row->Stride, Row->BytesPerPixel, Row->FilterType);
+		if (memcmp(Expected, Row->Out, Row->Stride + 1))
+			return false;
+
+		if (PNGUnfilterRow(Row->Out + 1, Upper, Row->Stride, Row->BytesPerPixel, Row->FilterType) == false ||
+			memcmp(Row->Out + 1, Current, Row->Stride))
+			return false;
+	}
+
+	return true;
+}
+
+static void BenchPNGRowKernels(sBench * Bench)
+{
+	static const uint Formats[] = { 4, 1 };
+	static const char * Filters[] = { "none", "sub", "up", "avg", "paeth" };
+	sBenchRow Row;
+	uchar * Expected;
+	char Kernel[BENCH_NAME_LEN];
+	char Case[BENCH_NAME_LEN];
+	int Saved;
+	ulong Pixels;
+
+	if (BenchWants(Bench, "PNGFilterRow.") == false && BenchWants(Bench, "PNGUnfilterRow.") == false && BenchWants(Bench, "PNGFilterBest.") == false)
+		return;
+
+	Saved = PNGGetSIMDLevel();
+	for (int f = 0; f < 2; f++)
+	{
+		// 512x512 image, every filter on every SIMD level CPU has
+		memset(&Row, 0x00, sizeof(Row));
+		Row.BytesPerPixel = Formats[f];
+		Row.Stride = 512 * Row.BytesPerPixel;
+		Row.Height = 512;
+		Row.Plain = (uchar *)LibAlloc(Row.Stride * Row.Height);
+		Row.Source = (uchar *)LibAlloc(Row.Stride * Row.Height);
+		Row.Out = (uchar *)LibAlloc(Row.Stride + 1);
+		Expected = (uchar *)LibAlloc(Row.Stride + 1);
+		if (Row.Plain == NULL || Row.Source == NULL || Row.Out == NULL || Expected == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			LibFree(Row.Plain);
+			LibFree(Row.Source);
+			LibFree(Row.Out);
+			LibFree(Expected);
+			break;
+		}
+		BenchFillImage(Row.Plain, Row.Stride * Row.Height, 256, f + 1);
+		Pixels = (Row.Height - 1) * (Row.Stride / Row.BytesPerPixel);
+
+		for (int t = 1; t < 5; t++)
+		{
+			Row.FilterType = t;
+
+			// Unfilter input - rows filtered by scalar code
+			for (uint y = 1; y < Row.Height; y++)
+			{
+				PNGFilterRowScalar(Row.Out, &Row.Plain[y * Row.Stride], &Row.Plain[(y - 1) * Row.Stride], Row.Stride, Row.BytesPerPixel, Row.FilterType);
+				memcpy(&Row.Source[y * Row.Stride], Row.Out + 1, Row.Stride);
+			}
+
+			for (int l = PNG_SIMD_SCALAR; l <= PNGGetSIMDSupport(); l++)
+			{
+				PNGSetSIMDLevel(l);
+				snprintf(Case, sizeof(Case), "%s %s", Filters[t], (Row.BytesPerPixel == 4) ? "rgba" : "indexed");
+				if (BenchRowCheck(&Row, Expected) == false)
+				{
+					LibMsg(MSG_ERROR, "PNG row kernels (%s, %s) differ from scalar code \n", PNGSIMDName(l), Case);
+					Bench->Errors++;
+					continue;
+				}
+
+				snprintf(Kernel, sizeof(Kernel), "PNGFilterRow.%s", PNGSIMDName(l));
+				BenchRun(Bench, Kernel, Case, Pixels, Row.Stride * (Row.Height - 1), NULL, BenchRowFilter, &Row);
+				snprintf(Kernel, sizeof(Kernel), "PNGUnfilterRow.%s", PNGSIMDName(l));
+				BenchRun(Bench, Kernel, Case, Pixels, Row.Stride * (Row.Height - 1), NULL, BenchRowUnfilter, &Row);
+			}
+		}
+
+		// Adaptive filtering: five filters and their costs per row (Source is scratch row here)
+		for (int l = PNG_SIMD_SCALAR; l <= PNGGetSIMDSupport(); l++)
+		{
+			PNGSetSIMDLevel(l);
+			snprintf(Case, sizeof(Case), "%s", (Row.BytesPerPixel == 4) ? "rgba" : "indexed");
+			for (uint y = 0; y < Row.Height; y++)
+				if (PNGRowCost(&Row.Plain[y * Row.Stride], Row.Stride - y % 32) != PNGRowCostScalar(&Row.Plain[y * Row.Stride], Row.Stride - y % 32))
+				{
+					LibMsg(MSG_ERROR, "PNGRowCost (%s, %s) differs from scalar code \n", PNGSIMDName(l), Case);
+					Bench->Errors++;
+					break;
+				}
+
+			snprintf(Kernel, sizeof(Kernel), "PNGFilterBest.%s", PNGSIMDName(l));
+			BenchRun(Bench, Kernel, Case, Pixels, Row.Stride * (Row.Height - 1), NULL, BenchRowBest, &Row);
+		}
+
+		LibFree(Row.Plain);
+		LibFree(Row.Source);
+		LibFree(Row.Out);
+		LibFree(Expected);
+	}
+	PNGSetSIMDLevel(Saved);
+}
+
+static bool BenchUnpackCheck(sBenchUnpack * Unpack, uchar * Expected)	// Compare current SIMD level with scalar code on all counts up to 300 and odd offsets
+{
+	ulong Bytes = (Unpack->BitDepth == 24) ? 4 : 1;		// Per output sample
+	ulong Size;
+
+	for (ulong Offset = 0; Offset < 4; Offset++)
+		for (ulong Count = 0; Count <= 300; Count++)
+		{
+			Size = Count * Bytes;
+			memset(Expected, 0xAA, Size + 16);
+			memset(Unpack->Out, 0xAA, Size + 16);
+			if (Unpack->BitDepth == 24)
+			{
+				PNGExpandRGBScalar(Expected, &Unpack->Source[Offset], Count);
+				PNGExpandRGB(Unpack->Out, &Unpack->Source[Offset], Count);
+			}
+			else
+			{
+				PNGUnpackRowScalar(Expected, &Unpack->Source[Offset], Count, Unpack->BitDepth);
+				PNGUnpackRow(Unpack->Out, &Unpack->Source[Offset], Count, Unpack->BitDepth);
+			}
+			if (memcmp(Expected, Unpack->Out, Size + 16))		// Nothing is written past the row either
+				return false;
+		}
+
+	return true;
+}
+
+static void BenchPNGUnpackKernels(sBench * Bench)
+{
+	static const uint Depths[] = { 1, 2, 4, 24 };
+	sBenchUnpack Unpack;
+	uchar * Expected;
+	char Kernel[BENCH_NAME_LEN];
+	char Case[BENCH_NAME_LEN];
+	ulong Pixels = 512 * 512;
+	int Saved;
+
+	if (BenchWants(Bench, "PNGUnpackRow.") == false && BenchWants(Bench, "PNGExpandRGB.") == false)
+		return;
+
+	// 512x512 image: packed source, one byte per sample (4 per pixel for RGB) out
+	Unpack.Source = (uchar *)LibAlloc(Pixels * 3 + 16);
+	Unpack.Out = (uchar *)LibAlloc(Pixels * 4 + 16);
+	Expected = (uchar *)LibAlloc(Pixels * 4 + 16);
+	if (Unpack.Source == NULL || Unpack.Out == NULL || Expected == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		LibFree(Unpack.Source);
+		LibFree(Unpack.Out);
+		LibFree(Expected);
+		return;
+	}
+	BenchFillImage(Unpack.Source, Pixels * 3 + 16, 256, 1);
+
+	Saved = PNGGetSIMDLevel();
+	for (int d = 0; d < 4; d++)
+	{
+		Unpack.BitDepth = Depths[d];
+		Unpack.Count = Pixels;
+		if (Unpack.BitDepth == 24)
+			snprintf(Case, sizeof(Case), "rgb");
+		else
+			snprintf(Case, sizeof(Case), "%u bit", Unpack.BitDepth);
+
+		for (int l = PNG_SIMD_SCALAR; l <= PNGGetSIMDSupport(); l++)
+		{
+			PNGSetSIMDLevel(l);
+			if (BenchUnpackCheck(&Unpack, Expected) == false)
+			{
+				LibMsg(MSG_ERROR, "PNG unpacking (%s, %s) differs from scalar code \n", PNGSIMDName(l), Case);
+				Bench->Errors++;
+				continue;
+			}
+
+			Unpack.Count = Pixels;
+			snprintf(Kernel, sizeof(Kernel), "%s.%s", (Unpack.BitDepth == 24) ? "PNGExpandRGB" : "PNGUnpackRow", PNGSIMDName(l));
+			BenchRun(Bench, Kernel, Case, Pixels, (Unpack.BitDepth == 24) ? Pixels * 4 : Pixels, NULL, BenchUnpack, &Unpack);
+		}
+	}
+	PNGSetSIMDLevel(Saved);
+
+	LibFree(Unpack.Source);
+	LibFree(Unpack.Out);
+	LibFree(Expected);
+}
+
+static void BenchZKernels(sBench * Bench)
+{
+	sBenchZ Z;
+	uchar * Data;
+	char Case[BENCH_NAME_LEN];
+
+	if (BenchWants(Bench, "ZDecompress") == false && BenchWants(Bench, "ZCompress") == false)
+		return;
+
+	for (int i = 0; i < BENCH_ZSIZE_COUNT; i++)
+	{
+		if (Bench->Quick == true && BenchZSizes[i] > 0x100000)
+			break;
+
+		Data = (uchar *)LibAlloc(BenchZSizes[i]);
+		if (Data == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			return;
+		}
+		BenchFillImage(Data, BenchZSizes[i], 64, i + 1);
+		if (ZCompress(Data, BenchZSizes[i], &Z.CData, &Z.CDataSize) == PS2HL_OK)
+		{
+			if (BenchZSizes[i] >= 0x100000)
+				snprintf(Case, sizeof(Case), "%luM", (unsigned long)(BenchZSizes[i] >> 20));
+			else
+				snprintf(Case, sizeof(Case), "%luK", (unsigned long)(BenchZSizes[i] >> 10));
+			BenchRun(Bench, "ZDecompress", Case, 0, BenchZSizes[i], NULL, BenchZDecompress, &Z);
+			if (BenchZSizes[i] <= 0x10000)		// Small files, where stream setup matters
+			{
+				Z.Data = Data;
+				Z.DataSize = BenchZSizes[i];
+				BenchRun(Bench, "ZCompress", Case, 0, BenchZSizes[i], NULL, BenchZCompress, &Z);
+			}
+			LibFree(Z.CData);
+		}
+		LibFree(Data);
+	}
+}
+
+static bool BenchChecksumCheck(const uchar * Data, ulong Size)	// Compare current level with zlib on all lengths up to 512 at all alignments, then whole Data
+{
+	for (ulong Offset = 0; Offset < 32; Offset++)
+		for (ulong Length = 0; Length <= 512 && Offset + Length <= Size; Length++)
+			if (ChecksumCRC32(0x12345678, &Data[Offset], Length) != ChecksumCRC32Scalar(0x12345678, &Data[Offset], Length) ||
+				ChecksumAdler32(0x0BADF00D, &Data[Offset], Length) != ChecksumAdler32Scalar(0x0BADF00D, &Data[Offset], Length))
+				return false;
+
+	return ChecksumCRC32(CHECKSUM_CRC32_INIT, Data, Size) == ChecksumCRC32Scalar(CHECKSUM_CRC32_INIT, Data, Size) &&
+		ChecksumAdler32(CHECKSUM_ADLER32_INIT, Data, Size) == ChecksumAdler32Scalar(CHECKSUM_ADLER32_INIT, Data, Size);
+}
+
+static void BenchChecksumKernels(sBench * Bench)
+{
+	sBenchZ Z;
+	uchar * Data;
+	char Kernel[BENCH_NAME_LEN];
+	char Case[BENCH_NAME_LEN];
+	ulong Size;
+	int Saved;
+
+	if (BenchWants(Bench, "CRC32.") == false && BenchWants(Bench, "Adler32.") == false)
+		return;
+
+	// All bytes set (0xFF) is the worst case for Adler-32 sums, so it is checked too
+	Size = BenchSumSizes[BENCH_SUMSIZE_COUNT - 1];
+	Data = (uchar *)LibAlloc(Size);
+	if (Data == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return;
+	}
+
+	Saved = ChecksumGetLevel();
+	memset(&Z, 0x00, sizeof(Z));
+	Z.Data = Data;
+	for (int l = CHECKSUM_SCALAR; l <= ChecksumGetSupport(); l++)
+	{
+		ChecksumSetLevel(l);
+		memset(Data, 0xFF, Size);
+		if (BenchChecksumCheck(Data, 0x10000) == true)
+		{
+			BenchFillImage(Data, Size, 256, 1);
+			if (BenchChecksumCheck(Data, Size) == true)
+			{
+				for (int i = 0; i < BENCH_SUMSIZE_COUNT; i++)
+				{
+					if (Bench->Quick == true && BenchSumSizes[i] > 0x100000)
+						break;
+
+					if (BenchSumSizes[i] >= 0x100000)
+						snprintf(Case, sizeof(Case), "%luM", (unsigned long)(BenchSumSizes[i] >> 20));
+					else if (BenchSumSizes[i] >= 0x400)
+						snprintf(Case, sizeof(Case), "%luK", (unsigned long)(BenchSumSizes[i] >> 10));
+					else
+						snprintf(Case, sizeof(Case), "%lu", (unsigned long)BenchSumSizes[i]);
+					Z.DataSize = BenchSumSizes[i];
+					snprintf(Kernel, sizeof(Kernel), "CRC32.%s", ChecksumName(l));
+					BenchRun(Bench, Kernel, Case, 0, Z.DataSize, NULL, BenchCRC32, &Z);
+					snprintf(Kernel, sizeof(Kernel), "Adler32.%s", ChecksumName(l));
+					BenchRun(Bench, Kernel, Case, 0, Z.DataSize, NULL, BenchAdler32, &Z);
+				}
+				continue;
+			}
+		}
+
+		LibMsg(MSG_ERROR, "Checksums (%s) differ from zlib \n", ChecksumName(l));
+		Bench->Errors++;
+	}
+	ChecksumSetLevel(Saved);
+	LibFree(Data);
+}
+
+////////// Front-end //////////
+int BenchMain(int ArgCount, char ** Args)
+{
+	sBench * Bench;
+	const sJobTool * Tool;
+	const char * JsonFile = NULL;
+	const char * BaseFile = NULL;
+	int Result = PS2HL_OK;
+
+	Bench = (sBench *)LibCalloc(1, sizeof(sBench));
+	if (Bench == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	Bench->Samples = BENCH_SAMPLES;
+	Bench->SampleTime = BENCH_SAMPLE_NS;
+
+	for (int i = 0; i < ArgCount && Result == PS2HL_OK; i++)
+	{
+		if (!strcmp(Args[i], "--quick"))
+		{
+			Bench->Quick = true;
+			Bench->Samples = BENCH_QUICK_SAMPLES;
+			Bench->SampleTime = BENCH_QUICK_NS;
+		}
+		else if (!strcmp(Args[i], "--json") && i + 1 < ArgCount)
+		{
+			JsonFile = Args[++i];
+		}
+		else if (!strcmp(Args[i], "--compare") && i + 1 < ArgCount)
+		{
+			BaseFile = Args[++i];
+		}
+		else if (!strcmp(Args[i], "--runs") && i + 1 < ArgCount)
+		{
+			Bench->Samples = atoi(Args[++i]);
+			if (Bench->Samples < 1 || Bench->Samples > BENCH_MAX_SAMPLES)
+			{
+				LibMsg(MSG_ERROR, "Number of runs should be 1 - %d \n", BENCH_MAX_SAMPLES);
+				Result = PS2HL_ERR_PARAM;
+			}
+		}
+		else if (Args[i][0] != '-' && Bench->PatternCount < BENCH_MAX_PATTERNS)
+		{
+			Bench->Patterns[Bench->PatternCount++] = Args[i];
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Unknown bench option: %s \n", Args[i]);
+			Result = PS2HL_ERR_PARAM;
+		}
+	}
+
+	if (Result == PS2HL_OK && BaseFile != NULL)
+		Result = BenchLoad(Bench, BaseFile);
+
+	if (Result == PS2HL_OK)
+	{
+		LibMsg(MSG_INFO, "%-21s %-17s %12s %7s %10s %10s %8s \n", "Kernel", "Case", "ns/run", "dev", "ns/pixel", "MB/s", BaseFile ? "change" : "");
+
+		BenchPNGKernels(Bench);
+		BenchPNGRowKernels(Bench);
+		BenchPNGUnpackKernels(Bench);
+		BenchZKernels(Bench);
+		BenchChecksumKernels(Bench);
+		for (int i = 0; (Tool = JobGetTool(i)) != NULL; i++)
+			if (Tool->Bench != NULL)
+				Tool->Bench(Bench);
+
+		if (Bench->Errors != 0)
+		{
+			Result = PS2HL_ERR_FORMAT;
+		}
+		else if (Bench->Count == 0)
+		{
+			LibMsg(MSG_ERROR, "No kernels match given names \n");
+			Result = PS2HL_ERR_PARAM;
+		}
+	}
+
+	if (Result == PS2HL_OK && JsonFile != NULL)
+		Result = BenchSave(Bench, JsonFile);
+
+	LibFree(Bench->Results);
+	LibFree(Bench->Base);
+	LibFree(Bench);
+	return Result;
+}
@@ -0,0 +1,37 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "types.h"
+
+// Microbenchmarks of hot kernels. Common ones (PNG filters, inflate) live in
+// bench.cpp, kernels of tools are registered by BenchKernels() of each tool
+// (see jobs.h). Every case is calibrated to run for a few milliseconds per
+// sample, several samples are taken and mean, deviation and best time are
+// reported as ns/pixel and MB/s. Results can be saved to JSON (one case per
+// line) and compared with previous run:
+//	ps2hl bench --json before.json
+//	ps2hl bench --compare before.json
+
+#define BENCH_DIM_COUNT		4		// Texture sizes of image cases
+extern const ushort BenchDims[BENCH_DIM_COUNT];	// 8, 32, 128, 512
+
+typedef unsigned long long tBenchTime;
+extern volatile int BenchSink;		// Store results of pure kernels here, so they are not optimized out
+
+struct sBench;
+
+typedef void (*tBenchFunc)(void * Ctx);
+
+bool BenchWants(sBench * Bench, const char * Kernel);		// Check if kernel (or group - "mdl.") is selected (skip preparing inputs otherwise)
+void BenchRun(sBench * Bench, const char * Kernel, const char * Case, ulong Pixels, ulong Bytes,
+	tBenchFunc Prepare, tBenchFunc Run, void * Ctx);		// Measure Run(Ctx) (Prepare - untimed setup before each run or NULL, Pixels/Bytes - work of one run, 0 - don't report)
+void BenchFillImage(uchar * Data, ulong Size, uint Levels, uint Seed);		// Texture-like test data (same for same seed)
+tBenchTime BenchNow();										// Monotonic time, ns
+tBenchTime BenchCPUTime();									// User + system time of process, ns
+ulong BenchPeakRSS(bool Reset);								// Peak resident set, KiB (Reset - start new peak where OS allows, returns 0)
+int BenchMain(int ArgCount, char ** Args);					// "ps2hl bench" (Args - options and kernel patterns), returns PS2HL_OK or error
+
+#endif // BENCH_H
@@ -0,0 +1,1438 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains incremental asset build: source tree is scanned
+// into a graph of nodes (file -> converted file -> PAK), every node
+// is checked against state of previous build and only dirty nodes run.
+//
+// Node is clean when stamps (size and time) of its sources are the same
+// as before, or when stamps differ but content hashes don't, and all of
+// its outputs still exist. File nodes run on a thread pool, PAK node is
+// queued when the last of its files is done.
+//
+// Build session can stay open (watch mode): graph of last update becomes
+// previous state of the next one, files that aren't marked as changed
+// are taken as clean without checking, and PAKs are patched in memory
+// images instead of packing whole dir again.
+//
+// State file (OUT/.ps2hl-build):
+//	PS2HL build <format>
+//	N <kind> <signature> <size> <time> <side size> <side time> <name>
+//	O <output name>			- outputs of previous node
+// Kinds: C - copy, V - conversion, P - PAK. Names are relative to
+// source and output dirs.
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "thpool.h"		// Goes first: sets up windows.h version
+#include "ps2hl.h"
+#include "fops.h"
+#include "jobs.h"
+#include "hash.h"
+#include "pakimg.h"
+#include "build.h"
+
+////////// Definitions //////////
+#ifdef _WIN32
+	#define BUILD_U64 "%I64u"	// Old msvcrt doesn't know %llu
+#else
+	#define BUILD_U64 "%llu"
+#endif
+
+#define BUILD_FORMAT	1		// Bump when signatures or state layout change
+#define BUILD_LINE_LEN	(PATH_LEN + 160)	// Max state file line length
+#define BUILD_MAX_CHANGED	256	// More changed files than that - check everything
+
+#define BUILD_COPY		'C'		// Node kinds
+#define BUILD_CONVERT	'V'		//
+#define BUILD_PAK		'P'		//
+
+////////// Structures //////////
+
+// Conversion rule
+struct sBuildRule
+{
+	const char * Ext;			// Source extension
+	const char * Tool;			// Converter
+	const char * Side;			// Extension of side file read by converter (NULL - none)
+};
+
+// List of names
+struct sBuildNames
+{
+	char ** Names;
+	int Count;
+	int Size;					// Allocated
+};
+
+struct sBuild;
+
+// Graph node (also used for entries of previous state)
+struct sBuildNode
+{
+	int Kind;					// BUILD_COPY, BUILD_CONVERT or BUILD_PAK
+	char * Name;				// Source file name or PAK dir name (relative)
+	const sJobTool * Tool;		// Converter (BUILD_CONVERT)
+	const char * Command;		// PAK command (BUILD_PAK)
+	const char * SideExt;		// Side file extension (NULL - none)
+	int Parent;					// PAK node (-1 - none)
+	int Pending;				// PAK: files that aren't done yet
+	sFileStamp Stamp;			// Source stamps (zero - missing)
+	sFileStamp SideStamp;		//
+	uchar Sig[HASH_SIZE];		// Signature: hash of tool version, source and side file contents
+	sBuildNames Outputs;		// Output names (relative)
+	sBuildNode * Old;			// Same node of previous build (NULL - new node)
+	sBuild * Build;				// Owner
+	bool Matched;				// Entry of previous state has node in current graph
+	bool Ran;					// Node was rebuilt
+	int Result;					// PS2HL_OK or error
+	pak::sPAKImage * Image;		// PAK: image kept between updates (NULL - not loaded)
+};
+
+// Build session
+struct sBuild
+{
+	char SrcDir[PATH_LEN];		// With trailing delimiter
+	char OutDir[PATH_LEN];		//
+	sBuildNode * Nodes;			// Current graph
+	int Count;					//
+	int Size;					//
+	sBuildNode * Old;			// Previous state (sorted by name)
+	int OldCount;				//
+	int OldSize;				//
+	sBuildNames Changed;		// Sources changed since last update
+	bool ChangedAll;			// Check every source
+	bool Warm;					// Patch PAK images instead of packing
+	sThreadPool Pool;			// Workers (kept between updates)
+	bool HasPool;				// false - run in place
+	tMutex Lock;				// Protects counters and PAK Pending
+	int Done;					// Counters
+	int Rebuilt;				//
+	int Failed;					//
+	int Result;					// First error
+};
+
+// Streaming of one dir into PAK
+struct sBuildStream
+{
+	char SrcDir[PATH_LEN];		// With trailing delimiter
+	char InDir[PATH_LEN];		// Where converters run (source dir or staging dir)
+	char PakName[PATH_LEN];		// PAK name without extension (rules depend on it)
+	bool Staged;				// No sink on this platform - convert staged copies
+	pak::sPAKImage * Image;		// PAK being written
+	sThreadPool Pool;			// Workers
+	bool HasPool;				// false - run in place
+	tMutex Lock;				// Protects image and counters
+	int Done;					// Counters
+	int Failed;					//
+	int Result;					// First error
+};
+
+// File of streamed dir
+struct sBuildStreamFile
+{
+	sBuildStream * Stream;		// Owner
+	char * Name;				// Source file name (relative)
+	sBuildNames Written;		// Files written to disk by staged conversion (relative)
+	tFileHook PrevHook;			// Hook to chain
+	void * PrevCtx;				//
+};
+
+////////// Globals //////////
+static const sBuildRule BuildRules[] =
+{
+	{ ".mdl", "mdl", ".inf" },
+	{ ".spr", "spr", NULL },
+	{ ".bmp", "phd", NULL },
+	{ ".png", "psi", NULL },	// "phd" in DECALS dir
+	{ ".nod", "nod", NULL }
+};
+#define BUILD_RULE_COUNT (int)(sizeof(BuildRules) / sizeof(BuildRules[0]))
+
+////////// Names //////////
+static bool NamesHas(sBuildNames * List, const char * Name)
+{
+	for (int i = 0; i < List->Count; i++)
+		if (!strcmp(List->Names[i], Name))
+			return true;
+
+	return false;
+}
+
+static bool NamesAdd(sBuildNames * List, const char * Name)
+{
+	size_t Len = strlen(Name);
+
+	if (NamesHas(List, Name) == true)
+		return true;
+
+	// Grow array
+	if (List->Count == List->Size)
+	{
+		int NewSize = List->Size ? List->Size * 2 : 4;
+		char ** NewNames = (char **)LibCalloc(NewSize, sizeof(char *));
+		if (NewNames == NULL)
+			return false;
+		if (List->Names != NULL)
+			memcpy(NewNames, List->Names, sizeof(char *) * List->Count);
+		LibFree(List->Names);
+		List->Names = NewNames;
+		List->Size = NewSize;
+	}
+
+	List->Names[List->Count] = (char *)LibAlloc(Len + 1);
+	if (List->Names[List->Count] == NULL)
+		return false;
+	memcpy(List->Names[List->Count], Name, Len + 1);
+	List->Count++;
+
+	return true;
+}
+
+static void NamesRemove(sBuildNames * List, const char * Name)
+{
+	for (int i = 0; i < List->Count; i++)
+	{
+		if (!strcmp(List->Names[i], Name))
+		{
+			LibFree(List->Names[i]);
+			List->Names[i] = List->Names[--List->Count];
+			return;
+		}
+	}
+}
+
+static void NamesFree(sBuildNames * List)
+{
+	for (int i = 0; i < List->Count; i++)
+		LibFree(List->Names[i]);
+	LibFree(List->Names);
+	List->Names = NULL;
+	List->Count = List->Size = 0;
+}
+
+////////// Nodes //////////
+static sBuildNode * BuildAddNode(sBuildNode ** Nodes, int * Count, int * Size, int Kind, const char * Name)
+{
+	sBuildNode * Node;
+	size_t Len = strlen(Name);
+
+	// Grow array
+	if (*Count == *Size)
+	{
+		int NewSize = *Size ? *Size * 2 : 64;
+		sBuildNode * NewNodes = (sBuildNode *)LibCalloc(NewSize, sizeof(sBuildNode));
+		if (NewNodes == NULL)
+			return NULL;
+		if (*Nodes != NULL)
+			memcpy(NewNodes, *Nodes, sizeof(sBuildNode) * *Count);
+		LibFree(*Nodes);
+		*Nodes = NewNodes;
+		*Size = NewSize;
+	}
+
+	Node = &(*Nodes)[*Count];
+	memset(Node, 0x00, sizeof(sBuildNode));
+	Node->Name = (char *)LibAlloc(Len + 1);
+	if (Node->Name == NULL)
+		return NULL;
+	memcpy(Node->Name, Name, Len + 1);
+	Node->Kind = Kind;
+	Node->Parent = -1;
+	(*Count)++;
+
+	return Node;
+}
+
+static void BuildFreeNodes(sBuildNode * Nodes, int Count)
+{
+	for (int i = 0; i < Count; i++)
+	{
+		LibFree(Nodes[i].Name);
+		NamesFree(&Nodes[i].Outputs);
+		pak::FreePAKImage(Nodes[i].Image);
+	}
+	LibFree(Nodes);
+}
+
+static int BuildCompareNodes(const void * A, const void * B)
+{
+	const sBuildNode * NodeA = (const sBuildNode *)A;
+	const sBuildNode * NodeB = (const sBuildNode *)B;
+	int Result = strcmp(NodeA->Name, NodeB->Name);
+
+	return Result ? Result : NodeA->Kind - NodeB->Kind;
+}
+
+static sBuildNode * BuildFindOld(sBuild * Build, int Kind, const char * Name)
+{
+	sBuildNode Key;
+
+	Key.Kind = Kind;
+	Key.Name = (char *)Name;
+
+	return (sBuildNode *)bsearch(&Key, Build->Old, Build->OldCount, sizeof(sBuildNode), BuildCompareNodes);
+}
+
+static bool BuildOutputsExist(sBuild * Build, sBuildNames * Outputs)
+{
+	char Name[PATH_LEN];
+	sFileStamp Stamp;
+
+	for (int i = 0; i < Outputs->Count; i++)
+	{
+		snprintf(Name, sizeof(Name), "%s%s", Build->OutDir, Outputs->Names[i]);
+		if (FileGetStamp(Name, &Stamp) == false)
+			return false;
+	}
+
+	return true;
+}
+
+static void BuildRemoveOutputs(sBuild * Build, sBuildNames * Outputs)
+{
+	char Name[PATH_LEN];
+
+	for (int i = 0; i < Outputs->Count; i++)
+	{
+		snprintf(Name, sizeof(Name), "%s%s", Build->OutDir, Outputs->Names[i]);
+		remove(Name);
+	}
+}
+
+static bool BuildCopyOutputs(sBuildNode * Node)	// Clean node keeps outputs of previous build
+{
+	for (int i = 0; i < Node->Old->Outputs.Count; i++)
+		if (NamesAdd(&Node->Outputs, Node->Old->Outputs.Names[i]) == false)
+			return false;
+
+	return true;
+}
+
+////////// State //////////
+static void BuildLoadState(sBuild * Build)
+{
+	char Name[PATH_LEN];
+	char Line[BUILD_LINE_LEN];
+	char Hex[HASH_HEX_LEN + 1];
+	char Kind;
+	int Format;
+	int Pos;
+	sBuildNode Node;
+	sBuildNode * Last = NULL;
+	FILE * ptrFile;
+
+	// Missing or old state - everything is dirty
+	if (snprintf(Name, sizeof(Name), "%s" BUILD_STATE, Build->OutDir) >= (int)sizeof(Name))
+		return;
+	ptrFile = fopen(Name, "r");
+	if (ptrFile == NULL)
+		return;
+	if (fgets(Line, sizeof(Line), ptrFile) == NULL || sscanf(Line, "PS2HL build %d", &Format) != 1 || Format != BUILD_FORMAT)
+	{
+		fclose(ptrFile);
+		return;
+	}
+
+	while (fgets(Line, sizeof(Line), ptrFile) != NULL)
+	{
+		Line[strcspn(Line, "\r\n")] = '\0';
+
+		if (Line[0] == 'O' && Line[1] == ' ' && Last != NULL)
+		{
+			NamesAdd(&Last->Outputs, &Line[2]);
+			continue;
+		}
+
+		Last = NULL;
+		if (Line[0] != 'N' || sscanf(Line, "N %c %32s " BUILD_U64 " " BUILD_U64 " " BUILD_U64 " " BUILD_U64 " %n", &Kind, Hex, &Node.Stamp.Size, &Node.Stamp.Time,
+			&Node.SideStamp.Size, &Node.SideStamp.Time, &Pos) != 6 || HashFromHex(Hex, Node.Sig) == false)
+			continue;
+
+		Last = BuildAddNode(&Build->Old, &Build->OldCount, &Build->OldSize, Kind, &Line[Pos]);
+		if (Last == NULL)
+			break;
+		Last->Stamp = Node.Stamp;
+		Last->SideStamp = Node.SideStamp;
+		memcpy(Last->Sig, Node.Sig, HASH_SIZE);
+	}
+	fclose(ptrFile);
+
+	qsort(Build->Old, Build->OldCount, sizeof(sBuildNode), BuildCompareNodes);
+}
+
+static bool BuildSaveState(sBuild * Build)
+{
+	char Name[PATH_LEN];
+	char TmpName[PATH_LEN];
+	char Hex[HASH_HEX_LEN];
+	sBuildNode * Node;
+	FILE * ptrFile;
+	bool Result;
+
+	if (snprintf(Name, sizeof(Name), "%s" BUILD_STATE, Build->OutDir) >= (int)sizeof(Name) ||
+		snprintf(TmpName, sizeof(TmpName), "%s" BUILD_STATE ".tmp", Build->OutDir) >= (int)sizeof(TmpName))
+		return false;
+	ptrFile = fopen(TmpName, "w");
+	if (ptrFile == NULL)
+		return false;
+
+	fprintf(ptrFile, "PS2HL build %d\n", BUILD_FORMAT);
+	for (int i = 0; i < Build->Count; i++)
+	{
+		Node = &Build->Nodes[i];
+
+		// Failed node gets empty signature, so it runs next time
+		if (Node->Result != PS2HL_OK)
+			memset(Node->Sig, 0x00, HASH_SIZE);
+
+		HashToHex(Node->Sig, Hex);
+		fprintf(ptrFile, "N %c %s " BUILD_U64 " " BUILD_U64 " " BUILD_U64 " " BUILD_U64 " %s\n", Node->Kind, Hex, Node->Stamp.Size, Node->Stamp.Time,
+			Node->SideStamp.Size, Node->SideStamp.Time, Node->Name);
+		for (int j = 0; j < Node->Outputs.Count; j++)
+			fprintf(ptrFile, "O %s\n", Node->Outputs.Names[j]);
+	}
+	Result = fclose(ptrFile) == 0;
+
+	// Replace old state
+	if (Result == true)
+	{
+		remove(Name);
+		Result = rename(TmpName, Name) == 0;
+	}
+	else
+	{
+		remove(TmpName);
+	}
+
+	return Result;
+}
+
+////////// Scan //////////
+static const sBuildRule * BuildFindRule(const char * Name, const char ** ptrTool)
+{
+	char Ext[5];
+
+	FileGetExtension(Name, Ext, sizeof(Ext));
+	for (int i = 0; i < BUILD_RULE_COUNT; i++)
+	{
+		if (strcmp(Ext, BuildRules[i].Ext))
+			continue;
+
+		// PNG is ambiguous: decals live in DECALS.PAK
+		*ptrTool = BuildRules[i].Tool;
+		if (!strcmp(Ext, ".png") && !strncmp(Name, "DECALS", 6) && (Name[6] == DIR_DELIM_CH || Name[6] == DIR_NOT_DELIM_CH))
+			*ptrTool = "phd";
+
+		return &BuildRules[i];
+	}
+
+	return NULL;
+}
+
+static void BuildSideName(const char * Name, const char * SideExt, char * Out, int OutSize)
+{
+	char Base[PATH_LEN];
+
+	FileGetFullName(Name, Base, sizeof(Base));
+	snprintf(Out, OutSize, "%s%s", Base, SideExt);
+}
+
+static bool BuildIsSideFile(const char * SrcDir, const char * Name)	// Side file of other source (not built by itself)
+{
+	char Ext[5];
+	char Base[PATH_LEN];
+	char Main[PATH_LEN];
+	sFileStamp Stamp;
+
+	FileGetExtension(Name, Ext, sizeof(Ext));
+	FileGetFullName(Name, Base, sizeof(Base));
+	for (int i = 0; i < BUILD_RULE_COUNT; i++)
+	{
+		if (BuildRules[i].Side == NULL || strcmp(Ext, BuildRules[i].Side))
+			continue;
+
+		snprintf(Main, sizeof(Main), "%s%s%s", SrcDir, Base, BuildRules[i].Ext);
+		if (FileGetStamp(Main, &Stamp) == true)
+			return true;
+	}
+
+	return false;
+}
+
+static int BuildScan(sBuild * Build)
+{
+	const char * FullName;
+	const char * Name;
+	const char * ToolName;
+	const sBuildRule * Rule;
+	char PakName[PATH_LEN];
+	sBuildNode * Node;
+	sDirIter Iter;
+	int FileCount;
+
+	// Files
+	DirIterInit(&Iter, Build->SrcDir);
+	while ((FullName = DirIterGet(&Iter)) != NULL)
+	{
+		// Iterator returns names with source dir prefix
+		Name = FullName + strlen(Build->SrcDir);
+		while (*Name == DIR_DELIM_CH)
+			Name++;
+
+		if (BuildIsSideFile(Build->SrcDir, Name) == true)
+			continue;
+
+		Rule = BuildFindRule(Name, &ToolName);
+		Node = BuildAddNode(&Build->Nodes, &Build->Count, &Build->Size, Rule ? BUILD_CONVERT : BUILD_COPY, Name);
+		if (Node == NULL)
+		{
+			DirIterClose(&Iter);
+			return PS2HL_ERR_MEMORY;
+		}
+		if (Rule != NULL)
+		{
+			Node->Tool = JobFindTool(ToolName);
+			Node->SideExt = Rule->Side;
+		}
+	}
+	DirIterClose(&Iter);
+
+	if (Build->Count == 0)
+	{
+		LibMsg(MSG_ERROR, "Empty dir, nothing to build: %s \n", Build->SrcDir);
+		return PS2HL_ERR_PARAM;
+	}
+
+	// PAK nodes: one per dir in source root
+	qsort(Build->Nodes, Build->Count, sizeof(sBuildNode), BuildCompareNodes);
+	FileCount = Build->Count;
+	for (int i = 0; i < FileCount; i++)
+	{
+		int Len = strcspn(Build->Nodes[i].Name, DIR_DELIM DIR_NOT_DELIM);
+
+		if (Build->Nodes[i].Name[Len] == '\0')
+			continue;	// File in root - no PAK
+
+		// Files are sorted, so PAK of previous file is the only candidate
+		memcpy(PakName, Build->Nodes[i].Name, Len);
+		PakName[Len] = '\0';
+		if (Build->Count == FileCount || strcmp(Build->Nodes[Build->Count - 1].Name, PakName))
+		{
+			Node = BuildAddNode(&Build->Nodes, &Build->Count, &Build->Size, BUILD_PAK, PakName);
+			if (Node == NULL)
+				return PS2HL_ERR_MEMORY;
+			Node->Tool = JobFindTool("pak");
+			Node->Command = !strcmp(PakName, "GLOBAL") ? "gpack" : "cpack";
+		}
+
+		Build->Nodes[i].Parent = Build->Count - 1;
+		Build->Nodes[Build->Count - 1].Pending++;
+	}
+
+	// Link to previous state
+	for (int i = 0; i < Build->Count; i++)
+	{
+		Build->Nodes[i].Build = Build;
+		Build->Nodes[i].Result = PS2HL_OK;
+		Build->Nodes[i].Old = BuildFindOld(Build, Build->Nodes[i].Kind, Build->Nodes[i].Name);
+		if (Build->Nodes[i].Old != NULL)
+		{
+			Build->Nodes[i].Old->Matched = true;
+			Build->Nodes[i].Image = Build->Nodes[i].Old->Image;
+			Build->Nodes[i].Old->Image = NULL;
+		}
+	}
+
+	return PS2HL_OK;
+}
+
+static void BuildRemoveStale(sBuild * Build)	// Remove outputs of nodes that are gone from source
+{
+	for (int i = 0; i < Build->OldCount; i++)
+	{
+		if (Build->Old[i].Matched == false)
+		{
+			LibMsg(MSG_DEBUG, "Removing outputs of: %s \n", Build->Old[i].Name);
+			BuildRemoveOutputs(Build, &Build->Old[i].Outputs);
+		}
+	}
+}
+
+////////// Node jobs //////////
+static void BuildHook(void * Ctx, int Access, const char * FileName, const char * OldName)
+{
+	sBuildNode * Node = (sBuildNode *)Ctx;
+	size_t DirLen = strlen(Node->Build->OutDir);
+
+	// Outputs are kept relative to output dir
+	if (Access == FILE_HOOK_RENAME && !strncmp(OldName, Node->Build->OutDir, DirLen))
+		NamesRemove(&Node->Outputs, OldName + DirLen);
+	if ((Access == FILE_HOOK_WRITE || Access == FILE_HOOK_RENAME) && !strncmp(FileName, Node->Build->OutDir, DirLen))
+		NamesAdd(&Node->Outputs, FileName + DirLen);
+}
+
+static void BuildSign(sBuildNode * Node, const uchar * SrcHash, const uchar * SideHash)
+{
+	sHash Hash;
+
+	HashInit(&Hash, BUILD_FORMAT);
+	Hash.H1 ^= Node->Kind;
+	if (Node->Tool != NULL)
+	{
+		HashStr(&Hash, Node->Tool->Name);
+		HashStr(&Hash, Node->Tool->Version());
+	}
+	if (Node->Command != NULL)
+		HashStr(&Hash, Node->Command);
+	if (SrcHash != NULL)
+		HashUpdate(&Hash, SrcHash, HASH_SIZE);
+	if (SideHash != NULL)
+		HashUpdate(&Hash, SideHash, HASH_SIZE);
+	HashFinal(&Hash, Node->Sig);
+}
+
+static bool BuildIsUnchanged(sBuildNode * Node)	// Source and side file weren't marked as changed
+{
+	sBuild * Build = Node->Build;
+	char SideName[PATH_LEN];
+
+	if (Build->ChangedAll == true || Node->Old == NULL || Node->Old->Result != PS2HL_OK || NamesHas(&Build->Changed, Node->Name) == true)
+		return false;
+
+	if (Node->SideExt != NULL)
+	{
+		BuildSideName(Node->Name, Node->SideExt, SideName, sizeof(SideName));
+		if (NamesHas(&Build->Changed, SideName) == true)
+			return false;
+	}
+
+	return true;
+}
+
+static int BuildFile(sBuildNode * Node)
+{
+	sBuild * Build = Node->Build;
+	char SrcName[PATH_LEN];
+	char SideName[PATH_LEN];
+	char StageName[PATH_LEN];
+	char StageSide[PATH_LEN];
+	uchar SrcHash[HASH_SIZE];
+	uchar SideHash[HASH_SIZE];
+	bool HasSide = false;
+	tFileHook PrevHook;
+	void * PrevCtx;
+	int Result;
+
+	// Nothing happened to file since last update
+	if (BuildIsUnchanged(Node) == true)
+	{
+		Node->Stamp = Node->Old->Stamp;
+		Node->SideStamp = Node->Old->SideStamp;
+		memcpy(Node->Sig, Node->Old->Sig, HASH_SIZE);
+		return BuildCopyOutputs(Node) ? PS2HL_OK : PS2HL_ERR_MEMORY;
+	}
+
+	snprintf(SrcName, sizeof(SrcName), "%s%s", Build->SrcDir, Node->Name);
+	snprintf(StageName, sizeof(StageName), "%s%s", Build->OutDir, Node->Name);
+	if (FileGetStamp(SrcName, &Node->Stamp) == false)
+	{
+		LibMsg(MSG_ERROR, "Error: can't open file: %s \n", SrcName);
+		return PS2HL_ERR_OPEN;
+	}
+	if (Node->SideExt != NULL)
+	{
+		BuildSideName(SrcName, Node->SideExt, SideName, sizeof(SideName));
+		BuildSideName(StageName, Node->SideExt, StageSide, sizeof(StageSide));
+		HasSide = FileGetStamp(SideName, &Node->SideStamp);
+	}
+
+	// Same stamps - no need to read anything
+	if (Node->Old != NULL && !memcmp(&Node->Stamp, &Node->Old->Stamp, sizeof(sFileStamp)) &&
+		!memcmp(&Node->SideStamp, &Node->Old->SideStamp, sizeof(sFileStamp)) && BuildOutputsExist(Build, &Node->Old->Outputs))
+	{
+		memcpy(Node->Sig, Node->Old->Sig, HASH_SIZE);
+		return BuildCopyOutputs(Node) ? PS2HL_OK : PS2HL_ERR_MEMORY;
+	}
+
+	// Stamps changed (touched, copied) - compare contents
+	if (HashFile(SrcName, SrcHash) == false || (HasSide == true && HashFile(SideName, SideHash) == false))
+	{
+		LibMsg(MSG_ERROR, "Error: can't read file: %s \n", SrcName);
+		return PS2HL_ERR_OPEN;
+	}
+	BuildSign(Node, SrcHash, HasSide ? SideHash : NULL);
+	if (Node->Old != NULL && !memcmp(Node->Sig, Node->Old->Sig, HASH_SIZE) && BuildOutputsExist(Build, &Node->Old->Outputs))
+		return BuildCopyOutputs(Node) ? PS2HL_OK : PS2HL_ERR_MEMORY;
+
+	// Dirty
+	LibMsg(MSG_INFO, "Building: %s \n", Node->Name);
+	Node->Ran = true;
+	if (Node->Old != NULL)
+		BuildRemoveOutputs(Build, &Node->Old->Outputs);
+
+	GenerateFolders(StageName);
+	if (FileClone(SrcName, StageName, false) == false)
+	{
+		LibMsg(MSG_ERROR, "Error: can't copy file: %s \n", SrcName);
+		return PS2HL_ERR_OPEN;
+	}
+	if (Node->Kind == BUILD_COPY)
+		return NamesAdd(&Node->Outputs, Node->Name) ? PS2HL_OK : PS2HL_ERR_MEMORY;
+	if (HasSide == true && FileClone(SideName, StageSide, false) == false)
+	{
+		LibMsg(MSG_ERROR, "Error: can't copy file: %s \n", SideName);
+		remove(StageName);
+		return PS2HL_ERR_OPEN;
+	}
+
+	// Convert staged copy, everything it writes is an output
+	FileGetHook(&PrevHook, &PrevCtx);
+	FileSetHook(BuildHook, Node);
+	Result = JobRun(Node->Tool->Name, JOB_CMD_AUTO, StageName);
+	FileSetHook(PrevHook, PrevCtx);
+
+	// Staged sources aren't outputs (unless converted in place)
+	if (HasSide == true)
+	{
+		remove(StageSide);
+		NamesRemove(&Node->Outputs, StageSide + strlen(Build->OutDir));
+	}
+	for (int i = 0; i < Node->Outputs.Count; i++)
+		if (!strcmp(Node->Outputs.Names[i], Node->Name))
+			return Result;
+	remove(StageName);
+
+	return Result;
+}
+
+static int BuildCompareEntries(const void * A, const void * B)	// Compare names ignoring kind of slashes
+{
+	const char * NameA = *(const char **)A;
+	const char * NameB = *(const char **)B;
+	int ChA, ChB;
+
+	do
+	{
+		ChA = (*NameA == DIR_NOT_DELIM_CH) ? DIR_DELIM_CH : (uchar)*NameA;
+		ChB = (*NameB == DIR_NOT_DELIM_CH) ? DIR_DELIM_CH : (uchar)*NameB;
+		NameA++;
+		NameB++;
+	} while (ChA == ChB && ChA != '\0');
+
+	return ChA - ChB;
+}
+
+static int BuildPatchPak(sBuildNode * Node)	// Update entries of rebuilt files in PAK image
+{
+	sBuild * Build = Node->Build;
+	sBuildNode * File;
+	const char ** Entries;
+	const char * Entry;
+	char PakName[PATH_LEN];
+	char FileName[PATH_LEN];
+	char EntryName[PATH_LEN];
+	size_t Prefix = strlen(Node->Name);
+	int EntryCount = 0;
+	int Result = PS2HL_OK;
+
+	if (snprintf(PakName, sizeof(PakName), "%s%s.PAK", Build->OutDir, Node->Name) >= (int)sizeof(PakName))
+		return PS2HL_ERR_PARAM;
+	if (Node->Image == NULL)
+	{
+		Result = pak::LoadPAKImage(PakName, &Node->Image);
+		if (Result != PS2HL_OK)
+			return Result;
+	}
+
+	// Entries that PAK should have: outputs of its files without dir name
+	for (int i = 0; i < Build->Count; i++)
+		if (Build->Nodes[i].Parent == Node - Build->Nodes)
+			EntryCount += Build->Nodes[i].Outputs.Count;
+	Entries = (const char **)LibCalloc(EntryCount + 1, sizeof(char *));
+	if (Entries == NULL)
+		return PS2HL_ERR_MEMORY;
+	EntryCount = 0;
+	for (int i = 0; i < Build->Count; i++)
+	{
+		File = &Build->Nodes[i];
+		if (File->Parent != Node - Build->Nodes)
+			continue;
+		for (int j = 0; j < File->Outputs.Count; j++)
+			Entries[EntryCount++] = File->Outputs.Names[j] + Prefix + 1;
+	}
+	qsort(Entries, EntryCount, sizeof(char *), BuildCompareEntries);
+
+	// Drop entries of removed files
+	for (int i = pak::GetPAKEntryCount(Node->Image) - 1; i >= 0; i--)
+	{
+		Entry = pak::GetPAKEntryName(Node->Image, i);
+		if (bsearch(&Entry, Entries, EntryCount, sizeof(char *), BuildCompareEntries) == NULL)
+		{
+			LibMsg(MSG_DEBUG, "Removing PAK entry: %s \n", Entry);
+			pak::RemovePAKEntry(Node->Image, Entry);
+		}
+	}
+
+	// Replace entries of rebuilt files, add new ones
+	for (int i = 0; i < Build->Count && Result == PS2HL_OK; i++)
+	{
+		File = &Build->Nodes[i];
+		if (File->Parent != Node - Build->Nodes || File->Ran == false)
+			continue;
+
+		for (int j = 0; j < File->Outputs.Count && Result == PS2HL_OK; j++)
+		{
+			snprintf(FileName, sizeof(FileName), "%s%s", Build->OutDir, File->Outputs.Names[j]);
+			snprintf(EntryName, sizeof(EntryName), "%s", File->Outputs.Names[j] + Prefix + 1);
+			PatchSlashes(EntryName, strlen(EntryName), false);
+			LibMsg(MSG_DEBUG, "Patching PAK entry: %s \n", EntryName);
+			Result = pak::PatchPAKImage(Node->Image, EntryName, FileName);
+		}
+	}
+	LibFree(Entries);
+
+	// Every expected entry has to be there (i.e. when file failed before)
+	if (Result == PS2HL_OK && pak::GetPAKEntryCount(Node->Image) != EntryCount)
+		Result = PS2HL_ERR_SKIP;
+
+	if (Result == PS2HL_OK)
+		Result = pak::SavePAKImage(Node->Image, PakName);
+
+	// Image may be half patched - drop it, PAK gets packed from scratch
+	if (Result != PS2HL_OK)
+	{
+		pak::FreePAKImage(Node->Image);
+		Node->Image = NULL;
+	}
+
+	return Result;
+}
+
+static bool BuildCanPatch(sBuildNode * Node)	// Previous PAK is there and can be patched
+{
+	static const uchar NoSig[HASH_SIZE] = { 0 };
+
+	return Node->Build->Warm == true && Node->Old != NULL && !strcmp(Node->Command, "cpack") &&
+		memcmp(Node->Old->Sig, NoSig, HASH_SIZE) != 0 && BuildOutputsExist(Node->Build, &Node->Old->Outputs);
+}
+
+static int BuildPak(sBuildNode * Node)
+{
+	sBuild * Build = Node->Build;
+	sBuildNode * File;
+	char DirName[PATH_LEN];
+	sHash Hash;
+
+	// Signature: names, signatures and outputs of all files
+	HashInit(&Hash, BUILD_FORMAT);
+	HashStr(&Hash, Node->Command);
+	HashStr(&Hash, Node->Tool->Version());
+	for (int i = 0; i < Build->Count; i++)
+	{
+		File = &Build->Nodes[i];
+		if (File->Parent != Node - Build->Nodes)
+			continue;
+
+		if (File->Result != PS2HL_OK)
+		{
+			LibMsg(MSG_ERROR, "Skipping %s.PAK: %s failed \n", Node->Name, File->Name);
+			return PS2HL_ERR_SKIP;
+		}
+
+		HashStr(&Hash, File->Name);
+		HashUpdate(&Hash, File->Sig, HASH_SIZE);
+		for (int j = 0; j < File->Outputs.Count; j++)
+			HashStr(&Hash, File->Outputs.Names[j]);
+	}
+	HashFinal(&Hash, Node->Sig);
+
+	if (Node->Old != NULL && !memcmp(Node->Sig, Node->Old->Sig, HASH_SIZE) && BuildOutputsExist(Build, &Node->Old->Outputs))
+		return BuildCopyOutputs(Node) ? PS2HL_OK : PS2HL_ERR_MEMORY;
+
+	// Dirty
+	Node->Ran = true;
+	if (BuildCanPatch(Node) == true)
+	{
+		LibMsg(MSG_INFO, "Patching: %s.PAK \n", Node->Name);
+		if (BuildPatchPak(Node) == PS2HL_OK)
+			return BuildCopyOutputs(Node) ? PS2HL_OK : PS2HL_ERR_MEMORY;
+	}
+
+	LibMsg(MSG_INFO, "Packing: %s \n", Node->Name);
+	pak::FreePAKImage(Node->Image);	// Image of old PAK is useless now
+	Node->Image = NULL;
+	if (Node->Old != NULL)
+		BuildRemoveOutputs(Build, &Node->Old->Outputs);
+
+	if (!strcmp(Node->Command, "gpack"))
+	{
+		NamesAdd(&Node->Outputs, "GLOBAL.PAK");
+		NamesAdd(&Node->Outputs, "GRESTORE.PAK");
+	}
+	else
+	{
+		snprintf(DirName, sizeof(DirName), "%s.PAK", Node->Name);
+		NamesAdd(&Node->Outputs, DirName);
+	}
+
+	snprintf(DirName, sizeof(DirName), "%s%s", Build->OutDir, Node->Name);
+	return JobRun(Node->Tool->Name, Node->Command, DirName);
+}
+
+static void BuildTask(void * Arg);
+
+static void BuildQueue(sBuildNode * Node)
+{
+	if (Node->Build->HasPool == false || PoolAdd(&Node->Build->Pool, BuildTask, Node) == false)
+		BuildTask(Node);	// Single thread or out of memory - run in place
+}
+
+static void BuildTask(void * Arg)
+{
+	sBuildNode * Node = (sBuildNode *)Arg;
+	sBuild * Build = Node->Build;
+	sBuildNode * Parent = NULL;
+
+	Node->Result = (Node->Kind == BUILD_PAK) ? BuildPak(Node) : BuildFile(Node);
+
+	MutexLock(&Build->Lock);
+	Build->Done++;
+	if (Node->Result != PS2HL_OK)
+	{
+		Build->Failed++;
+		if (Build->Result == PS2HL_OK)
+			Build->Result = Node->Result;
+		LibMsg(MSG_ERROR, "Failed: %s (%s) \n", Node->Name,
+			(Node->Result == PS2HL_ERR_SKIP) ? "skipped, one of its files failed" : LibStatusStr(Node->Result));
+	}
+	else if (Node->Ran == true)
+	{
+		Build->Rebuilt++;
+	}
+
+	// Last file of PAK is done - PAK is ready to go
+	if (Node->Parent >= 0 && --Build->Nodes[Node->Parent].Pending == 0)
+		Parent = &Build->Nodes[Node->Parent];
+	MutexUnlock(&Build->Lock);
+
+	if (Parent != NULL)
+		BuildQueue(Parent);
+}
+
+////////// Streaming to PAK //////////
+static int BuildStreamRead(const char * FileName, uchar ** ptrData, ulong * ptrSize)
+{
+	FILE * ptrFile;
+
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+
+	*ptrSize = FileSize(&ptrFile);
+	*ptrData = (uchar *)LibAlloc(*ptrSize ? *ptrSize : 1);
+	if (*ptrData == NULL)
+	{
+		fclose(ptrFile);
+		return PS2HL_ERR_MEMORY;
+	}
+	FileReadBlock(&ptrFile, *ptrData, 0, *ptrSize);
+	fclose(ptrFile);
+
+	return PS2HL_OK;
+}
+
+static int BuildStreamPut(sBuildStream * Stream, const char * Name, const void * Data, ulong Size)	// Name - relative to source dir
+{
+	char EntryName[PATH_LEN];
+	int Result;
+
+	snprintf(EntryName, sizeof(EntryName), "%s", Name);
+	PatchSlashes(EntryName, strlen(EntryName), false);
+	LibMsg(MSG_DEBUG, "PAK entry: %s \n", EntryName);
+
+	MutexLock(&Stream->Lock);
+	Result = pak::PutPAKEntry(Stream->Image, EntryName, Data, Size);
+	MutexUnlock(&Stream->Lock);
+
+	return Result;
+}
+
+static bool BuildSinkAccept(void * Ctx, const char * FileName)
+{
+	sBuildStreamFile * File = (sBuildStreamFile *)Ctx;
+
+	return !strncmp(FileName, File->Stream->InDir, strlen(File->Stream->InDir));
+}
+
+static bool BuildSinkPut(void * Ctx, const char * FileName, const void * Data, size_t Size)
+{
+	sBuildStreamFile * File = (sBuildStreamFile *)Ctx;
+
+	return BuildStreamPut(File->Stream, FileName + strlen(File->Stream->InDir), Data, (ulong)Size) == PS2HL_OK;
+}
+
+static void BuildStreamHook(void * Ctx, int Access, const char * FileName, const char * OldName)
+{
+	sBuildStreamFile * File = (sBuildStreamFile *)Ctx;
+	size_t DirLen = strlen(File->Stream->InDir);
+
+	// Files that went to disk (staged build) are collected after conversion
+	if (File->Stream->Staged == true && (Access == FILE_HOOK_WRITE || Access == FILE_HOOK_RENAME) && !strncmp(FileName, File->Stream->InDir, DirLen))
+		NamesAdd(&File->Written, FileName + DirLen);
+	if (File->PrevHook != NULL)
+		File->PrevHook(File->PrevCtx, Access, FileName, OldName);
+}
+
+static int BuildStreamCollect(sBuildStreamFile * File)	// Move files written by staged conversion into PAK
+{
+	sBuildStream * Stream = File->Stream;
+	char FileName[PATH_LEN];
+	uchar * Data;
+	ulong Size;
+	int Result = PS2HL_OK;
+
+	for (int i = 0; i < File->Written.Count; i++)
+	{
+		snprintf(FileName, sizeof(FileName), "%s%s", Stream->InDir, File->Written.Names[i]);
+		if (Result == PS2HL_OK)
+			Result = BuildStreamRead(FileName, &Data, &Size);
+		if (Result == PS2HL_OK)
+		{
+			Result = BuildStreamPut(Stream, File->Written.Names[i], Data, Size);
+			LibFree(Data);
+		}
+		remove(FileName);
+	}
+
+	return Result;
+}
+
+static int BuildStreamConvert(sBuildStreamFile * File, const sJobTool * Tool, const char * SideExt)
+{
+	sBuildStream * Stream = File->Stream;
+	char SrcName[PATH_LEN];
+	char SideName[PATH_LEN];
+	char InName[PATH_LEN];
+	char InSide[PATH_LEN];
+	bool HasSide = false;
+	sFileStamp Stamp;
+	tFileHook PrevHook;
+	void * PrevCtx;
+	int Result;
+
+	snprintf(SrcName, sizeof(SrcName), "%s%s", Stream->SrcDir, File->Name);
+	snprintf(InName, sizeof(InName), "%s%s", Stream->InDir, File->Name);
+	if (SideExt != NULL)
+	{
+		BuildSideName(SrcName, SideExt, SideName, sizeof(SideName));
+		BuildSideName(InName, SideExt, InSide, sizeof(InSide));
+		HasSide = (Stream->Staged == true) && FileGetStamp(SideName, &Stamp);
+	}
+
+	// No sink - converter works on staged copy as in normal build
+	if (Stream->Staged == true)
+	{
+		GenerateFolders(InName);
+		if (FileClone(SrcName, InName, false) == false || (HasSide == true && FileClone(SideName, InSide, false) == false))
+		{
+			LibMsg(MSG_ERROR, "Error: can't copy file: %s \n", SrcName);
+			remove(InName);
+			return PS2HL_ERR_OPEN;
+		}
+	}
+
+	// Converter isn't changed: its FileOpen() lands in PAK (cache is skipped, it needs files on disk)
+	FileGetHook(&PrevHook, &PrevCtx);
+	File->PrevHook = PrevHook;
+	File->PrevCtx = PrevCtx;
+	FileSetHook(BuildStreamHook, File);
+	if (Stream->Staged == false)
+		FileSetSink(BuildSinkAccept, BuildSinkPut, File);
+	Result = Tool->Run(JOB_CMD_AUTO, InName);
+	FileSetSink(NULL, NULL, NULL);
+	FileSetHook(PrevHook, PrevCtx);
+
+	if (Stream->Staged == true)
+	{
+		// Staged sources aren't outputs (unless converted in place)
+		if (NamesHas(&File->Written, File->Name) == false)
+			remove(InName);
+		if (HasSide == true)
+		{
+			NamesRemove(&File->Written, InSide + strlen(Stream->InDir));
+			remove(InSide);
+		}
+		if (Result == PS2HL_OK)
+			Result = BuildStreamCollect(File);
+		else
+			for (int i = 0; i < File->Written.Count; i++)
+			{
+				snprintf(InName, sizeof(InName), "%s%s", Stream->InDir, File->Written.Names[i]);
+				remove(InName);
+			}
+	}
+
+	return Result;
+}
+
+static void BuildStreamUnstage(sBuildStream * Stream, const char * Name)	// Remove staging dirs of file (ones that are empty)
+{
+	char Dir[PATH_LEN];
+	int Len;
+
+	snprintf(Dir, sizeof(Dir), "%s%s", Stream->InDir, Name);
+	for (Len = strlen(Dir); Len > (int)strlen(Stream->InDir); Len--)
+	{
+		if (Dir[Len] == DIR_DELIM_CH || Dir[Len] == DIR_NOT_DELIM_CH)
+		{
+			Dir[Len] = '\0';
+			DelDir(Dir);
+		}
+	}
+	DelDir(Stream->InDir);
+}
+
+static int BuildStreamFile(sBuildStreamFile * File)
+{
+	sBuildStream * Stream = File->Stream;
+	const sBuildRule * Rule;
+	const char * ToolName;
+	char RuleName[PATH_LEN];
+	char SrcName[PATH_LEN];
+	uchar * Data;
+	ulong Size;
+	int Result;
+
+	// Rules depend on PAK name (i.e. *.png in DECALS)
+	if (snprintf(RuleName, sizeof(RuleName), "%s" DIR_DELIM "%s", Stream->PakName, File->Name) >= (int)sizeof(RuleName))
+		return PS2HL_ERR_PARAM;
+	Rule = BuildFindRule(RuleName, &ToolName);
+	if (Rule != NULL)
+	{
+		LibMsg(MSG_INFO, "Converting: %s \n", File->Name);
+		return BuildStreamConvert(File, JobFindTool(ToolName), Rule->Side);
+	}
+
+	// Copied as is
+	snprintf(SrcName, sizeof(SrcName), "%s%s", Stream->SrcDir, File->Name);
+	Result = BuildStreamRead(SrcName, &Data, &Size);
+	if (Result != PS2HL_OK)
+		return Result;
+	Result = BuildStreamPut(Stream, File->Name, Data, Size);
+	LibFree(Data);
+
+	return Result;
+}
+
+static void BuildStreamTask(void * Arg)
+{
+	sBuildStreamFile * File = (sBuildStreamFile *)Arg;
+	sBuildStream * Stream = File->Stream;
+	int Result;
+
+	Result = BuildStreamFile(File);
+	NamesFree(&File->Written);
+
+	MutexLock(&Stream->Lock);
+	Stream->Done++;
+	if (Result != PS2HL_OK)
+	{
+		Stream->Failed++;
+		if (Stream->Result == PS2HL_OK)
+			Stream->Result = Result;
+		LibMsg(MSG_ERROR, "Failed: %s (%s) \n", File->Name, LibStatusStr(Result));
+	}
+	MutexUnlock(&Stream->Lock);
+}
+
+////////// Functions //////////
+static bool BuildSetDir(char * Out, const char * Dir)
+{
+	size_t Len = strlen(Dir);
+
+	if (Len == 0 || Len + 2 >= PATH_LEN)
+		return false;
+
+	strcpy(Out, Dir);
+	if (Out[Len - 1] != DIR_DELIM_CH && Out[Len - 1] != DIR_NOT_DELIM_CH)
+		strcat(Out, DIR_DELIM);
+
+	return true;
+}
+
+static void BuildKeepGraph(sBuild * Build)	// Graph of last update becomes previous state
+{
+	BuildFreeNodes(Build->Old, Build->OldCount);
+	Build->Old = Build->Nodes;
+	Build->OldCount = Build->Count;
+	Build->OldSize = Build->Size;
+	Build->Nodes = NULL;
+	Build->Count = Build->Size = 0;
+
+	for (int i = 0; i < Build->OldCount; i++)
+	{
+		Build->Old[i].Old = NULL;
+		Build->Old[i].Matched = false;
+	}
+	qsort(Build->Old, Build->OldCount, sizeof(sBuildNode), BuildCompareNodes);
+}
+
+sBuild * BuildOpen(const char * SrcDir, const char * OutDir, int Threads, bool Warm)
+{
+	sBuild * Build;
+	char Name[PATH_LEN];
+
+	Build = (sBuild *)LibCalloc(1, sizeof(sBuild));
+	if (Build == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return NULL;
+	}
+
+	if (CheckDir(SrcDir) == false || BuildSetDir(Build->SrcDir, SrcDir) == false || BuildSetDir(Build->OutDir, OutDir) == false)
+	{
+		LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+		LibFree(Build);
+		return NULL;
+	}
+
+	// Output dir inside of source would be scanned as source
+	if (!strncmp(Build->OutDir, Build->SrcDir, strlen(Build->SrcDir)))
+	{
+		LibMsg(MSG_ERROR, "Output dir can't be inside of source dir ...\n");
+		LibFree(Build);
+		return NULL;
+	}
+
+	// State file and its temp copy must fit
+	if (snprintf(Name, sizeof(Name), "%s" BUILD_STATE ".tmp", Build->OutDir) >= (int)sizeof(Name))
+	{
+		LibMsg(MSG_ERROR, "Output path is too long ...\n");
+		LibFree(Build);
+		return NULL;
+	}
+	GenerateFolders(Name);
+	BuildLoadState(Build);
+
+	MutexInit(&Build->Lock);
+	if (Threads > 1)
+		Build->HasPool = PoolStart(&Build->Pool, Threads);
+	Build->ChangedAll = true;
+	Build->Warm = Warm;
+
+	return Build;
+}
+
+void BuildMarkChanged(sBuild * Build, const char * Name)
+{
+	if (Build->ChangedAll == true)
+		return;
+
+	if (Name == NULL || Build->Changed.Count >= BUILD_MAX_CHANGED || NamesAdd(&Build->Changed, Name) == false)
+	{
+		Build->ChangedAll = true;
+		NamesFree(&Build->Changed);
+	}
+}
+
+int BuildUpdate(sBuild * Build)
+{
+	int Result;
+
+	// Previous update (if any) is the state to compare with
+	if (Build->Nodes != NULL)
+		BuildKeepGraph(Build);
+
+	Result = BuildScan(Build);
+	if (Result != PS2HL_OK)
+	{
+		BuildFreeNodes(Build->Nodes, Build->Count);
+		Build->Nodes = NULL;
+		Build->Count = Build->Size = 0;
+		return Result;
+	}
+	BuildRemoveStale(Build);
+
+	// Run file nodes, they queue PAK nodes
+	Build->Done = Build->Rebuilt = Build->Failed = 0;
+	Build->Result = PS2HL_OK;
+	for (int i = 0; i < Build->Count; i++)
+		if (Build->Nodes[i].Kind != BUILD_PAK)
+			BuildQueue(&Build->Nodes[i]);
+	if (Build->HasPool == true)
+		PoolWait(&Build->Pool);
+
+	if (BuildSaveState(Build) == false)
+		LibMsg(MSG_WARN, "Warning: can't save build state to %s \n", Build->OutDir);
+
+	LibMsg(MSG_INFO, "\nBuild: %d nodes, rebuilt: %d, up to date: %d, failed: %d \n", Build->Count,
+		Build->Rebuilt, Build->Done - Build->Rebuilt - Build->Failed, Build->Failed);
+
+	// Next update checks only what gets marked
+	Build->ChangedAll = false;
+	NamesFree(&Build->Changed);
+
+	return Build->Result;
+}
+
+void BuildClose(sBuild * Build)
+{
+	if (Build->HasPool == true)
+		PoolStop(&Build->Pool);
+	MutexDestroy(&Build->Lock);
+
+	NamesFree(&Build->Changed);
+	BuildFreeNodes(Build->Nodes, Build->Count);
+	BuildFreeNodes(Build->Old, Build->OldCount);
+	LibFree(Build);
+}
+
+int BuildRun(const char * SrcDir, const char * OutDir, int Threads)
+{
+	sBuild * Build;
+	int Result;
+
+	Build = BuildOpen(SrcDir, OutDir, Threads, false);
+	if (Build == NULL)
+		return PS2HL_ERR_PARAM;
+
+	Result = BuildUpdate(Build);
+	BuildClose(Build);
+
+	return Result;
+}
+
+int BuildStreamPak(const char * SrcDir, const char * PakFile, int Threads)
+{
+	sBuildStream * Stream;
+	sBuildStreamFile * Files = NULL;
+	sBuildStreamFile * NewFiles;
+	const char * FullName;
+	const char * Name;
+	sDirIter Iter;
+	int Count = 0;
+	int Size = 0;
+	int Result = PS2HL_OK;
+	char Dir[PATH_LEN];
+
+	Stream = (sBuildStream *)LibCalloc(1, sizeof(sBuildStream));
+	if (Stream == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	if (CheckDir(SrcDir) == false || BuildSetDir(Stream->SrcDir, SrcDir) == false)
+	{
+		LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+		LibFree(Stream);
+		return PS2HL_ERR_PARAM;
+	}
+
+	// GLOBAL.PAK comes with GRESTORE.PAK, it's packed by "pak gpack"
+	FileGetName(PakFile, Stream->PakName, sizeof(Stream->PakName), false);
+	if (!strcmp(Stream->PakName, "GLOBAL") || !strcmp(Stream->PakName, "GRESTORE"))
+	{
+		LibMsg(MSG_ERROR, "GLOBAL.PAK can't be streamed, use build or \"pak gpack\" ...\n");
+		LibFree(Stream);
+		return PS2HL_ERR_PARAM;
+	}
+
+	// Without sink converters write next to staged copies of sources
+	Stream->Staged = (FileSetSink(NULL, NULL, NULL) == false);
+	if (Stream->Staged == true)
+	{
+		snprintf(Dir, sizeof(Dir), "%s.stage", PakFile);
+		BuildSetDir(Stream->InDir, Dir);
+	}
+	else
+	{
+		strcpy(Stream->InDir, Stream->SrcDir);
+	}
+
+	// Files
+	DirIterInit(&Iter, Stream->SrcDir);
+	while ((FullName = DirIterGet(&Iter)) != NULL && Result == PS2HL_OK)
+	{
+		Name = FullName + strlen(Stream->SrcDir);
+		while (*Name == DIR_DELIM_CH)
+			Name++;
+
+		if (BuildIsSideFile(Stream->SrcDir, Name) == true)
+			continue;
+
+		if (Count == Size)
+		{
+			Size = Size ? Size * 2 : 64;
+			NewFiles = (sBuildStreamFile *)LibCalloc(Size, sizeof(sBuildStreamFile));
+			if (NewFiles == NULL)
+			{
+				Result = PS2HL_ERR_MEMORY;
+				break;
+			}
+			if (Files != NULL)
+				memcpy(NewFiles, Files, Count * sizeof(sBuildStreamFile));
+			LibFree(Files);
+			Files = NewFiles;
+		}
+		Files[Count].Stream = Stream;
+		Files[Count].Name = (char *)LibAlloc(strlen(Name) + 1);
+		if (Files[Count].Name == NULL)
+		{
+			Result = PS2HL_ERR_MEMORY;
+			break;
+		}
+		strcpy(Files[Count].Name, Name);
+		Count++;
+	}
+	DirIterClose(&Iter);
+
+	if (Result == PS2HL_OK && Count == 0)
+	{
+		LibMsg(MSG_ERROR, "Empty dir, nothing to pack: %s \n", Stream->SrcDir);
+		Result = PS2HL_ERR_PARAM;
+	}
+	if (Result == PS2HL_OK)
+		Result = pak::NewPAKImage(true, &Stream->Image);
+
+	// Entries are placed as conversions finish
+	if (Result == PS2HL_OK)
+	{
+		MutexInit(&Stream->Lock);
+		if (Threads > 1)
+			Stream->HasPool = PoolStart(&Stream->Pool, Threads);
+		for (int i = 0; i < Count; i++)
+			if (Stream->HasPool == false || PoolAdd(&Stream->Pool, BuildStreamTask, &Files[i]) == false)
+				BuildStreamTask(&Files[i]);
+		if (Stream->HasPool == true)
+			PoolStop(&Stream->Pool);
+		MutexDestroy(&Stream->Lock);
+		Result = Stream->Result;
+
+		if (Stream->Staged == true)
+			for (int i = 0; i < Count; i++)
+				BuildStreamUnstage(Stream, Files[i].Name);
+
+		LibMsg(MSG_INFO, "\nStream: %d files, failed: %d \n", Stream->Done, Stream->Failed);
+	}
+
+	// Order of entries shouldn't depend on timing of workers
+	if (Result == PS2HL_OK && pak::SortPAKImage(Stream->Image) == false)
+		Result = PS2HL_ERR_MEMORY;
+	if (Result == PS2HL_OK)
+	{
+		LibMsg(MSG_INFO, "Saving: %s \n", PakFile);
+		Result = pak::SavePAKImage(Stream->Image, PakFile);
+	}
+
+	for (int i = 0; i < Count; i++)
+		LibFree(Files[i].Name);
+	LibFree(Files);
+	pak::FreePAKImage(Stream->Image);
+	LibFree(Stream);
+
+	return Result;
+}
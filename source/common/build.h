@@ -0,0 +1,37 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef BUILD_H
+#define BUILD_H
+
+#include "types.h"
+
+// Incremental build of PS2 game files from mod sources:
+//	SRC/DIR/name.mdl	-> OUT/DIR/name.dol (name.inf is translated into it)
+//	SRC/DIR/name.spr	-> OUT/DIR/name.spz
+//	SRC/DIR/name.bmp	-> OUT/DIR/name (decal)
+//	SRC/DECALS/name.png	-> OUT/DECALS/name (decal)
+//	SRC/DIR/name.png	-> OUT/DIR/name.psi
+//	SRC/DIR/name.nod	-> OUT/DIR/name.nod (converted)
+//	SRC/DIR/anything	-> OUT/DIR/anything (copied)
+//	OUT/DIR/			-> OUT/DIR.PAK (compressed, GLOBAL -> GLOBAL.PAK + GRESTORE.PAK)
+// Files in root of SRC are copied as is. Stamps, content hashes and
+// outputs of every node are kept in OUT/.ps2hl-build, so next build
+// converts and packs only what has changed.
+
+#define BUILD_STATE ".ps2hl-build"	// State file name (in output dir)
+
+struct sBuild;
+
+int BuildRun(const char * SrcDir, const char * OutDir, int Threads);	// Bring OutDir up to date (Threads <= 1 - build in place), returns PS2HL_OK or error of first failed node
+
+// Build session (watch mode): graph, thread pool and PAK images stay in memory between updates
+sBuild * BuildOpen(const char * SrcDir, const char * OutDir, int Threads, bool Warm);	// Load state of previous build (NULL on error), Warm - patch PAKs instead of packing
+void BuildMarkChanged(sBuild * Build, const char * Name);							// Mark source as changed (name relative to SrcDir, NULL - anything could change)
+int BuildUpdate(sBuild * Build);													// Same as BuildRun(), first update checks every file, next ones - only marked files
+void BuildClose(sBuild * Build);													// Release session
+
+// Single pass PAK: converters write straight into PAK image (files of SrcDir become entries, nothing goes to disk)
+int BuildStreamPak(const char * SrcDir, const char * PakFile, int Threads);	// Convert and pack SrcDir into compressed PakFile (name of PAK selects rules, i.e. DECALS)
+
+#endif // BUILD_H
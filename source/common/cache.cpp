@@ -0,0 +1,841 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains content addressed conversion cache
+//
+// Layout of cache dir:
+//	index			- hash table of entries (mapped into memory)
+//	xx/<key>/		- entry: output files "0", "1", ... and "list"
+//	tmp/			- entries that are being stored
+//
+// "list" is a text file written last:
+//	PS2HL cache <format>
+//	D <hash or -> <name>	- side file read by job (- if it was missing)
+//	O <name>				- output file (stored as "0", "1", ... in order)
+// Names are relative to dir of input file, so entries can be reused
+// for a copy of the same file in another dir.
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "thpool.h"		// Goes first: sets up windows.h version
+
+#ifdef _WIN32
+	#include <windows.h>
+	#define getpid() (int)GetCurrentProcessId()
+#else
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <sys/file.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#include "ps2hl.h"
+#include "perf.h"
+#include "fops.h"
+#include "jobs.h"
+#include "hash.h"
+#include "cache.h"
+
+////////// Definitions //////////
+#define CACHE_MAGIC		"PS2HLCI1"		// Index file magic
+#define CACHE_FORMAT	1				// Bump when key or entry layout changes
+#define CACHE_SLOTS		0x10000			// Index capacity (power of 2)
+#define CACHE_MAX_COUNT	(CACHE_SLOTS / 4 * 3)	// Keep index at most 3/4 full (linear probing gets slow after that)
+#define CACHE_INDEX		"index"			// Index file name
+#define CACHE_LIST		"list"			// Entry list name
+#define CACHE_TMP		"tmp"			// Temp dir name
+
+typedef unsigned long long tCacheU64;
+
+////////// Structures //////////
+#pragma pack(1)
+// Index header (64 bytes)
+struct sCacheHeader
+{
+	char Magic[8];				// CACHE_MAGIC
+	uint Format;				// CACHE_FORMAT
+	uint Slots;					// CACHE_SLOTS
+	uint Count;					// Used slots
+	uint Reserved1;				//
+	tCacheU64 TotalSize;		// Size of all entries, bytes
+	tCacheU64 Clock;			// Logical time of last access (for LRU)
+	uchar Reserved2[24];		//
+};
+
+// Index slot (40 bytes)
+struct sCacheSlot
+{
+	uchar Key[HASH_SIZE];		// Entry key
+	tCacheU64 Size;				// Size of output files
+	tCacheU64 LastUse;			// Clock value at last store or hit
+	uint Used;					// 0 - empty slot
+	uint Reserved;				//
+};
+#pragma pack()
+
+// Index file (mapped)
+struct sCacheIndex
+{
+	sCacheHeader Header;
+	sCacheSlot Slots[CACHE_SLOTS];
+};
+
+// File accessed by job
+struct sCacheFile
+{
+	char * Name;				// Full name
+	int Access;					// FILE_HOOK_READ, FILE_HOOK_MISSING or FILE_HOOK_WRITE
+};
+
+// Files accessed by job (file hook context)
+struct sCacheRecord
+{
+	const char * InFile;		// Input file name
+	char InDir[PATH_LEN];		// Its dir (prefix of all names in entry)
+	sCacheFile * Files;			// Accessed files
+	int Count;					//
+	int Size;					// Allocated
+	bool Failed;				// Job result can't be cached
+	tFileHook PrevHook;			// Hook that was set before job (gets all events too)
+	void * PrevCtx;				//
+};
+
+////////// Globals //////////
+static bool CacheIsOpen = false;
+static char CacheDir[PATH_LEN];					// With trailing delimiter
+static tCacheU64 CacheMaxSize;					// Bytes
+static bool CacheHardLinks;						// Materialise hits with hard links
+static int CacheTmpCount = 0;					// Temp entry counter
+static tMutex CacheLock;						// Index lock between threads (file lock works between processes)
+static sCacheIndex * CacheIndex = NULL;			// Mapped index
+#ifdef _WIN32
+static HANDLE hCacheFile = INVALID_HANDLE_VALUE;
+static HANDLE hCacheMap = NULL;
+#else
+static int CacheFd = -1;
+#endif
+
+////////// Platform wrappers //////////
+#ifdef _WIN32
+
+static void CacheFileLock()
+{
+	OVERLAPPED Ov;
+
+	memset(&Ov, 0x00, sizeof(Ov));
+	LockFileEx(hCacheFile, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &Ov);
+}
+
+static void CacheFileUnlock()
+{
+	OVERLAPPED Ov;
+
+	memset(&Ov, 0x00, sizeof(Ov));
+	UnlockFileEx(hCacheFile, 0, 1, 0, &Ov);
+}
+
+static bool CacheMapIndex(const char * FileName)
+{
+	hCacheFile = CreateFileA(FileName, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hCacheFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Mapping extends file to full size (zero filled)
+	hCacheMap = CreateFileMappingA(hCacheFile, NULL, PAGE_READWRITE, 0, sizeof(sCacheIndex), NULL);
+	if (hCacheMap != NULL)
+		CacheIndex = (sCacheIndex *)MapViewOfFile(hCacheMap, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(sCacheIndex));
+
+	if (CacheIndex == NULL)
+	{
+		if (hCacheMap != NULL)
+			CloseHandle(hCacheMap);
+		CloseHandle(hCacheFile);
+		hCacheMap = NULL;
+		hCacheFile = INVALID_HANDLE_VALUE;
+		return false;
+	}
+
+	return true;
+}
+
+static void CacheUnmapIndex()
+{
+	UnmapViewOfFile(CacheIndex);
+	CloseHandle(hCacheMap);
+	CloseHandle(hCacheFile);
+	CacheIndex = NULL;
+	hCacheMap = NULL;
+	hCacheFile = INVALID_HANDLE_VALUE;
+}
+
+#else // linux
+
+static void CacheFileLock()
+{
+	flock(CacheFd, LOCK_EX);
+}
+
+static void CacheFileUnlock()
+{
+	flock(CacheFd, LOCK_UN);
+}
+
+static bool CacheMapIndex(const char * FileName)
+{
+	struct stat FileStat;
+	void * Map;
+
+	CacheFd = open(FileName, O_RDWR | O_CREAT, 0644);
+	if (CacheFd < 0)
+		return false;
+
+	// New file: extend to full size (sparse, zero filled)
+	if (fstat(CacheFd, &FileStat) != 0 ||
+		((size_t)FileStat.st_size < sizeof(sCacheIndex) && ftruncate(CacheFd, sizeof(sCacheIndex)) != 0))
+	{
+		close(CacheFd);
+		CacheFd = -1;
+		return false;
+	}
+
+	Map = mmap(NULL, sizeof(sCacheIndex), PROT_READ | PROT_WRITE, MAP_SHARED, CacheFd, 0);
+	if (Map == MAP_FAILED)
+	{
+		close(CacheFd);
+		CacheFd = -1;
+		return false;
+	}
+
+	CacheIndex = (sCacheIndex *)Map;
+	return true;
+}
+
+static void CacheUnmapIndex()
+{
+	munmap(CacheIndex, sizeof(sCacheIndex));
+	close(CacheFd);
+	CacheIndex = NULL;
+	CacheFd = -1;
+}
+
+#endif
+
+////////// Index //////////
+static void CacheLockIndex()
+{
+	MutexLock(&CacheLock);
+	CacheFileLock();
+}
+
+static void CacheUnlockIndex()
+{
+	CacheFileUnlock();
+	MutexUnlock(&CacheLock);
+}
+
+static uint CacheHome(const uchar * Key)
+{
+	return (Key[0] | (Key[1] << 8) | (Key[2] << 16)) & (CACHE_SLOTS - 1);
+}
+
+static int CacheFind(const uchar * Key)		// Caller holds lock, returns slot or -1
+{
+	uint Slot = CacheHome(Key);
+
+	while (CacheIndex->Slots[Slot].Used != 0)
+	{
+		if (!memcmp(CacheIndex->Slots[Slot].Key, Key, HASH_SIZE))
+			return Slot;
+		Slot = (Slot + 1) & (CACHE_SLOTS - 1);
+	}
+
+	return -1;
+}
+
+static void CacheRemoveSlot(uint Slot)		// Caller holds lock
+{
+	uint Next = Slot;
+	uint Home;
+
+	CacheIndex->Header.Count--;
+	CacheIndex->Header.TotalSize -= CacheIndex->Slots[Slot].Size;
+
+	// Backward shift deletion: move entries of the same probe chain into the hole
+	for (;;)
+	{
+		Next = (Next + 1) & (CACHE_SLOTS - 1);
+		if (CacheIndex->Slots[Next].Used == 0)
+			break;
+
+		// Entry can fill the hole only if hole is between its home and its slot
+		Home = CacheHome(CacheIndex->Slots[Next].Key);
+		if (((Next - Home) & (CACHE_SLOTS - 1)) < ((Next - Slot) & (CACHE_SLOTS - 1)))
+			continue;
+
+		CacheIndex->Slots[Slot] = CacheIndex->Slots[Next];
+		Slot = Next;
+	}
+
+	memset(&CacheIndex->Slots[Slot], 0x00, sizeof(sCacheSlot));
+}
+
+static void CacheInsert(const uchar * Key, tCacheU64 Size)	// Caller holds lock, key isn't in index
+{
+	uint Slot = CacheHome(Key);
+
+	while (CacheIndex->Slots[Slot].Used != 0)
+		Slot = (Slot + 1) & (CACHE_SLOTS - 1);
+
+	memcpy(CacheIndex->Slots[Slot].Key, Key, HASH_SIZE);
+	CacheIndex->Slots[Slot].Size = Size;
+	CacheIndex->Slots[Slot].LastUse = ++CacheIndex->Header.Clock;
+	CacheIndex->Slots[Slot].Used = 1;
+
+	CacheIndex->Header.Count++;
+	CacheIndex->Header.TotalSize += Size;
+}
+
+////////// Entries //////////
+static bool CacheEntryDir(const uchar * Key, char * Out)	// With trailing delimiter, false - path too long
+{
+	char Hex[HASH_HEX_LEN];
+
+	HashToHex(Key, Hex);
+	return snprintf(Out, PATH_LEN, "%s%.2s" DIR_DELIM "%s" DIR_DELIM, CacheDir, Hex, Hex) < PATH_LEN;
+}
+
+static void CacheDelEntryDir(const char * Dir)
+{
+	char Name[PATH_LEN];
+
+	// Outputs are numbered without gaps
+	for (int i = 0; ; i++)
+	{
+		if (snprintf(Name, sizeof(Name), "%s%d", Dir, i) >= (int)sizeof(Name) || remove(Name) != 0)
+			break;
+	}
+	if (snprintf(Name, sizeof(Name), "%s" CACHE_LIST, Dir) < (int)sizeof(Name))
+		remove(Name);
+	DelDir(Dir);
+}
+
+static int CacheCompareUse(const void * A, const void * B)
+{
+	tCacheU64 UseA = ((const sCacheSlot *)A)->LastUse;
+	tCacheU64 UseB = ((const sCacheSlot *)B)->LastUse;
+
+	return (UseA < UseB) ? -1 : (UseA > UseB);
+}
+
+static void CacheEvict()	// Caller holds lock
+{
+	sCacheHeader * Header = &CacheIndex->Header;
+	sCacheSlot * Slots;
+	char Dir[PATH_LEN];
+	tCacheU64 Size;
+	uint Count;
+	uint Used = 0;
+	int Slot;
+
+	if (Header->TotalSize <= CacheMaxSize && Header->Count <= CACHE_MAX_COUNT)
+		return;
+
+	// Sort entries by last use, evict oldest until cache is 90% of the limits
+	Slots = (sCacheSlot *)LibAlloc(sizeof(sCacheSlot) * Header->Count);
+	if (Slots == NULL)
+		return;
+	for (uint i = 0; i < CACHE_SLOTS && Used < Header->Count; i++)
+		if (CacheIndex->Slots[i].Used != 0)
+			Slots[Used++] = CacheIndex->Slots[i];
+	qsort(Slots, Used, sizeof(sCacheSlot), CacheCompareUse);
+
+	Size = Header->TotalSize;
+	Count = Used;
+	for (uint i = 0; i < Used && (Size > CacheMaxSize / 10 * 9 || Count > CACHE_MAX_COUNT / 10 * 9); i++)
+	{
+		Slot = CacheFind(Slots[i].Key);
+		if (Slot >= 0)
+			CacheRemoveSlot(Slot);
+		if (CacheEntryDir(Slots[i].Key, Dir) == true)
+			CacheDelEntryDir(Dir);
+
+		Size -= Slots[i].Size;
+		Count--;
+	}
+
+	LibMsg(MSG_DEBUG, "Cache: evicted %u entries \n", Used - Count);
+	LibFree(Slots);
+}
+
+////////// Record //////////
+static void CacheRecordInit(sCacheRecord * Rec, const char * FileName)
+{
+	Rec->InFile = FileName;
+	FileGetPath(FileName, Rec->InDir, sizeof(Rec->InDir));
+	Rec->Files = NULL;
+	Rec->Count = 0;
+	Rec->Size = 0;
+	Rec->Failed = false;
+	FileGetHook(&Rec->PrevHook, &Rec->PrevCtx);
+}
+
+static void CacheRecordFree(sCacheRecord * Rec)
+{
+	for (int i = 0; i < Rec->Count; i++)
+		LibFree(Rec->Files[i].Name);
+	LibFree(Rec->Files);
+	Rec->Files = NULL;
+	Rec->Count = Rec->Size = 0;
+}
+
+static sCacheFile * CacheRecordFind(sCacheRecord * Rec, const char * FileName)
+{
+	for (int i = 0; i < Rec->Count; i++)
+		if (!strcmp(Rec->Files[i].Name, FileName))
+			return &Rec->Files[i];
+
+	return NULL;
+}
+
+static void CacheRecordAdd(sCacheRecord * Rec, const char * FileName, int Access)
+{
+	size_t Len = strlen(FileName);
+	size_t DirLen = strlen(Rec->InDir);
+
+	// Only files in dir of input file (and below) can be part of entry
+	if (strncmp(FileName, Rec->InDir, DirLen) || strstr(&FileName[DirLen], "..") != NULL || strchr(&FileName[DirLen], ':') != NULL ||
+		FileName[DirLen] == DIR_DELIM_CH || FileName[DirLen] == DIR_NOT_DELIM_CH)
+	{
+		Rec->Failed = true;
+		return;
+	}
+
+	// Grow array
+	if (Rec->Count == Rec->Size)
+	{
+		int NewSize = Rec->Size ? Rec->Size * 2 : 16;
+		sCacheFile * NewFiles = (sCacheFile *)LibCalloc(NewSize, sizeof(sCacheFile));
+		if (NewFiles == NULL)
+		{
+			Rec->Failed = true;
+			return;
+		}
+		if (Rec->Files != NULL)
+			memcpy(NewFiles, Rec->Files, sizeof(sCacheFile) * Rec->Count);
+		LibFree(Rec->Files);
+		Rec->Files = NewFiles;
+		Rec->Size = NewSize;
+	}
+
+	Rec->Files[Rec->Count].Name = (char *)LibAlloc(Len + 1);
+	if (Rec->Files[Rec->Count].Name == NULL)
+	{
+		Rec->Failed = true;
+		return;
+	}
+	memcpy(Rec->Files[Rec->Count].Name, FileName, Len + 1);
+	Rec->Files[Rec->Count].Access = Access;
+	Rec->Count++;
+}
+
+static void CacheHook(void * Ctx, int Access, const char * FileName, const char * OldName)
+{
+	sCacheRecord * Rec = (sCacheRecord *)Ctx;
+	sCacheFile * File;
+
+	if (Rec->PrevHook != NULL)
+		Rec->PrevHook(Rec->PrevCtx, Access, FileName, OldName);
+
+	if (Rec->Failed == true)
+		return;
+
+	if (Access == FILE_HOOK_RENAME)
+	{
+		// Only own outputs may be renamed (temp file -> output)
+		File = CacheRecordFind(Rec, OldName);
+		if (File == NULL || File->Access != FILE_HOOK_WRITE || !strcmp(FileName, Rec->InFile))
+		{
+			Rec->Failed = true;
+			return;
+		}
+
+		if (CacheRecordFind(Rec, FileName) != NULL)
+		{
+			// Replaced other output: drop old name
+			File->Name[0] = '\0';
+			return;
+		}
+
+		size_t Len = strlen(FileName);
+		char * NewName = (char *)LibAlloc(Len + 1);
+		if (NewName == NULL)
+		{
+			Rec->Failed = true;
+			return;
+		}
+		memcpy(NewName, FileName, Len + 1);
+		LibFree(File->Name);
+		File->Name = NewName;
+		return;
+	}
+
+	// Input itself (modified in place - nothing to cache)
+	if (!strcmp(FileName, Rec->InFile))
+	{
+		if (Access == FILE_HOOK_WRITE)
+			Rec->Failed = true;
+		return;
+	}
+
+	File = CacheRecordFind(Rec, FileName);
+	if (File == NULL)
+		CacheRecordAdd(Rec, FileName, Access);
+	else if (Access == FILE_HOOK_WRITE && File->Access != FILE_HOOK_WRITE)
+		Rec->Failed = true;		// Side file modified
+}
+
+////////// Store and fetch //////////
+static bool CacheCheckList(FILE * ptrList, const char * InDir)	// Check header and side files
+{
+	char Line[PATH_LEN + 64];
+	char Name[PATH_LEN];
+	char * Sep;
+	uchar Hash[HASH_SIZE];
+	char Hex[HASH_HEX_LEN];
+	int Format;
+
+	if (fgets(Line, sizeof(Line), ptrList) == NULL || sscanf(Line, "PS2HL cache %d", &Format) != 1 || Format != CACHE_FORMAT)
+		return false;
+
+	while (fgets(Line, sizeof(Line), ptrList) != NULL)
+	{
+		Line[strcspn(Line, "\r\n")] = '\0';
+		if (Line[0] != 'D')
+			continue;
+
+		// "D <hash> <name>"
+		Sep = strchr(&Line[2], ' ');
+		if (Sep == NULL || snprintf(Name, sizeof(Name), "%s%s", InDir, &Sep[1]) >= (int)sizeof(Name))
+			return false;
+		*Sep = '\0';
+		if (HashFile(Name, Hash) == true)
+			HashToHex(Hash, Hex);
+		else
+			strcpy(Hex, "-");
+		if (strcmp(&Line[2], Hex))
+			return false;
+	}
+
+	return true;
+}
+
+static bool CacheFetch(const uchar * Key, const char * InDir)
+{
+	char Dir[PATH_LEN];
+	char Name[PATH_LEN];
+	char OutName[PATH_LEN];
+	char Line[PATH_LEN + 64];
+	FILE * ptrList;
+	bool Result = true;
+	int Slot;
+	int Count = 0;
+
+	CacheLockIndex();
+	Slot = CacheFind(Key);
+	if (Slot >= 0)
+		CacheIndex->Slots[Slot].LastUse = ++CacheIndex->Header.Clock;
+	CacheUnlockIndex();
+
+	if (Slot < 0)
+		return false;
+
+	// Entry may be evicted by other process right now, then job just runs as usual
+	if (CacheEntryDir(Key, Dir) == false || snprintf(Name, sizeof(Name), "%s" CACHE_LIST, Dir) >= (int)sizeof(Name))
+		return false;
+	ptrList = fopen(Name, "r");
+	if (ptrList == NULL)
+		return false;
+
+	if (CacheCheckList(ptrList, InDir) == false)
+	{
+		fclose(ptrList);
+		return false;
+	}
+
+	// Materialise outputs
+	rewind(ptrList);
+	while (fgets(Line, sizeof(Line), ptrList) != NULL)
+	{
+		Line[strcspn(Line, "\r\n")] = '\0';
+		if (Line[0] != 'O')
+			continue;
+
+		if (snprintf(OutName, sizeof(OutName), "%s%s", InDir, &Line[2]) >= (int)sizeof(OutName) ||
+			snprintf(Name, sizeof(Name), "%s%d", Dir, Count++) >= (int)sizeof(Name))
+		{
+			Result = false;
+			break;
+		}
+		GenerateFolders(OutName);
+		if (FileClone(Name, OutName, CacheHardLinks) == false)
+		{
+			Result = false;
+			break;
+		}
+		LibMsg(MSG_DEBUG, "Cache: %s \n", OutName);
+	}
+	fclose(ptrList);
+
+	return Result && Count > 0;
+}
+
+static void CacheStore(const uchar * Key, sCacheRecord * Rec)
+{
+	char TmpDir[PATH_LEN];
+	char Dir[PATH_LEN];
+	char Name[PATH_LEN];
+	char Hex[HASH_HEX_LEN];
+	uchar Hash[HASH_SIZE];
+	FILE * ptrList;
+	size_t DirLen = strlen(Rec->InDir);
+	tCacheU64 Size = 0;
+	bool Copied = true;
+	int Count = 0;
+	int Slot;
+
+	if (Rec->Failed == true)
+	{
+		LibMsg(MSG_DEBUG, "Cache: result of job isn't cacheable: %s \n", Rec->InFile);
+		return;
+	}
+
+	// Put entry together in temp dir
+	HashToHex(Key, Hex);
+	if (snprintf(TmpDir, sizeof(TmpDir), "%s" CACHE_TMP DIR_DELIM "%s.%d.%d" DIR_DELIM, CacheDir, Hex, getpid(), __atomic_add_fetch(&CacheTmpCount, 1, __ATOMIC_RELAXED)) >= (int)sizeof(TmpDir) ||
+		CacheEntryDir(Key, Dir) == false)
+	{
+		LibMsg(MSG_DEBUG, "Cache: path is too long: %s \n", CacheDir);
+		return;
+	}
+	NewDir(TmpDir);
+	if (snprintf(Name, sizeof(Name), "%s" CACHE_LIST, TmpDir) < (int)sizeof(Name))
+		ptrList = fopen(Name, "w");
+	else
+		ptrList = NULL;
+	if (ptrList == NULL)
+	{
+		DelDir(TmpDir);
+		return;
+	}
+	fprintf(ptrList, "PS2HL cache %d\n", CACHE_FORMAT);
+
+	for (int i = 0; i < Rec->Count; i++)
+	{
+		sCacheFile * File = &Rec->Files[i];
+
+		if (File->Name[0] == '\0')
+			continue;
+
+		if (File->Access == FILE_HOOK_WRITE)
+		{
+			// Temp files are gone by now
+			if (CheckDir(File->Name) == true || CheckFile(File->Name) == false)
+				continue;
+
+			// Never hard link here: outputs may be edited in place later
+			if (snprintf(Name, sizeof(Name), "%s%d", TmpDir, Count) >= (int)sizeof(Name) || FileClone(File->Name, Name, false) == false)
+			{
+				Copied = false;
+				break;
+			}
+
+			FILE * ptrFile = fopen(Name, "rb");
+			if (ptrFile != NULL)
+			{
+				Size += FileSize(&ptrFile);
+				fclose(ptrFile);
+			}
+			fprintf(ptrList, "O %s\n", &File->Name[DirLen]);
+			Count++;
+		}
+		else
+		{
+			if (HashFile(File->Name, Hash) == true)
+				HashToHex(Hash, Hex);
+			else
+				strcpy(Hex, "-");
+			fprintf(ptrList, "D %s %s\n", Hex, &File->Name[DirLen]);
+		}
+	}
+
+	// Jobs that produce nothing (tests, etc.) aren't cached
+	if (fclose(ptrList) != 0 || Count == 0 || Copied == false)
+	{
+		CacheDelEntryDir(TmpDir);
+		return;
+	}
+
+	// Publish entry (replaces old one with other side files)
+	CacheLockIndex();
+	Slot = CacheFind(Key);
+	if (Slot >= 0)
+		CacheRemoveSlot(Slot);
+	CacheDelEntryDir(Dir);
+	strcpy(Name, Dir);
+	GenerateFolders(Name);
+	Dir[strlen(Dir) - 1] = '\0';
+	TmpDir[strlen(TmpDir) - 1] = '\0';
+	if (rename(TmpDir, Dir) == 0)
+	{
+		CacheInsert(Key, Size);
+		CacheEvict();
+	}
+	else
+	{
+		strcat(TmpDir, DIR_DELIM);
+		CacheDelEntryDir(TmpDir);
+	}
+	CacheUnlockIndex();
+}
+
+////////// Functions //////////
+bool CacheOpen(const char * Dir, ulong MaxSizeMiB, bool HardLinks)
+{
+	sCacheHeader * Header;
+	char Name[PATH_LEN];
+	size_t Len = strlen(Dir);
+
+	if (CacheIsOpen == true || Len == 0 || Len + 40 >= PATH_LEN)
+		return false;
+
+	strcpy(CacheDir, Dir);
+	if (CacheDir[Len - 1] != DIR_DELIM_CH && CacheDir[Len - 1] != DIR_NOT_DELIM_CH)
+		strcat(CacheDir, DIR_DELIM);
+	CacheMaxSize = (tCacheU64)MaxSizeMiB * 1024 * 1024;
+	CacheHardLinks = HardLinks;
+
+	// Dirs
+	snprintf(Name, sizeof(Name), "%s" CACHE_TMP DIR_DELIM CACHE_INDEX, CacheDir);
+	GenerateFolders(Name);
+	if (CheckDir(CacheDir) == false)
+		return false;
+
+	// Index
+	snprintf(Name, sizeof(Name), "%s" CACHE_INDEX, CacheDir);
+	if (CacheMapIndex(Name) == false)
+		return false;
+	MutexInit(&CacheLock);
+
+	// New or incompatible index - start from scratch (old entries are replaced as they are stored again)
+	CacheLockIndex();
+	Header = &CacheIndex->Header;
+	if (memcmp(Header->Magic, CACHE_MAGIC, 8) || Header->Format != CACHE_FORMAT || Header->Slots != CACHE_SLOTS)
+	{
+		memset(CacheIndex, 0x00, sizeof(sCacheIndex));
+		memcpy(Header->Magic, CACHE_MAGIC, 8);
+		Header->Format = CACHE_FORMAT;
+		Header->Slots = CACHE_SLOTS;
+	}
+	CacheUnlockIndex();
+
+	CacheIsOpen = true;
+	return true;
+}
+
+void CacheClose()
+{
+	if (CacheIsOpen == false)
+		return;
+
+	CacheIsOpen = false;
+	CacheUnmapIndex();
+	MutexDestroy(&CacheLock);
+}
+
+bool CacheEnabled()
+{
+	return CacheIsOpen;
+}
+
+int CacheRunJob(const sJobTool * Tool, const char * Command, const char * FileName)
+{
+	sCacheRecord Rec;
+	sHash Hash;
+	uchar Data[HASH_SIZE];
+	uchar Key[HASH_SIZE];
+	char Name[PATH_LEN];
+	int Result;
+
+	// Dirs (pak pack) aren't cached
+	if (CacheIsOpen == false || CheckDir(FileName) == true || HashFile(FileName, Data) == false)
+		return Tool->Run(Command, FileName);
+
+	// Key: format, tool, command, tool version, file name (outputs are named after it), contents
+	FileGetName(FileName, Name, sizeof(Name), true);
+	HashInit(&Hash, CACHE_FORMAT);
+	HashStr(&Hash, Tool->Name);
+	HashStr(&Hash, JobIsAuto(Command) ? JOB_CMD_AUTO : Command);
+	HashStr(&Hash, Tool->Version());
+	HashStr(&Hash, Name);
+	HashUpdate(&Hash, Data, sizeof(Data));
+	HashFinal(&Hash, Key);
+
+	CacheRecordInit(&Rec, FileName);
+	if (CacheFetch(Key, Rec.InDir) == true)
+	{
+		LibMsg(MSG_INFO, "Cache hit: %s \n", FileName);
+		return PS2HL_OK;
+	}
+
+	// Miss: run job and watch what it reads and writes
+	FileSetHook(CacheHook, &Rec);
+	Result = Tool->Run(Command, FileName);
+	FileSetHook(NULL, NULL);
+
+	if (Result == PS2HL_OK)
+		CacheStore(Key, &Rec);
+	FileSetHook(Rec.PrevHook, Rec.PrevCtx);
+	CacheRecordFree(&Rec);
+
+	return Result;
+}
+
+int CacheParseArgs(int argc, char * argv[])
+{
+	const char * Dir = getenv(CACHE_ENV);
+	ulong MaxSize = CACHE_DEF_SIZE;
+	bool HardLinks = false;
+	int Out = 1;
+
+	// Strip options, keep the rest in order
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--cache") && i + 1 < argc)
+			Dir = argv[++i];
+		else if (!strcmp(argv[i], "--cache-size") && i + 1 < argc)
+			MaxSize = strtoul(argv[++i], NULL, 10);
+		else if (!strcmp(argv[i], "--cache-link"))
+			HardLinks = true;
+		else
+			argv[Out++] = argv[i];
+	}
+	argv[Out] = NULL;
+
+	if (Dir == NULL || Dir[0] == '\0')
+		return Out;
+
+	if (CacheOpen(Dir, MaxSize ? MaxSize : CACHE_DEF_SIZE, HardLinks) == false)
+	{
+		LibMsg(MSG_WARN, "Warning: can't open cache, working without it: %s \n", Dir);
+		return Out;
+	}
+	atexit(CacheClose);
+
+	return Out;
+}
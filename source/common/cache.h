@@ -0,0 +1,29 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "types.h"
+#include "jobs.h"
+
+// Conversion cache: results of jobs are stored in a directory, keyed by
+// hash of input file contents, input file name, tool, command and tool
+// version. Side files read by a job (i.e. *.INF of a model) are checked
+// on lookup too. Cache hits are materialised by reflink or copy (or hard
+// link with --cache-link) instead of running the tool again.
+// Index is a fixed size hash table mapped into memory, so opening the
+// cache costs the same no matter how many entries it has. Entries are
+// evicted in LRU order when cache gets bigger than the size limit.
+// Cache can be shared by several processes and threads.
+
+#define CACHE_DEF_SIZE	1024	// Default size limit, MiB
+#define CACHE_ENV		"PS2HL_CACHE"	// Environment variable with cache dir (used when there's no --cache)
+
+int CacheParseArgs(int argc, char * argv[]);		// Handle and remove --cache <dir>, --cache-size <MiB> and --cache-link, open cache, returns new argc
+bool CacheOpen(const char * Dir, ulong MaxSizeMiB, bool HardLinks);	// Open or create cache in Dir
+void CacheClose();									// Unmap index (registered with atexit() by CacheParseArgs())
+bool CacheEnabled();								// Check if cache is open
+int CacheRunJob(const sJobTool * Tool, const char * Command, const char * FileName);	// Fetch result from cache or run job and store result
+
+#endif // CACHE_H
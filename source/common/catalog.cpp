@@ -0,0 +1,1058 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains asset catalog: scan of game or mod tree into binary
+// columnar index and queries over it.
+//
+// Index file (DIR/.ps2hl-catalog), little endian:
+//	header					- sCatalogHeader
+//	tool names				- ToolCount x ulong (offsets in strings)
+//	columns					- ColumnCount x RowCount values (CatalogColumns order)
+//	strings					- names, '\0' terminated
+// Each file on disk is followed by rows of its PAK entries (their parent
+// column points to it), files are sorted by name.
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include "thpool.h"		// Goes first: sets up windows.h version
+#include "ps2hl.h"
+#include "fops.h"
+#include "jobs.h"
+#include "pakimg.h"
+#include "catalog.h"
+
+////////// Definitions //////////
+#ifdef _WIN32
+	#define CAT_U64 "%I64u"		// Old msvcrt doesn't know %llu
+#else
+	#define CAT_U64 "%llu"
+#endif
+
+#define CATALOG_FORMAT		1			// Bump when columns change
+#define CAT_NO_PARENT		0xFFFFFFFF	// Parent of file on disk
+#define CAT_MAX_FILTERS		32			// Filters per query
+
+#define CAT_COL_NAME		0			// Columns (same order as in CatalogColumns)
+#define CAT_COL_PARENT		1			//
+#define CAT_COL_TOOL		2			//
+#define CAT_COL_SIZE		3			//
+#define CAT_COL_TIME		4			//
+#define CAT_COL_WIDTH		5			//
+#define CAT_COL_HEIGHT		6			//
+#define CAT_COL_PALETTE		7			//
+#define CAT_COL_PS2			8			//
+#define CAT_COL_FRAMES		9			//
+#define CAT_COL_TEXTURES	10			//
+#define CAT_COL_SEQUENCES	11			//
+#define CAT_COL_RATE		12			//
+#define CAT_COL_CHANNELS	13			//
+#define CAT_COL_BITS		14			//
+#define CAT_COL_DIM			-1			// Virtual: max(width, height)
+#define CAT_COL_PAK			-2			// Virtual: name of parent PAK
+
+#define CAT_OP_EQ			0			// Filter operators
+#define CAT_OP_NE			1			//
+#define CAT_OP_LT			2			//
+#define CAT_OP_GT			3			//
+#define CAT_OP_LE			4			//
+#define CAT_OP_GE			5			//
+
+////////// Structures //////////
+
+// Row (file or PAK entry)
+struct sCatalogRow
+{
+	const char * Name;			// Relative name, '/' delimited (PAK entries - "DIR/NAME.PAK/entry")
+	ulong NameOffset;			// Name in strings of index (while saving)
+	ulong Parent;				// Row of PAK (CAT_NO_PARENT - file on disk)
+	uchar Tool;					// Tool index + 1 (0 - unknown file)
+	ulong Size;					// Bytes
+	unsigned long long Time;	// Modification time of file on disk (entries - 0)
+	sCatalogInfo Info;			// Properties
+};
+
+// Column of index
+struct sCatalogColumn
+{
+	const char * Name;			// Name in queries
+	size_t Offset;				// Field of sCatalogRow
+	size_t Width;				// Bytes per value
+};
+
+// File on disk and entries of its PAK
+struct sCatalogGroup
+{
+	sCatalogRow * Rows;			// File first
+	int Count;					//
+	int Size;					// Allocated
+	bool Owned;					// Names are allocated by this group (false - they belong to old index)
+};
+
+// Index file header
+#pragma pack(1)
+struct sCatalogHeader
+{
+	char Signature[4];			// "PHCI"
+	ulong Format;				// CATALOG_FORMAT
+	ulong RowCount;				//
+	ulong ColumnCount;			//
+	ulong ToolCount;			//
+	ulong StringSize;			// Bytes
+};
+#pragma pack()
+
+// Loaded index
+struct sCatalogIndex
+{
+	uchar * Data;				// Whole file
+	ulong RowCount;				//
+	ulong ToolCount;			//
+	const ulong * Tools;		// Offsets of tool names
+	const uchar * Columns[32];	// Values of each column
+	const char * Strings;		//
+	ulong StringSize;			//
+};
+
+// Scan session
+struct sCatalog
+{
+	char Dir[PATH_LEN];			// With trailing delimiter
+	sThreadPool Pool;			// Workers
+	bool HasPool;				// false - scan in place
+	sCatalogGroup * Groups;		// One per file on disk (sorted by name)
+	int Count;					//
+	tMutex Lock;				// Protects counters below
+	int Scanned;				// Counters
+	int Failed;					//
+};
+
+// File to describe
+struct sCatalogTask
+{
+	sCatalog * Catalog;
+	sCatalogGroup * Group;
+	char * FullName;
+};
+
+// Entry being described (memory lookup context)
+struct sCatalogEntry
+{
+	const char * FullName;		// Virtual name: PAK name + DIR_DELIM + entry name
+	const uchar * Data;			//
+	ulong Size;					//
+};
+
+// Query filter
+struct sCatalogFilter
+{
+	int Column;					// Index in CatalogColumns or CAT_COL_DIM/CAT_COL_PAK
+	int Op;						// CAT_OP_*
+	const char * Text;			// Pattern of text columns
+	unsigned long long Value;	// Value of numeric ones
+};
+
+////////// Globals //////////
+#define CAT_COLUMN(Name, Field) { Name, offsetof(sCatalogRow, Field), sizeof(((sCatalogRow *)0)->Field) }
+static const sCatalogColumn CatalogColumns[] =
+{
+	CAT_COLUMN("name",		NameOffset),
+	CAT_COLUMN("parent",	Parent),
+	CAT_COLUMN("tool",		Tool),
+	CAT_COLUMN("size",		Size),
+	CAT_COLUMN("time",		Time),
+	CAT_COLUMN("width",		Info.Width),
+	CAT_COLUMN("height",	Info.Height),
+	CAT_COLUMN("palette",	Info.Palette),
+	CAT_COLUMN("ps2",		Info.PS2),
+	CAT_COLUMN("frames",	Info.Frames),
+	CAT_COLUMN("textures",	Info.Textures),
+	CAT_COLUMN("sequences",	Info.Sequences),
+	CAT_COLUMN("rate",		Info.Rate),
+	CAT_COLUMN("channels",	Info.Channels),
+	CAT_COLUMN("bits",		Info.Bits)
+};
+#define CAT_COLUMN_COUNT (int)(sizeof(CatalogColumns) / sizeof(CatalogColumns[0]))
+
+static const char * CatalogPalettes[] = { "-", "indexed", "rgba" };
+
+////////// Rows //////////
+static void CatalogSlashes(char * Name)		// Same names on every platform
+{
+	for (; *Name != '\0'; Name++)
+		if (*Name == '\\')
+			*Name = '/';
+}
+
+static sCatalogRow * CatalogAddRow(sCatalogGroup * Group, const char * Name)
+{
+	sCatalogRow * NewRows;
+	char * NewName;
+
+	if (Group->Count == Group->Size)
+	{
+		NewRows = (sCatalogRow *)LibCalloc(Group->Size ? Group->Size * 2 : 4, sizeof(sCatalogRow));
+		if (NewRows == NULL)
+			return NULL;
+		if (Group->Rows != NULL)
+			memcpy(NewRows, Group->Rows, Group->Count * sizeof(sCatalogRow));
+		LibFree(Group->Rows);
+		Group->Rows = NewRows;
+		Group->Size = Group->Size ? Group->Size * 2 : 4;
+	}
+
+	NewName = (char *)LibAlloc(strlen(Name) + 1);
+	if (NewName == NULL)
+		return NULL;
+	strcpy(NewName, Name);
+	CatalogSlashes(NewName);
+
+	memset(&Group->Rows[Group->Count], 0x00, sizeof(sCatalogRow));
+	Group->Rows[Group->Count].Name = NewName;
+	Group->Rows[Group->Count].Parent = CAT_NO_PARENT;
+	return &Group->Rows[Group->Count++];
+}
+
+static void CatalogFreeGroup(sCatalogGroup * Group)
+{
+	if (Group->Owned == true)
+		for (int i = 0; i < Group->Count; i++)
+			LibFree((void *)Group->Rows[i].Name);
+	LibFree(Group->Rows);
+	memset(Group, 0x00, sizeof(sCatalogGroup));
+}
+
+static uchar CatalogToolCode(const sJobTool * Tool)
+{
+	for (int i = 0; Tool != NULL && JobGetTool(i) != NULL; i++)
+		if (JobGetTool(i) == Tool)
+			return i + 1;
+
+	return 0;
+}
+
+////////// Scan //////////
+static bool CatalogLookup(void * Ctx, const char * FileName, const void ** ptrData, size_t * ptrSize)
+{
+	sCatalogEntry * Entry = (sCatalogEntry *)Ctx;
+
+	if (strcmp(FileName, Entry->FullName))
+		return false;
+
+	*ptrData = Entry->Data;
+	*ptrSize = Entry->Size;
+	return true;
+}
+
+static void CatalogDescribe(sCatalogRow * Row, const char * FullName)
+{
+	const sJobTool * Tool;
+
+	Tool = JobSniffTool(FullName);
+	Row->Tool = CatalogToolCode(Tool);
+	if (Tool != NULL && Tool->Describe != NULL && Tool->Describe(FullName, &Row->Info) != PS2HL_OK)
+		memset(&Row->Info, 0x00, sizeof(sCatalogInfo));
+}
+
+static int CatalogDescribePak(sCatalogGroup * Group, const char * FullName)
+{
+	pak::sPAKImage * Image;
+	sCatalogEntry Entry;
+	sCatalogRow * Row;
+	char EntryFullName[PATH_LEN];
+	char Name[PATH_LEN];
+	size_t Prefix = strlen(FullName) + 1;
+	int Result;
+
+	Result = pak::LoadPAKImage(FullName, &Image);
+	if (Result != PS2HL_OK)
+		return Result;
+
+	for (int i = 0; i < pak::GetPAKEntryCount(Image); i++)
+	{
+		// Entries get names as if PAK was extracted in place
+		if (snprintf(EntryFullName, sizeof(EntryFullName), "%s" DIR_DELIM "%s", FullName, pak::GetPAKEntryName(Image, i)) >= (int)sizeof(EntryFullName) ||
+			snprintf(Name, sizeof(Name), "%s/%s", Group->Rows[0].Name, pak::GetPAKEntryName(Image, i)) >= (int)sizeof(Name))
+		{
+			Result = PS2HL_ERR_PARAM;
+			break;
+		}
+		if (strlen(EntryFullName) > Prefix)
+			PatchSlashes(&EntryFullName[Prefix], strlen(&EntryFullName[Prefix]), true);
+
+		Row = CatalogAddRow(Group, Name);
+		if (Row == NULL)
+		{
+			Result = PS2HL_ERR_MEMORY;
+			break;
+		}
+		Entry.FullName = EntryFullName;
+		Entry.Data = pak::GetPAKEntryData(Image, i, &Entry.Size);
+		Row->Size = Entry.Size;
+
+		FileSetMemory(CatalogLookup, &Entry);
+		CatalogDescribe(Row, EntryFullName);
+		FileSetMemory(NULL, NULL);
+	}
+	pak::FreePAKImage(Image);
+
+	return Result;
+}
+
+static void CatalogTask(void * Arg)
+{
+	sCatalogTask * Task = (sCatalogTask *)Arg;
+	sCatalog * Catalog = Task->Catalog;
+	sCatalogGroup * Group = Task->Group;
+	sCatalogRow * Row = &Group->Rows[0];
+	int Result = PS2HL_OK;
+
+	// Tools print what they find, catalog needs only values
+	LibMuteThread(true);
+	CatalogDescribe(Row, Task->FullName);
+	if (Row->Tool != 0 && !strcmp(JobGetTool(Row->Tool - 1)->Name, "pak"))
+	{
+		Row->Info.PS2 = 1;
+		Result = CatalogDescribePak(Group, Task->FullName);
+	}
+	LibMuteThread(false);
+
+	if (Result != PS2HL_OK)
+		LibMsg(MSG_WARN, "Warning: can't read PAK %s (%s) \n", Group->Rows[0].Name, LibStatusStr(Result));
+
+	MutexLock(&Catalog->Lock);
+	Catalog->Scanned++;
+	if (Result != PS2HL_OK)
+		Catalog->Failed++;
+	MutexUnlock(&Catalog->Lock);
+
+	LibFree(Task->FullName);
+	LibFree(Task);
+}
+
+static int CatalogCompareGroups(const void * A, const void * B)
+{
+	return strcmp(((const sCatalogGroup *)A)->Rows[0].Name, ((const sCatalogGroup *)B)->Rows[0].Name);
+}
+
+////////// Index file //////////
+static bool CatalogLoad(const char * FileName, sCatalogIndex * Index)
+{
+	FILE * ptrFile;
+	sCatalogHeader Header;
+	size_t Size;
+	size_t Pos;
+
+	memset(Index, 0x00, sizeof(sCatalogIndex));
+	ptrFile = FileProbe(FileName, "rb");
+	if (ptrFile == NULL)
+		return false;
+	Size = FileSize(&ptrFile);
+	memset(&Header, 0x00, sizeof(Header));
+	if (Size >= sizeof(Header))
+		FileReadBlock(&ptrFile, &Header, 0, sizeof(Header));
+	if (Size < sizeof(Header) || strncmp(Header.Signature, "PHCI", 4) || Header.Format != CATALOG_FORMAT || Header.ColumnCount != CAT_COLUMN_COUNT)
+	{
+		fclose(ptrFile);
+		return false;
+	}
+
+	Index->Data = (uchar *)LibAlloc(Size + 1);
+	if (Index->Data == NULL)
+	{
+		fclose(ptrFile);
+		return false;
+	}
+	FileReadBlock(&ptrFile, Index->Data, 0, Size);
+	Index->Data[Size] = '\0';	// Last string is always terminated
+	fclose(ptrFile);
+
+	// Every part must be inside of file
+	Pos = sizeof(Header);
+	Index->RowCount = Header.RowCount;
+	Index->ToolCount = Header.ToolCount;
+	Index->Tools = (const ulong *)&Index->Data[Pos];
+	Pos += Header.ToolCount * sizeof(ulong);
+	for (int i = 0; i < CAT_COLUMN_COUNT && Pos <= Size; i++)
+	{
+		Index->Columns[i] = &Index->Data[Pos];
+		if (Header.RowCount > (Size - Pos) / CatalogColumns[i].Width)
+			Pos = Size + 1;
+		else
+			Pos += Header.RowCount * CatalogColumns[i].Width;
+	}
+	if (Header.ToolCount > 255 || Pos > Size || Header.StringSize != Size - Pos)
+	{
+		LibFree(Index->Data);
+		memset(Index, 0x00, sizeof(sCatalogIndex));
+		return false;
+	}
+	Index->Strings = (const char *)&Index->Data[Pos];
+	Index->StringSize = Header.StringSize;
+
+	return true;
+}
+
+static unsigned long long CatalogGet(const sCatalogIndex * Index, int Column, ulong Row)
+{
+	unsigned long long Value = 0;
+
+	if (Column == CAT_COL_DIM)
+	{
+		Value = CatalogGet(Index, CAT_COL_WIDTH, Row);
+		return (Value > CatalogGet(Index, CAT_COL_HEIGHT, Row)) ? Value : CatalogGet(Index, CAT_COL_HEIGHT, Row);
+	}
+
+	memcpy(&Value, &Index->Columns[Column][Row * CatalogColumns[Column].Width], CatalogColumns[Column].Width);
+	return Value;
+}
+
+static const char * CatalogString(const sCatalogIndex * Index, unsigned long long Offset)
+{
+	return (Offset < Index->StringSize) ? &Index->Strings[Offset] : "";
+}
+
+static const char * CatalogText(const sCatalogIndex * Index, int Column, ulong Row)
+{
+	unsigned long long Value;
+
+	switch (Column)
+	{
+	case CAT_COL_NAME:
+		return CatalogString(Index, CatalogGet(Index, CAT_COL_NAME, Row));
+	case CAT_COL_TOOL:
+		Value = CatalogGet(Index, CAT_COL_TOOL, Row);
+		return (Value != 0 && Value <= Index->ToolCount) ? CatalogString(Index, Index->Tools[Value - 1]) : "-";
+	case CAT_COL_PAK:
+		Value = CatalogGet(Index, CAT_COL_PARENT, Row);
+		return (Value < Index->RowCount) ? CatalogText(Index, CAT_COL_NAME, Value) : "-";
+	case CAT_COL_PALETTE:
+		Value = CatalogGet(Index, CAT_COL_PALETTE, Row);
+		return (Value <= CAT_PAL_RGBA) ? CatalogPalettes[Value] : "?";
+	}
+
+	return NULL;	// Numeric column
+}
+
+static void CatalogLoadGroups(const sCatalogIndex * Index, sCatalogGroup ** ptrGroups, int * ptrCount)
+{
+	sCatalogGroup * Groups;
+	sCatalogGroup * Group = NULL;
+	sCatalogRow * Row;
+	uchar Tools[256];
+	int Count = 0;
+	ulong First = 0;
+
+	*ptrGroups = NULL;
+	*ptrCount = 0;
+	if (Index->RowCount == 0)
+		return;
+	Groups = (sCatalogGroup *)LibCalloc(Index->RowCount, sizeof(sCatalogGroup));
+	if (Groups == NULL)
+		return;
+
+	// Tools of old index could go in different order
+	memset(Tools, 0x00, sizeof(Tools));
+	for (ulong i = 0; i < Index->ToolCount; i++)
+		Tools[i + 1] = CatalogToolCode(JobFindTool(CatalogString(Index, Index->Tools[i])));
+
+	for (ulong i = 0; i < Index->RowCount; i++)
+	{
+		if (CatalogGet(Index, CAT_COL_PARENT, i) == CAT_NO_PARENT)
+		{
+			Group = &Groups[Count++];
+			Group->Owned = false;		// Names point to index
+			First = i;
+		}
+		else if (Group == NULL || CatalogGet(Index, CAT_COL_PARENT, i) != First)
+		{
+			continue;	// Broken index: entry without its PAK
+		}
+
+		Row = CatalogAddRow(Group, "");
+		if (Row == NULL)
+			break;
+		LibFree((void *)Row->Name);
+		Row->Name = CatalogText(Index, CAT_COL_NAME, i);
+		for (int c = 0; c < CAT_COLUMN_COUNT; c++)
+			if (c != CAT_COL_NAME && c != CAT_COL_PARENT)
+				memcpy((uchar *)Row + CatalogColumns[c].Offset, &Index->Columns[c][i * CatalogColumns[c].Width], CatalogColumns[c].Width);
+		Row->Tool = Tools[Row->Tool];
+		Row->Parent = CAT_NO_PARENT;
+	}
+
+	*ptrGroups = Groups;
+	*ptrCount = Count;
+}
+
+static bool CatalogSave(sCatalog * Catalog, const char * FileName)
+{
+	char TmpName[PATH_LEN];
+	sCatalogHeader Header;
+	sCatalogGroup * Group;
+	ulong Offset;
+	ulong Rows = 0;
+	ulong Row;
+	FILE * ptrFile;
+	bool Result;
+
+	// Row numbers and name offsets
+	Offset = 0;
+	for (int i = 0; JobGetTool(i) != NULL; i++)
+		Offset += strlen(JobGetTool(i)->Name) + 1;
+	for (int g = 0; g < Catalog->Count; g++)
+	{
+		Group = &Catalog->Groups[g];
+		for (int r = 0; r < Group->Count; r++)
+		{
+			Group->Rows[r].Parent = (r == 0) ? CAT_NO_PARENT : Rows;
+			Group->Rows[r].NameOffset = Offset;
+			Offset += strlen(Group->Rows[r].Name) + 1;
+		}
+		Rows += Group->Count;
+	}
+
+	memcpy(Header.Signature, "PHCI", 4);
+	Header.Format = CATALOG_FORMAT;
+	Header.RowCount = Rows;
+	Header.ColumnCount = CAT_COLUMN_COUNT;
+	Header.ToolCount = 0;
+	Header.StringSize = Offset;
+	while (JobGetTool(Header.ToolCount) != NULL)
+		Header.ToolCount++;
+
+	if (snprintf(TmpName, sizeof(TmpName), "%s.tmp", FileName) >= (int)sizeof(TmpName))
+		return false;
+	ptrFile = fopen(TmpName, "wb");
+	if (ptrFile == NULL)
+		return false;
+
+	fwrite(&Header, sizeof(Header), 1, ptrFile);
+	Offset = 0;
+	for (ulong i = 0; i < Header.ToolCount; i++)
+	{
+		fwrite(&Offset, sizeof(Offset), 1, ptrFile);
+		Offset += strlen(JobGetTool(i)->Name) + 1;
+	}
+
+	// Column by column
+	for (int c = 0; c < CAT_COLUMN_COUNT; c++)
+		for (int g = 0; g < Catalog->Count; g++)
+			for (int r = 0; r < Catalog->Groups[g].Count; r++)
+				fwrite((uchar *)&Catalog->Groups[g].Rows[r] + CatalogColumns[c].Offset, CatalogColumns[c].Width, 1, ptrFile);
+
+	for (ulong i = 0; i < Header.ToolCount; i++)
+		fwrite(JobGetTool(i)->Name, strlen(JobGetTool(i)->Name) + 1, 1, ptrFile);
+	for (int g = 0; g < Catalog->Count; g++)
+		for (Row = 0; Row < (ulong)Catalog->Groups[g].Count; Row++)
+			fwrite(Catalog->Groups[g].Rows[Row].Name, strlen(Catalog->Groups[g].Rows[Row].Name) + 1, 1, ptrFile);
+	Result = (ferror(ptrFile) == 0);
+	Result = (fclose(ptrFile) == 0) && Result;
+
+	// Replace old index
+	if (Result == true)
+	{
+		remove(FileName);
+		Result = rename(TmpName, FileName) == 0;
+	}
+	else
+	{
+		remove(TmpName);
+	}
+
+	return Result;
+}
+
+////////// Query //////////
+static bool CatalogMatch(const char * Pattern, const char * Text)	// '*' and '?' wildcards, case doesn't matter
+{
+	for (; *Pattern != '\0'; Pattern++, Text++)
+	{
+		if (*Pattern == '*')
+		{
+			for (; ; Text++)
+			{
+				if (CatalogMatch(Pattern + 1, Text) == true)
+					return true;
+				if (*Text == '\0')
+					return false;
+			}
+		}
+		if (*Text == '\0' || (*Pattern != '?' && tolower((uchar)*Pattern) != tolower((uchar)*Text)))
+			return false;
+	}
+
+	return *Text == '\0';
+}
+
+static int CatalogFindColumn(const char * Name, size_t Len)
+{
+	if (Len == 3 && !strncmp(Name, "dim", 3))
+		return CAT_COL_DIM;
+	if (Len == 3 && !strncmp(Name, "pak", 3))
+		return CAT_COL_PAK;
+	for (int i = 0; i < CAT_COLUMN_COUNT; i++)
+		if (strlen(CatalogColumns[i].Name) == Len && !strncmp(Name, CatalogColumns[i].Name, Len))
+			return i;
+
+	return CAT_COLUMN_COUNT;	// Not found
+}
+
+static bool CatalogIsText(int Column)
+{
+	return Column == CAT_COL_NAME || Column == CAT_COL_TOOL || Column == CAT_COL_PAK || Column == CAT_COL_PALETTE;
+}
+
+static bool CatalogParseFilter(const char * Arg, sCatalogFilter * Filter)
+{
+	static const char * Ops[] = { "!=", "<=", ">=", "=", "<", ">" };
+	static const int OpCodes[] = { CAT_OP_NE, CAT_OP_LE, CAT_OP_GE, CAT_OP_EQ, CAT_OP_LT, CAT_OP_GT };
+	size_t Len = strcspn(Arg, "!<>=");
+	char * End;
+
+	Filter->Column = CatalogFindColumn(Arg, Len);
+	if (Filter->Column == CAT_COLUMN_COUNT)
+		return false;
+
+	Filter->Op = -1;
+	for (int i = 0; i < 6 && Filter->Op == -1; i++)
+		if (!strncmp(&Arg[Len], Ops[i], strlen(Ops[i])))
+		{
+			Filter->Op = OpCodes[i];
+			Filter->Text = &Arg[Len + strlen(Ops[i])];
+		}
+	if (Filter->Op == -1)
+		return false;
+
+	// Text columns: only (not) equal to pattern
+	if (CatalogIsText(Filter->Column) == true)
+		return Filter->Op == CAT_OP_EQ || Filter->Op == CAT_OP_NE;
+
+	Filter->Value = strtoull(Filter->Text, &End, 0);
+	return End != Filter->Text && *End == '\0';
+}
+
+static bool CatalogFilterRow(const sCatalogIndex * Index, const sCatalogFilter * Filters, int Count, ulong Row)
+{
+	unsigned long long Value;
+	bool Match;
+
+	for (int i = 0; i < Count; i++)
+	{
+		if (CatalogIsText(Filters[i].Column) == true)
+		{
+			Match = CatalogMatch(Filters[i].Text, CatalogText(Index, Filters[i].Column, Row));
+			if (Match != (Filters[i].Op == CAT_OP_EQ))
+				return false;
+			continue;
+		}
+
+		Value = CatalogGet(Index, Filters[i].Column, Row);
+		switch (Filters[i].Op)
+		{
+		case CAT_OP_EQ: Match = Value == Filters[i].Value; break;
+		case CAT_OP_NE: Match = Value != Filters[i].Value; break;
+		case CAT_OP_LT: Match = Value < Filters[i].Value; break;
+		case CAT_OP_GT: Match = Value > Filters[i].Value; break;
+		case CAT_OP_LE: Match = Value <= Filters[i].Value; break;
+		default:		Match = Value >= Filters[i].Value; break;
+		}
+		if (Match == false)
+			return false;
+	}
+
+	return true;
+}
+
+// Sort context (qsort() has no argument for it)
+static __thread const sCatalogIndex * SortIndex;
+static __thread int SortColumn;
+
+static int CatalogCompareRows(const void * A, const void * B)
+{
+	ulong RowA = *(const ulong *)A;
+	ulong RowB = *(const ulong *)B;
+	unsigned long long ValueA, ValueB;
+	int Result;
+
+	if (CatalogIsText(SortColumn) == true)
+	{
+		Result = strcmp(CatalogText(SortIndex, SortColumn, RowA), CatalogText(SortIndex, SortColumn, RowB));
+		if (Result != 0)
+			return Result;
+	}
+	else
+	{
+		// Numbers: biggest first
+		ValueA = CatalogGet(SortIndex, SortColumn, RowA);
+		ValueB = CatalogGet(SortIndex, SortColumn, RowB);
+		if (ValueA != ValueB)
+			return (ValueA > ValueB) ? -1 : 1;
+	}
+
+	return (RowA < RowB) ? -1 : (RowA > RowB);
+}
+
+static void CatalogPrintRow(const sCatalogIndex * Index, ulong Row)
+{
+	char Dims[48] = "-";
+	char Audio[64] = "-";
+
+	if (CatalogGet(Index, CAT_COL_WIDTH, Row) != 0)
+		snprintf(Dims, sizeof(Dims), CAT_U64 "x" CAT_U64, CatalogGet(Index, CAT_COL_WIDTH, Row), CatalogGet(Index, CAT_COL_HEIGHT, Row));
+	if (CatalogGet(Index, CAT_COL_RATE, Row) != 0)
+		snprintf(Audio, sizeof(Audio), CAT_U64 "/" CAT_U64 "/" CAT_U64, CatalogGet(Index, CAT_COL_RATE, Row),
+			CatalogGet(Index, CAT_COL_CHANNELS, Row), CatalogGet(Index, CAT_COL_BITS, Row));
+
+	LibMsg(MSG_INFO, "%-4s %-3s %10lu %-9s %-7s %4u %4u %4u %-13s %s \n",
+		CatalogText(Index, CAT_COL_TOOL, Row),
+		CatalogGet(Index, CAT_COL_PS2, Row) ? "ps2" : "pc",
+		(unsigned long)CatalogGet(Index, CAT_COL_SIZE, Row),
+		Dims,
+		CatalogText(Index, CAT_COL_PALETTE, Row),
+		(uint)CatalogGet(Index, CAT_COL_FRAMES, Row),
+		(uint)CatalogGet(Index, CAT_COL_TEXTURES, Row),
+		(uint)CatalogGet(Index, CAT_COL_SEQUENCES, Row),
+		Audio,
+		CatalogText(Index, CAT_COL_NAME, Row));
+}
+
+static bool CatalogSameKey(const sCatalogIndex * Index, int Column, ulong RowA, ulong RowB)
+{
+	if (CatalogIsText(Column) == true)
+		return !strcmp(CatalogText(Index, Column, RowA), CatalogText(Index, Column, RowB));
+
+	return CatalogGet(Index, Column, RowA) == CatalogGet(Index, Column, RowB);
+}
+
+static void CatalogPrintGroups(const sCatalogIndex * Index, const ulong * Rows, ulong Count, const char * ColumnName, int Column)
+{
+	unsigned long long Bytes = 0;
+	ulong Items = 0;
+	char Key[32];
+	char Total[32];
+	const char * Text;
+
+	// Rows are sorted by column, so each group goes in one run
+	LibMsg(MSG_INFO, "%-24s %8s %14s \n", ColumnName, "count", "bytes");
+	for (ulong i = 0; i < Count; i++)
+	{
+		Items++;
+		Bytes += CatalogGet(Index, CAT_COL_SIZE, Rows[i]);
+		if (i + 1 < Count && CatalogSameKey(Index, Column, Rows[i], Rows[i + 1]) == true)
+			continue;
+
+		Text = CatalogText(Index, Column, Rows[i]);
+		if (Text == NULL)
+		{
+			snprintf(Key, sizeof(Key), CAT_U64, CatalogGet(Index, Column, Rows[i]));
+			Text = Key;
+		}
+		snprintf(Total, sizeof(Total), CAT_U64, Bytes);
+		LibMsg(MSG_INFO, "%-24s %8lu %14s \n", Text, (unsigned long)Items, Total);
+		Items = 0;
+		Bytes = 0;
+	}
+}
+
+////////// Functions //////////
+int CatalogBuild(const char * Dir, const char * IndexFile, int Threads)
+{
+	sCatalog * Catalog;
+	sCatalogIndex Index;
+	sCatalogGroup * Old;
+	sCatalogGroup * Found;
+	sCatalogGroup Key;
+	sCatalogRow KeyRow;
+	sCatalogTask * Task;
+	sCatalogRow * Row;
+	sFileStamp Stamp;
+	sDirIter Iter;
+	char IndexName[PATH_LEN];
+	char TmpName[PATH_LEN];
+	char * FullNames = NULL;
+	const char * FullName;
+	size_t Len = strlen(Dir);
+	size_t NamesSize = 0;
+	size_t NamesUsed = 0;
+	int OldCount;
+	int NameLen;
+	int Size = 0;
+	int Reused = 0;
+	int Entries = 0;
+	int Result = PS2HL_OK;
+
+	Catalog = (sCatalog *)LibCalloc(1, sizeof(sCatalog));
+	if (Catalog == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	if (CheckDir(Dir) == false || Len == 0 || Len + 2 >= PATH_LEN)
+	{
+		LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+		LibFree(Catalog);
+		return PS2HL_ERR_PARAM;
+	}
+	strcpy(Catalog->Dir, Dir);
+	if (Catalog->Dir[Len - 1] != DIR_DELIM_CH && Catalog->Dir[Len - 1] != DIR_NOT_DELIM_CH)
+		strcat(Catalog->Dir, DIR_DELIM);
+	if (IndexFile == NULL)
+		NameLen = snprintf(IndexName, sizeof(IndexName), "%s" CATALOG_INDEX, Catalog->Dir);
+	else
+		NameLen = snprintf(IndexName, sizeof(IndexName), "%s", IndexFile);
+	if (NameLen >= (int)sizeof(IndexName) || snprintf(TmpName, sizeof(TmpName), "%s.tmp", IndexName) >= (int)sizeof(TmpName))
+	{
+		LibMsg(MSG_ERROR, "Index path is too long ...\n");
+		LibFree(Catalog);
+		return PS2HL_ERR_PARAM;
+	}
+
+	// Rows of files that haven't changed are taken from previous index
+	CatalogLoad(IndexName, &Index);
+	CatalogLoadGroups(&Index, &Old, &OldCount);
+
+	// Names first: files are described in order of names, so index is the same for any -j
+	DirIterInit(&Iter, Catalog->Dir);
+	while ((FullName = DirIterGet(&Iter)) != NULL)
+	{
+		if (!strcmp(FullName, IndexName) || !strcmp(FullName, TmpName))
+			continue;
+
+		if (Catalog->Count == Size)
+		{
+			sCatalogGroup * NewGroups = (sCatalogGroup *)LibCalloc(Size ? Size * 2 : 256, sizeof(sCatalogGroup));
+			if (NewGroups == NULL)
+			{
+				Result = PS2HL_ERR_MEMORY;
+				break;
+			}
+			if (Catalog->Groups != NULL)
+				memcpy(NewGroups, Catalog->Groups, Catalog->Count * sizeof(sCatalogGroup));
+			LibFree(Catalog->Groups);
+			Catalog->Groups = NewGroups;
+			Size = Size ? Size * 2 : 256;
+		}
+
+		Catalog->Groups[Catalog->Count].Owned = true;
+		FullName += strlen(Catalog->Dir);
+		while (*FullName == DIR_DELIM_CH)
+			FullName++;
+		if (CatalogAddRow(&Catalog->Groups[Catalog->Count], FullName) == NULL)
+		{
+			Result = PS2HL_ERR_MEMORY;
+			break;
+		}
+		Catalog->Count++;
+	}
+	DirIterClose(&Iter);
+	if (Catalog->Count != 0)
+		qsort(Catalog->Groups, Catalog->Count, sizeof(sCatalogGroup), CatalogCompareGroups);
+
+	MutexInit(&Catalog->Lock);
+	if (Threads > 1 && Result == PS2HL_OK)
+		Catalog->HasPool = PoolStart(&Catalog->Pool, Threads);
+
+	for (int i = 0; i < Catalog->Count && Result == PS2HL_OK; i++)
+	{
+		Row = &Catalog->Groups[i].Rows[0];
+		NamesUsed = strlen(Catalog->Dir) + strlen(Row->Name) + 1;
+		if (NamesUsed > NamesSize)
+		{
+			LibFree(FullNames);
+			NamesSize = NamesUsed + PATH_LEN;
+			FullNames = (char *)LibAlloc(NamesSize);
+			if (FullNames == NULL)
+			{
+				Result = PS2HL_ERR_MEMORY;
+				break;
+			}
+		}
+		snprintf(FullNames, NamesSize, "%s%s", Catalog->Dir, Row->Name);
+		PatchSlashes(&FullNames[strlen(Catalog->Dir)], strlen(Row->Name), true);
+		if (FileGetStamp(FullNames, &Stamp) == false)
+			continue;
+		Row->Size = (ulong)Stamp.Size;
+		Row->Time = Stamp.Time;
+
+		// Unchanged file - same rows as before
+		Key.Rows = &KeyRow;
+		KeyRow.Name = Row->Name;
+		Found = (OldCount != 0) ? (sCatalogGroup *)bsearch(&Key, Old, OldCount, sizeof(sCatalogGroup), CatalogCompareGroups) : NULL;
+		if (Found != NULL && Found->Rows[0].Size == Row->Size && Found->Rows[0].Time == Row->Time)
+		{
+			Row = (sCatalogRow *)LibAlloc(Found->Count * sizeof(sCatalogRow));
+			if (Row == NULL)
+			{
+				Result = PS2HL_ERR_MEMORY;
+				break;
+			}
+			memcpy(Row, Found->Rows, Found->Count * sizeof(sCatalogRow));
+			CatalogFreeGroup(&Catalog->Groups[i]);
+			Catalog->Groups[i].Rows = Row;
+			Catalog->Groups[i].Count = Found->Count;
+			Catalog->Groups[i].Size = Found->Count;
+			Catalog->Groups[i].Owned = false;		// Names stay in old index
+			Reused++;
+			continue;
+		}
+
+		Task = (sCatalogTask *)LibCalloc(1, sizeof(sCatalogTask));
+		if (Task != NULL)
+			Task->FullName = (char *)LibAlloc(strlen(FullNames) + 1);
+		if (Task == NULL || Task->FullName == NULL)
+		{
+			LibFree(Task);
+			Result = PS2HL_ERR_MEMORY;
+			break;
+		}
+		strcpy(Task->FullName, FullNames);
+		Task->Catalog = Catalog;
+		Task->Group = &Catalog->Groups[i];
+
+		if (Catalog->HasPool == false || PoolAdd(&Catalog->Pool, CatalogTask, Task) == false)
+			CatalogTask(Task);
+	}
+	LibFree(FullNames);
+
+	if (Catalog->HasPool == true)
+		PoolStop(&Catalog->Pool);
+	MutexDestroy(&Catalog->Lock);
+
+	if (Result == PS2HL_OK)
+	{
+		if (IndexFile == NULL)
+			snprintf(IndexName, sizeof(IndexName), "%s" CATALOG_INDEX, Catalog->Dir);
+		if (CatalogSave(Catalog, IndexName) == false)
+		{
+			LibMsg(MSG_ERROR, "Error: can't write index %s \n", IndexName);
+			Result = PS2HL_ERR_OPEN;
+		}
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+	}
+
+	for (int i = 0; i < Catalog->Count; i++)
+		Entries += Catalog->Groups[i].Count - 1;
+	LibMsg(MSG_INFO, "\nCatalog: %d files (scanned: %d, unchanged: %d), %d PAK entries, unreadable PAKs: %d \n",
+		Catalog->Count, Catalog->Scanned, Reused, Entries, Catalog->Failed);
+
+	for (int i = 0; i < OldCount; i++)
+		CatalogFreeGroup(&Old[i]);
+	LibFree(Old);
+	LibFree(Index.Data);
+	for (int i = 0; i < Catalog->Count; i++)
+		CatalogFreeGroup(&Catalog->Groups[i]);
+	LibFree(Catalog->Groups);
+	LibFree(Catalog);
+	return Result;
+}
+
+int CatalogQuery(const char * IndexFile, int ArgCount, char ** Args)
+{
+	sCatalogIndex Index;
+	sCatalogFilter Filters[CAT_MAX_FILTERS];
+	char IndexName[PATH_LEN];
+	int NameLen;
+	int FilterCount = 0;
+	int Group = CAT_COLUMN_COUNT;
+	const char * GroupName = NULL;
+	int Sort = CAT_COLUMN_COUNT;
+	bool CountOnly = false;
+	ulong * Rows;
+	ulong Count = 0;
+	unsigned long long Bytes = 0;
+
+	// Dir - its default index
+	if (CheckDir(IndexFile) == true)
+		NameLen = snprintf(IndexName, sizeof(IndexName), "%s" DIR_DELIM CATALOG_INDEX, IndexFile);
+	else
+		NameLen = snprintf(IndexName, sizeof(IndexName), "%s", IndexFile);
+	if (NameLen >= (int)sizeof(IndexName))
+	{
+		LibMsg(MSG_ERROR, "Index path is too long ...\n");
+		return PS2HL_ERR_PARAM;
+	}
+
+	for (int i = 0; i < ArgCount; i++)
+	{
+		if (!strcmp(Args[i], "--count"))
+		{
+			CountOnly = true;
+		}
+		else if ((!strcmp(Args[i], "--group") || !strcmp(Args[i], "--sort")) && i + 1 < ArgCount)
+		{
+			if (!strcmp(Args[i], "--group"))
+			{
+				Group = CatalogFindColumn(Args[i + 1], strlen(Args[i + 1]));
+				GroupName = Args[i + 1];
+			}
+			else
+				Sort = CatalogFindColumn(Args[i + 1], strlen(Args[i + 1]));
+			if (CatalogFindColumn(Args[i + 1], strlen(Args[i + 1])) == CAT_COLUMN_COUNT)
+			{
+				LibMsg(MSG_ERROR, "Unknown column: %s \n", Args[i + 1]);
+				return PS2HL_ERR_PARAM;
+			}
+			i++;
+		}
+		else if (FilterCount == CAT_MAX_FILTERS || CatalogParseFilter(Args[i], &Filters[FilterCount]) == false)
+		{
+			LibMsg(MSG_ERROR, "Bad filter: %s (should be [column][=|!=|<|>|<=|>=][value]) \n", Args[i]);
+			return PS2HL_ERR_PARAM;
+		}
+		else
+		{
+			FilterCount++;
+		}
+	}
+
+	if (CatalogLoad(IndexName, &Index) == false)
+	{
+		LibMsg(MSG_ERROR, "Error: can't read index %s (run \"ps2hl catalog\" first) \n", IndexName);
+		return PS2HL_ERR_FORMAT;
+	}
+	Rows = (ulong *)LibAlloc(sizeof(ulong) * (Index.RowCount + 1));
+	if (Rows == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		LibFree(Index.Data);
+		return PS2HL_ERR_MEMORY;
+	}
+
+	for (ulong i = 0; i < Index.RowCount; i++)
+	{
+		if (CatalogFilterRow(&Index, Filters, FilterCount, i) == false)
+			continue;
+		Rows[Count++] = i;
+		Bytes += CatalogGet(&Index, CAT_COL_SIZE, i);
+	}
+
+	SortIndex = &Index;
+	SortColumn = (Group != CAT_COLUMN_COUNT) ? Group : Sort;
+	if (SortColumn != CAT_COLUMN_COUNT && Count != 0)
+		qsort(Rows, Count, sizeof(ulong), CatalogCompareRows);
+
+	if (Group != CAT_COLUMN_COUNT)
+	{
+		CatalogPrintGroups(&Index, Rows, Count, GroupName, Group);
+	}
+	else if (CountOnly == false)
+	{
+		LibMsg(MSG_INFO, "%-4s %-3s %10s %-9s %-7s %4s %4s %4s %-13s %s \n", "tool", "fmt", "size", "dims", "palette", "frm", "tex", "seq", "rate/ch/bits", "name");
+		for (ulong i = 0; i < Count; i++)
+			CatalogPrintRow(&Index, Rows[i]);
+	}
+	LibMsg(MSG_INFO, "Rows: %lu, bytes: " CAT_U64 " \n", (unsigned long)Count, Bytes);
+
+	LibFree(Rows);
+	LibFree(Index.Data);
+	return PS2HL_OK;
+}
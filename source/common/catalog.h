@@ -0,0 +1,40 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "types.h"
+
+// Asset catalog of game or mod tree: one row per file and per entry of
+// every PAK with type, size, location and properties (DescribeFile() of
+// each tool, see jobs.h). Rows are kept in binary index file column by
+// column, so queries read only columns they need. Files are described on
+// thread pool, files with the same size and time as in previous index
+// (PAKs - with all their entries) are taken from it without reading.
+
+#define CATALOG_INDEX	".ps2hl-catalog"	// Default index name (in scanned dir)
+
+#define CAT_PAL_NONE	0		// Palette types
+#define CAT_PAL_INDEXED	1		//
+#define CAT_PAL_RGBA	2		//
+
+// Properties of file (zero - unknown or doesn't apply)
+struct sCatalogInfo
+{
+	ushort Width;				// Image size (models - biggest texture, sprites - biggest frame)
+	ushort Height;				//
+	uchar Palette;				// CAT_PAL_*
+	uchar PS2;					// 1 - PS2 format, 0 - PC one
+	ushort Frames;				// Sprite frames, decal MIPs
+	ushort Textures;			// Model textures
+	ushort Sequences;			// Model sequences
+	ulong Rate;					// Audio sampling frequency
+	uchar Channels;				//
+	uchar Bits;					// Bits per sample
+};
+
+int CatalogBuild(const char * Dir, const char * IndexFile, int Threads);		// Scan Dir and update index (IndexFile NULL - Dir/CATALOG_INDEX), returns PS2HL_OK or error
+int CatalogQuery(const char * IndexFile, int ArgCount, char ** Args);		// Print rows that match filters (IndexFile may be dir), returns PS2HL_OK or error
+
+#endif // CATALOG_H
@@ -0,0 +1,352 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains CRC-32 and Adler-32 routines: zlib versions as
+// reference and fallback, PCLMULQDQ and SSSE3/AVX2 versions picked at runtime
+//
+// CRC-32 folds 64 bytes per step with carry-less multiplication and reduces
+// the rest with Barrett reduction ("Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction", Intel). Adler-32 sums 32 byte
+// blocks: s1 with psadbw, s2 with pmaddubsw by weights 32..1, up to NMAX
+// bytes between modulo reductions (as zlib does).
+//
+// SIMD code is built with function target attributes, same as PNG filter
+// kernels (see pngfilt.cpp), older compilers only get zlib code.
+//
+
+////////// Includes //////////
+#include <string.h>
+#include "types.h"
+#include "zlib.h"
+#include "checksum.h"
+
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+	#define CHECKSUM_SIMD_X86
+	#include <cpuid.h>
+	#include <immintrin.h>
+	#define CHECKSUM_TARGET(ISA) __attribute__((target(ISA)))
+#endif
+
+////////// Definitions //////////
+#define ADLER_BASE			65521		// Largest prime below 65536
+#define ADLER_NMAX			5552		// Most bytes before s2 can overflow 32 bits
+#define ADLER_BLOCK			32			// Bytes per SIMD step
+#define CRC_SIMD_MIN		64			// Shorter data goes to zlib
+#define ADLER_SIMD_MIN		64			//
+
+////////// Globals //////////
+static volatile int ChecksumLevel = -1;		// Forced level (-1 - best supported)
+
+static const char * ChecksumNames[CHECKSUM_COUNT] = { "scalar", "sse", "avx2" };
+
+////////// Reference //////////
+ulong ChecksumCRC32Scalar(ulong CRC, const void * Data, ulong Size)
+{
+	return crc32(CRC, (const Bytef *)Data, Size);
+}
+
+ulong ChecksumAdler32Scalar(ulong Adler, const void * Data, ulong Size)
+{
+	return adler32(Adler, (const Bytef *)Data, Size);
+}
+
+#ifdef CHECKSUM_SIMD_X86
+////////// CRC-32 //////////
+static CHECKSUM_TARGET("pclmul,sse4.1") uint ChecksumCRC32Fold(const uchar * Data, ulong Size, uint CRC)	// Size - multiple of 16, at least 64; CRC is not inverted here
+{
+	// Constants of reflected CRC-32 polynomial: x^(4*128+64), x^(4*128) mod P, then same
+	// for 128 bit folds, x^64 mod P, and P with its Barrett constant
+	static const unsigned long long K1K2[2] __attribute__((aligned(16))) = { 0x0154442BD4ULL, 0x01C6E41596ULL };
+	static const unsigned long long K3K4[2] __attribute__((aligned(16))) = { 0x01751997D0ULL, 0x00CCAA009EULL };
+	static const unsigned long long K5K0[2] __attribute__((aligned(16))) = { 0x0163CD6124ULL, 0x0000000000ULL };
+	static const unsigned long long Poly[2] __attribute__((aligned(16))) = { 0x01DB710641ULL, 0x01F7011641ULL };
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+	// Four 128 bit accumulators
+	x1 = _mm_loadu_si128((const __m128i *)(Data + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *)(Data + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(Data + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(Data + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(CRC));
+	x0 = _mm_load_si128((const __m128i *)K1K2);
+	Data += 64;
+	Size -= 64;
+
+	// Fold 64 bytes at a time
+	while (Size >= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(Data + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(Data + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(Data + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(Data + 0x30)));
+		Data += 64;
+		Size -= 64;
+	}
+
+	// Fold accumulators into one
+	x0 = _mm_load_si128((const __m128i *)K3K4);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	// Rest of 16 byte blocks
+	while (Size >= 16)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)Data)), x5);
+		Data += 16;
+		Size -= 16;
+	}
+
+	// 128 -> 64 bits
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x0 = _mm_loadl_epi64((const __m128i *)K5K0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	x0 = _mm_load_si128((const __m128i *)Poly);
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return (uint)_mm_extract_epi32(x1, 1);
+}
+
+////////// Adler-32 //////////
+static CHECKSUM_TARGET("ssse3") ulong ChecksumAdler32SSSE3(ulong Adler, const uchar * Data, ulong Size)
+{
+	const __m128i Tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+	const __m128i Tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i Ones = _mm_set1_epi16(1);
+	uint s1 = Adler & 0xFFFF;
+	uint s2 = (Adler >> 16) & 0xFFFF;
+	ulong Blocks = Size / ADLER_BLOCK;
+	uint n;
+
+	Size -= Blocks * ADLER_BLOCK;
+	while (Blocks > 0)
+	{
+		n = ADLER_NMAX / ADLER_BLOCK;
+		if (n > Blocks)
+			n = Blocks;
+		Blocks -= n;
+
+		// s1 of each block is added to s2 32 times: Prev collects s1 before every block
+		__m128i Prev = _mm_cvtsi32_si128(s1 * n);
+		__m128i S1 = _mm_setzero_si128();
+		__m128i S2 = _mm_cvtsi32_si128(s2);
+		do
+		{
+			const __m128i Bytes1 = _mm_loadu_si128((const __m128i *)Data);
+			const __m128i Bytes2 = _mm_loadu_si128((const __m128i *)(Data + 16));
+
+			Prev = _mm_add_epi32(Prev, S1);
+			S1 = _mm_add_epi32(S1, _mm_sad_epu8(Bytes1, Zero));
+			S2 = _mm_add_epi32(S2, _mm_madd_epi16(_mm_maddubs_epi16(Bytes1, Tap1), Ones));
+			S1 = _mm_add_epi32(S1, _mm_sad_epu8(Bytes2, Zero));
+			S2 = _mm_add_epi32(S2, _mm_madd_epi16(_mm_maddubs_epi16(Bytes2, Tap2), Ones));
+			Data += ADLER_BLOCK;
+		} while (--n);
+		S2 = _mm_add_epi32(S2, _mm_slli_epi32(Prev, 5));
+
+		// Horizontal sums (s1 is in two 64 bit halves, s2 - in four 32 bit lanes)
+		S1 = _mm_add_epi32(S1, _mm_shuffle_epi32(S1, _MM_SHUFFLE(1, 0, 3, 2)));
+		S2 = _mm_add_epi32(S2, _mm_shuffle_epi32(S2, _MM_SHUFFLE(2, 3, 0, 1)));
+		S2 = _mm_add_epi32(S2, _mm_shuffle_epi32(S2, _MM_SHUFFLE(1, 0, 3, 2)));
+		s1 = (s1 + (uint)_mm_cvtsi128_si32(S1)) % ADLER_BASE;
+		s2 = (uint)_mm_cvtsi128_si32(S2) % ADLER_BASE;
+	}
+
+	return ChecksumAdler32Scalar((s2 << 16) | s1, Data, Size);		// Tail
+}
+
+static CHECKSUM_TARGET("avx2") ulong ChecksumAdler32AVX2(ulong Adler, const uchar * Data, ulong Size)
+{
+	const __m256i Tap = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+		16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	const __m256i Zero = _mm256_setzero_si256();
+	const __m256i Ones = _mm256_set1_epi16(1);
+	uint s1 = Adler & 0xFFFF;
+	uint s2 = (Adler >> 16) & 0xFFFF;
+	ulong Blocks = Size / ADLER_BLOCK;
+	uint n;
+
+	Size -= Blocks * ADLER_BLOCK;
+	while (Blocks > 0)
+	{
+		n = ADLER_NMAX / ADLER_BLOCK;
+		if (n > Blocks)
+			n = Blocks;
+		Blocks -= n;
+
+		__m256i Prev = _mm256_setzero_si256();
+		__m256i S1 = _mm256_setzero_si256();
+		__m256i S2 = _mm256_setzero_si256();
+		uint First = s1 * n;
+		do
+		{
+			const __m256i Bytes = _mm256_loadu_si256((const __m256i *)Data);
+
+			Prev = _mm256_add_epi32(Prev, S1);
+			S1 = _mm256_add_epi32(S1, _mm256_sad_epu8(Bytes, Zero));
+			S2 = _mm256_add_epi32(S2, _mm256_madd_epi16(_mm256_maddubs_epi16(Bytes, Tap), Ones));
+			Data += ADLER_BLOCK;
+		} while (--n);
+		S2 = _mm256_add_epi32(S2, _mm256_slli_epi32(Prev, 5));
+
+		// Horizontal sums of both 128 bit halves
+		__m128i H1 = _mm_add_epi32(_mm256_castsi256_si128(S1), _mm256_extracti128_si256(S1, 1));
+		__m128i H2 = _mm_add_epi32(_mm256_castsi256_si128(S2), _mm256_extracti128_si256(S2, 1));
+		H1 = _mm_add_epi32(H1, _mm_shuffle_epi32(H1, _MM_SHUFFLE(1, 0, 3, 2)));
+		H2 = _mm_add_epi32(H2, _mm_shuffle_epi32(H2, _MM_SHUFFLE(2, 3, 0, 1)));
+		H2 = _mm_add_epi32(H2, _mm_shuffle_epi32(H2, _MM_SHUFFLE(1, 0, 3, 2)));
+		s2 = (s2 + First * ADLER_BLOCK + (uint)_mm_cvtsi128_si32(H2)) % ADLER_BASE;
+		s1 = (s1 + (uint)_mm_cvtsi128_si32(H1)) % ADLER_BASE;
+	}
+
+	return ChecksumAdler32Scalar((s2 << 16) | s1, Data, Size);		// Tail
+}
+
+////////// Detection //////////
+static uint ChecksumXGetBV()	// OS support of extended registers
+{
+	uint Eax, Edx;
+
+	__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(Eax), "=d"(Edx) : "c"(0));	// xgetbv (old assemblers don't know it)
+	return Eax;
+}
+#endif // CHECKSUM_SIMD_X86
+
+static int ChecksumDetect(bool * PCLMUL)
+{
+	*PCLMUL = false;
+#ifdef CHECKSUM_SIMD_X86
+	uint Eax, Ebx, Ecx, Edx;
+	int Level = CHECKSUM_SCALAR;
+
+	if (__get_cpuid(1, &Eax, &Ebx, &Ecx, &Edx) == 0)
+		return Level;
+
+	if ((Edx & bit_SSE2) && (Ecx & bit_SSSE3))
+		Level = CHECKSUM_SSE;
+	*PCLMUL = (Level == CHECKSUM_SSE && (Ecx & bit_PCLMUL) && (Ecx & bit_SSE4_1));
+
+	// AVX2 needs CPU support and OS that saves YMM registers
+	if (Level == CHECKSUM_SSE && (Ecx & bit_OSXSAVE) && (Ecx & bit_AVX) && (ChecksumXGetBV() & 0x06) == 0x06 && __get_cpuid_max(0, NULL) >= 7)
+	{
+		__cpuid_count(7, 0, Eax, Ebx, Ecx, Edx);
+		if (Ebx & bit_AVX2)
+			Level = CHECKSUM_AVX2;
+	}
+
+	return Level;
+#else
+	return CHECKSUM_SCALAR;
+#endif
+}
+
+static int ChecksumDetectPCLMUL()
+{
+	bool PCLMUL;
+
+	ChecksumDetect(&PCLMUL);
+	return PCLMUL;
+}
+
+////////// Dispatch //////////
+int ChecksumGetSupport()
+{
+	bool PCLMUL;
+	static const int Support = ChecksumDetect(&PCLMUL);		// Once, thread safe
+
+	return Support;
+}
+
+int ChecksumGetLevel()
+{
+	int Level = ChecksumLevel;
+
+	return (Level >= 0) ? Level : ChecksumGetSupport();
+}
+
+int ChecksumSetLevel(int Level)
+{
+	if (Level < CHECKSUM_SCALAR)
+		Level = CHECKSUM_SCALAR;
+	if (Level > ChecksumGetSupport())
+		Level = ChecksumGetSupport();
+
+	ChecksumLevel = Level;
+	return Level;
+}
+
+const char * ChecksumName(int Level)
+{
+	if (Level < 0 || Level >= CHECKSUM_COUNT)
+		return "unknown";
+
+	return ChecksumNames[Level];
+}
+
+ulong ChecksumCRC32(ulong CRC, const void * Data, ulong Size)
+{
+#ifdef CHECKSUM_SIMD_X86
+	static const bool PCLMUL = ChecksumDetectPCLMUL();
+	ulong Folded;
+
+	// Whole 16 byte blocks are folded, the rest goes to zlib
+	if (Size >= CRC_SIMD_MIN && PCLMUL == true && ChecksumGetLevel() != CHECKSUM_SCALAR)
+	{
+		Folded = Size & ~15UL;
+		CRC = ~ChecksumCRC32Fold((const uchar *)Data, Folded, ~(uint)CRC) & 0xFFFFFFFFUL;
+		Data = (const uchar *)Data + Folded;
+		Size -= Folded;
+	}
+#endif
+
+	return (Size != 0) ? ChecksumCRC32Scalar(CRC, Data, Size) : CRC;
+}
+
+ulong ChecksumAdler32(ulong Adler, const void * Data, ulong Size)
+{
+	if (Size >= ADLER_SIMD_MIN)
+	{
+		switch (ChecksumGetLevel())
+		{
+#ifdef CHECKSUM_SIMD_X86
+		case CHECKSUM_AVX2:
+			return ChecksumAdler32AVX2(Adler, (const uchar *)Data, Size);
+		case CHECKSUM_SSE:
+			return ChecksumAdler32SSSE3(Adler, (const uchar *)Data, Size);
+#endif
+		default:
+			break;
+		}
+	}
+
+	return ChecksumAdler32Scalar(Adler, Data, Size);
+}
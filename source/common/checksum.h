@@ -0,0 +1,31 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "types.h"
+
+// CRC-32 (PNG chunks, PAKs) and Adler-32 (zlib streams), same results as
+// crc32() and adler32() of zlib. CRC-32 is folded with PCLMULQDQ, Adler-32
+// is summed with SSSE3 or AVX2, picked at first use by cpuid; other CPUs
+// and short blocks go to zlib, which is also kept as reference.
+
+#define CHECKSUM_SCALAR		0		// zlib
+#define CHECKSUM_SSE		1		// PCLMULQDQ + SSE4.1 CRC-32, SSSE3 Adler-32
+#define CHECKSUM_AVX2		2		// Same CRC-32, AVX2 Adler-32
+#define CHECKSUM_COUNT		3
+
+#define CHECKSUM_CRC32_INIT		0	// Start values
+#define CHECKSUM_ADLER32_INIT	1	//
+
+ulong ChecksumCRC32(ulong CRC, const void * Data, ulong Size);			// Update CRC-32 with Data
+ulong ChecksumAdler32(ulong Adler, const void * Data, ulong Size);		// Update Adler-32 with Data
+ulong ChecksumCRC32Scalar(ulong CRC, const void * Data, ulong Size);	// Reference versions
+ulong ChecksumAdler32Scalar(ulong Adler, const void * Data, ulong Size);	//
+int ChecksumGetLevel();							// Level in use (CHECKSUM_*)
+int ChecksumGetSupport();						// Best level CPU supports
+int ChecksumSetLevel(int Level);				// Use given level (capped to supported one), returns level in use
+const char * ChecksumName(int Level);			// "scalar", "sse", "avx2"
+
+#endif // CHECKSUM_H
@@ -0,0 +1,610 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains synthetic corpus generator: PC files are written by
+// generators of tools and converted to PS2 formats by the same tools on
+// thread pool, then PS2 files are packed into PAKs and filler PAKs with
+// random entries are added.
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "thpool.h"		// Goes first: sets up windows.h version
+#include "ps2hl.h"
+#include "fops.h"
+#include "jobs.h"
+#include "pakimg.h"
+#include "catalog.h"
+#include "corpus.h"
+
+////////// Definitions //////////
+#define CORPUS_DIR_PC	"pc"		// Subdirs of output dir
+#define CORPUS_DIR_PS2	"ps2"		//
+#define CORPUS_DIR_PAK	"pak"		//
+
+#define CORPUS_DATA		-1			// Kind of filler PAKs (for seeds)
+
+// Parameters (same order as in CorpusParams)
+enum eCorpusParam
+{
+	CP_SEED, CP_MODELS, CP_TEXTURES, CP_SEQUENCES, CP_SPRITES, CP_FRAMES, CP_DECALS, CP_IMAGES,
+	CP_SOUNDS, CP_LENGTH, CP_GRAPHS, CP_NODES, CP_MAXDIM, CP_PAKS, CP_CPAKS, CP_ENTRIES,
+	CP_MINSIZE, CP_MAXSIZE, CP_DIST, CP_COUNT
+};
+
+////////// Structures //////////
+
+// Parameter ("key=value")
+struct sCorpusParam
+{
+	const char * Name;
+	int Default;
+	int Min;
+	int Max;
+	const char * Choices;		// Space separated names of values (NULL - number)
+};
+
+// Kind of generated files
+struct sCorpusKind
+{
+	const char * Dir;			// Dir in pc/, ps2/ and name of PAK
+	const char * Name;			// File name prefix
+	const char * Tool;			// Tool that makes and converts files
+	const char * Ext;			// PC extension
+	const char * PS2Ext;		// Extension of converted file (NULL - converted in place, "" - none)
+	int Param;					// Parameter with count
+};
+
+// Generator session
+struct sCorpus
+{
+	char Dir[PATH_LEN];			// With trailing delimiter
+	int Params[CP_COUNT];		// Values of parameters
+	int Counts[16];				// Files of each kind
+	sThreadPool Pool;			// Workers
+	bool HasPool;				// false - generate in place
+	tMutex Lock;				// Protects everything below
+	int Result;					// First error
+	int Files;					// Counters
+	int Paks;					//
+	int Entries;				//
+};
+
+// File or filler PAK to make
+struct sCorpusTask
+{
+	sCorpus * Corpus;
+	int Kind;					// Index in CorpusKinds (CORPUS_DATA - filler PAK)
+	int Index;					// Number of file of this kind
+};
+
+////////// Globals //////////
+static const sCorpusParam CorpusParams[CP_COUNT] =
+{
+	{ "seed",		1,		0,		0x7FFFFFFF,	NULL },
+	{ "models",		16,		0,		4096,		NULL },
+	{ "textures",	4,		1,		64,			NULL },			// Per model (at most)
+	{ "sequences",	16,		0,		512,		NULL },			//
+	{ "sprites",	16,		0,		4096,		NULL },
+	{ "frames",		8,		1,		255,		NULL },			// Per sprite (at most)
+	{ "decals",		16,		0,		4096,		NULL },
+	{ "images",		32,		0,		4096,		NULL },			// Half indexed, half RGBA
+	{ "sounds",		16,		0,		4096,		NULL },			// Half WAV, half VAG
+	{ "length",		4000,	100,	600000,		NULL },			// Sound length, ms (at most)
+	{ "graphs",		4,		0,		1024,		NULL },
+	{ "nodes",		256,	1,		4096,		NULL },			// Per graph (at most)
+	{ "maxdim",		256,	8,		2048,		NULL },			// Image size (at most)
+	{ "paks",		2,		0,		100,		NULL },			// Filler PAKs: normal
+	{ "cpaks",		2,		0,		100,		NULL },			//              compressed
+	{ "entries",	128,	1,		16384,		NULL },			// Per filler PAK
+	{ "minsize",	64,		1,		0x1000000,	NULL },			// Filler entry size
+	{ "maxsize",	262144,	1,		0x1000000,	NULL },			//
+	{ "dist",		1,		0,		1,			"uniform log" }	// Filler entry size distribution
+};
+
+static const sCorpusKind CorpusKinds[] =
+{
+	{ "MODELS",		"model",	"mdl",	".mdl",	".dol",	CP_MODELS },
+	{ "SPRITES",	"sprite",	"spr",	".spr",	".spz",	CP_SPRITES },
+	{ "DECALS",		"decal",	"phd",	".bmp",	"",		CP_DECALS },
+	{ "TEXTURES",	"image",	"psi",	".png",	".psi",	CP_IMAGES },
+	{ "SOUND",		"sound",	"mus",	".wav",	NULL,	CP_SOUNDS },
+	{ "SOUND",		"music",	"mus",	".vag",	NULL,	CP_SOUNDS },
+	{ "MAPS",		"graph",	"nod",	".nod",	NULL,	CP_GRAPHS }
+};
+#define CORPUS_KIND_COUNT (int)(sizeof(CorpusKinds) / sizeof(CorpusKinds[0]))
+
+static const ulong CorpusRates[] = { 11025, 22050, 44100 };
+
+////////// Random numbers //////////
+static uint CorpusMix(uint Value)	// Murmur3 finalizer
+{
+	Value ^= Value >> 16;
+	Value *= 0x85EBCA6B;
+	Value ^= Value >> 13;
+	Value *= 0xC2B2AE35;
+	Value ^= Value >> 16;
+	return Value;
+}
+
+static void CorpusSeed(sCorpusSpec * Spec, int Seed, int Kind, int Index)
+{
+	memset(Spec, 0x00, sizeof(sCorpusSpec));
+	Spec->Rng = CorpusMix(CorpusMix(CorpusMix((uint)Seed) ^ (uint)Kind * 0x9E3779B9) + (uint)Index);
+	if (Spec->Rng == 0)
+		Spec->Rng = 1;
+}
+
+uint CorpusRandom(sCorpusSpec * Spec)	// xorshift32
+{
+	uint Value = Spec->Rng;
+
+	Value ^= Value << 13;
+	Value ^= Value >> 17;
+	Value ^= Value << 5;
+	Spec->Rng = Value;
+
+	return Value;
+}
+
+uint CorpusRange(sCorpusSpec * Spec, uint Min, uint Max)
+{
+	if (Max <= Min)
+		return Min;
+
+	return Min + CorpusRandom(Spec) % (Max - Min + 1);
+}
+
+ushort CorpusDim(sCorpusSpec * Spec, ushort Max, bool Resized)
+{
+	uint Levels = 0;
+	uint Dim;
+
+	// Every power of two is equally likely
+	while ((16u << Levels) <= Max)
+		Levels++;
+	Dim = 8 << CorpusRange(Spec, 0, Levels);
+
+	// Sizes that tools have to resize (multiple of 4, so BMP rows need no padding)
+	if (Resized == true && Dim >= 16 && CorpusRange(Spec, 0, 3) == 0)
+		Dim = Dim * 3 / 4;
+
+	return Dim;
+}
+
+void CorpusFill(sCorpusSpec * Spec, uchar * Data, ulong Size, uint Levels)
+{
+	ulong Pos = 0;
+	uint Value;
+	uint Run;
+	int Step;
+
+	if (Levels == 0 || Levels > 256)
+		Levels = 256;
+
+	// Runs of slowly changing values with random jumps: compresses about as well as real textures
+	Value = CorpusRange(Spec, 0, Levels - 1);
+	while (Pos < Size)
+	{
+		Run = CorpusRange(Spec, 1, 32);
+		Step = (int)CorpusRange(Spec, 0, 4) - 2;
+		for (uint i = 0; i < Run && Pos < Size; i++)
+		{
+			Data[Pos++] = Value % Levels;
+			Value += Step;
+		}
+		if (CorpusRange(Spec, 0, 7) == 0)
+			Value = CorpusRange(Spec, 0, Levels - 1);
+	}
+}
+
+////////// Generation //////////
+static const char * CorpusChoice(const char * Choices, int Index, size_t * ptrLen)	// Index-th name in list (NULL - there is no such name)
+{
+	while (Index-- > 0 && Choices != NULL)
+		if ((Choices = strchr(Choices, ' ')) != NULL)
+			Choices++;
+
+	if (Choices != NULL)
+		*ptrLen = strcspn(Choices, " ");
+	return Choices;
+}
+
+static int CorpusCount(sCorpus * Corpus, int Kind)	// Sounds are split between WAV and VAG
+{
+	const sCorpusKind * Info = &CorpusKinds[Kind];
+	int Count = Corpus->Params[Info->Param];
+
+	if (!strcmp(Info->Ext, ".wav"))
+		return Count - Count / 2;
+	if (!strcmp(Info->Ext, ".vag"))
+		return Count / 2;
+
+	return Count;
+}
+
+static void CorpusSetup(sCorpus * Corpus, int Kind, int Index, sCorpusSpec * Spec)
+{
+	const int * Params = Corpus->Params;
+	const char * Tool = CorpusKinds[Kind].Tool;
+	// PSI are converted as is, odd sizes only for sources that tools resize
+	bool Resized = strcmp(Tool, "psi") != 0;
+	ulong Length;
+
+	CorpusSeed(Spec, Params[CP_SEED], Kind, Index);
+	Spec->Width = CorpusDim(Spec, Params[CP_MAXDIM], Resized);
+	Spec->Height = CorpusDim(Spec, Params[CP_MAXDIM], Resized);
+
+	if (!strcmp(Tool, "mdl"))
+	{
+		Spec->Count = CorpusRange(Spec, 1, Params[CP_TEXTURES]);
+		Spec->Sequences = CorpusRange(Spec, Params[CP_SEQUENCES] ? 1 : 0, Params[CP_SEQUENCES]);
+	}
+	else if (!strcmp(Tool, "spr"))
+	{
+		Spec->Count = CorpusRange(Spec, 1, Params[CP_FRAMES]);
+	}
+	else if (!strcmp(Tool, "psi"))
+	{
+		Spec->Palette = (Index % 2) ? CAT_PAL_RGBA : CAT_PAL_INDEXED;
+	}
+	else if (!strcmp(Tool, "mus"))
+	{
+		// PS2 HL plays VAG at 44100 only
+		Spec->Rate = !strcmp(CorpusKinds[Kind].Ext, ".vag") ? 44100 : CorpusRates[CorpusRange(Spec, 0, 2)];
+		Length = CorpusRange(Spec, Params[CP_LENGTH] / 4, Params[CP_LENGTH]);
+		Spec->Samples = Spec->Rate / 100 * Length / 10;
+	}
+	else if (!strcmp(Tool, "nod"))
+	{
+		Spec->Count = CorpusRange(Spec, Params[CP_NODES] / 4 + 1, Params[CP_NODES]);
+	}
+}
+
+static bool CorpusName(sCorpus * Corpus, char * Buffer, size_t Size, const char * Sub, int Kind, int Index, const char * Ext)	// false - doesn't fit
+{
+	const sCorpusKind * Info = &CorpusKinds[Kind];
+
+	return snprintf(Buffer, Size, "%s%s" DIR_DELIM "%s" DIR_DELIM "%s%04d%s", Corpus->Dir, Sub, Info->Dir, Info->Name, Index, Ext) < (int)Size;
+}
+
+static void CorpusDone(sCorpus * Corpus, int Result, int Files, int Paks, int Entries)
+{
+	MutexLock(&Corpus->Lock);
+	if (Corpus->Result == PS2HL_OK)
+		Corpus->Result = Result;
+	Corpus->Files += Files;
+	Corpus->Paks += Paks;
+	Corpus->Entries += Entries;
+	MutexUnlock(&Corpus->Lock);
+}
+
+static int CorpusMakeFile(sCorpus * Corpus, int Kind, int Index)
+{
+	const sCorpusKind * Info = &CorpusKinds[Kind];
+	const sJobTool * Tool = JobFindTool(Info->Tool);
+	sCorpusSpec Spec;
+	char PCName[PATH_LEN];
+	char PS2Name[PATH_LEN];
+	int Result;
+
+	if (Tool == NULL || Tool->Generate == NULL ||
+		CorpusName(Corpus, PCName, sizeof(PCName), CORPUS_DIR_PC, Kind, Index, Info->Ext) == false ||
+		CorpusName(Corpus, PS2Name, sizeof(PS2Name), CORPUS_DIR_PS2, Kind, Index, Info->Ext) == false)
+		return PS2HL_ERR_PARAM;
+	CorpusSetup(Corpus, Kind, Index, &Spec);
+
+	Result = Tool->Generate(PCName, &Spec);
+	if (Result != PS2HL_OK)
+		return Result;
+
+	// PS2 file is made by the tool itself from copy of PC one
+	if (FileClone(PCName, PS2Name, false) == false)
+		return PS2HL_ERR_OPEN;
+	Result = Tool->Run(JOB_CMD_AUTO, PS2Name);
+	if (Info->PS2Ext != NULL)
+		remove(PS2Name);
+
+	return Result;
+}
+
+static int CorpusMakePak(sCorpus * Corpus, int Index)
+{
+	const int * Params = Corpus->Params;
+	pak::sPAKImage * Image;
+	sCorpusSpec Spec;
+	char Name[PATH_LEN];
+	uchar * Data;
+	ulong Size;
+	uint MinBits = 0;
+	uint MaxBits = 0;
+	uint Bits;
+	uint Low, High;
+	int Result;
+
+	Data = (uchar *)LibAlloc(Params[CP_MAXSIZE]);
+	if (Data == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	Result = pak::NewPAKImage(Index >= Params[CP_PAKS], &Image);
+	if (Result != PS2HL_OK)
+	{
+		LibFree(Data);
+		return Result;
+	}
+
+	while ((1u << (MinBits + 1)) <= (uint)Params[CP_MINSIZE])
+		MinBits++;
+	while ((1u << (MaxBits + 1)) <= (uint)Params[CP_MAXSIZE])
+		MaxBits++;
+
+	CorpusSeed(&Spec, Params[CP_SEED], CORPUS_DATA, Index);
+	for (int i = 0; i < Params[CP_ENTRIES] && Result == PS2HL_OK; i++)
+	{
+		// Log distribution: size class first, then size inside of it (many small entries, few big ones)
+		if (Params[CP_DIST] == 1)
+		{
+			Bits = CorpusRange(&Spec, MinBits, MaxBits);
+			Low = (1u << Bits > (uint)Params[CP_MINSIZE]) ? 1u << Bits : Params[CP_MINSIZE];
+			High = ((2u << Bits) - 1 < (uint)Params[CP_MAXSIZE]) ? (2u << Bits) - 1 : Params[CP_MAXSIZE];
+			Size = CorpusRange(&Spec, Low, High);
+		}
+		else
+		{
+			Size = CorpusRange(&Spec, Params[CP_MINSIZE], Params[CP_MAXSIZE]);
+		}
+
+		// Some entries compress well, some don't
+		CorpusFill(&Spec, Data, Size, CorpusRange(&Spec, 16, 256));
+		snprintf(Name, sizeof(Name), "data%05d.bin", i);
+		Result = pak::PutPAKEntry(Image, Name, Data, Size);
+	}
+	LibFree(Data);
+
+	if (Result == PS2HL_OK && snprintf(Name, sizeof(Name), "%s" CORPUS_DIR_PAK DIR_DELIM "DATA%02d.PAK", Corpus->Dir, Index) >= (int)sizeof(Name))
+		Result = PS2HL_ERR_PARAM;
+	if (Result == PS2HL_OK && pak::SortPAKImage(Image) == false)
+		Result = PS2HL_ERR_MEMORY;
+	if (Result == PS2HL_OK)
+		Result = pak::SavePAKImage(Image, Name);
+	pak::FreePAKImage(Image);
+
+	return Result;
+}
+
+static void CorpusTask(void * Arg)
+{
+	sCorpusTask * Task = (sCorpusTask *)Arg;
+	int Result;
+
+	// Conversion messages of thousands of files are noise here
+	LibMuteThread(true);
+	if (Task->Kind == CORPUS_DATA)
+		Result = CorpusMakePak(Task->Corpus, Task->Index);
+	else
+		Result = CorpusMakeFile(Task->Corpus, Task->Kind, Task->Index);
+	LibMuteThread(false);
+
+	if (Task->Kind == CORPUS_DATA)
+		CorpusDone(Task->Corpus, Result, 0, 1, Task->Corpus->Params[CP_ENTRIES]);
+	else
+		CorpusDone(Task->Corpus, Result, (Result == PS2HL_OK) ? 2 : 0, 0, 0);
+	if (Result != PS2HL_OK)
+		LibMsg(MSG_ERROR, "Can't generate %s %d: %s \n", (Task->Kind == CORPUS_DATA) ? "filler PAK" : CorpusKinds[Task->Kind].Name,
+			Task->Index, LibStatusStr(Result));
+
+	LibFree(Task);
+}
+
+static int CorpusPackDir(sCorpus * Corpus, const char * Dir)	// ps2/DIR -> pak/DIR.PAK (entries are added in the same order for any -j)
+{
+	pak::sPAKImage * Image;
+	char FileName[PATH_LEN];
+	char EntryName[PATH_LEN];
+	const char * Ext;
+	int Entries = 0;
+	int Result;
+
+	Result = pak::NewPAKImage(true, &Image);
+	for (int Kind = 0; Kind < CORPUS_KIND_COUNT && Result == PS2HL_OK; Kind++)
+	{
+		if (strcmp(CorpusKinds[Kind].Dir, Dir))
+			continue;
+
+		Ext = (CorpusKinds[Kind].PS2Ext != NULL) ? CorpusKinds[Kind].PS2Ext : CorpusKinds[Kind].Ext;
+		for (int i = 0; i < Corpus->Counts[Kind] && Result == PS2HL_OK; i++)
+		{
+			if (CorpusName(Corpus, FileName, sizeof(FileName), CORPUS_DIR_PS2, Kind, i, Ext) == false)
+			{
+				Result = PS2HL_ERR_PARAM;
+				break;
+			}
+			snprintf(EntryName, sizeof(EntryName), "%s%04d%s", CorpusKinds[Kind].Name, i, Ext);
+			Result = pak::PatchPAKImage(Image, EntryName, FileName);
+			Entries++;
+		}
+	}
+
+	if (Result == PS2HL_OK && snprintf(FileName, sizeof(FileName), "%s" CORPUS_DIR_PAK DIR_DELIM "%s.PAK", Corpus->Dir, Dir) >= (int)sizeof(FileName))
+		Result = PS2HL_ERR_PARAM;
+	if (Result == PS2HL_OK && pak::SortPAKImage(Image) == false)
+		Result = PS2HL_ERR_MEMORY;
+	if (Result == PS2HL_OK)
+		Result = pak::SavePAKImage(Image, FileName);
+	pak::FreePAKImage(Image);
+
+	CorpusDone(Corpus, Result, 0, 1, Entries);
+	return Result;
+}
+
+static bool CorpusParse(sCorpus * Corpus, int ArgCount, char ** Args)
+{
+	const char * Value;
+	const char * Choice;
+	char * End;
+	size_t Len;
+	size_t ChoiceLen;
+	long Number;
+	int Param;
+
+	for (int i = 0; i < CP_COUNT; i++)
+		Corpus->Params[i] = CorpusParams[i].Default;
+
+	for (int i = 0; i < ArgCount; i++)
+	{
+		Value = strchr(Args[i], '=');
+		Len = (Value != NULL) ? (size_t)(Value - Args[i]) : 0;
+		for (Param = 0; Param < CP_COUNT; Param++)
+			if (Len == strlen(CorpusParams[Param].Name) && !strncmp(Args[i], CorpusParams[Param].Name, Len))
+				break;
+		if (Param == CP_COUNT)
+		{
+			LibMsg(MSG_ERROR, "Can't recognise corpus parameter: %s \n", Args[i]);
+			return false;
+		}
+		Value++;
+
+		// Named value: its number in list of choices
+		if (CorpusParams[Param].Choices != NULL)
+		{
+			for (Number = 0; (Choice = CorpusChoice(CorpusParams[Param].Choices, Number, &ChoiceLen)) != NULL; Number++)
+				if (ChoiceLen == strlen(Value) && !strncmp(Choice, Value, ChoiceLen))
+					break;
+			if (Choice == NULL)
+			{
+				LibMsg(MSG_ERROR, "Corpus parameter %s takes one of: %s \n", CorpusParams[Param].Name, CorpusParams[Param].Choices);
+				return false;
+			}
+		}
+		else
+		{
+			Number = strtol(Value, &End, 10);
+			if (Value[0] == '\0' || *End != '\0' || Number < CorpusParams[Param].Min || Number > CorpusParams[Param].Max)
+			{
+				LibMsg(MSG_ERROR, "Corpus parameter %s should be number from %d to %d \n", CorpusParams[Param].Name,
+					CorpusParams[Param].Min, CorpusParams[Param].Max);
+				return false;
+			}
+		}
+		Corpus->Params[Param] = Number;
+	}
+
+	if (Corpus->Params[CP_MINSIZE] > Corpus->Params[CP_MAXSIZE])
+	{
+		LibMsg(MSG_ERROR, "Corpus parameter minsize is bigger than maxsize \n");
+		return false;
+	}
+
+	return true;
+}
+
+static void CorpusPrintParams(sCorpus * Corpus)
+{
+	const char * Choice;
+	char Line[512];
+	size_t Len = 0;
+	size_t ChoiceLen = 0;
+
+	for (int i = 0; i < CP_COUNT && Len < sizeof(Line); i++)
+	{
+		Choice = (CorpusParams[i].Choices != NULL) ? CorpusChoice(CorpusParams[i].Choices, Corpus->Params[i], &ChoiceLen) : NULL;
+		if (Choice != NULL)
+			Len += snprintf(&Line[Len], sizeof(Line) - Len, "%s%s=%.*s", Len ? " " : "", CorpusParams[i].Name, (int)ChoiceLen, Choice);
+		else
+			Len += snprintf(&Line[Len], sizeof(Line) - Len, "%s%s=%d", Len ? " " : "", CorpusParams[i].Name, Corpus->Params[i]);
+	}
+
+	LibMsg(MSG_INFO, "Corpus parameters: %s \n", Line);
+}
+
+////////// Functions //////////
+int CorpusRun(const char * OutDir, int ArgCount, char ** Args, int Threads)
+{
+	sCorpus * Corpus;
+	sCorpusTask * Task;
+	char Path[PATH_LEN];
+	size_t Len = strlen(OutDir);
+	int Result;
+
+	Corpus = (sCorpus *)LibCalloc(1, sizeof(sCorpus));
+	if (Corpus == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	if (Len == 0 || Len + 32 >= PATH_LEN)
+	{
+		LibMsg(MSG_ERROR, "Bad output dir: %s \n", OutDir);
+		LibFree(Corpus);
+		return PS2HL_ERR_PARAM;
+	}
+	if (CorpusParse(Corpus, ArgCount, Args) == false)
+	{
+		LibFree(Corpus);
+		return PS2HL_ERR_PARAM;
+	}
+	strcpy(Corpus->Dir, OutDir);
+	if (Corpus->Dir[Len - 1] != DIR_DELIM_CH && Corpus->Dir[Len - 1] != DIR_NOT_DELIM_CH)
+		strcat(Corpus->Dir, DIR_DELIM);
+	CorpusPrintParams(Corpus);
+
+	// Dirs are made before workers start
+	snprintf(Path, sizeof(Path), "%s" CORPUS_DIR_PAK DIR_DELIM, Corpus->Dir);
+	GenerateFolders(Path);
+	for (int Kind = 0; Kind < CORPUS_KIND_COUNT; Kind++)
+	{
+		Corpus->Counts[Kind] = CorpusCount(Corpus, Kind);
+		if (Corpus->Counts[Kind] == 0)
+			continue;
+		snprintf(Path, sizeof(Path), "%s" CORPUS_DIR_PC DIR_DELIM "%s" DIR_DELIM, Corpus->Dir, CorpusKinds[Kind].Dir);
+		GenerateFolders(Path);
+		snprintf(Path, sizeof(Path), "%s" CORPUS_DIR_PS2 DIR_DELIM "%s" DIR_DELIM, Corpus->Dir, CorpusKinds[Kind].Dir);
+		GenerateFolders(Path);
+	}
+
+	MutexInit(&Corpus->Lock);
+	if (Threads > 1)
+		Corpus->HasPool = PoolStart(&Corpus->Pool, Threads);
+
+	// Filler PAKs go first (they are the biggest tasks)
+	for (int Kind = CORPUS_DATA; Kind < CORPUS_KIND_COUNT; Kind++)
+	{
+		int Count = (Kind == CORPUS_DATA) ? Corpus->Params[CP_PAKS] + Corpus->Params[CP_CPAKS] : Corpus->Counts[Kind];
+		for (int i = 0; i < Count; i++)
+		{
+			Task = (sCorpusTask *)LibCalloc(1, sizeof(sCorpusTask));
+			if (Task == NULL)
+			{
+				LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+				CorpusDone(Corpus, PS2HL_ERR_MEMORY, 0, 0, 0);
+				continue;
+			}
+			Task->Corpus = Corpus;
+			Task->Kind = Kind;
+			Task->Index = i;
+
+			if (Corpus->HasPool == false || PoolAdd(&Corpus->Pool, CorpusTask, Task) == false)
+				CorpusTask(Task);
+		}
+	}
+
+	if (Corpus->HasPool == true)
+		PoolStop(&Corpus->Pool);
+
+	// Each dir of PS2 files goes to its PAK
+	for (int Kind = 0; Kind < CORPUS_KIND_COUNT && Corpus->Result == PS2HL_OK; Kind++)
+		if (Corpus->Counts[Kind] != 0 && (Kind == 0 || strcmp(CorpusKinds[Kind].Dir, CorpusKinds[Kind - 1].Dir)))
+			CorpusPackDir(Corpus, CorpusKinds[Kind].Dir);
+	MutexDestroy(&Corpus->Lock);
+
+	LibMsg(MSG_INFO, "Corpus: %d files, %d PAKs (%d entries) in %s \n", Corpus->Files, Corpus->Paks, Corpus->Entries, OutDir);
+
+	Result = Corpus->Result;
+	LibFree(Corpus);
+	return Result;
+}
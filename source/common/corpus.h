@@ -0,0 +1,41 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include "types.h"
+
+// Synthetic corpus: procedurally made game and mod files for timing tools
+// without retail data. Sources are written by generators of each tool
+// (GenerateFile(), see jobs.h), PS2 files are made from them by the tools
+// themselves, so everything in corpus is something tools can load:
+//	OUT/pc/DIR/			- PC files (source tree for build mode)
+//	OUT/ps2/DIR/		- same files converted to PS2 formats
+//	OUT/pak/DIR.PAK		- ps2/DIR packed (compressed)
+//	OUT/pak/DATAnn.PAK	- filler PAKs (normal and compressed) with random entries
+// Every file gets its own generator state made of seed, kind and number,
+// so corpus is the same byte for byte for the same parameters and any -j.
+
+// Parameters and state of one generated file
+#pragma pack(push, 8)		// Natural layout even after tool headers (they leave "#pragma pack(1)" on)
+struct sCorpusSpec
+{
+	uint Rng;					// Generator state (CorpusRandom())
+	ulong Rate;					// Audio sampling frequency
+	ulong Samples;				// Audio length
+	ushort Width;				// Image size (models - biggest texture)
+	ushort Height;				//
+	ushort Count;				// Model textures, sprite frames, graph nodes
+	ushort Sequences;			// Model sequences
+	uchar Palette;				// Images: CAT_PAL_INDEXED or CAT_PAL_RGBA
+};
+#pragma pack(pop)
+
+uint CorpusRandom(sCorpusSpec * Spec);										// Next random number
+uint CorpusRange(sCorpusSpec * Spec, uint Min, uint Max);					// Random number in [Min, Max]
+ushort CorpusDim(sCorpusSpec * Spec, ushort Max, bool Resized);			// Texture size up to Max: power of two (8 or more), if Resized every 4th - 3/4 of it
+void CorpusFill(sCorpusSpec * Spec, uchar * Data, ulong Size, uint Levels);	// Image-like data (runs and gradients, values below Levels)
+int CorpusRun(const char * OutDir, int ArgCount, char ** Args, int Threads);	// Generate corpus (Args - "key=value" parameters), returns PS2HL_OK or first error
+
+#endif // CORPUS_H
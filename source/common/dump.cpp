@@ -0,0 +1,542 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains whole game dump: PAKs are loaded one after another,
+// their entries are handed to converters in memory and converted on
+// thread pool, loading waits while too much data is in flight
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "thpool.h"		// Goes first: sets up windows.h version
+#include "ps2hl.h"
+#include "fops.h"
+#include "jobs.h"
+#include "pakimg.h"
+#include "dump.h"
+
+////////// Structures //////////
+
+// Conversion rule
+struct sDumpRule
+{
+	const char * Ext;			// Entry extension ("" - no extension)
+	const char * Tool;			// Converter (entry is checked by its magic too)
+	const char * Command;		//
+};
+
+struct sDump;
+struct sDumpTask;
+
+// Loaded PAK or file, shared by its tasks
+struct sDumpSource
+{
+	sDump * Dump;				// Owner
+	pak::sPAKImage * Image;		// PAK (NULL - single file)
+	uchar * Data;				// File contents
+	ulong DataSize;				//
+	char Out[PATH_LEN];			// Output dir of PAK entries or output file name
+	unsigned long long Memory;	// Bytes charged to memory limit
+	sDumpTask * Tasks;			// One per entry
+	int Pending;				// Tasks that aren't done yet
+};
+
+// Single entry
+struct sDumpTask
+{
+	sDumpSource * Source;		//
+	int Index;					// PAK entry (-1 - file)
+};
+
+// Entry being converted (lives on stack of worker)
+struct sDumpFile
+{
+	const char * Name;			// Output name (converter gets this name as input)
+	const uchar * Data;			// Contents
+	ulong Size;					//
+	bool Written;				// Converter has replaced it with file on disk
+	tFileHook PrevHook;			// Chained hook
+	void * PrevCtx;				//
+};
+
+// Dump session
+struct sDump
+{
+	char GameDir[PATH_LEN];		// With trailing delimiter
+	char OutDir[PATH_LEN];		//
+	sThreadPool Pool;			// Workers
+	bool HasPool;				// false - convert in place
+	tMutex Lock;				// Protects everything below
+	tCond Room;					// Signaled when loaded data is released
+	unsigned long long Memory;	// Loaded data in flight
+	int Converted;				// Counters
+	int Copied;					//
+	int Failed;					//
+	int Result;					// First error
+};
+
+////////// Globals //////////
+static const sDumpRule DumpRules[] =
+{
+	{ ".dol", "mdl", JOB_CMD_AUTO },
+	{ ".spz", "spr", JOB_CMD_AUTO },
+	{ ".psi", "psi", JOB_CMD_AUTO },
+	{ ".vag", "mus", "patch" },		// Normal audio is left alone
+	{ ".wav", "mus", "patch" },		//
+	{ "", "phd", JOB_CMD_AUTO }		// Decals have no extension
+};
+#define DUMP_RULE_COUNT (int)(sizeof(DumpRules) / sizeof(DumpRules[0]))
+
+////////// Entries //////////
+static const sDumpRule * DumpFindRule(const char * Name)
+{
+	const char * Short = Name;
+	const char * Ext;
+
+	for (const char * Ptr = Name; *Ptr != '\0'; Ptr++)
+		if (*Ptr == DIR_DELIM_CH || *Ptr == DIR_NOT_DELIM_CH)
+			Short = Ptr + 1;
+	Ext = strrchr(Short, '.');
+	if (Ext == NULL)
+		Ext = "";
+
+	for (int i = 0; i < DUMP_RULE_COUNT; i++)
+	{
+		const char * RuleExt = DumpRules[i].Ext;
+		size_t Len = strlen(RuleExt);
+
+		if (strlen(Ext) != Len)
+			continue;
+		for (size_t j = 0; j <= Len; j++)
+		{
+			if (tolower((uchar)Ext[j]) != RuleExt[j])
+				break;
+			if (j == Len)
+				return &DumpRules[i];
+		}
+	}
+
+	return NULL;
+}
+
+static bool DumpIsSafeName(const char * Name)	// Entry stays inside of output dir
+{
+	const char * Part = Name;
+
+	if (*Name == '\0' || *Name == DIR_DELIM_CH || *Name == DIR_NOT_DELIM_CH || strchr(Name, ':') != NULL)
+		return false;
+
+	while (*Part != '\0')
+	{
+		size_t Len = strcspn(Part, DIR_DELIM DIR_NOT_DELIM);
+		if (Len == 2 && Part[0] == '.' && Part[1] == '.')
+			return false;
+		Part += Len;
+		if (*Part != '\0')
+			Part++;
+	}
+
+	return true;
+}
+
+static bool DumpLookup(void * Ctx, const char * FileName, const void ** ptrData, size_t * ptrSize)
+{
+	sDumpFile * File = (sDumpFile *)Ctx;
+
+	if (File->Written == true || strcmp(FileName, File->Name))
+		return false;
+
+	*ptrData = File->Data;
+	*ptrSize = File->Size;
+	return true;
+}
+
+static void DumpHook(void * Ctx, int Access, const char * FileName, const char * OldName)
+{
+	sDumpFile * File = (sDumpFile *)Ctx;
+
+	if (File->PrevHook != NULL)
+		File->PrevHook(File->PrevCtx, Access, FileName, OldName);
+
+	// Converted in place (audio) - further reads go to disk
+	if ((Access == FILE_HOOK_WRITE || Access == FILE_HOOK_RENAME) && !strcmp(FileName, File->Name))
+		File->Written = true;
+}
+
+static int DumpWrite(sDumpFile * File)	// Entry goes out as is
+{
+	FILE * ptrFile;
+
+	if (FileOpen(&ptrFile, File->Name, "wb") == false)
+		return PS2HL_ERR_OPEN;
+	FileWriteBlock(&ptrFile, File->Data, File->Size);
+	fclose(ptrFile);
+
+	return PS2HL_OK;
+}
+
+static int DumpConvert(sDumpFile * File, bool * ptrConverted)
+{
+	const sDumpRule * Rule = DumpFindRule(File->Name);
+	const sJobTool * Tool = (Rule != NULL) ? JobFindTool(Rule->Tool) : NULL;
+	int Result = PS2HL_ERR_SKIP;
+
+	*ptrConverted = false;
+
+	// Converter reads entry from memory, writes results to disk
+	if (Tool != NULL)
+	{
+		FileGetHook(&File->PrevHook, &File->PrevCtx);
+		FileSetHook(DumpHook, File);
+		FileSetMemory(DumpLookup, File);
+		if (Tool->Sniff(File->Name) == true)
+			Result = Tool->Run(Rule->Command, File->Name);
+		FileSetMemory(NULL, NULL);
+		FileSetHook(File->PrevHook, File->PrevCtx);
+	}
+	if (Result == PS2HL_OK)
+	{
+		*ptrConverted = true;
+		return PS2HL_OK;
+	}
+
+	// Failed conversion still leaves original file
+	if (DumpWrite(File) != PS2HL_OK)
+		return PS2HL_ERR_OPEN;
+
+	return (Result == PS2HL_ERR_SKIP) ? PS2HL_OK : Result;
+}
+
+////////// Tasks //////////
+static void DumpFreeSource(sDumpSource * Source)
+{
+	pak::FreePAKImage(Source->Image);
+	LibFree(Source->Data);
+	LibFree(Source->Tasks);
+	LibFree(Source);
+}
+
+static void DumpTask(void * Arg)
+{
+	sDumpTask * Task = (sDumpTask *)Arg;
+	sDumpSource * Source = Task->Source;
+	sDump * Dump = Source->Dump;
+	char Name[PATH_LEN];
+	const char * EntryName;
+	sDumpFile File;
+	bool Converted = false;
+	bool Last;
+	int Result;
+
+	memset(&File, 0x00, sizeof(File));
+	File.Name = Name;
+	if (Source->Image != NULL)
+	{
+		EntryName = pak::GetPAKEntryName(Source->Image, Task->Index);
+		File.Data = pak::GetPAKEntryData(Source->Image, Task->Index, &File.Size);
+		if (snprintf(Name, sizeof(Name), "%s%s", Source->Out, EntryName) >= (int)sizeof(Name))
+			Result = PS2HL_ERR_PARAM;
+		else
+			Result = DumpIsSafeName(EntryName) ? PS2HL_OK : PS2HL_ERR_FORMAT;
+		PatchSlashes(Name, strlen(Name), true);
+	}
+	else
+	{
+		EntryName = Source->Out;
+		File.Data = Source->Data;
+		File.Size = Source->DataSize;
+		snprintf(Name, sizeof(Name), "%s", Source->Out);
+		Result = PS2HL_OK;
+	}
+	if (Result == PS2HL_OK)
+	{
+		GenerateFolders(Name);
+		Result = DumpConvert(&File, &Converted);
+	}
+
+	MutexLock(&Dump->Lock);
+	if (Result != PS2HL_OK)
+	{
+		Dump->Failed++;
+		if (Dump->Result == PS2HL_OK)
+			Dump->Result = Result;
+		LibMsg(MSG_ERROR, "Failed: %s (%s) \n", EntryName, LibStatusStr(Result));
+	}
+	if (Converted == true)
+		Dump->Converted++;
+	else if (Result == PS2HL_OK)
+		Dump->Copied++;
+
+	// Last entry - loaded data can go
+	Last = --Source->Pending == 0;
+	if (Last == true)
+	{
+		Dump->Memory -= Source->Memory;
+		CondBroadcast(&Dump->Room);
+	}
+	MutexUnlock(&Dump->Lock);
+
+	if (Last == true)
+		DumpFreeSource(Source);
+}
+
+static void DumpQueue(sDump * Dump, sDumpSource * Source, int Count)
+{
+	Source->Pending = Count;
+	for (int i = 0; i < Count; i++)
+		if (Dump->HasPool == false || PoolAdd(&Dump->Pool, DumpTask, &Source->Tasks[i]) == false)
+			DumpTask(&Source->Tasks[i]);	// Single thread or out of memory - run in place
+}
+
+static void DumpReserve(sDump * Dump, unsigned long long Bytes)	// Wait for room (something is always let through)
+{
+	MutexLock(&Dump->Lock);
+	while (Dump->Memory > 0 && Dump->Memory + Bytes > (unsigned long long)DUMP_MEMORY * 1024 * 1024)
+		CondWait(&Dump->Room, &Dump->Lock);
+	Dump->Memory += Bytes;
+	MutexUnlock(&Dump->Lock);
+}
+
+static void DumpRelease(sDump * Dump, unsigned long long Bytes)
+{
+	MutexLock(&Dump->Lock);
+	Dump->Memory -= Bytes;
+	CondBroadcast(&Dump->Room);
+	MutexUnlock(&Dump->Lock);
+}
+
+static void DumpFail(sDump * Dump, const char * Name, int Result)
+{
+	MutexLock(&Dump->Lock);
+	Dump->Failed++;
+	if (Dump->Result == PS2HL_OK)
+		Dump->Result = Result;
+	LibMsg(MSG_ERROR, "Failed: %s (%s) \n", Name, LibStatusStr(Result));
+	MutexUnlock(&Dump->Lock);
+}
+
+////////// Sources //////////
+static sDumpSource * DumpNewSource(sDump * Dump, const char * FullName, unsigned long long * ptrMemory)	// Reserve memory for file
+{
+	sFileStamp Stamp;
+	sDumpSource * Source;
+
+	if (FileGetStamp(FullName, &Stamp) == false)
+	{
+		DumpFail(Dump, FullName, PS2HL_ERR_OPEN);
+		return NULL;
+	}
+	Source = (sDumpSource *)LibCalloc(1, sizeof(sDumpSource));
+	if (Source == NULL)
+	{
+		DumpFail(Dump, FullName, PS2HL_ERR_MEMORY);
+		return NULL;
+	}
+
+	Source->Dump = Dump;
+	*ptrMemory = Stamp.Size;
+	DumpReserve(Dump, Stamp.Size);
+	return Source;
+}
+
+static void DumpPak(sDump * Dump, const char * FullName, const char * Name)
+{
+	unsigned long long Reserved;
+	sDumpSource * Source;
+	size_t Len = strlen(Name);
+	int Count = 0;
+	int Result;
+
+	Source = DumpNewSource(Dump, FullName, &Reserved);
+	if (Source == NULL)
+		return;
+
+	// DIR/NAME.PAK -> OUT/DIR/NAME/
+	if (snprintf(Source->Out, sizeof(Source->Out), "%s%.*s" DIR_DELIM, Dump->OutDir, (int)(Len - 4), Name) >= (int)sizeof(Source->Out))
+	{
+		DumpRelease(Dump, Reserved);
+		DumpFreeSource(Source);
+		DumpFail(Dump, Name, PS2HL_ERR_PARAM);
+		return;
+	}
+
+	// Inflated image takes place of reserved file size
+	LibMsg(MSG_INFO, "Extracting: %s \n", Name);
+	Result = pak::LoadPAKImage(FullName, &Source->Image);
+	if (Result == PS2HL_OK)
+	{
+		Count = pak::GetPAKEntryCount(Source->Image);
+		Source->Tasks = (sDumpTask *)LibCalloc(Count ? Count : 1, sizeof(sDumpTask));
+		if (Source->Tasks == NULL)
+			Result = PS2HL_ERR_MEMORY;
+	}
+	if (Result != PS2HL_OK)
+	{
+		DumpRelease(Dump, Reserved);
+		DumpFreeSource(Source);
+		DumpFail(Dump, Name, Result);
+		return;
+	}
+	Source->Memory = pak::GetPAKImageSize(Source->Image);
+	MutexLock(&Dump->Lock);
+	Dump->Memory += Source->Memory - Reserved;
+	MutexUnlock(&Dump->Lock);
+
+	for (int i = 0; i < Count; i++)
+	{
+		Source->Tasks[i].Source = Source;
+		Source->Tasks[i].Index = i;
+	}
+
+	if (Count == 0)
+	{
+		DumpRelease(Dump, Source->Memory);
+		DumpFreeSource(Source);
+		return;
+	}
+	DumpQueue(Dump, Source, Count);
+}
+
+static void DumpFile(sDump * Dump, const char * FullName, const char * Name)
+{
+	char OutName[PATH_LEN];
+	unsigned long long Reserved;
+	sDumpSource * Source;
+	FILE * ptrFile;
+
+	if (snprintf(OutName, sizeof(OutName), "%s%s", Dump->OutDir, Name) >= (int)sizeof(OutName))
+	{
+		DumpFail(Dump, Name, PS2HL_ERR_PARAM);
+		return;
+	}
+
+	// Nothing to convert - no need to load it
+	if (DumpFindRule(Name) == NULL)
+	{
+		GenerateFolders(OutName);
+		if (FileClone(FullName, OutName, false) == false)
+		{
+			DumpFail(Dump, Name, PS2HL_ERR_OPEN);
+			return;
+		}
+		MutexLock(&Dump->Lock);
+		Dump->Copied++;
+		MutexUnlock(&Dump->Lock);
+		return;
+	}
+
+	Source = DumpNewSource(Dump, FullName, &Reserved);
+	if (Source == NULL)
+		return;
+	Source->Memory = Reserved;
+	strcpy(Source->Out, OutName);
+	Source->Tasks = (sDumpTask *)LibCalloc(1, sizeof(sDumpTask));
+	if (Source->Tasks == NULL || FileOpen(&ptrFile, FullName, "rb") == false)
+	{
+		DumpRelease(Dump, Reserved);
+		DumpFreeSource(Source);
+		DumpFail(Dump, Name, PS2HL_ERR_OPEN);
+		return;
+	}
+	Source->DataSize = FileSize(&ptrFile);
+	Source->Data = (uchar *)LibAlloc(Source->DataSize ? Source->DataSize : 1);
+	if (Source->Data != NULL)
+		FileReadBlock(&ptrFile, Source->Data, 0, Source->DataSize);
+	fclose(ptrFile);
+	if (Source->Data == NULL)
+	{
+		DumpRelease(Dump, Reserved);
+		DumpFreeSource(Source);
+		DumpFail(Dump, Name, PS2HL_ERR_MEMORY);
+		return;
+	}
+
+	Source->Tasks[0].Source = Source;
+	Source->Tasks[0].Index = -1;
+	DumpQueue(Dump, Source, 1);
+}
+
+////////// Functions //////////
+static bool DumpSetDir(char * Out, const char * Dir)
+{
+	size_t Len = strlen(Dir);
+
+	if (Len == 0 || Len + 2 >= PATH_LEN)
+		return false;
+
+	strcpy(Out, Dir);
+	if (Out[Len - 1] != DIR_DELIM_CH && Out[Len - 1] != DIR_NOT_DELIM_CH)
+		strcat(Out, DIR_DELIM);
+
+	return true;
+}
+
+int DumpRun(const char * GameDir, const char * OutDir, int Threads)
+{
+	sDump * Dump;
+	sDirIter Iter;
+	const char * FullName;
+	const char * Name;
+	char Extension[5];
+	int Result;
+
+	Dump = (sDump *)LibCalloc(1, sizeof(sDump));
+	if (Dump == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+
+	if (CheckDir(GameDir) == false || DumpSetDir(Dump->GameDir, GameDir) == false || DumpSetDir(Dump->OutDir, OutDir) == false)
+	{
+		LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+		LibFree(Dump);
+		return PS2HL_ERR_PARAM;
+	}
+
+	// Output dir inside of game dir would be dumped too
+	if (!strncmp(Dump->OutDir, Dump->GameDir, strlen(Dump->GameDir)))
+	{
+		LibMsg(MSG_ERROR, "Output dir can't be inside of game dir ...\n");
+		LibFree(Dump);
+		return PS2HL_ERR_PARAM;
+	}
+
+	MutexInit(&Dump->Lock);
+	CondInit(&Dump->Room);
+	if (Threads > 1)
+		Dump->HasPool = PoolStart(&Dump->Pool, Threads);
+
+	// Loading goes on while entries of previous PAKs are converted
+	DirIterInit(&Iter, Dump->GameDir);
+	while ((FullName = DirIterGet(&Iter)) != NULL)
+	{
+		// Iterator returns names with game dir prefix
+		Name = FullName + strlen(Dump->GameDir);
+		while (*Name == DIR_DELIM_CH)
+			Name++;
+
+		FileGetExtension(Name, Extension, sizeof(Extension));
+		if (!strcmp(Extension, ".pak"))
+			DumpPak(Dump, FullName, Name);
+		else
+			DumpFile(Dump, FullName, Name);
+	}
+	DirIterClose(&Iter);
+
+	if (Dump->HasPool == true)
+		PoolStop(&Dump->Pool);
+	CondDestroy(&Dump->Room);
+	MutexDestroy(&Dump->Lock);
+
+	LibMsg(MSG_INFO, "\nDump: converted: %d, copied: %d, failed: %d \n", Dump->Converted, Dump->Copied, Dump->Failed);
+	if (Dump->Converted + Dump->Copied + Dump->Failed == 0)
+		LibMsg(MSG_WARN, "Warning: nothing to dump in %s \n", GameDir);
+
+	Result = Dump->Result;
+	LibFree(Dump);
+	return Result;
+}
@@ -0,0 +1,26 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef DUMP_H
+#define DUMP_H
+
+#include "types.h"
+
+// Dump of whole game to PC formats (reverse of build):
+//	GAME/DIR/NAME.PAK	-> OUT/DIR/NAME/ (entries, converted)
+//	name.dol			-> name.mdl
+//	name.spz			-> name.spr
+//	name.psi			-> name.png
+//	name (decal)		-> name.bmp
+//	name.vag, name.wav	-> same name (PS2 -> normal)
+//	anything else		-> copied as is
+// PAKs are inflated in memory and their entries go to converters without
+// being extracted to disk. Entries are converted on thread pool, while
+// next PAKs are read; reading waits when loaded data takes more than
+// DUMP_MEMORY (plus one PAK, which can't be split).
+
+#define DUMP_MEMORY 256			// Loaded PAKs and files waiting for conversion, MiB
+
+int DumpRun(const char * GameDir, const char * OutDir, int Threads);	// Dump everything in GameDir (Threads <= 1 - in place), returns PS2HL_OK or first error
+
+#endif // DUMP_H
@@ -15,10 +15,17 @@
 #else
 	#include <sys/types.h>
 	#include <sys/stat.h>
+	#include <sys/ioctl.h>
+	#include <fcntl.h>
 	#include <unistd.h>
 	#include <dirent.h>
+	#ifndef FICLONE
+		#define FICLONE _IOW(0x94, 9, int)	// Older headers don't have it (linux/fs.h)
+	#endif
 #endif
 
+#include "ps2hl.h"
+#include "perf.h"
 #include "fops.h"
 
 //#define FDEBUG // Enable/disable debug
@@ -28,47 +35,353 @@
 	#define DPRINT(...)
 #endif
 
+#define FILE_COPY_BUF 0x10000	// FileClone() copy buffer size
+
+static __thread tFileHook Hook = NULL;		// Per thread file access hook
+static __thread void * HookCtx = NULL;		//
+static __thread tFileMemory Memory = NULL;	// Per thread in-memory files
+static __thread void * MemoryCtx = NULL;	//
+
+void FileSetHook(tFileHook NewHook, void * Ctx)
+{
+	Hook = NewHook;
+	HookCtx = Ctx;
+}
+
+void FileGetHook(tFileHook * ptrHook, void ** ptrCtx)
+{
+	*ptrHook = Hook;
+	*ptrCtx = HookCtx;
+}
+
+void FileSetMemory(tFileMemory Lookup, void * Ctx)
+{
+	Memory = Lookup;
+	MemoryCtx = Ctx;
+}
+
+static FILE * FileOpenMemory(const char * FileName, const char * Mode)	// NULL - file isn't in memory
+{
+	const void * Data;
+	size_t Size;
+	FILE * ptrFile;
+
+	if (Memory == NULL || strchr(Mode, 'w') || strchr(Mode, 'a') || strchr(Mode, '+'))
+		return NULL;
+	if (Memory(MemoryCtx, FileName, &Data, &Size) == false)
+		return NULL;
+
+#ifdef _WIN32
+	// No fmemopen() - nameless temp file, gone after fclose()
+	ptrFile = tmpfile();
+	if (ptrFile != NULL)
+	{
+		fwrite(Data, 1, Size, ptrFile);
+		rewind(ptrFile);
+	}
+#else
+	// Empty buffer isn't accepted by older libc
+	ptrFile = (Size > 0) ? fmemopen((void *)Data, Size, "rb") : fopen("/dev/null", "rb");
+#endif
+
+	return ptrFile;
+}
+
+#ifdef _WIN32
+
+bool FileSetSink(tFileSinkAccept Accept, tFileSinkPut Put, void * Ctx)
+{
+	// No custom streams in msvcrt - files go to disk
+	(void)Put;
+	(void)Ctx;
+	return Accept == NULL;
+}
+
+static FILE * FileOpenSink(const char * FileName, const char * Mode)
+{
+	(void)FileName;
+	(void)Mode;
+	return NULL;
+}
+
+#else // linux
+
+static __thread tFileSinkAccept SinkAccept = NULL;	// Per thread output sink
+static __thread tFileSinkPut SinkPut = NULL;		//
+static __thread void * SinkCtx = NULL;				//
+
+// Sink stream (glibc custom stream)
+struct sFileSinkStream
+{
+	char * Name;				// File name passed to Put()
+	uchar * Data;				// Written contents
+	size_t Size;				//
+	size_t Space;				// Allocated
+	size_t Pos;					// Current position
+	tFileSinkPut Put;			// Sink of thread which opened it
+	void * Ctx;					//
+};
+
+static ssize_t FileSinkWrite(void * Cookie, const char * Buf, size_t Size)
+{
+	sFileSinkStream * Stream = (sFileSinkStream *)Cookie;
+	size_t End = Stream->Pos + Size;
+
+	if (End > Stream->Space)
+	{
+		size_t NewSpace = Stream->Space ? Stream->Space : 0x10000;
+		uchar * NewData;
+
+		while (NewSpace < End)
+			NewSpace *= 2;
+		NewData = (uchar *)LibAlloc(NewSpace);
+		if (NewData == NULL)
+			return 0;
+		if (Stream->Data != NULL)
+			memcpy(NewData, Stream->Data, Stream->Size);
+		LibFree(Stream->Data);
+		Stream->Data = NewData;
+		Stream->Space = NewSpace;
+	}
+
+	// Seek past the end leaves zeros (same as file)
+	if (Stream->Pos > Stream->Size)
+		memset(&Stream->Data[Stream->Size], 0x00, Stream->Pos - Stream->Size);
+	memcpy(&Stream->Data[Stream->Pos], Buf, Size);
+	Stream->Pos = End;
+	if (End > Stream->Size)
+		Stream->Size = End;
+
+	return Size;
+}
+
+static int FileSinkSeek(void * Cookie, off64_t * Offset, int Whence)
+{
+	sFileSinkStream * Stream = (sFileSinkStream *)Cookie;
+	off64_t Base = (Whence == SEEK_SET) ? 0 : (Whence == SEEK_CUR) ? (off64_t)Stream->Pos : (off64_t)Stream->Size;
+
+	if (Base + *Offset < 0)
+		return -1;
+	Stream->Pos = Base + *Offset;
+	*Offset = Stream->Pos;
+
+	return 0;
+}
+
+static int FileSinkClose(void * Cookie)
+{
+	sFileSinkStream * Stream = (sFileSinkStream *)Cookie;
+	bool Result = Stream->Put(Stream->Ctx, Stream->Name, Stream->Data ? Stream->Data : (const uchar *)"", Stream->Size);
+
+	LibFree(Stream->Data);
+	LibFree(Stream->Name);
+	LibFree(Stream);
+
+	return Result ? 0 : EOF;
+}
+
+bool FileSetSink(tFileSinkAccept Accept, tFileSinkPut Put, void * Ctx)
+{
+	SinkAccept = Accept;
+	SinkPut = Put;
+	SinkCtx = Ctx;
+	return true;
+}
+
+static FILE * FileOpenSink(const char * FileName, const char * Mode)	// NULL - file goes to disk
+{
+	cookie_io_functions_t Funcs = { NULL, FileSinkWrite, FileSinkSeek, FileSinkClose };
+	sFileSinkStream * Stream;
+	size_t Len = strlen(FileName);
+	FILE * ptrFile;
+
+	if (SinkAccept == NULL || Mode[0] != 'w' || strchr(Mode, '+') || SinkAccept(SinkCtx, FileName) == false)
+		return NULL;
+
+	Stream = (sFileSinkStream *)LibCalloc(1, sizeof(sFileSinkStream));
+	if (Stream == NULL)
+		return NULL;
+	Stream->Name = (char *)LibAlloc(Len + 1);
+	if (Stream->Name == NULL)
+	{
+		LibFree(Stream);
+		return NULL;
+	}
+	memcpy(Stream->Name, FileName, Len + 1);
+	Stream->Put = SinkPut;
+	Stream->Ctx = SinkCtx;
+
+	ptrFile = fopencookie(Stream, "wb", Funcs);
+	if (ptrFile == NULL)
+	{
+		LibFree(Stream->Name);
+		LibFree(Stream);
+	}
+
+	return ptrFile;
+}
+
+#endif
+
+static void FileCallHook(const char * FileName, const char * Mode, bool Opened)
+{
+	if (Hook == NULL)
+		return;
+
+	if (strchr(Mode, 'w') || strchr(Mode, 'a') || strchr(Mode, '+'))
+	{
+		if (Opened == true)
+			Hook(HookCtx, FILE_HOOK_WRITE, FileName, NULL);
+	}
+	else
+	{
+		Hook(HookCtx, Opened ? FILE_HOOK_READ : FILE_HOOK_MISSING, FileName, NULL);
+	}
+}
+
+static bool FileCopy(const char * SrcName, const char * DstName)
+{
+	FILE * ptrSrc;
+	FILE * ptrDst;
+	char * Buffer;
+	size_t Size;
+	bool Result = true;
+
+	Buffer = (char *)LibAlloc(FILE_COPY_BUF);
+	if (Buffer == NULL)
+		return false;
+
+	ptrSrc = fopen(SrcName, "rb");
+	if (ptrSrc == NULL)
+	{
+		LibFree(Buffer);
+		return false;
+	}
+	ptrDst = fopen(DstName, "wb");
+	if (ptrDst == NULL)
+	{
+		fclose(ptrSrc);
+		LibFree(Buffer);
+		return false;
+	}
+
+	while ((Size = fread(Buffer, 1, FILE_COPY_BUF, ptrSrc)) != 0)
+	{
+		PERF_ADD(PERF_READS, 1);
+		PERF_ADD(PERF_BYTES_READ, Size);
+		if (fwrite(Buffer, 1, Size, ptrDst) != Size)
+		{
+			Result = false;
+			break;
+		}
+		PERF_ADD(PERF_WRITES, 1);
+		PERF_ADD(PERF_BYTES_WRITTEN, Size);
+	}
+
+	fclose(ptrSrc);
+	if (fclose(ptrDst) != 0)
+		Result = false;
+	LibFree(Buffer);
+
+	if (Result == false)
+		remove(DstName);
+
+	return Result;
+}
+
 size_t FileSize(FILE **ptrFile)
 {
+	PERF_ADD(PERF_SEEKS, 1);
 	fseek(*ptrFile, 0, SEEK_END);						// Move pointer to the file's end
 	return ftell(*ptrFile);								// Return pointer position
 }
 
 void FileReadBlock(FILE **ptrSrcFile, void * DstBuff, size_t Addr, size_t Size)
 {
+	PERF_SCOPE(PERF_PH_DISK_READ);
 	fseek(*ptrSrcFile, Addr, SEEK_SET);					// Seek to specified address
 	fread(DstBuff, (size_t)1, Size, *ptrSrcFile);		// 
+	PERF_ADD(PERF_SEEKS, 1);
+	PERF_ADD(PERF_READS, 1);
+	PERF_ADD(PERF_BYTES_READ, Size);
 }
 
 void FileWriteBlock(FILE **ptrDstFile, const void * SrcBuff, size_t Addr, size_t Size)
 {
+	PERF_SCOPE(PERF_PH_DISK_WRITE);
 	fseek(*ptrDstFile, Addr, SEEK_SET);					// Seek to specified address
 	fwrite(SrcBuff, (size_t)1, Size, *ptrDstFile);		// Write block
 	fseek(*ptrDstFile, 0, SEEK_END);					// Set pointer to file's end
+	PERF_ADD(PERF_SEEKS, 2);
+	PERF_ADD(PERF_WRITES, 1);
+	PERF_ADD(PERF_BYTES_WRITTEN, Size);
 }
 
 void FileWriteBlock(FILE **ptrDstFile, const void * SrcBuff, size_t Size)
 {
+	PERF_SCOPE(PERF_PH_DISK_WRITE);
 	fseek(*ptrDstFile, 0, SEEK_END);					// Set pointer to file's end
 	fwrite(SrcBuff, (size_t)1, Size, *ptrDstFile);		// Write block
+	PERF_ADD(PERF_SEEKS, 1);
+	PERF_ADD(PERF_WRITES, 1);
+	PERF_ADD(PERF_BYTES_WRITTEN, Size);
 }
 
-void SafeFileOpen(FILE **ptrFile, const char * FileName, const char * Mode)
+bool FileOpen(FILE **ptrFile, const char * FileName, const char * Mode)
 {
-	*ptrFile = fopen(FileName, Mode);
+	// Output that never reaches disk
+	*ptrFile = FileOpenSink(FileName, Mode);
+	if (*ptrFile == NULL)
+		*ptrFile = FileOpenMemory(FileName, Mode);
+
+	// New file instead of rewriting old one, so hard links (conversion cache) stay intact
+	if (*ptrFile == NULL && Mode[0] == 'w')
+		remove(FileName);
+	if (*ptrFile == NULL)
+		*ptrFile = fopen(FileName, Mode);
+	PERF_ADD(PERF_OPENS, 1);
+	FileCallHook(FileName, Mode, *ptrFile != NULL);
 
 	if (*ptrFile == NULL)
 	{
-		printf("Error: can't open file: %s \n\n", FileName);
-		exit(EXIT_FAILURE);
+		LibMsg(MSG_ERROR, "Error: can't open file: %s \n\n", FileName);
+		return false;
 	}
+
+	return true;
+}
+
+FILE * FileProbe(const char * FileName, const char * Mode)
+{
+	FILE * ptrFile;
+
+	ptrFile = FileOpenSink(FileName, Mode);
+	if (ptrFile == NULL)
+		ptrFile = FileOpenMemory(FileName, Mode);
+	if (ptrFile == NULL)
+		ptrFile = fopen(FileName, Mode);
+	PERF_ADD(PERF_OPENS, 1);
+	FileCallHook(FileName, Mode, ptrFile != NULL);
+
+	return ptrFile;
 }
 
 void FileGetExtension(const char * Path, char * OutputBuffer, int OutputBufferSize)
 {
-	if (OutputBufferSize > 4)
-		for (int i = 0; i <= 4; i++)
-			OutputBuffer[i] = tolower(Path[strlen(Path) - 4 + i]);
+	size_t Len = strlen(Path);
+
+	if (OutputBufferSize <= 4)
+		return;
+
+	// Too short for extension
+	if (Len < 4)
+	{
+		OutputBuffer[0] = '\0';
+		return;
+	}
+
+	for (int i = 0; i <= 4; i++)
+		OutputBuffer[i] = tolower(Path[Len - 4 + i]);
 }
 
 void FileGetName(const char * Path, char * OutputBuffer, int OutputBufferSize, bool WithExtension)
@@ -190,6 +503,9 @@ void FileSafeRename(char * OldName, char * NewName)
 
 	// Rename
 	rename(OldName, NewName);
+
+	if (Hook != NULL)
+		Hook(HookCtx, FILE_HOOK_RENAME, NewName, OldName);
 }
 
 void PatchSlashes(char * cPathBuff, int BuffSize, bool PakToFs)
@@ -212,40 +528,55 @@ void PatchSlashes(char * cPathBuff, int BuffSize, bool PakToFs)
 
 void GenerateFolders(char * cPath)
 {
-	char PathBuffer[PATH_LEN];
-	char * cDir;
-	char cCurrent[PATH_LEN] = "";
-	char Counter = 0;
+	char cCurrent[PATH_LEN];
+	size_t Len = strlen(cPath);
 
-	strcpy(PathBuffer, cPath);			// Save cPath to buffer, to avoid error, when parsing (const char *)
+	if (Len >= PATH_LEN)
+		return;
+	memcpy(cCurrent, cPath, Len + 1);
 
-	cDir = strtok(PathBuffer, DIR_DELIM);	// First run: count words
-	while (cDir != NULL)
+	// Cut path at every delimiter (no strtok(): jobs create dirs from several threads)
+	for (size_t i = 1; i < Len; i++)
 	{
-		Counter++;
-		cDir = strtok(NULL, DIR_DELIM);
-	}
+		if (cCurrent[i] != DIR_DELIM_CH || cCurrent[i - 1] == DIR_DELIM_CH)
+			continue;
 
-	strcpy(PathBuffer, cPath);			// Give strtok() fresh string
-	cDir = strtok(PathBuffer, DIR_DELIM);	// Second run: create folders
-	while (cDir != NULL)
-	{
-		strcat(cCurrent, cDir);
-		if (Counter > 1)
-		{
-			NewDir(cCurrent);
-			Counter--;
-		}
-		strcat(cCurrent, DIR_DELIM);
-		cDir = strtok(NULL, DIR_DELIM);
+		cCurrent[i] = '\0';
+		NewDir(cCurrent);
+		cCurrent[i] = DIR_DELIM_CH;
 	}
 }
 
+static bool FileCloneData(const char * SrcName, const char * DstName, bool AllowHardLink);
+
+bool FileClone(const char * SrcName, const char * DstName, bool AllowHardLink)
+{
+	if (FileCloneData(SrcName, DstName, AllowHardLink) == false)
+		return false;
+
+	if (Hook != NULL)
+		Hook(HookCtx, FILE_HOOK_WRITE, DstName, NULL);
+
+	return true;
+}
+
 
 //// PLATFORM-DEPENDENT CODE BELOW ////
 
 #ifdef _WIN32
 
+bool FileGetStamp(const char * FileName, sFileStamp * Stamp)
+{
+	WIN32_FILE_ATTRIBUTE_DATA Data;
+
+	if (GetFileAttributesExA(FileName, GetFileExInfoStandard, &Data) == 0 || (Data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		return false;
+
+	Stamp->Size = ((unsigned long long)Data.nFileSizeHigh << 32) | Data.nFileSizeLow;
+	Stamp->Time = ((unsigned long long)Data.ftLastWriteTime.dwHighDateTime << 32) | Data.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
 bool CheckDir(const char * Path)
 {
 	DWORD Attr = GetFileAttributesA(Path);
@@ -258,6 +589,21 @@ void NewDir(const char * DirName)
 	CreateDirectoryA(DirName, NULL);
 }
 
+void DelDir(const char * DirName)
+{
+	RemoveDirectoryA(DirName);
+}
+
+static bool FileCloneData(const char * SrcName, const char * DstName, bool AllowHardLink)
+{
+	// No reflinks here (ReFS block cloning needs much more code)
+	remove(DstName);
+	if (AllowHardLink == true && CreateHardLinkA(DstName, SrcName, NULL))
+		return true;
+
+	return FileCopy(SrcName, DstName);
+}
+
 void ProgGetPath(char * OutputBuffer, int OutputBufferSize)
 {
 	HMODULE hModule;
@@ -272,77 +618,70 @@ void ProgGetPath(char * OutputBuffer, int OutputBufferSize)
 }
 
 // Some older compilers have bad time with `#include <filesystem>`, so I added alternative iterator
-#define NUM_LEV 20 // How deep dir iterator can go
-static struct
-{
-	int CurLev;						// Current dir level
-	HANDLE hFind[NUM_LEV];			// Stores search progress
-	WIN32_FIND_DATA data[NUM_LEV];	// Stores file data
-	char BaseDir[PATH_LEN];			// Stores base dir for current session
-	char RetPath[PATH_LEN];			// Stores resulting file name
-} GI;
-static void DirGetBase(char * buf) // Gets base dir for currrent level (internal func)
+static void DirGetBase(sDirIter * Iter, char * buf) // Gets base dir for currrent level (internal func)
 {
 	// Base dir
-	strcpy(buf, GI.BaseDir);
+	strcpy(buf, Iter->BaseDir);
 
 	// Next dir levels
-	for (int lv = 0; lv < GI.CurLev; lv++)
+	for (int lv = 0; lv < Iter->CurLev; lv++)
 	{
-		strcat(buf, GI.data[lv].cFileName);
+		strcat(buf, Iter->data[lv].cFileName);
 		strcat(buf, DIR_DELIM);
 	}
 
 	//DPRINT("[iter] get base: %s\n", buf);
 }
-void DirIterClose()
+void DirIterClose(sDirIter * Iter)
 {
 	// Close active searches
-	for (int lv = 0; lv <= GI.CurLev; lv++)
+	for (int lv = 0; lv <= Iter->CurLev; lv++)
 	{
-		if (GI.hFind != INVALID_HANDLE_VALUE)
-			FindClose(GI.hFind[lv]);
+		if (Iter->hFind[lv] != INVALID_HANDLE_VALUE)
+			FindClose(Iter->hFind[lv]);
 	}
 
 	// Reset list
-	GI.CurLev = 0;
-	GI.hFind[0] = INVALID_HANDLE_VALUE;
-	GI.BaseDir[0] = '\0';
-	GI.RetPath[0] = '\0';
+	Iter->CurLev = 0;
+	Iter->hFind[0] = INVALID_HANDLE_VALUE;
+	Iter->BaseDir[0] = '\0';
+	Iter->RetPath[0] = '\0';
 }
-void DirIterInit(const char * Dir)
+void DirIterInit(sDirIter * Iter, const char * Dir)
 {
-	// Close prev session
-	DirIterClose();
+	// Reset state (structure isn't initialized yet, so don't close anything)
+	Iter->CurLev = 0;
+	Iter->hFind[0] = INVALID_HANDLE_VALUE;
+	Iter->RetPath[0] = '\0';
 
 	// Store base dir (with deliminer at the end)
-	strcpy(GI.BaseDir, Dir);
-	int len = strlen(GI.BaseDir);
+	strcpy(Iter->BaseDir, Dir);
+	int len = strlen(Iter->BaseDir);
 	if (!len)
-		strcpy(GI.BaseDir, DIR_DELIM);		// empty
-	else if (GI.BaseDir[len-1] == DIR_NOT_DELIM_CH)
-		GI.BaseDir[len-1] = DIR_DELIM_CH;	// wrong delim
-	else if (GI.BaseDir[len-1] != DIR_DELIM_CH)
-		strcat(GI.BaseDir, DIR_DELIM);		// no delim
+		strcpy(Iter->BaseDir, DIR_DELIM);		// empty
+	else if (Iter->BaseDir[len-1] == DIR_NOT_DELIM_CH)
+		Iter->BaseDir[len-1] = DIR_DELIM_CH;	// wrong delim
+	else if (Iter->BaseDir[len-1] != DIR_DELIM_CH)
+		strcat(Iter->BaseDir, DIR_DELIM);		// no delim
 
-	DPRINT("[iter]->(re)init, base: %s\n", GI.BaseDir);
+	DPRINT("[iter]->(re)init, base: %s\n", Iter->BaseDir);
 }
-const char * DirIterGet()
+const char * DirIterGet(sDirIter * Iter)
 {
 	char SearchStr[PATH_LEN] = "";
 
 	bool Found = false;
-	if (GI.hFind[GI.CurLev] == INVALID_HANDLE_VALUE)
+	if (Iter->hFind[Iter->CurLev] == INVALID_HANDLE_VALUE)
 	{
 		DPRINT("[iter] get first\n");
 
 		// Get base dir for current level
-		DirGetBase(SearchStr);
+		DirGetBase(Iter, SearchStr);
 		strcat(SearchStr, "*.*");
 
 		// Find first entry
-		GI.hFind[GI.CurLev] = FindFirstFile(SearchStr, &GI.data[GI.CurLev]);
-		if (GI.hFind[GI.CurLev] != INVALID_HANDLE_VALUE)
+		Iter->hFind[Iter->CurLev] = FindFirstFile(SearchStr, &Iter->data[Iter->CurLev]);
+		if (Iter->hFind[Iter->CurLev] != INVALID_HANDLE_VALUE)
 			Found = true;
 	}
 	else
@@ -350,50 +689,51 @@ const char * DirIterGet()
 		DPRINT("[iter] get next\n");
 
 		// Find next entry
-		if (FindNextFile(GI.hFind[GI.CurLev], &GI.data[GI.CurLev]))
+		if (FindNextFile(Iter->hFind[Iter->CurLev], &Iter->data[Iter->CurLev]))
 			Found = true;
 	}
 
 	if (Found)
 	{
 		// Found something
-		if (GI.data[GI.CurLev].dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		if (Iter->data[Iter->CurLev].dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
 		{
 			/// Dir ///
 
 			// Skip '.' and '..' recursively
-			if (!strcmp(GI.data[GI.CurLev].cFileName, ".") || !strcmp(GI.data[GI.CurLev].cFileName, ".."))
-				return DirIterGet();
+			if (!strcmp(Iter->data[Iter->CurLev].cFileName, ".") || !strcmp(Iter->data[Iter->CurLev].cFileName, ".."))
+				return DirIterGet(Iter);
 
-			DPRINT("[iter] entering dir: %s\n", GI.data[GI.CurLev].cFileName);
+			DPRINT("[iter] entering dir: %s\n", Iter->data[Iter->CurLev].cFileName);
 
 			// Go one level up (inside directory)
-			if (++(GI.CurLev) > NUM_LEV)
+			if (Iter->CurLev + 1 >= DIR_ITER_LEVELS)
 			{
-				DPRINT("[%s] subdir level overflow!\n", __func__);
-				exit(1);
+				DPRINT("[%s] subdir level overflow, skipping dir!\n", __func__);
+				return DirIterGet(Iter);
 			}
-			GI.hFind[GI.CurLev] = INVALID_HANDLE_VALUE;
-			return DirIterGet();
+			(Iter->CurLev)++;
+			Iter->hFind[Iter->CurLev] = INVALID_HANDLE_VALUE;
+			return DirIterGet(Iter);
 		}
 
 		/// File ///
-		DirGetBase(GI.RetPath);
-		strcat(GI.RetPath, GI.data[GI.CurLev].cFileName);
-		DPRINT("[iter]<-return file: %s\n", GI.RetPath);
-		return GI.RetPath;
+		DirGetBase(Iter, Iter->RetPath);
+		strcat(Iter->RetPath, Iter->data[Iter->CurLev].cFileName);
+		DPRINT("[iter]<-return file: %s\n", Iter->RetPath);
+		return Iter->RetPath;
 	}
 
 	// Not found anything
-	if (GI.CurLev)
+	if (Iter->CurLev)
 	{
 		DPRINT("[iter] leaving dir\n");
 
 		// Go one level down (outside)
-		if (GI.hFind[GI.CurLev] != INVALID_HANDLE_VALUE)
-			FindClose(GI.hFind[GI.CurLev]);
-		(GI.CurLev)--;
-		return DirIterGet();
+		if (Iter->hFind[Iter->CurLev] != INVALID_HANDLE_VALUE)
+			FindClose(Iter->hFind[Iter->CurLev]);
+		(Iter->CurLev)--;
+		return DirIterGet(Iter);
 	}
 
 	// End - stop
@@ -403,11 +743,24 @@ const char * DirIterGet()
 
 #else // linux
 
+bool FileGetStamp(const char * FileName, sFileStamp * Stamp)
+{
+	struct stat FileStat;
+
+	if (stat(FileName, &FileStat) != 0 || S_ISDIR(FileStat.st_mode))
+		return false;
+
+	Stamp->Size = FileStat.st_size;
+	Stamp->Time = (unsigned long long)FileStat.st_mtim.tv_sec * 1000000000ULL + FileStat.st_mtim.tv_nsec;
+	return true;
+}
+
 bool CheckDir(const char * Path)
 {
 	struct stat DirStat;
 
-	stat(Path, &DirStat);
+	if (stat(Path, &DirStat) != 0)
+		return false;
 
 	if (DirStat.st_mode & S_IFDIR)
 		return true;
@@ -420,6 +773,40 @@ void NewDir(const char * DirName)
 	mkdir(DirName, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 }
 
+void DelDir(const char * DirName)
+{
+	rmdir(DirName);
+}
+
+static bool FileCloneData(const char * SrcName, const char * DstName, bool AllowHardLink)
+{
+	int SrcFd, DstFd;
+	bool Cloned = false;
+
+	remove(DstName);
+
+	// Reflink (btrfs, xfs, ...) - shares data blocks, but not the file
+	SrcFd = open(SrcName, O_RDONLY);
+	if (SrcFd < 0)
+		return false;
+	DstFd = open(DstName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (DstFd >= 0)
+	{
+		Cloned = ioctl(DstFd, FICLONE, SrcFd) == 0;
+		close(DstFd);
+	}
+	close(SrcFd);
+	if (Cloned == true)
+		return true;
+	remove(DstName);
+
+	// Hard link (same file system)
+	if (AllowHardLink == true && link(SrcName, DstName) == 0)
+		return true;
+
+	return FileCopy(SrcName, DstName);
+}
+
 void ProgGetPath(char * OutputBuffer, int OutputBufferSize)
 {
 	// https://stackoverflow.com/questions/758018/path-to-binary-in-c
@@ -427,75 +814,68 @@ void ProgGetPath(char * OutputBuffer, int OutputBufferSize)
 }
 
 // Some older compilers have bad time with `#include <filesystem>`, so I added alternative iterator
-#define NUM_LEV 20 // How deep dir iterator can go
-static struct
-{
-	int CurLev;						// Current dir level
-	DIR * dir[NUM_LEV];				// Stores search progress
-	struct dirent * ent[NUM_LEV];	// Stores file data
-	char BaseDir[PATH_LEN];			// Stores base dir for current session
-	char RetPath[PATH_LEN];			// Stores resulting file name
-} GI;
-static void DirGetBase(char * buf) // Gets base dir for currrent level (internal func)
+static void DirGetBase(sDirIter * Iter, char * buf) // Gets base dir for currrent level (internal func)
 {
 	// Base dir
-	strcpy(buf, GI.BaseDir);
+	strcpy(buf, Iter->BaseDir);
 
 	// Next dir levels
-	for (int lv = 0; lv < GI.CurLev; lv++)
+	for (int lv = 0; lv < Iter->CurLev; lv++)
 	{
-		strcat(buf, GI.ent[lv]->d_name);
+		strcat(buf, Iter->ent[lv]->d_name);
 		strcat(buf, DIR_DELIM);
 	}
 
 	//DPRINT("[iter] get base: %s\n", buf);
 }
-void DirIterClose()
+void DirIterClose(sDirIter * Iter)
 {
 	// Close active searches
-	for (int lv = 0; lv <= GI.CurLev; lv++)
+	for (int lv = 0; lv <= Iter->CurLev; lv++)
 	{
-		if (GI.dir != NULL)
-			closedir(GI.dir[lv]);
+		if (Iter->dir[lv] != NULL)
+			closedir(Iter->dir[lv]);
 	}
 
 	// Reset list
-	GI.CurLev = 0;
-	GI.dir[0] = NULL;
-	GI.BaseDir[0] = '\0';
-	GI.RetPath[0] = '\0';
+	Iter->CurLev = 0;
+	Iter->dir[0] = NULL;
+	Iter->BaseDir[0] = '\0';
+	Iter->RetPath[0] = '\0';
 }
-void DirIterInit(const char * Dir)
+void DirIterInit(sDirIter * Iter, const char * Dir)
 {
-	// Close prev session
-	DirIterClose();
+	// Reset state (structure isn't initialized yet, so don't close anything)
+	Iter->CurLev = 0;
+	Iter->dir[0] = NULL;
+	Iter->RetPath[0] = '\0';
 
 	// Store base dir (with deliminer at the end)
-	strcpy(GI.BaseDir, Dir);
-	int len = strlen(GI.BaseDir);
-	if (!len || (len && GI.BaseDir[len-1] != DIR_DELIM_CH))
-		strcat(GI.BaseDir, DIR_DELIM);
+	strcpy(Iter->BaseDir, Dir);
+	int len = strlen(Iter->BaseDir);
+	if (!len || (len && Iter->BaseDir[len-1] != DIR_DELIM_CH))
+		strcat(Iter->BaseDir, DIR_DELIM);
 
-	DPRINT("[iter]->(re)init, base: %s\n", GI.BaseDir);
+	DPRINT("[iter]->(re)init, base: %s\n", Iter->BaseDir);
 }
-const char * DirIterGet()
+const char * DirIterGet(sDirIter * Iter)
 {
 	char SearchStr[PATH_LEN] = "";
 
 	bool Found = false;
-	if (GI.dir[GI.CurLev] == NULL)
+	if (Iter->dir[Iter->CurLev] == NULL)
 	{
 		DPRINT("[iter] get first\n");
 
 		// Get base dir for current level
-		DirGetBase(SearchStr);
+		DirGetBase(Iter, SearchStr);
 
 		// Find first entry
-		GI.dir[GI.CurLev] = opendir(SearchStr);
-		if (GI.dir[GI.CurLev])
+		Iter->dir[Iter->CurLev] = opendir(SearchStr);
+		if (Iter->dir[Iter->CurLev])
 		{
-			GI.ent[GI.CurLev] = readdir(GI.dir[GI.CurLev]);
-			if (GI.ent[GI.CurLev] != NULL)
+			Iter->ent[Iter->CurLev] = readdir(Iter->dir[Iter->CurLev]);
+			if (Iter->ent[Iter->CurLev] != NULL)
 				Found = true;
 		}
 	}
@@ -504,51 +884,52 @@ const char * DirIterGet()
 		DPRINT("[iter] get next\n");
 
 		// Find next entry
-		GI.ent[GI.CurLev] = readdir(GI.dir[GI.CurLev]);
-		if (GI.ent[GI.CurLev] != NULL)
+		Iter->ent[Iter->CurLev] = readdir(Iter->dir[Iter->CurLev]);
+		if (Iter->ent[Iter->CurLev] != NULL)
 			Found = true;
 	}
 
 	if (Found)
 	{
 		// Found something
-		if (GI.ent[GI.CurLev]->d_type == DT_DIR)
+		if (Iter->ent[Iter->CurLev]->d_type == DT_DIR)
 		{
 			/// Dir ///
 
 			// Skip '.' and '..' recursively
-			if (!strcmp(GI.ent[GI.CurLev]->d_name, ".") || !strcmp(GI.ent[GI.CurLev]->d_name, ".."))
-				return DirIterGet();
+			if (!strcmp(Iter->ent[Iter->CurLev]->d_name, ".") || !strcmp(Iter->ent[Iter->CurLev]->d_name, ".."))
+				return DirIterGet(Iter);
 
-			DPRINT("[iter] entering dir: %s\n", GI.ent[GI.CurLev]->d_name);
+			DPRINT("[iter] entering dir: %s\n", Iter->ent[Iter->CurLev]->d_name);
 
 			// Go one level up (inside directory)
-			if (++(GI.CurLev) > NUM_LEV)
+			if (Iter->CurLev + 1 >= DIR_ITER_LEVELS)
 			{
-				DPRINT("[%s] subdir level overflow!\n", __func__);
-				exit(1);
+				DPRINT("[%s] subdir level overflow, skipping dir!\n", __func__);
+				return DirIterGet(Iter);
 			}
-			GI.dir[GI.CurLev] = NULL;
-			return DirIterGet();
+			(Iter->CurLev)++;
+			Iter->dir[Iter->CurLev] = NULL;
+			return DirIterGet(Iter);
 		}
 
 		/// File ///
-		DirGetBase(GI.RetPath);
-		strcat(GI.RetPath, GI.ent[GI.CurLev]->d_name);
-		DPRINT("[iter]<-return file: %s\n", GI.RetPath);
-		return GI.RetPath;
+		DirGetBase(Iter, Iter->RetPath);
+		strcat(Iter->RetPath, Iter->ent[Iter->CurLev]->d_name);
+		DPRINT("[iter]<-return file: %s\n", Iter->RetPath);
+		return Iter->RetPath;
 	}
 
 	// Not found anything
-	if (GI.CurLev)
+	if (Iter->CurLev)
 	{
 		DPRINT("[iter] leaving dir\n");
 
 		// Go one level down (outside)
-		if (GI.dir[GI.CurLev] != NULL)
-			closedir(GI.dir[GI.CurLev]);
-		(GI.CurLev)--;
-		return DirIterGet();
+		if (Iter->dir[Iter->CurLev] != NULL)
+			closedir(Iter->dir[Iter->CurLev]);
+		(Iter->CurLev)--;
+		return DirIterGet(Iter);
 	}
 
 	// End - stop
@@ -13,6 +13,7 @@
 	#define DIR_NOT_DELIM_CH	'/'
 #else
 	#include <limits.h>
+	#include <dirent.h>
 	#define PATH_LEN PATH_MAX
 	#define DIR_DELIM		"/"
 	#define DIR_DELIM_CH	'/'
@@ -20,11 +21,52 @@
 	#define DIR_NOT_DELIM_CH	'\\'
 #endif
 
+// Recursive dir iterator state (each caller keeps its own, so iterators can be used from several threads)
+#define DIR_ITER_LEVELS 20 // How deep dir iterator can go
+struct sDirIter
+{
+	int CurLev;									// Current dir level
+#ifdef _WIN32
+	HANDLE hFind[DIR_ITER_LEVELS];				// Stores search progress
+	WIN32_FIND_DATA data[DIR_ITER_LEVELS];		// Stores file data
+#else
+	DIR * dir[DIR_ITER_LEVELS];					// Stores search progress
+	struct dirent * ent[DIR_ITER_LEVELS];		// Stores file data
+#endif
+	char BaseDir[PATH_LEN];						// Stores base dir for current session
+	char RetPath[PATH_LEN];						// Stores resulting file name
+};
+
+// File access hook: lets callers find out what files a job read and produced
+#define FILE_HOOK_READ		0	// File opened for reading
+#define FILE_HOOK_MISSING	1	// File doesn't exist (failed read or probe)
+#define FILE_HOOK_WRITE		2	// File opened for writing
+#define FILE_HOOK_RENAME	3	// File renamed (FileName - new name)
+typedef void (*tFileHook)(void * Ctx, int Access, const char * FileName, const char * OldName);
+
+// In-memory files: lets jobs read data that was never written to disk
+// Lookup() returns false if file isn't in memory (then it's opened from disk)
+typedef bool (*tFileMemory)(void * Ctx, const char * FileName, const void ** ptrData, size_t * ptrSize);
+
+// Output sink: files written by current thread go to Put() instead of disk
+// Accept() is asked when file is opened for writing, Put() gets its whole
+// contents on fclose() (false - write failed)
+typedef bool (*tFileSinkAccept)(void * Ctx, const char * FileName);
+typedef bool (*tFileSinkPut)(void * Ctx, const char * FileName, const void * Data, size_t Size);
+
+// File stamp (quick change check without reading file)
+struct sFileStamp
+{
+	unsigned long long Size;	// Bytes
+	unsigned long long Time;	// Modification time, ns (or 100 ns on Windows)
+};
+
 size_t FileSize(FILE **ptrFile); // Reads file size
 void FileReadBlock(FILE **ptrSrcFile, void * DstBuff, size_t Addr, size_t Size); // Reads chunk from file
 void FileWriteBlock(FILE **ptrDstFile, const void * SrcBuff, size_t Addr, size_t Size); // Writes chunk to file
 void FileWriteBlock(FILE **ptrDstFile, const void * SrcBuff, size_t Size); // Writes chunk to file from prev. pos
-void SafeFileOpen(FILE **ptrFile, const char * FileName, const char * Mode); // Opens file, checks that everything is alright
+bool FileOpen(FILE **ptrFile, const char * FileName, const char * Mode); // Opens file, reports error and returns false on failure
+FILE * FileProbe(const char * FileName, const char * Mode); // Opens file quietly (NULL if it doesn't exist)
 void FileGetExtension(const char * Path, char * OutputBuffer, int OutputBufferSize); // Fetches extension from file name
 void FileGetName(const char * Path, char * OutputBuffer, int OutputBufferSize, bool WithExtension); // Fetches short name from full file name
 void FileGetFullName(const char * Path, char * OutputBuffer, int OutputBufferSize); // Cuts extension from full file name
@@ -36,8 +78,15 @@ void GenerateFolders(char * cPath); // Makes all dirs from the path if they don'
 void PatchSlashes(char * cPathBuff, int BuffSize, bool PakToFs); // Fixes slashes in path
 void ProgGetPath(char * OutputBuffer, int OutputBufferSize); // Gets path to the executable file
 void FileSafeRename(char * OldName, char * NewName); // Safe file rename
-void DirIterInit(const char * Dir); // Init/reset dir iterator
-void DirIterClose(); // Deinit dir iterator
-const char * DirIterGet(); // Dir iterator, returns NULL on end
+void FileSetHook(tFileHook Hook, void * Ctx); // Watch files accessed by current thread (NULL - stop)
+void FileGetHook(tFileHook * Hook, void ** Ctx); // Get current hook (to chain it)
+void FileSetMemory(tFileMemory Lookup, void * Ctx); // Read files of current thread through Lookup first (NULL - stop)
+bool FileSetSink(tFileSinkAccept Accept, tFileSinkPut Put, void * Ctx); // Redirect writes of current thread (NULL - stop), false - not supported on this platform
+bool FileGetStamp(const char * FileName, sFileStamp * Stamp); // Get size and modification time (false if file doesn't exist)
+bool FileClone(const char * SrcName, const char * DstName, bool AllowHardLink); // Reflink, hard link (if allowed) or copy file, replaces DstName
+void DelDir(const char * DirName); // Removes empty dir
+void DirIterInit(sDirIter * Iter, const char * Dir); // Init dir iterator
+void DirIterClose(sDirIter * Iter); // Deinit dir iterator
+const char * DirIterGet(sDirIter * Iter); // Dir iterator, returns NULL on end
 
 #endif
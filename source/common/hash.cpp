@@ -0,0 +1,200 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains streaming MurmurHash3 (x64, 128 bit)
+// and helpers to hash files
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <string.h>
+#include "ps2hl.h"
+#include "perf.h"
+#include "hash.h"
+
+////////// Definitions //////////
+#define HASH_FILE_BUF 0x10000		// File hashing buffer size
+#define HASH_ROTL(X, R) (((X) << (R)) | ((X) >> (64 - (R))))
+
+static tHashU64 HashFmix(tHashU64 K)
+{
+	K ^= K >> 33;
+	K *= 0xff51afd7ed558ccdULL;
+	K ^= K >> 33;
+	K *= 0xc4ceb9fe1a85ec53ULL;
+	K ^= K >> 33;
+
+	return K;
+}
+
+static tHashU64 HashLoad(const uchar * Data, int Size)	// Little endian load of up to 8 bytes
+{
+	tHashU64 Result = 0;
+
+	for (int i = Size - 1; i >= 0; i--)
+		Result = (Result << 8) | Data[i];
+
+	return Result;
+}
+
+static void HashMix(sHash * Hash, tHashU64 K1, tHashU64 K2)
+{
+	K1 *= 0x87c37b91114253d5ULL;
+	K1 = HASH_ROTL(K1, 31);
+	K1 *= 0x4cf5ad432745937fULL;
+	Hash->H1 ^= K1;
+
+	K2 *= 0x4cf5ad432745937fULL;
+	K2 = HASH_ROTL(K2, 33);
+	K2 *= 0x87c37b91114253d5ULL;
+	Hash->H2 ^= K2;
+}
+
+static void HashBlock(sHash * Hash, const uchar * Block)
+{
+	HashMix(Hash, HashLoad(Block, 8), 0);
+	Hash->H1 = HASH_ROTL(Hash->H1, 27);
+	Hash->H1 += Hash->H2;
+	Hash->H1 = Hash->H1 * 5 + 0x52dce729;
+
+	HashMix(Hash, 0, HashLoad(&Block[8], 8));
+	Hash->H2 = HASH_ROTL(Hash->H2, 31);
+	Hash->H2 += Hash->H1;
+	Hash->H2 = Hash->H2 * 5 + 0x38495ab5;
+}
+
+////////// Functions //////////
+void HashInit(sHash * Hash, tHashU64 Seed)
+{
+	Hash->H1 = Seed;
+	Hash->H2 = Seed;
+	Hash->Len = 0;
+	Hash->TailLen = 0;
+}
+
+void HashUpdate(sHash * Hash, const void * Data, size_t Size)
+{
+	const uchar * Pos = (const uchar *)Data;
+
+	Hash->Len += Size;
+
+	// Complete block left from previous call
+	if (Hash->TailLen > 0)
+	{
+		while (Size > 0 && Hash->TailLen < 16)
+		{
+			Hash->Tail[Hash->TailLen++] = *Pos++;
+			Size--;
+		}
+		if (Hash->TailLen < 16)
+			return;
+		HashBlock(Hash, Hash->Tail);
+		Hash->TailLen = 0;
+	}
+
+	for (; Size >= 16; Size -= 16, Pos += 16)
+		HashBlock(Hash, Pos);
+
+	memcpy(Hash->Tail, Pos, Size);
+	Hash->TailLen = Size;
+}
+
+void HashStr(sHash * Hash, const char * Str)
+{
+	HashUpdate(Hash, Str, strlen(Str) + 1);
+}
+
+void HashFinal(sHash * Hash, uchar * Out)
+{
+	tHashU64 H1, H2;
+
+	// Tail (K1 - first 8 bytes, K2 - the rest)
+	HashMix(Hash, HashLoad(Hash->Tail, (Hash->TailLen < 8) ? Hash->TailLen : 8),
+		(Hash->TailLen > 8) ? HashLoad(&Hash->Tail[8], Hash->TailLen - 8) : 0);
+
+	H1 = Hash->H1 ^ Hash->Len;
+	H2 = Hash->H2 ^ Hash->Len;
+	H1 += H2;
+	H2 += H1;
+	H1 = HashFmix(H1);
+	H2 = HashFmix(H2);
+	H1 += H2;
+	H2 += H1;
+
+	for (int i = 0; i < 8; i++)
+	{
+		Out[i] = (uchar)(H1 >> (i * 8));
+		Out[i + 8] = (uchar)(H2 >> (i * 8));
+	}
+}
+
+bool HashFile(const char * FileName, uchar * Out)
+{
+	sHash Hash;
+	FILE * ptrFile;
+	uchar * Buffer;
+	size_t Size;
+
+	Buffer = (uchar *)LibAlloc(HASH_FILE_BUF);
+	if (Buffer == NULL)
+		return false;
+
+	// Not FileOpen(): missing side files are normal
+	ptrFile = fopen(FileName, "rb");
+	PERF_ADD(PERF_OPENS, 1);
+	if (ptrFile == NULL)
+	{
+		LibFree(Buffer);
+		return false;
+	}
+
+	HashInit(&Hash, 0);
+	while ((Size = fread(Buffer, 1, HASH_FILE_BUF, ptrFile)) != 0)
+	{
+		PERF_ADD(PERF_READS, 1);
+		PERF_ADD(PERF_BYTES_READ, Size);
+		HashUpdate(&Hash, Buffer, Size);
+	}
+	HashFinal(&Hash, Out);
+
+	fclose(ptrFile);
+	LibFree(Buffer);
+
+	return true;
+}
+
+void HashToHex(const uchar * Hash, char * Out)
+{
+	const char * Digits = "0123456789abcdef";
+
+	for (int i = 0; i < HASH_SIZE; i++)
+	{
+		Out[i * 2] = Digits[Hash[i] >> 4];
+		Out[i * 2 + 1] = Digits[Hash[i] & 0x0F];
+	}
+	Out[HASH_SIZE * 2] = '\0';
+}
+
+bool HashFromHex(const char * Hex, uchar * Out)
+{
+	int Digit[2];
+
+	for (int i = 0; i < HASH_SIZE; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			char Ch = Hex[i * 2 + j];
+
+			if (Ch >= '0' && Ch <= '9')
+				Digit[j] = Ch - '0';
+			else if (Ch >= 'a' && Ch <= 'f')
+				Digit[j] = Ch - 'a' + 10;
+			else
+				return false;
+		}
+		Out[i] = (uchar)((Digit[0] << 4) | Digit[1]);
+	}
+
+	return Hex[HASH_SIZE * 2] == '\0';
+}
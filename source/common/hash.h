@@ -0,0 +1,33 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include "types.h"
+
+#define HASH_SIZE		16		// Hash size, bytes
+#define HASH_HEX_LEN	33		// Hex string size (with '\0')
+
+typedef unsigned long long tHashU64;
+
+// Streaming MurmurHash3 (x64, 128 bit), used to identify file contents
+// (conversion cache, build graph). Not a cryptographic hash.
+struct sHash
+{
+	tHashU64 H1, H2;			// State
+	tHashU64 Len;				// Bytes hashed
+	uchar Tail[16];				// Incomplete block
+	int TailLen;				//
+};
+
+void HashInit(sHash * Hash, tHashU64 Seed);							// Start new hash
+void HashUpdate(sHash * Hash, const void * Data, size_t Size);			// Add data (any chunk size)
+void HashStr(sHash * Hash, const char * Str);							// Add string with terminator (so "ab","c" != "a","bc")
+void HashFinal(sHash * Hash, uchar * Out);								// Get result (HASH_SIZE bytes)
+bool HashFile(const char * FileName, uchar * Out);						// Hash file contents (false if file can't be read)
+void HashToHex(const uchar * Hash, char * Out);							// Hex string (HASH_HEX_LEN bytes)
+bool HashFromHex(const char * Hex, uchar * Out);						// Parse hex string (false if it's malformed)
+
+#endif // HASH_H
@@ -0,0 +1,134 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains job dispatch shared by batch front-ends:
+// tool lookup by name and by file magic
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <string.h>
+#include "ps2hl.h"
+#include "perf.h"
+#include "fops.h"
+#include "jobs.h"
+#include "cache.h"
+
+////////// Globals //////////
+// Sniff order matters: strong magic first, PHD (zero filled header) last
+static const sJobTool JobTools[] =
+{
+	{ "pak", "test extract pack pack16 cpack gpack decompress compress",	pak::RunJob, pak::SniffFile, pak::JobVersion, pak::LintFile, NULL, NULL, NULL },
+	{ "mdl", "extract seqrep",												mdl::RunJob, mdl::SniffFile, mdl::JobVersion, mdl::LintFile, mdl::DescribeFile, mdl::GenerateFile, mdl::BenchKernels },
+	{ "spr", "noresize lin",												spr::RunJob, spr::SniffFile, spr::JobVersion, spr::LintFile, spr::DescribeFile, spr::GenerateFile, spr::BenchKernels },
+	{ "psi", "",															psi::RunJob, psi::SniffFile, psi::JobVersion, psi::LintFile, psi::DescribeFile, psi::GenerateFile, NULL },
+	{ "txt", "",															txt::RunJob, txt::SniffFile, txt::JobVersion, NULL, NULL, NULL, NULL },
+	{ "mus", "patch unpatch test",											mus::RunJob, mus::SniffFile, mus::JobVersion, mus::LintFile, mus::DescribeFile, mus::GenerateFile, NULL },
+	{ "nod", "test",														nod::RunJob, nod::SniffFile, nod::JobVersion, nod::LintFile, nod::DescribeFile, nod::GenerateFile, NULL },
+	{ "epc", "",															epc::RunJob, epc::SniffFile, epc::JobVersion, epc::LintFile, NULL, NULL, NULL },
+	{ "phd", "topng",														phd::RunJob, phd::SniffFile, phd::JobVersion, phd::LintFile, phd::DescribeFile, phd::GenerateFile, phd::BenchKernels }
+};
+#define JOB_TOOL_COUNT (int)(sizeof(JobTools) / sizeof(JobTools[0]))
+
+////////// Functions //////////
+bool JobIsAuto(const char * Command)
+{
+	return Command == NULL || Command[0] == '\0' || !strcmp(Command, JOB_CMD_AUTO);
+}
+
+const sJobTool * JobGetTool(int Index)
+{
+	if (Index < 0 || Index >= JOB_TOOL_COUNT)
+		return NULL;
+
+	return &JobTools[Index];
+}
+
+const sJobTool * JobFindTool(const char * Name)
+{
+	for (int i = 0; i < JOB_TOOL_COUNT; i++)
+		if (!strcmp(JobTools[i].Name, Name))
+			return &JobTools[i];
+
+	return NULL;
+}
+
+bool JobHasCommand(const sJobTool * Tool, const char * Command)
+{
+	const char * Pos = Tool->Commands;
+	size_t Len = strlen(Command);
+
+	if (Len == 0)
+		return false;
+
+	// Look for whole word in command list
+	while ((Pos = strstr(Pos, Command)) != NULL)
+	{
+		if ((Pos == Tool->Commands || Pos[-1] == ' ') && (Pos[Len] == ' ' || Pos[Len] == '\0'))
+			return true;
+		Pos += Len;
+	}
+
+	return false;
+}
+
+const sJobTool * JobSniffTool(const char * FileName)
+{
+	// Directories can't be sniffed, they need explicit command (pak pack, etc.)
+	if (CheckDir(FileName) == true)
+		return NULL;
+
+	for (int i = 0; i < JOB_TOOL_COUNT; i++)
+		if (JobTools[i].Sniff(FileName) == true)
+			return &JobTools[i];
+
+	return NULL;
+}
+
+int JobRun(const char * ToolName, const char * Command, const char * FileName)
+{
+	const sJobTool * Tool;
+	FILE * ptrFile;
+
+	PERF_SCOPE(PERF_PH_JOB);
+
+	if (JobIsAuto(ToolName) == true)
+	{
+		if (CheckDir(FileName) == true)
+		{
+			LibMsg(MSG_ERROR, "Directory needs explicit tool and command (i.e. \"pak pack\"): %s \n", FileName);
+			return PS2HL_ERR_PARAM;
+		}
+
+		// Check that file is readable before sniffing
+		ptrFile = fopen(FileName, "rb");
+		if (ptrFile == NULL)
+		{
+			LibMsg(MSG_ERROR, "Error: can't open file: %s \n", FileName);
+			return PS2HL_ERR_OPEN;
+		}
+		fclose(ptrFile);
+
+		Tool = JobSniffTool(FileName);
+		if (Tool == NULL)
+		{
+			LibMsg(MSG_ERROR, "Can't recognise file (specify tool explicitly): %s \n", FileName);
+			return PS2HL_ERR_FORMAT;
+		}
+	}
+	else
+	{
+		Tool = JobFindTool(ToolName);
+		if (Tool == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unknown tool: %s \n", ToolName);
+			return PS2HL_ERR_PARAM;
+		}
+	}
+
+	if (CacheEnabled() == true)
+		return CacheRunJob(Tool, Command, FileName);
+
+	return Tool->Run(Command, FileName);
+}
@@ -0,0 +1,62 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include "types.h"
+
+#define JOB_CMD_AUTO "auto"		// Default action for given file (same as drag and drop on a tool)
+
+struct sLintFile;
+struct sCatalogInfo;
+struct sCorpusSpec;
+struct sBench;
+
+// Job entry points of each tool (implemented at the end of <tool>/<tool>.cpp)
+// RunJob() - non-interactive command dispatch, returns PS2HL_OK or error code
+// SniffFile() - true if file looks like something this tool can handle (checked by magic)
+// JobVersion() - tool title with version (part of conversion cache key)
+// LintFile() - check file against PS2 HL limits, issues go to LintReport(), returns PS2HL_ERR_OPEN if file can't be read
+// DescribeFile() - fill catalog properties of file, returns PS2HL_OK, PS2HL_ERR_OPEN or PS2HL_ERR_FORMAT
+// GenerateFile() - write synthetic PC file for corpus (format is chosen by extension), returns PS2HL_OK or error
+// BenchKernels() - run microbenchmarks of tool kernels through BenchRun()
+namespace pak { int RunJob(const char * Command, const char * FileName); bool SniffFile(const char * FileName); const char * JobVersion(); int LintFile(const char * FileName, sLintFile * Lint); }
+namespace mdl { int RunJob(const char * Command, const char * FileName); bool SniffFile(const char * FileName); const char * JobVersion(); int LintFile(const char * FileName, sLintFile * Lint); int DescribeFile(const char * FileName, sCatalogInfo * Info); int GenerateFile(const char * FileName, sCorpusSpec * Spec); void BenchKernels(sBench * Bench); }
+namespace spr { int RunJob(const char * Command, const char * FileName); bool SniffFile(const char * FileName); const char * JobVersion(); int LintFile(const char * FileName, sLintFile * Lint); int DescribeFile(const char * FileName, sCatalogInfo * Info); int GenerateFile(const char * FileName, sCorpusSpec * Spec); void BenchKernels(sBench * Bench); }
+namespace psi { int RunJob(const char * Command, const char * FileName); bool SniffFile(const char * FileName); const char * JobVersion(); int LintFile(const char * FileName, sLintFile * Lint); int DescribeFile(const char * FileName, sCatalogInfo * Info); int GenerateFile(const char * FileName, sCorpusSpec * Spec); }
+namespace phd { int RunJob(const char * Command, const char * FileName); bool SniffFile(const char * FileName); const char * JobVersion(); int LintFile(const char * FileName, sLintFile * Lint); int DescribeFile(const char * FileName, sCatalogInfo * Info); int GenerateFile(const char * FileName, sCorpusSpec * Spec); void BenchKernels(sBench * Bench); }
+namespace txt { int RunJob(const char * Command, const char * FileName); bool SniffFile(const char * FileName); const char * JobVersion(); }
+namespace mus { int RunJob(const char * Command, const char * FileName); bool SniffFile(const char * FileName); const char * JobVersion(); int LintFile(const char * FileName, sLintFile * Lint); int DescribeFile(const char * FileName, sCatalogInfo * Info); int GenerateFile(const char * FileName, sCorpusSpec * Spec); }
+namespace nod { int RunJob(const char * Command, const char * FileName); bool SniffFile(const char * FileName); const char * JobVersion(); int LintFile(const char * FileName, sLintFile * Lint); int DescribeFile(const char * FileName, sCatalogInfo * Info); int GenerateFile(const char * FileName, sCorpusSpec * Spec); }
+namespace epc { int RunJob(const char * Command, const char * FileName); bool SniffFile(const char * FileName); const char * JobVersion(); int LintFile(const char * FileName, sLintFile * Lint); }
+
+// Tool descriptor
+typedef int (*tJobRun)(const char * Command, const char * FileName);
+typedef bool (*tJobSniff)(const char * FileName);
+typedef const char * (*tJobVersion)();
+typedef int (*tJobLint)(const char * FileName, sLintFile * Lint);
+typedef int (*tJobDescribe)(const char * FileName, sCatalogInfo * Info);
+typedef int (*tJobGenerate)(const char * FileName, sCorpusSpec * Spec);
+typedef void (*tJobBench)(sBench * Bench);
+struct sJobTool
+{
+	const char * Name;			// Subcommand name ("pak", "mdl", ...)
+	const char * Commands;		// Space separated list of supported commands (besides "auto")
+	tJobRun Run;				// Command dispatch
+	tJobSniff Sniff;			// Format check
+	tJobVersion Version;		// Tool version
+	tJobLint Lint;				// Validator (NULL - nothing to check)
+	tJobDescribe Describe;		// Catalog properties (NULL - nothing but size)
+	tJobGenerate Generate;		// Corpus generator (NULL - tool has no sources to make)
+	tJobBench Bench;			// Kernel microbenchmarks (NULL - none)
+};
+
+bool JobIsAuto(const char * Command);											// Check if command means default action
+const sJobTool * JobGetTool(int Index);											// Enumerate tools (NULL after last one)
+const sJobTool * JobFindTool(const char * Name);								// Find tool by name (NULL if not found)
+bool JobHasCommand(const sJobTool * Tool, const char * Command);				// Check if tool supports command
+const sJobTool * JobSniffTool(const char * FileName);							// Find tool by file magic (NULL if unknown)
+int JobRun(const char * ToolName, const char * Command, const char * FileName);	// Run job (ToolName NULL or "auto" - sniff file)
+
+#endif // JOBS_H
@@ -0,0 +1,357 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains lint of whole game or mod tree: files are sniffed
+// and checked by validators of their tools on thread pool, PAKs are
+// loaded in memory and their entries are checked the same way (each PAK
+// is checked by one worker). Validators run muted, everything they find
+// goes to one report which is sorted and printed at the end.
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "thpool.h"		// Goes first: sets up windows.h version
+#include "ps2hl.h"
+#include "fops.h"
+#include "jobs.h"
+#include "lint.h"
+
+////////// Definitions //////////
+#define LINT_MAX_TOOLS	16		// Counters per tool
+#define LINT_MSG_LEN	512		// Max issue text length (without file name)
+
+////////// Structures //////////
+
+// Tool of files that aren't recognised by magic (validator reports what's wrong)
+struct sLintExt
+{
+	const char * Ext;
+	const char * Tool;
+};
+
+// Issue in report
+struct sLintIssue
+{
+	int Level;					// LINT_ERROR or LINT_WARN
+	char * Text;				// "name: level: message"
+};
+
+// Lint session
+struct sLint
+{
+	char Dir[PATH_LEN];			// With trailing delimiter
+	sThreadPool Pool;			// Workers
+	bool HasPool;				// false - check in place
+	tMutex Lock;				// Protects everything below
+	sLintIssue * Issues;		// Report
+	int Count;					//
+	int Size;					// Allocated
+	int Checked[LINT_MAX_TOOLS];	// Checked files of each tool
+	int Files;					// Counters
+	int Entries;				//
+	int Unknown;				//
+	int Unchecked;				//
+	int Errors;					//
+	int Warnings;				//
+};
+
+// File or PAK entry being checked (lives on stack of worker)
+struct sLintFile
+{
+	sLint * Lint;				// Owner
+	const char * Name;			// Name in report (relative, PAK entries - PAK name/entry)
+	const char * FullName;		// Name validator gets
+	const uchar * Data;			// PAK entry contents (NULL - file on disk)
+	ulong Size;					//
+};
+
+// Loose file
+struct sLintTask
+{
+	sLint * Lint;
+	char * FullName;
+};
+
+////////// Globals //////////
+static const sLintExt LintExts[] =
+{
+	{ ".pak", "pak" },
+	{ ".dol", "mdl" },
+	{ ".mdl", "mdl" },
+	{ ".spz", "spr" },
+	{ ".spr", "spr" },
+	{ ".psi", "psi" },
+	{ ".vag", "mus" },
+	{ ".wav", "mus" },
+	{ ".nod", "nod" }
+};
+#define LINT_EXT_COUNT (int)(sizeof(LintExts) / sizeof(LintExts[0]))
+
+////////// Checks //////////
+static bool LintLookup(void * Ctx, const char * FileName, const void ** ptrData, size_t * ptrSize)
+{
+	sLintFile * File = (sLintFile *)Ctx;
+
+	if (strcmp(FileName, File->FullName))
+		return false;
+
+	*ptrData = File->Data;
+	*ptrSize = File->Size;
+	return true;
+}
+
+static const sJobTool * LintFindTool(const char * FileName)
+{
+	const sJobTool * Tool;
+	char Ext[5];
+
+	Tool = JobSniffTool(FileName);
+	if (Tool != NULL)
+		return Tool;
+
+	// Broken file with known extension is worth an error
+	FileGetExtension(FileName, Ext, sizeof(Ext));
+	for (int i = 0; i < LINT_EXT_COUNT; i++)
+		if (!strcmp(Ext, LintExts[i].Ext))
+			return JobFindTool(LintExts[i].Tool);
+
+	return NULL;
+}
+
+static bool LintIsSideFile(const char * FileName)	// *.inf next to *.mdl belongs to model
+{
+	char Ext[5];
+	char Main[PATH_LEN];
+	sFileStamp Stamp;
+
+	FileGetExtension(FileName, Ext, sizeof(Ext));
+	if (strcmp(Ext, ".inf"))
+		return false;
+
+	FileGetFullName(FileName, Main, sizeof(Main) - 4);
+	strcat(Main, ".mdl");
+	return FileGetStamp(Main, &Stamp);
+}
+
+static void LintCheck(sLintFile * File)
+{
+	sLint * Lint = File->Lint;
+	const sJobTool * Tool;
+	int Index = 0;
+	int Result = PS2HL_OK;
+
+	Tool = LintFindTool(File->FullName);
+	if (Tool != NULL && Tool->Lint != NULL)
+		Result = Tool->Lint(File->FullName, File);
+	if (Result != PS2HL_OK)
+		LintReport(File, LINT_ERROR, "can't check file (%s)", LibStatusStr(Result));
+
+	while (Tool != NULL && Index < LINT_MAX_TOOLS - 1 && JobGetTool(Index) != Tool)
+		Index++;
+
+	MutexLock(&Lint->Lock);
+	if (File->Data != NULL)
+		Lint->Entries++;
+	else
+		Lint->Files++;
+	if (Tool == NULL)
+		Lint->Unknown++;
+	else if (Tool->Lint == NULL)
+		Lint->Unchecked++;
+	else
+		Lint->Checked[Index]++;
+	MutexUnlock(&Lint->Lock);
+}
+
+static void LintTask(void * Arg)
+{
+	sLintTask * Task = (sLintTask *)Arg;
+	sLintFile File;
+
+	File.Lint = Task->Lint;
+	File.FullName = Task->FullName;
+	File.Name = Task->FullName + strlen(Task->Lint->Dir);
+	while (*File.Name == DIR_DELIM_CH)
+		File.Name++;
+	File.Data = NULL;
+	File.Size = 0;
+
+	// Validators report through LintReport(), their own messages are noise here
+	LibMuteThread(true);
+	LintCheck(&File);
+	LibMuteThread(false);
+
+	LibFree(Task->FullName);
+	LibFree(Task);
+}
+
+static int LintCompareIssues(const void * A, const void * B)
+{
+	return strcmp(((const sLintIssue *)A)->Text, ((const sLintIssue *)B)->Text);
+}
+
+static void LintPrint(sLint * Lint)
+{
+	char Tools[256];
+	size_t Len = 0;
+
+	qsort(Lint->Issues, Lint->Count, sizeof(sLintIssue), LintCompareIssues);
+	for (int i = 0; i < Lint->Count; i++)
+		LibMsg(Lint->Issues[i].Level == LINT_ERROR ? MSG_ERROR : MSG_WARN, "%s \n", Lint->Issues[i].Text);
+
+	Tools[0] = '\0';
+	for (int i = 0; i < LINT_MAX_TOOLS && JobGetTool(i) != NULL && Len < sizeof(Tools); i++)
+		if (Lint->Checked[i] != 0)
+			Len += snprintf(&Tools[Len], sizeof(Tools) - Len, "%s%s: %d", Len ? ", " : "", JobGetTool(i)->Name, Lint->Checked[i]);
+
+	LibMsg(MSG_INFO, "\nLint: %d files, %d PAK entries (%s), unknown: %d, not checked: %d \n",
+		Lint->Files, Lint->Entries, Tools, Lint->Unknown, Lint->Unchecked);
+	LibMsg(MSG_INFO, "Errors: %d, warnings: %d \n", Lint->Errors, Lint->Warnings);
+}
+
+////////// Functions //////////
+void LintReport(sLintFile * File, int Level, const char * Format, ...)
+{
+	sLint * Lint = File->Lint;
+	sLintIssue * NewIssues;
+	char Message[LINT_MSG_LEN];
+	char * Text;
+	size_t Len;
+	va_list Args;
+
+	va_start(Args, Format);
+	vsnprintf(Message, sizeof(Message), Format, Args);
+	va_end(Args);
+
+	Len = strlen(File->Name) + strlen(Message) + 16;
+	Text = (char *)LibAlloc(Len);
+	if (Text != NULL)
+		snprintf(Text, Len, "%s: %s: %s", File->Name, (Level == LINT_ERROR) ? "error" : "warning", Message);
+
+	MutexLock(&Lint->Lock);
+	if (Level == LINT_ERROR)
+		Lint->Errors++;
+	else
+		Lint->Warnings++;
+	if (Text != NULL && Lint->Count == Lint->Size)
+	{
+		NewIssues = (sLintIssue *)LibCalloc(Lint->Size ? Lint->Size * 2 : 64, sizeof(sLintIssue));
+		if (NewIssues != NULL)
+		{
+			if (Lint->Issues != NULL)
+				memcpy(NewIssues, Lint->Issues, Lint->Count * sizeof(sLintIssue));
+			LibFree(Lint->Issues);
+			Lint->Issues = NewIssues;
+			Lint->Size = Lint->Size ? Lint->Size * 2 : 64;
+		}
+	}
+	if (Text != NULL && Lint->Count < Lint->Size)
+	{
+		Lint->Issues[Lint->Count].Level = Level;
+		Lint->Issues[Lint->Count].Text = Text;
+		Lint->Count++;
+		Text = NULL;
+	}
+	MutexUnlock(&Lint->Lock);
+
+	LibFree(Text);	// Counted, but there is no room for text
+}
+
+void LintEntries(sLintFile * Pak, pak::sPAKImage * Image)
+{
+	char FullName[PATH_LEN];
+	char Name[PATH_LEN];
+	size_t Prefix = strlen(Pak->FullName) + 1;
+	sLintFile Entry;
+
+	for (int i = 0; i < pak::GetPAKEntryCount(Image); i++)
+	{
+		// Entries get names as if PAK was extracted in place
+		snprintf(FullName, sizeof(FullName), "%s" DIR_DELIM "%s", Pak->FullName, pak::GetPAKEntryName(Image, i));
+		if (strlen(FullName) > Prefix)
+			PatchSlashes(&FullName[Prefix], strlen(&FullName[Prefix]), true);
+		snprintf(Name, sizeof(Name), "%s/%s", Pak->Name, pak::GetPAKEntryName(Image, i));
+
+		Entry.Lint = Pak->Lint;
+		Entry.Name = Name;
+		Entry.FullName = FullName;
+		Entry.Data = pak::GetPAKEntryData(Image, i, &Entry.Size);
+
+		FileSetMemory(LintLookup, &Entry);
+		LintCheck(&Entry);
+		FileSetMemory(NULL, NULL);
+	}
+}
+
+int LintRun(const char * Dir, int Threads)
+{
+	sLint * Lint;
+	sLintTask * Task;
+	sDirIter Iter;
+	const char * FullName;
+	size_t Len = strlen(Dir);
+	int Result;
+
+	Lint = (sLint *)LibCalloc(1, sizeof(sLint));
+	if (Lint == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+
+	if (CheckDir(Dir) == false || Len == 0 || Len + 2 >= PATH_LEN)
+	{
+		LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+		LibFree(Lint);
+		return PS2HL_ERR_PARAM;
+	}
+	strcpy(Lint->Dir, Dir);
+	if (Lint->Dir[Len - 1] != DIR_DELIM_CH && Lint->Dir[Len - 1] != DIR_NOT_DELIM_CH)
+		strcat(Lint->Dir, DIR_DELIM);
+
+	MutexInit(&Lint->Lock);
+	if (Threads > 1)
+		Lint->HasPool = PoolStart(&Lint->Pool, Threads);
+
+	DirIterInit(&Iter, Lint->Dir);
+	while ((FullName = DirIterGet(&Iter)) != NULL)
+	{
+		if (LintIsSideFile(FullName) == true)
+			continue;
+
+		Task = (sLintTask *)LibCalloc(1, sizeof(sLintTask));
+		if (Task != NULL)
+			Task->FullName = (char *)LibAlloc(strlen(FullName) + 1);
+		if (Task == NULL || Task->FullName == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			LibFree(Task);
+			continue;
+		}
+		strcpy(Task->FullName, FullName);
+		Task->Lint = Lint;
+
+		if (Lint->HasPool == false || PoolAdd(&Lint->Pool, LintTask, Task) == false)
+			LintTask(Task);
+	}
+	DirIterClose(&Iter);
+
+	if (Lint->HasPool == true)
+		PoolStop(&Lint->Pool);
+	MutexDestroy(&Lint->Lock);
+
+	LintPrint(Lint);
+	if (Lint->Files == 0)
+		LibMsg(MSG_WARN, "Warning: nothing to check in %s \n", Dir);
+
+	Result = (Lint->Errors == 0) ? PS2HL_OK : PS2HL_ERR_FORMAT;
+	for (int i = 0; i < Lint->Count; i++)
+		LibFree(Lint->Issues[i].Text);
+	LibFree(Lint->Issues);
+	LibFree(Lint);
+	return Result;
+}
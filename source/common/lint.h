@@ -0,0 +1,24 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef LINT_H
+#define LINT_H
+
+#include "types.h"
+#include "pakimg.h"
+
+// Lint of game or mod tree: every file (and every entry of every PAK) is
+// sniffed and checked by validator of its tool (LintFile() of each tool,
+// see jobs.h) against PS2 HL limits. Files are checked on thread pool,
+// issues are collected into one report sorted by file name.
+
+#define LINT_ERROR	0			// Issue levels: game won't load it
+#define LINT_WARN	1			//               may work, but doesn't look right
+
+struct sLintFile;
+
+void LintReport(sLintFile * Lint, int Level, const char * Format, ...);	// Add issue of file (validators call it)
+void LintEntries(sLintFile * Lint, pak::sPAKImage * Image);				// Check entries of loaded PAK (PAK validator calls it)
+int LintRun(const char * Dir, int Threads);								// Check everything in Dir (Threads <= 1 - in place), returns PS2HL_OK if there are no errors
+
+#endif // LINT_H
@@ -0,0 +1,497 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains buffered logger for front-ends:
+// level filter, text/JSONL output and rate-limited progress bar
+//
+// Async mode: every thread owns a single producer/single consumer ring
+// buffer, so logging never takes a lock. Background writer drains all
+// buffers every few ms. Messages of one thread keep their order,
+// messages of different threads never mix within a line.
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "ps2hl.h"
+#include "perf.h"
+#include "thpool.h"
+#include "log.h"
+
+#ifdef _WIN32
+	#include <io.h>
+	#define LOG_ISATTY(FILE)	_isatty(_fileno(FILE))
+#else
+	#include <time.h>
+	#include <unistd.h>
+	#define LOG_ISATTY(FILE)	isatty(fileno(FILE))
+#endif
+
+////////// Definitions //////////
+#define LOG_BUF_SIZE		0x10000		// Per thread ring buffer size (power of 2)
+#define LOG_WRITER_MS		10			// Writer wakes up this often
+#define LOG_PROGRESS_MS		100			// Min interval between progress updates
+#define LOG_BAR_WIDTH		30			// Progress bar width in characters
+
+#define LOG_REC_MSG			0			// Record types
+#define LOG_REC_PROGRESS	1			//
+
+////////// Structures //////////
+
+// Record header (text follows it in ring buffer)
+struct sLogRecord
+{
+	uint Size;			// Text size (without terminating zero)
+	uint Seq;			// Global record number (records are written in this order)
+	uint Time;			// ms since logger start
+	int Type;			// LOG_REC_*
+	int Level;			// MSG_* level
+	int Tid;			// Thread number
+	ulong Done;			// Progress
+	ulong Total;		//
+};
+
+// Per thread ring buffer
+struct sLogBuffer
+{
+	char Data[LOG_BUF_SIZE];
+	uint Head;				// Write position (owner thread only)
+	uint Tail;				// Read position (writer only)
+	uint Pending;			// Head snapshot for current drain (writer only)
+	sLogBuffer * Next;		// Next buffer in global list
+};
+
+////////// Globals //////////
+static const char * LogLevelName[] = { "error", "warn", "info", "debug" };
+
+static bool LogStarted = false;
+static bool LogAsync = false;
+static int LogLevel = MSG_INFO;
+static int LogFormat = LOG_TEXT;
+static bool LogTTY = false;						// Progress bar is drawn on terminal only
+static uint LogStartTime = 0;
+static uint LogLastProgress = 0;				// Time of last progress record (+1, 0 - none yet)
+
+static tMutex LogLock;							// Protects buffer list and output
+static bool LogLockReady = false;				//
+static sLogBuffer * LogBuffers = NULL;			// Buffers of all threads
+static int LogThreadCount = 0;					//
+static uint LogSeq = 0;							// Next record number
+static uint LogNextSeq = 0;						// Next record number to write (LogLock)
+static tThread LogWriter;						// Background writer
+static volatile bool LogStopping = false;		//
+
+static char LogBar[LOG_BAR_WIDTH + 64] = "";	// Last drawn progress bar ("" - none)
+
+static __thread sLogBuffer * LogSelf = NULL;	// Buffer of current thread
+static __thread int LogTid = -1;				// Number of current thread
+
+////////// Platform wrappers //////////
+#ifdef _WIN32
+
+static uint LogNow()	// ms
+{
+	return GetTickCount();
+}
+
+#else // linux
+
+static uint LogNow()	// ms
+{
+	struct timespec Time;
+
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return (uint)(Time.tv_sec * 1000 + Time.tv_nsec / 1000000);
+}
+
+#endif
+
+////////// Output (caller holds LogLock) //////////
+static void LogEraseBar()
+{
+	int Len = strlen(LogBar);
+
+	if (Len == 0)
+		return;
+
+	fprintf(stdout, "\r%*s\r", Len, "");
+}
+
+static void LogJSONString(const char * Text, uint Size)
+{
+	uint Start = 0;
+
+	// Trim whitespace, text output uses it for layout
+	while (Start < Size && (uchar)Text[Start] <= ' ')
+		Start++;
+	while (Size > Start && (uchar)Text[Size - 1] <= ' ')
+		Size--;
+
+	fputc('"', stdout);
+	for (uint i = Start; i < Size; i++)
+	{
+		uchar Ch = Text[i];
+
+		if (Ch == '"' || Ch == '\\')
+			fprintf(stdout, "\\%c", Ch);
+		else if (Ch == '\n')
+			fputs("\\n", stdout);
+		else if (Ch == '\t')
+			fputs("\\t", stdout);
+		else if (Ch < ' ')
+			fprintf(stdout, "\\u%04x", Ch);
+		else
+			fputc(Ch, stdout);
+	}
+	fputc('"', stdout);
+}
+
+static void LogOutput(const sLogRecord * Record, const char * Text)
+{
+	PERF_SCOPE(PERF_PH_CONSOLE);
+
+	if (LogFormat == LOG_JSONL)
+	{
+		fprintf(stdout, "{\"t\":%u.%03u,\"tid\":%d,", Record->Time / 1000, Record->Time % 1000, Record->Tid);
+		if (Record->Type == LOG_REC_PROGRESS)
+		{
+			fprintf(stdout, "\"level\":\"progress\",\"done\":%lu,\"total\":%lu}\n", (unsigned long)Record->Done, (unsigned long)Record->Total);
+		}
+		else
+		{
+			fprintf(stdout, "\"level\":\"%s\",\"msg\":", LogLevelName[Record->Level]);
+			LogJSONString(Text, Record->Size);
+			fputs("}\n", stdout);
+		}
+		return;
+	}
+
+	if (Record->Type == LOG_REC_PROGRESS)
+	{
+		int Fill = (Record->Total != 0) ? (int)((double)Record->Done / Record->Total * LOG_BAR_WIDTH) : LOG_BAR_WIDTH;
+		char Line[LOG_BAR_WIDTH + 1];
+
+		if (Fill > LOG_BAR_WIDTH)
+			Fill = LOG_BAR_WIDTH;
+		memset(Line, '#', Fill);
+		memset(Line + Fill, '.', LOG_BAR_WIDTH - Fill);
+		Line[LOG_BAR_WIDTH] = '\0';
+
+		LogEraseBar();
+		snprintf(LogBar, sizeof(LogBar), "[%s] %lu/%lu", Line, (unsigned long)Record->Done, (unsigned long)Record->Total);
+		fputs(LogBar, stdout);
+
+		// Finished - leave it on screen
+		if (Record->Done >= Record->Total)
+		{
+			fputc('\n', stdout);
+			LogBar[0] = '\0';
+		}
+		return;
+	}
+
+	// Message goes above the bar
+	LogEraseBar();
+	fwrite(Text, 1, Record->Size, stdout);
+	if (LogBar[0] != '\0')
+		fputs(LogBar, stdout);
+}
+
+////////// Ring buffers //////////
+static sLogBuffer * LogGetBuffer()
+{
+	sLogBuffer * Buffer;
+
+	if (LogSelf != NULL)
+		return LogSelf;
+
+	// Not LibAlloc(): logger outlives library calls and shouldn't use user allocator
+	Buffer = (sLogBuffer *)calloc(1, sizeof(sLogBuffer));
+	if (Buffer == NULL)
+		return NULL;
+
+	MutexLock(&LogLock);
+	Buffer->Next = LogBuffers;
+	LogBuffers = Buffer;
+	MutexUnlock(&LogLock);
+
+	LogSelf = Buffer;
+	return Buffer;
+}
+
+static void LogRingWrite(sLogBuffer * Buffer, uint Pos, const void * Src, uint Size)
+{
+	uint Offset = Pos & (LOG_BUF_SIZE - 1);
+	uint First = LOG_BUF_SIZE - Offset;
+
+	if (First > Size)
+		First = Size;
+	memcpy(&Buffer->Data[Offset], Src, First);
+	memcpy(&Buffer->Data[0], (const char *)Src + First, Size - First);
+}
+
+static void LogRingRead(sLogBuffer * Buffer, uint Pos, void * Dst, uint Size)
+{
+	uint Offset = Pos & (LOG_BUF_SIZE - 1);
+	uint First = LOG_BUF_SIZE - Offset;
+
+	if (First > Size)
+		First = Size;
+	memcpy(Dst, &Buffer->Data[Offset], First);
+	memcpy((char *)Dst + First, &Buffer->Data[0], Size - First);
+}
+
+static void LogDrain(bool Force)	// Caller holds LogLock (Force - don't wait for records that aren't published yet)
+{
+	sLogRecord Record, Next;
+	sLogBuffer * Oldest;
+	char Text[1024 + 1];
+	bool Wrote = false;
+
+	// Take what is published so far
+	for (sLogBuffer * Buffer = LogBuffers; Buffer != NULL; Buffer = Buffer->Next)
+		Buffer->Pending = __atomic_load_n(&Buffer->Head, __ATOMIC_ACQUIRE);
+
+	// Merge buffers by record number
+	for (;;)
+	{
+		Oldest = NULL;
+		for (sLogBuffer * Buffer = LogBuffers; Buffer != NULL; Buffer = Buffer->Next)
+		{
+			if (Buffer->Tail == Buffer->Pending)
+				continue;
+
+			LogRingRead(Buffer, Buffer->Tail, &Next, sizeof(Next));
+			if (Oldest == NULL || (int)(Next.Seq - Record.Seq) < 0)
+			{
+				Oldest = Buffer;
+				Record = Next;
+			}
+		}
+		if (Oldest == NULL)
+			break;
+
+		// Thread that took earlier number hasn't published its record yet
+		if (Force == false && (int)(Record.Seq - LogNextSeq) > 0)
+			break;
+
+		LogRingRead(Oldest, Oldest->Tail + sizeof(Record), Text, Record.Size);
+		Text[Record.Size] = '\0';
+		__atomic_store_n(&Oldest->Tail, Oldest->Tail + sizeof(Record) + Record.Size, __ATOMIC_RELEASE);
+
+		if ((int)(Record.Seq - LogNextSeq) >= 0)
+			LogNextSeq = Record.Seq + 1;
+		LogOutput(&Record, Text);
+		Wrote = true;
+	}
+
+	if (Wrote == true)
+		fflush(stdout);
+}
+
+static void LogWriterLoop(void * Arg)
+{
+	(void)Arg;
+
+	while (__atomic_load_n(&LogStopping, __ATOMIC_ACQUIRE) == false)
+	{
+		MutexLock(&LogLock);
+		LogDrain(false);
+		MutexUnlock(&LogLock);
+
+		ThreadSleep(LOG_WRITER_MS);
+	}
+}
+
+static void LogPut(sLogRecord * Record, const char * Text)
+{
+	sLogBuffer * Buffer;
+	uint Need;
+
+	if (LogTid < 0)
+		LogTid = __sync_fetch_and_add(&LogThreadCount, 1);
+	Record->Tid = LogTid;
+	Record->Seq = __sync_fetch_and_add(&LogSeq, 1);
+	Record->Time = LogNow() - LogStartTime;
+
+	// Sync mode or no memory for buffer - write in place
+	Buffer = LogAsync ? LogGetBuffer() : NULL;
+	if (Buffer == NULL)
+	{
+		MutexLock(&LogLock);
+		LogDrain(false);
+		if ((int)(Record->Seq - LogNextSeq) >= 0)
+			LogNextSeq = Record->Seq + 1;
+		LogOutput(Record, Text);
+		fflush(stdout);
+		MutexUnlock(&LogLock);
+		return;
+	}
+
+	// Wait for free space (writer drains buffer every LOG_WRITER_MS)
+	Need = sizeof(sLogRecord) + Record->Size;
+	while (LOG_BUF_SIZE - (Buffer->Head - __atomic_load_n(&Buffer->Tail, __ATOMIC_ACQUIRE)) < Need)
+		ThreadSleep(1);
+
+	LogRingWrite(Buffer, Buffer->Head, Record, sizeof(sLogRecord));
+	LogRingWrite(Buffer, Buffer->Head + sizeof(sLogRecord), Text, Record->Size);
+	__atomic_store_n(&Buffer->Head, Buffer->Head + Need, __ATOMIC_RELEASE);
+}
+
+////////// Library callbacks //////////
+static void LogMsgCallback(void * Ctx, int Level, const char * Text)
+{
+	sLogRecord Record;
+	(void)Ctx;
+
+	if ((Level & MSG_LEVEL_MASK) > LogLevel)
+		return;
+
+	memset(&Record, 0x00, sizeof(Record));
+	Record.Type = LOG_REC_MSG;
+	Record.Level = Level & MSG_LEVEL_MASK;
+	Record.Size = strlen(Text);
+	if (Record.Level > MSG_DEBUG)
+		Record.Level = MSG_DEBUG;
+	LogPut(&Record, Text);
+
+	// Let user read it
+	if ((Level & MSG_CONFIRM) && LibIsInteractive() == true)
+	{
+		LogFlush();
+		UTIL_WAIT_KEY("Press any key to continue ...");
+	}
+}
+
+static void LogProgressCallback(void * Ctx, ulong Done, ulong Total)
+{
+	(void)Ctx;
+	LogProgress(Done, Total);
+}
+
+////////// Functions //////////
+void LogProgress(ulong Done, ulong Total)
+{
+	sLogRecord Record;
+	uint Now, Last;
+
+	if (LogStarted == false || LogLevel < MSG_INFO || (LogFormat == LOG_TEXT && LogTTY == false))
+		return;
+
+	// Rate limit, but always show the end
+	Now = LogNow() - LogStartTime + 1;
+	Last = __atomic_load_n(&LogLastProgress, __ATOMIC_RELAXED);
+	if (Done < Total)
+	{
+		if (Last != 0 && Now - Last < LOG_PROGRESS_MS)
+			return;
+		if (__sync_bool_compare_and_swap(&LogLastProgress, Last, Now) == false)
+			return;		// Other thread just did it
+	}
+
+	memset(&Record, 0x00, sizeof(Record));
+	Record.Type = LOG_REC_PROGRESS;
+	Record.Level = MSG_INFO;
+	Record.Done = Done;
+	Record.Total = Total;
+	LogPut(&Record, "");
+}
+
+void LogStart(int Level, int Format, bool Async)
+{
+	if (LogStarted == true)
+		return;
+
+	LogLevel = Level;
+	LogFormat = Format;
+	LogTTY = LOG_ISATTY(stdout);
+	LogStartTime = LogNow();
+	LogLastProgress = 0;
+	LogStopping = false;
+	if (LogLockReady == false)
+	{
+		MutexInit(&LogLock);
+		LogLockReady = true;
+	}
+
+	// Fall back to sync output if writer can't start
+	LogAsync = Async;
+	if (LogAsync == true && ThreadStart(&LogWriter, LogWriterLoop, NULL) == false)
+		LogAsync = false;
+
+	LogStarted = true;
+	LibSetMsgCallback(LogMsgCallback, NULL);
+	LibSetProgressCallback(LogProgressCallback, NULL);
+}
+
+void LogFlush()
+{
+	if (LogStarted == false)
+		return;
+
+	MutexLock(&LogLock);
+	LogDrain(false);
+	MutexUnlock(&LogLock);
+}
+
+void LogStop()
+{
+	// Thread buffers are kept: threads still point to them and reuse them after restart
+	if (LogStarted == false)
+		return;
+
+	LibSetMsgCallback(NULL, NULL);
+	LibSetProgressCallback(NULL, NULL);
+
+	if (LogAsync == true)
+	{
+		__atomic_store_n(&LogStopping, true, __ATOMIC_RELEASE);
+		ThreadJoin(LogWriter);
+	}
+
+	// Every thread is done with logging by now
+	MutexLock(&LogLock);
+	LogDrain(true);
+
+	// Unfinished progress bar
+	if (LogBar[0] != '\0')
+	{
+		fputc('\n', stdout);
+		LogBar[0] = '\0';
+	}
+	fflush(stdout);
+	MutexUnlock(&LogLock);
+
+	LogStarted = false;
+}
+
+int LogParseArgs(int argc, char * argv[], bool Async)
+{
+	int Level = MSG_INFO;
+	int Format = LOG_TEXT;
+	int Out = 1;
+
+	// Strip options, keep the rest in order
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-q"))
+			Level = MSG_WARN;
+		else if (!strcmp(argv[i], "-v"))
+			Level = MSG_DEBUG;
+		else if (!strcmp(argv[i], "--log-format=text"))
+			Format = LOG_TEXT;
+		else if (!strcmp(argv[i], "--log-format=jsonl"))
+			Format = LOG_JSONL;
+		else
+			argv[Out++] = argv[i];
+	}
+	argv[Out] = NULL;
+
+	LogStart(Level, Format, Async);
+	atexit(LogStop);
+
+	return Out;
+}
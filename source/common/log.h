@@ -0,0 +1,24 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef LOG_H
+#define LOG_H
+
+#include "types.h"
+
+////////// Output formats //////////
+#define LOG_TEXT		0	// Plain text, same as default library output
+#define LOG_JSONL		1	// One JSON object per line (--log-format=jsonl)
+
+// Logger is a library message/progress sink for front-ends: it filters
+// messages by level and replaces per-item progress with a rate-limited
+// progress bar. In async mode each thread writes to its own lock-free
+// buffer and a background thread does the actual output.
+
+int LogParseArgs(int argc, char * argv[], bool Async);	// Handle and remove -q, -v, --log-format=text|jsonl, start logger, returns new argc
+void LogStart(int Level, int Format, bool Async);		// Start logger (Level - most verbose MSG_* level to print)
+void LogFlush();										// Write out everything logged so far (call before printing directly)
+void LogStop();											// Flush, stop writer thread and restore default library output
+void LogProgress(ulong Done, ulong Total);				// Report progress (rate-limited, also receives LibProgress())
+
+#endif // LOG_H
@@ -0,0 +1,36 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef PAKIMG_H
+#define PAKIMG_H
+
+#include "types.h"
+
+// PAK image: unpacked PAK kept in memory, so single entries can be
+// replaced without packing whole directory again. Entry that still fits
+// into its segments is overwritten in place, bigger one is moved to the
+// end of data. Space left by moved and removed entries is reclaimed when
+// it takes more than half of the image.
+// Implemented in paktool/paktool.cpp (layout of PAK is private to PAK tool)
+namespace pak
+{
+
+struct sPAKImage;
+
+int NewPAKImage(bool Compressed, sPAKImage ** ptrImage);									// Empty image (compressed - 16 byte segments, normal - CD sectors)
+int LoadPAKImage(const char * cFile, sPAKImage ** ptrImage);								// Load normal or compressed PAK, returns PS2HL_OK or error
+int PatchPAKImage(sPAKImage * Image, const char * EntryName, const char * cFile);			// Replace entry with contents of file (entry is added if missing)
+int PutPAKEntry(sPAKImage * Image, const char * EntryName, const void * Data, ulong Size);	// Same from memory
+void RemovePAKEntry(sPAKImage * Image, const char * EntryName);								// Remove entry (missing entry is ignored)
+bool SortPAKImage(sPAKImage * Image);														// Sort entries by name and pack them back to back (false - out of memory)
+int GetPAKEntryCount(sPAKImage * Image);													// Number of entries
+const char * GetPAKEntryName(sPAKImage * Image, int Index);									// Entry name (PAK slashes)
+int FindPAKEntry(sPAKImage * Image, const char * EntryName);								// Entry index (-1 - not found)
+const uchar * GetPAKEntryData(sPAKImage * Image, int Index, ulong * ptrSize);				// Entry contents (valid until image is changed)
+ulong GetPAKImageSize(sPAKImage * Image);													// Memory taken by image
+int SavePAKImage(sPAKImage * Image, const char * cFile);									// Write PAK (compressed if it was loaded compressed), replaces cFile
+void FreePAKImage(sPAKImage * Image);														// Release image (NULL is ignored)
+
+} // namespace pak
+
+#endif // PAKIMG_H
@@ -0,0 +1,346 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains lightweight performance counters:
+// phase timers, I/O and allocation counters, peak RSS,
+// JSON summary (--stats) and Chrome trace events (--trace)
+//
+// Each thread accumulates into its own block, so hot paths don't
+// take locks. Blocks are summed up at exit, trace events are
+// flushed under lock when thread buffer is full.
+// Trace file can be opened in chrome://tracing or Perfetto.
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "ps2hl.h"
+#include "perf.h"
+
+#ifdef PS2HL_PERF
+
+#include "thpool.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <psapi.h>
+	#define PERF_U64 "%I64u"		// Old msvcrt doesn't know %llu
+#else
+	#define PERF_U64 "%llu"
+	#include <time.h>
+	#include <sys/resource.h>
+#endif
+
+////////// Definitions //////////
+#define PERF_TRACE_BUF 512		// Trace events buffered per thread before flush
+
+////////// Structures //////////
+
+// Complete ("X") trace event
+struct sPerfEvent
+{
+	ePerfPhase Phase;
+	tPerfTime Start;
+	tPerfTime End;
+};
+
+// Per thread counters
+struct sPerfThread
+{
+	int Tid;									// Sequential thread number (0 - first thread seen, usually main)
+	tPerfTime Counters[PERF_COUNTER_COUNT];		// Counter values
+	tPerfTime PhaseTime[PERF_PHASE_COUNT];		// Total phase time, ns
+	tPerfTime PhaseCalls[PERF_PHASE_COUNT];		// Number of phase scopes
+	sPerfEvent Events[PERF_TRACE_BUF];			// Pending trace events
+	int EventCount;								//
+	sPerfThread * Next;							// Next block in global list
+};
+
+////////// Globals //////////
+static const char * PerfCounterName[PERF_COUNTER_COUNT] =
+{
+	"bytes_read",
+	"bytes_written",
+	"read_calls",
+	"write_calls",
+	"seek_calls",
+	"open_calls",
+	"allocs",
+	"alloc_bytes",
+	"frees"
+};
+
+static const char * PerfPhaseName[PERF_PHASE_COUNT] =
+{
+	"disk.read",
+	"disk.write",
+	"zlib.inflate",
+	"zlib.deflate",
+	"png.read",
+	"png.write",
+	"png.filter",
+	"palette",
+	"console",
+	"job"
+};
+
+bool PerfEnabled = false;
+static bool PerfStats = false;					// Print summary at exit
+static FILE * PerfTraceFile = NULL;				// Trace output (NULL - no trace)
+static bool PerfTraceFirst = true;				// No comma before first event
+static tPerfTime PerfStartTime = 0;				// Trace timestamps are relative to this
+static tMutex PerfLock;							// Protects thread list and trace file
+static sPerfThread * PerfThreads = NULL;		// All thread blocks
+static int PerfThreadCount = 0;					//
+static __thread sPerfThread * PerfSelf = NULL;	// Block of current thread
+
+////////// Platform wrappers //////////
+#ifdef _WIN32
+
+tPerfTime PerfNow()
+{
+	LARGE_INTEGER Counter, Freq;
+
+	QueryPerformanceCounter(&Counter);
+	QueryPerformanceFrequency(&Freq);
+
+	// Split to avoid overflow
+	return (tPerfTime)(Counter.QuadPart / Freq.QuadPart) * 1000000000ULL +
+		(tPerfTime)(Counter.QuadPart % Freq.QuadPart) * 1000000000ULL / Freq.QuadPart;
+}
+
+static tPerfTime PerfPeakRSS()		// KiB
+{
+	// psapi is loaded at run time, so tools don't need extra libs to link
+	typedef BOOL (WINAPI * tGetMemInfo)(HANDLE, PPROCESS_MEMORY_COUNTERS, DWORD);
+	PROCESS_MEMORY_COUNTERS Info;
+	HMODULE hPsapi = LoadLibraryA("psapi.dll");
+	tGetMemInfo GetMemInfo;
+	tPerfTime Result = 0;
+
+	if (hPsapi == NULL)
+		return 0;
+
+	GetMemInfo = (tGetMemInfo)GetProcAddress(hPsapi, "GetProcessMemoryInfo");
+	if (GetMemInfo != NULL && GetMemInfo(GetCurrentProcess(), &Info, sizeof(Info)))
+		Result = Info.PeakWorkingSetSize / 1024;
+
+	FreeLibrary(hPsapi);
+	return Result;
+}
+
+#else // linux
+
+tPerfTime PerfNow()
+{
+	struct timespec Time;
+
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return (tPerfTime)Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
+static tPerfTime PerfPeakRSS()		// KiB
+{
+	struct rusage Usage;
+
+	if (getrusage(RUSAGE_SELF, &Usage) != 0)
+		return 0;
+
+	return Usage.ru_maxrss;
+}
+
+#endif
+
+////////// Functions //////////
+static sPerfThread * PerfGetThread()
+{
+	sPerfThread * Thread;
+
+	if (PerfSelf != NULL)
+		return PerfSelf;
+
+	// Not LibAlloc(): counters shouldn't count themselves or go through user allocator
+	Thread = (sPerfThread *)calloc(1, sizeof(sPerfThread));
+	if (Thread == NULL)
+		return NULL;
+
+	MutexLock(&PerfLock);
+	Thread->Tid = PerfThreadCount++;
+	Thread->Next = PerfThreads;
+	PerfThreads = Thread;
+	MutexUnlock(&PerfLock);
+
+	PerfSelf = Thread;
+	return Thread;
+}
+
+static void PerfTraceWrite(const char * Format, ...)	// Caller holds PerfLock
+{
+	va_list Args;
+
+	if (PerfTraceFirst == false)
+		fputs(",\n", PerfTraceFile);
+	PerfTraceFirst = false;
+
+	va_start(Args, Format);
+	vfprintf(PerfTraceFile, Format, Args);
+	va_end(Args);
+}
+
+static void PerfFlushEvents(sPerfThread * Thread)	// Caller holds PerfLock
+{
+	sPerfEvent * Event;
+
+	for (int i = 0; i < Thread->EventCount; i++)
+	{
+		Event = &Thread->Events[i];
+		PerfTraceWrite("{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+			PerfPhaseName[Event->Phase], Thread->Tid,
+			(Event->Start - PerfStartTime) / 1000.0, (Event->End - Event->Start) / 1000.0);
+	}
+	Thread->EventCount = 0;
+}
+
+void PerfAdd(ePerfCounter Counter, tPerfTime Value)
+{
+	sPerfThread * Thread = PerfGetThread();
+
+	if (Thread != NULL)
+		Thread->Counters[Counter] += Value;
+}
+
+void PerfPhase(ePerfPhase Phase, tPerfTime Start, tPerfTime End)
+{
+	sPerfThread * Thread = PerfGetThread();
+
+	if (Thread == NULL)
+		return;
+
+	Thread->PhaseTime[Phase] += End - Start;
+	Thread->PhaseCalls[Phase]++;
+
+	if (PerfTraceFile == NULL)
+		return;
+
+	// Buffer event, flush when full
+	if (Thread->EventCount == PERF_TRACE_BUF)
+	{
+		MutexLock(&PerfLock);
+		PerfFlushEvents(Thread);
+		MutexUnlock(&PerfLock);
+	}
+	Thread->Events[Thread->EventCount].Phase = Phase;
+	Thread->Events[Thread->EventCount].Start = Start;
+	Thread->Events[Thread->EventCount].End = End;
+	Thread->EventCount++;
+}
+
+static void PerfReport()	// atexit() handler, all worker threads are joined by now
+{
+	tPerfTime Counters[PERF_COUNTER_COUNT];
+	tPerfTime PhaseTime[PERF_PHASE_COUNT];
+	tPerfTime PhaseCalls[PERF_PHASE_COUNT];
+	tPerfTime WallTime = PerfNow() - PerfStartTime;
+	sPerfThread * Thread;
+
+	memset(Counters, 0x00, sizeof(Counters));
+	memset(PhaseTime, 0x00, sizeof(PhaseTime));
+	memset(PhaseCalls, 0x00, sizeof(PhaseCalls));
+
+	MutexLock(&PerfLock);
+	for (Thread = PerfThreads; Thread != NULL; Thread = Thread->Next)
+	{
+		for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+			Counters[i] += Thread->Counters[i];
+		for (int i = 0; i < PERF_PHASE_COUNT; i++)
+		{
+			PhaseTime[i] += Thread->PhaseTime[i];
+			PhaseCalls[i] += Thread->PhaseCalls[i];
+		}
+
+		// Trace: rest of events and thread name
+		if (PerfTraceFile != NULL)
+		{
+			PerfFlushEvents(Thread);
+			if (Thread->Tid == 0)
+				PerfTraceWrite("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"main\"}}");
+			else
+				PerfTraceWrite("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}", Thread->Tid, Thread->Tid);
+		}
+	}
+	MutexUnlock(&PerfLock);
+
+	if (PerfTraceFile != NULL)
+	{
+		fputs("\n]}\n", PerfTraceFile);
+		fclose(PerfTraceFile);
+		PerfTraceFile = NULL;
+	}
+
+	// Summary goes to stderr, so it can be separated from regular output
+	if (PerfStats == true)
+	{
+		fflush(stdout);
+		fprintf(stderr, "{\n\t\"wall_ms\": %.3f,\n\t\"threads\": %d,\n\t\"peak_rss_kb\": " PERF_U64 ",\n\t\"counters\": {",
+			WallTime / 1000000.0, PerfThreadCount, PerfPeakRSS());
+		for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+			fprintf(stderr, "%s\n\t\t\"%s\": " PERF_U64, i ? "," : "", PerfCounterName[i], Counters[i]);
+		fputs("\n\t},\n\t\"phases\": {", stderr);
+		for (int i = 0; i < PERF_PHASE_COUNT; i++)
+			fprintf(stderr, "%s\n\t\t\"%s\": { \"calls\": " PERF_U64 ", \"ms\": %.3f }", i ? "," : "", PerfPhaseName[i], PhaseCalls[i], PhaseTime[i] / 1000000.0);
+		fputs("\n\t}\n}\n", stderr);
+	}
+
+	PerfEnabled = false;
+}
+
+#endif // PS2HL_PERF
+
+int PerfParseArgs(int argc, char * argv[])
+{
+	const char * TraceName = NULL;
+	bool Stats = false;
+	int Out = 1;
+
+	// Strip options, keep the rest in order
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--stats"))
+			Stats = true;
+		else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+			TraceName = argv[++i];
+		else
+			argv[Out++] = argv[i];
+	}
+	argv[Out] = NULL;
+
+	if (Stats == false && TraceName == NULL)
+		return Out;
+
+#ifdef PS2HL_PERF
+	MutexInit(&PerfLock);
+	PerfStartTime = PerfNow();
+	PerfStats = Stats;
+
+	if (TraceName != NULL)
+	{
+		PerfTraceFile = fopen(TraceName, "w");
+		if (PerfTraceFile == NULL)
+			LibMsg(MSG_WARN, "Warning: can't create trace file: %s \n", TraceName);
+		else
+			fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", PerfTraceFile);
+	}
+
+	// Main thread gets tid 0
+	PerfEnabled = true;
+	PerfGetThread();
+	atexit(PerfReport);
+#else
+	LibMsg(MSG_WARN, "Warning: performance counters are disabled in this build, --stats/--trace ignored \n");
+#endif
+
+	return Out;
+}
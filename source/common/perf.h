@@ -0,0 +1,88 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef PERF_H
+#define PERF_H
+
+#include "types.h"
+
+// Build with PS2HL_PERF defined (default in Makefiles, "make PERF=0" to disable)
+// to get counters and timers. Without it macros below expand to nothing and
+// front-ends only accept (and ignore) --stats/--trace options.
+
+////////// Counters //////////
+enum ePerfCounter
+{
+	PERF_BYTES_READ = 0,	// Bytes read through fops
+	PERF_BYTES_WRITTEN,		// Bytes written through fops
+	PERF_READS,				// fread() calls
+	PERF_WRITES,			// fwrite() calls
+	PERF_SEEKS,				// fseek() calls
+	PERF_OPENS,				// fopen() calls
+	PERF_ALLOCS,			// LibAlloc() calls
+	PERF_ALLOC_BYTES,		// Bytes requested by LibAlloc()
+	PERF_FREES,				// LibFree() calls
+	PERF_COUNTER_COUNT
+};
+
+////////// Phases //////////
+enum ePerfPhase
+{
+	PERF_PH_DISK_READ = 0,	// "disk.read"
+	PERF_PH_DISK_WRITE,		// "disk.write"
+	PERF_PH_INFLATE,		// "zlib.inflate"
+	PERF_PH_DEFLATE,		// "zlib.deflate"
+	PERF_PH_PNG_READ,		// "png.read" - chunk parsing and palette/bitmap decoding
+	PERF_PH_PNG_WRITE,		// "png.write"
+	PERF_PH_PNG_FILTER,		// "png.filter" - filtering and unfiltering of scanlines
+	PERF_PH_PALETTE,		// "palette" - palette conversions of all tools
+	PERF_PH_CONSOLE,		// "console" - default message output
+	PERF_PH_JOB,			// "job" - whole batch job
+	PERF_PHASE_COUNT
+};
+
+////////// Functions //////////
+int PerfParseArgs(int argc, char * argv[]);		// Handle and remove --stats and --trace <file> from argv, returns new argc
+
+#ifdef PS2HL_PERF
+
+typedef unsigned long long tPerfTime;
+
+extern bool PerfEnabled;						// Set by PerfParseArgs(), everything below is skipped if false
+
+tPerfTime PerfNow();											// Monotonic time in nanoseconds
+void PerfAdd(ePerfCounter Counter, tPerfTime Value);			// Add to counter of current thread
+void PerfPhase(ePerfPhase Phase, tPerfTime Start, tPerfTime End);	// Account phase time and emit trace event
+
+// Measures time from construction to the end of scope (phases may nest, time is inclusive)
+struct sPerfScope
+{
+	ePerfPhase Phase;
+	tPerfTime Start;
+
+	sPerfScope(ePerfPhase NewPhase)
+	{
+		Phase = NewPhase;
+		Start = PerfEnabled ? PerfNow() : 0;
+	}
+
+	~sPerfScope()
+	{
+		if (PerfEnabled)
+			PerfPhase(Phase, Start, PerfNow());
+	}
+};
+
+#define PERF_CAT2(A, B)			A##B
+#define PERF_CAT(A, B)			PERF_CAT2(A, B)
+#define PERF_SCOPE(PHASE)		sPerfScope PERF_CAT(PerfScope, __LINE__)(PHASE)
+#define PERF_ADD(COUNTER, VAL)	{ if (PerfEnabled) PerfAdd(COUNTER, VAL); }
+
+#else
+
+#define PERF_SCOPE(PHASE)
+#define PERF_ADD(COUNTER, VAL)
+
+#endif // PS2HL_PERF
+
+#endif // PERF_H
@@ -0,0 +1,800 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains PNG scanline filter and sample unpacking kernels:
+// scalar reference and SSE2/SSSE3/AVX2 versions picked at runtime
+//
+// Filtering (encoder) has no dependencies between bytes of a row, so every
+// filter is done 16 or 32 bytes at a time. Unfiltering depends on already
+// decoded left pixel: Up is done 16 or 32 bytes at a time, Sub - as prefix
+// sum in register, Avg and Paeth - one 4 byte pixel at a time (rows with
+// 1 byte pixels are unfiltered by scalar code here).
+//
+// Unpacking of 1, 2 and 4 bit samples splits every byte into its high and
+// low part and interleaves them (SSE2), once per halving of sample size.
+// RGB rows get alpha with pshufb, 4 (SSSE3) or 8 (AVX2) pixels at a time.
+//
+// SIMD code is built with function target attributes, so the rest of the
+// library keeps its compiler flags (-m32 builds don't assume SSE2 either).
+// Older compilers without them (GCC < 4.9) only get scalar code.
+//
+
+////////// Includes //////////
+#include <string.h>
+#include "types.h"
+#include "perf.h"
+#include "pngfilt.h"
+
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+	#define PNG_SIMD_X86
+	#include <cpuid.h>
+	#include <immintrin.h>
+	#define PNG_TARGET(ISA) __attribute__((target(ISA)))
+#endif
+
+////////// Globals //////////
+static volatile int SIMDLevel = -1;		// Forced level (-1 - best supported)
+
+static const char * SIMDNames[PNG_SIMD_COUNT] = { "scalar", "sse2", "ssse3", "avx2" };
+
+////////// Scalar reference //////////
+static inline int PNGPaeth(int a, int b, int c)		// Same as PaethPredictor()
+{
+	int pa = (b > c) ? b - c : c - b;
+	int pb = (a > c) ? a - c : c - a;
+	int pc = (a + b - c - c > 0) ? a + b - c - c : c + c - a - b;
+
+	if (pa <= pb && pa <= pc)
+		return a;
+	else if (pb <= pc)
+		return b;
+	else
+		return c;
+}
+
+static inline uchar PNGPredict(uchar FilterType, uchar a, uchar b, uchar c)	// a = left, b = above, c = upper left
+{
+	switch (FilterType)
+	{
+	case 1:			// SUB filter (Difference between current and previous pixels)
+		return a;
+	case 2:			// UP filter (Difference between current and upper pixels)
+		return b;
+	case 3:			// AVG filter (Difference between current pixel and average of prevoius and upper pixels)
+		return (a + b) / 2;
+	case 4:			// Paeth filter (Difference between current pixel and pixel out of a, b, c that is closest to a + b - c)
+		return PNGPaeth(a, b, c);
+	default:		// No filter
+		return 0;
+	}
+}
+
+void PNGFilterRowScalar(uchar * Out, const uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType)
+{
+	ulong i;
+
+	Out[0] = FilterType;		// Set filter type in first byte of row
+	Out++;
+
+	// Left and upper left are zero in first pixel
+	for (i = 0; i < Distance && i < Length; i++)
+		Out[i] = Row[i] - PNGPredict(FilterType, 0, Upper[i], 0);
+	for (; i < Length; i++)
+		Out[i] = Row[i] - PNGPredict(FilterType, Row[i - Distance], Upper[i], Upper[i - Distance]);
+}
+
+bool PNGUnfilterRowScalar(uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType)
+{
+	ulong i;
+
+	if (FilterType > 4)
+		return false;
+
+	for (i = 0; i < Distance && i < Length; i++)
+		Row[i] += PNGPredict(FilterType, 0, Upper[i], 0);
+	for (; i < Length; i++)
+		Row[i] += PNGPredict(FilterType, Row[i - Distance], Upper[i], Upper[i - Distance]);
+
+	return true;
+}
+
+ulong PNGRowCostScalar(const uchar * Row, ulong Length)
+{
+	ulong Cost = 0;
+
+	// Bytes are taken as signed: 0xFF (-1) is as cheap as 0x01
+	for (ulong i = 0; i < Length; i++)
+		Cost += (Row[i] < 0x80) ? Row[i] : 0x100 - Row[i];
+
+	return Cost;
+}
+
+void PNGUnpackRowScalar(uchar * Out, const uchar * Row, ulong Count, uint BitDepth)
+{
+	uint Mask = (1 << BitDepth) - 1;
+
+	if (BitDepth >= 8)
+	{
+		memcpy(Out, Row, Count);
+		return;
+	}
+
+	// First sample is in high bits
+	for (ulong i = 0; i < Count; i++)
+		Out[i] = (Row[i * BitDepth / 8] >> (8 - BitDepth - (i * BitDepth) % 8)) & Mask;
+}
+
+void PNGExpandRGBScalar(uchar * Out, const uchar * Row, ulong Count)
+{
+	for (ulong i = 0; i < Count; i++)
+	{
+		Out[i * 4 + 0] = Row[i * 3 + 0];
+		Out[i * 4 + 1] = Row[i * 3 + 1];
+		Out[i * 4 + 2] = Row[i * 3 + 2];
+		Out[i * 4 + 3] = 0xFF;
+	}
+}
+
+#ifdef PNG_SIMD_X86
+////////// SSE2 //////////
+static inline PNG_TARGET("sse2") __m128i PNGLoad4(const uchar * Data)
+{
+	int Value;
+
+	memcpy(&Value, Data, sizeof(Value));
+	return _mm_cvtsi32_si128(Value);
+}
+
+static inline PNG_TARGET("sse2") void PNGStore4(uchar * Data, __m128i Value)
+{
+	int Result = _mm_cvtsi128_si32(Value);
+
+	memcpy(Data, &Result, sizeof(Result));
+}
+
+static inline PNG_TARGET("sse2") __m128i PNGAvgSSE2(__m128i a, __m128i b)	// (a + b) / 2 without rounding up
+{
+	return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+
+static inline PNG_TARGET("sse2") __m128i PNGSelect16(__m128i pa, __m128i pb, __m128i pc, __m128i a, __m128i b, __m128i c)	// Paeth choice by distances
+{
+	__m128i NotA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+	__m128i UseC = _mm_cmpgt_epi16(pb, pc);
+	__m128i BC = _mm_or_si128(_mm_and_si128(UseC, c), _mm_andnot_si128(UseC, b));
+
+	return _mm_or_si128(_mm_and_si128(NotA, BC), _mm_andnot_si128(NotA, a));
+}
+
+static inline PNG_TARGET("sse2") __m128i PNGPaeth16SSE2(__m128i a, __m128i b, __m128i c)	// 16 bit lanes
+{
+	__m128i Zero = _mm_setzero_si128();
+	__m128i bc = _mm_sub_epi16(b, c);
+	__m128i ac = _mm_sub_epi16(a, c);
+	__m128i abc = _mm_add_epi16(bc, ac);
+
+	// |x| = max(x, -x)
+	return PNGSelect16(_mm_max_epi16(bc, _mm_sub_epi16(Zero, bc)), _mm_max_epi16(ac, _mm_sub_epi16(Zero, ac)),
+		_mm_max_epi16(abc, _mm_sub_epi16(Zero, abc)), a, b, c);
+}
+
+static inline PNG_TARGET("sse2") __m128i PNGPaeth8SSE2(__m128i a, __m128i b, __m128i c)	// 16 bytes
+{
+	__m128i Zero = _mm_setzero_si128();
+	__m128i Low = PNGPaeth16SSE2(_mm_unpacklo_epi8(a, Zero), _mm_unpacklo_epi8(b, Zero), _mm_unpacklo_epi8(c, Zero));
+	__m128i High = PNGPaeth16SSE2(_mm_unpackhi_epi8(a, Zero), _mm_unpackhi_epi8(b, Zero), _mm_unpackhi_epi8(c, Zero));
+
+	return _mm_packus_epi16(Low, High);
+}
+
+static PNG_TARGET("sse2") void PNGFilterRowSSE2(uchar * Out, const uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType)
+{
+	ulong i;
+
+	if ((Distance != 1 && Distance != 4) || FilterType == 0 || FilterType > 4)
+	{
+		PNGFilterRowScalar(Out, Row, Upper, Length, Distance, FilterType);
+		return;
+	}
+
+	Out[0] = FilterType;
+	Out++;
+	for (i = 0; i < Distance && i < Length; i++)
+		Out[i] = Row[i] - PNGPredict(FilterType, 0, Upper[i], 0);
+
+	for (; i + 16 <= Length; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)&Row[i]);
+		__m128i a = _mm_loadu_si128((const __m128i *)&Row[i - Distance]);
+		__m128i b = _mm_loadu_si128((const __m128i *)&Upper[i]);
+		__m128i p;
+
+		switch (FilterType)
+		{
+		case 1:
+			p = a;
+			break;
+		case 2:
+			p = b;
+			break;
+		case 3:
+			p = PNGAvgSSE2(a, b);
+			break;
+		default:
+			p = PNGPaeth8SSE2(a, b, _mm_loadu_si128((const __m128i *)&Upper[i - Distance]));
+			break;
+		}
+		_mm_storeu_si128((__m128i *)&Out[i], _mm_sub_epi8(x, p));
+	}
+
+	for (; i < Length; i++)
+		Out[i] = Row[i] - PNGPredict(FilterType, Row[i - Distance], Upper[i], Upper[i - Distance]);
+}
+
+static PNG_TARGET("sse2") ulong PNGUnfilterUpSSE2(uchar * Row, const uchar * Upper, ulong Length)	// Returns bytes done
+{
+	ulong i;
+
+	for (i = 0; i + 16 <= Length; i += 16)
+		_mm_storeu_si128((__m128i *)&Row[i], _mm_add_epi8(_mm_loadu_si128((const __m128i *)&Row[i]), _mm_loadu_si128((const __m128i *)&Upper[i])));
+
+	return i;
+}
+
+static PNG_TARGET("sse2") ulong PNGUnfilterSubSSE2(uchar * Row, ulong Length, uint Distance)	// Prefix sum of pixels in register
+{
+	__m128i Carry = _mm_setzero_si128();		// Last decoded pixel in every position
+	ulong i;
+
+	for (i = 0; i + 16 <= Length; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)&Row[i]);
+
+		if (Distance == 4)
+		{
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi8(x, Carry);
+			Carry = _mm_shuffle_epi32(x, 0xFF);
+		}
+		else
+		{
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 1));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 2));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi8(x, Carry);
+			Carry = _mm_set1_epi8((char)(_mm_extract_epi16(x, 7) >> 8));
+		}
+		_mm_storeu_si128((__m128i *)&Row[i], x);
+	}
+
+	return i;
+}
+
+static PNG_TARGET("sse2") ulong PNGUnfilterAvgSSE2(uchar * Row, const uchar * Upper, ulong Length)	// 4 byte pixels
+{
+	__m128i a = _mm_setzero_si128();
+	ulong i;
+
+	for (i = 0; i + 4 <= Length; i += 4)
+	{
+		a = _mm_add_epi8(PNGLoad4(&Row[i]), PNGAvgSSE2(a, PNGLoad4(&Upper[i])));
+		PNGStore4(&Row[i], a);
+	}
+
+	return i;
+}
+
+static PNG_TARGET("sse2") ulong PNGUnfilterPaethSSE2(uchar * Row, const uchar * Upper, ulong Length)	// 4 byte pixels, 16 bit lanes
+{
+	__m128i Zero = _mm_setzero_si128();
+	__m128i a = Zero;
+	__m128i c = Zero;
+	__m128i b, x;
+	ulong i;
+
+	for (i = 0; i + 4 <= Length; i += 4)
+	{
+		b = _mm_unpacklo_epi8(PNGLoad4(&Upper[i]), Zero);
+		x = _mm_add_epi8(PNGLoad4(&Row[i]), _mm_packus_epi16(PNGPaeth16SSE2(a, b, c), Zero));
+		PNGStore4(&Row[i], x);
+		a = _mm_unpacklo_epi8(x, Zero);
+		c = b;
+	}
+
+	return i;
+}
+
+static PNG_TARGET("sse2") bool PNGUnfilterRowSSE2(uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType)
+{
+	ulong Done;
+
+	// Unfilter as much as possible with SIMD, rest is done by scalar code below
+	switch (FilterType)
+	{
+	case 0:
+		return true;
+	case 1:
+		Done = (Distance == 1 || Distance == 4) ? PNGUnfilterSubSSE2(Row, Length, Distance) : 0;
+		break;
+	case 2:
+		Done = PNGUnfilterUpSSE2(Row, Upper, Length);
+		break;
+	case 3:
+		Done = (Distance == 4) ? PNGUnfilterAvgSSE2(Row, Upper, Length) : 0;
+		break;
+	case 4:
+		Done = (Distance == 4) ? PNGUnfilterPaethSSE2(Row, Upper, Length) : 0;
+		break;
+	default:
+		return false;
+	}
+
+	if (Done == 0)
+		return PNGUnfilterRowScalar(Row, Upper, Length, Distance, FilterType);
+	for (ulong i = Done; i < Length; i++)
+		Row[i] += PNGPredict(FilterType, Row[i - Distance], Upper[i], Upper[i - Distance]);
+
+	return true;
+}
+
+static PNG_TARGET("sse2") ulong PNGRowCostSSE2(const uchar * Row, ulong Length)
+{
+	__m128i Zero = _mm_setzero_si128();
+	__m128i Sum = _mm_setzero_si128();
+	__m128i Value;
+	ulong i;
+
+	// |x| of signed byte = min(x, -x) as unsigned, psadbw adds 8 of them up
+	for (i = 0; i + 16 <= Length; i += 16)
+	{
+		Value = _mm_loadu_si128((const __m128i *)&Row[i]);
+		Sum = _mm_add_epi64(Sum, _mm_sad_epu8(_mm_min_epu8(Value, _mm_sub_epi8(Zero, Value)), Zero));
+	}
+
+	return _mm_cvtsi128_si32(Sum) + _mm_cvtsi128_si32(_mm_srli_si128(Sum, 8)) + PNGRowCostScalar(&Row[i], Length - i);
+}
+
+static inline PNG_TARGET("sse2") void PNGSplitSSE2(__m128i Value, int Shift, __m128i * Lo, __m128i * Hi)	// Every byte to two of Shift bits, high part first
+{
+	__m128i Mask = _mm_set1_epi8((char)((1 << Shift) - 1));
+	__m128i High = _mm_and_si128(_mm_srl_epi16(Value, _mm_cvtsi32_si128(Shift)), Mask);
+	__m128i Low = _mm_and_si128(Value, Mask);
+
+	*Lo = _mm_unpacklo_epi8(High, Low);
+	*Hi = _mm_unpackhi_epi8(High, Low);
+}
+
+static PNG_TARGET("sse2") ulong PNGUnpackRowSSE2(uchar * Out, const uchar * Row, ulong Count, uint BitDepth)	// Returns samples done
+{
+	__m128i Parts[8];
+	ulong Step = 128 / BitDepth;		// Samples in 16 bytes
+	ulong i;
+	int PartCount;
+
+	// 16 bytes -> 2 vectors of nibbles -> 4 of 2 bit samples -> 8 of bits
+	for (i = 0; i + Step <= Count; i += Step, Row += 16)
+	{
+		Parts[0] = _mm_loadu_si128((const __m128i *)Row);
+		PartCount = 1;
+		for (int Shift = 4; Shift >= (int)BitDepth; Shift /= 2)
+		{
+			for (int n = PartCount - 1; n >= 0; n--)		// Backwards: split parts go past unsplit ones
+				PNGSplitSSE2(Parts[n], Shift, &Parts[n * 2], &Parts[n * 2 + 1]);
+			PartCount *= 2;
+		}
+
+		for (int n = 0; n < PartCount; n++)
+			_mm_storeu_si128((__m128i *)&Out[i + n * 16], Parts[n]);
+	}
+
+	return i;
+}
+
+////////// SSSE3 //////////
+static inline PNG_TARGET("ssse3") __m128i PNGPaeth16SSSE3(__m128i a, __m128i b, __m128i c)	// 16 bit lanes
+{
+	__m128i bc = _mm_sub_epi16(b, c);
+	__m128i ac = _mm_sub_epi16(a, c);
+
+	return PNGSelect16(_mm_abs_epi16(bc), _mm_abs_epi16(ac), _mm_abs_epi16(_mm_add_epi16(bc, ac)), a, b, c);
+}
+
+static PNG_TARGET("ssse3") void PNGFilterRowSSSE3(uchar * Out, const uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType)
+{
+	__m128i Zero = _mm_setzero_si128();
+	ulong i;
+
+	// Only Paeth gains from SSSE3
+	if ((Distance != 1 && Distance != 4) || FilterType != 4)
+	{
+		PNGFilterRowSSE2(Out, Row, Upper, Length, Distance, FilterType);
+		return;
+	}
+
+	Out[0] = FilterType;
+	Out++;
+	for (i = 0; i < Distance && i < Length; i++)
+		Out[i] = Row[i] - Upper[i];
+
+	for (; i + 16 <= Length; i += 16)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)&Row[i]);
+		__m128i a = _mm_loadu_si128((const __m128i *)&Row[i - Distance]);
+		__m128i b = _mm_loadu_si128((const __m128i *)&Upper[i]);
+		__m128i c = _mm_loadu_si128((const __m128i *)&Upper[i - Distance]);
+		__m128i Low = PNGPaeth16SSSE3(_mm_unpacklo_epi8(a, Zero), _mm_unpacklo_epi8(b, Zero), _mm_unpacklo_epi8(c, Zero));
+		__m128i High = PNGPaeth16SSSE3(_mm_unpackhi_epi8(a, Zero), _mm_unpackhi_epi8(b, Zero), _mm_unpackhi_epi8(c, Zero));
+
+		_mm_storeu_si128((__m128i *)&Out[i], _mm_sub_epi8(x, _mm_packus_epi16(Low, High)));
+	}
+
+	for (; i < Length; i++)
+		Out[i] = Row[i] - PNGPaeth(Row[i - Distance], Upper[i], Upper[i - Distance]);
+}
+
+static PNG_TARGET("ssse3") bool PNGUnfilterRowSSSE3(uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType)
+{
+	__m128i Zero = _mm_setzero_si128();
+	__m128i a = Zero;
+	__m128i c = Zero;
+	__m128i b, x;
+	ulong i;
+
+	if (Distance != 4 || FilterType != 4)
+		return PNGUnfilterRowSSE2(Row, Upper, Length, Distance, FilterType);
+
+	for (i = 0; i + 4 <= Length; i += 4)
+	{
+		b = _mm_unpacklo_epi8(PNGLoad4(&Upper[i]), Zero);
+		x = _mm_add_epi8(PNGLoad4(&Row[i]), _mm_packus_epi16(PNGPaeth16SSSE3(a, b, c), Zero));
+		PNGStore4(&Row[i], x);
+		a = _mm_unpacklo_epi8(x, Zero);
+		c = b;
+	}
+	for (; i < Length; i++)
+		Row[i] += PNGPaeth(Row[i - Distance], Upper[i], Upper[i - Distance]);
+
+	return true;
+}
+
+static PNG_TARGET("ssse3") ulong PNGExpandRGBSSSE3(uchar * Out, const uchar * Row, ulong Count)	// Returns pixels done
+{
+	const __m128i Shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i Alpha = _mm_set1_epi32((int)0xFF000000);
+	ulong i;
+
+	// 16 byte load has 4 pixels and a bit of next ones, so it stops short of row end
+	for (i = 0; i * 3 + 16 <= Count * 3; i += 4)
+		_mm_storeu_si128((__m128i *)&Out[i * 4], _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&Row[i * 3]), Shuffle), Alpha));
+
+	return i;
+}
+
+////////// AVX2 //////////
+static inline PNG_TARGET("avx2") __m256i PNGPaeth16AVX2(__m256i a, __m256i b, __m256i c)	// 16 bit lanes
+{
+	__m256i bc = _mm256_sub_epi16(b, c);
+	__m256i ac = _mm256_sub_epi16(a, c);
+	__m256i pa = _mm256_abs_epi16(bc);
+	__m256i pb = _mm256_abs_epi16(ac);
+	__m256i pc = _mm256_abs_epi16(_mm256_add_epi16(bc, ac));
+	__m256i NotA = _mm256_or_si256(_mm256_cmpgt_epi16(pa, pb), _mm256_cmpgt_epi16(pa, pc));
+
+	return _mm256_blendv_epi8(a, _mm256_blendv_epi8(b, c, _mm256_cmpgt_epi16(pb, pc)), NotA);
+}
+
+static PNG_TARGET("avx2") void PNGFilterRowAVX2(uchar * Out, const uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType)
+{
+	__m256i Zero = _mm256_setzero_si256();
+	__m256i One = _mm256_set1_epi8(1);
+	ulong i;
+
+	if ((Distance != 1 && Distance != 4) || FilterType == 0 || FilterType > 4)
+	{
+		PNGFilterRowScalar(Out, Row, Upper, Length, Distance, FilterType);
+		return;
+	}
+
+	Out[0] = FilterType;
+	Out++;
+	for (i = 0; i < Distance && i < Length; i++)
+		Out[i] = Row[i] - PNGPredict(FilterType, 0, Upper[i], 0);
+
+	for (; i + 32 <= Length; i += 32)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i *)&Row[i]);
+		__m256i a = _mm256_loadu_si256((const __m256i *)&Row[i - Distance]);
+		__m256i b = _mm256_loadu_si256((const __m256i *)&Upper[i]);
+		__m256i p;
+
+		switch (FilterType)
+		{
+		case 1:
+			p = a;
+			break;
+		case 2:
+			p = b;
+			break;
+		case 3:
+			p = _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), One));
+			break;
+		default:
+		{
+			// Unpack and pack work within 128 bit lanes, so bytes come back in order
+			__m256i c = _mm256_loadu_si256((const __m256i *)&Upper[i - Distance]);
+			__m256i Low = PNGPaeth16AVX2(_mm256_unpacklo_epi8(a, Zero), _mm256_unpacklo_epi8(b, Zero), _mm256_unpacklo_epi8(c, Zero));
+			__m256i High = PNGPaeth16AVX2(_mm256_unpackhi_epi8(a, Zero), _mm256_unpackhi_epi8(b, Zero), _mm256_unpackhi_epi8(c, Zero));
+			p = _mm256_packus_epi16(Low, High);
+			break;
+		}
+		}
+		_mm256_storeu_si256((__m256i *)&Out[i], _mm256_sub_epi8(x, p));
+	}
+
+	for (; i < Length; i++)
+		Out[i] = Row[i] - PNGPredict(FilterType, Row[i - Distance], Upper[i], Upper[i - Distance]);
+}
+
+static PNG_TARGET("avx2") bool PNGUnfilterRowAVX2(uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType)
+{
+	ulong i;
+
+	// Others depend on left pixel, 256 bit registers don't help them
+	if (FilterType != 2)
+		return PNGUnfilterRowSSSE3(Row, Upper, Length, Distance, FilterType);
+
+	for (i = 0; i + 32 <= Length; i += 32)
+		_mm256_storeu_si256((__m256i *)&Row[i], _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)&Row[i]), _mm256_loadu_si256((const __m256i *)&Upper[i])));
+	for (; i < Length; i++)
+		Row[i] += Upper[i];
+
+	return true;
+}
+
+static PNG_TARGET("avx2") ulong PNGRowCostAVX2(const uchar * Row, ulong Length)
+{
+	__m256i Zero = _mm256_setzero_si256();
+	__m256i Sum = _mm256_setzero_si256();
+	__m256i Value;
+	__m128i Half;
+	ulong i;
+
+	for (i = 0; i + 32 <= Length; i += 32)
+	{
+		Value = _mm256_loadu_si256((const __m256i *)&Row[i]);
+		Sum = _mm256_add_epi64(Sum, _mm256_sad_epu8(_mm256_abs_epi8(Value), Zero));
+	}
+	Half = _mm_add_epi64(_mm256_castsi256_si128(Sum), _mm256_extracti128_si256(Sum, 1));
+
+	return _mm_cvtsi128_si32(Half) + _mm_cvtsi128_si32(_mm_srli_si128(Half, 8)) + PNGRowCostScalar(&Row[i], Length - i);
+}
+
+static PNG_TARGET("avx2") ulong PNGExpandRGBAVX2(uchar * Out, const uchar * Row, ulong Count)	// Returns pixels done
+{
+	const __m256i Shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i Alpha = _mm256_set1_epi32((int)0xFF000000);
+	__m256i Value;
+	ulong i;
+
+	// Each lane gets 4 pixels (pshufb doesn't cross lanes)
+	for (i = 0; i * 3 + 28 <= Count * 3; i += 8)
+	{
+		Value = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)&Row[i * 3])), _mm_loadu_si128((const __m128i *)&Row[i * 3 + 12]), 1);
+		_mm256_storeu_si256((__m256i *)&Out[i * 4], _mm256_or_si256(_mm256_shuffle_epi8(Value, Shuffle), Alpha));
+	}
+
+	return i + PNGExpandRGBSSSE3(&Out[i * 4], &Row[i * 3], Count - i);
+}
+
+////////// Detection //////////
+static uint PNGXGetBV()		// OS support of extended registers
+{
+	uint Eax, Edx;
+
+	__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(Eax), "=d"(Edx) : "c"(0));	// xgetbv (old assemblers don't know it)
+	return Eax;
+}
+#endif // PNG_SIMD_X86
+
+static int PNGDetectSIMD()
+{
+#ifdef PNG_SIMD_X86
+	uint Eax, Ebx, Ecx, Edx;
+	int Level = PNG_SIMD_SCALAR;
+
+	if (__get_cpuid(1, &Eax, &Ebx, &Ecx, &Edx) == 0)
+		return Level;
+
+	if (Edx & bit_SSE2)
+		Level = PNG_SIMD_SSE2;
+	if (Level == PNG_SIMD_SSE2 && (Ecx & bit_SSSE3))
+		Level = PNG_SIMD_SSSE3;
+
+	// AVX2 needs CPU support and OS that saves YMM registers
+	if (Level == PNG_SIMD_SSSE3 && (Ecx & bit_OSXSAVE) && (Ecx & bit_AVX) && (PNGXGetBV() & 0x06) == 0x06 && __get_cpuid_max(0, NULL) >= 7)
+	{
+		__cpuid_count(7, 0, Eax, Ebx, Ecx, Edx);
+		if (Ebx & bit_AVX2)
+			Level = PNG_SIMD_AVX2;
+	}
+
+	return Level;
+#else
+	return PNG_SIMD_SCALAR;
+#endif
+}
+
+////////// Dispatch //////////
+int PNGGetSIMDSupport()
+{
+	static const int Support = PNGDetectSIMD();		// Once, thread safe
+
+	return Support;
+}
+
+int PNGGetSIMDLevel()
+{
+	int Level = SIMDLevel;
+
+	return (Level >= 0) ? Level : PNGGetSIMDSupport();
+}
+
+int PNGSetSIMDLevel(int Level)
+{
+	if (Level < PNG_SIMD_SCALAR)
+		Level = PNG_SIMD_SCALAR;
+	if (Level > PNGGetSIMDSupport())
+		Level = PNGGetSIMDSupport();
+
+	SIMDLevel = Level;
+	return Level;
+}
+
+const char * PNGSIMDName(int Level)
+{
+	if (Level < 0 || Level >= PNG_SIMD_COUNT)
+		return "unknown";
+
+	return SIMDNames[Level];
+}
+
+void PNGFilterRow(uchar * Out, const uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType)
+{
+	PERF_SCOPE(PERF_PH_PNG_FILTER);
+
+	if (FilterType == 0)
+	{
+		Out[0] = 0;		// None - plain copy on every level
+		memcpy(Out + 1, Row, Length);
+		return;
+	}
+
+	switch (PNGGetSIMDLevel())
+	{
+#ifdef PNG_SIMD_X86
+	case PNG_SIMD_AVX2:
+		PNGFilterRowAVX2(Out, Row, Upper, Length, Distance, FilterType);
+		break;
+	case PNG_SIMD_SSSE3:
+		PNGFilterRowSSSE3(Out, Row, Upper, Length, Distance, FilterType);
+		break;
+	case PNG_SIMD_SSE2:
+		PNGFilterRowSSE2(Out, Row, Upper, Length, Distance, FilterType);
+		break;
+#endif
+	default:
+		PNGFilterRowScalar(Out, Row, Upper, Length, Distance, FilterType);
+		break;
+	}
+}
+
+bool PNGUnfilterRow(uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType)
+{
+	PERF_SCOPE(PERF_PH_PNG_FILTER);
+
+	switch (PNGGetSIMDLevel())
+	{
+#ifdef PNG_SIMD_X86
+	case PNG_SIMD_AVX2:
+		return PNGUnfilterRowAVX2(Row, Upper, Length, Distance, FilterType);
+	case PNG_SIMD_SSSE3:
+		return PNGUnfilterRowSSSE3(Row, Upper, Length, Distance, FilterType);
+	case PNG_SIMD_SSE2:
+		return PNGUnfilterRowSSE2(Row, Upper, Length, Distance, FilterType);
+#endif
+	default:
+		return PNGUnfilterRowScalar(Row, Upper, Length, Distance, FilterType);
+	}
+}
+
+ulong PNGRowCost(const uchar * Row, ulong Length)
+{
+	switch (PNGGetSIMDLevel())
+	{
+#ifdef PNG_SIMD_X86
+	case PNG_SIMD_AVX2:
+		return PNGRowCostAVX2(Row, Length);
+	case PNG_SIMD_SSSE3:
+	case PNG_SIMD_SSE2:
+		return PNGRowCostSSE2(Row, Length);
+#endif
+	default:
+		return PNGRowCostScalar(Row, Length);
+	}
+}
+
+uchar * PNGFilterRowBest(uchar * Out, uchar * Scratch, const uchar * Row, const uchar * Upper, ulong Length, uint Distance)
+{
+	uchar * Best = Out;
+	uchar * Try = Scratch;
+	uchar * Swap;
+	ulong BestCost = 0;
+	ulong Cost;
+
+	// Minimum sum of absolute differences (as libpng does): smallest signed bytes deflate best
+	for (uchar FilterType = 0; FilterType <= 4; FilterType++)
+	{
+		PNGFilterRow(Try, Row, Upper, Length, Distance, FilterType);
+		{
+			PERF_SCOPE(PERF_PH_PNG_FILTER);
+			Cost = PNGRowCost(Try + 1, Length);
+		}
+		if (FilterType == 0 || Cost < BestCost)
+		{
+			BestCost = Cost;
+			Swap = Best;
+			Best = Try;
+			Try = Swap;
+		}
+		if (BestCost == 0)
+			break;		// Can't get better
+	}
+
+	return Best;
+}
+
+void PNGUnpackRow(uchar * Out, const uchar * Row, ulong Count, uint BitDepth)
+{
+	ulong Done = 0;
+
+	if (BitDepth >= 8)
+	{
+		memcpy(Out, Row, Count);
+		return;
+	}
+
+#ifdef PNG_SIMD_X86
+	if (PNGGetSIMDLevel() >= PNG_SIMD_SSE2)
+		Done = PNGUnpackRowSSE2(Out, Row, Count, BitDepth);
+#endif
+
+	// Done is a multiple of 8 samples, so tail starts on byte boundary
+	if (Done < Count)
+		PNGUnpackRowScalar(&Out[Done], &Row[Done * BitDepth / 8], Count - Done, BitDepth);
+}
+
+void PNGExpandRGB(uchar * Out, const uchar * Row, ulong Count)
+{
+	ulong Done = 0;
+
+	switch (PNGGetSIMDLevel())
+	{
+#ifdef PNG_SIMD_X86
+	case PNG_SIMD_AVX2:
+		Done = PNGExpandRGBAVX2(Out, Row, Count);
+		break;
+	case PNG_SIMD_SSSE3:
+		Done = PNGExpandRGBSSSE3(Out, Row, Count);
+		break;
+#endif
+	default:
+		break;
+	}
+
+	if (Done < Count)
+		PNGExpandRGBScalar(&Out[Done * 4], &Row[Done * 3], Count - Done);
+}
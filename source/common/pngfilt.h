@@ -0,0 +1,40 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef PNGFILT_H
+#define PNGFILT_H
+
+#include "types.h"
+
+// PNG scanline filter kernels (Sub, Up, Avg, Paeth in both directions).
+// Rows with 1 and 4 byte pixels get SSE2, SSSE3 or AVX2 code picked at
+// first use by cpuid, everything else goes to scalar code, which is also
+// kept as reference (PNGSetSIMDLevel(PNG_SIMD_SCALAR) switches to it).
+// Same goes for unpacking of 1, 2 and 4 bit samples (SSE2) and expansion of
+// RGB rows to RGBA (SSSE3, AVX2).
+
+#define PNG_SIMD_SCALAR		0
+#define PNG_SIMD_SSE2		1
+#define PNG_SIMD_SSSE3		2
+#define PNG_SIMD_AVX2		3
+#define PNG_SIMD_COUNT		4
+
+// Row is Length bytes, Upper - previous unfiltered row (zeroes for first one),
+// Distance - bytes per pixel (at least 1), FilterType - 0 - 4
+void PNGFilterRow(uchar * Out, const uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType);	// Filter row to Out (Out[0] - filter type, Length bytes after it)
+bool PNGUnfilterRow(uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType);				// Unfilter row in place (false - unknown filter)
+void PNGFilterRowScalar(uchar * Out, const uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType);	// Reference versions
+bool PNGUnfilterRowScalar(uchar * Row, const uchar * Upper, ulong Length, uint Distance, uchar FilterType);			//
+ulong PNGRowCost(const uchar * Row, ulong Length);		// Sum of absolute values of bytes taken as signed (filter choice heuristic)
+ulong PNGRowCostScalar(const uchar * Row, ulong Length);	// Reference version
+uchar * PNGFilterRowBest(uchar * Out, uchar * Scratch, const uchar * Row, const uchar * Upper, ulong Length, uint Distance);	// Try all filters, returns Out or Scratch - whichever has row of lowest cost
+void PNGUnpackRow(uchar * Out, const uchar * Row, ulong Count, uint BitDepth);	// Count samples of 1, 2, 4 or 8 bits (first one in high bits) to bytes
+void PNGExpandRGB(uchar * Out, const uchar * Row, ulong Count);					// Count RGB pixels to RGBA with opaque alpha (Out doesn't overlap Row)
+void PNGUnpackRowScalar(uchar * Out, const uchar * Row, ulong Count, uint BitDepth);	// Reference versions
+void PNGExpandRGBScalar(uchar * Out, const uchar * Row, ulong Count);				//
+int PNGGetSIMDLevel();						// Level in use (PNG_SIMD_*)
+int PNGGetSIMDSupport();					// Best level CPU supports
+int PNGSetSIMDLevel(int Level);				// Use given level (capped to supported one), returns level in use
+const char * PNGSIMDName(int Level);		// "scalar", "sse2", "ssse3", "avx2"
+
+#endif // PNGFILT_H
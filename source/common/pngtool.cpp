@@ -15,106 +15,145 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include "thpool.h"		// Goes first: sets up windows.h version
 #include "util.h"
 #include "types.h"
 #include "fops.h"
+#include "ps2hl.h"
+#include "perf.h"
 #include "zlib.h"
+#include "ztool.h"
 #include "pngtool.h"
+#include "pngfilt.h"
+#include "checksum.h"
 
-sPNGData * PNGReadChunk(FILE ** ptrFile, const char * Marker)		// Markers: "IHDR", "PLTE", "tRNS", "IDAT", "IEND"
+////////// Globals //////////
+static volatile int PNGThreads = 1;		// Threads for strips of big images
+
+// First pixel (X, Y) and steps (X, Y) of passes: plain image and 7 of Adam7
+static const uchar PNGPlainPass[1][4] = { { 0, 0, 1, 1 } };
+static const uchar PNGAdam7Passes[7][4] =
 {
-	uchar * FileData; 
-	ulong FileDataSize;
+	{ 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 }
+};
 
-	sPNGData * PNGData;			// This pointer would be returned by function
-	uchar * FinalData = NULL;	// Data from all chunks with corresponding marker
-	ulong FinalDataSize = 0;	// Size of data from all chunks with corresponding marker
+////////// Functions //////////
+static ulong PNGGetBE32(const uchar * Data)
+{
+	return ((ulong)Data[0] << 24) | ((ulong)Data[1] << 16) | ((ulong)Data[2] << 8) | (ulong)Data[3];
+}
 
-	// Check marker size
-	if (strlen(Marker) < 4)
-		return NULL;
+static ulong PNGMarker(const char * Marker)		// "IDAT" -> 0x49444154
+{
+	return PNGGetBE32((const uchar *)Marker);
+}
+
+bool PNGLoadFile(FILE ** ptrFile, sPNGFile * PNG)
+{
+	PERF_SCOPE(PERF_PH_PNG_READ);
 
-	// Allocate memory for file data and PNG data
-	FileDataSize = FileSize(ptrFile);
-	FileData = (uchar *)malloc(FileDataSize);
-	FileReadBlock(ptrFile, FileData, 0, FileDataSize);
-	PNGData = (sPNGData *)malloc(sizeof(sPNGData));
-	if (FileData == NULL || PNGData == NULL)
+	static const uchar Signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+	ulong Pos;
+	ulong Size;
+	ulong Type;
+	ulong Count = 0;
+
+	memset(PNG, 0x00, sizeof(sPNGFile));
+
+	// Whole file is read once, chunks are referenced in place
+	PNG->DataSize = FileSize(ptrFile);
+	PNG->Data = (uchar *)LibAlloc(PNG->DataSize ? PNG->DataSize : 1);
+	if (PNG->Data == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+		return false;
+	}
+	FileReadBlock(ptrFile, PNG->Data, 0, PNG->DataSize);
+	if (PNG->DataSize < sizeof(Signature) || memcmp(PNG->Data, Signature, sizeof(Signature)))
 	{
-		puts("Unable to allocate memory! \n");
-		exit(EXIT_FAILURE);
+		LibMsg(MSG_ERROR, "Corrupted file: PNG signature is not found ... \n\n");
+		PNGFreeFile(PNG);
+		return false;
 	}
 
-	// Accumulate data from all chunks with corresonding markers
-	ulong ChunkCounder = 0;
-	for (ulong i = 0; i < FileDataSize - 4; i++)
+	// Walk twice: count chunks, then fill index
+	for (int Pass = 0; Pass < 2; Pass++)
 	{
-		// Look for marker
-		if (FileData[i] == Marker[0])
-			if (FileData[i + 1] == Marker[1] && FileData[i + 2] == Marker[2] && FileData[i + 3] == Marker[3])
+		for (Pos = sizeof(Signature), Count = 0; Pos + 12 <= PNG->DataSize; Pos += Size + 12)
+		{
+			Size = PNGGetBE32(&PNG->Data[Pos]);
+			Type = PNGGetBE32(&PNG->Data[Pos + 4]);
+			if (Size > PNG->DataSize - Pos - 12)
+			{
+				LibMsg(MSG_ERROR, "Corrupted file: chunk is cut ... \n\n");
+				PNGFreeFile(PNG);
+				return false;
+			}
+
+			if (Pass == 0)
 			{
-				uchar * TempBuff = NULL;		// Temporary storage
-				ulong TempBuffSize = 0;			// Temporary storage size
-
-				uchar * ChunkData = NULL;		// Data from current chunk
-				ulong ChunkDataSize = 0;		// Size of current chunk
-
-				// Check chunk size
-				memcpy(&ChunkDataSize, &FileData[i - 4], sizeof(ChunkDataSize));
-				ChunkDataSize = UTIL_BSWAP32(ChunkDataSize);						// Swap endian
-
-				// Allocate memory for data from this chunk
-				ChunkData = (uchar *)malloc(ChunkDataSize);
-				if (ChunkData == NULL)
-				{
-					puts("Unable to allocate memory! \n");
-					exit(EXIT_FAILURE);
-				}
-
-				// Accumulate data from this chunk
-				memcpy(ChunkData, &FileData[i + 4], ChunkDataSize);
-
-				// Copy data from old FinalData to Temp and then destroy it
-				if (FinalData != NULL && FinalDataSize != 0)
-				{
-					TempBuffSize = FinalDataSize;
-					TempBuff = (uchar *)malloc(TempBuffSize);
-					memcpy(TempBuff, FinalData, FinalDataSize);
-
-					free(FinalData);
-				}
-
-				// Allocate more memory to FinalData
-				FinalDataSize = TempBuffSize + ChunkDataSize;
-				FinalData = (uchar *)malloc(FinalDataSize);
-				if (FinalData == NULL)
-				{
-					puts("Unable to allocate memory! \n");
-					exit(EXIT_FAILURE);
-				}
-
-				// Restore FinalData from Temp and copy new chunk to it
-				memcpy(FinalData, TempBuff, TempBuffSize);
-				memcpy(FinalData + TempBuffSize, ChunkData, ChunkDataSize);
-
-				// Free memory
-				free(ChunkData);
-				free(TempBuff);
-
-				ChunkCounder++;
+				// Damaged data is caught by inflate and palette checks, so CRC is only reported
+				if (ChecksumCRC32(CHECKSUM_CRC32_INIT, &PNG->Data[Pos + 4], Size + 4) != PNGGetBE32(&PNG->Data[Pos + 8 + Size]))
+					LibMsg(MSG_WARN, "CRC of %.4s chunk doesn't match ... \n", &PNG->Data[Pos + 4]);
 			}
+			else
+			{
+				PNG->Chunks[Count].Type = Type;
+				PNG->Chunks[Count].Offset = Pos + 8;
+				PNG->Chunks[Count].DataSize = Size;
+			}
+			Count++;
+
+			if (Type == PNGMarker("IEND"))
+				break;
+		}
+
+		if (Pass == 0)
+		{
+			if (Count == 0 || PNGGetBE32(&PNG->Data[sizeof(Signature) + 4]) != PNGMarker("IHDR"))
+			{
+				LibMsg(MSG_ERROR, "Corrupted file: header chunk is not found ... \n\n");
+				PNGFreeFile(PNG);
+				return false;
+			}
+
+			PNG->Chunks = (sPNGChunk *)LibAlloc(Count * sizeof(sPNGChunk));
+			if (PNG->Chunks == NULL)
+			{
+				LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+				PNGFreeFile(PNG);
+				return false;
+			}
+		}
 	}
-	printf("Found %i %s chunk(s) \n", ChunkCounder, Marker);
+	PNG->ChunkCount = Count;
+	LibMsg(MSG_DEBUG, "Found %i chunk(s) \n", Count);
 
-	// Free memory
-	free(FileData);
+	return true;
+}
 
-	// Prepare structure
-	PNGData->DataSize = FinalDataSize;
-	PNGData->Data = FinalData;
+const sPNGChunk * PNGFindChunk(const sPNGFile * PNG, const char * Marker, const sPNGChunk * After)	// Markers: "IHDR", "PLTE", "tRNS", "IDAT", "IEND"
+{
+	ulong Type;
+	ulong i;
 
-	// Return pointer to structure
-	return PNGData;
+	// Check marker size
+	if (strlen(Marker) < 4)
+		return NULL;
+
+	Type = PNGMarker(Marker);
+	for (i = (After != NULL) ? (ulong)(After - PNG->Chunks) + 1 : 0; i < PNG->ChunkCount; i++)
+		if (PNG->Chunks[i].Type == Type)
+			return &PNG->Chunks[i];
+
+	return NULL;
+}
+
+void PNGFreeFile(sPNGFile * PNG)
+{
+	LibFree(PNG->Data);
+	LibFree(PNG->Chunks);
+	memset(PNG, 0x00, sizeof(sPNGFile));
 }
 
 void PNGWriteChunk(FILE ** ptrFile, const char * Marker, sPNGData * Chunk)	// Markers: "IHDR", "PLTE", "tRNS", "IDAT", "IEND"
@@ -126,9 +165,9 @@ void PNGWriteChunk(FILE ** ptrFile, const char * Marker, sPNGData * Chunk)	// Ma
 		return;
 
 	// Calculate CRC
-	CRC = crc32(0L, (const Bytef *) Marker, 4);
+	CRC = ChecksumCRC32(CHECKSUM_CRC32_INIT, Marker, 4);
 	if (Chunk->DataSize != 0)
-		CRC = crc32(CRC, Chunk->Data, Chunk->DataSize);
+		CRC = ChecksumCRC32(CRC, Chunk->Data, Chunk->DataSize);
 	CRC = UTIL_BSWAP32(CRC);
 
 	// Write chunk size
@@ -155,9 +194,9 @@ void PNGWriteChunk(FILE ** ptrFile, const char * Marker, const void * Data, ulon
 		return;
 
 	// Calculate CRC
-	CRC = crc32(0L, (const Bytef *)Marker, 4);
+	CRC = ChecksumCRC32(CHECKSUM_CRC32_INIT, Marker, 4);
 	if (DataSize != 0)
-		CRC = crc32(CRC, (const Bytef *) Data, DataSize);
+		CRC = ChecksumCRC32(CRC, Data, DataSize);
 	CRC = UTIL_BSWAP32(CRC);
 
 	// Write chunk size
@@ -195,89 +234,55 @@ uchar PNGGetByteFromRow(uchar * Row, uint PixelNumber, uint BitDepth)
 
 bool PNGUnfilter(sPNGData * InData, uint Height, uint Width, uint BytesPerPixel, uint BitDepth)		// Reverse filtering effects (get raw data)
 {
+	PERF_SCOPE(PERF_PH_PNG_FILTER);
+
 	uchar * RawData;
 	ulong RawDataSize;
+	uchar * Zeroes;
+
+	// Check bit depth
+	if (BitDepth == 0 || BitDepth > 8 || (8 % BitDepth) != 0)
+		return false;
 
 	// Allocate memory for decoded bitmap
 	RawDataSize = Width * Height * BytesPerPixel;
-	RawData = (uchar *)malloc(RawDataSize);
+	RawData = (uchar *)LibAlloc(RawDataSize ? RawDataSize : 1);
 	if (RawData == NULL)
 	{
-		puts("Unable to allocate memory! \n");
-		exit(EXIT_FAILURE);
+		LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+		return false;
 	}
 
-	uint RowLength = ceil((double)Width * (double)BytesPerPixel * (double)BitDepth / 8.0);	// Row length of original bitmap
+	uint RowLength = (Width * BytesPerPixel * BitDepth + 7) / 8;							// Row length of original bitmap
 	uint NewRowLength = Width * BytesPerPixel;												// Row length of output bitmap
-	uchar FilterType;		// Filter type
-	uchar Current;			// Current pixel
-	uchar Previous;			// Previous (left) pixel
-	uchar Upper;			// Upper pixel
-	uchar UpperPrevious;	// Upper previous pixel
-	uchar Paeth;			// Paeth predicted pixel
+	uint Distance = (BytesPerPixel * BitDepth >= 8) ? BytesPerPixel * BitDepth / 8 : 1;	// Bytes between same samples of neighbour pixels
+	Zeroes = (uchar *)LibCalloc(RowLength + 1, 1);											// Row above first one
+	if (Zeroes == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+		LibFree(RawData);
+		return false;
+	}
+
+	// Unfilter rows in place (packed), then unpack samples of sub-8 bit rows
 	for (ulong Row = 0; Row < Height; Row++)
 	{
-		FilterType = InData->Data[Row * (RowLength + 1)];	// Get filter type from 1-st byte of pixel row
-		if (FilterType > 4)									// Return flase if unsupported fiter is detected 
-			return false;
-		if (BitDepth < 8 && FilterType != 0)				// No support for filtering with bit depth < 8
-			return false;
+		uchar * Current = &InData->Data[Row * (RowLength + 1)];
+		const uchar * Upper = (Row == 0) ? Zeroes : &InData->Data[(Row - 1) * (RowLength + 1) + 1];
 
-		for (int i = 0; i < NewRowLength; i++)
+		if (PNGUnfilterRow(Current + 1, Upper, RowLength, Distance, Current[0]) == false)
 		{
-			// Calculate values for all filters
-			Current = PNGGetByteFromRow(InData->Data + (Row * (RowLength + 1) + 1), i, BitDepth);
-			if (i < BytesPerPixel)
-			{
-				Previous = 0;
-			}
-			else
-			{
-				Previous = RawData[Row * NewRowLength + i - BytesPerPixel];
-			}
-			if (Row == 0)
-			{
-				Upper = 0;
-				UpperPrevious = 0;
-			}
-			else
-			{
-				Upper = RawData[(Row - 1) * NewRowLength + i];
-				if (i < BytesPerPixel)
-				{
-					UpperPrevious = 0;
-				}
-				else
-				{
-					UpperPrevious = RawData[(Row - 1) * NewRowLength + i - BytesPerPixel];
-				}
-			}
-			Paeth = PaethPredictor(Previous, Upper, UpperPrevious);
-
-			// Unfilter image
-			switch (FilterType)		// Filters are applied per pixels for each channel individually (R, G, B, A)
-			{
-			case 0:			// No filter
-				RawData[Row * NewRowLength + i] = Current;
-				break;
-			case 1:			// SUB filter (Difference between current and previous pixels)
-				RawData[Row * NewRowLength + i] = Current + Previous;
-				break;
-			case 2:			// UP filter (Difference between current and upper pixels)
-				RawData[Row * NewRowLength + i] = Current + Upper;
-				break;
-			case 3:			// AVG filter (Difference between current pixel and average of prevoius and upper pixels)
-				RawData[Row * NewRowLength + i] = Current + floor(((double)Previous + (double)Upper) / 2);
-				break;
-			case 4:			// Paeth filter (Difference between current pixel and predicted pixel. Predicted pixel can be previous, upper, or upper previous pixel. Criteria of prediction - lowest delta with current pixel.)
-				RawData[Row * NewRowLength + i] = Current + Paeth;
-				break;
-			}
+			LibFree(Zeroes);
+			LibFree(RawData);
+			return false;
 		}
+
+		PNGUnpackRow(&RawData[Row * NewRowLength], Current + 1, NewRowLength, BitDepth);
 	}
+	LibFree(Zeroes);
 
 	// Destroy old data
-	free(InData->Data);
+	LibFree(InData->Data);
 
 	// Update input structure
 	InData->Data = RawData;
@@ -288,87 +293,35 @@ bool PNGUnfilter(sPNGData * InData, uint Height, uint Width, uint BytesPerPixel,
 
 bool PNGFilter(sPNGData * InData, uint Height, uint Width, uint BytesPerPixel, uchar FilterType)		// Apply filter to raw data
 {
+	PERF_SCOPE(PERF_PH_PNG_FILTER);
+
 	uchar * FiltData;
 	ulong FiltDataSize;
+	uchar * Zeroes;
 
 	// Check filter type
 	if (FilterType > 4)
 		return false;
 
 	// Allocate memory for filtered bitmap
+	uint RowLength = Width * BytesPerPixel;
 	FiltDataSize = Width * Height * BytesPerPixel + Height;
-	FiltData = (uchar *)malloc(FiltDataSize);
-	if (FiltData == NULL)
+	FiltData = (uchar *)LibAlloc(FiltDataSize);
+	Zeroes = (uchar *)LibCalloc(RowLength + 1, 1);		// Row above first one
+	if (FiltData == NULL || Zeroes == NULL)
 	{
-		puts("Unable to allocate memory! \n");
-		exit(EXIT_FAILURE);
+		LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+		LibFree(FiltData);
+		LibFree(Zeroes);
+		return false;
 	}
 
-	uint RowLength = Width * BytesPerPixel;
-	uchar Current;
-	uchar Previous;
-	uchar Upper;
-	uchar UpperPrevious;
-	uchar Paeth;
 	for (ulong Row = 0; Row < Height; Row++)
-	{
-		FiltData[Row * (RowLength + 1)] = FilterType;		// Set filter type in first byte of row
-
-		for (int i = 0; i < RowLength; i++)
-		{
-			// Calculate values for all filters
-			Current = InData->Data[Row * RowLength + i];
-			if (i < BytesPerPixel)
-			{
-				Previous = 0;
-			}
-			else
-			{
-				Previous = InData->Data[Row * RowLength + i - BytesPerPixel];
-			}
-			if (Row == 0)
-			{
-				Upper = 0;
-				UpperPrevious = 0;
-			}
-			else
-			{
-				Upper = InData->Data[(Row - 1) * RowLength + i];
-				if (i < BytesPerPixel)
-				{
-					UpperPrevious = 0;
-				}
-				else
-				{
-					UpperPrevious = InData->Data[(Row - 1) * RowLength + i - BytesPerPixel];
-				}
-			}
-			Paeth = PaethPredictor(Previous, Upper, UpperPrevious);
-
-			// Unfilter image
-			switch (FilterType)		// Filters are applied per pixels for each channel separately (R, G, B, A)
-			{
-			case 0:			// No filter
-				FiltData[Row * (RowLength + 1) + (i + 1)] = Current;
-				break;
-			case 1:			// SUB filter (Difference between current and previous pixels)
-				FiltData[Row * (RowLength + 1) + (i + 1)] = Current - Previous;
-				break;
-			case 2:			// UP filter (Difference between current and upper pixels)
-				FiltData[Row * (RowLength + 1) + (i + 1)] = Current - Upper;
-				break;
-			case 3:			// AVG filter (Difference between current pixel and average of prevoius and upper pixels)
-				FiltData[Row * (RowLength + 1) + (i + 1)] = Current - floor(((double)Previous + (double)Upper) / 2);
-				break;
-			case 4:			// Paeth filter (Difference between current pixel and predicted pixel. Predicted pixel can be previous, upper, or upper previous pixel. Criteria of prediction - lowest delta with current pixel.)
-				FiltData[Row * (RowLength + 1) + (i + 1)] = Current - Paeth;
-				break;
-			}
-		}
-	}
+		PNGFilterRow(&FiltData[Row * (RowLength + 1)], &InData->Data[Row * RowLength], (Row == 0) ? Zeroes : &InData->Data[(Row - 1) * RowLength], RowLength, BytesPerPixel, FilterType);
+	LibFree(Zeroes);
 
 	// Destroy old data
-	free(InData->Data);
+	LibFree(InData->Data);
 
 	// Update input structure
 	InData->Data = FiltData;
@@ -383,11 +336,11 @@ bool PNGDecompress(sPNGData * InData)
 	ulong DDataSize;
 
 	// Decompress image
-	if (ZDecompress(InData->Data, InData->DataSize, &DData, &DDataSize, InData->DataSize) == false)
+	if (ZDecompress(InData->Data, InData->DataSize, &DData, &DDataSize, InData->DataSize) != PS2HL_OK)
 		return false;
 
 	// Destroy old data
-	free(InData->Data);
+	LibFree(InData->Data);
 
 	// Update input structure
 	InData->Data = DData;
@@ -402,11 +355,11 @@ bool PNGCompress(sPNGData * InData)
 	ulong CDataSize;
 
 	// Decompress image
-	if (ZCompress(InData->Data, InData->DataSize, &CData, &CDataSize) == false)
+	if (ZCompress(InData->Data, InData->DataSize, &CData, &CDataSize) != PS2HL_OK)
 		return false;
 
 	// Destroy old data
-	free(InData->Data);
+	LibFree(InData->Data);
 
 	// Update input structure
 	InData->Data = CData;
@@ -439,198 +392,392 @@ int PaethPredictor(int a, int b, int c)
 	}
 }
 
-sPNGData * PNGReadPalette(FILE ** ptrFile)
+bool PNGReadCLUT(const sPNGFile * PNG, uchar * CLUT, uchar Mode)
 {
-	sPNGData * RGBPalette;
-	sPNGData * Alpha;
-	
-	uchar * FullRGBPalette;
-	uchar * FullAlpha;
-	sPNGData * RGBAPalette;
-
-	// Read palette
-	RGBPalette = PNGReadChunk(ptrFile, "PLTE");
-	
-	// Check if palette is not present
-	if (RGBPalette->Data == NULL)
+	PERF_SCOPE(PERF_PH_PALETTE);
+
+	const sPNGChunk * RGBPalette;
+	const sPNGChunk * Alpha;
+	const uchar * RGB;
+	const uchar * A;
+	uchar * Entry;
+	ulong Colors;
+	ulong Alphas;
+
+	// Find palette
+	RGBPalette = PNGFindChunk(PNG, "PLTE", NULL);
+	if (RGBPalette == NULL || RGBPalette->DataSize == 0)
 	{
-		puts("Corrupted file: palette chunk is not present ... \n");
-		exit(EXIT_FAILURE);
+		LibMsg(MSG_ERROR, "Corrupted file: palette chunk is not present ... \n\n");
+		return false;
 	}
-	else
+	Colors = RGBPalette->DataSize / 3;
+	if (Colors > 0x100)
+		Colors = 0x100;
+	if (Colors < 0x100)
+		LibMsg(MSG_INFO, "Palette is cut, restoring ...\n");
+
+	// Find alpha
+	Alpha = PNGFindChunk(PNG, "tRNS", NULL);
+	Alphas = (Alpha != NULL) ? Alpha->DataSize : 0;
+	if (Alphas > 0x100)
+		Alphas = 0x100;
+	if (Alpha == NULL)
+		LibMsg(MSG_INFO, "Converting 24 bit palette to 32 bit ...\n");
+	else if (Alphas < 0x100)
+		LibMsg(MSG_INFO, "Alpha is cut, restoring ...\n");
+
+	// Merge RGB palette and alpha straight to CLUT (missing colors are black, missing alpha is opaque)
+	RGB = &PNG->Data[RGBPalette->Offset];
+	A = (Alpha != NULL) ? &PNG->Data[Alpha->Offset] : NULL;
+	for (ulong Element = 0; Element < 0x100; Element++)
 	{
-		// Check if palette is cut
-		if (RGBPalette->DataSize < 0x300)
+		// Swap bits 3 and 4 of index: 8 - 15 <-> 16 - 23
+		Entry = &CLUT[((Element & ~0x18UL) | ((Element & 0x08) << 1) | ((Element & 0x10) >> 1)) * 4];
+		Entry[3] = ((Element < Alphas) ? A[Element] : 0xFF) / 2;
+		if (Mode == PNG_CLUT_ALPHA && Entry[3] == 0x7F)
+			Entry[3] = 0x80;
+
+		// Transparent entries of textures are blacked out to avoid artifacts
+		if (Element >= Colors || (Mode == PNG_CLUT_ALPHA && Entry[3] == 0x00))
 		{
-			puts("Palette is cut, restoring ...");
-			
-			// Allocate memory for full RGB palette
-			FullRGBPalette = (uchar *)malloc(0x300);
-			if (FullRGBPalette == NULL)
-			{
-				puts("Unable to allocate memory! \n");
-				exit(EXIT_FAILURE);
-			}
-
-			// Copy cut palette to full
-			memset(FullRGBPalette, 0x00, 0x300);
-			memcpy(FullRGBPalette, RGBPalette->Data, RGBPalette->DataSize);
-
-			// Destroy cut palette and set pointer to full one
-			free(RGBPalette->Data);
-			RGBPalette->DataSize = 0x300;
-			RGBPalette->Data = FullRGBPalette;
+			Entry[0] = 0x00;
+			Entry[1] = 0x00;
+			Entry[2] = 0x00;
+		}
+		else
+		{
+			Entry[0] = RGB[Element * 3 + 0] / 2;
+			Entry[1] = RGB[Element * 3 + 1] / 2;
+			Entry[2] = RGB[Element * 3 + 2] / 2;
 		}
 	}
 
-	// Read alpha
-	Alpha = PNGReadChunk(ptrFile, "tRNS");
+	return true;
+}
 
-	// Check if alpha is not present
-	if (Alpha->Data == NULL)
+// Row decoder: IDAT chunks are fed to inflate in place, each row is
+// inflated into two-row window and unfiltered against the previous one
+struct sPNGRowReader
+{
+	z_stream * Stream;			// Raw inflate stream of thread (ZInflateBegin())
+	const sPNGFile * PNG;
+	const sPNGChunk * Chunk;	// Current IDAT chunk (NULL - no more chunks)
+	ulong Adler;				// Adler-32 of inflated data
+	int Result;					// Last inflate() result
+};
+
+static void PNGNextIDAT(sPNGRowReader * Reader)	// Next chunk when current one is used up
+{
+	while (Reader->Stream->avail_in == 0 && Reader->Chunk != NULL)
 	{
-		puts("Converting 24 bit palette to 32 bit ...");
-
-		// Allocate memory for new alpha
-		FullAlpha = (uchar *)malloc(0x100);
-		if (FullAlpha == NULL)
+		Reader->Chunk = PNGFindChunk(Reader->PNG, "IDAT", Reader->Chunk);
+		if (Reader->Chunk != NULL)
 		{
-			puts("Unable to allocate memory! \n");
-			exit(EXIT_FAILURE);
+			Reader->Stream->next_in = &Reader->PNG->Data[Reader->Chunk->Offset];
+			Reader->Stream->avail_in = Reader->Chunk->DataSize;
 		}
+	}
+}
 
-		// Initialize new alpha
-		memset(FullAlpha, 0xFF, 0x100);
+static bool PNGReadIDATBytes(sPNGRowReader * Reader, uchar * Out, uint Count)	// Take bytes outside of deflate data (zlib header, trailer)
+{
+	for (uint i = 0; i < Count; i++)
+	{
+		PNGNextIDAT(Reader);
+		if (Reader->Stream->avail_in == 0)
+			return false;
+		Out[i] = *Reader->Stream->next_in++;
+		Reader->Stream->avail_in--;
+	}
 
-		// Set pointer to new alpha
-		Alpha->DataSize = 0x100;
-		Alpha->Data = FullAlpha;
+	return true;
+}
+
+static bool PNGInflateRow(sPNGRowReader * Reader, uchar * Row, ulong RowSize)	// Inflate one row (with filter type byte)
+{
+	PERF_SCOPE(PERF_PH_INFLATE);
+
+	Reader->Stream->next_out = Row;
+	Reader->Stream->avail_out = RowSize;
+	while (Reader->Stream->avail_out != 0)
+	{
+		// Inflate may still have buffered output after last chunk
+		PNGNextIDAT(Reader);
+
+		if (Reader->Result == Z_STREAM_END)
+			return false;		// Stream is over before bitmap
+		Reader->Result = inflate(Reader->Stream, Z_NO_FLUSH);
+		if (Reader->Result != Z_OK && Reader->Result != Z_STREAM_END)
+			return false;		// Damaged data or no input left (Z_BUF_ERROR)
 	}
-	else
+	Reader->Adler = ChecksumAdler32(Reader->Adler, Row, RowSize);
+
+	return true;
+}
+
+static void PNGCheckAdler(sPNGRowReader * Reader)	// Warn when Adler-32 of image data doesn't match (bitmap is decoded by now)
+{
+	PERF_SCOPE(PERF_PH_INFLATE);
+
+	uchar Trailer[ZTRAILER_SIZE];
+	uchar Extra;
+
+	// Last row may be out before end of stream is read
+	while (Reader->Result == Z_OK)
 	{
-		// Check if alpha is cut
-		if (Alpha->DataSize < 0x100)
-		{
-			puts("Alpha is cut, restoring ...");
+		PNGNextIDAT(Reader);
+		Reader->Stream->next_out = &Extra;
+		Reader->Stream->avail_out = 1;
+		Reader->Result = inflate(Reader->Stream, Z_NO_FLUSH);
+		if (Reader->Stream->avail_out == 0)
+			return;				// More data than bitmap needs - not checked
+	}
 
-			// Allocate memory for full alpha
-			FullAlpha = (uchar *)malloc(0x100);
-			if (FullAlpha == NULL)
-			{
-				puts("Unable to allocate memory! \n");
-				exit(EXIT_FAILURE);
-			}
+	// Cut or damaged stream after last row isn't checked either
+	if (Reader->Result != Z_STREAM_END)
+		return;
+	if (PNGReadIDATBytes(Reader, Trailer, ZTRAILER_SIZE) == false || ZGetTrailer(Trailer) != Reader->Adler)
+		LibMsg(MSG_WARN, "Adler-32 of image data doesn't match ... \n");
+}
 
-			// Copy cut alpha to full
-			memset(FullAlpha, 0xFF, 0x100);
-			memcpy(FullAlpha, Alpha->Data, Alpha->DataSize);
+static void PNGScatterRow(uchar * Dst, const uchar * Src, uint Count, uint Step, uchar BytesPerPixel)	// Put pixels of pass row to their places in image row
+{
+	switch (BytesPerPixel)
+	{
+	case 1:
+		for (uint x = 0; x < Count; x++)
+			Dst[x * Step] = Src[x];
+		break;
+	case 4:
+		for (uint x = 0; x < Count; x++)
+			memcpy(&Dst[x * Step * 4], &Src[x * 4], 4);
+		break;
+	default:
+		for (uint x = 0; x < Count; x++)
+			memcpy(&Dst[x * Step * BytesPerPixel], &Src[x * BytesPerPixel], BytesPerPixel);
+		break;
+	}
+}
 
-			// Destroy cut alpha and set pointer to full one
-			free(Alpha->Data);
-			Alpha->DataSize = 0x100;
-			Alpha->Data = FullAlpha;
-		}
+bool PNGDecodeRows(const sPNGFile * PNG, uint Width, uint Height, uchar BytesPerPixel, uint BitDepth, uchar Interlacing, tPNGRowFunc Func, void * Ctx)
+{
+	PERF_SCOPE(PERF_PH_PNG_READ);
+
+	sPNGRowReader Reader;
+	uchar * Window;				// Two filtered rows (with filter type byte) + unpacked row
+	uchar * Rows[2];
+	uchar * Unpacked;
+	uchar * Image = NULL;		// Interlaced image (one byte per sample)
+	const uchar (*Passes)[4];	// PNGPlainPass or PNGAdam7Passes
+	const uchar * Data;
+	ulong RowLength;			// Packed row without filter type byte
+	ulong OutLength;			// One byte per sample
+	uint Distance;				// Bytes between same samples of neighbour pixels (at least 1)
+	uint PassCount;
+	uint PassWidth;
+	uint PassHeight;
+	uchar Header[ZHEADER_SIZE];	// zlib header
+	bool Success = true;
+
+	// Check parameters (window size (RowLength + 1) * 2 + OutLength is at most 3 * OutLength + 2, it must fit too)
+	if (Width == 0 || Height == 0 || BitDepth == 0 || BitDepth > 8 || (8 % BitDepth) != 0 || Interlacing > 1 ||
+		(unsigned long long)Width * BytesPerPixel * 3 + 2 > 0x7FFFFFFF ||
+		(Interlacing == 1 && (unsigned long long)Width * Height * BytesPerPixel > 0x7FFFFFFF))
+	{
+		LibMsg(MSG_ERROR, "Unsupported image size ... \n\n");
+		return false;
 	}
-	
-	// Allocate memory for RGBA palette
-	RGBAPalette = (sPNGData *)malloc(sizeof(sPNGData));
-	if (RGBAPalette == NULL)
+	if (PNGFindChunk(PNG, "IDAT", NULL) == NULL)
 	{
-		puts("Unable to allocate memory! \n");
-		exit(EXIT_FAILURE);
+		LibMsg(MSG_ERROR, "Can't read image data ... \n\n");
+		return false;
 	}
-	RGBAPalette->DataSize = 0x400;
-	RGBAPalette->Data = (uchar *)malloc(RGBAPalette->DataSize);
-	if (RGBAPalette->Data == NULL)
+	RowLength = ((ulong)Width * BytesPerPixel * BitDepth + 7) / 8;
+	OutLength = (ulong)Width * BytesPerPixel;
+	Distance = (BytesPerPixel * BitDepth >= 8) ? BytesPerPixel * BitDepth / 8 : 1;
+	Passes = (Interlacing == 1) ? PNGAdam7Passes : PNGPlainPass;
+	PassCount = (Interlacing == 1) ? 7 : 1;
+
+	// Allocate window (and whole image, as rows of interlaced one are known only after last pass)
+	Window = (uchar *)LibAlloc((RowLength + 1) * 2 + OutLength);
+	if (Window != NULL && Interlacing == 1)
 	{
-		puts("Unable to allocate memory! \n");
-		exit(EXIT_FAILURE);
+		LibMsg(MSG_INFO, "De-interlacing image ...\n");
+		Image = (uchar *)LibAlloc(OutLength * Height);
+	}
+	if (Window == NULL || (Interlacing == 1 && Image == NULL))
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+		LibFree(Window);
+		return false;
 	}
+	Rows[0] = Window;
+	Rows[1] = Window + RowLength + 1;
+	Unpacked = Window + (RowLength + 1) * 2;
 
-	// Merge RGB palette and Alpha to RGBA palette as in PSI
-	for (ulong Element = 0; Element < 0x100; Element++)
+	memset(&Reader, 0x00, sizeof(Reader));
+	Reader.Stream = ZInflateBegin();
+	if (Reader.Stream == NULL)
 	{
-		RGBAPalette->Data[Element * 4 + 0] = RGBPalette->Data[Element * 3 + 0];
-		RGBAPalette->Data[Element * 4 + 1] = RGBPalette->Data[Element * 3 + 1];
-		RGBAPalette->Data[Element * 4 + 2] = RGBPalette->Data[Element * 3 + 2];
-		RGBAPalette->Data[Element * 4 + 3] = Alpha->Data[Element];
+		LibFree(Image);
+		LibFree(Window);
+		return false;
 	}
+	Reader.PNG = PNG;
+	Reader.Chunk = PNGFindChunk(PNG, "IDAT", NULL);
+	Reader.Stream->next_in = &PNG->Data[Reader.Chunk->Offset];
+	Reader.Stream->avail_in = Reader.Chunk->DataSize;
+	Reader.Adler = CHECKSUM_ADLER32_INIT;
+	Reader.Result = Z_OK;
+
+	// Inflate stream is raw, zlib header is checked here
+	if (PNGReadIDATBytes(&Reader, Header, ZHEADER_SIZE) == false || ZCheckHeader(Header) == false)
+	{
+		LibMsg(MSG_ERROR, "Can't decompress image data ... \n\n");
+		Success = false;
+	}
+
+	// Each pass is filtered as separate image, passes without pixels have no rows at all
+	for (uint Pass = 0; Pass < PassCount && Success == true; Pass++)
+	{
+		const uchar * P = Passes[Pass];
+
+		PassWidth = (Width > P[0]) ? (Width - P[0] + P[2] - 1) / P[2] : 0;
+		PassHeight = (Height > P[1]) ? (Height - P[1] + P[3] - 1) / P[3] : 0;
+		if (PassWidth == 0 || PassHeight == 0)
+			continue;
+		RowLength = ((ulong)PassWidth * BytesPerPixel * BitDepth + 7) / 8;
+		memset(Rows[1], 0x00, RowLength + 1);		// Row above first one is zero
 
-	// Free memory
-	free(RGBPalette);
-	free(Alpha);
+		for (uint Row = 0; Row < PassHeight && Success == true; Row++)
+		{
+			uchar * Current = Rows[Row & 1];
+			uchar * Upper = Rows[(Row & 1) ^ 1];
+
+			if (PNGInflateRow(&Reader, Current, RowLength + 1) == false)
+			{
+				LibMsg(MSG_ERROR, "Can't decompress image data ... \n\n");
+				Success = false;
+				break;
+			}
+			if (PNGUnfilterRow(Current + 1, Upper + 1, RowLength, Distance, Current[0]) == false)
+			{
+				LibMsg(MSG_ERROR, "Can't unfilter image ... \n\n");
+				Success = false;
+				break;
+			}
 
-	// Return pointer
-	return RGBAPalette;
+			// Unpack samples to bytes
+			Data = Current + 1;
+			if (BitDepth < 8)
+			{
+				PNGUnpackRow(Unpacked, Current + 1, (ulong)PassWidth * BytesPerPixel, BitDepth);
+				Data = Unpacked;
+			}
+
+			if (Image == NULL)
+				Success = Func(Ctx, Row, Data);
+			else
+				PNGScatterRow(&Image[(ulong)(P[1] + Row * P[3]) * OutLength + P[0] * BytesPerPixel], Data, PassWidth, P[2], BytesPerPixel);
+		}
+	}
+
+	// Interlaced image goes out row by row once it is complete
+	for (uint Row = 0; Image != NULL && Row < Height && Success == true; Row++)
+		Success = Func(Ctx, Row, &Image[(ulong)Row * OutLength]);
+
+	if (Success == true)
+		PNGCheckAdler(&Reader);
+	ZInflateEnd(Reader.Stream);
+	LibFree(Image);
+	LibFree(Window);
+
+	return Success;
 }
 
-sPNGData * PNGReadBitmap(FILE ** ptrFile, uint Width, uint Height, uchar BytesPerPixel, uint BitDepth)
+// Collects decoded rows into bitmap
+struct sPNGBitmapRows
 {
-	sPNGData * PNGImgData;
-	
-	// Allocate memory
-	PNGImgData = (sPNGData *)malloc(sizeof(sPNGData));
-	if (PNGImgData == NULL)
-	{
-		puts("Unable to allocate memory! \n");
-		exit(EXIT_FAILURE);
-	}
+	uchar * Data;
+	uint Width;
+	uchar BytesPerPixel;
+};
+
+static bool PNGStoreRow(void * Ctx, uint Row, const uchar * Data)
+{
+	sPNGBitmapRows * Bitmap = (sPNGBitmapRows *)Ctx;
 
-	// Read compressed data
-	PNGImgData = PNGReadChunk(ptrFile, "IDAT");
-	if (PNGImgData->Data == NULL)
+	// 24 bit rows get alpha on the fly
+	if (Bitmap->BytesPerPixel == 3)
+		PNGExpandRGB(&Bitmap->Data[(ulong)Row * Bitmap->Width * 4], Data, Bitmap->Width);
+	else
 	{
-		puts("Can't read image data ... \n");
-		exit(EXIT_FAILURE);
+		memcpy(&Bitmap->Data[(ulong)Row * Bitmap->Width * Bitmap->BytesPerPixel], Data, Bitmap->Width * Bitmap->BytesPerPixel);
 	}
 
-	// Decompress data
-	PNGDecompress(PNGImgData);
+	return true;
+}
 
-	// Unfilter
-	if (PNGUnfilter(PNGImgData, Height, Width, BytesPerPixel, BitDepth) == false)
+sPNGData * PNGReadBitmap(const sPNGFile * PNG, uint Width, uint Height, uchar BytesPerPixel, uint BitDepth, uchar Interlacing)
+{
+	PERF_SCOPE(PERF_PH_PNG_READ);
+
+	sPNGData * PNGImgData;
+	sPNGBitmapRows Bitmap;
+	uchar OutBytesPerPixel = (BytesPerPixel == 3) ? 4 : BytesPerPixel;
+
+	// Check size
+	if ((unsigned long long)Width * Height * OutBytesPerPixel > 0x7FFFFFFF)
 	{
-		puts("Can't unfilter image ... \n");
-		exit(EXIT_FAILURE);
+		LibMsg(MSG_ERROR, "Unsupported image size ... \n\n");
+		return NULL;
 	}
 
 	// If bimap is 24 bit then convert it to 32 bit format (add alpha)
 	if (BytesPerPixel == 3)
-	{
-		uchar * Bitmap32;
-		ulong Bitmap32Size;
+		LibMsg(MSG_INFO, "Converting 24 bit bitmap to 32 bit format ...\n");
 
-		puts("Converting 24 bit bitmap to 32 bit format ...");
-
-		// Allocate memory
-		Bitmap32Size = Width * Height * 4;
-		Bitmap32 = (uchar *) malloc(Bitmap32Size);
-		if (Bitmap32 == NULL)
-		{
-			puts("Unable to allocate memory ... \n");
-			exit(EXIT_FAILURE);
-		}
-
-		// Add alpha to each pixel of bitmap
-		for (ulong Pixel = 0; Pixel < (Width * Height); Pixel++)
-		{
-			Bitmap32[Pixel * 4 + 0] = PNGImgData->Data[Pixel * BytesPerPixel + 0];
-			Bitmap32[Pixel * 4 + 1] = PNGImgData->Data[Pixel * BytesPerPixel + 1];
-			Bitmap32[Pixel * 4 + 2] = PNGImgData->Data[Pixel * BytesPerPixel + 2];
-			Bitmap32[Pixel * 4 + 3] = 0xFF;
-		}
+	// Allocate memory for bitmap
+	PNGImgData = (sPNGData *)LibAlloc(sizeof(sPNGData));
+	if (PNGImgData != NULL)
+	{
+		PNGImgData->DataSize = Width * Height * OutBytesPerPixel;
+		PNGImgData->Data = (uchar *)LibAlloc(PNGImgData->DataSize ? PNGImgData->DataSize : 1);
+	}
+	if (PNGImgData == NULL || PNGImgData->Data == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ... \n\n");
+		LibFree(PNGImgData);
+		return NULL;
+	}
 
-		// Destroy 24 bit bitmap and set pointer to 32 bit bitmap
-		free(PNGImgData->Data);
-		PNGImgData->DataSize = Bitmap32Size;
-		PNGImgData->Data = Bitmap32;
+	// Decode rows straight to bitmap
+	Bitmap.Data = PNGImgData->Data;
+	Bitmap.Width = Width;
+	Bitmap.BytesPerPixel = BytesPerPixel;
+	if (PNGDecodeRows(PNG, Width, Height, BytesPerPixel, BitDepth, Interlacing, PNGStoreRow, &Bitmap) == false)
+	{
+		PNGFreeData(PNGImgData);
+		return NULL;
 	}
 
 	return PNGImgData;
 }
 
+void PNGFreeData(sPNGData * PNGData)
+{
+	if (PNGData == NULL)
+		return;
+
+	LibFree(PNGData->Data);
+	LibFree(PNGData);
+}
+
 void PNGWritePalette(FILE ** ptrFile, sPNGData * RGBAPalette)
 {
+	PERF_SCOPE(PERF_PH_PNG_WRITE);
+
 	ulong RGBPaletteSize = 0x300;
 	uchar RGBPalette[0x300];
 
@@ -654,125 +801,401 @@ void PNGWritePalette(FILE ** ptrFile, sPNGData * RGBAPalette)
 	PNGWriteChunk(ptrFile, "tRNS", Alpha, AlphaSize);
 }
 
-void PNGWriteBitmap(FILE ** ptrFile, uint Width, uint Height, uchar BytesPerPixel, sPNGData * RGBABitmap)
+// Filters rows of source one by one (two-row window)
+struct sPNGRowEncoder
 {
-	uchar FilterType = 4;	// Paeth filter
+	tPNGRowSource Source;
+	void * Ctx;
+	uchar * Rows[2];			// Current and previous source rows
+	uchar * Filtered;			// Filtered row (with filter type byte)
+	uchar * Scratch;			// Second filtered row for adaptive filtering
+	ulong RowLength;
+	uint Distance;
+	uchar FilterType;
+};
+
+static const uchar * PNGEncodeRow(sPNGRowEncoder * Enc, uint Row)	// Filtered row (RowLength + 1 bytes), NULL - source failed
+{
+	const uchar * Data = Enc->Source(Enc->Ctx, Row);
 
-	// Apply filter
-	PNGFilter(RGBABitmap, Height, Width, BytesPerPixel, FilterType);
+	if (Data == NULL)
+		return NULL;
+	memcpy(Enc->Rows[Row & 1], Data, Enc->RowLength);		// Source may reuse its buffer
 
-	// Compress image
-	PNGCompress(RGBABitmap);
-	
-	// Write image "IDAT" chunk
-	PNGWriteChunk(ptrFile, "IDAT", RGBABitmap);
+	if (Enc->FilterType == PNG_FILTER_ADAPTIVE)
+		return PNGFilterRowBest(Enc->Filtered, Enc->Scratch, Enc->Rows[Row & 1], Enc->Rows[(Row & 1) ^ 1], Enc->RowLength, Enc->Distance);
+
+	PNGFilterRow(Enc->Filtered, Enc->Rows[Row & 1], Enc->Rows[(Row & 1) ^ 1], Enc->RowLength, Enc->Distance, Enc->FilterType);
+	return Enc->Filtered;
 }
 
-bool ZDecompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize, ulong StartSize)
+// Collects deflated data into IDAT chunks of PNG_IDAT_SIZE
+struct sPNGIDATWriter
 {
-	// Setting up zlib variables for decomression
-	z_stream infstream;
-	infstream.zalloc = Z_NULL;
-	infstream.zfree = Z_NULL;
-	infstream.opaque = Z_NULL;
-
-	// Setting up other variables
-	uchar * NewData;
-	ulong NewDataSize;
-	bool Finish;
+	FILE ** ptrFile;
+	uchar * Piece;
+	ulong Used;
+};
 
-	// Set starting size of decompressed data (would be increased if bigger)
-	NewDataSize = StartSize;
+static void PNGPutIDAT(sPNGIDATWriter * Writer, const uchar * Data, ulong Size)
+{
+	ulong Part;
 
-	// Decompression loop
-	do
+	while (Size > 0)
 	{
-		// Allocate memory for decompressed data
-		NewData = (uchar *)malloc(NewDataSize);
-		if (NewData == NULL)
+		Part = PNG_IDAT_SIZE - Writer->Used;
+		if (Part > Size)
+			Part = Size;
+		memcpy(&Writer->Piece[Writer->Used], Data, Part);
+		Writer->Used += Part;
+		Data += Part;
+		Size -= Part;
+
+		if (Writer->Used == PNG_IDAT_SIZE)
 		{
-			puts("Unable to allocate memory ...");
-			return false;
+			PNGWriteChunk(Writer->ptrFile, "IDAT", Writer->Piece, Writer->Used);
+			Writer->Used = 0;
 		}
+	}
+}
 
-		infstream.next_in = (Bytef *)InputData;			// Input data pointer (compressed data)
-		infstream.avail_in = (uint)InputDataSize;		// Size of input data
-		infstream.next_out = (Bytef *)NewData;			// Output data pointer (decompressed data)
-		infstream.avail_out = (uint)NewDataSize;		// Size of output data
+static bool PNGDeflateRows(sPNGRowEncoder * Enc, sPNGIDATWriter * Writer, uint Height)	// One zlib stream, row by row
+{
+	z_stream * Stream;
+	const uchar * Data;
+	uchar Wrap[ZTRAILER_SIZE];	// zlib header, then trailer
+	ulong Adler = CHECKSUM_ADLER32_INIT;
+	int Result = Z_OK;
+
+	Stream = ZDeflateBegin();
+	if (Stream == NULL)
+		return false;
+
+	// Deflate stream is raw: header goes first, Adler-32 of rows - after it
+	ZPutHeader(Wrap);
+	PNGPutIDAT(Writer, Wrap, ZHEADER_SIZE);
+	Stream->next_out = &Writer->Piece[Writer->Used];
+	Stream->avail_out = PNG_IDAT_SIZE - Writer->Used;
 
-														// Decompression work
-		if (inflateInit(&infstream) != Z_OK)
+	// Filter each row into scratch and feed it to deflate, write IDAT every time piece is full
+	for (uint Row = 0; Row <= Height && Result == Z_OK; Row++)
+	{
+		if (Row < Height)
 		{
-			puts("Zlib: can't decompress data ...");
-			return false;
+			Data = PNGEncodeRow(Enc, Row);
+			if (Data == NULL)
+			{
+				Result = Z_DATA_ERROR;
+				break;
+			}
+			Stream->next_in = (Bytef *)Data;
+			Stream->avail_in = Enc->RowLength + 1;
+			Adler = ChecksumAdler32(Adler, Data, Enc->RowLength + 1);
 		}
-		inflate(&infstream, Z_FINISH);
-		inflateEnd(&infstream);
 
-		// if buffer is full then increase buffer size and retry decompression
-		if (NewDataSize == infstream.total_out)
+		// Row is done when deflate stops with room left in piece, stream - on Z_STREAM_END
+		for (;;)
 		{
-			free(NewData);
-			NewDataSize = NewDataSize * 2 + 1;		// +1 to avoid infinite loop, when StartSize = 0
+			{
+				PERF_SCOPE(PERF_PH_DEFLATE);
+				Result = deflate(Stream, (Row < Height) ? Z_NO_FLUSH : Z_FINISH);
+			}
+			if (Result == Z_BUF_ERROR)
+				Result = Z_OK;		// No progress possible: input is used up
+			if (Result != Z_OK && Result != Z_STREAM_END)
+				break;
 
-			Finish = false;
+			if (Stream->avail_out == 0)
+			{
+				PNGWriteChunk(Writer->ptrFile, "IDAT", Writer->Piece, PNG_IDAT_SIZE - Stream->avail_out);
+				Stream->next_out = Writer->Piece;
+				Stream->avail_out = PNG_IDAT_SIZE;
+				if (Result != Z_STREAM_END)
+					continue;
+			}
+			break;
 		}
-		else
+		if (Row == Height && Result == Z_OK)
+			Result = Z_DATA_ERROR;		// Z_FINISH should end stream
+	}
+	Writer->Used = PNG_IDAT_SIZE - Stream->avail_out;
+	ZDeflateEnd(Stream);
+	if (Result != Z_STREAM_END)
+		return false;
+
+	ZPutTrailer(Wrap, Adler);
+	PNGPutIDAT(Writer, Wrap, ZTRAILER_SIZE);
+	if (Writer->Used != 0)
+		PNGWriteChunk(Writer->ptrFile, "IDAT", Writer->Piece, Writer->Used);
+	return true;
+}
+
+// Strip of big image: its filtered rows are deflated on their own as raw deflate data,
+// which ends with Z_FULL_FLUSH (byte boundary, so strips can be glued together)
+struct sPNGStrip
+{
+	uchar * Data;				// Filtered rows
+	uchar * Dict;				// Last 32 KiB of previous strip (deflate window)
+	uchar * Out;				// Deflated strip
+	ulong DataSize;				//
+	ulong DictSize;				//
+	ulong OutSize;				// Allocated, then used
+	ulong Adler;				// Adler-32 of Data
+	tThread Thread;
+	bool Threaded;				// Deflated by Thread (needs join)
+	bool Pending;				// Deflated, but not written yet
+	bool Last;					// Ends stream (Z_FINISH)
+	bool Ok;
+};
+
+static void PNGDeflateStrip(void * Arg)
+{
+	PERF_SCOPE(PERF_PH_DEFLATE);
+
+	sPNGStrip * Strip = (sPNGStrip *)Arg;
+	z_stream Stream;
+	ulong OutSize = Strip->OutSize;
+	int Result;
+
+	Strip->Ok = false;
+	Strip->Adler = ChecksumAdler32(CHECKSUM_ADLER32_INIT, Strip->Data, Strip->DataSize);
+
+	// Raw deflate: zlib header and Adler-32 are written once for whole stream
+	memset(&Stream, 0x00, sizeof(Stream));
+	if (deflateInit2(&Stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return;
+	if (Strip->DictSize != 0 && deflateSetDictionary(&Stream, Strip->Dict, Strip->DictSize) != Z_OK)
+	{
+		deflateEnd(&Stream);
+		return;
+	}
+
+	// Out has room for whole strip, so one call is enough (flush is complete when some room is left)
+	Stream.next_in = Strip->Data;
+	Stream.avail_in = Strip->DataSize;
+	Stream.next_out = Strip->Out;
+	Stream.avail_out = OutSize;
+	Result = deflate(&Stream, (Strip->Last == true) ? Z_FINISH : Z_FULL_FLUSH);
+	Strip->OutSize = OutSize - Stream.avail_out;
+	if (Strip->Last == true)
+		Strip->Ok = (Result == Z_STREAM_END);
+	else
+		Strip->Ok = (Result == Z_OK && Stream.avail_in == 0 && Stream.avail_out != 0);
+	deflateEnd(&Stream);
+}
+
+static bool PNGFinishStrip(sPNGStrip * Strip, sPNGIDATWriter * Writer, ulong * Adler)	// Wait for strip and write it
+{
+	if (Strip->Pending == false)
+		return true;
+	if (Strip->Threaded == true)
+		ThreadJoin(Strip->Thread);
+	Strip->Threaded = false;
+	Strip->Pending = false;
+
+	if (Strip->Ok == false)
+		return false;
+	PNGPutIDAT(Writer, Strip->Out, Strip->OutSize);
+	*Adler = adler32_combine(*Adler, Strip->Adler, Strip->DataSize);
+	return true;
+}
+
+static bool PNGDeflateStrips(sPNGRowEncoder * Enc, sPNGIDATWriter * Writer, uint Height, uint StripRows)	// Strips on up to PNGThreads threads
+{
+	sPNGStrip * Strips;
+	sPNGStrip * Strip;
+	sPNGStrip * Prev;
+	const uchar * Data;
+	uchar Wrap[ZTRAILER_SIZE];	// zlib header, then trailer
+	ulong Adler = CHECKSUM_ADLER32_INIT;
+	ulong StripSize = (Enc->RowLength + 1) * StripRows;
+	uint StripCount = (Height + StripRows - 1) / StripRows;
+	uint Slots = PNGThreads;
+	uint Started = 0;			// Strips given to workers
+	uint Row = 0;
+	bool Result = true;
+
+	// Strip layout depends only on image, so output is the same for any number of threads
+	if (Slots > StripCount)
+		Slots = StripCount;
+	if (Slots > POOL_MAX_THREADS)
+		Slots = POOL_MAX_THREADS;
+	if (Slots < 1)
+		Slots = 1;
+
+	Strips = (sPNGStrip *)LibCalloc(Slots, sizeof(sPNGStrip));
+	if (Strips == NULL)
+		return false;
+	for (uint i = 0; i < Slots; i++)
+	{
+		Strips[i].Data = (uchar *)LibAlloc(StripSize);
+		Strips[i].Dict = (uchar *)LibAlloc(PNG_STRIP_DICT);
+		Strips[i].Out = (uchar *)LibAlloc(compressBound(StripSize) + 16);	// + full flush marker
+		if (Strips[i].Data == NULL || Strips[i].Dict == NULL || Strips[i].Out == NULL)
+			Result = false;
+	}
+
+	ZPutHeader(Wrap);
+	PNGPutIDAT(Writer, Wrap, ZHEADER_SIZE);
+	for (uint s = 0; s < StripCount && Result == true; s++)
+	{
+		// Slot is reused every Slots strips: write what it has first, so strips go in order
+		Strip = &Strips[s % Slots];
+		if (PNGFinishStrip(Strip, Writer, &Adler) == false)
 		{
-			Finish = true;
+			Result = false;
+			break;
 		}
-	} while (Finish == false);
 
-	// Check if output data has zero size
-	if (infstream.total_out == 0)
-		return false;
+		// Dictionary - tail of previous strip, so strips compress as well as one stream
+		// (previous slot is the same one for single thread, so tail is copied before rows)
+		Strip->DictSize = 0;
+		if (s > 0)
+		{
+			Prev = &Strips[(s - 1) % Slots];
+			Strip->DictSize = (Prev->DataSize < PNG_STRIP_DICT) ? Prev->DataSize : PNG_STRIP_DICT;
+			memcpy(Strip->Dict, &Prev->Data[Prev->DataSize - Strip->DictSize], Strip->DictSize);
+		}
 
-	//puts("Decompression is completed successfully.");
+		// Rows are read and filtered here, deflate goes to worker
+		for (Strip->DataSize = 0; Row < Height && Strip->DataSize < StripSize; Row++)
+		{
+			Data = PNGEncodeRow(Enc, Row);
+			if (Data == NULL)
+			{
+				Result = false;
+				break;
+			}
+			memcpy(&Strip->Data[Strip->DataSize], Data, Enc->RowLength + 1);
+			Strip->DataSize += Enc->RowLength + 1;
+		}
+		if (Result == false)
+			break;
+
+		Strip->OutSize = compressBound(StripSize) + 16;
+		Strip->Last = (s + 1 == StripCount);
+		Strip->Pending = true;
+		Strip->Threaded = (Slots > 1 && ThreadStart(&Strip->Thread, PNGDeflateStrip, Strip) == true);
+		if (Strip->Threaded == false)
+			PNGDeflateStrip(Strip);		// Single thread or thread didn't start
+		Started++;
+	}
 
-	// Return data pointer, data size and result
-	*OutputData = NewData;
-	*OutputDataSize = infstream.total_out;
-	return true;
+	// Rest of strips in order (all of them are waited for even after error)
+	for (uint s = (Started > Slots) ? Started - Slots : 0; s < Started; s++)
+		if (PNGFinishStrip(&Strips[s % Slots], Writer, &Adler) == false)
+			Result = false;
+
+	if (Result == true)
+	{
+		ZPutTrailer(Wrap, Adler);
+		PNGPutIDAT(Writer, Wrap, ZTRAILER_SIZE);
+		if (Writer->Used != 0)
+			PNGWriteChunk(Writer->ptrFile, "IDAT", Writer->Piece, Writer->Used);
+	}
+
+	for (uint i = 0; i < Slots; i++)
+	{
+		LibFree(Strips[i].Data);
+		LibFree(Strips[i].Dict);
+		LibFree(Strips[i].Out);
+	}
+	LibFree(Strips);
+
+	return Result;
+}
+
+void PNGSetThreads(int Count)
+{
+	PNGThreads = (Count > 1) ? Count : 1;
 }
 
-bool ZCompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize)
+bool PNGEncodeRows(FILE ** ptrFile, uint Width, uint Height, uchar BytesPerPixel, uchar FilterType, tPNGRowSource Source, void * Ctx)
 {
-	// Allocate memory for compressed data
-	uchar * NewData;
-	ulong NewDataSize;
+	PERF_SCOPE(PERF_PH_PNG_WRITE);
+
+	sPNGRowEncoder Enc;
+	sPNGIDATWriter Writer;
+	uchar * Window;				// Two source rows + two filtered rows + IDAT piece
+	ulong RowLength;
+	uint StripRows;
+	bool Result;
+
+	// Check parameters (window must fit too)
+	if (FilterType > PNG_FILTER_ADAPTIVE || Width == 0 || Height == 0 || (unsigned long long)Width * BytesPerPixel * 4 + 2 + PNG_IDAT_SIZE > 0x7FFFFFFF)
+		return false;
+	RowLength = (ulong)Width * BytesPerPixel;
 
-	NewDataSize = InputDataSize;
-	NewData = (uchar *)malloc(NewDataSize);
-	if (NewData == NULL)
+	// Indexed pixels aren't intensities and predicting them rarely pays off,
+	// so adaptive mode writes them unfiltered (libpng does the same)
+	if (FilterType == PNG_FILTER_ADAPTIVE && BytesPerPixel == 1)
+		FilterType = 0;
+
+	// Allocate window
+	Window = (uchar *)LibAlloc(RowLength * 4 + 2 + PNG_IDAT_SIZE);
+	if (Window == NULL)
 	{
-		puts("Unable to allocate memory ...");
+		LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
 		return false;
 	}
+	Enc.Source = Source;
+	Enc.Ctx = Ctx;
+	Enc.Rows[0] = Window;
+	Enc.Rows[1] = Window + RowLength;
+	Enc.Filtered = Window + RowLength * 2;
+	Enc.Scratch = Enc.Filtered + RowLength + 1;
+	Enc.RowLength = RowLength;
+	Enc.Distance = (BytesPerPixel != 0) ? BytesPerPixel : 1;
+	Enc.FilterType = FilterType;
+	memset(Enc.Rows[1], 0x00, RowLength);		// Row above first one is zero
+
+	Writer.ptrFile = ptrFile;
+	Writer.Piece = Enc.Scratch + RowLength + 1;
+	Writer.Used = 0;
+
+	// Big images go in strips that are deflated in parallel, the rest - as one stream
+	StripRows = PNG_STRIP_SIZE / (RowLength + 1);
+	if (StripRows == 0)
+		StripRows = 1;
+	if ((unsigned long long)(RowLength + 1) * Height > PNG_STRIP_MIN && Height > StripRows)
+		Result = PNGDeflateStrips(&Enc, &Writer, Height, StripRows);
+	else
+		Result = PNGDeflateRows(&Enc, &Writer, Height);
+	LibFree(Window);
 
-	// Setting up zlib variables for compression
-	z_stream defstream;
-	defstream.zalloc = Z_NULL;
-	defstream.zfree = Z_NULL;
-	defstream.opaque = Z_NULL;
+	return Result;
+}
 
-	defstream.next_in = (Bytef *)InputData;			// Input data pointer (decompressed data)
-	defstream.avail_in = (ulong)InputDataSize;		// Size of input data
-	defstream.next_out = (Bytef *)NewData;			// Output data pointer (compressed data)
-	defstream.avail_out = (ulong)NewDataSize;		// Size of output data
+// Serves rows of bitmap in memory
+struct sPNGBitmapSource
+{
+	const uchar * Data;
+	ulong RowLength;
+};
 
-													// Compression work.
-	deflateInit(&defstream, Z_BEST_COMPRESSION);
-	deflate(&defstream, Z_FINISH);
-	deflateEnd(&defstream);
+static const uchar * PNGBitmapRow(void * Ctx, uint Row)
+{
+	sPNGBitmapSource * Bitmap = (sPNGBitmapSource *)Ctx;
 
-	// Check if output data has zero size
-	if (defstream.total_out == 0)
-		return false;
+	return &Bitmap->Data[Row * Bitmap->RowLength];
+}
 
-	//puts("Compression is completed succesfully.");
+bool PNGWriteBitmap(FILE ** ptrFile, uint Width, uint Height, uchar BytesPerPixel, sPNGData * RGBABitmap)
+{
+	PERF_SCOPE(PERF_PH_PNG_WRITE);
+
+	uchar FilterType = PNG_FILTER_ADAPTIVE;
+	sPNGBitmapSource Bitmap;
+
+	// Filter, compress and write image "IDAT" chunks row by row
+	Bitmap.Data = RGBABitmap->Data;
+	Bitmap.RowLength = (ulong)Width * BytesPerPixel;
+	if (PNGEncodeRows(ptrFile, Width, Height, BytesPerPixel, FilterType, PNGBitmapRow, &Bitmap) == false)
+	{
+		LibMsg(MSG_ERROR, "Zlib: can't compress image ... \n\n");
+		return false;
+	}
 
-	// Return data pointer, data size and result
-	*OutputData = NewData;
-	*OutputDataSize = defstream.total_out;
 	return true;
 }
+
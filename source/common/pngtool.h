@@ -4,6 +4,8 @@
 #ifndef PNGTOOL_H
 #define PNGTOOL_H
 
+#include "checksum.h"		// Header CRC
+
 // Data pointer + size
 struct sPNGData
 {
@@ -11,14 +13,60 @@ struct sPNGData
 	uchar * Data;
 };
 
+// Size of IDAT chunks written by encoder
+#define PNG_IDAT_SIZE 0x10000
+
+// Images bigger than PNG_STRIP_MIN (filtered) are deflated in strips of
+// PNG_STRIP_SIZE, each with last PNG_STRIP_DICT bytes of previous one as
+// dictionary, on PNGSetThreads() threads. Strips make one zlib stream.
+#define PNG_STRIP_MIN 0x100000
+#define PNG_STRIP_SIZE 0x40000
+#define PNG_STRIP_DICT 0x8000
+
+// Palette of indexed image as PS2 CLUT: 256 RGBA entries, blocks of 8 entries
+// 8 - 15 and 16 - 23 of every 32 swapped (CSM1), color values halved (0x80 - 1.0)
+#define PNG_CLUT_SIZE 0x400
+#define PNG_CLUT_HALF 0				// Every byte halved (decals)
+#define PNG_CLUT_ALPHA 1			// Same, but opaque alpha is 0x80 and transparent entries are black (textures)
+
+// Filter type for encoder: best of five filters for every row (indexed images - none)
+#define PNG_FILTER_ADAPTIVE 5
+
 // PNG types
 #define PNG_UNKNOWN 0
 #define PNG_RGB 2
 #define PNG_INDEXED 3
 #define PNG_RGBA 6
 
-// PNG Functions
-sPNGData * PNGReadChunk(FILE ** ptrFile, const char * Marker);												// Read data from all PNG chunks with specified marker
+// Chunk of PNG file (data stays in file image)
+#pragma pack(push, 8)		// In-memory only, same layout whatever packing includer has on
+struct sPNGChunk
+{
+	ulong Type;					// Marker as big endian number ("IDAT" - 0x49444154)
+	ulong Offset;				// Offset of chunk data in file
+	ulong DataSize;				// Size of chunk data
+};
+
+// PNG file image with index of its chunks
+struct sPNGFile
+{
+	uchar * Data;				// Whole file
+	sPNGChunk * Chunks;			// In file order, up to IEND
+	ulong DataSize;				//
+	ulong ChunkCount;			//
+};
+#pragma pack(pop)
+
+// Receives decoded row (Width * BytesPerPixel bytes, one byte per sample), false - stop decoding
+typedef bool (*tPNGRowFunc)(void * Ctx, uint Row, const uchar * Data);
+
+// Gives row to encode (Width * BytesPerPixel bytes, may be reused for next row), NULL - stop encoding
+typedef const uchar * (*tPNGRowSource)(void * Ctx, uint Row);
+
+// PNG Functions (functions that return pointers return NULL on failure)
+bool PNGLoadFile(FILE ** ptrFile, sPNGFile * PNG);															// Read file once and index its chunks (length, type and CRC are checked)
+const sPNGChunk * PNGFindChunk(const sPNGFile * PNG, const char * Marker, const sPNGChunk * After);		// First chunk with specified marker (After - next one after it), NULL if there is none
+void PNGFreeFile(sPNGFile * PNG);																			// Free file image and index
 void PNGWriteChunk(FILE ** ptrFile, const char * Marker, sPNGData * Chunk);									// Write chunk to PNG
 void PNGWriteChunk(FILE ** ptrFile, const char * Marker, const void * Data, ulong DataSize);				// Write chunk to PNG
 bool PNGDecompress(sPNGData * InData);																		// Decompress bitmap
@@ -27,12 +75,14 @@ uchar PNGGetByteFromRow(uchar * Row, uint PixelNumber, uint BitDepth);
 bool PNGUnfilter(sPNGData * InData, uint Height, uint Width, uint BytesPerPixel, uint BitDepth);			// Revert filtering from bitmap
 bool PNGFilter(sPNGData * InData, uint Height, uint Width, uint BytesPerPixel, uchar FilterType);			// Apply filter to bitmap
 int PaethPredictor(int a, int b, int c);																	// Paeth predictor function
-sPNGData * PNGReadPalette(FILE ** ptrFile);																	// Read palette from PNG file
-sPNGData * PNGReadBitmap(FILE ** ptrFile, uint Width, uint Height, uchar BytesPerPixel, uint BitDepth);		// Read raw bitmap from PNG file
+bool PNGReadCLUT(const sPNGFile * PNG, uchar * CLUT, uchar Mode);											// Read PLTE and tRNS to PNG_CLUT_SIZE bytes of CLUT in one pass (Mode - PNG_CLUT_*)
+bool PNGDecodeRows(const sPNGFile * PNG, uint Width, uint Height, uchar BytesPerPixel, uint BitDepth, uchar Interlacing, tPNGRowFunc Func, void * Ctx);	// Inflate and unfilter bitmap row by row (two-row window, Adam7 - whole image), rows are passed to Func in order
+sPNGData * PNGReadBitmap(const sPNGFile * PNG, uint Width, uint Height, uchar BytesPerPixel, uint BitDepth, uchar Interlacing);	// Read raw bitmap from PNG file
+bool PNGEncodeRows(FILE ** ptrFile, uint Width, uint Height, uchar BytesPerPixel, uchar FilterType, tPNGRowSource Source, void * Ctx);	// Filter rows (FilterType - 0 - 4 or PNG_FILTER_ADAPTIVE) into scratch and deflate them straight to IDAT chunks of PNG_IDAT_SIZE (memory use doesn't depend on height)
+void PNGSetThreads(int Count);																				// Threads for strips of big images (default - 1, output is the same for any count)
 void PNGWritePalette(FILE ** ptrFile, sPNGData * RGBAPalette);												// Write palette to PNG file
-void PNGWriteBitmap(FILE ** ptrFile, uint Width, uint Height, uchar BytesPerPixel, sPNGData * RGBABitmap);	// Write bitmap to PNG file
-bool ZDecompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize, ulong StartSize);	// Compress data with Zlib
-bool ZCompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize);					// Decompress data with Zlib
+bool PNGWriteBitmap(FILE ** ptrFile, uint Width, uint Height, uchar BytesPerPixel, sPNGData * RGBABitmap);	// Write bitmap to PNG file
+void PNGFreeData(sPNGData * PNGData);																		// Free data and structure
 
 // *.png image header
 #pragma pack(1)
@@ -89,7 +139,7 @@ struct sPNGHeader
 
 		// Calculate CRC
 		this->SwapEndian();
-		CRC = crc32(0L, (const Bytef *) &this->IHDT, sizeof(ulong) * 3 + sizeof(uchar) * 5);
+		CRC = ChecksumCRC32(CHECKSUM_CRC32_INIT, &this->IHDT, sizeof(ulong) * 3 + sizeof(uchar) * 5);
 		this->SwapEndian();
 		this->CRC32 = CRC;
 	}
@@ -97,8 +147,19 @@ struct sPNGHeader
 	uchar CheckType()
 	{
 		if (this->Signature1 != 0x89504E47 || this->Signature2 != 0x0D0A1A0A || this->IHDTSize != 13 || this->IHDT != 0x49484452
-			|| this->BitDepth > 8 || this->Compression != 0 || this->Filter != 0 || this->Interlacing != 0)
+			|| this->Compression != 0 || this->Filter != 0 || this->Interlacing > 1)
+			return PNG_UNKNOWN;
+
+		// Indexed images have 1, 2, 4 or 8 bit samples, true color ones - 8 bit (16 bit isn't supported)
+		if (this->ColorType == PNG_INDEXED)
+		{
+			if (this->BitDepth == 0 || this->BitDepth > 8 || (8 % this->BitDepth) != 0)
+				return PNG_UNKNOWN;
+		}
+		else if (this->BitDepth != 8)
+		{
 			return PNG_UNKNOWN;
+		}
 
 		return this->ColorType;
 	}
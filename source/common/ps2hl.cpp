@@ -0,0 +1,163 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains glue between library code and its front-ends:
+// status codes, message/progress output and memory allocation hooks.
+//
+// Library code never prints, waits for input or exits on its own,
+// everything goes through functions below. By default messages are
+// printed to stdout, so CLI tools behave like before.
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "util.h"
+#include "ps2hl.h"
+#include "perf.h"
+
+////////// Globals //////////
+static const char * StatusStr[PS2HL_ERR_COUNT] =
+{
+	"OK",
+	"can't open file",
+	"can't allocate memory",
+	"unsupported or damaged file",
+	"zlib error",
+	"bad parameter",
+	"nothing to do"
+};
+
+static tLibMsgCallback MsgCallback = NULL;				// Message output (NULL - stdout)
+static void * MsgCtx = NULL;							//
+static tLibProgressCallback ProgressCallback = NULL;	// Progress output (NULL - none)
+static void * ProgressCtx = NULL;						//
+static tLibAllocCallback AllocCallback = NULL;			// Memory allocator (NULL - malloc/free)
+static tLibFreeCallback FreeCallback = NULL;			//
+static void * AllocCtx = NULL;							//
+static bool Interactive = false;						// Default output waits for a key on MSG_CONFIRM
+static __thread bool Muted = false;						// Messages of current thread are dropped
+
+////////// Functions //////////
+const char * LibStatusStr(int Status)
+{
+	if (Status < 0 || Status >= PS2HL_ERR_COUNT)
+		return "unknown error";
+
+	return StatusStr[Status];
+}
+
+void LibSetMsgCallback(tLibMsgCallback Callback, void * Ctx)
+{
+	MsgCallback = Callback;
+	MsgCtx = Ctx;
+}
+
+void LibMuteThread(bool Mute)
+{
+	Muted = Mute;
+}
+
+void LibSetProgressCallback(tLibProgressCallback Callback, void * Ctx)
+{
+	ProgressCallback = Callback;
+	ProgressCtx = Ctx;
+}
+
+void LibSetAllocator(tLibAllocCallback Alloc, tLibFreeCallback Free, void * Ctx)
+{
+	// Both or none
+	if (Alloc == NULL || Free == NULL)
+	{
+		AllocCallback = NULL;
+		FreeCallback = NULL;
+		AllocCtx = NULL;
+		return;
+	}
+
+	AllocCallback = Alloc;
+	FreeCallback = Free;
+	AllocCtx = Ctx;
+}
+
+void LibSetInteractive(bool NewInteractive)
+{
+	Interactive = NewInteractive;
+}
+
+bool LibIsInteractive()
+{
+	return Interactive;
+}
+
+void LibMsg(int Level, const char * Format, ...)
+{
+	char Buffer[1024];
+	va_list Args;
+
+	if (Muted == true)
+		return;
+
+	va_start(Args, Format);
+	vsnprintf(Buffer, sizeof(Buffer), Format, Args);
+	va_end(Args);
+
+	if (MsgCallback != NULL)
+	{
+		MsgCallback(MsgCtx, Level, Buffer);
+		return;
+	}
+
+	// Default output
+	PERF_SCOPE(PERF_PH_CONSOLE);
+	fputs(Buffer, stdout);
+	if (Interactive == true && (Level & MSG_CONFIRM))
+		UTIL_WAIT_KEY("Press any key to continue ...");
+}
+
+void LibProgress(ulong Done, ulong Total)
+{
+	if (ProgressCallback != NULL)
+		ProgressCallback(ProgressCtx, Done, Total);
+}
+
+void * LibAlloc(size_t Size)
+{
+	PERF_ADD(PERF_ALLOCS, 1);
+	PERF_ADD(PERF_ALLOC_BYTES, Size);
+
+	if (AllocCallback != NULL)
+		return AllocCallback(AllocCtx, Size);
+
+	return malloc(Size);
+}
+
+void * LibCalloc(size_t Count, size_t Size)
+{
+	void * Ptr;
+
+	// Check for overflow
+	if (Size != 0 && Count > ((size_t)-1) / Size)
+		return NULL;
+
+	Ptr = LibAlloc(Count * Size);
+	if (Ptr != NULL)
+		memset(Ptr, 0x00, Count * Size);
+
+	return Ptr;
+}
+
+void LibFree(void * Ptr)
+{
+	if (Ptr == NULL)
+		return;
+
+	PERF_ADD(PERF_FREES, 1);
+	if (FreeCallback != NULL)
+		FreeCallback(AllocCtx, Ptr);
+	else
+		free(Ptr);
+}
@@ -0,0 +1,48 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef PS2HL_H
+#define PS2HL_H
+
+#include <stddef.h>
+#include "types.h"
+
+////////// Status codes //////////
+#define PS2HL_OK			0	// Success
+#define PS2HL_ERR_OPEN		1	// Can't open input or create output file
+#define PS2HL_ERR_MEMORY	2	// Can't allocate memory
+#define PS2HL_ERR_FORMAT	3	// Unsupported or damaged input
+#define PS2HL_ERR_ZLIB		4	// Zlib failed to deflate/inflate data
+#define PS2HL_ERR_PARAM		5	// Bad argument (wrong path, empty dir, etc.)
+#define PS2HL_ERR_SKIP		6	// Nothing to do (already converted, etc.)
+#define PS2HL_ERR_COUNT		7
+
+////////// Message levels //////////
+#define MSG_ERROR			0	// Operation failed
+#define MSG_WARN			1	// Operation succeeded, but result may be not what user expects
+#define MSG_INFO			2	// Regular progress output
+#define MSG_DEBUG			3	// Verbose output
+#define MSG_LEVEL_MASK		0x0F
+#define MSG_CONFIRM			0x10	// Flag: interactive front-end should let user read message before going on
+
+////////// Callbacks //////////
+typedef void (*tLibMsgCallback)(void * Ctx, int Level, const char * Text);		// Text already contains line breaks
+typedef void (*tLibProgressCallback)(void * Ctx, ulong Done, ulong Total);		// Called after each processed item (file, texture, frame, ...)
+typedef void * (*tLibAllocCallback)(void * Ctx, size_t Size);					// Should return NULL on failure
+typedef void (*tLibFreeCallback)(void * Ctx, void * Ptr);						// Never gets NULL
+
+////////// Functions //////////
+const char * LibStatusStr(int Status);															// Get description of status code
+void LibSetMsgCallback(tLibMsgCallback Callback, void * Ctx);									// Redirect messages (NULL - restore default stdout output)
+void LibMuteThread(bool Mute);																	// Drop messages of current thread (i.e. while validators run on behalf of lint)
+void LibSetProgressCallback(tLibProgressCallback Callback, void * Ctx);						// Receive progress (NULL - disable)
+void LibSetAllocator(tLibAllocCallback Alloc, tLibFreeCallback Free, void * Ctx);				// Redirect allocations (NULL - restore malloc/free)
+void LibSetInteractive(bool Interactive);														// Let default output wait for a key on MSG_CONFIRM messages (CLI only)
+bool LibIsInteractive();																		// Check if front-end is interactive (for custom message callbacks)
+void LibMsg(int Level, const char * Format, ...);												// Emit message
+void LibProgress(ulong Done, ulong Total);														// Emit progress
+void * LibAlloc(size_t Size);																	// Allocate memory
+void * LibCalloc(size_t Count, size_t Size);													// Allocate zero-filled memory
+void LibFree(void * Ptr);																		// Free memory (NULL is ignored)
+
+#endif // PS2HL_H
@@ -0,0 +1,708 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains end-to-end throughput check: dirs of synthetic corpus
+// are converted by tools on thread pool several times, time, memory and
+// outputs of each scenario are summarised and compared with baseline.
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "thpool.h"		// Goes first: sets up windows.h version
+#include "ps2hl.h"
+#include "fops.h"
+#include "hash.h"
+#include "jobs.h"
+#include "bench.h"
+#include "regress.h"
+
+////////// Definitions //////////
+#define REGRESS_MAX_RUNS		64
+#define REGRESS_MAX_PATTERNS	32
+#define REGRESS_NAME_LEN		32
+
+////////// Structures //////////
+
+// Conversion of one corpus dir
+struct sRegressScenario
+{
+	const char * Name;
+	const char * Tool;
+	const char * Command;
+	const char * Dir;			// Relative to corpus dir
+	const char * Ext;			// Input files ("" - files without extension)
+};
+
+// Measurements of scenario (or baseline of it)
+struct sRegressResult
+{
+	char Name[REGRESS_NAME_LEN];
+	int Files;
+	double Bytes;				// Input size
+	int Threads;
+	double Wall;				// Median, ms
+	double WallDev;				//
+	double CPU;					// Mean, ms
+	double RSS;					// Max, KiB
+	char Hash[HASH_HEX_LEN];	// Scratch dir contents after conversion
+	bool Stable;				// Same hash in every run
+};
+
+// Input file
+struct sRegressFile
+{
+	char * Name;				// Relative
+	char * FullName;			// Copy in scratch dir
+};
+
+// Session
+struct sRegress
+{
+	char Dir[PATH_LEN];			// Corpus, with trailing delimiter
+	char WorkDir[PATH_LEN];		// Scratch, with trailing delimiter
+	int Runs;
+	double Threshold;			// %
+	double RSSThreshold;		// %
+	const char * Patterns[REGRESS_MAX_PATTERNS];	// Selected scenarios (none - all)
+	int PatternCount;
+	sThreadPool Pool;
+	bool HasPool;
+	int Threads;
+	tMutex Lock;
+	int Failed;					// Jobs that failed in current run
+	sRegressResult * Base;		// Baseline
+	int BaseCount;
+};
+
+// Job of current run
+struct sRegressTask
+{
+	sRegress * Regress;
+	const sJobTool * Tool;
+	const char * Command;
+	const char * FileName;
+};
+
+////////// Globals //////////
+static const sRegressScenario RegressScenarios[] =
+{
+	{ "pak.extract",	"pak",	"extract",		"pak",								".pak" },
+	{ "mdl.todol",		"mdl",	JOB_CMD_AUTO,	"pc" DIR_DELIM "MODELS",			".mdl" },
+	{ "mdl.tomdl",		"mdl",	JOB_CMD_AUTO,	"ps2" DIR_DELIM "MODELS",			".dol" },
+	{ "spr.tospz",		"spr",	JOB_CMD_AUTO,	"pc" DIR_DELIM "SPRITES",			".spr" },
+	{ "spr.tospr",		"spr",	JOB_CMD_AUTO,	"ps2" DIR_DELIM "SPRITES",			".spz" },
+	{ "phd.todecal",	"phd",	JOB_CMD_AUTO,	"pc" DIR_DELIM "DECALS",			".bmp" },
+	{ "phd.tobmp",		"phd",	JOB_CMD_AUTO,	"ps2" DIR_DELIM "DECALS",			"" },
+	{ "psi.topsi",		"psi",	JOB_CMD_AUTO,	"pc" DIR_DELIM "TEXTURES",			".png" },
+	{ "psi.topng",		"psi",	JOB_CMD_AUTO,	"ps2" DIR_DELIM "TEXTURES",			".psi" },
+	{ "mus.wav",		"mus",	JOB_CMD_AUTO,	"pc" DIR_DELIM "SOUND",				".wav" },
+	{ "mus.vag",		"mus",	JOB_CMD_AUTO,	"pc" DIR_DELIM "SOUND",				".vag" },
+	{ "nod.convert",	"nod",	JOB_CMD_AUTO,	"pc" DIR_DELIM "MAPS",				".nod" }
+};
+#define REGRESS_SCENARIO_COUNT (int)(sizeof(RegressScenarios) / sizeof(RegressScenarios[0]))
+
+////////// Files //////////
+static int RegressCompareFiles(const void * A, const void * B)
+{
+	return strcmp(((const sRegressFile *)A)->Name, ((const sRegressFile *)B)->Name);
+}
+
+static void RegressFreeFiles(sRegressFile * Files, int Count)
+{
+	if (Files == NULL)
+		return;
+
+	for (int i = 0; i < Count; i++)
+	{
+		LibFree(Files[i].Name);
+		LibFree(Files[i].FullName);
+	}
+	LibFree(Files);
+}
+
+static sRegressFile * RegressListFiles(const char * Dir, const char * Ext, int * ptrCount)	// Sorted by name (Ext NULL - every file), NULL if there is nothing
+{
+	sRegressFile * Files = NULL;
+	sRegressFile * NewFiles;
+	sDirIter Iter;
+	const char * FullName;
+	const char * Name;
+	char FileExt[5];
+	int Count = 0;
+	int Size = 0;
+
+	if (CheckDir(Dir) == false)
+	{
+		*ptrCount = 0;
+		return NULL;
+	}
+
+	DirIterInit(&Iter, Dir);
+	while ((FullName = DirIterGet(&Iter)) != NULL)
+	{
+		FileGetExtension(FullName, FileExt, sizeof(FileExt));
+		if (Ext != NULL && (Ext[0] != '\0' ? strcmp(FileExt, Ext) != 0 : FileExt[0] == '.'))
+			continue;
+
+		if (Count == Size)
+		{
+			NewFiles = (sRegressFile *)LibCalloc(Size ? Size * 2 : 64, sizeof(sRegressFile));
+			if (NewFiles == NULL)
+				break;
+			if (Files != NULL)
+				memcpy(NewFiles, Files, Count * sizeof(sRegressFile));
+			LibFree(Files);
+			Files = NewFiles;
+			Size = Size ? Size * 2 : 64;
+		}
+
+		Name = FullName + strlen(Dir);
+		while (*Name == DIR_DELIM_CH || *Name == DIR_NOT_DELIM_CH)
+			Name++;
+		Files[Count].Name = (char *)LibAlloc(strlen(Name) + 1);
+		Files[Count].FullName = (char *)LibAlloc(strlen(FullName) + 1);
+		if (Files[Count].Name == NULL || Files[Count].FullName == NULL)
+		{
+			LibFree(Files[Count].Name);
+			LibFree(Files[Count].FullName);
+			break;
+		}
+		strcpy(Files[Count].Name, Name);
+		strcpy(Files[Count].FullName, FullName);
+		Count++;
+	}
+	DirIterClose(&Iter);
+
+	if (Count == 0)
+	{
+		LibFree(Files);
+		Files = NULL;
+	}
+	else
+	{
+		qsort(Files, Count, sizeof(sRegressFile), RegressCompareFiles);
+	}
+
+	*ptrCount = Count;
+	return Files;
+}
+
+static void RegressClean(const char * Dir)		// Remove everything in scratch dir of scenario
+{
+	sRegressFile * Files;
+	char Path[PATH_LEN];
+	int Count;
+
+	Files = RegressListFiles(Dir, NULL, &Count);
+	for (int i = 0; i < Count; i++)
+		remove(Files[i].FullName);
+
+	// Dirs made by converters (i.e. extracted PAKs), deepest first
+	for (int i = 0; i < Count; i++)
+	{
+		snprintf(Path, sizeof(Path), "%s", Files[i].FullName);
+		for (int Len = strlen(Path); Len > (int)strlen(Dir); Len--)
+		{
+			if (Path[Len] == DIR_DELIM_CH || Path[Len] == DIR_NOT_DELIM_CH)
+			{
+				Path[Len] = '\0';
+				DelDir(Path);
+			}
+		}
+	}
+	DelDir(Dir);
+
+	RegressFreeFiles(Files, Count);
+}
+
+static bool RegressHash(const char * Dir, char * Hex)	// Names and contents of everything in scratch dir
+{
+	sRegressFile * Files;
+	sHash Hash;
+	uchar FileHash[HASH_SIZE];
+	uchar Result[HASH_SIZE];
+	bool Success = true;
+	int Count;
+
+	Files = RegressListFiles(Dir, NULL, &Count);
+	HashInit(&Hash, 0);
+	for (int i = 0; i < Count; i++)
+	{
+		PatchSlashes(Files[i].Name, strlen(Files[i].Name), false);	// Same hash on every OS
+		HashStr(&Hash, Files[i].Name);
+		if (HashFile(Files[i].FullName, FileHash) == false)
+			Success = false;
+		HashUpdate(&Hash, FileHash, sizeof(FileHash));
+	}
+	HashFinal(&Hash, Result);
+	HashToHex(Result, Hex);
+
+	RegressFreeFiles(Files, Count);
+	return Success;
+}
+
+////////// Runs //////////
+static void RegressTask(void * Arg)
+{
+	sRegressTask * Task = (sRegressTask *)Arg;
+	int Result;
+
+	// Messages of converters are noise here (and take time)
+	LibMuteThread(true);
+	Result = Task->Tool->Run(Task->Command, Task->FileName);
+	LibMuteThread(false);
+
+	if (Result != PS2HL_OK)
+	{
+		MutexLock(&Task->Regress->Lock);
+		Task->Regress->Failed++;
+		MutexUnlock(&Task->Regress->Lock);
+	}
+}
+
+static int RegressOnce(sRegress * Regress, const sRegressScenario * Scenario, const sJobTool * Tool,
+	const char * Dir, sRegressFile * Inputs, int Count, double * Wall, double * CPU, double * RSS, char * Hash)
+{
+	sRegressTask * Tasks;
+	sRegressFile * Staged;
+	tBenchTime StartWall, StartCPU;
+	char FullName[PATH_LEN];
+
+	Tasks = (sRegressTask *)LibCalloc(Count, sizeof(sRegressTask));
+	Staged = (sRegressFile *)LibCalloc(Count, sizeof(sRegressFile));
+	if (Tasks == NULL || Staged == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		LibFree(Tasks);
+		LibFree(Staged);
+		return PS2HL_ERR_MEMORY;
+	}
+
+	// Inputs are copied every run: some converters change files in place
+	RegressClean(Dir);
+	for (int i = 0; i < Count; i++)
+	{
+		if (snprintf(FullName, sizeof(FullName), "%s%s", Dir, Inputs[i].Name) >= (int)sizeof(FullName))
+			break;
+		Staged[i].FullName = (char *)LibAlloc(strlen(FullName) + 1);
+		if (Staged[i].FullName == NULL)
+			break;
+		strcpy(Staged[i].FullName, FullName);
+		GenerateFolders(Staged[i].FullName);
+		if (FileClone(Inputs[i].FullName, Staged[i].FullName, false) == false)
+			break;
+
+		Tasks[i].Regress = Regress;
+		Tasks[i].Tool = Tool;
+		Tasks[i].Command = Scenario->Command;
+		Tasks[i].FileName = Staged[i].FullName;
+	}
+
+	Regress->Failed = 0;
+	BenchPeakRSS(true);
+	StartCPU = BenchCPUTime();
+	StartWall = BenchNow();
+	for (int i = 0; i < Count; i++)
+		if (Tasks[i].FileName != NULL && (Regress->HasPool == false || PoolAdd(&Regress->Pool, RegressTask, &Tasks[i]) == false))
+			RegressTask(&Tasks[i]);
+	if (Regress->HasPool == true)
+		PoolWait(&Regress->Pool);
+	*Wall = (double)(BenchNow() - StartWall) / 1000000.0;
+	*CPU = (double)(BenchCPUTime() - StartCPU) / 1000000.0;
+	*RSS = BenchPeakRSS(false);
+
+	for (int i = 0; i < Count; i++)
+		if (Tasks[i].FileName == NULL)
+			Regress->Failed++;
+	RegressHash(Dir, Hash);
+
+	RegressFreeFiles(Staged, Count);
+	LibFree(Tasks);
+	return (Regress->Failed == 0) ? PS2HL_OK : PS2HL_ERR_FORMAT;
+}
+
+static int RegressCompareTimes(const void * A, const void * B)
+{
+	double a = *(const double *)A;
+	double b = *(const double *)B;
+
+	return (a > b) - (a < b);
+}
+
+static int RegressScenario(sRegress * Regress, const sRegressScenario * Scenario, sRegressResult * Result)
+{
+	const sJobTool * Tool = JobFindTool(Scenario->Tool);
+	sRegressFile * Inputs;
+	char InDir[PATH_LEN];
+	char Dir[PATH_LEN];
+	char Hash[HASH_HEX_LEN];
+	double Walls[REGRESS_MAX_RUNS];
+	double Wall, CPU, RSS;
+	double Sum = 0;
+	double SumSq = 0;
+	sFileStamp Stamp;
+	int Count;
+	int Status = PS2HL_OK;
+
+	if (snprintf(InDir, sizeof(InDir), "%s%s", Regress->Dir, Scenario->Dir) >= (int)sizeof(InDir) ||
+		snprintf(Dir, sizeof(Dir), "%s%s" DIR_DELIM, Regress->WorkDir, Scenario->Name) >= (int)sizeof(Dir))
+	{
+		LibMsg(MSG_ERROR, "%s: path is too long \n", Scenario->Name);
+		return PS2HL_ERR_PARAM;
+	}
+	Inputs = RegressListFiles(InDir, Scenario->Ext, &Count);
+	if (Inputs == NULL || Tool == NULL)
+		return PS2HL_ERR_SKIP;
+
+	memset(Result, 0x00, sizeof(sRegressResult));
+	snprintf(Result->Name, sizeof(Result->Name), "%s", Scenario->Name);
+	Result->Files = Count;
+	Result->Threads = Regress->Threads;
+	Result->Stable = true;
+	for (int i = 0; i < Count; i++)
+		if (FileGetStamp(Inputs[i].FullName, &Stamp) == true)
+			Result->Bytes += Stamp.Size;
+
+	for (int r = 0; r < Regress->Runs && Status == PS2HL_OK; r++)
+	{
+		Status = RegressOnce(Regress, Scenario, Tool, Dir, Inputs, Count, &Wall, &CPU, &RSS, Hash);
+		if (Status != PS2HL_OK)
+		{
+			LibMsg(MSG_ERROR, "%s: %d of %d files failed \n", Scenario->Name, Regress->Failed, Count);
+			break;
+		}
+
+		Walls[r] = Wall;
+		Sum += Wall;
+		Result->CPU += CPU / Regress->Runs;
+		if (RSS > Result->RSS)
+			Result->RSS = RSS;
+		if (r == 0)
+			strcpy(Result->Hash, Hash);
+		else if (strcmp(Result->Hash, Hash))
+			Result->Stable = false;
+	}
+	RegressClean(Dir);
+	RegressFreeFiles(Inputs, Count);
+	if (Status != PS2HL_OK)
+		return Status;
+
+	for (int r = 0; r < Regress->Runs; r++)
+		SumSq += (Walls[r] - Sum / Regress->Runs) * (Walls[r] - Sum / Regress->Runs);
+	Result->WallDev = (Regress->Runs > 1) ? sqrt(SumSq / (Regress->Runs - 1)) : 0.0;
+	qsort(Walls, Regress->Runs, sizeof(double), RegressCompareTimes);
+	Result->Wall = (Regress->Runs % 2) ? Walls[Regress->Runs / 2] : (Walls[Regress->Runs / 2 - 1] + Walls[Regress->Runs / 2]) / 2;
+
+	return PS2HL_OK;
+}
+
+////////// Baseline //////////
+static bool RegressGetNumber(const char * Line, const char * Key, double * Value)
+{
+	const char * Pos = strstr(Line, Key);
+
+	if (Pos == NULL)
+		return false;
+
+	*Value = strtod(Pos + strlen(Key), NULL);
+	return true;
+}
+
+static int RegressLoad(sRegress * Regress, const char * FileName)
+{
+	FILE * ptrFile;
+	char Line[1024];
+	sRegressResult Result;
+	sRegressResult * NewBase;
+	double Value;
+	int Size = 0;
+
+	if (FileOpen(&ptrFile, FileName, "r") == false)
+		return PS2HL_ERR_OPEN;
+
+	while (fgets(Line, sizeof(Line), ptrFile) != NULL)
+	{
+		memset(&Result, 0x00, sizeof(Result));
+		if (strstr(Line, "\"scenario\":") == NULL ||
+			sscanf(strstr(Line, "\"scenario\":"), "\"scenario\": \"%31[^\"]\"", Result.Name) != 1 ||
+			RegressGetNumber(Line, "\"wall_ms\":", &Result.Wall) == false)
+			continue;
+
+		if (RegressGetNumber(Line, "\"files\":", &Value) == true)
+			Result.Files = (int)Value;
+		if (RegressGetNumber(Line, "\"threads\":", &Value) == true)
+			Result.Threads = (int)Value;
+		RegressGetNumber(Line, "\"cpu_ms\":", &Result.CPU);
+		RegressGetNumber(Line, "\"peak_rss_kb\":", &Result.RSS);
+		if (strstr(Line, "\"hash\":") != NULL)
+			sscanf(strstr(Line, "\"hash\":"), "\"hash\": \"%32[0-9a-f]\"", Result.Hash);
+
+		if (Regress->BaseCount == Size)
+		{
+			NewBase = (sRegressResult *)LibCalloc(Size ? Size * 2 : 16, sizeof(sRegressResult));
+			if (NewBase == NULL)
+			{
+				fclose(ptrFile);
+				LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+				return PS2HL_ERR_MEMORY;
+			}
+			if (Regress->Base != NULL)
+				memcpy(NewBase, Regress->Base, Regress->BaseCount * sizeof(sRegressResult));
+			LibFree(Regress->Base);
+			Regress->Base = NewBase;
+			Size = Size ? Size * 2 : 16;
+		}
+		Regress->Base[Regress->BaseCount++] = Result;
+	}
+	fclose(ptrFile);
+
+	if (Regress->BaseCount == 0)
+	{
+		LibMsg(MSG_ERROR, "No scenarios in %s \n", FileName);
+		return PS2HL_ERR_FORMAT;
+	}
+	return PS2HL_OK;
+}
+
+static bool RegressCheck(sRegress * Regress, const sRegressResult * Result)	// Print changes against baseline, false - regression
+{
+	const sRegressResult * Base = NULL;
+	char Problems[128] = "";
+	double Wall, CPU, RSS;
+
+	for (int i = 0; i < Regress->BaseCount && Base == NULL; i++)
+		if (!strcmp(Regress->Base[i].Name, Result->Name))
+			Base = &Regress->Base[i];
+
+	if (Result->Stable == false)
+		strcat(Problems, " outputs differ between runs;");
+	if (Base == NULL)
+	{
+		if (Regress->BaseCount != 0)
+			LibMsg(MSG_WARN, "%-12s not in baseline \n", Result->Name);
+	}
+	else if (Base->Files != Result->Files)
+	{
+		LibMsg(MSG_WARN, "%-12s baseline has %d files, can't compare \n", Result->Name, Base->Files);
+	}
+	else
+	{
+		// Outputs don't depend on -j, times do
+		if (Base->Hash[0] != '\0' && strcmp(Base->Hash, Result->Hash))
+			strcat(Problems, " outputs changed;");
+
+		if (Base->Threads != Result->Threads)
+		{
+			LibMsg(MSG_WARN, "%-12s baseline was made on %d threads, times aren't compared \n", Result->Name, Base->Threads);
+		}
+		else
+		{
+			Wall = (Base->Wall > 0) ? (Result->Wall - Base->Wall) / Base->Wall * 100.0 : 0.0;
+			CPU = (Base->CPU > 0) ? (Result->CPU - Base->CPU) / Base->CPU * 100.0 : 0.0;
+			RSS = (Base->RSS > 0) ? (Result->RSS - Base->RSS) / Base->RSS * 100.0 : 0.0;
+			if (Wall > Regress->Threshold)
+				strcat(Problems, " wall time;");
+			if (CPU > Regress->Threshold)
+				strcat(Problems, " CPU time;");
+			if (RSS > Regress->RSSThreshold)
+				strcat(Problems, " peak RSS;");
+
+			LibMsg(MSG_INFO, "%-12s vs baseline: wall %+.1f%%, CPU %+.1f%%, RSS %+.1f%% \n", Result->Name, Wall, CPU, RSS);
+		}
+	}
+
+	if (Problems[0] != '\0')
+	{
+		Problems[strlen(Problems) - 1] = '\0';
+		LibMsg(MSG_ERROR, "%-12s regression:%s \n", Result->Name, Problems);
+		return false;
+	}
+	return true;
+}
+
+static void RegressPrint(const sRegressResult * Result)
+{
+	double Seconds = Result->Wall / 1000.0;
+
+	LibMsg(MSG_INFO, "%-12s %5d files %9.2f MB  wall %9.1f ms %5.1f%%  CPU %9.1f ms  %9.1f files/s %8.1f MB/s  RSS %7.0f KiB \n",
+		Result->Name, Result->Files, Result->Bytes / 1048576.0, Result->Wall, (Result->Wall > 0) ? Result->WallDev / Result->Wall * 100.0 : 0.0,
+		Result->CPU, (Seconds > 0) ? Result->Files / Seconds : 0.0, (Seconds > 0) ? Result->Bytes / 1048576.0 / Seconds : 0.0, Result->RSS);
+}
+
+static void RegressSaveLine(FILE * ptrFile, const sRegressResult * Result, bool Last)
+{
+	double Seconds = Result->Wall / 1000.0;
+
+	fprintf(ptrFile, "\t\t{ \"scenario\": \"%s\", \"files\": %d, \"bytes\": %.0f, \"threads\": %d, \"wall_ms\": %.3f, \"wall_dev_ms\": %.3f, \"cpu_ms\": %.3f, \"peak_rss_kb\": %.0f, \"files_per_s\": %.2f, \"mb_per_s\": %.3f, \"hash\": \"%s\" }%s\n",
+		Result->Name, Result->Files, Result->Bytes, Result->Threads, Result->Wall, Result->WallDev, Result->CPU, Result->RSS,
+		(Seconds > 0) ? Result->Files / Seconds : 0.0, (Seconds > 0) ? Result->Bytes / 1048576.0 / Seconds : 0.0, Result->Hash, Last ? "" : ",");
+}
+
+////////// Front-end //////////
+static bool RegressWants(sRegress * Regress, const char * Name)
+{
+	if (Regress->PatternCount == 0)
+		return true;
+
+	// Prefix of scenario name: "mdl" - both directions of models
+	for (int i = 0; i < Regress->PatternCount; i++)
+		if (!strncmp(Name, Regress->Patterns[i], strlen(Regress->Patterns[i])))
+			return true;
+
+	return false;
+}
+
+static int RegressParse(sRegress * Regress, int ArgCount, char ** Args, const char ** ptrJson, const char ** ptrBase)
+{
+	for (int i = 0; i < ArgCount; i++)
+	{
+		if (!strcmp(Args[i], "--runs") && i + 1 < ArgCount)
+		{
+			Regress->Runs = atoi(Args[++i]);
+			if (Regress->Runs < 1 || Regress->Runs > REGRESS_MAX_RUNS)
+			{
+				LibMsg(MSG_ERROR, "Number of runs should be 1 - %d \n", REGRESS_MAX_RUNS);
+				return PS2HL_ERR_PARAM;
+			}
+		}
+		else if (!strcmp(Args[i], "--threshold") && i + 1 < ArgCount)
+		{
+			Regress->Threshold = atof(Args[++i]);
+		}
+		else if (!strcmp(Args[i], "--rss-threshold") && i + 1 < ArgCount)
+		{
+			Regress->RSSThreshold = atof(Args[++i]);
+		}
+		else if (!strcmp(Args[i], "--json") && i + 1 < ArgCount)
+		{
+			*ptrJson = Args[++i];
+		}
+		else if (!strcmp(Args[i], "--baseline") && i + 1 < ArgCount)
+		{
+			*ptrBase = Args[++i];
+		}
+		else if (Args[i][0] != '-' && Regress->PatternCount < REGRESS_MAX_PATTERNS)
+		{
+			Regress->Patterns[Regress->PatternCount++] = Args[i];
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Unknown regress option: %s \n", Args[i]);
+			return PS2HL_ERR_PARAM;
+		}
+	}
+
+	if (Regress->Threshold <= 0 || Regress->RSSThreshold <= 0)
+	{
+		LibMsg(MSG_ERROR, "Thresholds should be above zero \n");
+		return PS2HL_ERR_PARAM;
+	}
+	return PS2HL_OK;
+}
+
+int RegressRun(const char * CorpusDir, int ArgCount, char ** Args, int Threads)
+{
+	sRegress * Regress;
+	sRegressResult * Results;
+	FILE * ptrFile = NULL;
+	const char * JsonFile = NULL;
+	const char * BaseFile = NULL;
+	size_t Len = strlen(CorpusDir);
+	int Count = 0;
+	int Regressions = 0;
+	int Result;
+
+	Regress = (sRegress *)LibCalloc(1, sizeof(sRegress));
+	Results = (sRegressResult *)LibCalloc(REGRESS_SCENARIO_COUNT, sizeof(sRegressResult));
+	if (Regress == NULL || Results == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		LibFree(Regress);
+		LibFree(Results);
+		return PS2HL_ERR_MEMORY;
+	}
+	Regress->Runs = REGRESS_DEF_RUNS;
+	Regress->Threshold = REGRESS_DEF_THRESHOLD;
+	Regress->RSSThreshold = REGRESS_DEF_RSS;
+	Regress->Threads = Threads;
+
+	Result = RegressParse(Regress, ArgCount, Args, &JsonFile, &BaseFile);
+	if (Result == PS2HL_OK && (CheckDir(CorpusDir) == false || Len == 0 || Len + sizeof(REGRESS_DIR) + 2 >= PATH_LEN))
+	{
+		LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+		Result = PS2HL_ERR_PARAM;
+	}
+	if (Result == PS2HL_OK && BaseFile != NULL)
+		Result = RegressLoad(Regress, BaseFile);
+	if (Result != PS2HL_OK)
+	{
+		LibFree(Regress->Base);
+		LibFree(Regress);
+		LibFree(Results);
+		return Result;
+	}
+
+	strcpy(Regress->Dir, CorpusDir);
+	if (Regress->Dir[Len - 1] != DIR_DELIM_CH && Regress->Dir[Len - 1] != DIR_NOT_DELIM_CH)
+		strcat(Regress->Dir, DIR_DELIM);
+	snprintf(Regress->WorkDir, sizeof(Regress->WorkDir), "%s" REGRESS_DIR DIR_DELIM, Regress->Dir);
+
+	MutexInit(&Regress->Lock);
+	if (Threads > 1)
+		Regress->HasPool = PoolStart(&Regress->Pool, Threads);
+
+	LibMsg(MSG_INFO, "Regress: %d runs on %d threads, thresholds: time %.1f%%, RSS %.1f%% \n",
+		Regress->Runs, Threads, Regress->Threshold, Regress->RSSThreshold);
+	for (int i = 0; i < REGRESS_SCENARIO_COUNT; i++)
+	{
+		if (RegressWants(Regress, RegressScenarios[i].Name) == false)
+			continue;
+
+		Result = RegressScenario(Regress, &RegressScenarios[i], &Results[Count]);
+		if (Result == PS2HL_ERR_SKIP)
+			continue;
+		if (Result != PS2HL_OK)
+		{
+			Regressions++;
+			continue;
+		}
+
+		RegressPrint(&Results[Count]);
+		if (RegressCheck(Regress, &Results[Count]) == false)
+			Regressions++;
+		Count++;
+	}
+
+	if (Regress->HasPool == true)
+		PoolStop(&Regress->Pool);
+	MutexDestroy(&Regress->Lock);
+	DelDir(Regress->WorkDir);
+
+	if (Count == 0 && Regressions == 0)
+	{
+		LibMsg(MSG_ERROR, "Nothing to convert in %s (make it with \"ps2hl corpus\") \n", CorpusDir);
+		Regressions++;
+	}
+
+	if (JsonFile != NULL && Count != 0 && FileOpen(&ptrFile, JsonFile, "w") == true)
+	{
+		fprintf(ptrFile, "{\n\t\"runs\": %d,\n\t\"regress\": [\n", Regress->Runs);
+		for (int i = 0; i < Count; i++)
+			RegressSaveLine(ptrFile, &Results[i], i + 1 == Count);
+		fprintf(ptrFile, "\t]\n}\n");
+		fclose(ptrFile);
+		LibMsg(MSG_INFO, "Results saved to %s \n", JsonFile);
+	}
+
+	if (BaseFile != NULL || Regressions != 0)
+		LibMsg(MSG_INFO, "Regressions: %d \n", Regressions);
+
+	LibFree(Regress->Base);
+	LibFree(Regress);
+	LibFree(Results);
+	return (Regressions == 0) ? PS2HL_OK : PS2HL_ERR_FORMAT;
+}
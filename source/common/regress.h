@@ -0,0 +1,27 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef REGRESS_H
+#define REGRESS_H
+
+#include "types.h"
+
+// End-to-end throughput check over synthetic corpus (see corpus.h): each
+// scenario copies one dir of corpus to scratch dir and converts it with
+// its tool in-process (converters are called directly, conversion cache
+// isn't used), several times. Wall and CPU time, peak RSS and hash of
+// everything in scratch dir are recorded, saved to JSON (one scenario per
+// line) and compared with baseline:
+//	ps2hl regress CORPUS --json base.json
+//	ps2hl regress CORPUS --baseline base.json --threshold 5
+// Scenario regresses when median wall time or CPU time grows by more than
+// threshold, peak RSS - by more than RSS threshold, or outputs differ.
+
+#define REGRESS_DIR				".ps2hl-regress"	// Scratch dir (in corpus dir)
+#define REGRESS_DEF_RUNS		5
+#define REGRESS_DEF_THRESHOLD	10			// Time, %
+#define REGRESS_DEF_RSS			20			// Peak RSS, %
+
+int RegressRun(const char * CorpusDir, int ArgCount, char ** Args, int Threads);	// Run scenarios (Args - options and scenario names), returns PS2HL_OK, PS2HL_ERR_FORMAT on regression or error
+
+#endif // REGRESS_H
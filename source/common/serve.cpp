@@ -0,0 +1,876 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains server mode: framed requests over local socket
+// (named pipe on windows) are read by one thread per client, loaded PAKs
+// and decoded palettes are shared between requests
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#ifndef _WIN32
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <poll.h>
+	#include <unistd.h>
+	#include <errno.h>
+	#undef MSG_CONFIRM		// Socket flag, not used here (ps2hl.h has its own)
+#endif
+#include "thpool.h"		// Goes first: sets up windows.h version
+#include "ps2hl.h"
+#include "fops.h"
+#include "jobs.h"
+#include "pakimg.h"
+#include "texdec.h"
+#include "serve.h"
+
+////////// Definitions //////////
+#define SERVE_FIELDS 4			// Max fields in request
+#define SERVE_POLL_MS 200		// Idle clients check for Ctrl+C this often
+
+#ifdef _WIN32
+	typedef HANDLE tServeConn;
+#else
+	typedef int tServeConn;
+#endif
+
+////////// Structures //////////
+
+// Loaded PAK
+struct sServePak
+{
+	char * Name;				// File name as it came in request
+	sFileStamp Stamp;			// Stamp of loaded file
+	pak::sPAKImage * Image;		//
+	ulong Size;					// Memory taken
+	ulong LastUse;				// Clock of last request
+};
+
+// Decoded palette
+struct sServePalette
+{
+	char * Key;					// File name or "PAK\nentry" (NULL - free slot)
+	sFileStamp Stamp;			// Stamp of file it came from
+	uchar Palette[TEX_PALETTE_SIZE];
+	ulong LastUse;				//
+};
+
+// Response
+struct sServeReply
+{
+	int Status;					// PS2HL_OK or error
+	uchar * Data;				// Payload (LibFree())
+	ulong Size;					//
+	uchar Header[8];			// Width and height of RGBA (sent before Data)
+	ulong HeaderSize;			//
+};
+
+// Connected client
+struct sServeClient
+{
+	tServeConn Conn;			//
+	tThread Thread;				// Reads requests of this client
+	volatile bool Done;			// Thread has finished (can be joined)
+	sServeClient * Next;		//
+};
+
+// Server state
+struct sServer
+{
+	sServePak * Paks;			// Loaded PAKs
+	int PakCount;				//
+	int PakSize;				//
+	unsigned long long PakBytes;	// Memory taken by PAKs
+	sServePalette * Palettes;	// SERVE_PALETTES slots
+	ulong Clock;				// Request counter (for LRU)
+	tMutex Lock;				// Protects everything above
+	sServeClient * Clients;		// Connected clients (listener thread only)
+	int Busy;					// Requests being handled
+	int Slots;					// Max requests handled at once (-j)
+	tMutex SlotLock;			// Protects Busy
+	tCond Room;					// Signaled when Busy drops
+	char Address[PATH_LEN];		// Socket file or pipe name
+};
+
+////////// Globals //////////
+static sServer Server;
+static volatile sig_atomic_t ServeStop = 0;	// Set by Ctrl+C
+
+////////// Caches //////////
+static char * ServeDup(const char * Str)
+{
+	size_t Len = strlen(Str);
+	char * Copy = (char *)LibAlloc(Len + 1);
+
+	if (Copy != NULL)
+		memcpy(Copy, Str, Len + 1);
+
+	return Copy;
+}
+
+static void ServeFreePak(int Index)
+{
+	Server.PakBytes -= Server.Paks[Index].Size;
+	LibFree(Server.Paks[Index].Name);
+	pak::FreePAKImage(Server.Paks[Index].Image);
+	Server.Paks[Index] = Server.Paks[--Server.PakCount];
+}
+
+static int ServeFindPak(const char * PakName, const sFileStamp * Stamp)	// Index of loaded PAK or -1 (lock is held)
+{
+	for (int i = 0; i < Server.PakCount; i++)
+	{
+		if (strcmp(Server.Paks[i].Name, PakName))
+			continue;
+		if (!memcmp(&Server.Paks[i].Stamp, Stamp, sizeof(sFileStamp)))
+		{
+			Server.Paks[i].LastUse = Server.Clock;
+			return i;
+		}
+		// Changed since loaded
+		ServeFreePak(i);
+		break;
+	}
+
+	return -1;
+}
+
+static int ServeAddPak(const char * PakName, const sFileStamp * Stamp, pak::sPAKImage * Image, int * ptrIndex)	// Take loaded PAK into cache (lock is held)
+{
+	sServePak * Pak;
+	ulong Size = pak::GetPAKImageSize(Image);
+	int Oldest;
+
+	// Unload least recently used PAKs first, so new one is never picked
+	while (Server.PakCount > 0 && Server.PakBytes + Size > (unsigned long long)SERVE_PAK_CACHE * 1024 * 1024)
+	{
+		Oldest = 0;
+		for (int i = 1; i < Server.PakCount; i++)
+			if (Server.Paks[i].LastUse < Server.Paks[Oldest].LastUse)
+				Oldest = i;
+		LibMsg(MSG_DEBUG, "Unloaded PAK: %s \n", Server.Paks[Oldest].Name);
+		ServeFreePak(Oldest);
+	}
+
+	// Grow array
+	if (Server.PakCount == Server.PakSize)
+	{
+		int NewSize = Server.PakSize ? Server.PakSize * 2 : 16;
+		sServePak * NewPaks = (sServePak *)LibCalloc(NewSize, sizeof(sServePak));
+		if (NewPaks == NULL)
+			return PS2HL_ERR_MEMORY;
+		if (Server.Paks != NULL)
+			memcpy(NewPaks, Server.Paks, sizeof(sServePak) * Server.PakCount);
+		LibFree(Server.Paks);
+		Server.Paks = NewPaks;
+		Server.PakSize = NewSize;
+	}
+
+	Pak = &Server.Paks[Server.PakCount];
+	memset(Pak, 0x00, sizeof(sServePak));
+	Pak->Name = ServeDup(PakName);
+	if (Pak->Name == NULL)
+		return PS2HL_ERR_MEMORY;
+	Pak->Stamp = *Stamp;
+	Pak->Image = Image;
+	Pak->Size = Size;
+	Pak->LastUse = Server.Clock;
+	Server.PakBytes += Size;
+	*ptrIndex = Server.PakCount++;
+	LibMsg(MSG_DEBUG, "Loaded PAK: %s \n", PakName);
+
+	return PS2HL_OK;
+}
+
+static int ServeCopyEntry(const sServePak * Pak, const char * EntryName, uchar ** ptrData, ulong * ptrSize, sFileStamp * ptrStamp)	// Copy, so PAK can be unloaded by other thread (lock is held)
+{
+	const uchar * Data;
+	int Index;
+
+	Index = pak::FindPAKEntry(Pak->Image, EntryName);
+	if (Index < 0)
+		return PS2HL_ERR_PARAM;
+
+	Data = pak::GetPAKEntryData(Pak->Image, Index, ptrSize);
+	*ptrData = (uchar *)LibAlloc(*ptrSize ? *ptrSize : 1);
+	if (*ptrData == NULL)
+		return PS2HL_ERR_MEMORY;
+	memcpy(*ptrData, Data, *ptrSize);
+	*ptrStamp = Pak->Stamp;
+
+	return PS2HL_OK;
+}
+
+static int ServeGetEntry(const char * PakName, const char * EntryName, uchar ** ptrData, ulong * ptrSize, sFileStamp * ptrStamp)	// Copy of PAK entry
+{
+	pak::sPAKImage * Image;
+	sFileStamp Stamp;
+	int Index;
+	int Result;
+
+	if (FileGetStamp(PakName, &Stamp) == false)
+		return PS2HL_ERR_OPEN;
+
+	MutexLock(&Server.Lock);
+	Index = ServeFindPak(PakName, &Stamp);
+	if (Index >= 0)
+		Result = ServeCopyEntry(&Server.Paks[Index], EntryName, ptrData, ptrSize, ptrStamp);
+	MutexUnlock(&Server.Lock);
+	if (Index >= 0)
+		return Result;
+
+	// Load without lock, so other clients are not stalled
+	Result = pak::LoadPAKImage(PakName, &Image);
+	if (Result != PS2HL_OK)
+		return Result;
+
+	MutexLock(&Server.Lock);
+	Index = ServeFindPak(PakName, &Stamp);
+	if (Index >= 0)
+	{
+		// Other client loaded it meanwhile
+		pak::FreePAKImage(Image);
+		Result = PS2HL_OK;
+	}
+	else
+	{
+		Result = ServeAddPak(PakName, &Stamp, Image, &Index);
+		if (Result != PS2HL_OK)
+			pak::FreePAKImage(Image);
+	}
+	if (Result == PS2HL_OK)
+		Result = ServeCopyEntry(&Server.Paks[Index], EntryName, ptrData, ptrSize, ptrStamp);
+	MutexUnlock(&Server.Lock);
+
+	return Result;
+}
+
+static int ServeGetFile(const char * FileName, uchar ** ptrData, ulong * ptrSize, sFileStamp * ptrStamp)
+{
+	FILE * ptrFile;
+
+	if (FileGetStamp(FileName, ptrStamp) == false || FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+
+	*ptrSize = FileSize(&ptrFile);
+	*ptrData = (uchar *)LibAlloc(*ptrSize ? *ptrSize : 1);
+	if (*ptrData == NULL)
+	{
+		fclose(ptrFile);
+		return PS2HL_ERR_MEMORY;
+	}
+	FileReadBlock(&ptrFile, *ptrData, 0, *ptrSize);
+	fclose(ptrFile);
+
+	return PS2HL_OK;
+}
+
+static bool ServeFindPalette(const char * Key, sFileStamp * Stamp, uchar * Palette)
+{
+	bool Found = false;
+
+	MutexLock(&Server.Lock);
+	for (int i = 0; i < SERVE_PALETTES; i++)
+	{
+		if (Server.Palettes[i].Key != NULL && !strcmp(Server.Palettes[i].Key, Key) &&
+			!memcmp(&Server.Palettes[i].Stamp, Stamp, sizeof(sFileStamp)))
+		{
+			memcpy(Palette, Server.Palettes[i].Palette, TEX_PALETTE_SIZE);
+			Server.Palettes[i].LastUse = Server.Clock;
+			Found = true;
+			break;
+		}
+	}
+	MutexUnlock(&Server.Lock);
+
+	return Found;
+}
+
+static void ServeKeepPalette(const char * Key, sFileStamp * Stamp, const uchar * Palette)	// Replace same key or least recently used slot
+{
+	sServePalette * Slot = NULL;
+
+	MutexLock(&Server.Lock);
+	for (int i = 0; i < SERVE_PALETTES; i++)
+	{
+		if (Server.Palettes[i].Key != NULL && !strcmp(Server.Palettes[i].Key, Key))
+		{
+			Slot = &Server.Palettes[i];
+			break;
+		}
+		if (Slot == NULL || Server.Palettes[i].Key == NULL || (Slot->Key != NULL && Server.Palettes[i].LastUse < Slot->LastUse))
+			Slot = &Server.Palettes[i];
+	}
+
+	if (Slot->Key == NULL || strcmp(Slot->Key, Key))
+	{
+		LibFree(Slot->Key);
+		Slot->Key = ServeDup(Key);
+	}
+	if (Slot->Key != NULL)
+	{
+		Slot->Stamp = *Stamp;
+		memcpy(Slot->Palette, Palette, TEX_PALETTE_SIZE);
+		Slot->LastUse = Server.Clock;
+	}
+	MutexUnlock(&Server.Lock);
+}
+
+////////// Requests //////////
+static void ServeConvert(char ** Fields, int Count, sServeReply * Reply)
+{
+	if (Count != 4)
+	{
+		Reply->Status = PS2HL_ERR_PARAM;
+		return;
+	}
+
+	Reply->Status = JobRun(Fields[1], Fields[2], Fields[3]);
+}
+
+static void ServeExtract(char ** Fields, int Count, sServeReply * Reply)
+{
+	sFileStamp Stamp;
+
+	if (Count != 3)
+	{
+		Reply->Status = PS2HL_ERR_PARAM;
+		return;
+	}
+
+	Reply->Status = ServeGetEntry(Fields[1], Fields[2], &Reply->Data, &Reply->Size, &Stamp);
+}
+
+static void ServeRGBA(char ** Fields, int Count, sServeReply * Reply)
+{
+	char Key[PATH_LEN * 2];
+	uchar Palette[TEX_PALETTE_SIZE];
+	sFileStamp Stamp;
+	uchar * Data;
+	ulong DataSize;
+	uint Width, Height;
+	bool Decal;
+	bool HasPalette;
+	int Result;
+
+	// Texture from file or PAK
+	if (Count == 2)
+	{
+		Result = ServeGetFile(Fields[1], &Data, &DataSize, &Stamp);
+		snprintf(Key, sizeof(Key), "%s", Fields[1]);
+	}
+	else if (Count == 3)
+	{
+		Result = ServeGetEntry(Fields[1], Fields[2], &Data, &DataSize, &Stamp);
+		snprintf(Key, sizeof(Key), "%s\n%s", Fields[1], Fields[2]);
+	}
+	else
+	{
+		Result = PS2HL_ERR_PARAM;
+	}
+	if (Result != PS2HL_OK)
+	{
+		Reply->Status = Result;
+		return;
+	}
+
+	// Palette is decoded only once per file
+	Decal = phd::SniffPHD(Data, DataSize);
+	HasPalette = ServeFindPalette(Key, &Stamp, Palette);
+	if (HasPalette == false)
+	{
+		Result = Decal ? phd::DecodePHDPalette(Data, DataSize, Palette) : psi::DecodePSIPalette(Data, DataSize, Palette);
+		HasPalette = Result == PS2HL_OK;
+		if (HasPalette == true)
+			ServeKeepPalette(Key, &Stamp, Palette);
+	}
+
+	if (Decal == true)
+		Result = phd::DecodePHD(Data, DataSize, HasPalette ? Palette : NULL, &Reply->Data, &Width, &Height);
+	else
+		Result = psi::DecodePSI(Data, DataSize, HasPalette ? Palette : NULL, &Reply->Data, &Width, &Height);
+	LibFree(Data);
+
+	Reply->Status = Result;
+	if (Result == PS2HL_OK)
+	{
+		Reply->Size = Width * Height * 4;
+		memcpy(&Reply->Header[0], &Width, 4);
+		memcpy(&Reply->Header[4], &Height, 4);
+		Reply->HeaderSize = 8;
+	}
+}
+
+static void ServeHandle(char * Request, ulong Size, sServeReply * Reply)
+{
+	char * Fields[SERVE_FIELDS];
+	int Count = 0;
+
+	// Split fields
+	Request[Size] = '\0';
+	Fields[Count++] = Request;
+	for (ulong i = 0; i < Size && Count < SERVE_FIELDS; i++)
+	{
+		if (Request[i] == '\n')
+		{
+			Request[i] = '\0';
+			Fields[Count++] = &Request[i + 1];
+		}
+	}
+
+	MutexLock(&Server.Lock);
+	Server.Clock++;
+	MutexUnlock(&Server.Lock);
+
+	if (!strcmp(Fields[0], "ping"))
+		Reply->Status = PS2HL_OK;
+	else if (!strcmp(Fields[0], "convert"))
+		ServeConvert(Fields, Count, Reply);
+	else if (!strcmp(Fields[0], "extract"))
+		ServeExtract(Fields, Count, Reply);
+	else if (!strcmp(Fields[0], "rgba"))
+		ServeRGBA(Fields, Count, Reply);
+	else
+		Reply->Status = PS2HL_ERR_PARAM;
+
+	LibMsg((Reply->Status == PS2HL_OK) ? MSG_DEBUG : MSG_WARN, "Request: %s %s: %s \n", Fields[0], (Count > 1) ? Fields[Count - 1] : "", LibStatusStr(Reply->Status));
+}
+
+////////// Platform wrappers //////////
+#ifdef _WIN32
+
+static bool ServeWait(tServeConn Conn)	// Wait for data, false - client is gone or server stops
+{
+	DWORD Avail;
+
+	// Blocking ReadFile() can't be woken up, so pipe is peeked
+	while (ServeStop == 0)
+	{
+		if (PeekNamedPipe(Conn, NULL, 0, NULL, &Avail, NULL) == FALSE)
+			return false;
+		if (Avail > 0)
+			return true;
+		ThreadSleep(10);
+	}
+
+	return false;
+}
+
+static bool ServeRead(tServeConn Conn, void * Buffer, ulong Size)
+{
+	DWORD Done;
+
+	while (Size > 0)
+	{
+		if (ServeWait(Conn) == false || ReadFile(Conn, Buffer, Size, &Done, NULL) == FALSE || Done == 0)
+			return false;
+		Buffer = (uchar *)Buffer + Done;
+		Size -= Done;
+	}
+
+	return true;
+}
+
+static bool ServeWrite(tServeConn Conn, const void * Buffer, ulong Size)
+{
+	DWORD Done;
+
+	while (Size > 0)
+	{
+		if (WriteFile(Conn, Buffer, Size, &Done, NULL) == FALSE || Done == 0)
+			return false;
+		Buffer = (const uchar *)Buffer + Done;
+		Size -= Done;
+	}
+
+	return true;
+}
+
+static void ServeShutdown(tServeConn Conn)	// Wake up thread of client (server stops)
+{
+	(void)Conn;		// ServeWait() notices ServeStop by itself
+}
+
+static void ServeDisconnect(tServeConn Conn)
+{
+	FlushFileBuffers(Conn);
+	DisconnectNamedPipe(Conn);
+	CloseHandle(Conn);
+}
+
+#else // linux
+
+static bool ServeWait(tServeConn Conn)	// Wait for data, false - client is gone or server stops
+{
+	struct pollfd Poll;
+	int Result;
+
+	Poll.fd = Conn;
+	Poll.events = POLLIN;
+	while (ServeStop == 0)
+	{
+		Result = poll(&Poll, 1, SERVE_POLL_MS);
+		if (Result > 0)
+			return true;		// Data, hang up or error (recv() tells which)
+		if (Result < 0 && errno != EINTR)
+			return false;
+	}
+
+	return false;
+}
+
+static bool ServeRead(tServeConn Conn, void * Buffer, ulong Size)
+{
+	ssize_t Done;
+
+	while (Size > 0)
+	{
+		if (ServeWait(Conn) == false)
+			return false;
+		Done = recv(Conn, Buffer, Size, 0);
+		if (Done < 0 && errno == EINTR)
+			continue;
+		if (Done <= 0)
+			return false;
+		Buffer = (uchar *)Buffer + Done;
+		Size -= Done;
+	}
+
+	return true;
+}
+
+static bool ServeWrite(tServeConn Conn, const void * Buffer, ulong Size)
+{
+	ssize_t Done;
+
+	while (Size > 0)
+	{
+		Done = send(Conn, Buffer, Size, MSG_NOSIGNAL);	// Gone client shouldn't kill server
+		if (Done < 0 && errno == EINTR)
+			continue;
+		if (Done <= 0)
+			return false;
+		Buffer = (const uchar *)Buffer + Done;
+		Size -= Done;
+	}
+
+	return true;
+}
+
+static void ServeShutdown(tServeConn Conn)	// Wake up thread of client (server stops)
+{
+	shutdown(Conn, SHUT_RDWR);
+}
+
+static void ServeDisconnect(tServeConn Conn)
+{
+	close(Conn);
+}
+
+#endif
+
+////////// Clients //////////
+static void ServeHandleLimited(char * Request, uint Size, sServeReply * Reply)	// Idle clients don't count, only -j requests run at once
+{
+	MutexLock(&Server.SlotLock);
+	while (Server.Busy >= Server.Slots)
+		CondWait(&Server.Room, &Server.SlotLock);
+	Server.Busy++;
+	MutexUnlock(&Server.SlotLock);
+
+	ServeHandle(Request, Size, Reply);
+
+	MutexLock(&Server.SlotLock);
+	Server.Busy--;
+	CondSignal(&Server.Room);
+	MutexUnlock(&Server.SlotLock);
+}
+
+static void ServeClient(void * Arg)
+{
+	sServeClient * Client = (sServeClient *)Arg;
+	tServeConn Conn = Client->Conn;
+	char * Request;
+	sServeReply Reply;
+	uint Header[2];
+	uint Size;
+	bool Alive = true;
+
+	Request = (char *)LibAlloc(SERVE_MAX_REQUEST + 1);
+	if (Request == NULL)
+		Alive = false;
+
+	while (Alive == true && ServeRead(Conn, &Size, sizeof(Size)) == true)
+	{
+		memset(&Reply, 0x00, sizeof(Reply));
+
+		// Too big request can't be skipped safely - answer and hang up
+		if (Size > SERVE_MAX_REQUEST)
+		{
+			Reply.Status = PS2HL_ERR_PARAM;
+			Alive = false;
+		}
+		else if (ServeRead(Conn, Request, Size) == false)
+		{
+			break;
+		}
+		else
+		{
+			ServeHandleLimited(Request, Size, &Reply);
+		}
+
+		// Failed request gets error description
+		if (Reply.Status != PS2HL_OK)
+		{
+			LibFree(Reply.Data);
+			Reply.Size = strlen(LibStatusStr(Reply.Status));
+			Reply.Data = (uchar *)ServeDup(LibStatusStr(Reply.Status));
+			Reply.HeaderSize = 0;
+			if (Reply.Data == NULL)
+				Reply.Size = 0;
+		}
+
+		Header[0] = Reply.Status;
+		Header[1] = Reply.HeaderSize + Reply.Size;
+		if (ServeWrite(Conn, Header, sizeof(Header)) == false ||
+			ServeWrite(Conn, Reply.Header, Reply.HeaderSize) == false ||
+			ServeWrite(Conn, Reply.Data, Reply.Size) == false)
+			Alive = false;
+		LibFree(Reply.Data);
+	}
+
+	LibFree(Request);
+	ServeDisconnect(Conn);
+	__atomic_store_n(&Client->Done, true, __ATOMIC_RELEASE);
+}
+
+static void ServeReap(bool All)	// Join threads of gone clients (All - wake up and join every client)
+{
+	sServeClient ** Link = &Server.Clients;
+	sServeClient * Client;
+
+	if (All == true)
+		for (Client = Server.Clients; Client != NULL; Client = Client->Next)
+			if (__atomic_load_n(&Client->Done, __ATOMIC_ACQUIRE) == false)
+				ServeShutdown(Client->Conn);
+
+	while ((Client = *Link) != NULL)
+	{
+		if (All == false && __atomic_load_n(&Client->Done, __ATOMIC_ACQUIRE) == false)
+		{
+			Link = &Client->Next;
+			continue;
+		}
+		ThreadJoin(Client->Thread);
+		*Link = Client->Next;
+		LibFree(Client);
+	}
+}
+
+static void ServeAccept(tServeConn Conn)
+{
+	sServeClient * Client = (sServeClient *)LibCalloc(1, sizeof(sServeClient));
+
+	ServeReap(false);
+	if (Client == NULL)
+	{
+		ServeDisconnect(Conn);
+		return;
+	}
+
+	// Each client gets own thread: editors keep connection open between requests
+	Client->Conn = Conn;
+	if (ThreadStart(&Client->Thread, ServeClient, Client) == false)
+	{
+		ServeClient(Client);	// Out of threads - serve in place
+		LibFree(Client);
+		return;
+	}
+	Client->Next = Server.Clients;
+	Server.Clients = Client;
+}
+
+////////// Listening //////////
+#ifdef _WIN32
+
+static BOOL WINAPI ServeCtrlHandler(DWORD Type)
+{
+	HANDLE Pipe;
+
+	if (Type != CTRL_C_EVENT && Type != CTRL_BREAK_EVENT)
+		return FALSE;
+
+	// Wake up ConnectNamedPipe()
+	ServeStop = 1;
+	Pipe = CreateFileA(Server.Address, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+	if (Pipe != INVALID_HANDLE_VALUE)
+		CloseHandle(Pipe);
+
+	return TRUE;
+}
+
+static int ServeListen(const char * Address)
+{
+	HANDLE Pipe;
+
+	if (!strncmp(Address, "\\\\.\\pipe\\", 9))
+		snprintf(Server.Address, sizeof(Server.Address), "%s", Address);
+	else
+		snprintf(Server.Address, sizeof(Server.Address), "\\\\.\\pipe\\%s", Address);
+
+	SetConsoleCtrlHandler(ServeCtrlHandler, TRUE);
+	LibMsg(MSG_INFO, "Serving on %s (Ctrl+C to stop) ...\n", Server.Address);
+
+	// One pipe instance per client
+	while (ServeStop == 0)
+	{
+		Pipe = CreateNamedPipeA(Server.Address, PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+			PIPE_UNLIMITED_INSTANCES, 0x10000, 0x10000, 0, NULL);
+		if (Pipe == INVALID_HANDLE_VALUE)
+		{
+			LibMsg(MSG_ERROR, "Error: can't create pipe: %s \n", Server.Address);
+			SetConsoleCtrlHandler(ServeCtrlHandler, FALSE);
+			return PS2HL_ERR_OPEN;
+		}
+
+		if (ConnectNamedPipe(Pipe, NULL) == FALSE && GetLastError() != ERROR_PIPE_CONNECTED)
+		{
+			CloseHandle(Pipe);
+			continue;
+		}
+		if (ServeStop != 0)
+		{
+			ServeDisconnect(Pipe);
+			break;
+		}
+
+		ServeAccept(Pipe);
+	}
+
+	SetConsoleCtrlHandler(ServeCtrlHandler, FALSE);
+	return PS2HL_OK;
+}
+
+#else // linux
+
+static void ServeSignal(int Signal)
+{
+	(void)Signal;
+	ServeStop = 1;
+}
+
+static int ServeListen(const char * Address)
+{
+	struct sockaddr_un Addr;
+	struct sigaction Action;
+	struct pollfd Poll;
+	int Fd;
+	int Client;
+
+	if (strlen(Address) >= sizeof(Addr.sun_path))
+	{
+		LibMsg(MSG_ERROR, "Socket path is too long: %s \n", Address);
+		return PS2HL_ERR_PARAM;
+	}
+	snprintf(Server.Address, sizeof(Server.Address), "%s", Address);
+	memset(&Addr, 0x00, sizeof(Addr));
+	Addr.sun_family = AF_UNIX;
+	strcpy(Addr.sun_path, Address);
+
+	Fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (Fd < 0)
+	{
+		LibMsg(MSG_ERROR, "Error: can't create socket \n");
+		return PS2HL_ERR_OPEN;
+	}
+
+	// Socket file left by crashed server is removed, live server is left alone
+	if (connect(Fd, (struct sockaddr *)&Addr, sizeof(Addr)) == 0)
+	{
+		LibMsg(MSG_ERROR, "Error: server is already running on %s \n", Address);
+		close(Fd);
+		return PS2HL_ERR_PARAM;
+	}
+	close(Fd);
+	unlink(Address);
+
+	Fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (Fd < 0 || bind(Fd, (struct sockaddr *)&Addr, sizeof(Addr)) != 0 || listen(Fd, 16) != 0)
+	{
+		LibMsg(MSG_ERROR, "Error: can't listen on %s \n", Address);
+		if (Fd >= 0)
+			close(Fd);
+		return PS2HL_ERR_OPEN;
+	}
+
+	// Ctrl+C should let clients finish and logs flush
+	memset(&Action, 0x00, sizeof(Action));
+	Action.sa_handler = ServeSignal;
+	Action.sa_flags = SA_RESTART;
+	sigemptyset(&Action.sa_mask);
+	sigaction(SIGINT, &Action, NULL);
+	sigaction(SIGTERM, &Action, NULL);
+	LibMsg(MSG_INFO, "Serving on %s (Ctrl+C to stop) ...\n", Address);
+
+	// Poll with timeout to notice Ctrl+C
+	Poll.fd = Fd;
+	Poll.events = POLLIN;
+	while (ServeStop == 0)
+	{
+		if (poll(&Poll, 1, 500) <= 0)
+			continue;
+
+		Client = accept4(Fd, NULL, NULL, SOCK_CLOEXEC);
+		if (Client >= 0)
+			ServeAccept(Client);
+	}
+
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	close(Fd);
+	unlink(Address);
+
+	return PS2HL_OK;
+}
+
+#endif
+
+////////// Functions //////////
+int ServeRun(const char * Address, int Threads)
+{
+	int Result;
+
+	memset(&Server, 0x00, sizeof(Server));
+	Server.Palettes = (sServePalette *)LibCalloc(SERVE_PALETTES, sizeof(sServePalette));
+	if (Server.Palettes == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	MutexInit(&Server.Lock);
+	MutexInit(&Server.SlotLock);
+	CondInit(&Server.Room);
+	Server.Slots = (Threads > 1) ? Threads : 1;
+
+	Result = ServeListen(Address);
+
+	// Requests in progress are answered, idle clients are hung up on
+	ServeReap(true);
+	CondDestroy(&Server.Room);
+	MutexDestroy(&Server.SlotLock);
+	MutexDestroy(&Server.Lock);
+
+	while (Server.PakCount > 0)
+		ServeFreePak(0);
+	LibFree(Server.Paks);
+	for (int i = 0; i < SERVE_PALETTES; i++)
+		LibFree(Server.Palettes[i].Key);
+	LibFree(Server.Palettes);
+	if (Result == PS2HL_OK)
+		LibMsg(MSG_INFO, "\nServer stopped\n");
+
+	return Result;
+}
@@ -0,0 +1,39 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "types.h"
+
+// Server mode for editors and previewers: requests come over unix domain
+// socket (named pipe \\.\pipe\<name> on windows), so there is no need to
+// start a tool for every file. Loaded PAKs stay in memory (until their
+// file changes) and decoded palettes are cached, so repeated previews
+// don't touch disk. Each client has own thread, which waits for its
+// requests, but only -j requests are handled at once.
+//
+// Frames (numbers are 32-bit little endian):
+//	request:	size, payload - fields separated by '\n'
+//	response:	status (PS2HL_OK or error code), size, payload
+// Requests:
+//	ping								- empty response
+//	convert\n<tool>\n<command>\n<file>	- run job (tool and command may be "auto")
+//	extract\n<pak>\n<entry>				- contents of PAK entry
+//	rgba\n<file>						- decode *.psi or decal: width, height, RGBA pixels
+//	rgba\n<pak>\n<entry>				- same for PAK entry
+// Payload of failed request is error description.
+
+#define SERVE_MAX_REQUEST	16384	// Max request payload
+#define SERVE_PAK_CACHE		256		// Memory for loaded PAKs, MiB
+#define SERVE_PALETTES		1024	// Decoded palettes to keep
+
+#ifdef _WIN32
+	#define SERVE_DEFAULT "ps2hl"				// Pipe name when none given
+#else
+	#define SERVE_DEFAULT "/tmp/ps2hl.sock"		// Socket file when none given
+#endif
+
+int ServeRun(const char * Address, int Threads);	// Serve until Ctrl+C (Threads - requests handled at once)
+
+#endif // SERVE_H
@@ -0,0 +1,30 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef TEXDEC_H
+#define TEXDEC_H
+
+#include "types.h"
+
+// Texture decoders for previews: image in memory -> RGBA bitmap (8 bits per
+// channel, same colors as *.png written by tools), output should be freed
+// with LibFree(). Palette of indexed image can be decoded once and passed
+// to next calls (NULL - decode it every time).
+// Implemented in psitool/psitool.cpp and phdtool/phdtool.cpp
+
+#define TEX_PALETTE_SIZE 0x400	// Decoded palette: 256 RGBA entries
+
+namespace psi
+{
+int DecodePSIPalette(const uchar * Data, ulong DataSize, uchar * Palette);										// Decode palette of *.psi (PS2HL_ERR_SKIP - image has no palette)
+int DecodePSI(const uchar * Data, ulong DataSize, const uchar * Palette, uchar ** ptrRGBA, uint * ptrWidth, uint * ptrHeight);	// Decode *.psi
+}
+
+namespace phd
+{
+int DecodePHDPalette(const uchar * Data, ulong DataSize, uchar * Palette);										// Decode palette of decal
+int DecodePHD(const uchar * Data, ulong DataSize, const uchar * Palette, uchar ** ptrRGBA, uint * ptrWidth, uint * ptrHeight);	// Decode decal (scaled to its original size)
+bool SniffPHD(const uchar * Data, ulong DataSize);																// Check if data looks like decal
+}
+
+#endif // TEXDEC_H
@@ -0,0 +1,257 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains thin platform threading wrappers and simple thread pool
+//
+// Library code itself is single threaded per call, pool is used by
+// front-ends to run independent jobs side by side in one process
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include "ps2hl.h"
+#include "thpool.h"
+
+#ifndef _WIN32
+	#include <unistd.h>
+#endif
+
+////////// Platform wrappers //////////
+#ifdef _WIN32
+
+void MutexInit(tMutex * Mutex)		{ InitializeCriticalSection(Mutex); }
+void MutexDestroy(tMutex * Mutex)	{ DeleteCriticalSection(Mutex); }
+void MutexLock(tMutex * Mutex)		{ EnterCriticalSection(Mutex); }
+void MutexUnlock(tMutex * Mutex)	{ LeaveCriticalSection(Mutex); }
+
+void CondInit(tCond * Cond)						{ InitializeConditionVariable(Cond); }
+void CondDestroy(tCond * Cond)					{ (void)Cond; }
+void CondWait(tCond * Cond, tMutex * Mutex)		{ SleepConditionVariableCS(Cond, Mutex, INFINITE); }
+void CondSignal(tCond * Cond)					{ WakeConditionVariable(Cond); }
+void CondBroadcast(tCond * Cond)					{ WakeAllConditionVariable(Cond); }
+
+int ThreadCPUCount()
+{
+	SYSTEM_INFO Info;
+
+	GetSystemInfo(&Info);
+	return (Info.dwNumberOfProcessors > 0) ? Info.dwNumberOfProcessors : 1;
+}
+
+static DWORD WINAPI ThreadEntry(LPVOID Arg)
+{
+	sThreadStart Start = *(sThreadStart *)Arg;
+
+	LibFree(Arg);
+	Start.Func(Start.Arg);
+	return 0;
+}
+
+static bool ThreadCreate(tThread * ptrThread, sThreadStart * Start)
+{
+	*ptrThread = CreateThread(NULL, 0, ThreadEntry, Start, 0, NULL);
+	return *ptrThread != NULL;
+}
+
+void ThreadJoin(tThread Thread)
+{
+	WaitForSingleObject(Thread, INFINITE);
+	CloseHandle(Thread);
+}
+
+void ThreadSleep(int Ms)
+{
+	Sleep(Ms);
+}
+
+#else // linux
+
+void MutexInit(tMutex * Mutex)		{ pthread_mutex_init(Mutex, NULL); }
+void MutexDestroy(tMutex * Mutex)	{ pthread_mutex_destroy(Mutex); }
+void MutexLock(tMutex * Mutex)		{ pthread_mutex_lock(Mutex); }
+void MutexUnlock(tMutex * Mutex)	{ pthread_mutex_unlock(Mutex); }
+
+void CondInit(tCond * Cond)						{ pthread_cond_init(Cond, NULL); }
+void CondDestroy(tCond * Cond)					{ pthread_cond_destroy(Cond); }
+void CondWait(tCond * Cond, tMutex * Mutex)		{ pthread_cond_wait(Cond, Mutex); }
+void CondSignal(tCond * Cond)					{ pthread_cond_signal(Cond); }
+void CondBroadcast(tCond * Cond)					{ pthread_cond_broadcast(Cond); }
+
+int ThreadCPUCount()
+{
+	long Count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return (Count > 0) ? (int)Count : 1;
+}
+
+static void * ThreadEntry(void * Arg)
+{
+	sThreadStart Start = *(sThreadStart *)Arg;
+
+	LibFree(Arg);
+	Start.Func(Start.Arg);
+	return NULL;
+}
+
+static bool ThreadCreate(tThread * ptrThread, sThreadStart * Start)
+{
+	return pthread_create(ptrThread, NULL, ThreadEntry, Start) == 0;
+}
+
+void ThreadJoin(tThread Thread)
+{
+	pthread_join(Thread, NULL);
+}
+
+void ThreadSleep(int Ms)
+{
+	usleep(Ms * 1000);
+}
+
+#endif
+
+////////// Threads //////////
+bool ThreadStart(tThread * ptrThread, tPoolTask Func, void * Arg)
+{
+	sThreadStart * Start;
+
+	// Entry point frees it
+	Start = (sThreadStart *)LibAlloc(sizeof(sThreadStart));
+	if (Start == NULL)
+		return false;
+	Start->Func = Func;
+	Start->Arg = Arg;
+
+	if (ThreadCreate(ptrThread, Start) == false)
+	{
+		LibFree(Start);
+		return false;
+	}
+
+	return true;
+}
+
+////////// Pool //////////
+static void PoolLoop(void * Arg)
+{
+	sThreadPool * Pool = (sThreadPool *)Arg;
+	sPoolTask * Task;
+
+	MutexLock(&Pool->Lock);
+	for (;;)
+	{
+		// Wait for work
+		while (Pool->Head == NULL && Pool->Stop == false)
+			CondWait(&Pool->HasWork, &Pool->Lock);
+
+		// Queue is drained and pool is stopping - exit
+		if (Pool->Head == NULL)
+			break;
+
+		// Pop task
+		Task = Pool->Head;
+		Pool->Head = Task->Next;
+		if (Pool->Head == NULL)
+			Pool->Tail = NULL;
+
+		// Run it unlocked
+		MutexUnlock(&Pool->Lock);
+		Task->Func(Task->Arg);
+		LibFree(Task);
+		MutexLock(&Pool->Lock);
+
+		// Report completion
+		Pool->Pending--;
+		if (Pool->Pending == 0)
+			CondBroadcast(&Pool->AllDone);
+	}
+	MutexUnlock(&Pool->Lock);
+}
+
+bool PoolStart(sThreadPool * Pool, int ThreadCount)
+{
+	if (ThreadCount <= 0)
+		ThreadCount = ThreadCPUCount();
+	if (ThreadCount > POOL_MAX_THREADS)
+		ThreadCount = POOL_MAX_THREADS;
+
+	Pool->ThreadCount = 0;
+	Pool->Head = NULL;
+	Pool->Tail = NULL;
+	Pool->Pending = 0;
+	Pool->Stop = false;
+	MutexInit(&Pool->Lock);
+	CondInit(&Pool->HasWork);
+	CondInit(&Pool->AllDone);
+
+	// Start workers
+	for (int i = 0; i < ThreadCount; i++)
+	{
+		if (ThreadStart(&Pool->Threads[i], PoolLoop, Pool) == false)
+			break;
+		Pool->ThreadCount++;
+	}
+
+	// Nothing started
+	if (Pool->ThreadCount == 0)
+	{
+		LibMsg(MSG_ERROR, "Can't start worker threads ...\n");
+		CondDestroy(&Pool->AllDone);
+		CondDestroy(&Pool->HasWork);
+		MutexDestroy(&Pool->Lock);
+		return false;
+	}
+
+	return true;
+}
+
+bool PoolAdd(sThreadPool * Pool, tPoolTask Func, void * Arg)
+{
+	sPoolTask * Task;
+
+	Task = (sPoolTask *)LibAlloc(sizeof(sPoolTask));
+	if (Task == NULL)
+		return false;
+	Task->Func = Func;
+	Task->Arg = Arg;
+	Task->Next = NULL;
+
+	// Push to queue tail
+	MutexLock(&Pool->Lock);
+	if (Pool->Tail == NULL)
+		Pool->Head = Task;
+	else
+		Pool->Tail->Next = Task;
+	Pool->Tail = Task;
+	Pool->Pending++;
+	CondSignal(&Pool->HasWork);
+	MutexUnlock(&Pool->Lock);
+
+	return true;
+}
+
+void PoolWait(sThreadPool * Pool)
+{
+	MutexLock(&Pool->Lock);
+	while (Pool->Pending != 0)
+		CondWait(&Pool->AllDone, &Pool->Lock);
+	MutexUnlock(&Pool->Lock);
+}
+
+void PoolStop(sThreadPool * Pool)
+{
+	// Let workers drain the queue and exit
+	MutexLock(&Pool->Lock);
+	Pool->Stop = true;
+	CondBroadcast(&Pool->HasWork);
+	MutexUnlock(&Pool->Lock);
+
+	for (int i = 0; i < Pool->ThreadCount; i++)
+		ThreadJoin(Pool->Threads[i]);
+	Pool->ThreadCount = 0;
+
+	CondDestroy(&Pool->AllDone);
+	CondDestroy(&Pool->HasWork);
+	MutexDestroy(&Pool->Lock);
+}
@@ -0,0 +1,83 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef THPOOL_H
+#define THPOOL_H
+
+#ifdef _WIN32
+	#ifndef _WIN32_WINNT
+		#define _WIN32_WINNT 0x0600	// Condition variables need Vista+
+	#endif
+	#include <windows.h>
+	typedef HANDLE				tThread;
+	typedef CRITICAL_SECTION	tMutex;
+	typedef CONDITION_VARIABLE	tCond;
+#else
+	#include <pthread.h>
+	typedef pthread_t			tThread;
+	typedef pthread_mutex_t		tMutex;
+	typedef pthread_cond_t		tCond;
+#endif
+
+#include "types.h"
+
+#define POOL_MAX_THREADS 64		// Upper limit for worker count
+
+// Mutex wrappers
+void MutexInit(tMutex * Mutex);
+void MutexDestroy(tMutex * Mutex);
+void MutexLock(tMutex * Mutex);
+void MutexUnlock(tMutex * Mutex);
+
+// Condition variable wrappers (wait with mutex locked)
+void CondInit(tCond * Cond);
+void CondDestroy(tCond * Cond);
+void CondWait(tCond * Cond, tMutex * Mutex);
+void CondSignal(tCond * Cond);
+void CondBroadcast(tCond * Cond);
+
+// Number of online CPUs (at least 1)
+int ThreadCPUCount();
+
+// Thread function (also used as pool task)
+typedef void (*tPoolTask)(void * Arg);
+
+// Thread start parameters (passed to platform entry point)
+struct sThreadStart
+{
+	tPoolTask Func;				// Thread function
+	void * Arg;					// Its argument
+};
+
+bool ThreadStart(tThread * ptrThread, tPoolTask Func, void * Arg);	// Start thread running Func(Arg)
+void ThreadJoin(tThread Thread);									// Wait for thread to finish and release it
+void ThreadSleep(int Ms);											// Suspend current thread
+
+// Task queue entry
+struct sPoolTask
+{
+	tPoolTask Func;				// Task function
+	void * Arg;					// Task argument
+	sPoolTask * Next;			// Next task in queue
+};
+
+// Fixed size thread pool with FIFO task queue
+struct sThreadPool
+{
+	tThread Threads[POOL_MAX_THREADS];	// Worker threads
+	int ThreadCount;					// Number of started workers
+	sPoolTask * Head;					// Queue head (next task to run)
+	sPoolTask * Tail;					// Queue tail
+	int Pending;						// Queued + running tasks
+	bool Stop;							// Workers should exit when queue is empty
+	tMutex Lock;						// Protects everything above
+	tCond HasWork;						// Signaled when task is queued or pool stops
+	tCond AllDone;						// Signaled when Pending drops to 0
+};
+
+bool PoolStart(sThreadPool * Pool, int ThreadCount);				// Start workers (ThreadCount <= 0 - one per CPU)
+bool PoolAdd(sThreadPool * Pool, tPoolTask Func, void * Arg);		// Queue task, returns false if out of memory
+void PoolWait(sThreadPool * Pool);									// Wait until all queued tasks are done
+void PoolStop(sThreadPool * Pool);									// Finish queued tasks and release workers
+
+#endif // THPOOL_H
@@ -0,0 +1,376 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains watch mode: source dir is watched with inotify
+// (change notifications on windows) and open build session is updated
+// after every burst of changes
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include "ps2hl.h"
+#include "fops.h"
+#include "build.h"
+#include "watch.h"
+
+#ifndef _WIN32
+	#include <sys/inotify.h>
+	#include <sys/stat.h>
+	#include <poll.h>
+	#include <unistd.h>
+	#include <errno.h>
+#endif
+
+////////// Structures //////////
+
+// Watched dir (linux watches every dir separately)
+struct sWatchDir
+{
+	int Wd;						// Watch descriptor
+	char * Name;				// Relative to source dir, with trailing delimiter ("" - source dir)
+};
+
+// Watch session
+struct sWatch
+{
+	char SrcDir[PATH_LEN];		// With trailing delimiter
+	sBuild * Build;				// Build session that gets changes
+#ifdef _WIN32
+	HANDLE Change;				// Change notification of whole tree
+#else
+	int Fd;						// Inotify instance
+	sWatchDir * Dirs;			// Watched dirs
+	int Count;					//
+	int Size;					//
+#endif
+};
+
+////////// Globals //////////
+static volatile sig_atomic_t WatchStop = 0;	// Set by Ctrl+C
+
+////////// Platform wrappers //////////
+#ifdef _WIN32
+
+static BOOL WINAPI WatchCtrlHandler(DWORD Type)
+{
+	if (Type != CTRL_C_EVENT && Type != CTRL_BREAK_EVENT)
+		return FALSE;
+
+	WatchStop = 1;
+	return TRUE;
+}
+
+static bool WatchInit(sWatch * Watch)
+{
+	Watch->Change = FindFirstChangeNotificationA(Watch->SrcDir, TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+		FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+	if (Watch->Change == INVALID_HANDLE_VALUE)
+		return false;
+
+	SetConsoleCtrlHandler(WatchCtrlHandler, TRUE);
+	return true;
+}
+
+static void WatchClose(sWatch * Watch)
+{
+	SetConsoleCtrlHandler(WatchCtrlHandler, FALSE);
+	FindCloseChangeNotification(Watch->Change);
+}
+
+static bool WatchWait(sWatch * Watch)	// Wait for changes and for quiet after them, false - stopped
+{
+	bool Changed = false;
+	DWORD Result;
+
+	// Wait in slices to notice Ctrl+C
+	while (WatchStop == 0)
+	{
+		Result = WaitForSingleObject(Watch->Change, Changed ? WATCH_DELAY : 200);
+		if (Result == WAIT_OBJECT_0)
+		{
+			Changed = true;
+			FindNextChangeNotification(Watch->Change);
+		}
+		else if (Result == WAIT_TIMEOUT)
+		{
+			if (Changed == true)
+				break;
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Error: can't watch dir: %s \n", Watch->SrcDir);
+			return false;
+		}
+	}
+
+	// Notification doesn't tell what has changed
+	BuildMarkChanged(Watch->Build, NULL);
+	return WatchStop == 0;
+}
+
+#else // linux
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+#define WATCH_BUF_SIZE 16384	// Event buffer
+
+static void WatchSignal(int Signal)
+{
+	(void)Signal;
+	WatchStop = 1;
+}
+
+static sWatchDir * WatchFindDir(sWatch * Watch, int Wd)
+{
+	for (int i = 0; i < Watch->Count; i++)
+		if (Watch->Dirs[i].Wd == Wd)
+			return &Watch->Dirs[i];
+
+	return NULL;
+}
+
+static bool WatchAddDir(sWatch * Watch, const char * Name)	// Watch dir and all dirs inside of it
+{
+	char Path[PATH_LEN];
+	char SubName[PATH_LEN];
+	size_t Len = strlen(Name);
+	struct dirent * Ent;
+	struct stat Info;
+	sWatchDir * Dir;
+	DIR * DirHandle;
+	int Wd;
+
+	if (snprintf(Path, sizeof(Path), "%s%s", Watch->SrcDir, Name) >= (int)sizeof(Path))
+	{
+		LibMsg(MSG_WARN, "Warning: path is too long: %s \n", Name);
+		return false;
+	}
+	Wd = inotify_add_watch(Watch->Fd, Path, WATCH_EVENTS | IN_ONLYDIR);
+	if (Wd < 0)
+	{
+		LibMsg(MSG_WARN, "Warning: can't watch dir: %s \n", Path);
+		return false;
+	}
+
+	// Same dir can show up twice (created while its parent was scanned)
+	Dir = WatchFindDir(Watch, Wd);
+	if (Dir == NULL)
+	{
+		if (Watch->Count == Watch->Size)
+		{
+			int NewSize = Watch->Size ? Watch->Size * 2 : 64;
+			sWatchDir * NewDirs = (sWatchDir *)LibCalloc(NewSize, sizeof(sWatchDir));
+			if (NewDirs == NULL)
+				return false;
+			if (Watch->Dirs != NULL)
+				memcpy(NewDirs, Watch->Dirs, sizeof(sWatchDir) * Watch->Count);
+			LibFree(Watch->Dirs);
+			Watch->Dirs = NewDirs;
+			Watch->Size = NewSize;
+		}
+		Dir = &Watch->Dirs[Watch->Count++];
+		Dir->Wd = Wd;
+		Dir->Name = NULL;
+	}
+	LibFree(Dir->Name);
+	Dir->Name = (char *)LibAlloc(Len + 1);
+	if (Dir->Name == NULL)
+		return false;
+	memcpy(Dir->Name, Name, Len + 1);
+
+	// Subdirs
+	DirHandle = opendir(Path);
+	if (DirHandle == NULL)
+		return true;
+	while ((Ent = readdir(DirHandle)) != NULL)
+	{
+		if (!strcmp(Ent->d_name, ".") || !strcmp(Ent->d_name, ".."))
+			continue;
+
+		// Room for delimiter is kept
+		if (snprintf(SubName, sizeof(SubName), "%s%s", Name, Ent->d_name) >= (int)sizeof(SubName) - 1 ||
+			snprintf(Path, sizeof(Path), "%s%s", Watch->SrcDir, SubName) >= (int)sizeof(Path))
+		{
+			LibMsg(MSG_WARN, "Warning: path is too long: %s%s \n", Name, Ent->d_name);
+			continue;
+		}
+		if (stat(Path, &Info) != 0 || !S_ISDIR(Info.st_mode))
+			continue;
+
+		strcat(SubName, DIR_DELIM);
+		WatchAddDir(Watch, SubName);
+	}
+	closedir(DirHandle);
+
+	return true;
+}
+
+static void WatchRemoveDir(sWatch * Watch, sWatchDir * Dir)	// Dir is gone, kernel has dropped its watch
+{
+	LibFree(Dir->Name);
+	*Dir = Watch->Dirs[--Watch->Count];
+}
+
+static bool WatchInit(sWatch * Watch)
+{
+	struct sigaction Action;
+
+	Watch->Fd = inotify_init1(IN_CLOEXEC);
+	if (Watch->Fd < 0)
+		return false;
+	if (WatchAddDir(Watch, "") == false)
+	{
+		close(Watch->Fd);
+		return false;
+	}
+
+	// Ctrl+C should let build finish and logs flush
+	memset(&Action, 0x00, sizeof(Action));
+	Action.sa_handler = WatchSignal;
+	Action.sa_flags = SA_RESTART;
+	sigemptyset(&Action.sa_mask);
+	sigaction(SIGINT, &Action, NULL);
+	sigaction(SIGTERM, &Action, NULL);
+
+	return true;
+}
+
+static void WatchClose(sWatch * Watch)
+{
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+
+	close(Watch->Fd);
+	for (int i = 0; i < Watch->Count; i++)
+		LibFree(Watch->Dirs[i].Name);
+	LibFree(Watch->Dirs);
+}
+
+static void WatchRead(sWatch * Watch)	// Pass names from events to build
+{
+	char Buf[WATCH_BUF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char Name[PATH_LEN];
+	const struct inotify_event * Event;
+	sWatchDir * Dir;
+	ssize_t Len;
+
+	Len = read(Watch->Fd, Buf, sizeof(Buf));
+	for (char * Ptr = Buf; Len > 0 && Ptr < Buf + Len; Ptr += sizeof(struct inotify_event) + Event->len)
+	{
+		Event = (const struct inotify_event *)Ptr;
+
+		// Lost events - check everything
+		if (Event->mask & IN_Q_OVERFLOW)
+		{
+			LibMsg(MSG_DEBUG, "Too many changes, checking all files \n");
+			BuildMarkChanged(Watch->Build, NULL);
+			continue;
+		}
+
+		Dir = WatchFindDir(Watch, Event->wd);
+		if (Dir == NULL)
+			continue;
+		if (Event->mask & IN_IGNORED)
+		{
+			WatchRemoveDir(Watch, Dir);
+			continue;
+		}
+		if (Event->len == 0)
+			continue;
+
+		// Room for delimiter is kept
+		if (snprintf(Name, sizeof(Name), "%s%s", Dir->Name, Event->name) >= (int)sizeof(Name) - 1)
+		{
+			LibMsg(MSG_WARN, "Warning: path is too long: %s%s \n", Dir->Name, Event->name);
+			continue;
+		}
+		LibMsg(MSG_DEBUG, "Changed: %s \n", Name);
+
+		// New dir may already have files, which were never seen by watch
+		if (Event->mask & IN_ISDIR)
+		{
+			if (Event->mask & (IN_CREATE | IN_MOVED_TO))
+			{
+				strcat(Name, DIR_DELIM);
+				WatchAddDir(Watch, Name);
+				BuildMarkChanged(Watch->Build, NULL);
+			}
+			continue;
+		}
+
+		BuildMarkChanged(Watch->Build, Name);
+	}
+}
+
+static bool WatchWait(sWatch * Watch)	// Wait for changes and for quiet after them, false - stopped
+{
+	struct pollfd Poll;
+	int Timeout = -1;
+	int Ready;
+
+	Poll.fd = Watch->Fd;
+	Poll.events = POLLIN;
+	while (WatchStop == 0)
+	{
+		Ready = poll(&Poll, 1, Timeout);
+		if (Ready < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			LibMsg(MSG_ERROR, "Error: can't watch dir: %s \n", Watch->SrcDir);
+			return false;
+		}
+		if (Ready == 0)
+			return true;	// Quiet after changes
+
+		WatchRead(Watch);
+		Timeout = WATCH_DELAY;
+	}
+
+	return false;
+}
+
+#endif
+
+////////// Functions //////////
+int WatchRun(const char * SrcDir, const char * OutDir, int Threads)
+{
+	sWatch Watch;
+	size_t Len = strlen(SrcDir);
+
+	memset(&Watch, 0x00, sizeof(Watch));
+	if (Len == 0 || Len + 2 >= PATH_LEN)
+		return PS2HL_ERR_PARAM;
+	strcpy(Watch.SrcDir, SrcDir);
+	if (SrcDir[Len - 1] != DIR_DELIM_CH && SrcDir[Len - 1] != DIR_NOT_DELIM_CH)
+		strcat(Watch.SrcDir, DIR_DELIM);
+
+	Watch.Build = BuildOpen(SrcDir, OutDir, Threads, true);
+	if (Watch.Build == NULL)
+		return PS2HL_ERR_PARAM;
+
+	// Start watching before first build, so changes made meanwhile aren't lost
+	if (WatchInit(&Watch) == false)
+	{
+		LibMsg(MSG_ERROR, "Error: can't watch dir: %s \n", SrcDir);
+		BuildClose(Watch.Build);
+		return PS2HL_ERR_OPEN;
+	}
+
+	BuildUpdate(Watch.Build);
+	while (WatchStop == 0)
+	{
+		LibMsg(MSG_INFO, "\nWatching %s for changes (Ctrl+C to stop) ...\n", SrcDir);
+		if (WatchWait(&Watch) == false)
+			break;
+		BuildUpdate(Watch.Build);
+	}
+
+	WatchClose(&Watch);
+	BuildClose(Watch.Build);
+	LibMsg(MSG_INFO, "\nStopped watching\n");
+
+	return PS2HL_OK;
+}
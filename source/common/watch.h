@@ -0,0 +1,21 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "types.h"
+
+// Watch mode: build output dir, then keep watching source dir and update
+// build after every change. Bursts of events (editor saves, copying of
+// many files) are merged, update starts when source is quiet for
+// WATCH_DELAY ms. Only files that got events are checked (on linux,
+// windows doesn't tell names, so stamps of every file are checked).
+// Build session stays open, so PAKs are patched in memory instead of
+// packing whole dir again. Runs until Ctrl+C.
+
+#define WATCH_DELAY 300		// Debounce delay, ms
+
+int WatchRun(const char * SrcDir, const char * OutDir, int Threads);	// Returns PS2HL_OK when stopped or error if watching can't start
+
+#endif // WATCH_H
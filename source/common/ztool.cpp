@@ -0,0 +1,362 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains DEFLATE\INFLATE wrappers shared by all tools
+//
+// Zlib library is used within this module
+//
+
+////////// Includes //////////
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "ps2hl.h"
+#include "perf.h"
+#include "zlib.h"
+#include "ztool.h"
+#include "checksum.h"
+
+////////// Definitions //////////
+#define ZDeflateInit(Stream) deflateInit2(Stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY)	// Raw, same as deflateInit() otherwise
+#define ZInflateInit(Stream) inflateInit2(Stream, -MAX_WBITS)															// Raw
+
+////////// Structures //////////
+
+// Streams of one thread (in global list, released at exit)
+struct sZThread
+{
+	z_stream Deflate;
+	z_stream Inflate;
+	uchar * Arena;				// Memory of both streams
+	ulong ArenaUsed;			//
+	bool DeflateReady;			// deflateInit() done
+	bool InflateReady;			// inflateInit() done
+	bool DeflateBusy;			// Given out by ZDeflateBegin()
+	bool InflateBusy;			// Given out by ZInflateBegin()
+	sZThread * Next;
+};
+
+////////// Globals //////////
+static sZThread * ZThreads = NULL;				// Streams of all threads
+static int ZExitHook = 0;						// atexit() is set
+static __thread sZThread * ZSelf = NULL;		// Streams of current thread
+
+////////// Stream pool //////////
+static voidpf ZArenaAlloc(voidpf Opaque, uInt Items, uInt Size)
+{
+	sZThread * Self = (sZThread *)Opaque;
+	ulong Bytes = ((ulong)Items * Size + 15) & ~15UL;	// Keep 16 byte alignment
+	uchar * Block;
+
+	// Streams are never ended while thread is alive, so arena only grows up to the size of two states
+	if (Self->Arena != NULL && Bytes <= ZARENA_SIZE - Self->ArenaUsed)
+	{
+		Block = &Self->Arena[Self->ArenaUsed];
+		Self->ArenaUsed += Bytes;
+		return Block;
+	}
+
+	return LibAlloc((ulong)Items * Size);		// Doesn't fit (i.e. zlib with bigger state)
+}
+
+static void ZArenaFree(voidpf Opaque, voidpf Address)
+{
+	sZThread * Self = (sZThread *)Opaque;
+
+	if (Self->Arena == NULL || (uchar *)Address < Self->Arena || (uchar *)Address >= Self->Arena + ZARENA_SIZE)
+		LibFree(Address);
+}
+
+static void ZReleaseThreads()	// atexit() handler, worker threads are joined by now
+{
+	sZThread * Thread;
+
+	while (ZThreads != NULL)
+	{
+		Thread = ZThreads;
+		ZThreads = Thread->Next;
+		if (Thread->DeflateReady == true)
+			deflateEnd(&Thread->Deflate);
+		if (Thread->InflateReady == true)
+			inflateEnd(&Thread->Inflate);
+		LibFree(Thread->Arena);
+		LibFree(Thread);
+	}
+}
+
+static sZThread * ZGetThread()
+{
+	sZThread * Thread;
+
+	if (ZSelf != NULL)
+		return ZSelf;
+
+	Thread = (sZThread *)LibCalloc(1, sizeof(sZThread));
+	if (Thread == NULL)
+		return NULL;
+	Thread->Arena = (uchar *)LibAlloc(ZARENA_SIZE);		// NULL - streams use heap
+	Thread->Deflate.zalloc = ZArenaAlloc;
+	Thread->Deflate.zfree = ZArenaFree;
+	Thread->Deflate.opaque = Thread;
+	Thread->Inflate.zalloc = ZArenaAlloc;
+	Thread->Inflate.zfree = ZArenaFree;
+	Thread->Inflate.opaque = Thread;
+
+	// Lock-free push, list is only walked at exit
+	do
+		Thread->Next = ZThreads;
+	while (__sync_bool_compare_and_swap(&ZThreads, Thread->Next, Thread) == false);
+	if (__sync_bool_compare_and_swap(&ZExitHook, 0, 1) == true)
+		atexit(ZReleaseThreads);
+
+	ZSelf = Thread;
+	return Thread;
+}
+
+z_stream * ZDeflateBegin()
+{
+	sZThread * Self = ZGetThread();
+	z_stream * Stream;
+
+	if (Self != NULL && Self->DeflateBusy == false)
+	{
+		if (Self->DeflateReady == false)
+		{
+			if (ZDeflateInit(&Self->Deflate) != Z_OK)
+				return NULL;
+			Self->DeflateReady = true;
+		}
+		else if (deflateReset(&Self->Deflate) != Z_OK)
+		{
+			return NULL;
+		}
+		Self->DeflateBusy = true;
+		return &Self->Deflate;
+	}
+
+	// Nested use - own stream
+	Stream = (z_stream *)LibCalloc(1, sizeof(z_stream));
+	if (Stream == NULL)
+		return NULL;
+	if (ZDeflateInit(Stream) != Z_OK)
+	{
+		LibFree(Stream);
+		return NULL;
+	}
+	return Stream;
+}
+
+void ZDeflateEnd(z_stream * Stream)
+{
+	if (Stream == NULL)
+		return;
+
+	if (ZSelf != NULL && Stream == &ZSelf->Deflate)
+	{
+		ZSelf->DeflateBusy = false;
+		return;
+	}
+	deflateEnd(Stream);
+	LibFree(Stream);
+}
+
+z_stream * ZInflateBegin()
+{
+	sZThread * Self = ZGetThread();
+	z_stream * Stream;
+
+	if (Self != NULL && Self->InflateBusy == false)
+	{
+		if (Self->InflateReady == false)
+		{
+			Self->Inflate.next_in = Z_NULL;
+			Self->Inflate.avail_in = 0;
+			if (ZInflateInit(&Self->Inflate) != Z_OK)
+				return NULL;
+			Self->InflateReady = true;
+		}
+		else if (inflateReset(&Self->Inflate) != Z_OK)
+		{
+			return NULL;
+		}
+		Self->InflateBusy = true;
+		return &Self->Inflate;
+	}
+
+	// Nested use - own stream
+	Stream = (z_stream *)LibCalloc(1, sizeof(z_stream));
+	if (Stream == NULL)
+		return NULL;
+	if (ZInflateInit(Stream) != Z_OK)
+	{
+		LibFree(Stream);
+		return NULL;
+	}
+	return Stream;
+}
+
+void ZInflateEnd(z_stream * Stream)
+{
+	if (Stream == NULL)
+		return;
+
+	if (ZSelf != NULL && Stream == &ZSelf->Inflate)
+	{
+		ZSelf->InflateBusy = false;
+		return;
+	}
+	inflateEnd(Stream);
+	LibFree(Stream);
+}
+
+////////// Stream wrapper //////////
+void ZPutHeader(uchar * Out)
+{
+	Out[0] = 0x78;		// Deflate, 32 KiB window
+	Out[1] = 0xDA;		// Best compression, no dictionary, check bits
+}
+
+void ZPutTrailer(uchar * Out, ulong Adler)
+{
+	Out[0] = (uchar)(Adler >> 24);
+	Out[1] = (uchar)(Adler >> 16);
+	Out[2] = (uchar)(Adler >> 8);
+	Out[3] = (uchar)Adler;
+}
+
+bool ZCheckHeader(const uchar * Data)
+{
+	return (Data[0] & 0x0F) == Z_DEFLATED && (Data[0] >> 4) + 8 <= MAX_WBITS && (Data[1] & 0x20) == 0 && ((Data[0] << 8) | Data[1]) % 31 == 0;
+}
+
+ulong ZGetTrailer(const uchar * Data)
+{
+	return ((ulong)Data[0] << 24) | ((ulong)Data[1] << 16) | ((ulong)Data[2] << 8) | Data[3];
+}
+
+static int ZDeflateWrapped(z_stream * defstream, const uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize)	// Compress to zlib stream with raw deflate stream
+{
+	uchar * NewData;
+	ulong NewDataSize;
+
+	// Allocate memory for compressed data (worst case size, so incompressible data fits too)
+	NewDataSize = ZHEADER_SIZE + deflateBound(defstream, InputDataSize) + ZTRAILER_SIZE;
+	NewData = (uchar *)LibAlloc(NewDataSize);
+	if (NewData == NULL)
+		return PS2HL_ERR_MEMORY;
+
+	defstream->next_in = (Bytef *)InputData;					// Input data pointer (decompressed data)
+	defstream->avail_in = (uint)InputDataSize;					// Size of input data
+	defstream->next_out = (Bytef *)NewData + ZHEADER_SIZE;		// Output data pointer (compressed data)
+	defstream->avail_out = (uint)(NewDataSize - ZHEADER_SIZE - ZTRAILER_SIZE);	// Size of output data
+
+	// Compression work
+	if (deflate(defstream, Z_FINISH) != Z_STREAM_END || defstream->total_out == 0)
+	{
+		LibFree(NewData);
+		return PS2HL_ERR_ZLIB;
+	}
+
+	// Wrap it
+	NewDataSize = ZHEADER_SIZE + defstream->total_out;
+	ZPutHeader(NewData);
+	ZPutTrailer(&NewData[NewDataSize], ChecksumAdler32(CHECKSUM_ADLER32_INIT, InputData, InputDataSize));
+	NewDataSize += ZTRAILER_SIZE;
+
+	// Return data pointer and data size
+	*OutputData = NewData;
+	*OutputDataSize = NewDataSize;
+	return PS2HL_OK;
+}
+
+////////// Functions //////////
+int ZDecompress(const uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize, ulong StartSize)
+{
+	PERF_SCOPE(PERF_PH_INFLATE);
+
+	z_stream * infstream;
+	uchar * NewData;
+	ulong NewDataSize;
+	int Result;
+
+	// Check zlib header (raw deflate data follows it)
+	if (InputDataSize < ZHEADER_SIZE + ZTRAILER_SIZE || ZCheckHeader(InputData) == false)
+		return PS2HL_ERR_ZLIB;
+
+	// Set starting size of decompressed data (would be increased if bigger)
+	NewDataSize = StartSize;
+
+	infstream = ZInflateBegin();
+	if (infstream == NULL)
+		return PS2HL_ERR_ZLIB;
+
+	// Decompression loop
+	do
+	{
+		// Allocate memory for decompressed data
+		NewData = (uchar *)LibAlloc(NewDataSize);
+		if (NewData == NULL)
+		{
+			ZInflateEnd(infstream);
+			return PS2HL_ERR_MEMORY;
+		}
+
+		infstream->next_in = (Bytef *)InputData + ZHEADER_SIZE;			// Input data pointer (compressed data)
+		infstream->avail_in = (uint)(InputDataSize - ZHEADER_SIZE);		// Size of input data
+		infstream->next_out = (Bytef *)NewData;							// Output data pointer (decompressed data)
+		infstream->avail_out = (uint)NewDataSize;						// Size of output data
+
+		// Decompression work
+		Result = inflate(infstream, Z_FINISH);
+
+		// if buffer is full then increase buffer size and retry decompression
+		if (Result != Z_STREAM_END)
+		{
+			LibFree(NewData);
+
+			if ((Result != Z_BUF_ERROR && Result != Z_OK) || infstream->avail_out != 0 || inflateReset(infstream) != Z_OK)
+			{
+				ZInflateEnd(infstream);
+				return PS2HL_ERR_ZLIB;	// Damaged or truncated stream
+			}
+
+			NewDataSize = NewDataSize * 2 + 1;		// +1 to avoid infinite loop, when StartSize = 0
+		}
+	} while (Result != Z_STREAM_END);
+	NewDataSize = infstream->total_out;
+
+	// Trailer follows deflate data
+	if (infstream->avail_in < ZTRAILER_SIZE || ZGetTrailer(infstream->next_in) != ChecksumAdler32(CHECKSUM_ADLER32_INIT, NewData, NewDataSize))
+		NewDataSize = 0;		// Treated as damaged
+	ZInflateEnd(infstream);
+
+	// Check if output data has zero size
+	if (NewDataSize == 0)
+	{
+		LibFree(NewData);
+		return PS2HL_ERR_ZLIB;
+	}
+
+	// Return data pointer and data size
+	*OutputData = NewData;
+	*OutputDataSize = NewDataSize;
+	return PS2HL_OK;
+}
+
+int ZCompress(const uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize)
+{
+	PERF_SCOPE(PERF_PH_DEFLATE);
+
+	z_stream * defstream;
+	int Result;
+
+	defstream = ZDeflateBegin();
+	if (defstream == NULL)
+		return PS2HL_ERR_ZLIB;
+
+	Result = ZDeflateWrapped(defstream, InputData, InputDataSize, OutputData, OutputDataSize);
+	ZDeflateEnd(defstream);
+	return Result;
+}
@@ -0,0 +1,34 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+#ifndef ZTOOL_H
+#define ZTOOL_H
+
+#include "types.h"
+
+// Zlib functions (return PS2HL_OK or error code, output should be freed with LibFree())
+int ZDecompress(const uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize, ulong StartSize);	// Decompress data with Zlib
+int ZCompress(const uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize);					// Compress data with Zlib
+
+// Per thread zlib streams: each thread keeps one deflate (best compression)
+// and one inflate stream, which are only reset between uses. Their state is
+// allocated once from arena of the thread (zalloc/zfree), so converting many
+// small files doesn't call deflateInit() and malloc() for each of them.
+// Nested use on same thread gets separate stream.
+// Streams are raw deflate: zlib header and Adler-32 trailer are written and
+// checked by callers (ZPutHeader() etc.), so checksum is ChecksumAdler32().
+#define ZARENA_SIZE 0x50000		// Deflate (~270 KiB at best level) + inflate (~40 KiB)
+#define ZHEADER_SIZE 2			// CMF, FLG
+#define ZTRAILER_SIZE 4			// Adler-32 (big endian)
+
+struct z_stream_s;
+struct z_stream_s * ZDeflateBegin();				// Deflate stream of current thread, reset (NULL on failure)
+void ZDeflateEnd(struct z_stream_s * Stream);		// Give it back
+struct z_stream_s * ZInflateBegin();				// Inflate stream of current thread, reset (NULL on failure)
+void ZInflateEnd(struct z_stream_s * Stream);		// Give it back
+void ZPutHeader(uchar * Out);						// Header of best compression stream (0x78 0xDA)
+void ZPutTrailer(uchar * Out, ulong Adler);			// Adler-32 of uncompressed data
+bool ZCheckHeader(const uchar * Data);				// Deflate with 32 KiB window or less, no preset dictionary
+ulong ZGetTrailer(const uchar * Data);				// Stored Adler-32
+
+#endif // ZTOOL_H
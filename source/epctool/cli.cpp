@@ -0,0 +1,80 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains command line front-end of EPC tool
+//
+
+////////// Includes //////////
+#include "util.h"
+#include "main.h"
+#include "perf.h"
+#include "log.h"
+
+using namespace epc;
+
+int main(int argc, char * argv[])
+{
+	char cExtension[5];
+
+	argc = PerfParseArgs(argc, argv);	// --stats, --trace <file>
+	argc = LogParseArgs(argc, argv, false);	// -q, -v, --log-format=jsonl
+	LibSetInteractive(true);
+	LibMsg(MSG_INFO, "%s\n", PROG_TITLE);
+
+	if (argc == 1)
+	{
+		puts(PROG_INFO);
+		UTIL_WAIT_KEY("Press any key to exit ...");
+	}
+	else if (argc == 2)
+	{
+		FileGetExtension(argv[1], cExtension, sizeof(cExtension));
+
+		if (!strcmp(cExtension, ".txt") == true)
+		{
+			LibMsg(MSG_INFO, "Processing file: %s \n", argv[1]);
+
+			if (ValidateInputFile(argv[1]) == PS2HL_OK)			// File is OK
+			{
+				if (TranslateInputFile(argv[1]) == PS2HL_OK)
+				{
+					LibMsg(MSG_INFO, "Done! \n\n");
+					return 0;
+				}
+				else
+				{
+					LibMsg(MSG_ERROR, "Translation error! \n\n");
+				}
+			}
+			else											// Bad file
+			{
+				LibMsg(MSG_ERROR, "Validation failed! \n\n");
+			}
+		}
+		else if (!strcmp(cExtension, ".inf") == true)
+		{
+			if (TranslateSourceFile(argv[1]) == PS2HL_OK)
+			{
+				LibMsg(MSG_INFO, "Done! \n\n");
+				return 0;
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Translation error! \n\n");
+			}
+		}
+		else												// Unsupported file
+		{
+			LibMsg(MSG_ERROR, "Unsupported file extension ...\n");
+		}
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Too many arguments ...\n");
+	}
+
+	//getch();
+	
+	return 1;
+}
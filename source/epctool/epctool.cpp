@@ -8,22 +8,15 @@
 ////////// Includes //////////
 #include "util.h"
 #include "main.h"				// Main header
+#include "jobs.h"
+#include "lint.h"
 
 ////////// Defines /////////////
 
 // !!! Check for dulicate models too!!!!!
 
-////////// Functions //////////
-bool AddTerminator(char * Buffer, char Symbol);	// Replace specified symbol with null terminator
-bool FindSymbol(char * Buffer, char Symbol);	// Find symbol in string
-uint SetSubmodels(char * Buffer);				// Set up submodels flags
-bool SetBit(uint * Input, uchar Bit);			// Set bit in 4-byte variable
-bool ValidateInputFile(const char * cFile);		// Validate input file
-bool TranslateInputFile(const char * cFile);	// Translate input file
-bool TranslateSourceFile(const char * cFile);	// Translate source file obtained from "YA PS2HL" mod
-
-///////// Variables /////////
-
+namespace epc
+{
 
 ///////// Code /////////
 bool AddTerminator(char * Buffer, char Symbol)
@@ -87,14 +80,12 @@ uint SetSubmodels(char * Buffer)
 				// Give warning if submodel number is wrong
 				if (Number > 31)
 				{
-					puts("Waning: found submodel number > 31, ignoring.\n");
-					UTIL_WAIT_KEY("Press any key to confirm ...");
+					LibMsg(MSG_WARN | MSG_CONFIRM, "Waning: found submodel number > 31, ignoring.\n\n");
 					continue;
 				}
 				else if (Number == 0)
 				{
-					puts("Waning: submodel number 0 can result in unforseen consequences.\n");
-					UTIL_WAIT_KEY("Press any key to confirm ...");
+					LibMsg(MSG_WARN | MSG_CONFIRM, "Waning: submodel number 0 can result in unforseen consequences.\n\n");
 				}
 
 				// Set up submodel flag
@@ -129,7 +120,7 @@ bool SetBit(uint * Input, uchar Bit)
 	return true;
 }
 
-bool ValidateInputFile(const char * cFile)
+int ValidateInputFile(const char * cFile)
 {
 	FILE * ptrInputF;		// Input file stream
 	char Buffer[128];		// Text buffer
@@ -137,7 +128,8 @@ bool ValidateInputFile(const char * cFile)
 	ushort Close = 0;		// Close brackets count
 
 	// Open file
-	SafeFileOpen(&ptrInputF, cFile, "rb");
+	if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Count '{' and '}'
 	Open = Close = 0;
@@ -157,9 +149,9 @@ bool ValidateInputFile(const char * cFile)
 			}
 			else
 			{
-				puts("Invalid {} order !");
+				LibMsg(MSG_ERROR, "Invalid {} order !\n");
 				fclose(ptrInputF);
-				return false;
+				return PS2HL_ERR_FORMAT;
 			}
 		}
 	}
@@ -167,20 +159,20 @@ bool ValidateInputFile(const char * cFile)
 	// Check for empty
 	if (Open == 0 && Close == 0)
 	{
-		puts("Found zero maps ...");
+		LibMsg(MSG_ERROR, "Found zero maps ...\n");
 		fclose(ptrInputF);
-		return false;
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Check for parity
 	if (Open != Close)
 	{
-		puts("Number of \'{\' not matches \'}\' !");
+		LibMsg(MSG_ERROR, "Number of \'{\' not matches \'}\' !\n");
 		fclose(ptrInputF);
-		return false;
+		return PS2HL_ERR_FORMAT;
 	}
 
-	printf("Found %d maps \n", Open);
+	LibMsg(MSG_INFO, "Found %d maps \n", Open);
 	
 	// Rewind file pointer
 	fseek(ptrInputF, 0, SEEK_SET);
@@ -206,46 +198,46 @@ bool ValidateInputFile(const char * cFile)
 				}
 				else
 				{
-					puts("Invalid [] order !");
+					LibMsg(MSG_ERROR, "Invalid [] order !\n");
 					fclose(ptrInputF);
-					return false;
+					return PS2HL_ERR_FORMAT;
 				}
 			}
 		}
 
 		if (Open != Close)
 		{
-					puts("Both \'[\' and \']\' should be on one line !");
+					LibMsg(MSG_ERROR, "Both \'[\' and \']\' should be on one line !\n");
 					fclose(ptrInputF);
-					return false;
+					return PS2HL_ERR_FORMAT;
 		}
 	}
 
 	// Check for empty
 	if (Open == 0 && Close == 0)
 	{
-		puts("Found zero models ...");
+		LibMsg(MSG_ERROR, "Found zero models ...\n");
 		fclose(ptrInputF);
-		return false;
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Check for parity
 	if (Open != Close)
 	{
-		puts("Number of \'[\' not matches \']\' ...");
+		LibMsg(MSG_ERROR, "Number of \'[\' not matches \']\' ...\n");
 		fclose(ptrInputF);
-		return false;
+		return PS2HL_ERR_FORMAT;
 	}
 
-	printf("Found %d model references \n", Open);
+	LibMsg(MSG_INFO, "Found %d model references \n", Open);
 
 	// Close file
 	fclose(ptrInputF);
 
-	return true;
+	return PS2HL_OK;
 }
 
-bool TranslateInputFile(const char * cFile)
+int TranslateInputFile(const char * cFile)
 {
 	FILE * ptrInputF;					// Input file stream
 	FILE * ptrOutputF;					// Output file stream
@@ -263,7 +255,8 @@ bool TranslateInputFile(const char * cFile)
 	//// Read items ////
 
 	// Open input file
-	SafeFileOpen(&ptrInputF, cFile, "rb");
+	if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Fetch items from file
 	Map = true;
@@ -282,9 +275,10 @@ bool TranslateInputFile(const char * cFile)
 			}
 			else
 			{
-				printf("Error: found at least two identical maps. \nMap name: %s \n", PrevBuffer);
+				LibMsg(MSG_ERROR, "Error: found at least two identical maps. \nMap name: %s \n", PrevBuffer);
 				fclose(ptrInputF);
-				return false;
+				List.Clear();
+				return PS2HL_ERR_FORMAT;
 			}
 		}
 		else if (!strcmp(Buffer, "}") == true)
@@ -310,13 +304,18 @@ bool TranslateInputFile(const char * cFile)
 
 	//// Write item list ////
 
-	puts("Writing item List ...");
+	LibMsg(MSG_INFO, "Writing item List ...\n");
 
 	// Open output file
 	char OutFileName[PATH_LEN];
 	FileGetPath(cFile, OutFileName, sizeof(OutFileName));
 	strcat(OutFileName, "extraprecache.epc");
-	SafeFileOpen(&ptrOutputF, OutFileName, "wb");
+	if (FileOpen(&ptrOutputF, OutFileName, "wb") == false)
+	{
+		fclose(ptrInputF);
+		List.Clear();
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Write item count
 	ItemCnt = List.ListSz;
@@ -327,7 +326,15 @@ bool TranslateInputFile(const char * cFile)
 	{
 		// Allocate memory
 		uint Size = (strlen(List.List[i]) / PS2HL_EPC_ALLIGNMENT + 1) * PS2HL_EPC_ALLIGNMENT;
-		char * ItemBuf = (char *) malloc(Size);
+		char * ItemBuf = (char *) LibAlloc(Size);
+		if (ItemBuf == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			fclose(ptrInputF);
+			fclose(ptrOutputF);
+			List.Clear();
+			return PS2HL_ERR_MEMORY;
+		}
 		memset(ItemBuf, 0xFD, Size);
 		strcpy(ItemBuf, List.List[i]);
 
@@ -338,7 +345,7 @@ bool TranslateInputFile(const char * cFile)
 		FileWriteBlock(&ptrOutputF, ItemBuf, Size);
 
 		// Free mamory
-		free(ItemBuf);
+		LibFree(ItemBuf);
 	}
 
 	// Write map count
@@ -347,7 +354,7 @@ bool TranslateInputFile(const char * cFile)
 	
 	//// Read connections ////
 	
-	puts("Writing connections ...\n");
+	LibMsg(MSG_INFO, "Writing connections ...\n\n");
 
 	// Rewind input file pointer
 	fseek(ptrInputF, 0, SEEK_SET);
@@ -366,10 +373,11 @@ bool TranslateInputFile(const char * cFile)
 			Result = List.Find(PrevBuffer);
 			if (Result == -1)
 			{
-				puts("Unexpected error: map isn't found in the internal list ...");
+				LibMsg(MSG_ERROR, "Unexpected error: map isn't found in the internal list ...\n");
 				fclose(ptrInputF);
 				fclose(ptrOutputF);
-				return false;
+				List.Clear();
+				return PS2HL_ERR_FORMAT;
 			}
 
 			// Set up map entry
@@ -396,10 +404,11 @@ bool TranslateInputFile(const char * cFile)
 				Result = List.Find(PrevBuffer);
 				if (Result == -1)
 				{
-					puts("Unexpected error: model isn't found in the internal list ...");
+					LibMsg(MSG_ERROR, "Unexpected error: model isn't found in the internal list ...\n");
 					fclose(ptrInputF);
 					fclose(ptrOutputF);
-					return false;
+					List.Clear();
+					return PS2HL_ERR_FORMAT;
 				}
 
 				// Set up model entry
@@ -423,10 +432,13 @@ bool TranslateInputFile(const char * cFile)
 	// Close output file
 	fclose(ptrOutputF);
 
-	return true;
+	// Free memory
+	List.Clear();
+
+	return PS2HL_OK;
 }
 
-bool TranslateSourceFile(const char * cFile)
+int TranslateSourceFile(const char * cFile)
 {
 	sModelHeader ModelHeader;	// Model file header
 	sModelSeq * SeqTable;		// Sequences table
@@ -450,7 +462,8 @@ bool TranslateSourceFile(const char * cFile)
 	srcList.Init();
 
 	// Open input file
-	SafeFileOpen(&ptrInFile, cFile, "r");
+	if (FileOpen(&ptrInFile, cFile, "r") == false)
+		return PS2HL_ERR_OPEN;
 	fseek(ptrInFile, 0, SEEK_SET);
 
 	// Parse file
@@ -468,12 +481,12 @@ bool TranslateSourceFile(const char * cFile)
 			// Sequence
 			if (ModelIndex == -1)
 			{
-				puts("Error: sequence before model");
+				LibMsg(MSG_ERROR, "Error: sequence before model\n");
 				continue;
 			}
 			if (MapIndex == -1)
 			{
-				puts("Error: sequence before map");
+				LibMsg(MSG_ERROR, "Error: sequence before map\n");
 				continue;
 			}
 
@@ -484,7 +497,7 @@ bool TranslateSourceFile(const char * cFile)
 				int Submodel = srcList.FindSequence(ModelIndex, LineBuf);
 				if (Submodel == -1)
 				{
-					puts("Error adding sequence");
+					LibMsg(MSG_ERROR, "Error adding sequence\n");
 					continue;
 				}
 				if (Submodel)
@@ -496,12 +509,12 @@ bool TranslateSourceFile(const char * cFile)
 			// Submodel index
 			if (ModelIndex == -1)
 			{
-				puts("Error: submodel before model");
+				LibMsg(MSG_ERROR, "Error: submodel before model\n");
 				continue;
 			}
 			if (MapIndex == -1)
 			{
-				puts("Error: submodel before map");
+				LibMsg(MSG_ERROR, "Error: submodel before map\n");
 				continue;
 			}
 
@@ -519,7 +532,7 @@ bool TranslateSourceFile(const char * cFile)
 			// Model
 			if (MapIndex == -1)
 			{
-				puts("Error: model before map");
+				LibMsg(MSG_ERROR, "Error: model before map\n");
 				continue;
 			}
 
@@ -528,8 +541,14 @@ bool TranslateSourceFile(const char * cFile)
 			if (LineBuf[0] != '\0')
 			{
 				ModelIndex = srcList.FindOrAdd(LineBuf, false, Dir1, Dir2);
+				if (srcList.Error != PS2HL_OK)
+				{
+					fclose(ptrInFile);
+					srcList.Clear();
+					return srcList.Error;
+				}
 				if (ModelIndex == -1)
-					puts("Error adding model");
+					LibMsg(MSG_ERROR, "Error adding model\n");
 				else
 					if (srcList.Types[ModelIndex] == NOTEXTURES_MODEL)
 						srcList.SetSubmodel(ModelIndex, srcList.List[MapIndex], 0);	// Mark texture submodel
@@ -543,7 +562,7 @@ bool TranslateSourceFile(const char * cFile)
 			{
 				MapIndex = srcList.FindOrAdd(LineBuf, true, Dir1, Dir2);
 				if (MapIndex == -1)
-					puts("Error adding map");
+					LibMsg(MSG_ERROR, "Error adding map\n");
 			}
 		}
 		else if (!strcmp(LineBuf, KWD_DIR))
@@ -566,7 +585,11 @@ bool TranslateSourceFile(const char * cFile)
 	// Open output file
 	FileGetFullName(cFile, cOutFileName, sizeof(cOutFileName));
 	strcat(cOutFileName, ".txt");
-	SafeFileOpen(&ptrOutFile, cOutFileName, "w");
+	if (FileOpen(&ptrOutFile, cOutFileName, "w") == false)
+	{
+		srcList.Clear();
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Write output file
 	for (short map = 0; map < srcList.ListSz; map++)
@@ -618,64 +641,115 @@ bool TranslateSourceFile(const char * cFile)
 	// Free memory
 	srcList.Clear();
 
-	puts("Done!\n\n");
-	return true;
+	LibMsg(MSG_INFO, "Done!\n\n\n");
+	return PS2HL_OK;
 }
 
-int main(int argc, char * argv[])
+
+////////// Batch jobs //////////
+int RunJob(const char * Command, const char * FileName)
 {
 	char cExtension[5];
+	int Result;
 
-	puts(PROG_TITLE);
-
-	if (argc == 1)
+	if (JobIsAuto(Command) == false)
 	{
-		puts(PROG_INFO);
-		UTIL_WAIT_KEY("Press any key to exit ...");
+		LibMsg(MSG_ERROR, "Can't recognise command: %s \n", Command);
+		return PS2HL_ERR_PARAM;
 	}
-	else if (argc == 2)
+
+	FileGetExtension(FileName, cExtension, sizeof(cExtension));
+	if (!strcmp(cExtension, ".txt"))
 	{
-		FileGetExtension(argv[1], cExtension, sizeof(cExtension));
+		LibMsg(MSG_INFO, "Processing file: %s \n", FileName);
 
-		if (!strcmp(cExtension, ".txt") == true)
+		Result = ValidateInputFile(FileName);
+		if (Result != PS2HL_OK)
 		{
-			printf("Processing file: %s \n", argv[1]);
+			LibMsg(MSG_ERROR, "Validation failed! \n");
+			return Result;
+		}
+		return TranslateInputFile(FileName);
+	}
+	if (!strcmp(cExtension, ".inf"))
+		return TranslateSourceFile(FileName);
 
-			if (ValidateInputFile(argv[1]) == true)			// File is OK
-			{
-				if (TranslateInputFile(argv[1]) == true)
-				{
-					puts("Done! \n");
-					return 0;
-				}
-				else
-				{
-					puts("Translation error! \n");
-				}
-			}
-			else											// Bad file
-			{
-				puts("Validation failed! \n");
-			}
+	LibMsg(MSG_ERROR, "Unsupported file extension ...\n");
+	return PS2HL_ERR_PARAM;
+}
+
+const char * JobVersion()
+{
+	return PROG_TITLE;
+}
+
+bool SniffFile(const char * FileName)
+{
+	char cExtension[5];
+
+	// Only source lists are recognised (*.txt goes to TXT tool)
+	FileGetExtension(FileName, cExtension, sizeof(cExtension));
+	return !strcmp(cExtension, ".inf");
+}
+
+int LintFile(const char * FileName, sLintFile * Lint)
+{
+	char cExtension[5];
+	FILE * ptrInFile;
+	char LineBuf[PATH_LEN];
+	int Line = 0;
+	int Result;
+	bool HasMap = false;
+	bool HasModel = false;
+
+	// Precache list
+	FileGetExtension(FileName, cExtension, sizeof(cExtension));
+	if (!strcmp(cExtension, ".txt"))
+	{
+		Result = ValidateInputFile(FileName);
+		if (Result == PS2HL_ERR_FORMAT)
+			LintReport(Lint, LINT_ERROR, "invalid precache list (check it with \"epc\")");
+		return (Result == PS2HL_ERR_FORMAT) ? PS2HL_OK : Result;
+	}
+
+	// Source list: same order rules as in TranslateSourceFile()
+	if (FileOpen(&ptrInFile, FileName, "r") == false)
+		return PS2HL_ERR_OPEN;
+	while (fgets(LineBuf, sizeof(LineBuf), ptrInFile) != NULL)
+	{
+		Line++;
+		AddTerminator(LineBuf, '\r');
+		AddTerminator(LineBuf, '\n');
+		if (LineBuf[0] == KEY_COMMENT || LineBuf[0] == '\0')
+			continue;
+
+		if (!strcmp(LineBuf, KWD_MAP))
+			HasMap = true;
+		else if (!strcmp(LineBuf, KWD_MODEL))
+		{
+			if (HasMap == false)
+				LintReport(Lint, LINT_ERROR, "line %d: model before map", Line);
+			HasModel = true;
 		}
-		if (!strcmp(cExtension, ".inf") == true)
+		else if (!strcmp(LineBuf, KWD_SEQ) || !strcmp(LineBuf, KWD_INDEX))
 		{
-			if (TranslateSourceFile(argv[1]) == true)
-				puts("Done! \n");
-			else
-				puts("Translation error! \n");
+			if (HasMap == false || HasModel == false)
+				LintReport(Lint, LINT_ERROR, "line %d: %s before %s", Line, LineBuf, HasMap ? "model" : "map");
 		}
-		else												// Unsupported file
+		else if (strcmp(LineBuf, KWD_DIR) && strcmp(LineBuf, KWD_DIR2))
+			continue;
+
+		// Keyword takes next line
+		if (fgets(LineBuf, sizeof(LineBuf), ptrInFile) == NULL)
 		{
-			puts("Unsupported file extension ...");
+			LintReport(Lint, LINT_ERROR, "line %d: keyword without value at end of file", Line);
+			break;
 		}
+		Line++;
 	}
-	else
-	{
-		puts("Too many arguments ...");
-	}
+	fclose(ptrInFile);
 
-	//getch();
-	
-	return 1;
+	return PS2HL_OK;
 }
+
+} // namespace epc
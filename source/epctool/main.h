@@ -5,14 +5,14 @@
 // This file contains all definitions and declarations
 //
 
-#ifndef MAIN_H
-#define MAIN_H
+#ifndef EPCTOOL_MAIN_H
+#define EPCTOOL_MAIN_H
 
 ////////// Includes //////////
 #include <stdio.h>		// puts(), printf(), sscanf(), snprintf(), rename(), remove()
 #include <string.h>		// strcpy(), strcat(), strlen(), strtok(), strncpy(), memset()
 #include <malloc.h>		// malloc(), free()
-#include <stdlib.h>		// exit()
+#include <stdlib.h>		// exit() (front-end only)
 #include <math.h>		// round(), sqrt(), ceil()
 #include <ctype.h>		// tolower()
 
@@ -46,6 +46,18 @@ For more info check out readme.txt\n\
 
 ////////// Functions //////////
 #include "fops.h"
+#include "ps2hl.h"
+
+namespace epc
+{
+
+bool AddTerminator(char * Buffer, char Symbol);	// Replace specified symbol with null terminator
+bool FindSymbol(char * Buffer, char Symbol);	// Find symbol in string
+uint SetSubmodels(char * Buffer);				// Set up submodels flags
+bool SetBit(uint * Input, uchar Bit);			// Set bit in 4-byte variable
+int ValidateInputFile(const char * cFile);		// Validate input file
+int TranslateInputFile(const char * cFile);		// Translate input file
+int TranslateSourceFile(const char * cFile);	// Translate source file obtained from "YA PS2HL" mod
 
 ////////// Structures //////////
 
@@ -74,7 +86,7 @@ struct sPrecacheList
 		// Check if list is full
 		if (ListSz == MAX_ITEMS)
 		{
-			printf("%d item(s) limit overflow!\n", MAX_ITEMS);
+			LibMsg(MSG_ERROR, "%d item(s) limit overflow!\n", MAX_ITEMS);
 			return false;
 		}
 
@@ -83,7 +95,9 @@ struct sPrecacheList
 
 		// Allocate memory
 		ushort Size = Len + 1;
-		char * NewItem = (char *) malloc(Size);
+		char * NewItem = (char *) LibAlloc(Size);
+		if (NewItem == NULL)
+			return false;
 		strcpy(NewItem, Item);
 
 		// Add item to the list
@@ -119,7 +133,7 @@ struct sPrecacheList
 		// Check if list is full
 		if (ListSz == MAX_ITEMS)
 		{
-			printf("%d item(s) limit overflow!\n", MAX_ITEMS);
+			LibMsg(MSG_ERROR, "%d item(s) limit overflow!\n", MAX_ITEMS);
 			return -1;
 		}
 
@@ -128,7 +142,9 @@ struct sPrecacheList
 
 		// Allocate memory
 		ushort Size = Len + 1;
-		char * NewItem = (char *)malloc(Size);
+		char * NewItem = (char *)LibAlloc(Size);
+		if (NewItem == NULL)
+			return -1;
 		strcpy(NewItem, Item);
 
 		// Add item to the list
@@ -146,7 +162,7 @@ struct sPrecacheList
 	{
 		// Free memory
 		for (uchar i = 0; i < ListSz; i++)
-			free(List[i]);
+			LibFree(List[i]);
 
 		// Fill this structure with 0x00
 		memset(this, 0x00, sizeof(*this));
@@ -244,7 +260,6 @@ struct sModelSeq
 };
 
 // List of source file pecache items
-extern bool SetBit(uint * Input, uchar Bit);
 #pragma pack(1)				// Fix unwanted 0x00 bytes in structure
 class cSourceList : public sPrecacheList
 {
@@ -254,6 +269,7 @@ public:
 	sModelSeq * SeqTabArr[MAX_ITEMS];		// Array of sequence tables
 	ulong SeqTabItems[MAX_ITEMS];			// Array of item counts for sequence tables
 	int Types [MAX_ITEMS];					// Model types
+	int Error;								// Status of last model read (PS2HL_OK or error code)
 
 
 
@@ -266,11 +282,11 @@ public:
 	// Deinit
 	void Clear()
 	{
-		sPrecacheList::Clear();
-
-		// Clean sequence tables
+		// Clean sequence tables (before base class resets list size)
 		for (int sq = 0; sq < ListSz; sq++)
-			free(SeqTabArr[sq]);
+			LibFree(SeqTabArr[sq]);
+
+		sPrecacheList::Clear();
 
 		memset(this, 0xFF, sizeof(*this));
 	}
@@ -281,8 +297,8 @@ public:
 		short MapIndex = Find(MapName);
 		if (MapIndex == -1)
 		{
-			printf("Oops, unexpexted error: can't find map %s\n", MapName);
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Oops, unexpexted error: can't find map %s\n", MapName);
+			return false;
 		}
 
 		//if (Submodel)
@@ -291,11 +307,15 @@ public:
 		return false;
 	}
 
-	// Find or add item
+	// Find or add item (on fatal error returns -1 and sets Error)
 	short FindOrAdd(const char * Item, bool ItemIsMap, char * ModelDir, char * ModelDir2)
 	{
 		short Index = sPrecacheList::FindOrAdd(Item, ItemIsMap);
 
+		Error = PS2HL_OK;
+		if (Index == -1)
+			return -1;
+
 		if (!IsMap[Index] && SeqTabArr[Index] == NULL)
 		{
 			// Read sequence table from model file
@@ -304,22 +324,22 @@ public:
 			sModelSeq * SeqTable;		// Sequences table
 			ulong SeqTableSz;			// Sequences table size
 
-			FILE * ptrInFile;
+			FILE * ptrInFile = NULL;
 			char FileName[PATH_LEN];
 			char FullName[PATH_LEN];
 
-			// Try to open input file in primary directory
+			// Try to open input file in primary directory (FileProbe(), misses are expected here)
 			FileGetName(List[Index], FileName, sizeof(FileName), false);
 			strcat(FileName, ".dol");		// Try .dol
 			strcpy(FullName, ModelDir);
 			strcat(FullName, FileName);
-			SafeFileOpen(&ptrInFile, FullName, "rb");
+			ptrInFile = FileProbe(FullName, "rb");
 			if (ptrInFile == NULL)
 			{
 				strcpy(FileName, FullName);
 				FileGetFullName(FileName, FullName, sizeof(FullName));
 				strcat(FullName, ".mdl");	// Try .mdl
-				SafeFileOpen(&ptrInFile, FullName, "rb");
+				ptrInFile = FileProbe(FullName, "rb");
 			}
 
 			// Try to open input file in secondary directory
@@ -330,28 +350,31 @@ public:
 				strcat(FileName, ".dol");		// Try .dol
 				strcpy(FullName, ModelDir2);
 				strcat(FullName, FileName);
-				SafeFileOpen(&ptrInFile, FullName, "rb");
+				ptrInFile = FileProbe(FullName, "rb");
 				if (ptrInFile == NULL)
 				{
 					strcpy(FileName, FullName);
 					FileGetFullName(FileName, FullName, sizeof(FullName));
 					strcat(FullName, ".mdl");	// Try .mdl
-					SafeFileOpen(&ptrInFile, FullName, "rb");
+					ptrInFile = FileProbe(FullName, "rb");
 				}
 			}
 
-			// Can't find file - exit
+			// Can't find file - stop
 			if (ptrInFile == NULL)
 			{
-				printf("Error: can't open file: %s \n", List[Index]);
 				if (!strcmp(ModelDir, ".") || !strcmp(ModelDir2, "."))
 				{
-					puts("You can specify model directories by adding those lines to .ini file:");
-					printf("\n%s:\nYOUR_MOD_DIR\\models\n\n%s:\nYOUR_VALVE_DIR\\models\n\n", KWD_DIR, KWD_DIR2);
+					LibMsg(MSG_ERROR, "Error: can't open file: %s \n", List[Index]);
+					LibMsg(MSG_ERROR, "You can specify model directories by adding those lines to .ini file:\n");
+					LibMsg(MSG_ERROR | MSG_CONFIRM, "\n%s:\nYOUR_MOD_DIR\\models\n\n%s:\nYOUR_VALVE_DIR\\models\n\n", KWD_DIR, KWD_DIR2);
 				}
-				puts("Press any key to exit ...");
-				getchar();
-				exit(EXIT_FAILURE);
+				else
+				{
+					LibMsg(MSG_ERROR | MSG_CONFIRM, "Error: can't open file: %s \n", List[Index]);
+				}
+				Error = PS2HL_ERR_OPEN;
+				return -1;
 			}
 
 			// Load model header
@@ -361,17 +384,26 @@ public:
 			Types[Index] = ModelHeader.CheckModel();
 			if (Types[Index] == NORMAL_MODEL || Types[Index] == NOTEXTURES_MODEL)
 			{
-				printf("Reading sequences from %s \nInternal name: %s \nSequences: %i \n", FullName, ModelHeader.Name, ModelHeader.SeqCount);
+				LibMsg(MSG_INFO, "Reading sequences from %s \nInternal name: %s \nSequences: %i \n", FullName, ModelHeader.Name, ModelHeader.SeqCount);
 			}
 			else
 			{
-				puts("Bad model file");
-				exit(EXIT_FAILURE);
+				LibMsg(MSG_ERROR, "Bad model file\n");
+				fclose(ptrInFile);
+				Error = PS2HL_ERR_FORMAT;
+				return -1;
 			}
 
 			// Allocate memory for sequence table
 			SeqTableSz = sizeof(sModelSeq) * ModelHeader.SeqCount;
-			SeqTable = (sModelSeq *)malloc(SeqTableSz);
+			SeqTable = (sModelSeq *)LibAlloc(SeqTableSz);
+			if (SeqTable == NULL)
+			{
+				LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+				fclose(ptrInFile);
+				Error = PS2HL_ERR_MEMORY;
+				return -1;
+			}
 			SeqTabArr[Index] = SeqTable;
 			SeqTabItems[Index] = ModelHeader.SeqCount;
 
@@ -392,7 +424,7 @@ public:
 		
 		if (!SeqTab)
 		{
-			printf("Error: uninitialized sequence table in model \"%s\" \n", List[ModelIndex]);
+			LibMsg(MSG_ERROR, "Error: uninitialized sequence table in model \"%s\" \n", List[ModelIndex]);
 			return -1;
 		}
 
@@ -407,7 +439,7 @@ public:
 		}
 
 		if (Result == SEQ_FAIL)
-			printf("Warning: can't find sequence \"%s\" in \"%s\" \n", SeqName, List[ModelIndex]);
+			LibMsg(MSG_WARN, "Warning: can't find sequence \"%s\" in \"%s\" \n", SeqName, List[ModelIndex]);
 
 		return Result;
 	}
@@ -489,4 +521,6 @@ struct sPS2HL_EPCModelEntry
 };
 */
 
-#endif // MAIN_H
+} // namespace epc
+
+#endif // EPCTOOL_MAIN_H
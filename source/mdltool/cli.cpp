@@ -0,0 +1,135 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains command line front-end of model tool
+//
+
+////////// Includes //////////
+#include "util.h"
+#include "main.h"
+#include "perf.h"
+#include "log.h"
+#include "cache.h"
+
+using namespace mdl;
+
+int main(int argc, char * argv[])
+{
+	char cFileExtension[5];
+	int Result = PS2HL_OK;
+
+	// Output info
+	argc = PerfParseArgs(argc, argv);	// --stats, --trace <file>
+	argc = LogParseArgs(argc, argv, false);	// -q, -v, --log-format=jsonl
+	argc = CacheParseArgs(argc, argv);	// --cache <dir>, --cache-size <MiB>, --cache-link
+	LibSetInteractive(true);
+	LibMsg(MSG_INFO, "%s\n", PROG_TITLE);
+
+	// Cached conversion goes through job dispatch ("mdltool (command) file")
+	if (CacheEnabled() == true && (argc == 2 || argc == 3))
+		return (JobRun("mdl", (argc == 3) ? argv[1] : JOB_CMD_AUTO, argv[argc - 1]) == PS2HL_OK) ? 0 : 1;
+
+	// Check arguments
+	if (argc == 1)
+	{
+		// No arguments - show help screen
+		puts(PROG_INFO);
+		UTIL_WAIT_KEY("Press any key to exit ...");
+	}
+	else if (argc == 2)		// Convert model
+	{
+		FileGetExtension(argv[1], cFileExtension, 5);
+
+		LibMsg(MSG_INFO, "\nProcessing file: %s\n", argv[1]);
+
+		if (!strcmp(".mdl", cFileExtension))
+		{
+			if (CheckModel(argv[1]) == NORMAL_MODEL)
+			{
+				Result = ConvertMDLToDOL(argv[1]);
+			}
+			else if (CheckModel(argv[1]) == SEQ_MODEL || CheckModel(argv[1]) == NOTEXTURES_MODEL)
+			{
+				Result = ConvertSubmodel(argv[1], ".mdl", ".dol");
+			}
+			else if (CheckModel(argv[1]) == DUMMY_MODEL)
+			{
+				// Patch dummy model's extension and internal name
+				Result = ConvertDummySubmodel(argv[1], ".mdl", ".dol");
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Can't recognise model file ...\n");
+			}
+		}
+		else if (!strcmp(".dol", cFileExtension))
+		{
+			if (CheckModel(argv[1]) == NORMAL_MODEL)
+			{
+				Result = ConvertDOLToMDL(argv[1]);
+			}
+			else if (CheckModel(argv[1]) == SEQ_MODEL || CheckModel(argv[1]) == NOTEXTURES_MODEL)
+			{
+				Result = ConvertSubmodel(argv[1], ".dol", ".mdl");
+			}
+			else if (CheckModel(argv[1]) == DUMMY_MODEL)
+			{
+				// Patch dummy model's extension and internal name
+				Result = ConvertDummySubmodel(argv[1], ".dol", ".mdl");
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Can't recognise model file ...\n");
+			}
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Wrong file extension.\n");
+		}
+	}
+	else if (argc == 3 && !strcmp(argv[1], "extract") == true)		// Extract textures from model
+	{
+		FileGetExtension(argv[2], cFileExtension, 5);
+
+		LibMsg(MSG_INFO, "\nProcessing file: %s\n", argv[2]);
+
+		if (!strcmp(".mdl", cFileExtension))
+		{
+			if (CheckModel(argv[2]) == NORMAL_MODEL)
+				Result = ExtractMDLTextures(argv[2]);
+			else
+				LibMsg(MSG_ERROR, "Can't find texture data ...\n");
+		}
+		else if (!strcmp(".dol", cFileExtension))
+		{
+			if (CheckModel(argv[2]) == NORMAL_MODEL)
+				Result = ExtractDOLTextures(argv[2]);
+			else
+				LibMsg(MSG_ERROR, "Can't find texture data ...\n");
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Wrong file extension.\n");
+		}
+	}
+	else if (argc == 3 && !strcmp(argv[1], "seqrep") == true)		// Report sequences
+	{
+		FileGetExtension(argv[2], cFileExtension, 5);
+
+		LibMsg(MSG_INFO, "\nProcessing file: %s\n", argv[2]);
+
+		if (!strcmp(".mdl", cFileExtension) || !strcmp(".dol", cFileExtension))
+			Result = SeqReport(argv[2]);
+		else
+			LibMsg(MSG_ERROR, "Wrong file extension.\n");
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Can't recognise arguments.\n");
+	}
+
+	//getchar();
+	
+	return (Result == PS2HL_OK) ? 0 : 1;
+}
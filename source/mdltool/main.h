@@ -5,14 +5,14 @@
 // This file contains all definitions and declarations
 //
 
-#ifndef MAIN_H
-#define MAIN_H
+#ifndef MDLTOOL_MAIN_H
+#define MDLTOOL_MAIN_H
 
 ////////// Includes //////////
 #include <stdio.h>		// puts(), printf(), sscanf(), snprintf()
 #include <string.h>		// strcpy(), strcat(), strlen(), strtok(), strncpy()
 #include <malloc.h>		// malloc(), free()
-#include <stdlib.h>		// exit()
+#include <stdlib.h>		// exit() (front-end only)
 #include <math.h>		// round()
 #include <ctype.h>		// tolower()
 
@@ -46,6 +46,7 @@ For more info check out readme.txt\n\
 #define MDL_DEF_REF_SZ 0x68
 #define MDL_FILE_REF_SZ 0x48
 #define MDL_FILE_REF_SPACE 0x20
+#define MDL_GEN_DATA_SIZE 0x40		// Corpus models: bytes between header and sequence table
 
 // Keywords
 #define KWD_FADESTART "fadestart"
@@ -61,6 +62,11 @@ For more info check out readme.txt\n\
 
 ////////// Functions //////////
 #include "fops.h"
+#include "ps2hl.h"
+#include "perf.h"
+
+namespace mdl
+{
 
 ////////// Structures //////////
 
@@ -272,19 +278,27 @@ struct sTexture
 		this->Bitmap = NULL;
 	}
 
-	void UpdateFromFile(FILE ** ptrFile, ulong FileBitmapOffset, ulong FileBitmapSize, ulong FilePaletteOffset, ulong FilePaletteSize, const char * NewName, ulong NewWidth, ulong NewHeight)	// Update from file
+	void Deinit()				// Free palette and bitmap
+	{
+		LibFree(this->Palette);
+		LibFree(this->Bitmap);
+		this->Palette = NULL;
+		this->Bitmap = NULL;
+	}
+
+	bool UpdateFromFile(FILE ** ptrFile, ulong FileBitmapOffset, ulong FileBitmapSize, ulong FilePaletteOffset, ulong FilePaletteSize, const char * NewName, ulong NewWidth, ulong NewHeight)	// Update from file
 	{
 		// Destroy old palette and bitmap
-		free(Palette);
-		free(Bitmap);
+		Deinit();
 
 		// Allocate memory for new ones
-		Palette = (uchar *) malloc(FilePaletteSize);
-		Bitmap = (uchar *) malloc(FileBitmapSize);
+		Palette = (uchar *) LibAlloc(FilePaletteSize);
+		Bitmap = (uchar *) LibAlloc(FileBitmapSize);
 		if (Palette == NULL || Bitmap == NULL)
 		{
-			UTIL_WAIT_KEY("Unable to allocate memory ...");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			Deinit();
+			return false;
 		}
 
 		// Copy data from file to memory
@@ -296,6 +310,8 @@ struct sTexture
 		this->Width = NewWidth;
 		this->Height = NewHeight;
 		this->PaletteSize = FilePaletteSize;
+
+		return true;
 	}
 
 	/*void Rename(const char * NewName)
@@ -314,16 +330,16 @@ struct sTexture
 		this->Height = NewHeight;
 	}*/
 
-	void ScaleResize(ulong NewWidth, ulong NewHeight)			// Resize bitmap. Used for MDL to DOL conversion.
+	bool ScaleResize(ulong NewWidth, ulong NewHeight)			// Resize bitmap. Used for MDL to DOL conversion.
 	{
 		char * NewBitmap;
 
 		// Allocate memory for new bitmap
-		NewBitmap = (char *) malloc(NewWidth * NewHeight);	
+		NewBitmap = (char *) LibAlloc(NewWidth * NewHeight);	
 		if (NewBitmap == NULL)
 		{
-			UTIL_WAIT_KEY("Unable to allocate memory ...");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			return false;
 		}
 
 		// Copy resized old bitmap to new one
@@ -338,7 +354,7 @@ struct sTexture
 
 		
 		// Destroy old bitmap
-		free(this->Bitmap);
+		LibFree(this->Bitmap);
 
 		// Save pointer to new bitmap
 		this->Bitmap = (uchar *) NewBitmap;
@@ -346,18 +362,20 @@ struct sTexture
 		// Update bitmap size
 		this->Width = NewWidth;
 		this->Height = NewHeight;
+
+		return true;
 	}
 
-	void TileResize(ulong NewWidth, ulong NewHeight)			// Resize bitmap by tiling old in new one. Used for MDL to DOL conversion.
+	bool TileResize(ulong NewWidth, ulong NewHeight)			// Resize bitmap by tiling old in new one. Used for MDL to DOL conversion.
 	{
 		char * NewBitmap;
 
 		// Allocate memory for new bitmap
-		NewBitmap = (char *)malloc(NewWidth * NewHeight);
+		NewBitmap = (char *)LibAlloc(NewWidth * NewHeight);
 		if (NewBitmap == NULL)
 		{
-			UTIL_WAIT_KEY("Unable to allocate memory ...");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			return false;
 		}
 
 		// Tile new bitmap with old one
@@ -386,7 +404,7 @@ struct sTexture
 
 
 		// Destroy old bitmap
-		free(this->Bitmap);
+		LibFree(this->Bitmap);
 
 		// Save pointer to new bitmap
 		this->Bitmap = (uchar *)NewBitmap;
@@ -394,18 +412,20 @@ struct sTexture
 		// Update bitmap size
 		this->Width = NewWidth;
 		this->Height = NewHeight;
+
+		return true;
 	}
 
-	void FlipBitmap()		// Flip bitmap vertically. Needed for DOL\MDL to BMP conversion and vice versa.
+	bool FlipBitmap()		// Flip bitmap vertically. Needed for DOL\MDL to BMP conversion and vice versa.
 	{
 		char * NewBitmap;
 
 		// Allocate memory for new bitmap
-		NewBitmap = (char *)malloc(this->Width * this->Height);
+		NewBitmap = (char *)LibAlloc(this->Width * this->Height);
 		if (NewBitmap == NULL)
 		{
-			UTIL_WAIT_KEY("Unable to allocate memory ...");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			return false;
 		}
 
 		// Copy flipped bitmap to new place
@@ -414,10 +434,12 @@ struct sTexture
 				NewBitmap[(this->Width * y) + x] = this->Bitmap[(this->Width * ((this->Height - 1) - y)) + x];
 
 		// Destroy old bitmap
-		free(this->Bitmap);
+		LibFree(this->Bitmap);
 
 		// Save pointer to new bitmap
 		this->Bitmap = (uchar *) NewBitmap;
+
+		return true;
 	}
 
 	void PaletteReformat(uint PaletteElementSize)			// Reposition color table elements. Used for DOL to MDL and MDL to DOL conversions.
@@ -463,19 +485,21 @@ struct sTexture
 		}
 	}*/
 
-	void PaletteRemoveSpacers()	// Convert palette to MDL format
+	bool PaletteRemoveSpacers()	// Convert palette to MDL format
 	{
+		PERF_SCOPE(PERF_PH_PALETTE);
+
 		char * NewPalette;
 		ulong NewPaletteSize = EIGHT_BIT_PALETTE_ELEMENTS_COUNT * MDL_PALETTE_ELEMENT_SIZE;
 
 		if (this->PaletteSize == EIGHT_BIT_PALETTE_ELEMENTS_COUNT * DOL_BMP_PALETTE_ELEMENT_SIZE)
 		{
 			// Allocate memory for new palette
-			NewPalette = (char *)malloc(NewPaletteSize);
+			NewPalette = (char *)LibAlloc(NewPaletteSize);
 			if (NewPalette == NULL)
 			{
-				UTIL_WAIT_KEY("Unable to allocate memory ...");
-				exit(EXIT_FAILURE);
+				LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+				return false;
 			}
 
 			// Copy palette without spacers to new place
@@ -491,7 +515,7 @@ struct sTexture
 			}
 
 			// Destroy old palette
-			free(this->Palette);
+			LibFree(this->Palette);
 
 			// Save pointer to new palette
 			this->Palette = (uchar *) NewPalette;
@@ -499,21 +523,25 @@ struct sTexture
 			// Update size
 			this->PaletteSize = NewPaletteSize;
 		}
+
+		return true;
 	}
 
-	void PaletteAddSpacers(char Spacer)		// Convert palette to DOL\BMP format
+	bool PaletteAddSpacers(char Spacer)		// Convert palette to DOL\BMP format
 	{
+		PERF_SCOPE(PERF_PH_PALETTE);
+
 		char * NewPalette;
 		ulong NewPaletteSize = EIGHT_BIT_PALETTE_ELEMENTS_COUNT * DOL_BMP_PALETTE_ELEMENT_SIZE;
 
 		if (this->PaletteSize == EIGHT_BIT_PALETTE_ELEMENTS_COUNT * MDL_PALETTE_ELEMENT_SIZE)
 		{
 			// Allocate memory for new palette
-			NewPalette = (char *)malloc(NewPaletteSize);
+			NewPalette = (char *)LibAlloc(NewPaletteSize);
 			if (NewPalette == NULL)
 			{
-				UTIL_WAIT_KEY("Unable to allocate memory ...");
-				exit(EXIT_FAILURE);
+				LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+				return false;
 			}
 
 			// Copy palette with spacers to new place
@@ -533,7 +561,7 @@ struct sTexture
 			}
 
 			// Destroy old palette
-			free(this->Palette);
+			LibFree(this->Palette);
 
 			// Save pointer to new palette
 			this->Palette = (uchar *) NewPalette;
@@ -541,6 +569,8 @@ struct sTexture
 			// Update size
 			this->PaletteSize = NewPaletteSize;
 		}
+
+		return true;
 	}
 
 	void PaletteSwapRedAndGreen(int ElementSize)		// Needed for MDL/DOL to BMP conversion and vice versa.
@@ -556,4 +586,26 @@ struct sTexture
 	}
 };
 
-#endif // MAIN_H
+////////// Model functions //////////
+uint PSIProperSize(uint Size, bool ToLower);																		// Calculate nearest appropriate size of PS2 DOL texture
+int ExtractDOLTextures(const char * FileName);																		// Extract textures from PS2 model
+int ExtractMDLTextures(const char * FileName);																		// Extract textures from PC model
+int ConvertMDLToDOL(const char * FileName);																		// Convert model from PC to PS2 format
+int ConvertDOLToMDL(const char * FileName);																		// Convert model from PS2 to PC format
+int ConvertSubmodel(const char * FileName, const char * OriginalExtension, const char * TargetExtension);				// Convert submodel
+int ConvertDummySubmodel(const char * FileName, const char * OriginalExtension, const char * TargetExtension);		// Convert submodel which consists of signature and name only
+int GetExtraDOLData(const char * FileName);																		// Extract extra data from DOL model
+bool AddTerminator(char * Buffer, char Symbol);																		// Helper for CheckExtraFile()
+ushort CountSymbols(char * Buffer, char Symbol);																	// Counts symbols in line
+bool CheckExtraFile(const char * FileName);																			// Check if extra *.INF file is valid
+void GetValues(char * Buffer, ulong * Values, uchar ValuesCount);													// Helper for TranslateExtraFile()
+int TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect, sDOLLODEntry ** LODTable);			// Fetch data from extra *.INF file
+void PatchSubmodelRef(sModelHeader * MdlHdr, char * ModelData, ulong ModelDataSize, const char * NewExtension);		// Patch internal submodel references
+int CheckModel(const char * FileName);																				// Check model type
+void PatchDOLExtraSection(char * ModelData, ulong ModelDataSize, ulong LODDataOffseet, uchar MaxBodyParts, uchar NumBodyGroups, ulong FadeStart, ulong FadeEnd);
+		// Write extra data to DOL model file (this is needed to allow correct body part part switching and to stop crashing on PS2).
+int SeqReport(const char * FileName);																				// Sequence report
+
+} // namespace mdl
+
+#endif // MDLTOOL_MAIN_H
@@ -8,30 +8,14 @@
 ////////// Includes //////////
 #include "util.h"
 #include "main.h"
+#include "jobs.h"
+#include "lint.h"
+#include "catalog.h"
+#include "corpus.h"
+#include "bench.h"
 
-////////// Global variables //////////
-
-
-////////// Functions //////////
-uint PSIProperSize(uint Size, bool ToLower);																		// Calculate nearest appropriate size of PS2 DOL texture
-void ExtractDOLTextures(const char * FileName);																		// Extract textures from PS2 model
-void ExtractMDLTextures(const char * FileName);																		// Extract textures from PC model
-void ConvertMDLToDOL(const char * FileName);																		// Convert model from PC to PS2 format
-void ConvertDOLToMDL(const char * FileName);																		// Convert model from PS2 to PC format
-void ConvertSubmodel(const char * FileName, char * OriginalExtension, char * TargetExtension);						// Convert submodel
-void ConvertDummySubmodel(const char * FileName, char * OriginalExtension, char * TargetExtension);					// Convert submodel which consists of signature and name only
-void GetExtraDOLData(const char * FileName);																		// Extract extra data from DOL model
-bool AddTerminator(char * Buffer, char Symbol);																		// Helper for CheckExtraFile()
-ushort CountSymbols(char * Buffer, char Symbol);																	// Counts symbols in line
-bool CheckExtraFile(const char * FileName);																			// Check if extra *.INF file is valid
-void GetValues(char * Buffer, ulong * Values, uchar ValuesCount);													// Helper for TranslateExtraFile()
-bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect, sDOLLODEntry ** LODTable);			// Fetch data from extra *.INF file
-void PatchSubmodelRef(sModelHeader * MdlHdr, char * ModelData, ulong ModelDataSize, char * NewExtension);			// Patch internal submodel references
-int CheckModel(const char * FileName);																				// Check model type
-void PatchDOLExtraSection(char * ModelData, ulong ModelDataSize, ulong LODDataOffseet, uchar MaxBodyParts, uchar NumBodyGroups, ulong FadeStart, ulong FadeEnd);
-		// Write extra data to DOL model file (this is needed to allow correct body part part switching and to stop crashing on PS2).
-void SeqReport(const char * FileName);																				// Sequence report
-
+namespace mdl
+{
 
 // Write extra data to DOL model file (this is needed to allow correct body part switching and to stop crashing on PS2)
 void PatchDOLExtraSection(char * ModelData, ulong ModelDataSize, ulong LODDataOffseet, uchar MaxBodyParts, uchar NumBodyGroups, ulong FadeStart, ulong FadeEnd)
@@ -67,7 +51,8 @@ int CheckModel(const char * FileName)	// Check model type
 	int ModelType;
 
 	// Open model file
-	SafeFileOpen(&ptrModelFile, FileName, "rb");
+	if (FileOpen(&ptrModelFile, FileName, "rb") == false)
+		return UNKNOWN_MODEL;
 
 	// Check for dummy model (Signature, Name and FileSize only)
 	if (FileSize(&ptrModelFile) < sizeof(sModelHeader))
@@ -88,7 +73,20 @@ int CheckModel(const char * FileName)	// Check model type
 	return ModelType;
 }
 
-void ConvertDOLToMDL(const char * FileName)		// Convert model from PS2 to PC format 
+static int CloseModel(FILE * ptrInFile, sModelTextureEntry * ModelTextureTable, sTexture * Textures, int TextureCount, int Result)	// Free texture data and close input model, returns Result
+{
+	if (Textures != NULL)
+		for (int i = 0; i < TextureCount; i++)
+			Textures[i].Deinit();
+
+	LibFree(Textures);
+	LibFree(ModelTextureTable);
+	fclose(ptrInFile);
+
+	return Result;
+}
+
+int ConvertDOLToMDL(const char * FileName)		// Convert model from PS2 to PC format
 {
 	sModelHeader ModelHeader;					// Model file header
 	sModelTextureEntry * ModelTextureTable;		// Model texture table
@@ -101,9 +99,11 @@ void ConvertDOLToMDL(const char * FileName)		// Convert model from PS2 to PC for
 	char cOutFileName[PATH_LEN];
 
 	ulong ModelSize;
+	int Result;
 
 	// Open file
-	SafeFileOpen(&ptrInFile, FileName, "rb");
+	if (FileOpen(&ptrInFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Get header from file
 	ModelHeader.UpdateFromFile(&ptrInFile);
@@ -111,22 +111,35 @@ void ConvertDOLToMDL(const char * FileName)		// Convert model from PS2 to PC for
 	// Check model
 	if (ModelHeader.CheckModel() == NORMAL_MODEL)
 	{
-		printf("Internal name: %s \nTextures: %i, Texture table offset: 0x%X \n", ModelHeader.Name, ModelHeader.TextureCount, ModelHeader.TextureTableOffset);
+		LibMsg(MSG_INFO, "Internal name: %s \nTextures: %i, Texture table offset: 0x%X \n", ModelHeader.Name, ModelHeader.TextureCount, ModelHeader.TextureTableOffset);
 	}
 	else
 	{
-		puts("Incorrect model file.");
-		return;
+		LibMsg(MSG_ERROR, "Incorrect model file.\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Save extra *.DOL data to *.INF file
 	if (ModelHeader.TextureTableOffset - sizeof(sModelHeader) > sizeof(sDOLExtraSection))	// Do not extract data from texture submodels
-		GetExtraDOLData(FileName);
+	{
+		Result = GetExtraDOLData(FileName);
+		if (Result != PS2HL_OK)
+		{
+			fclose(ptrInFile);
+			return Result;
+		}
+	}
 
 	// Allocate memory for textures
 	ModelTextureTableSize = ModelHeader.TextureCount * sizeof(sModelTextureEntry);
-	ModelTextureTable = (sModelTextureEntry *)malloc(ModelTextureTableSize);
-	Textures = (sTexture *)malloc(sizeof(sTexture) * ModelHeader.TextureCount);
+	ModelTextureTable = (sModelTextureEntry *)LibAlloc(ModelTextureTableSize);
+	Textures = (sTexture *)LibCalloc(ModelHeader.TextureCount, sizeof(sTexture));
+	if (ModelTextureTable == NULL || Textures == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return CloseModel(ptrInFile, ModelTextureTable, Textures, 0, PS2HL_ERR_MEMORY);
+	}
 
 	// Load and convert textures
 	uint BitmapOffset;
@@ -145,18 +158,21 @@ void ConvertDOLToMDL(const char * FileName)		// Convert model from PS2 to PC for
 
 		// Load texture
 		Textures[i].Initialize();
-		Textures[i].UpdateFromFile(&ptrInFile, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height);
-		
+		if (Textures[i].UpdateFromFile(&ptrInFile, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height) == false)
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
+
 		// Convert texture
 		Textures[i].PaletteReformat(DOL_BMP_PALETTE_ELEMENT_SIZE);
-		Textures[i].PaletteRemoveSpacers();
+		if (Textures[i].PaletteRemoveSpacers() == false)
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
 	}
 
 	// Write results to output file
 	// Open output file
 	FileGetFullName(FileName, cOutFileName, sizeof(cOutFileName));
 	strcat(cOutFileName, ".mdl");
-	SafeFileOpen(&ptrOutFile, cOutFileName, "wb");
+	if (FileOpen(&ptrOutFile, cOutFileName, "wb") == false)
+		return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, PS2HL_ERR_OPEN);
 
 	// Write modified header
 	FileGetName(cOutFileName, cNewModelName, sizeof(cNewModelName), false);
@@ -167,12 +183,18 @@ void ConvertDOLToMDL(const char * FileName)		// Convert model from PS2 to PC for
 
 	// Write patched model data
 	uchar * ModelData;
-	ModelData = (uchar *)malloc(ModelHeader.TextureTableOffset - sizeof(sModelHeader));
+	ModelData = (uchar *)LibAlloc(ModelHeader.TextureTableOffset - sizeof(sModelHeader));
+	if (ModelData == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrOutFile);
+		return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, PS2HL_ERR_MEMORY);
+	}
 	FileReadBlock(&ptrInFile, (char *)ModelData, sizeof(sModelHeader), ModelHeader.TextureTableOffset - sizeof(sModelHeader));
 	PatchDOLExtraSection((char *)ModelData, ModelHeader.TextureTableOffset - sizeof(sModelHeader), 0x00504453, 0, 0, 0, 0);		// Clear extra field
 	PatchSubmodelRef(&ModelHeader, (char *)ModelData, ModelHeader.TextureTableOffset - sizeof(sModelHeader), ".mdl");			// Patch internal submodel references
 	FileWriteBlock(&ptrOutFile, (char *)ModelData, ModelHeader.TextureTableOffset - sizeof(sModelHeader));
-	free(ModelData);
+	LibFree(ModelData);
 
 	// Write modified texture table
 	uint Offset = ModelHeader.TextureTableOffset + sizeof(sModelTextureEntry) * ModelHeader.TextureCount + ModelHeader.SkinCount * ModelHeader.SkinEntrySize * 2;
@@ -189,41 +211,46 @@ void ConvertDOLToMDL(const char * FileName)		// Convert model from PS2 to PC for
 	// Write skin data
 	uchar * SkinTable;
 	ulong SkinTableSize = ModelHeader.SkinCount * ModelHeader.SkinEntrySize * 2;
-	SkinTable = (uchar *)malloc(SkinTableSize);
+	SkinTable = (uchar *)LibAlloc(SkinTableSize);
+	if (SkinTable == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrOutFile);
+		return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, PS2HL_ERR_MEMORY);
+	}
 	FileReadBlock(&ptrInFile, SkinTable, ModelHeader.SkinTableOffset, SkinTableSize);
 	FileWriteBlock(&ptrOutFile, SkinTable, SkinTableSize);
-	free(SkinTable);
+	LibFree(SkinTable);
 
 	// Write textures
 	for (int i = 0; i < ModelHeader.TextureCount; i++)
 	{
-		FileWriteBlock(&ptrOutFile, (char *)Textures[i].Bitmap, Textures[i].Width * Textures[i].Height);		
+		FileWriteBlock(&ptrOutFile, (char *)Textures[i].Bitmap, Textures[i].Width * Textures[i].Height);
 		FileWriteBlock(&ptrOutFile, (char *)Textures[i].Palette, Textures[i].PaletteSize);
+		LibProgress(i + 1, ModelHeader.TextureCount);
 	}
 
 	// Update model size field
 	ModelSize = FileSize(&ptrOutFile);
 	FileWriteBlock(&ptrOutFile, &ModelSize, 0x48, sizeof(ModelSize));	// 0x48 - address of model size field
 
-	// Free memory
-	free(ModelTextureTable);
-	free(Textures);
-	
-	// Close files
-	fclose(ptrInFile);
+	// Close output file
 	fclose(ptrOutFile);
 
-	puts("Done!\n\n");
+	LibMsg(MSG_INFO, "Done!\n\n\n");
+
+	// Free memory and close input file
+	return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, PS2HL_OK);
 }
 
-void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 format 
+int ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 format
 {
 	sModelHeader ModelHeader;					// Model file header
 	sModelTextureEntry * ModelTextureTable;		// Model texture table
 	ulong ModelTextureTableSize;				// Model texture table size (how many textures)
 	sDOLTextureHeader DOLTextureHeader;			// DOL Texture Header
 	sTexture * Textures;						// Pointer to textures data
-	
+
 	FILE * ptrInFile;
 	FILE * ptrOutFile;
 	char cOutFileName[PATH_LEN];
@@ -231,9 +258,11 @@ void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 form
 	char cTextureName[64];
 
 	ulong ModelSize;
+	int Result;
 
 	// Open file
-	SafeFileOpen(&ptrInFile, FileName, "rb");
+	if (FileOpen(&ptrInFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Get header from file
 	ModelHeader.UpdateFromFile(&ptrInFile);
@@ -241,18 +270,24 @@ void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 form
 	// Check model
 	if (ModelHeader.CheckModel() == NORMAL_MODEL)
 	{
-		printf("Internal name: %s \nTextures: %i, Texture table offset: 0x%X \n", ModelHeader.Name, ModelHeader.TextureCount, ModelHeader.TextureTableOffset);
+		LibMsg(MSG_INFO, "Internal name: %s \nTextures: %i, Texture table offset: 0x%X \n", ModelHeader.Name, ModelHeader.TextureCount, ModelHeader.TextureTableOffset);
 	}
 	else
 	{
-		puts("Incorrect model file.");
-		return;
+		LibMsg(MSG_ERROR, "Incorrect model file.\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Allocate memory for texture tables
 	ModelTextureTableSize = ModelHeader.TextureCount * sizeof(sModelTextureEntry);
-	ModelTextureTable = (sModelTextureEntry *)malloc(ModelTextureTableSize);
-	Textures = (sTexture *)malloc(sizeof(sTexture) * ModelHeader.TextureCount);
+	ModelTextureTable = (sModelTextureEntry *)LibAlloc(ModelTextureTableSize);
+	Textures = (sTexture *)LibCalloc(ModelHeader.TextureCount, sizeof(sTexture));
+	if (ModelTextureTable == NULL || Textures == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return CloseModel(ptrInFile, ModelTextureTable, Textures, 0, PS2HL_ERR_MEMORY);
+	}
 
 	// Convert textures
 	uint BitmapOffset;
@@ -269,8 +304,8 @@ void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 form
 		FileGetExtension(ModelTextureTable[i].Name, TexExtension, sizeof(TexExtension));
 		if (!strcmp(TexExtension, ".pvr") == true)
 		{
-			UTIL_WAIT_KEY("Dreamcast model conversion is not suppotred ...");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR | MSG_CONFIRM, "Dreamcast model conversion is not suppotred ...\n");
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, i, PS2HL_ERR_FORMAT);
 		}
 
 		BitmapOffset = ModelTextureTable[i].Offset + MDL_TEXTURE_HEADER_SIZE;
@@ -280,21 +315,25 @@ void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 form
 
 		// Load texture
 		Textures[i].Initialize();
-		Textures[i].UpdateFromFile(&ptrInFile, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height);
-		
+		if (Textures[i].UpdateFromFile(&ptrInFile, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height) == false)
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
+
 		// Resize texture
-		Textures[i].TileResize(PSIProperSize(Textures[i].Width, false), PSIProperSize(Textures[i].Height, false));
-		
+		if (Textures[i].TileResize(PSIProperSize(Textures[i].Width, false), PSIProperSize(Textures[i].Height, false)) == false)
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
+
 		// Convert texture
 		Textures[i].PaletteReformat(MDL_PALETTE_ELEMENT_SIZE);
-		Textures[i].PaletteAddSpacers(0x80);
+		if (Textures[i].PaletteAddSpacers(0x80) == false)
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
 	}
 
 	// Write results to output file
 	// Open output file
 	FileGetFullName(FileName, cOutFileName, sizeof(cOutFileName));
 	strcat(cOutFileName, ".dol");
-	SafeFileOpen(&ptrOutFile, cOutFileName, "wb");
+	if (FileOpen(&ptrOutFile, cOutFileName, "wb") == false)
+		return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, PS2HL_ERR_OPEN);
 
 	// Write modified header
 	FileGetName(cOutFileName, cNewModelName, sizeof(cNewModelName), false);
@@ -306,12 +345,18 @@ void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 form
 
 	// Write patched model data
 	uchar * ModelData;
-	ModelData = (uchar *) malloc(ModelHeader.TextureTableOffset - sizeof(sModelHeader));
+	ModelData = (uchar *) LibAlloc(ModelHeader.TextureTableOffset - sizeof(sModelHeader));
+	if (ModelData == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrOutFile);
+		return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, PS2HL_ERR_MEMORY);
+	}
 	FileReadBlock(&ptrInFile, (char *) ModelData, sizeof(sModelHeader), ModelHeader.TextureTableOffset - sizeof(sModelHeader));
 	PatchDOLExtraSection((char *)ModelData, ModelHeader.TextureTableOffset - sizeof(sModelHeader), 0, 0, 0, 0, 0);			// Reset extra section to it's default state
 	PatchSubmodelRef(&ModelHeader, (char *)ModelData, ModelHeader.TextureTableOffset - sizeof(sModelHeader), ".dol");		// Patch internal submodel references
 	FileWriteBlock(&ptrOutFile, (char *) ModelData, ModelHeader.TextureTableOffset - sizeof(sModelHeader));
-	free(ModelData);
+	LibFree(ModelData);
 
 	// Write modified texture table
 	uint Offset = ModelHeader.TextureTableOffset + sizeof(sModelTextureEntry) * ModelHeader.TextureCount + ModelHeader.SkinCount * ModelHeader.SkinEntrySize * 2;
@@ -329,10 +374,16 @@ void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 form
 	// Write skin data
 	uchar * SkinTable;
 	ulong SkinTableSize = ModelHeader.SkinCount * ModelHeader.SkinEntrySize * 2;
-	SkinTable = (uchar *)malloc(SkinTableSize);
+	SkinTable = (uchar *)LibAlloc(SkinTableSize);
+	if (SkinTable == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrOutFile);
+		return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, PS2HL_ERR_MEMORY);
+	}
 	FileReadBlock(&ptrInFile, SkinTable, ModelHeader.SkinTableOffset, SkinTableSize);
 	FileWriteBlock(&ptrOutFile, SkinTable, SkinTableSize);
-	free(SkinTable);
+	LibFree(SkinTable);
 
 	// Write blank bytes to fill 16-byte block (PS2 HL likes everything to be alligned)
 	char Spacer = 0x00;
@@ -350,6 +401,7 @@ void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 form
 		FileWriteBlock(&ptrOutFile, &DOLTextureHeader, sizeof(sDOLTextureHeader));
 		FileWriteBlock(&ptrOutFile, (char *) Textures[i].Palette, Textures[i].PaletteSize);
 		FileWriteBlock(&ptrOutFile, (char *) Textures[i].Bitmap, Textures[i].Width * Textures[i].Height);
+		LibProgress(i + 1, ModelHeader.TextureCount);
 	}
 
 	// Fetch data from external *.INI file (if present) and write it to DOL file
@@ -358,7 +410,12 @@ void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 form
 	if (CheckExtraFile(FileName) == true)
 	{
 		// Get data from *.INI
-		TranslateExtraFile(FileName, &DOLXS, &LODTable);
+		Result = TranslateExtraFile(FileName, &DOLXS, &LODTable);
+		if (Result != PS2HL_OK)
+		{
+			fclose(ptrOutFile);
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, Result);
+		}
 
 		// Rewrite extra section
 		DOLXS.LODDataOffset = FileSize(&ptrOutFile);
@@ -368,7 +425,7 @@ void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 form
 		if (LODTable != NULL)
 		{
 			FileWriteBlock(&ptrOutFile, LODTable, FileSize(&ptrOutFile), DOLXS.NumBodyGroups * DOLXS.MaxBodyParts * sizeof(sDOLLODEntry));
-			free(LODTable);
+			LibFree(LODTable);
 		}
 
 		// Align data
@@ -381,18 +438,16 @@ void ConvertMDLToDOL(const char * FileName)	// Convert model from PC to PS2 form
 	ModelSize = FileSize(&ptrOutFile);
 	FileWriteBlock(&ptrOutFile, &ModelSize, 0x48, sizeof(ModelSize));	// 0x48 - address of model size field
 
-	// Free memory
-	free(ModelTextureTable);
-	free(Textures);
-
-	// Close files
-	fclose(ptrInFile);
+	// Close output file
 	fclose(ptrOutFile);
 
-	puts("Done!\n\n");
+	LibMsg(MSG_INFO, "Done!\n\n\n");
+
+	// Free memory and close input file
+	return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, PS2HL_OK);
 }
 
-void ConvertSubmodel(const char * FileName, char * OriginalExtension, char * TargetExtension)	// Convert submodel
+int ConvertSubmodel(const char * FileName, const char * OriginalExtension, const char * TargetExtension)	// Convert submodel
 {
 	FILE * ptrModelFile;
 	FILE * ptrOutputFile;
@@ -401,14 +456,14 @@ void ConvertSubmodel(const char * FileName, char * OriginalExtension, char * Tar
 	char * ModelData;
 	ulong ModelDataSize;
 
-	int ModelType;
 	char NewModelName[64];
 	char OutputFile[PATH_LEN];
 
-	puts("Patching submodel ...");
+	LibMsg(MSG_INFO, "Patching submodel ...\n");
 
 	// Open model file
-	SafeFileOpen(&ptrModelFile, FileName, "rb");
+	if (FileOpen(&ptrModelFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Load header
 	ModelHeader.UpdateFromFile(&ptrModelFile);
@@ -416,14 +471,33 @@ void ConvertSubmodel(const char * FileName, char * OriginalExtension, char * Tar
 	// Check header
 	if (ModelHeader.CheckModel() != NOTEXTURES_MODEL && ModelHeader.CheckModel() != SEQ_MODEL)
 	{
-		puts("Invalid submodel ...");
-		return;
+		LibMsg(MSG_ERROR, "Invalid submodel ...\n");
+		fclose(ptrModelFile);
+		return PS2HL_ERR_FORMAT;
 	}
 
+	// Read model data
+	ModelDataSize = FileSize(&ptrModelFile) - sizeof(sModelHeader);
+	ModelData = (char *)LibAlloc(ModelDataSize);
+	if (ModelData == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrModelFile);
+		return PS2HL_ERR_MEMORY;
+	}
+	FileReadBlock(&ptrModelFile, ModelData, sizeof(sModelHeader), ModelDataSize);
+
+	// Close file
+	fclose(ptrModelFile);
+
 	// Create new model file
 	FileGetFullName(FileName, OutputFile, sizeof(OutputFile));
 	strcat(OutputFile, TargetExtension);
-	SafeFileOpen(&ptrOutputFile, OutputFile, "wb");
+	if (FileOpen(&ptrOutputFile, OutputFile, "wb") == false)
+	{
+		LibFree(ModelData);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Update and write model header
 	FileGetName(FileName, NewModelName, sizeof(NewModelName), false);
@@ -432,9 +506,6 @@ void ConvertSubmodel(const char * FileName, char * OriginalExtension, char * Tar
 	FileWriteBlock(&ptrOutputFile, (char *)&ModelHeader, sizeof(sModelHeader));
 
 	// Write patched model data
-	ModelDataSize = FileSize(&ptrModelFile) - sizeof(sModelHeader);
-	ModelData = (char *)malloc(ModelDataSize);
-	FileReadBlock(&ptrModelFile, ModelData, sizeof(sModelHeader), ModelDataSize);
 	if (ModelHeader.CheckModel() == NOTEXTURES_MODEL)	// Apply patch to "IDST" models only
 	{
 		// Patch references
@@ -449,15 +520,17 @@ void ConvertSubmodel(const char * FileName, char * OriginalExtension, char * Tar
 	FileWriteBlock(&ptrOutputFile, ModelData, ModelDataSize);
 
 	// Free memory
-	free(ModelData);
+	LibFree(ModelData);
 
 	// Close file
-	fclose(ptrModelFile);
+	fclose(ptrOutputFile);
+
+	LibMsg(MSG_INFO, "Done!\n\n\n");
 
-	puts("Done!\n\n");
+	return PS2HL_OK;
 }
 
-void ConvertDummySubmodel(const char * FileName, char * OriginalExtension, char * TargetExtension)	// Convert submodel which consists of signature and name only
+int ConvertDummySubmodel(const char * FileName, const char * OriginalExtension, const char * TargetExtension)	// Convert submodel which consists of signature and name only
 {
 	FILE * ptrModelFile;
 	FILE * ptrOutputFile;
@@ -468,36 +541,55 @@ void ConvertDummySubmodel(const char * FileName, char * OriginalExtension, char
 	char OutputFile[PATH_LEN];
 	char NewInternalName[64];
 
-	puts("Patching dummy submodel ...");
+	LibMsg(MSG_INFO, "Patching dummy submodel ...\n");
 
 	// Open model file
-	SafeFileOpen(&ptrModelFile, FileName, "rb");
+	if (FileOpen(&ptrModelFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+
+	// Read model data
+	ModelDataSize = FileSize(&ptrModelFile);
+	ModelData = (char *)LibAlloc(ModelDataSize);
+	if (ModelData == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrModelFile);
+		return PS2HL_ERR_MEMORY;
+	}
+	FileReadBlock(&ptrModelFile, ModelData, 0, ModelDataSize);
+
+	// Close file
+	fclose(ptrModelFile);
 
 	// Create new model file
 	FileGetFullName(FileName, OutputFile, sizeof(OutputFile));
 	strcat(OutputFile, TargetExtension);
-	SafeFileOpen(&ptrOutputFile, OutputFile, "wb");
+	if (FileOpen(&ptrOutputFile, OutputFile, "wb") == false)
+	{
+		LibFree(ModelData);
+		return PS2HL_ERR_OPEN;
+	}
 	FileGetName(OutputFile, NewInternalName, sizeof(NewInternalName), true);
 
 	// Write patched model data
-	ModelDataSize = FileSize(&ptrModelFile);
-	ModelData = (char *)malloc(ModelDataSize);
-	FileReadBlock(&ptrModelFile, ModelData, 0, ModelDataSize);
-	for (uchar c = 8; ModelData[c] != '\0'; c++)	// Clear old name, 8 - offset of internal name
+	for (uchar c = 8; c < ModelDataSize && ModelData[c] != '\0'; c++)	// Clear old name, 8 - offset of internal name
 		ModelData[c] = '\0';
-	strcpy(&ModelData[8], NewInternalName);			// Copy new name, 8 - offset of internal name
+	if (ModelDataSize > 8)
+		snprintf(&ModelData[8], ModelDataSize - 8, "%s", NewInternalName);	// Copy new name, 8 - offset of internal name
 	FileWriteBlock(&ptrOutputFile, ModelData, ModelDataSize);
 
 	// Free memory
-	free(ModelData);
+	LibFree(ModelData);
 
 	// Close file
-	fclose(ptrModelFile);
+	fclose(ptrOutputFile);
+
+	LibMsg(MSG_INFO, "Done!\n\n\n");
 
-	puts("Done!\n\n");
+	return PS2HL_OK;
 }
 
-void GetExtraDOLData(const char * FileName)
+int GetExtraDOLData(const char * FileName)
 {
 	FILE * ptrInFile;
 	FILE * ptrOutFile;
@@ -505,7 +597,8 @@ void GetExtraDOLData(const char * FileName)
 	sDOLExtraSection DOLExtraSect;
 
 	// Open input file
-	SafeFileOpen(&ptrInFile, FileName, "rb");
+	if (FileOpen(&ptrInFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Read extra section
 	FileReadBlock(&ptrInFile, &DOLExtraSect, sizeof(sModelHeader), sizeof(sDOLExtraSection));
@@ -516,12 +609,16 @@ void GetExtraDOLData(const char * FileName)
 	{
 		sDOLLODEntry * LODTable;
 
-		puts("Fetching extra data ...");
+		LibMsg(MSG_INFO, "Fetching extra data ...\n");
 
 		//// Open output *.INF file
 		FileGetFullName(FileName, cOutFileName, sizeof(cOutFileName));
 		strcat(cOutFileName, ".inf");
-		SafeFileOpen(&ptrOutFile, cOutFileName, "wb");
+		if (FileOpen(&ptrOutFile, cOutFileName, "wb") == false)
+		{
+			fclose(ptrInFile);
+			return PS2HL_ERR_OPEN;
+		}
 
 
 		//// Write output file
@@ -548,12 +645,13 @@ void GetExtraDOLData(const char * FileName)
 			fprintf(ptrOutFile, "\\\\ decompiling the model and removing LOD body parts.\r\n\r\n");
 
 			// Read LOD table
-			LODTable = (sDOLLODEntry *)malloc(LODTableSize);
+			LODTable = (sDOLLODEntry *)LibAlloc(LODTableSize);
 			if (LODTable == NULL)
 			{
-				puts("Can't allocate memory!");
+				LibMsg(MSG_ERROR, "Can't allocate memory!\n");
+				fclose(ptrOutFile);
 				fclose(ptrInFile);
-				return;
+				return PS2HL_ERR_MEMORY;
 			}
 			FileReadBlock(&ptrInFile, LODTable, DOLExtraSect.LODDataOffset, LODTableSize);
 
@@ -579,6 +677,8 @@ void GetExtraDOLData(const char * FileName)
 
 				fprintf(ptrOutFile, "}\r\n\r\n");
 			}
+
+			LibFree(LODTable);
 		}
 
 		//// Close output file
@@ -587,6 +687,8 @@ void GetExtraDOLData(const char * FileName)
 
 	// Close input file
 	fclose(ptrInFile);
+
+	return PS2HL_OK;
 }
 
 ///////////////////////////////////////
@@ -631,12 +733,12 @@ bool CheckExtraFile(const char * FileName)
 	ushort Open = 0;		// Open brackets count
 	ushort Close = 0;		// Close brackets count
 
-	puts("Checking *.INF file ...");
+	LibMsg(MSG_INFO, "Checking *.INF file ...\n");
 
 	// Open input *.INF file
 	FileGetFullName(FileName, cInFileName, sizeof(cInFileName));
 	strcat(cInFileName, ".inf");
-	ptrInFile = fopen(cInFileName, "rb");
+	ptrInFile = FileProbe(cInFileName, "rb");
 	if (ptrInFile == NULL)
 		return false;
 
@@ -666,7 +768,7 @@ bool CheckExtraFile(const char * FileName)
 				}
 				else
 				{
-					puts("Invalid [] order !");
+					LibMsg(MSG_WARN, "Invalid [] order !\n");
 					fclose(ptrInFile);
 					return false;
 				}
@@ -675,7 +777,7 @@ bool CheckExtraFile(const char * FileName)
 
 		if (Open != Close)
 		{
-			puts("Both \'[\' and \']\' should be on one line !");
+			LibMsg(MSG_WARN, "Both \'[\' and \']\' should be on one line !\n");
 			fclose(ptrInFile);
 			return false;
 		}
@@ -684,7 +786,7 @@ bool CheckExtraFile(const char * FileName)
 	// Check if empty
 	if (Open == 0 && Close == 0)
 	{
-		puts("*.INF file is empty, skipping ...");
+		LibMsg(MSG_INFO, "*.INF file is empty, skipping ...\n");
 		fclose(ptrInFile);
 		return false;
 	}
@@ -692,12 +794,12 @@ bool CheckExtraFile(const char * FileName)
 	// Check for parity
 	if (Open != Close)
 	{
-		puts("Number of \'[\' not matches \']\' ...");
+		LibMsg(MSG_WARN, "Number of \'[\' not matches \']\' ...\n");
 		fclose(ptrInFile);
 		return false;
 	}
 
-	printf("Found %d active lines \n", Open);
+	LibMsg(MSG_INFO, "Found %d active lines \n", Open);
 
 	// Rewind file pointer
 	fseek(ptrInFile, 0, SEEK_SET);
@@ -727,7 +829,7 @@ bool CheckExtraFile(const char * FileName)
 			}
 			else
 			{
-				puts("Invalid {} order !");
+				LibMsg(MSG_WARN, "Invalid {} order !\n");
 				fclose(ptrInFile);
 				return false;
 			}
@@ -737,12 +839,12 @@ bool CheckExtraFile(const char * FileName)
 	// Check for parity
 	if (Open != Close)
 	{
-		puts("Number of \'{\' not matches \'}\' !");
+		LibMsg(MSG_WARN, "Number of \'{\' not matches \'}\' !\n");
 		fclose(ptrInFile);
 		return false;
 	}
 
-	printf("Found %d body groups \n", Open);
+	LibMsg(MSG_INFO, "Found %d body groups \n", Open);
 
 	// Close file
 	fclose(ptrInFile);
@@ -779,7 +881,7 @@ void GetValues(char * Buffer, ulong * Values, uchar ValuesCount)
 				// Check for values
 				if (CurrentVal >= ValuesCount)
 				{
-					puts("Too many values, skipping the rest of them ...\n");
+					LibMsg(MSG_WARN, "Too many values, skipping the rest of them ...\n\n");
 					break;
 				}
 
@@ -802,7 +904,7 @@ void GetValues(char * Buffer, ulong * Values, uchar ValuesCount)
 	}
 }
 
-bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect, sDOLLODEntry ** LODTable)
+int TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect, sDOLLODEntry ** LODTable)
 {
 	FILE * ptrInFile;					// Input file stream
 	char cInFileName[PATH_LEN];			// Input file name
@@ -813,7 +915,9 @@ bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect,
 	//// Open input *.INF file
 	FileGetFullName(FileName, cInFileName, sizeof(cInFileName));
 	strcat(cInFileName, ".inf");
-	SafeFileOpen(&ptrInFile, cInFileName, "rb");
+	*LODTable = NULL;
+	if (FileOpen(&ptrInFile, cInFileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	//// Clear extra section
 	memset(DOLExtraSect, 0x00, sizeof(sDOLExtraSection));
@@ -859,7 +963,7 @@ bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect,
 						DOLExtraSect->FadeStart = Value;
 						if (DOLExtraSect->FadeEnd == 0)
 							DOLExtraSect->FadeEnd = Value;
-						puts("Got fade start value ...");
+						LibMsg(MSG_INFO, "Got fade start value ...\n");
 					}
 					else if (!strcmp(Buffer, KWD_FADEEND) == true)
 					{
@@ -867,19 +971,19 @@ bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect,
 						DOLExtraSect->FadeEnd = Value;
 						if (DOLExtraSect->FadeStart == 0)
 							DOLExtraSect->FadeStart = Value;
-						puts("Got fade end value ...");
+						LibMsg(MSG_INFO, "Got fade end value ...\n");
 					}
 					else if (!strcmp(Buffer, KWD_NUMGROUPS) == true)
 					{
 						// Number of body groups
 						DOLExtraSect->NumBodyGroups = Value;
-						puts("Got number of body groups ...");
+						LibMsg(MSG_INFO, "Got number of body groups ...\n");
 					}
 					else if (!strcmp(Buffer, KWD_MAXPARTS) == true)
 					{
 						// Max number of body parts
 						DOLExtraSect->MaxBodyParts = Value;
-						puts("Got maximum number of body parts ...");
+						LibMsg(MSG_INFO, "Got maximum number of body parts ...\n");
 					}
 				}
 			}
@@ -892,23 +996,23 @@ bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect,
 	// Check if LOD table is needed
 	if (DOLExtraSect->NumBodyGroups * DOLExtraSect->MaxBodyParts == 0)
 	{
-		*LODTable = NULL;
 		fclose(ptrInFile);
-		return true;
+		return PS2HL_OK;
 	}
 
-	puts("Fetching LOD table ...");
+	LibMsg(MSG_INFO, "Fetching LOD table ...\n");
 
 	// Rewind input file
 	rewind(ptrInFile);
 
 	// Allocate memory for LOD table
 	ulong LODTableSz = DOLExtraSect->NumBodyGroups * DOLExtraSect->MaxBodyParts * sizeof(sDOLLODEntry);
-	*LODTable = (sDOLLODEntry *) calloc(1, LODTableSz);
+	*LODTable = (sDOLLODEntry *) LibCalloc(1, LODTableSz);
 	if (*LODTable == NULL)
 	{
-		puts("Can't allocate memory!");
-		return false;
+		LibMsg(MSG_ERROR, "Can't allocate memory!\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_MEMORY;
 	}
 
 	// Fill table
@@ -933,12 +1037,12 @@ bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect,
 		// Fetch LOD table (inside of {})
 		if (Buffer[0] == '{' && Buffer[1] == '\0')
 		{
-			printf("Fetching group #%d: \t\"%s\"\n", GroupCount, PrevBuffer);
+			LibMsg(MSG_INFO, "Fetching group #%d: \t\"%s\"\n", GroupCount, PrevBuffer);
 			
 			// Check if out of bounds
 			if (GroupCount >= DOLExtraSect->NumBodyGroups)
 			{
-				printf("Group #%d is out of bounds, ignoring the rest of the file\n", GroupCount);
+				LibMsg(MSG_INFO, "Group #%d is out of bounds, ignoring the rest of the file\n", GroupCount);
 				break;
 			}
 
@@ -966,7 +1070,7 @@ bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect,
 					// Check if out of bounds
 					if (PartCount >= DOLExtraSect->MaxBodyParts)
 					{
-						printf("Part #%d is out of bounds, skipping ...\n", PartCount);
+						LibMsg(MSG_INFO, "Part #%d is out of bounds, skipping ...\n", PartCount);
 						PartCount++;
 						EntryNum++;
 						continue;
@@ -979,7 +1083,7 @@ bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect,
 					(*LODTable)[EntryNum].LODCount = ValuesCnt;
 					GetValues(Buffer, (*LODTable)[EntryNum].LODDistances, ValuesCnt);
 					AddTerminator(Buffer, '[');
-					printf("Fetched part #%d: \t\"%s\"\n", PartCount, Buffer);
+					LibMsg(MSG_INFO, "Fetched part #%d: \t\"%s\"\n", PartCount, Buffer);
 					
 					// Increnent part and entry counters
 					PartCount++;
@@ -992,14 +1096,14 @@ bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect,
 						// Check if out of bounds
 						if (PartCount >= DOLExtraSect->MaxBodyParts)
 						{
-							printf("Part #%d is out of bounds, skipping ...\n", PartCount);
+							LibMsg(MSG_INFO, "Part #%d is out of bounds, skipping ...\n", PartCount);
 							PartCount++;
 							EntryNum++;
 							continue;
 						}
 						
 						// Fetch (in this case do nothing as entry already should be nulled out)
-						printf("Fetched blank part #%d\n", PartCount);
+						LibMsg(MSG_INFO, "Fetched blank part #%d\n", PartCount);
 
 						// Increnent part and entry counters
 						PartCount++;
@@ -1015,13 +1119,13 @@ bool TranslateExtraFile(const char * FileName, sDOLExtraSection * DOLExtraSect,
 	//// Close input file
 	fclose(ptrInFile);
 
-	return true;
+	return PS2HL_OK;
 }
 ///////////////////////////////////////
 ///////////////////////////////////
 //////////////////////////////
 
-void PatchSubmodelRef(sModelHeader * MdlHdr, char * ModelData, ulong ModelDataSize, char * NewExtension)		// Patch internal submodel references
+void PatchSubmodelRef(sModelHeader * MdlHdr, char * ModelData, ulong ModelDataSize, const char * NewExtension)		// Patch internal submodel references
 {
 	// Check if patching is needed
 	if (MdlHdr->SubmodelCount <= 1)
@@ -1031,7 +1135,7 @@ void PatchSubmodelRef(sModelHeader * MdlHdr, char * ModelData, ulong ModelDataSi
 	if (ModelDataSize < 4 || strlen(NewExtension) != 4)
 		return;
 
-	printf("Found %i internal submodel reference(s), patching ...\n", MdlHdr->SubmodelCount - 1);
+	LibMsg(MSG_INFO, "Found %i internal submodel reference(s), patching ...\n", MdlHdr->SubmodelCount - 1);
 	
 	// Calculate offset to first submodel reference
 	ulong Offset = MdlHdr->SubmodelTableOffset - sizeof(sModelHeader) + MDL_DEF_REF_SZ + MDL_FILE_REF_SPACE;
@@ -1043,7 +1147,7 @@ void PatchSubmodelRef(sModelHeader * MdlHdr, char * ModelData, ulong ModelDataSi
 		// Redundant check?
 		if (Offset + MDL_FILE_REF_SZ > ModelDataSize)
 		{
-			puts("Oops, model data is too small. Patching failed ...");
+			LibMsg(MSG_WARN, "Oops, model data is too small. Patching failed ...\n");
 			return;
 		}
 
@@ -1058,7 +1162,7 @@ void PatchSubmodelRef(sModelHeader * MdlHdr, char * ModelData, ulong ModelDataSi
 			Counter++;
 			if (Counter > MDL_FILE_REF_SZ)
 			{
-				puts("Oops, erroneous reference. Patching failed ...");
+				LibMsg(MSG_WARN, "Oops, erroneous reference. Patching failed ...\n");
 				return;
 			}
 		}
@@ -1099,11 +1203,10 @@ uint PSIProperSize(uint Size, bool ToLower)	// Function returns closest proper d
 	}
 }
 
-void ExtractDOLTextures(const char * FileName)	// Extract textures from PS2 model
+int ExtractDOLTextures(const char * FileName)	// Extract textures from PS2 model
 {
 	sModelHeader ModelHeader;					// Model file header
 	sModelTextureEntry * ModelTextureTable;		// Model texture table
-	ulong ModelTextureTableSize;				// Model texture table size (how many textures)
 	sTexture * Textures;						// Pointer to texturs data
 
 	FILE * ptrInFile;
@@ -1113,7 +1216,8 @@ void ExtractDOLTextures(const char * FileName)	// Extract textures from PS2 mode
 	char cOutFolderName[PATH_LEN];
 
 	// Open file
-	SafeFileOpen(&ptrInFile, FileName, "rb");
+	if (FileOpen(&ptrInFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Load model header
 	ModelHeader.UpdateFromFile(&ptrInFile);
@@ -1121,17 +1225,23 @@ void ExtractDOLTextures(const char * FileName)	// Extract textures from PS2 mode
 	// Check model
 	if (ModelHeader.CheckModel() == NORMAL_MODEL)
 	{
-		printf("Internal name: %s \nTextures: %i, Texture table offset: 0x%X \n", ModelHeader.Name, ModelHeader.TextureCount, ModelHeader.TextureTableOffset);
+		LibMsg(MSG_INFO, "Internal name: %s \nTextures: %i, Texture table offset: 0x%X \n", ModelHeader.Name, ModelHeader.TextureCount, ModelHeader.TextureTableOffset);
 	}
 	else
 	{
-		puts("Can't extract textures.");
-		return;
+		LibMsg(MSG_ERROR, "Can't extract textures.\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Allocate memory for textures
-	ModelTextureTable = (sModelTextureEntry *)malloc(ModelHeader.TextureCount * sizeof(sModelTextureEntry));
-	Textures = (sTexture *)malloc(sizeof(sTexture) * ModelHeader.TextureCount);
+	ModelTextureTable = (sModelTextureEntry *)LibAlloc(ModelHeader.TextureCount * sizeof(sModelTextureEntry));
+	Textures = (sTexture *)LibCalloc(ModelHeader.TextureCount, sizeof(sTexture));
+	if (ModelTextureTable == NULL || Textures == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return CloseModel(ptrInFile, ModelTextureTable, Textures, 0, PS2HL_ERR_MEMORY);
+	}
 
 	// Prepare folder for output files
 	strcpy(cOutFolderName, FileName);
@@ -1146,7 +1256,7 @@ void ExtractDOLTextures(const char * FileName)	// Extract textures from PS2 mode
 	for (int i = 0; i < ModelHeader.TextureCount; i++)
 	{
 		ModelTextureTable[i].UpdateFromFile(&ptrInFile, ModelHeader.TextureTableOffset, i);
-		printf(" Texture #%i \n Name: %s \n Width: %i \n Height: %i \n Offset: %x \n\n", i + 1, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height, ModelTextureTable[i].Offset);
+		LibMsg(MSG_INFO, " Texture #%i \n Name: %s \n Width: %i \n Height: %i \n Offset: %x \n\n", i + 1, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height, ModelTextureTable[i].Offset);
 
 		BitmapOffset = ModelTextureTable[i].Offset + DOL_TEXTURE_HEADER_SIZE + EIGHT_BIT_PALETTE_ELEMENTS_COUNT * DOL_BMP_PALETTE_ELEMENT_SIZE;
 		BitmapSize = ModelTextureTable[i].Height * ModelTextureTable[i].Width;
@@ -1155,19 +1265,22 @@ void ExtractDOLTextures(const char * FileName)	// Extract textures from PS2 mode
 
 		// Load texture
 		Textures[i].Initialize();
-		Textures[i].UpdateFromFile(&ptrInFile, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height);
+		if (Textures[i].UpdateFromFile(&ptrInFile, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height) == false)
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
 
 		// Convert texture
-		Textures[i].FlipBitmap();
+		if (Textures[i].FlipBitmap() == false)
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
 		Textures[i].PaletteReformat(DOL_BMP_PALETTE_ELEMENT_SIZE);
-		Textures[i].PaletteRemoveSpacers();
-		Textures[i].PaletteAddSpacers(0x00);
+		if (Textures[i].PaletteRemoveSpacers() == false || Textures[i].PaletteAddSpacers(0x00) == false)
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
 		Textures[i].PaletteSwapRedAndGreen(DOL_BMP_PALETTE_ELEMENT_SIZE);
 
 		// Save texture to *.bmp
 		strcpy(cOutFileName, cOutFolderName);
 		strcat(cOutFileName, ModelTextureTable[i].Name);
-		SafeFileOpen(&ptrBMPOutput, cOutFileName, "wb");
+		if (FileOpen(&ptrBMPOutput, cOutFileName, "wb") == false)
+			return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_OPEN);
 
 		BMPHeader.Update(Textures[i].Width, Textures[i].Height);
 		FileWriteBlock(&ptrBMPOutput, (char *) &BMPHeader, sizeof(sBMPHeader));
@@ -1175,23 +1288,19 @@ void ExtractDOLTextures(const char * FileName)	// Extract textures from PS2 mode
 		FileWriteBlock(&ptrBMPOutput, (char *) Textures[i].Bitmap, Textures[i].Width * Textures[i].Height);
 
 		fclose(ptrBMPOutput);
+		LibProgress(i + 1, ModelHeader.TextureCount);
 	}
 
-	// Free memory
-	free(ModelTextureTable);
-	free(Textures);
-
-	// Close files
-	fclose(ptrInFile);
+	LibMsg(MSG_INFO, "Done!\n\n\n");
 
-	puts("Done!\n\n");
+	// Free memory and close input file
+	return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, PS2HL_OK);
 }
 
-void ExtractMDLTextures(const char * FileName)	// Extract textures from PC model
+int ExtractMDLTextures(const char * FileName)	// Extract textures from PC model
 {
 	sModelHeader ModelHeader;					// Model file header
 	sModelTextureEntry * ModelTextureTable;		// Model texture table
-	ulong ModelTextureTableSize;				// Model texture table size (how many textures)
 	sTexture * Textures;						// Pointer to textures data
 
 	FILE * ptrInFile;
@@ -1201,7 +1310,8 @@ void ExtractMDLTextures(const char * FileName)	// Extract textures from PC model
 	char cOutFolderName[PATH_LEN];
 
 	// Open file
-	SafeFileOpen(&ptrInFile, FileName, "rb");
+	if (FileOpen(&ptrInFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Load model header
 	ModelHeader.UpdateFromFile(&ptrInFile);
@@ -1209,17 +1319,23 @@ void ExtractMDLTextures(const char * FileName)	// Extract textures from PC model
 	// Check model
 	if (ModelHeader.CheckModel() == NORMAL_MODEL)
 	{
-		printf("Internal name: %s \nTextures: %i, Texture table offset: 0x%X \n", ModelHeader.Name, ModelHeader.TextureCount, ModelHeader.TextureTableOffset);
+		LibMsg(MSG_INFO, "Internal name: %s \nTextures: %i, Texture table offset: 0x%X \n", ModelHeader.Name, ModelHeader.TextureCount, ModelHeader.TextureTableOffset);
 	}
 	else
 	{
-		puts("Can't extract textures.");
-		return;
+		LibMsg(MSG_ERROR, "Can't extract textures.\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Allocate memory for textutes
-	ModelTextureTable = (sModelTextureEntry *)malloc(ModelHeader.TextureCount * sizeof(sModelTextureEntry));
-	Textures = (sTexture *)malloc(sizeof(sTexture) * ModelHeader.TextureCount);
+	ModelTextureTable = (sModelTextureEntry *)LibAlloc(ModelHeader.TextureCount * sizeof(sModelTextureEntry));
+	Textures = (sTexture *)LibCalloc(ModelHeader.TextureCount, sizeof(sTexture));
+	if (ModelTextureTable == NULL || Textures == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return CloseModel(ptrInFile, ModelTextureTable, Textures, 0, PS2HL_ERR_MEMORY);
+	}
 
 	// Prepare folder for output files
 	strcpy(cOutFolderName, FileName);
@@ -1236,7 +1352,7 @@ void ExtractMDLTextures(const char * FileName)	// Extract textures from PC model
 	for (int i = 0; i < ModelHeader.TextureCount; i++)
 	{
 		ModelTextureTable[i].UpdateFromFile(&ptrInFile, ModelHeader.TextureTableOffset, i);
-		printf(" Texture #%i \n Name: %s \n Width: %i \n Height: %i \n Offset: %x \n\n", i + 1, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height, ModelTextureTable[i].Offset);
+		LibMsg(MSG_INFO, " Texture #%i \n Name: %s \n Width: %i \n Height: %i \n Offset: %x \n\n", i + 1, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height, ModelTextureTable[i].Offset);
 
 		// PVR check
 		if (RawExtract == false)
@@ -1245,7 +1361,7 @@ void ExtractMDLTextures(const char * FileName)	// Extract textures from PC model
 			if (!strcmp(TexExtension, ".pvr") == true)
 			{
 				RawExtract = true;
-				puts("Dreamcast textures found ...");
+				LibMsg(MSG_INFO, "Dreamcast textures found ...\n");
 			}
 		}
 
@@ -1261,17 +1377,21 @@ void ExtractMDLTextures(const char * FileName)	// Extract textures from PC model
 
 			// Load texture
 			Textures[i].Initialize();
-			Textures[i].UpdateFromFile(&ptrInFile, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height);
+			if (Textures[i].UpdateFromFile(&ptrInFile, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, ModelTextureTable[i].Name, ModelTextureTable[i].Width, ModelTextureTable[i].Height) == false)
+				return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
 
 			// Convert texture
-			Textures[i].FlipBitmap();
+			if (Textures[i].FlipBitmap() == false)
+				return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
 			Textures[i].PaletteSwapRedAndGreen(MDL_PALETTE_ELEMENT_SIZE);
-			Textures[i].PaletteAddSpacers(0x00);
+			if (Textures[i].PaletteAddSpacers(0x00) == false)
+				return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_MEMORY);
 
 			// Save texture to *.bmp file
 			strcpy(cOutFileName, cOutFolderName);
 			strcat(cOutFileName, ModelTextureTable[i].Name);
-			SafeFileOpen(&ptrBMPOutput, cOutFileName, "wb");
+			if (FileOpen(&ptrBMPOutput, cOutFileName, "wb") == false)
+				return CloseModel(ptrInFile, ModelTextureTable, Textures, i + 1, PS2HL_ERR_OPEN);
 
 			BMPHeader.Update(Textures[i].Width, Textures[i].Height);
 			FileWriteBlock(&ptrBMPOutput, (char *)&BMPHeader, sizeof(sBMPHeader));
@@ -1297,43 +1417,44 @@ void ExtractMDLTextures(const char * FileName)	// Extract textures from PC model
 			}
 
 			// Allocate memory
-			pPVR = (uchar *)malloc(PVRSize);
+			pPVR = (uchar *)LibAlloc(PVRSize);
 			if (pPVR == NULL)
 			{
-				puts("Unable to allocate memory ...");
-				exit(EXIT_FAILURE);
+				LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+				return CloseModel(ptrInFile, ModelTextureTable, Textures, i, PS2HL_ERR_MEMORY);
 			}
-			
+
 			// Read texture
 			FileReadBlock(&ptrInFile, pPVR, ModelTextureTable[i].Offset, PVRSize);
 
 			// Open output file
 			strcpy(cOutFileName, cOutFolderName);
 			strcat(cOutFileName, ModelTextureTable[i].Name);
-			SafeFileOpen(&ptrBMPOutput, cOutFileName, "wb");
+			if (FileOpen(&ptrBMPOutput, cOutFileName, "wb") == false)
+			{
+				LibFree(pPVR);
+				return CloseModel(ptrInFile, ModelTextureTable, Textures, i, PS2HL_ERR_OPEN);
+			}
 
 			// Write texture
 			FileWriteBlock(&ptrBMPOutput, pPVR, PVRSize);
 
 			// Free memory
-			free(pPVR);
+			LibFree(pPVR);
 		}
 
 		// Close output file
 		fclose(ptrBMPOutput);
+		LibProgress(i + 1, ModelHeader.TextureCount);
 	}
 
-	// Free memory
-	free(ModelTextureTable);
-	free(Textures);
+	LibMsg(MSG_INFO, "Done!\n\n\n");
 
-	// Close files
-	fclose(ptrInFile);
-
-	puts("Done!\n\n");
+	// Free memory and close input file
+	return CloseModel(ptrInFile, ModelTextureTable, Textures, ModelHeader.TextureCount, PS2HL_OK);
 }
 
-void SeqReport(const char * FileName)
+int SeqReport(const char * FileName)
 {
 	sModelHeader ModelHeader;	// Model file header
 	sModelSeq * SeqTable;		// Sequences table
@@ -1344,7 +1465,8 @@ void SeqReport(const char * FileName)
 	char cOutFileName[PATH_LEN];
 
 	// Open input file
-	SafeFileOpen(&ptrInFile, FileName, "rb");
+	if (FileOpen(&ptrInFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Load model header
 	ModelHeader.UpdateFromFile(&ptrInFile);
@@ -1352,18 +1474,25 @@ void SeqReport(const char * FileName)
 	// Check model
 	if (ModelHeader.CheckModel() == NORMAL_MODEL)
 	{
-		printf("Internal name: %s \nSequences: %i \n", ModelHeader.Name, ModelHeader.SeqCount);
+		LibMsg(MSG_INFO, "Internal name: %s \nSequences: %i \n", ModelHeader.Name, ModelHeader.SeqCount);
 	}
 	else
 	{
-		puts("Bad model file");
-		return;
+		LibMsg(MSG_ERROR, "Bad model file\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Allocate memory for sequence table
 	SeqCount = ModelHeader.SeqCount;
 	SeqTableSz = sizeof(sModelSeq) * SeqCount;
-	SeqTable = (sModelSeq *) malloc(SeqTableSz);
+	SeqTable = (sModelSeq *) LibAlloc(SeqTableSz);
+	if (SeqTable == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_MEMORY;
+	}
 
 	// Read qequence table
 	FileReadBlock(&ptrInFile, SeqTable, ModelHeader.SeqTableOffset, SeqTableSz);
@@ -1374,11 +1503,15 @@ void SeqReport(const char * FileName)
 	// Open output file
 	FileGetFullName(FileName, cOutFileName, sizeof(cOutFileName));
 	strcat(cOutFileName, "_seq.txt");
-	SafeFileOpen(&ptrOutFile, cOutFileName, "w");
+	if (FileOpen(&ptrOutFile, cOutFileName, "w") == false)
+	{
+		LibFree(SeqTable);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Print report
 	fprintf(ptrOutFile, "File: %s\nSequences: %d\n\n", FileName, SeqCount);
-	fprintf(ptrOutFile, "[#]\t[File]\t[Sequence]\n", FileName, SeqCount);
+	fprintf(ptrOutFile, "[#]\t[File]\t[Sequence]\n");
 	for (int sq = 0; sq < SeqCount; sq++)
 		fprintf(ptrOutFile, "%d\t%d\t%s\n", sq, SeqTable[sq].Num, SeqTable[sq].Name);
 
@@ -1386,122 +1519,393 @@ void SeqReport(const char * FileName)
 	fclose(ptrOutFile);
 
 	// Free memory
-	free(SeqTable);
+	LibFree(SeqTable);
 
-	puts("Done!\n\n");
+	LibMsg(MSG_INFO, "Done!\n\n\n");
+
+	return PS2HL_OK;
 }
 
-int main(int argc, char * argv[])
+
+////////// Batch jobs //////////
+int RunJob(const char * Command, const char * FileName)
 {
-	FILE * ptrInputFile;
-	FILE * ptrConfigFile;
-	char ConfigFilePath[PATH_LEN];
-	char Line[80];
 	char cFileExtension[5];
+	int ModelType;
 
-	// Output info
-	puts(PROG_TITLE);
-
-	// Check arguments
-	if (argc == 1)
+	FileGetExtension(FileName, cFileExtension, sizeof(cFileExtension));
+	if (strcmp(".mdl", cFileExtension) && strcmp(".dol", cFileExtension))
 	{
-		// No arguments - show help screen
-		puts(PROG_INFO);
-		UTIL_WAIT_KEY("Press any key to exit ...");
+		LibMsg(MSG_ERROR, "Wrong file extension.\n");
+		return PS2HL_ERR_PARAM;
 	}
-	else if (argc == 2)		// Convert model
+
+	LibMsg(MSG_INFO, "\nProcessing file: %s\n", FileName);
+	ModelType = CheckModel(FileName);
+
+	// Default action - convert model
+	if (JobIsAuto(Command) == true)
 	{
-		FileGetExtension(argv[1], cFileExtension, 5);
+		bool ToDOL = !strcmp(".mdl", cFileExtension);
 
-		printf("\nProcessing file: %s\n", argv[1]);
+		if (ModelType == NORMAL_MODEL)
+			return ToDOL ? ConvertMDLToDOL(FileName) : ConvertDOLToMDL(FileName);
+		if (ModelType == SEQ_MODEL || ModelType == NOTEXTURES_MODEL)
+			return ToDOL ? ConvertSubmodel(FileName, ".mdl", ".dol") : ConvertSubmodel(FileName, ".dol", ".mdl");
+		if (ModelType == DUMMY_MODEL)
+			return ToDOL ? ConvertDummySubmodel(FileName, ".mdl", ".dol") : ConvertDummySubmodel(FileName, ".dol", ".mdl");
 
-		if (!strcmp(".mdl", cFileExtension))
-		{
-			if (CheckModel(argv[1]) == NORMAL_MODEL)
-			{
-				ConvertMDLToDOL(argv[1]);
-			}
-			else if (CheckModel(argv[1]) == SEQ_MODEL || CheckModel(argv[1]) == NOTEXTURES_MODEL)
-			{
-				ConvertSubmodel(argv[1], ".mdl", ".dol");
-			}
-			else if (CheckModel(argv[1]) == DUMMY_MODEL)
-			{
-				// Patch dummy model's extension and internal name
-				ConvertDummySubmodel(argv[1], ".mdl", ".dol");
-			}
-			else
-			{
-				puts("Can't recognise model file ...");
-			}
-		}
-		else if (!strcmp(".dol", cFileExtension))
-		{
-			if (CheckModel(argv[1]) == NORMAL_MODEL)
-			{
-				ConvertDOLToMDL(argv[1]);
-			}
-			else if (CheckModel(argv[1]) == SEQ_MODEL || CheckModel(argv[1]) == NOTEXTURES_MODEL)
-			{
-				ConvertSubmodel(argv[1], ".dol", ".mdl");
-			}
-			else if (CheckModel(argv[1]) == DUMMY_MODEL)
-			{
-				// Patch dummy model's extension and internal name
-				ConvertDummySubmodel(argv[1], ".dol", ".mdl");
-			}
-			else
-			{
-				puts("Can't recognise model file ...");
-			}
-		}
-		else
+		LibMsg(MSG_ERROR, "Can't recognise model file ...\n");
+		return PS2HL_ERR_FORMAT;
+	}
+
+	// Extract textures
+	if (!strcmp(Command, "extract"))
+	{
+		if (ModelType != NORMAL_MODEL)
 		{
-			puts("Wrong file extension.");
+			LibMsg(MSG_ERROR, "Can't find texture data ...\n");
+			return PS2HL_ERR_FORMAT;
 		}
+		return !strcmp(".mdl", cFileExtension) ? ExtractMDLTextures(FileName) : ExtractDOLTextures(FileName);
+	}
+
+	// Report sequences
+	if (!strcmp(Command, "seqrep"))
+		return SeqReport(FileName);
+
+	LibMsg(MSG_ERROR, "Can't recognise command: %s \n", Command);
+	return PS2HL_ERR_PARAM;
+}
+
+const char * JobVersion()
+{
+	return PROG_TITLE;
+}
+
+bool SniffFile(const char * FileName)
+{
+	char cFileExtension[5];
+
+	// Dummy models are recognised by size only, so extension is required too
+	FileGetExtension(FileName, cFileExtension, sizeof(cFileExtension));
+	if (strcmp(".mdl", cFileExtension) && strcmp(".dol", cFileExtension))
+		return false;
+
+	return CheckModel(FileName) != UNKNOWN_MODEL;
+}
+
+int LintFile(const char * FileName, sLintFile * Lint)
+{
+	FILE * ptrFile;
+	sModelHeader ModelHeader;
+	sModelTextureEntry Texture;
+	char cFileExtension[5];
+	ulong ModelSize;
+	ulong TextureSize;
+	bool IsDOL;
+
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	FileGetExtension(FileName, cFileExtension, sizeof(cFileExtension));
+	IsDOL = !strcmp(cFileExtension, ".dol");
+
+	// Dummy models have signature, name and size only
+	ModelSize = FileSize(&ptrFile);
+	if (ModelSize < sizeof(sModelHeader))
+	{
+		fclose(ptrFile);
+		return PS2HL_OK;
 	}
-	else if (argc == 3 && !strcmp(argv[1], "extract") == true)		// Extract textures from model
+	ModelHeader.UpdateFromFile(&ptrFile);
+
+	if (ModelHeader.CheckModel() == UNKNOWN_MODEL)
 	{
-		FileGetExtension(argv[2], cFileExtension, 5);
+		LintReport(Lint, LINT_ERROR, "not a GoldSrc model (signature \"%.4s\", version %lu, should be \"IDST\" or \"IDSQ\", 10)",
+			ModelHeader.Signature, (unsigned long)ModelHeader.Version);
+		fclose(ptrFile);
+		return PS2HL_OK;
+	}
+	if (ModelHeader.FileSize != ModelSize)
+		LintReport(Lint, LINT_WARN, "size in header (%lu) doesn't match file size (%lu)", (unsigned long)ModelHeader.FileSize, (unsigned long)ModelSize);
+	if (ModelHeader.SeqCount != 0 && (ModelHeader.SeqTableOffset > ModelSize || ModelHeader.SeqCount > (ModelSize - ModelHeader.SeqTableOffset) / sizeof(sModelSeq)))
+		LintReport(Lint, LINT_ERROR, "sequence table is out of file (%lu sequences)", (unsigned long)ModelHeader.SeqCount);
 
-		printf("\nProcessing file: %s\n", argv[2]);
+	if (ModelHeader.CheckModel() != NORMAL_MODEL)
+	{
+		fclose(ptrFile);
+		return PS2HL_OK;
+	}
+	if (ModelHeader.TextureTableOffset > ModelSize || ModelHeader.TextureCount > (ModelSize - ModelHeader.TextureTableOffset) / sizeof(sModelTextureEntry))
+	{
+		LintReport(Lint, LINT_ERROR, "texture table is out of file (%lu textures)", (unsigned long)ModelHeader.TextureCount);
+		fclose(ptrFile);
+		return PS2HL_OK;
+	}
 
-		if (!strcmp(".mdl", cFileExtension))
+	// Textures: PS2 needs power of two sizes, DOL keeps them with RGBA palette
+	for (ulong i = 0; i < ModelHeader.TextureCount; i++)
+	{
+		Texture.UpdateFromFile(&ptrFile, ModelHeader.TextureTableOffset, i);
+		Texture.Name[sizeof(Texture.Name) - 1] = '\0';
+		if (IsDOL == true)
 		{
-			if (CheckModel(argv[2]) == NORMAL_MODEL)
-				ExtractMDLTextures(argv[2]);
-			else
-				puts("Can't find texture data ...");
+			if (Texture.Width != PSIProperSize(Texture.Width, false) || Texture.Height != PSIProperSize(Texture.Height, false))
+				LintReport(Lint, LINT_ERROR, "texture %s is %lux%lu, PS2 needs power of two (%d or more)", Texture.Name,
+					(unsigned long)Texture.Width, (unsigned long)Texture.Height, PSI_MIN_DIMENSION);
+			TextureSize = DOL_TEXTURE_HEADER_SIZE + EIGHT_BIT_PALETTE_ELEMENTS_COUNT * DOL_BMP_PALETTE_ELEMENT_SIZE;
 		}
-		else if (!strcmp(".dol", cFileExtension))
+		else
 		{
-			if (CheckModel(argv[2]) == NORMAL_MODEL)
-				ExtractDOLTextures(argv[2]);
-			else
-				puts("Can't find texture data ...");
+			TextureSize = EIGHT_BIT_PALETTE_ELEMENTS_COUNT * MDL_PALETTE_ELEMENT_SIZE;
 		}
-		else
+		if (Texture.Width == 0 || Texture.Height == 0 || Texture.Width > 0x1000 || Texture.Height > 0x1000 ||
+			Texture.Offset > ModelSize || TextureSize + Texture.Width * Texture.Height > ModelSize - Texture.Offset)
+			LintReport(Lint, LINT_ERROR, "texture %s (%lux%lu) is out of file", Texture.Name, (unsigned long)Texture.Width, (unsigned long)Texture.Height);
+	}
+	fclose(ptrFile);
+
+	return PS2HL_OK;
+}
+
+int DescribeFile(const char * FileName, sCatalogInfo * Info)
+{
+	FILE * ptrFile;
+	sModelHeader ModelHeader;
+	sModelTextureEntry Texture;
+	char cFileExtension[5];
+	ulong ModelSize;
+
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	FileGetExtension(FileName, cFileExtension, sizeof(cFileExtension));
+	Info->PS2 = !strcmp(cFileExtension, ".dol");
+
+	// Dummy models have nothing to describe
+	ModelSize = FileSize(&ptrFile);
+	if (ModelSize < sizeof(sModelHeader))
+	{
+		fclose(ptrFile);
+		return PS2HL_OK;
+	}
+	ModelHeader.UpdateFromFile(&ptrFile);
+	if (ModelHeader.CheckModel() == UNKNOWN_MODEL)
+	{
+		fclose(ptrFile);
+		return PS2HL_ERR_FORMAT;
+	}
+	Info->Sequences = ModelHeader.SeqCount;
+
+	// Biggest texture (table is checked the same way as in LintFile())
+	if (ModelHeader.CheckModel() == NORMAL_MODEL && ModelHeader.TextureTableOffset <= ModelSize &&
+		ModelHeader.TextureCount <= (ModelSize - ModelHeader.TextureTableOffset) / sizeof(sModelTextureEntry))
+	{
+		Info->Textures = ModelHeader.TextureCount;
+		Info->Palette = CAT_PAL_INDEXED;
+		for (ulong i = 0; i < ModelHeader.TextureCount; i++)
 		{
-			puts("Wrong file extension.");
+			Texture.UpdateFromFile(&ptrFile, ModelHeader.TextureTableOffset, i);
+			if (Texture.Width * Texture.Height > (ulong)Info->Width * Info->Height && Texture.Width <= 0xFFFF && Texture.Height <= 0xFFFF)
+			{
+				Info->Width = Texture.Width;
+				Info->Height = Texture.Height;
+			}
 		}
 	}
-	else if (argc == 3 && !strcmp(argv[1], "seqrep") == true)		// Report sequences
+	fclose(ptrFile);
+
+	return PS2HL_OK;
+}
+
+int GenerateFile(const char * FileName, sCorpusSpec * Spec)
+{
+	FILE * ptrFile;
+	sModelHeader ModelHeader;
+	sModelSeq Seq;
+	sModelTextureEntry * Textures;
+	char cFileExtension[5];
+	char cTextureName[64];
+	ushort * Skin;
+	uchar * Bitmap;
+	ulong Offset;
+	ulong BitmapSize;
+	ulong Width, Height;
+
+	FileGetExtension(FileName, cFileExtension, sizeof(cFileExtension));
+	if (strcmp(cFileExtension, ".mdl") || Spec->Count == 0)
+		return PS2HL_ERR_PARAM;
+
+	// Data that isn't important for conversion (bones, etc.) is filled with noise, DOL extra section goes there
+	memset(&ModelHeader, 0x00, sizeof(ModelHeader));
+	memcpy(ModelHeader.Signature, "IDST", 4);
+	ModelHeader.Version = 0xA;
+	FileGetName(FileName, ModelHeader.Name, sizeof(ModelHeader.Name), true);
+	ModelHeader.SubmodelCount = 1;
+	ModelHeader.SubmodelTableOffset = sizeof(sModelHeader);
+	ModelHeader.SeqCount = Spec->Sequences;
+	ModelHeader.SeqTableOffset = sizeof(sModelHeader) + MDL_GEN_DATA_SIZE;
+	ModelHeader.TextureCount = Spec->Count;
+	ModelHeader.TextureTableOffset = ModelHeader.SeqTableOffset + sizeof(sModelSeq) * ModelHeader.SeqCount;
+	ModelHeader.SkinCount = 1;
+	ModelHeader.SkinEntrySize = Spec->Count;
+	ModelHeader.SkinTableOffset = ModelHeader.TextureTableOffset + sizeof(sModelTextureEntry) * ModelHeader.TextureCount;
+	ModelHeader.TextureDataOffset = ModelHeader.SkinTableOffset + ModelHeader.SkinCount * ModelHeader.SkinEntrySize * 2;
+
+	Bitmap = (uchar *)LibAlloc((ulong)Spec->Width * Spec->Height + EIGHT_BIT_PALETTE_ELEMENTS_COUNT * MDL_PALETTE_ELEMENT_SIZE);
+	Textures = (sModelTextureEntry *)LibAlloc(sizeof(sModelTextureEntry) * Spec->Count);
+	Skin = (ushort *)LibAlloc(sizeof(ushort) * Spec->Count);
+	if (Bitmap == NULL || Textures == NULL || Skin == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		LibFree(Bitmap);
+		LibFree(Textures);
+		LibFree(Skin);
+		return PS2HL_ERR_MEMORY;
+	}
+
+	if (FileOpen(&ptrFile, FileName, "wb") == false)
 	{
-		FileGetExtension(argv[2], cFileExtension, 5);
+		LibFree(Bitmap);
+		LibFree(Textures);
+		LibFree(Skin);
+		return PS2HL_ERR_OPEN;
+	}
+	FileWriteBlock(&ptrFile, &ModelHeader, sizeof(sModelHeader));
+	CorpusFill(Spec, Bitmap, MDL_GEN_DATA_SIZE, 256);
+	FileWriteBlock(&ptrFile, Bitmap, MDL_GEN_DATA_SIZE);
 
-		printf("\nProcessing file: %s\n", argv[2]);
+	// Sequences
+	for (ulong i = 0; i < ModelHeader.SeqCount; i++)
+	{
+		memset(&Seq, 0x00, sizeof(Seq));
+		snprintf(Seq.Name, sizeof(Seq.Name), "seq%03lu", (unsigned long)i);
+		Seq.Num = 0;
+		FileWriteBlock(&ptrFile, &Seq, sizeof(Seq));
+	}
 
-		if (!strcmp(".mdl", cFileExtension) || !strcmp(".dol", cFileExtension))
-			SeqReport(argv[2]);
-		else
-			puts("Wrong file extension.");
+	// Texture table (first texture is the biggest one) and skin table
+	Offset = ModelHeader.TextureDataOffset;
+	for (ulong i = 0; i < ModelHeader.TextureCount; i++)
+	{
+		Width = (i == 0) ? Spec->Width : CorpusDim(Spec, Spec->Width, true);
+		Height = (i == 0) ? Spec->Height : CorpusDim(Spec, Spec->Height, true);
+		snprintf(cTextureName, sizeof(cTextureName), "tex%02lu.bmp", (unsigned long)i);
+		Textures[i].Update(cTextureName, Width, Height, Offset);
+		Offset += Width * Height + EIGHT_BIT_PALETTE_ELEMENTS_COUNT * MDL_PALETTE_ELEMENT_SIZE;
+		Skin[i] = i;
 	}
-	else
+	FileWriteBlock(&ptrFile, Textures, sizeof(sModelTextureEntry) * Spec->Count);
+	FileWriteBlock(&ptrFile, Skin, sizeof(ushort) * Spec->Count);
+
+	// Textures: bitmap, then palette
+	for (ulong i = 0; i < ModelHeader.TextureCount; i++)
 	{
-		puts("Can't recognise arguments.");
+		BitmapSize = Textures[i].Width * Textures[i].Height + EIGHT_BIT_PALETTE_ELEMENTS_COUNT * MDL_PALETTE_ELEMENT_SIZE;
+		CorpusFill(Spec, Bitmap, BitmapSize, 256);
+		FileWriteBlock(&ptrFile, Bitmap, BitmapSize);
 	}
 
-	//getchar();
-	
-	return 0;
+	// Update model size field
+	ModelHeader.FileSize = FileSize(&ptrFile);
+	FileWriteBlock(&ptrFile, &ModelHeader.FileSize, 0x48, sizeof(ModelHeader.FileSize));	// 0x48 - address of model size field
+	fclose(ptrFile);
+
+	LibFree(Bitmap);
+	LibFree(Textures);
+	LibFree(Skin);
+	return PS2HL_OK;
 }
+
+
+// Texture kernel input: bitmap is restored from Source before each run
+struct sBenchTexture
+{
+	sTexture Texture;
+	uchar * Source;
+	ulong SourceWidth;
+	ulong SourceHeight;
+	ulong Width;				// Target size
+	ulong Height;				//
+};
+
+static void BenchTexturePrepare(void * Ctx)
+{
+	sBenchTexture * Kernel = (sBenchTexture *)Ctx;
+
+	LibFree(Kernel->Texture.Bitmap);
+	Kernel->Texture.Bitmap = (uchar *)LibAlloc(Kernel->SourceWidth * Kernel->SourceHeight);
+	if (Kernel->Texture.Bitmap != NULL)
+		memcpy(Kernel->Texture.Bitmap, Kernel->Source, Kernel->SourceWidth * Kernel->SourceHeight);
+	Kernel->Texture.Width = Kernel->SourceWidth;
+	Kernel->Texture.Height = Kernel->SourceHeight;
+}
+
+static void BenchTileResize(void * Ctx)
+{
+	sBenchTexture * Kernel = (sBenchTexture *)Ctx;
+
+	if (Kernel->Texture.Bitmap != NULL)
+		Kernel->Texture.TileResize(Kernel->Width, Kernel->Height);
+}
+
+static void BenchScaleResize(void * Ctx)
+{
+	sBenchTexture * Kernel = (sBenchTexture *)Ctx;
+
+	if (Kernel->Texture.Bitmap != NULL)
+		Kernel->Texture.ScaleResize(Kernel->Width, Kernel->Height);
+}
+
+static void BenchPaletteReformat(void * Ctx)
+{
+	((sBenchTexture *)Ctx)->Texture.PaletteReformat(MDL_PALETTE_ELEMENT_SIZE);
+}
+
+void BenchKernels(sBench * Bench)
+{
+	sBenchTexture Kernel;
+	uchar Palette[EIGHT_BIT_PALETTE_ELEMENTS_COUNT * MDL_PALETTE_ELEMENT_SIZE];
+	char Case[32];
+	ulong Pixels;
+
+	if (BenchWants(Bench, "mdl.") == false)
+		return;
+
+	memset(&Kernel, 0x00, sizeof(Kernel));
+	Kernel.Texture.Initialize();
+
+	// Palette of every texture is reformatted on conversion
+	BenchFillImage(Palette, sizeof(Palette), 256, 1);
+	Kernel.Texture.Palette = Palette;
+	Kernel.Texture.PaletteSize = sizeof(Palette);
+	BenchRun(Bench, "mdl.PaletteReformat", "256 rgb", EIGHT_BIT_PALETTE_ELEMENTS_COUNT, sizeof(Palette), NULL, BenchPaletteReformat, &Kernel);
+	Kernel.Texture.Palette = NULL;
+
+	// Textures of odd sizes are resized up to power of two (from 3/4 of it here)
+	for (int i = 0; i < BENCH_DIM_COUNT; i++)
+	{
+		Kernel.Width = BenchDims[i];
+		Kernel.Height = BenchDims[i];
+		Kernel.SourceWidth = BenchDims[i] * 3 / 4;
+		Kernel.SourceHeight = BenchDims[i] * 3 / 4;
+		Kernel.Source = (uchar *)LibAlloc(Kernel.SourceWidth * Kernel.SourceHeight);
+		if (Kernel.Source == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			return;
+		}
+		BenchFillImage(Kernel.Source, Kernel.SourceWidth * Kernel.SourceHeight, 256, i + 1);
+
+		Pixels = Kernel.Width * Kernel.Height;
+		snprintf(Case, sizeof(Case), "%lux%lu->%lux%lu", (unsigned long)Kernel.SourceWidth, (unsigned long)Kernel.SourceHeight,
+			(unsigned long)Kernel.Width, (unsigned long)Kernel.Height);
+		BenchRun(Bench, "mdl.TileResize", Case, Pixels, Pixels, BenchTexturePrepare, BenchTileResize, &Kernel);
+		BenchRun(Bench, "mdl.ScaleResize", Case, Pixels, Pixels, BenchTexturePrepare, BenchScaleResize, &Kernel);
+
+		LibFree(Kernel.Texture.Bitmap);
+		Kernel.Texture.Bitmap = NULL;
+		LibFree(Kernel.Source);
+	}
+}
+
+} // namespace mdl
@@ -0,0 +1,157 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains command line front-end of music tool
+//
+
+////////// Includes //////////
+#include "util.h"
+#include "main.h"
+#include "perf.h"
+#include "log.h"
+
+using namespace mus;
+
+int main(int argc, char * argv[])
+{
+
+	// Output info
+	argc = PerfParseArgs(argc, argv);	// --stats, --trace <file>
+	argc = LogParseArgs(argc, argv, false);	// -q, -v, --log-format=jsonl
+	LibSetInteractive(true);
+	LibMsg(MSG_INFO, "%s\n", PROG_TITLE);
+
+	// Check arguments
+	if (argc == 1)
+	{
+		// No arguments - show help screen
+		puts(PROG_INFO);
+		UTIL_WAIT_KEY("Press any key to exit ...");
+	}
+	else if (argc == 2)
+	{
+		char cFileExtension[5];
+
+		FileGetExtension(argv[1], cFileExtension, 5);
+
+		LibMsg(MSG_INFO, "\nProcessing file: %s\n", argv[1]);
+
+		if (!strcmp(".vag", cFileExtension))
+		{
+			if (CheckVAG(argv[1], false) == VAG_PS2)
+			{
+				PatchVAG(argv[1]);
+			}
+			else if (CheckVAG(argv[1], false) == VAG_NORMAL || CheckVAG(argv[1], false) == VAG_UNSUPPORTED)
+			{
+				UnpatchVAG(argv[1]);
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Can't recognise VAG audio file ...\n");
+			}
+		}
+		if (!strcmp(".wav", cFileExtension))
+		{
+			uchar WAVType = CheckWAV(argv[1], false);
+
+			if (WAVType == WAV_PS2)
+			{
+				PatchWAV(argv[1]);
+			}
+			else if (WAVType == WAV_NORMAL || WAVType == WAV_UNSUPPORTED)
+			{
+				UnpatchWAV(argv[1]);
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Can't recognise WAV audio file ...\n");
+			}
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Wrong file extension ...\n");
+		}
+	}
+	else if (argc == 3)
+	{
+		char cFileExtension[5];
+
+		FileGetExtension(argv[2], cFileExtension, 5);
+
+		LibMsg(MSG_INFO, "\nProcessing file: %s\n", argv[2]);
+
+		if (!strcmp(argv[1], "patch") == true)
+		{
+			if (!strcmp(".vag", cFileExtension))
+			{
+				PatchVAG(argv[2]);
+			}
+			else if (!strcmp(".wav", cFileExtension))
+			{
+				uchar WAVType = CheckWAV(argv[2], false);
+
+				// PS2 to Normal
+				if (WAVType == WAV_PS2)
+					PatchWAV(argv[2]);
+				else if (WAVType == WAV_NORMAL || WAV_UNSUPPORTED)
+					LibMsg(MSG_WARN, "File is already in normal format ...\n");
+				else
+					LibMsg(MSG_ERROR, "Bad file ...\n");
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Wrong file extension ...\n");
+			}
+		}
+		else if (!strcmp(argv[1], "unpatch") == true)
+		{
+			if (!strcmp(".vag", cFileExtension))
+			{
+				UnpatchVAG(argv[2]);
+			}
+			else if (!strcmp(".wav", cFileExtension))
+			{
+				uchar WAVType = CheckWAV(argv[2], false);
+
+				// Normal to PS2
+				if (WAVType == WAV_NORMAL || WAVType == WAV_UNSUPPORTED)
+					UnpatchWAV(argv[2]);	
+				else if (WAVType == WAV_PS2)
+					LibMsg(MSG_WARN, "File is already in PS2 format ...\n");
+				else
+					LibMsg(MSG_ERROR, "Bad file ...\n");
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Wrong file extension ...\n");
+			}
+		}
+		else if (!strcmp(argv[1], "test") == true)
+		{
+			if (!strcmp(".vag", cFileExtension))
+			{
+				CheckVAG(argv[2], true);
+			}
+			else if (!strcmp(".wav", cFileExtension))
+			{
+				CheckWAV(argv[2], true);
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Wrong file extension ...\n");
+			}
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Wrong arguments ...\n");
+		}
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Can't recognise arguments ...\n");
+	}
+	
+	return 0;
+}
@@ -5,14 +5,14 @@
 // This file contains all definitions and declarations
 //
 
-#ifndef MAIN_H
-#define MAIN_H
+#ifndef MUSTOOL_MAIN_H
+#define MUSTOOL_MAIN_H
 
 ////////// Includes??? //////////
 #include <stdio.h>		// puts(), printf(), sscanf(), snprintf()
 #include <string.h>		// strcpy(), strcat(), strlen(), strtok(), strncpy()
 #include <malloc.h>		// malloc(), free()
-#include <stdlib.h>		// exit()
+#include <stdlib.h>		// exit() (front-end only)
 #include <math.h>		// round(), ceil()
 #include <ctype.h>		// tolower()
 
@@ -48,6 +48,17 @@ For more info check out readme.txt\n\
 
 ////////// Functions //////////
 #include "fops.h"
+#include "ps2hl.h"
+
+namespace mus
+{
+
+int PatchVAG(const char * FileName);						// Add header to VAG file (normal format)
+int UnpatchVAG(const char * FileName);						// Remove header from VAG file (PS2 HL music format)
+uchar CheckVAG(const char * FileName, bool PrintInfo);		// Check VAG audio file type
+int UnpatchWAV(const char * FileName);						// Remove header from WAV file
+int PatchWAV(const char * FileName);						// Add header to WAV file
+uchar CheckWAV(const char * FileName, bool PrintInfo);		// Check WAV audio file type
 
 ////////// Structures //////////
 
@@ -402,4 +413,6 @@ union uWAVHeader
 	}
 };
 
-#endif // MAIN_H
+} // namespace mus
+
+#endif // MUSTOOL_MAIN_H
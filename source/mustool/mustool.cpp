@@ -8,17 +8,15 @@
 ////////// Includes //////////
 #include "util.h"
 #include "main.h"
+#include "jobs.h"
+#include "lint.h"
+#include "catalog.h"
+#include "corpus.h"
 
-////////// Functions //////////
-void PatchVAG(const char * FileName);						// Add header to VAG file (normal format)
-void UnpatchVAG(const char * FileName);						// Remove header from VAG file (PS2 HL music format)
-uchar CheckVAG(const char * FileName, bool PrintInfo);		// Check VAG audio file type
-void UnpatchWAV(const char * FileName);						// Remove header from WAV file
-void PatchWAV(const char * FileName);						// Add header to WAV file
-uchar CheckWAV(const char * FileName, bool PrintInfo);		// Check WAV audio file type
-
+namespace mus
+{
 
-void UnpatchVAG(const char * FileName)		// Remove header from VAG file (PS2 HL music format)
+int UnpatchVAG(const char * FileName)		// Remove header from VAG file (PS2 HL music format)
 {
 	FILE * ptrInFile;		// Input file stream
 	FILE * ptrOutFile;		// Output file stream
@@ -28,7 +26,8 @@ void UnpatchVAG(const char * FileName)		// Remove header from VAG file (PS2 HL m
 	ulong AudioDataSize;	// Size of audio data
 
 	// Open file
-	SafeFileOpen(&ptrInFile, FileName, "rb");
+	if (FileOpen(&ptrInFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Get header from file
 	VAGHeader.UpdateFromFile(&ptrInFile);
@@ -37,50 +36,63 @@ void UnpatchVAG(const char * FileName)		// Remove header from VAG file (PS2 HL m
 	// Check VAG
 	if (VAGHeader.CheckType() == VAG_NORMAL)
 	{
-		printf("Internal name: \"%s\", Channels: %i, Sampling frequency: %i \n", VAGHeader.Name, (VAGHeader.Channels == 0 ? 1 : VAGHeader.Channels), VAGHeader.SamplingF);
+		LibMsg(MSG_INFO, "Internal name: \"%s\", Channels: %i, Sampling frequency: %i \n", VAGHeader.Name, (VAGHeader.Channels == 0 ? 1 : VAGHeader.Channels), VAGHeader.SamplingF);
 	}
 	else if (VAGHeader.CheckType() == VAG_UNSUPPORTED)
 	{
-		printf("Internal name: \"%s\", Channels: %i, Sampling frequency: %i \n", VAGHeader.Name, (VAGHeader.Channels == 0 ? 1 : VAGHeader.Channels), VAGHeader.SamplingF);
-		printf("Warning: PS2 HL supports only 1 channel 44100 Hz audio. \nYou may encounter problems with this file. \n");
-		UTIL_WAIT_KEY("Press any key to confirm ...");
+		LibMsg(MSG_INFO, "Internal name: \"%s\", Channels: %i, Sampling frequency: %i \n", VAGHeader.Name, (VAGHeader.Channels == 0 ? 1 : VAGHeader.Channels), VAGHeader.SamplingF);
+		LibMsg(MSG_WARN | MSG_CONFIRM, "Warning: PS2 HL supports only 1 channel 44100 Hz audio. \nYou may encounter problems with this file. \n");
 	}
 	else if (VAGHeader.CheckType() == VAG_PS2)
 	{
-		puts("File already in PS2 music format ...");
-		return;
+		LibMsg(MSG_INFO, "File already in PS2 music format ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_SKIP;
 	}
 	else
 	{
-		puts("Incorrect VAG music file ...");
-		return;
+		LibMsg(MSG_ERROR, "Incorrect VAG music file ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_FORMAT;
 	}
-	puts("Unpatching VAG music file ...");
+	LibMsg(MSG_INFO, "Unpatching VAG music file ...\n");
 
 	// Read audio data
 	AudioDataSize = FileSize(&ptrInFile) - sizeof(sVAGHeader);
-	AudioData = (uchar *)malloc(AudioDataSize);
+	AudioData = (uchar *)LibAlloc(AudioDataSize);
+	if (AudioData == NULL)
+	{
+		LibMsg(MSG_ERROR, "Can't allocate memory ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_MEMORY;
+	}
 	FileReadBlock(&ptrInFile, AudioData, sizeof(sVAGHeader), AudioDataSize);
 
 	// Close input file
 	fclose(ptrInFile);
 
 	// Open output file (same as input)
-	SafeFileOpen(&ptrOutFile, FileName, "wb");
+	if (FileOpen(&ptrOutFile, FileName, "wb") == false)
+	{
+		LibFree(AudioData);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Write audio data only
 	FileWriteBlock(&ptrOutFile, AudioData, AudioDataSize);
 
 	// Free memory
-	free(AudioData);
+	LibFree(AudioData);
 
 	// Close output file
 	fclose(ptrOutFile);
 
-	puts("Done \n");
+	LibMsg(MSG_INFO, "Done \n\n");
+
+	return PS2HL_OK;
 }
 
-void PatchVAG(const char * FileName)	// Add header to VAG file (normal format)
+int PatchVAG(const char * FileName)	// Add header to VAG file (normal format)
 {
 	FILE * ptrInFile;		// Input file stream
 	FILE * ptrOutFile;		// Output file stream
@@ -91,7 +103,8 @@ void PatchVAG(const char * FileName)	// Add header to VAG file (normal format)
 	ulong AudioDataSize;	// Size of audio data
 
 	// Open file
-	SafeFileOpen(&ptrInFile, FileName, "rb");
+	if (FileOpen(&ptrInFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Get header from file
 	VAGHeader.UpdateFromFile(&ptrInFile);
@@ -100,29 +113,41 @@ void PatchVAG(const char * FileName)	// Add header to VAG file (normal format)
 	// Check VAG
 	if (VAGHeader.CheckType() == VAG_PS2)
 	{
-		puts("Patching PS2 VAG music file ...");
+		LibMsg(MSG_INFO, "Patching PS2 VAG music file ...\n");
 	}
 	else if (VAGHeader.CheckType() == VAG_NORMAL || VAGHeader.CheckType() == VAG_UNSUPPORTED)
 	{
-		puts("This file is already patched ...");
-		return;
+		LibMsg(MSG_INFO, "This file is already patched ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_SKIP;
 	}
 	else
 	{
-		puts("Incorrect VAG music file ...");
-		return;
+		LibMsg(MSG_ERROR, "Incorrect VAG music file ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Read audio data
 	AudioDataSize = FileSize(&ptrInFile);
-	AudioData = (uchar *)malloc(AudioDataSize);
+	AudioData = (uchar *)LibAlloc(AudioDataSize);
+	if (AudioData == NULL)
+	{
+		LibMsg(MSG_ERROR, "Can't allocate memory ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_MEMORY;
+	}
 	FileReadBlock(&ptrInFile, AudioData, 0, AudioDataSize);
 
 	// Close input file
 	fclose(ptrInFile);
 
 	// Open output file (same as input)
-	SafeFileOpen(&ptrOutFile, FileName, "wb");
+	if (FileOpen(&ptrOutFile, FileName, "wb") == false)
+	{
+		LibFree(AudioData);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Update header
 	FileGetName(FileName, cNewVAGName, sizeof(cNewVAGName), false);
@@ -134,12 +159,14 @@ void PatchVAG(const char * FileName)	// Add header to VAG file (normal format)
 	FileWriteBlock(&ptrOutFile, AudioData, AudioDataSize);
 
 	// Free memory
-	free(AudioData);
+	LibFree(AudioData);
 
 	// Close output file
 	fclose(ptrOutFile);
 
-	puts("Done \n");
+	LibMsg(MSG_INFO, "Done \n\n");
+
+	return PS2HL_OK;
 }
 
 uchar CheckVAG(const char * FileName, bool PrintInfo)	// Check VAG audio file type
@@ -149,7 +176,8 @@ uchar CheckVAG(const char * FileName, bool PrintInfo)	// Check VAG audio file ty
 	uchar VAGType;
 
 	// Open file
-	SafeFileOpen(&ptrInputFile, FileName, "rb");
+	if (FileOpen(&ptrInputFile, FileName, "rb") == false)
+		return UNKNOWN_FILE;
 
 	// Check type
 	VAGHeader.UpdateFromFile(&ptrInputFile);
@@ -161,17 +189,17 @@ uchar CheckVAG(const char * FileName, bool PrintInfo)	// Check VAG audio file ty
 	{
 		if (VAGType == VAG_NORMAL || VAGType == VAG_UNSUPPORTED)
 		{
-			puts("Type: normal VAG music file.");
-			printf("Internal name: \"%s\", Channels: %i, Sampling frequency: %i \n", VAGHeader.Name, (VAGHeader.Channels == 0? 1 : VAGHeader.Channels), VAGHeader.SamplingF);
+			LibMsg(MSG_INFO, "Type: normal VAG music file.\n");
+			LibMsg(MSG_INFO, "Internal name: \"%s\", Channels: %i, Sampling frequency: %i \n", VAGHeader.Name, (VAGHeader.Channels == 0? 1 : VAGHeader.Channels), VAGHeader.SamplingF);
 		}
 		else if (VAGType == VAG_PS2)
 		{
-			puts("Type: PS2 Half-Life VAG music file.");
-			puts("PS2 HL supports only 1 channel 44100 Hz audio.");
+			LibMsg(MSG_INFO, "Type: PS2 Half-Life VAG music file.\n");
+			LibMsg(MSG_INFO, "PS2 HL supports only 1 channel 44100 Hz audio.\n");
 		}
 		else
 		{
-			puts("Type: incorrect VAG music file.");
+			LibMsg(MSG_INFO, "Type: incorrect VAG music file.\n");
 		}
 	}
 
@@ -181,7 +209,7 @@ uchar CheckVAG(const char * FileName, bool PrintInfo)	// Check VAG audio file ty
 	return VAGType;
 }
 
-void UnpatchWAV(const char * FileName)		// Remove header from WAV file
+int UnpatchWAV(const char * FileName)		// Remove header from WAV file
 {
 	FILE * ptrInFile;		// Input file stream
 	FILE * ptrOutFile;		// Output file stream
@@ -191,7 +219,8 @@ void UnpatchWAV(const char * FileName)		// Remove header from WAV file
 	ulong AudioDataSize;	// Size of audio data
 
 	// Open file
-	SafeFileOpen(&ptrInFile, FileName, "rb");
+	if (FileOpen(&ptrInFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Get header from file
 	WAVHeader.UpdateFromNormal(&ptrInFile);
@@ -199,35 +228,41 @@ void UnpatchWAV(const char * FileName)		// Remove header from WAV file
 	// Check type
 	if (WAVHeader.CheckType(FileSize(&ptrInFile)) == WAV_NORMAL)
 	{
-		printf("Normal WAV: Channels: %i, Sampling frequency: %i, BitsPerSample: %i \n",
+		LibMsg(MSG_INFO, "Normal WAV: Channels: %i, Sampling frequency: %i, BitsPerSample: %i \n",
 			WAVHeader.Normal.WaveChunk.Channels,
 			WAVHeader.Normal.WaveChunk.SamplingF,
 			WAVHeader.Normal.WaveChunk.BitsPerSample);
 	}
 	else if (WAVHeader.CheckType(FileSize(&ptrInFile)) == WAV_UNSUPPORTED)
 	{
-		printf("Channels: %i, Sampling frequency: %i, BitsPerSample: %i \n",
+		LibMsg(MSG_INFO, "Channels: %i, Sampling frequency: %i, BitsPerSample: %i \n",
 			WAVHeader.Normal.WaveChunk.Channels,
 			WAVHeader.Normal.WaveChunk.SamplingF,
 			WAVHeader.Normal.WaveChunk.BitsPerSample);
-		printf("Warning: PS2 HL supports only 8-bit 1 channel 11025/22050/44100 Hz audio. \nYou may encounter problems with this file. \n");
-		UTIL_WAIT_KEY("Press any key to confirm ...");
+		LibMsg(MSG_WARN | MSG_CONFIRM, "Warning: PS2 HL supports only 8-bit 1 channel 11025/22050/44100 Hz audio. \nYou may encounter problems with this file. \n");
 	}
 	else
 	{
-		puts("Bad WAV file ...");
-		return;
+		LibMsg(MSG_ERROR, "Bad WAV file ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	if (WAVHeader.Normal.Looped == true)
-		printf("Looped sound detected, start sample: %d \n", WAVHeader.Normal.LoopStart);
+		LibMsg(MSG_INFO, "Looped sound detected, start sample: %d \n", WAVHeader.Normal.LoopStart);
 
-	puts("Unpatching WAV music file ...");
+	LibMsg(MSG_INFO, "Unpatching WAV music file ...\n");
 
 	// Read audio data
 	AudioDataSize = WAVHeader.Normal.DataChunk.DataSize + 16 -
 		(WAVHeader.Normal.DataChunk.DataSize + sizeof(sPS2WAVHeader)) % 16;	// Audio data should be aligned within 16-byte blocks
-	AudioData = (uchar *)malloc(AudioDataSize);
+	AudioData = (uchar *)LibAlloc(AudioDataSize);
+	if (AudioData == NULL)
+	{
+		LibMsg(MSG_ERROR, "Can't allocate memory ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_MEMORY;
+	}
 	memset(AudioData, 0x00, AudioDataSize);
 	FileReadBlock(&ptrInFile, AudioData, WAVHeader.Normal.DataOffset, WAVHeader.Normal.DataChunk.DataSize);
 
@@ -235,7 +270,11 @@ void UnpatchWAV(const char * FileName)		// Remove header from WAV file
 	fclose(ptrInFile);
 
 	// Open output file (same as input)
-	SafeFileOpen(&ptrOutFile, FileName, "wb");
+	if (FileOpen(&ptrOutFile, FileName, "wb") == false)
+	{
+		LibFree(AudioData);
+		return PS2HL_ERR_OPEN;
+	}
 	
 	// Convert header
 	WAVHeader.ConvertToPS2();
@@ -249,15 +288,17 @@ void UnpatchWAV(const char * FileName)		// Remove header from WAV file
 	FileWriteBlock(&ptrOutFile, AudioData, AudioDataSize);
 
 	// Free memory
-	free(AudioData);
+	LibFree(AudioData);
 
 	// Close output file
 	fclose(ptrOutFile);
 
-	puts("Done \n");
+	LibMsg(MSG_INFO, "Done \n\n");
+
+	return PS2HL_OK;
 }
 
-void PatchWAV(const char * FileName)	// Add header to WAV file
+int PatchWAV(const char * FileName)	// Add header to WAV file
 {
 	FILE * ptrInFile;		// Input file stream
 	FILE * ptrOutFile;		// Output file stream
@@ -267,7 +308,8 @@ void PatchWAV(const char * FileName)	// Add header to WAV file
 	ulong AudioDataSize;	// Size of audio data
 
 	// Open file
-	SafeFileOpen(&ptrInFile, FileName, "rb");
+	if (FileOpen(&ptrInFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Get header from file
 	WAVHeader.UpdateFromPS2(&ptrInFile);
@@ -275,27 +317,38 @@ void PatchWAV(const char * FileName)	// Add header to WAV file
 	// Check type
 	if (WAVHeader.CheckType(FileSize(&ptrInFile)) == WAV_PS2)
 	{
-		printf("PS2 WAV: Sampling frequency: %i \n", WAVHeader.PS2.SamplingF);
+		LibMsg(MSG_INFO, "PS2 WAV: Sampling frequency: %i \n", WAVHeader.PS2.SamplingF);
 		if (WAVHeader.PS2.LoopStart != PS2_WAV_NOLOOP)
-			printf("Looped sound detected, start sample: %d \n", WAVHeader.PS2.LoopStart);
+			LibMsg(MSG_INFO, "Looped sound detected, start sample: %d \n", WAVHeader.PS2.LoopStart);
 	}
 	else
 	{
-		puts("Bad PS2 WAV file ...");
-		return;
+		LibMsg(MSG_ERROR, "Bad PS2 WAV file ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_FORMAT;
 	}
-	puts("Patching PS2 WAV audio file ...");
+	LibMsg(MSG_INFO, "Patching PS2 WAV audio file ...\n");
 
 	// Read audio data
 	AudioDataSize = WAVHeader.PS2.DataSize;
-	AudioData = (uchar *)malloc(AudioDataSize);
+	AudioData = (uchar *)LibAlloc(AudioDataSize);
+	if (AudioData == NULL)
+	{
+		LibMsg(MSG_ERROR, "Can't allocate memory ...\n");
+		fclose(ptrInFile);
+		return PS2HL_ERR_MEMORY;
+	}
 	FileReadBlock(&ptrInFile, AudioData, sizeof(sPS2WAVHeader), AudioDataSize);
 
 	// Close input file
 	fclose(ptrInFile);
 
 	// Open output file (same as input)
-	SafeFileOpen(&ptrOutFile, FileName, "wb");
+	if (FileOpen(&ptrOutFile, FileName, "wb") == false)
+	{
+		LibFree(AudioData);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Convert header
 	WAVHeader.ConvertToNormal();
@@ -309,11 +362,13 @@ void PatchWAV(const char * FileName)	// Add header to WAV file
 	sLOOP * LoopChunk = NULL;
 	if (WAVHeader.Normal.Looped == true)
 	{
-		LoopChunk = (sLOOP *) malloc(sizeof(sLOOP));
+		LoopChunk = (sLOOP *) LibAlloc(sizeof(sLOOP));
 		if (LoopChunk == NULL)
 		{
-			puts("Can't allocate memory ...");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Can't allocate memory ...\n");
+			LibFree(AudioData);
+			fclose(ptrOutFile);
+			return PS2HL_ERR_MEMORY;
 		}
 		LoopChunk->Init(WAVHeader.Normal.DataChunk.DataSize, WAVHeader.Normal.LoopStart);
 		WAVHeader.Normal.RiffChunk.RiffSize += sizeof(sLOOP);
@@ -328,16 +383,18 @@ void PatchWAV(const char * FileName)	// Add header to WAV file
 		if (Spacer)
 			fputc(0x00, ptrOutFile);
 		FileWriteBlock(&ptrOutFile, LoopChunk, sizeof(sLOOP));
-		free(LoopChunk);
+		LibFree(LoopChunk);
 	}
 
 	// Free memory
-	free(AudioData);
+	LibFree(AudioData);
 
 	// Close output file
 	fclose(ptrOutFile);
 
-	puts("Done \n");
+	LibMsg(MSG_INFO, "Done \n\n");
+
+	return PS2HL_OK;
 }
 
 uchar CheckWAV(const char * FileName, bool PrintInfo)	// Check WAV audio file type
@@ -347,7 +404,8 @@ uchar CheckWAV(const char * FileName, bool PrintInfo)	// Check WAV audio file ty
 	uchar NormWAVType, PS2WAVType;
 
 	// Open file
-	SafeFileOpen(&ptrInputFile, FileName, "rb");
+	if (FileOpen(&ptrInputFile, FileName, "rb") == false)
+		return UNKNOWN_FILE;
 
 	// Check type
 	NormWAVHeader.UpdateFromNormal(&ptrInputFile);
@@ -363,8 +421,8 @@ uchar CheckWAV(const char * FileName, bool PrintInfo)	// Check WAV audio file ty
 	{
 		if (PrintInfo == true)
 		{
-			puts("Type: normal WAV audio file.");
-			printf("Channels: %i, Sampling frequency: %i, BitsPerSample: %i \n",
+			LibMsg(MSG_INFO, "Type: normal WAV audio file.\n");
+			LibMsg(MSG_INFO, "Channels: %i, Sampling frequency: %i, BitsPerSample: %i \n",
 				NormWAVHeader.Normal.WaveChunk.Channels,
 				NormWAVHeader.Normal.WaveChunk.SamplingF,
 				NormWAVHeader.Normal.WaveChunk.BitsPerSample);
@@ -376,8 +434,8 @@ uchar CheckWAV(const char * FileName, bool PrintInfo)	// Check WAV audio file ty
 	{
 		if (PrintInfo == true)
 		{
-			puts("Type: PS2 Half-Life WAV audio file with compressed header.");
-			printf("Sampling frequency: %i \n", PS2WAVHeader.PS2.SamplingF);
+			LibMsg(MSG_INFO, "Type: PS2 Half-Life WAV audio file with compressed header.\n");
+			LibMsg(MSG_INFO, "Sampling frequency: %i \n", PS2WAVHeader.PS2.SamplingF);
 		}
 
 		return WAV_PS2;
@@ -385,7 +443,7 @@ uchar CheckWAV(const char * FileName, bool PrintInfo)	// Check WAV audio file ty
 	else
 	{
 		if (PrintInfo == true)
-			puts("Type: bad WAV file");
+			LibMsg(MSG_INFO, "Type: bad WAV file\n");
 
 		return WAV_UNSUPPORTED;
 	}
@@ -393,146 +451,259 @@ uchar CheckWAV(const char * FileName, bool PrintInfo)	// Check WAV audio file ty
 	return 0;
 }
 
-int main(int argc, char * argv[])
-{
-	FILE * ptrInputFile;
-	FILE * ptrConfigFile;
-	char ConfigFilePath[PATH_LEN];
-	char Line[80];
 
-	// Output info
-	puts(PROG_TITLE);
+////////// Batch jobs //////////
+int RunJob(const char * Command, const char * FileName)
+{
+	char cFileExtension[5];
+	uchar Type;
+	bool IsVAG;
 
-	// Check arguments
-	if (argc == 1)
+	FileGetExtension(FileName, cFileExtension, sizeof(cFileExtension));
+	if (strcmp(".vag", cFileExtension) && strcmp(".wav", cFileExtension))
 	{
-		// No arguments - show help screen
-		puts(PROG_INFO);
-		UTIL_WAIT_KEY("Press any key to exit ...");
+		LibMsg(MSG_ERROR, "Wrong file extension ...\n");
+		return PS2HL_ERR_PARAM;
 	}
-	else if (argc == 2)
+	IsVAG = !strcmp(".vag", cFileExtension);
+
+	LibMsg(MSG_INFO, "\nProcessing file: %s\n", FileName);
+
+	// Print info
+	if (!strcmp(Command ? Command : "", "test"))
 	{
-		char cFileExtension[5];
+		Type = IsVAG ? CheckVAG(FileName, true) : CheckWAV(FileName, true);
+		return (Type == (uchar)UNKNOWN_FILE) ? PS2HL_ERR_FORMAT : PS2HL_OK;
+	}
 
-		FileGetExtension(argv[1], cFileExtension, 5);
+	Type = IsVAG ? CheckVAG(FileName, false) : CheckWAV(FileName, false);
+	if (Type == (uchar)UNKNOWN_FILE)
+	{
+		LibMsg(MSG_ERROR, "Bad file ...\n");
+		return PS2HL_ERR_FORMAT;
+	}
 
-		printf("\nProcessing file: %s\n", argv[1]);
+	// Default action - toggle format (VAG_* and WAV_* values match)
+	if (JobIsAuto(Command) == true)
+	{
+		if (Type == VAG_PS2)
+			return IsVAG ? PatchVAG(FileName) : PatchWAV(FileName);
+		else
+			return IsVAG ? UnpatchVAG(FileName) : UnpatchWAV(FileName);
+	}
 
-		if (!strcmp(".vag", cFileExtension))
-		{
-			if (CheckVAG(argv[1], false) == VAG_PS2)
-			{
-				PatchVAG(argv[1]);
-			}
-			else if (CheckVAG(argv[1], false) == VAG_NORMAL || CheckVAG(argv[1], false) == VAG_UNSUPPORTED)
-			{
-				UnpatchVAG(argv[1]);
-			}
-			else
-			{
-				puts("Can't recognise VAG audio file ...");
-			}
-		}
-		if (!strcmp(".wav", cFileExtension))
+	// PS2 to normal
+	if (!strcmp(Command, "patch"))
+	{
+		if (Type != VAG_PS2)
 		{
-			uchar WAVType = CheckWAV(argv[1], false);
-
-			if (WAVType == WAV_PS2)
-			{
-				PatchWAV(argv[1]);
-			}
-			else if (WAVType == WAV_NORMAL || WAVType == WAV_UNSUPPORTED)
-			{
-				UnpatchWAV(argv[1]);
-			}
-			else
-			{
-				puts("Can't recognise WAV audio file ...");
-			}
+			LibMsg(MSG_WARN, "File is already in normal format ...\n");
+			return PS2HL_ERR_SKIP;
 		}
-		else
+		return IsVAG ? PatchVAG(FileName) : PatchWAV(FileName);
+	}
+
+	// Normal to PS2
+	if (!strcmp(Command, "unpatch"))
+	{
+		if (Type == VAG_PS2)
 		{
-			puts("Wrong file extension ...");
+			LibMsg(MSG_WARN, "File is already in PS2 format ...\n");
+			return PS2HL_ERR_SKIP;
 		}
+		return IsVAG ? UnpatchVAG(FileName) : UnpatchWAV(FileName);
 	}
-	else if (argc == 3)
+
+	LibMsg(MSG_ERROR, "Can't recognise command: %s \n", Command);
+	return PS2HL_ERR_PARAM;
+}
+
+const char * JobVersion()
+{
+	return PROG_TITLE;
+}
+
+bool SniffFile(const char * FileName)
+{
+	char cFileExtension[5];
+
+	FileGetExtension(FileName, cFileExtension, sizeof(cFileExtension));
+	if (!strcmp(".vag", cFileExtension))
+		return CheckVAG(FileName, false) != (uchar)UNKNOWN_FILE;
+	if (!strcmp(".wav", cFileExtension))
+		return CheckWAV(FileName, false) != (uchar)UNKNOWN_FILE;
+
+	return false;
+}
+
+int LintFile(const char * FileName, sLintFile * Lint)
+{
+	char cFileExtension[5];
+	FILE * ptrFile;
+	uchar Type;
+
+	// Check* functions can't tell unreadable file from bad one
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	fclose(ptrFile);
+
+	FileGetExtension(FileName, cFileExtension, sizeof(cFileExtension));
+	if (!strcmp(".vag", cFileExtension))
+	{
+		Type = CheckVAG(FileName, false);
+		if (Type == (uchar)UNKNOWN_FILE)
+			LintReport(Lint, LINT_ERROR, "not a VAG file");
+		else if (Type == VAG_UNSUPPORTED)
+			LintReport(Lint, LINT_ERROR, "PS2 HL plays only 44100 Hz mono VAG");
+	}
+	else
 	{
-		char cFileExtension[5];
+		Type = CheckWAV(FileName, false);
+		if (Type == (uchar)UNKNOWN_FILE || Type == WAV_UNSUPPORTED)
+			LintReport(Lint, LINT_ERROR, "bad WAV, PS2 HL plays only 8-bit mono 11025, 22050 or 44100 Hz");
+	}
+
+	return PS2HL_OK;
+}
 
-		FileGetExtension(argv[2], cFileExtension, 5);
+int DescribeFile(const char * FileName, sCatalogInfo * Info)
+{
+	char cFileExtension[5];
+	FILE * ptrFile;
+	sVAGHeader VAGHeader;
+	uWAVHeader NormWAVHeader, PS2WAVHeader;
+	ulong Size;
+	uchar Type;
 
-		printf("\nProcessing file: %s\n", argv[2]);
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	Size = FileSize(&ptrFile);
 
-		if (!strcmp(argv[1], "patch") == true)
+	// Same checks as in CheckVAG() and CheckWAV(), but values are kept
+	FileGetExtension(FileName, cFileExtension, sizeof(cFileExtension));
+	if (!strcmp(".vag", cFileExtension))
+	{
+		memset(&VAGHeader, 0x00, sizeof(VAGHeader));
+		VAGHeader.UpdateFromFile(&ptrFile);
+		VAGHeader.SwapEndian();
+		Type = VAGHeader.CheckType();
+		if (Type == VAG_PS2)
+		{
+			// Headerless: PS2 HL plays only this
+			Info->PS2 = 1;
+			Info->Rate = 44100;
+			Info->Channels = 1;
+		}
+		else if (Type != (uchar)UNKNOWN_FILE)
 		{
-			if (!strcmp(".vag", cFileExtension))
-			{
-				PatchVAG(argv[2]);
-			}
-			else if (!strcmp(".wav", cFileExtension))
-			{
-				uchar WAVType = CheckWAV(argv[2], false);
-
-				// PS2 to Normal
-				if (WAVType == WAV_PS2)
-					PatchWAV(argv[2]);
-				else if (WAVType == WAV_NORMAL || WAV_UNSUPPORTED)
-					puts("File is already in normal format ...");
-				else
-					puts("Bad file ...");
-			}
-			else
-			{
-				puts("Wrong file extension ...");
-			}
+			Info->Rate = VAGHeader.SamplingF;
+			Info->Channels = (VAGHeader.Channels == 0) ? 1 : VAGHeader.Channels;
 		}
-		else if (!strcmp(argv[1], "unpatch") == true)
+	}
+	else
+	{
+		NormWAVHeader.UpdateFromNormal(&ptrFile);
+		PS2WAVHeader.UpdateFromPS2(&ptrFile);
+		Type = NormWAVHeader.CheckType(Size);
+		if (Type == WAV_NORMAL || Type == WAV_UNSUPPORTED)
 		{
-			if (!strcmp(".vag", cFileExtension))
-			{
-				UnpatchVAG(argv[2]);
-			}
-			else if (!strcmp(".wav", cFileExtension))
-			{
-				uchar WAVType = CheckWAV(argv[2], false);
-
-				// Normal to PS2
-				if (WAVType == WAV_NORMAL || WAVType == WAV_UNSUPPORTED)
-					UnpatchWAV(argv[2]);	
-				else if (WAVType == WAV_PS2)
-					puts("File is already in PS2 format ...");
-				else
-					puts("Bad file ...");
-			}
-			else
-			{
-				puts("Wrong file extension ...");
-			}
+			Info->Rate = NormWAVHeader.Normal.WaveChunk.SamplingF;
+			Info->Channels = NormWAVHeader.Normal.WaveChunk.Channels;
+			Info->Bits = NormWAVHeader.Normal.WaveChunk.BitsPerSample;
 		}
-		else if (!strcmp(argv[1], "test") == true)
+		else if (PS2WAVHeader.CheckType(Size) == WAV_PS2)
 		{
-			if (!strcmp(".vag", cFileExtension))
-			{
-				CheckVAG(argv[2], true);
-			}
-			else if (!strcmp(".wav", cFileExtension))
-			{
-				CheckWAV(argv[2], true);
-			}
-			else
-			{
-				puts("Wrong file extension ...");
-			}
+			Type = WAV_PS2;
+			Info->PS2 = 1;
+			Info->Rate = PS2WAVHeader.PS2.SamplingF;
+			Info->Channels = 1;
+			Info->Bits = 8;
 		}
 		else
 		{
-			puts("Wrong arguments ...");
+			Type = (uchar)UNKNOWN_FILE;
 		}
 	}
+	fclose(ptrFile);
+
+	return (Type == (uchar)UNKNOWN_FILE) ? PS2HL_ERR_FORMAT : PS2HL_OK;
+}
+
+int GenerateFile(const char * FileName, sCorpusSpec * Spec)
+{
+	FILE * ptrFile;
+	sVAGHeader VAGHeader;
+	uWAVHeader WAVHeader;
+	char cFileExtension[5];
+	char cName[64];
+	uchar * AudioData;
+	ulong AudioDataSize;
+	ulong Period;
+	long Value;
+
+	FileGetExtension(FileName, cFileExtension, sizeof(cFileExtension));
+	if (strcmp(".vag", cFileExtension) && strcmp(".wav", cFileExtension))
+		return PS2HL_ERR_PARAM;
+
+	// VAG - ADPCM blocks of 28 samples (first one is silent, last one has end flag), WAV - 8-bit mono PCM
+	if (!strcmp(".vag", cFileExtension))
+		AudioDataSize = (Spec->Samples / 28 + 2) * 16;
 	else
+		AudioDataSize = Spec->Samples;
+	AudioData = (uchar *)LibAlloc(AudioDataSize);
+	if (AudioData == NULL)
 	{
-		puts("Can't recognise arguments ...");
+		LibMsg(MSG_ERROR, "Can't allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
 	}
-	
-	return 0;
+
+	if (!strcmp(".vag", cFileExtension))
+	{
+		CorpusFill(Spec, AudioData, AudioDataSize, 256);
+		memset(AudioData, 0x00, 16);
+		for (ulong i = 16; i < AudioDataSize; i += 16)
+		{
+			AudioData[i] = (CorpusRange(Spec, 0, 4) << 4) | CorpusRange(Spec, 0, 12);	// Filter and shift
+			AudioData[i + 1] = (i + 16 < AudioDataSize) ? 0 : 1;						// Flags
+		}
+
+		FileGetName(FileName, cName, sizeof(cName), false);
+		VAGHeader.Update(AudioDataSize, cName);
+		VAGHeader.SwapEndian();
+	}
+	else
+	{
+		// Triangle wave with noise
+		Period = CorpusRange(Spec, 16, 256);
+		for (ulong i = 0; i < AudioDataSize; i++)
+		{
+			Value = (long)(i % Period) * 192 / Period;
+			Value = (Value < 96 ? Value : 192 - Value) + 80 + (long)CorpusRange(Spec, 0, 8) - 4;
+			AudioData[i] = (uchar)Value;
+		}
+
+		memset(&WAVHeader, 0x00, sizeof(WAVHeader));
+		WAVHeader.PS2.DataSize = AudioDataSize;
+		WAVHeader.PS2.LoopStart = PS2_WAV_NOLOOP;
+		WAVHeader.PS2.SamplingF = Spec->Rate;
+		WAVHeader.PS2.Magic1 = 1;
+		WAVHeader.ConvertToNormal();
+	}
+
+	if (FileOpen(&ptrFile, FileName, "wb") == false)
+	{
+		LibFree(AudioData);
+		return PS2HL_ERR_OPEN;
+	}
+	if (!strcmp(".vag", cFileExtension))
+		FileWriteBlock(&ptrFile, &VAGHeader, sizeof(sVAGHeader));
+	else
+		FileWriteBlock(&ptrFile, &WAVHeader, WAVHeader.Normal.DataOffset);
+	FileWriteBlock(&ptrFile, AudioData, AudioDataSize);
+	fclose(ptrFile);
+
+	LibFree(AudioData);
+	return PS2HL_OK;
 }
+
+} // namespace mus
@@ -0,0 +1,71 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This module contains command line front-end of NOD tool
+//
+
+////////// Includes //////////
+#include "util.h"
+#include "main.h"				// Main header
+#include "perf.h"
+#include "log.h"
+
+using namespace nod;
+
+int main(int argc, char * argv[])
+{
+	char cExtension[5];
+
+	argc = PerfParseArgs(argc, argv);	// --stats, --trace <file>
+	argc = LogParseArgs(argc, argv, false);	// -q, -v, --log-format=jsonl
+	LibSetInteractive(true);
+
+	LibMsg(MSG_INFO, "%s\n", PROG_TITLE);
+
+	if (argc == 1)
+	{
+		puts(PROG_INFO);
+		UTIL_WAIT_KEY("Press any key to exit ...");
+	}
+	else if (argc == 2)
+	{
+		FileGetExtension(argv[1], cExtension, sizeof(cExtension));
+
+		if (!strcmp(cExtension, ".nod") == true)
+		{
+			if (ConvertNOD(argv[1]) == PS2HL_OK)
+				return 0;
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Unsupported file ...\n");
+		}
+	}
+	else if (argc == 3)
+	{
+		if (!strcmp(argv[1], "test") == true)
+		{
+			FileGetExtension(argv[2], cExtension, sizeof(cExtension));
+			if (!strcmp(cExtension, ".nod") == true)
+			{
+				TestFile(argv[2], true);
+				return 0;
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Unsupported file ...\n");
+			}
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Can't recognise arguments ...\n");
+		}
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Too many arguments ...\n");
+	}
+	
+	return 1;
+}
@@ -5,14 +5,14 @@
 // This file contains all definitions and declarations
 //
 
-#ifndef MAIN_H
-#define MAIN_H
+#ifndef NODTOOL_MAIN_H
+#define NODTOOL_MAIN_H
 
 ////////// Includes //////////
 #include <stdio.h>		// puts(), printf(), sscanf(), snprintf(), rename(), remove()
 #include <string.h>		// strcpy(), strcat(), strlen(), strtok(), strncpy(), memset()
 #include <malloc.h>		// malloc(), free()
-#include <stdlib.h>		// exit()
+#include <stdlib.h>		// exit() (front-end only)
 #include <math.h>		// round(), sqrt(), ceil()
 #include <ctype.h>		// tolower()
 
@@ -36,7 +36,8 @@ enum eNodFormats
 	NOD_FORMAT_PC,
 	NOD_FORMAT_PS2,
 	NOD_ERR_VERSION,
-	NOD_ERR_UNKNOWN
+	NOD_ERR_UNKNOWN,
+	NOD_ERR_MEMORY
 };
 
 // Proper node graph version
@@ -58,6 +59,13 @@ enum eNodFormats
 
 ////////// Functions //////////
 #include "fops.h"
+#include "ps2hl.h"
+
+namespace nod
+{
+
+int TestFile(const char * FileName, bool PrintInfo);		// Check file (returns eNodFormats value)
+int ConvertNOD(const char * FileName);		// Convert PC <-> PS2 in place
 
 ////////// Structures //////////
 #pragma pack(1)				// Fix unwanted 0x00 bytes in structure
@@ -134,11 +142,18 @@ struct sNodeGraph
 	void Deinit()
 	{
 		// Free memory
-		if (CNodes != NULL)		free(CNodes);
-		if (CLinks != NULL)		free(CLinks);
-		if (DistInfo != NULL)	free(DistInfo);
-		if (Routes != NULL)		free(Routes);
-		if (Hashes != NULL)		free(Hashes);
+		LibFree(CNodes);
+		LibFree(CLinks);
+		LibFree(DistInfo);
+		LibFree(Routes);
+		LibFree(Hashes);
+
+		// Reset pointers
+		CNodes = NULL;
+		CLinks = NULL;
+		DistInfo = NULL;
+		Routes = NULL;
+		Hashes = NULL;
 	}
 
 	int LoadAndCheckHeader(FILE **ptrFile)
@@ -186,35 +201,30 @@ struct sNodeGraph
 		// Allocate memory for structures //
 
 		// Nodes
-		if (CNodes != NULL)
-			free(CNodes);
-		CNodes = (sCNode_PS2 *)		calloc(sizeof(sCNode_PS2) * CGraph.NodeCount, 1);
+		LibFree(CNodes);
+		CNodes = (sCNode_PS2 *)		LibCalloc(sizeof(sCNode_PS2) * CGraph.NodeCount, 1);
 
 		// Links
-		if (CLinks != NULL)
-			free(CLinks);
-		CLinks = (sCLink *)			calloc(sizeof(sCLink) * CGraph.LinkCount, 1);
+		LibFree(CLinks);
+		CLinks = (sCLink *)			LibCalloc(sizeof(sCLink) * CGraph.LinkCount, 1);
 
 		// Dists
-		if (DistInfo != NULL)
-			free(DistInfo);
-		DistInfo = (sDIST_INFO *)	calloc(sizeof(sDIST_INFO) * CGraph.NodeCount, 1);
+		LibFree(DistInfo);
+		DistInfo = (sDIST_INFO *)	LibCalloc(sizeof(sDIST_INFO) * CGraph.NodeCount, 1);
 
 		// Routes
-		if (Routes != NULL)
-			free(Routes);
-		Routes = (char *)			calloc(sizeof(char) * CGraph.RouteCount, 1);
+		LibFree(Routes);
+		Routes = (char *)			LibCalloc(sizeof(char) * CGraph.RouteCount, 1);
 
 		// Hashes
-		if (Hashes != NULL)
-			free(Hashes);
-		Hashes = (short *)			calloc(sizeof(short) * CGraph.HashCount, 1);
+		LibFree(Hashes);
+		Hashes = (short *)			LibCalloc(sizeof(short) * CGraph.HashCount, 1);
 
 		// Check allocation
 		if (CNodes == NULL || CLinks == NULL || DistInfo == NULL || Routes == NULL || Hashes == NULL)
 		{
-			UTIL_WAIT_KEY("Unable to allocate memory ...");
-			exit(EXIT_FAILURE);
+			Deinit();
+			return NOD_ERR_MEMORY;
 		}
 
 		// Load structures //
@@ -299,4 +309,6 @@ struct sNodeGraph
 	}
 };
 
-#endif // MAIN_H
+} // namespace nod
+
+#endif // NODTOOL_MAIN_H
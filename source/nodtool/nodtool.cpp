@@ -8,40 +8,48 @@
 ////////// Includes //////////
 #include "util.h"
 #include "main.h"				// Main header
+#include "jobs.h"
+#include "lint.h"
+#include "catalog.h"
+#include "corpus.h"
 
-////////// Functions //////////
-int TestFile(const char * FileName);
-void ConvertNOD(const char * FileName);
+namespace nod
+{
 
-int TestFile(const char * FileName)
+int TestFile(const char * FileName, bool PrintInfo)
 {
 	FILE * ptrFile;
 	sNodeGraph NGraph;
 
-	printf("\nTesting file: %s \n", FileName);
+	if (PrintInfo == true)
+		LibMsg(MSG_INFO, "\nTesting file: %s \n", FileName);
 
 	// Open file for reading
-	SafeFileOpen(&ptrFile, FileName, "rb");
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return NOD_ERR_UNKNOWN;
 
 	// Load and check header
 	NGraph.Init();
 	int Result = NGraph.LoadAndCheckHeader(&ptrFile);
 
 	// Show info
-	switch (Result)
+	if (PrintInfo == true)
 	{
-	case NOD_FORMAT_PC:
-		puts("Proper PC file \n");
-		break;
-	case NOD_FORMAT_PS2:
-		puts("Proper PS2 file \n");
-		break;
-	case NOD_ERR_VERSION:
-		printf("Unknown file: version %d, should be 16 \n\n", NGraph.Version);
-		break;
-	case NOD_ERR_UNKNOWN:
-		puts("Unknown file: size mismatch \n");
-		break;
+		switch (Result)
+		{
+		case NOD_FORMAT_PC:
+			LibMsg(MSG_INFO, "Proper PC file \n\n");
+			break;
+		case NOD_FORMAT_PS2:
+			LibMsg(MSG_INFO, "Proper PS2 file \n\n");
+			break;
+		case NOD_ERR_VERSION:
+			LibMsg(MSG_INFO, "Unknown file: version %d, should be 16 \n\n", NGraph.Version);
+			break;
+		case NOD_ERR_UNKNOWN:
+			LibMsg(MSG_INFO, "Unknown file: size mismatch \n\n");
+			break;
+		}
 	}
 
 	// Close file
@@ -51,43 +59,52 @@ int TestFile(const char * FileName)
 	return Result;
 }
 
-void ConvertNOD(const char * FileName)
+int ConvertNOD(const char * FileName)
 {
 	FILE * ptrFile;
 	sNodeGraph NGraph;
 	int Result;
 
-	printf("\nProcessing file: %s \n", FileName);
+	LibMsg(MSG_INFO, "\nProcessing file: %s \n", FileName);
 
 	// Open file for reading
-	SafeFileOpen(&ptrFile, FileName, "rb");
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Load data
 	NGraph.Init();
 	Result = NGraph.UpdateFromFile(&ptrFile);
 	if (Result == NOD_ERR_VERSION)
 	{
-		printf("Unknown file: version %d, should be 16\n", NGraph.Version);
-		UTIL_WAIT_KEY("Press any key to exit...");
+		LibMsg(MSG_ERROR | MSG_CONFIRM, "Unknown file: version %d, should be 16\n", NGraph.Version);
 		fclose(ptrFile);
-		return;
+		return PS2HL_ERR_FORMAT;
 	}
 	else if (Result == NOD_ERR_UNKNOWN)
 	{
-		puts("Unknown file: size mismatch\n");
-		UTIL_WAIT_KEY("Press any key to exit...");
+		LibMsg(MSG_ERROR | MSG_CONFIRM, "Unknown file: size mismatch\n\n");
 		fclose(ptrFile);
-		return;
+		return PS2HL_ERR_FORMAT;
+	}
+	else if (Result == NOD_ERR_MEMORY)
+	{
+		LibMsg(MSG_ERROR | MSG_CONFIRM, "Unable to allocate memory ...\n");
+		fclose(ptrFile);
+		return PS2HL_ERR_MEMORY;
 	}
 
 	// Show some info
-	printf("Properties: \n Nodes: %d \n Links: %d \n Routes: %d \n Hashes: %d \n", NGraph.CGraph.NodeCount, NGraph.CGraph.LinkCount, NGraph.CGraph.RouteCount, NGraph.CGraph.HashCount);
+	LibMsg(MSG_INFO, "Properties: \n Nodes: %d \n Links: %d \n Routes: %d \n Hashes: %d \n", NGraph.CGraph.NodeCount, NGraph.CGraph.LinkCount, NGraph.CGraph.RouteCount, NGraph.CGraph.HashCount);
 
 	// Close file
 	fclose(ptrFile);
 
 	// Open file for writing
-	SafeFileOpen(&ptrFile, FileName, "wb");
+	if (FileOpen(&ptrFile, FileName, "wb") == false)
+	{
+		NGraph.Deinit();
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Write data
 	if (Result == NOD_FORMAT_PS2)
@@ -101,58 +118,138 @@ void ConvertNOD(const char * FileName)
 	// Close file
 	fclose(ptrFile);
 
-	puts("\nDone! \n");
+	LibMsg(MSG_INFO, "\nDone! \n\n");
+
+	return PS2HL_OK;
 }
 
-int main(int argc, char * argv[])
+
+////////// Batch jobs //////////
+int RunJob(const char * Command, const char * FileName)
 {
 	char cExtension[5];
+	int Format;
 
-	puts(PROG_TITLE);
-
-	if (argc == 1)
+	FileGetExtension(FileName, cExtension, sizeof(cExtension));
+	if (strcmp(cExtension, ".nod"))
 	{
-		puts(PROG_INFO);
-		UTIL_WAIT_KEY("Press any key to exit ...");
+		LibMsg(MSG_ERROR, "Unsupported file ...\n");
+		return PS2HL_ERR_PARAM;
 	}
-	else if (argc == 2)
-	{
-		FileGetExtension(argv[1], cExtension, sizeof(cExtension));
 
-		if (!strcmp(cExtension, ".nod") == true)
-		{
-			ConvertNOD(argv[1]);
-			return 0;
-		}
-		else
-		{
-			puts("Unsupported file ...");
-		}
+	// Default action - convert
+	if (JobIsAuto(Command) == true)
+		return ConvertNOD(FileName);
+
+	// Print info
+	if (!strcmp(Command, "test"))
+	{
+		Format = TestFile(FileName, true);
+		return (Format == NOD_FORMAT_PC || Format == NOD_FORMAT_PS2) ? PS2HL_OK : PS2HL_ERR_FORMAT;
 	}
-	else if (argc == 3)
+
+	LibMsg(MSG_ERROR, "Can't recognise command: %s \n", Command);
+	return PS2HL_ERR_PARAM;
+}
+
+const char * JobVersion()
+{
+	return PROG_TITLE;
+}
+
+bool SniffFile(const char * FileName)
+{
+	char cExtension[5];
+	int Format;
+
+	FileGetExtension(FileName, cExtension, sizeof(cExtension));
+	if (strcmp(cExtension, ".nod"))
+		return false;
+
+	Format = TestFile(FileName, false);
+	return Format == NOD_FORMAT_PC || Format == NOD_FORMAT_PS2;
+}
+
+int LintFile(const char * FileName, sLintFile * Lint)
+{
+	FILE * ptrFile;
+	sNodeGraph NGraph;
+	int Result;
+
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+
+	// Same check as TestFile()
+	NGraph.Init();
+	Result = NGraph.LoadAndCheckHeader(&ptrFile);
+	fclose(ptrFile);
+
+	if (Result == NOD_ERR_VERSION)
+		LintReport(Lint, LINT_ERROR, "node graph version %d, should be %d", NGraph.Version, NOD_SUPPORTED_VESION);
+	else if (Result == NOD_ERR_UNKNOWN)
+		LintReport(Lint, LINT_ERROR, "node graph size doesn't match its header");
+
+	return PS2HL_OK;
+}
+
+int DescribeFile(const char * FileName, sCatalogInfo * Info)
+{
+	int Format;
+
+	Format = TestFile(FileName, false);
+	if (Format != NOD_FORMAT_PC && Format != NOD_FORMAT_PS2)
+		return PS2HL_ERR_FORMAT;
+
+	Info->PS2 = (Format == NOD_FORMAT_PS2);
+	return PS2HL_OK;
+}
+
+int GenerateFile(const char * FileName, sCorpusSpec * Spec)
+{
+	FILE * ptrFile;
+	sNodeGraph NGraph;
+	char cExtension[5];
+
+	FileGetExtension(FileName, cExtension, sizeof(cExtension));
+	if (strcmp(cExtension, ".nod") || Spec->Count == 0)
+		return PS2HL_ERR_PARAM;
+
+	// Contents of structures don't matter for conversion, only their counts do
+	NGraph.Init();
+	memset(&NGraph.CGraph, 0x00, sizeof(sCGraph));
+	NGraph.Version = NOD_SUPPORTED_VESION;
+	NGraph.CGraph.NodeCount = Spec->Count;
+	NGraph.CGraph.LinkCount = Spec->Count * CorpusRange(Spec, 2, 6);
+	NGraph.CGraph.RouteCount = Spec->Count * CorpusRange(Spec, 4, 16);
+	NGraph.CGraph.HashCount = NGraph.CGraph.LinkCount * 2;
+	NGraph.CNodes = (sCNode_PS2 *)LibCalloc(sizeof(sCNode_PS2) * NGraph.CGraph.NodeCount, 1);
+	NGraph.CLinks = (sCLink *)LibCalloc(sizeof(sCLink) * NGraph.CGraph.LinkCount, 1);
+	NGraph.DistInfo = (sDIST_INFO *)LibCalloc(sizeof(sDIST_INFO) * NGraph.CGraph.NodeCount, 1);
+	NGraph.Routes = (char *)LibCalloc(sizeof(char) * NGraph.CGraph.RouteCount, 1);
+	NGraph.Hashes = (short *)LibCalloc(sizeof(short) * NGraph.CGraph.HashCount, 1);
+	if (NGraph.CNodes == NULL || NGraph.CLinks == NULL || NGraph.DistInfo == NULL || NGraph.Routes == NULL || NGraph.Hashes == NULL)
 	{
-		if (!strcmp(argv[1], "test") == true)
-		{
-			FileGetExtension(argv[2], cExtension, sizeof(cExtension));
-			if (!strcmp(cExtension, ".nod") == true)
-			{
-				TestFile(argv[2]);
-				return 0;
-			}
-			else
-			{
-				puts("Unsupported file ...");
-			}
-		}
-		else
-		{
-			puts("Can't recognise arguments ...");
-		}
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		NGraph.Deinit();
+		return PS2HL_ERR_MEMORY;
 	}
-	else
+	CorpusFill(Spec, NGraph.CGraph.SomeData2, sizeof(NGraph.CGraph.SomeData2), 256);
+	CorpusFill(Spec, (uchar *)NGraph.CNodes, sizeof(sCNode_PS2) * NGraph.CGraph.NodeCount, 256);
+	CorpusFill(Spec, (uchar *)NGraph.CLinks, sizeof(sCLink) * NGraph.CGraph.LinkCount, 256);
+	CorpusFill(Spec, (uchar *)NGraph.DistInfo, sizeof(sDIST_INFO) * NGraph.CGraph.NodeCount, 256);
+	CorpusFill(Spec, (uchar *)NGraph.Routes, sizeof(char) * NGraph.CGraph.RouteCount, 256);
+	CorpusFill(Spec, (uchar *)NGraph.Hashes, sizeof(short) * NGraph.CGraph.HashCount, 256);
+
+	if (FileOpen(&ptrFile, FileName, "wb") == false)
 	{
-		puts("Too many arguments ...");
+		NGraph.Deinit();
+		return PS2HL_ERR_OPEN;
 	}
-	
-	return 1;
+	NGraph.SaveToFile(&ptrFile, NOD_FORMAT_PC);
+	fclose(ptrFile);
+
+	NGraph.Deinit();
+	return PS2HL_OK;
 }
+
+} // namespace nod
@@ -0,0 +1,164 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This module contains command line front-end of PAK tool
+//
+
+////////// Includes //////////
+#include "util.h"
+#include "main.h"				// Main header
+#include "perf.h"
+#include "log.h"
+
+using namespace pak;
+
+int main(int argc, char * argv[])
+{
+	char Action;
+
+	argc = PerfParseArgs(argc, argv);	// --stats, --trace <file>
+	argc = LogParseArgs(argc, argv, false);	// -q, -v, --log-format=jsonl
+	LibSetInteractive(true);
+
+	LibMsg(MSG_INFO, "%s\n", PROG_TITLE);
+
+	if (argc == 1)
+	{
+		puts(PROG_INFO);
+		UTIL_WAIT_KEY("Press any key to exit ...");
+	}
+	else if (argc == 2)
+	{
+		if (CheckDir(argv[1]) == true)						// Folder
+		{
+			puts("\nChoose PAK type:");
+			puts(" n - normal, align=2048 [PAK0, DECALS, UGMESAVE, DICTS]");
+			puts(" s - normal, align=16 [pausegui, discfail]");
+			puts(" c - compressed, align=16 [VALVE, DECAY, MIDHL, MIDTOH, MIDDECAY, FRONTEND,");
+			puts("\tGUISOUND, GDECALS, CGMESAVE, SYSSAVE, SYSTEM]");
+			puts(" g - global, compressed, align=16, *.spz patch [GLOBAL+GRESTORE]");
+			do
+			{
+				fflush(stdout);
+				Action = getc(stdin);
+			} while (Action != 'n' && Action != 'c' && Action != 'g' && Action != 's');
+
+			if (Action == 'n')
+			{
+				// Normal
+				PackPAK(argv[1], PS2HL_NPAK_SEG_SIZE);
+			}
+			else if (Action == 's')
+			{
+				// Normal with small alignment (pausegui.pak)
+				if (PackPAK(argv[1], PS2HL_CPAK_SEG_SIZE) != PS2HL_OK)
+					return 1;
+			}
+			else if (Action == 'c')
+			{
+				// Compressed
+				if (PackCompressedPAK(argv[1]) != PS2HL_OK)
+					return 1;
+			}
+			else
+			{
+				// GLOBAL+GRESTORE
+				if (PackGlobalPAK(argv[1]) != PS2HL_OK)
+					return 1;
+			}
+		}
+		else if (CheckPAK(argv[1], false) == 0)				// Normal PS2 PAK
+		{
+			// Extract
+			ExtractPAK(argv[1]);
+		}
+		else if (CheckPAK(argv[1], false) == 1)				// Compressed PS2 PAK
+		{
+			// Decompress and extract
+			ExtractAnyPAK(argv[1]);
+		}
+		else if (CheckPAK(argv[1], false) == -1)			// Unsupported file
+		{
+			LibMsg(MSG_ERROR, "Unsupported file ...\n");
+		}
+	}
+	else if (argc == 3)
+	{
+		if (!strcmp(argv[1], "test") == true)
+		{
+			CheckPAK(argv[2], true);
+		}
+		else if (!strcmp(argv[1], "extract") == true)
+		{
+			ExtractAnyPAK(argv[2]);
+		}
+		else if (!strcmp(argv[1], "pack") == true)
+		{
+			if (CheckDir(argv[2]) == true)
+			{
+				// Pack
+				PackPAK(argv[2], PS2HL_NPAK_SEG_SIZE);
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+			}
+		}
+		else if (!strcmp(argv[1], "pack16") == true)
+		{
+			if (CheckDir(argv[2]) == true)
+			{
+				// Pack
+				if (PackPAK(argv[2], PS2HL_CPAK_SEG_SIZE) != PS2HL_OK)
+					return 1;
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+			}
+		}
+		else if (!strcmp(argv[1], "cpack") == true)
+		{
+			if (CheckDir(argv[2]) == true)
+			{
+				if (PackCompressedPAK(argv[2]) != PS2HL_OK)
+					return 1;
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+			}
+		}
+		else if (!strcmp(argv[1], "gpack") == true)
+		{
+			if (CheckDir(argv[2]) == true)
+			{
+				if (PackGlobalPAK(argv[2]) != PS2HL_OK)
+					return 1;
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+			}
+		}
+		else if (!strcmp(argv[1], "decompress") == true)
+		{
+			DecompressPAK(argv[2]);
+		}
+		else if (!strcmp(argv[1], "compress") == true)
+		{
+			CompressPAK(argv[2]);
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Can't recognise command ...\n");
+		}
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Too many arguments ...\n");
+	}
+	
+	return 0;
+}
@@ -5,19 +5,20 @@
 // This file contains all definitions and declarations
 //
 
-#ifndef MAIN_H
-#define MAIN_H
+#ifndef PAKTOOL_MAIN_H
+#define PAKTOOL_MAIN_H
 
 ////////// Includes //////////
 #include <stdio.h>		// puts(), printf(), gets_s(), sscanf(), snprintf(), rename(), remove()
 #include <string.h>		// strcpy(), strcat(), strlen(), strtok(), strncpy(), memset()
 #include <malloc.h>		// malloc(), free()
-#include <stdlib.h>		// exit()
+#include <stdlib.h>		// exit() (front-end only)
 #include <math.h>		// round(), sqrt(), ceil()
 #include <ctype.h>		// tolower()
 
 ////////// Zlib stuff //////////
 #include "zlib.h"
+#include "ztool.h"
 #include <assert.h>
 
 ////////// Definitions //////////
@@ -47,6 +48,21 @@ For more info check out readme.txt\n\
 
 ////////// Functions //////////
 #include "fops.h"
+#include "ps2hl.h"
+
+namespace pak
+{
+
+int ExtractPAK(const char * cFile);																							// Extract given PAK file
+int PackPAK(const char * cFolder, ulong SegmentSize);																		// Pack folder into PAK
+int DecompressPAK(const char * cFile);																						// Decompress PAK file
+int CompressPAK(const char * cFile);																						// Compress PAK file
+int CheckPAK(const char * cFile, bool PrintInfo);																			// Check PAK file (returns PAK type)
+ulong CalculateFileSpace(ulong FileSize, ulong SegmentSize);																// Calculate amount of space occupied by file inside PAK
+int ConvertToGRE(const char * cFile);																						// Convert PAK to GRESTORE format
+int ExtractAnyPAK(const char * cFile);																						// Extract normal or compressed PAK
+int PackCompressedPAK(const char * cFolder);																				// Pack folder into compressed PAK
+int PackGlobalPAK(const char * cFolder);																					// Pack folder into GLOBAL.PAK and GRESTORE.PAK
 
 ////////// Structures //////////
 
@@ -202,4 +218,6 @@ struct sSPZFrameTableEntry
 	}
 };
 
-#endif // MAIN_H
+} // namespace pak
+
+#endif // PAKTOOL_MAIN_H
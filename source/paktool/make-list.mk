@@ -1,2 +1,6 @@
-OBJS=$(COMOBJ)/fops.o $(OBJDIR)/paktool.o
-LIBS=-L$(COMOBJ) -lz
+OBJS=$(OBJDIR)/cli.o
+ifeq ($(OS),Windows_NT)
+LIBS=-L$(COMOBJ) -lps2hl -lz
+else
+LIBS=-L$(COMOBJ) -lps2hl -lz -lpthread
+endif
@@ -10,128 +10,12 @@
 ////////// Includes //////////
 #include "util.h"
 #include "main.h"				// Main header
+#include "jobs.h"
+#include "pakimg.h"
+#include "lint.h"
 
-////////// Functions //////////
-void ExtractPAK(const char * cFile);																						// Extract given PAK file
-void PackPAK(const char * cFolder, ulong SegmentSize);																		// Pack folder into PAK
-bool DecompressPAK(const char * cFile);																						// Decompress PAK file
-bool CompressPAK(const char * cFile);																						// Compress PAK file
-int CheckPAK(const char * cFile, bool PrintInfo);																			// Check PAK file
-bool ZDecompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize, ulong StartSize);		// Compress data with zlib
-bool ZCompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize);						// Decompress data with zlib
-ulong CalculateFileSpace(ulong FileSize, ulong SegmentSize);																// Calculate amount of space occupied by file inside PAK
-void ConvertToGRE(const char * cFile);																						// Convert PAK to GRESTORE format
-
-
-
-bool ZDecompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize, ulong StartSize)
-{
-	// Setting up zlib variables for decomression
-	z_stream infstream;
-	infstream.zalloc = Z_NULL;
-	infstream.zfree = Z_NULL;
-	infstream.opaque = Z_NULL;
-
-	// Setting up other variables
-	uchar * NewData;
-	ulong NewDataSize;
-	bool Finish;
-
-	// Set starting size of decompressed data (would be increased if bigger)
-	NewDataSize = StartSize;
-
-	// Decompression loop
-	do
-	{
-		// Allocate memory for decompressed data
-		NewData = (uchar *)malloc(NewDataSize);
-		if (NewData == NULL)
-		{
-			puts("Unable to allocate memory ...");
-			return false;
-		}
-
-		infstream.next_in = (Bytef *)InputData;			// Input data pointer (compressed data)
-		infstream.avail_in = (uint)InputDataSize;		// Size of input data
-		infstream.next_out = (Bytef *)NewData;			// Output data pointer (decompressed data)
-		infstream.avail_out = (uint)NewDataSize;		// Size of output data
-
-		// Decompression work
-		if (inflateInit(&infstream) != Z_OK)
-		{
-			puts("Zlib: can't decompress data ...");
-			return false;
-		}
-		inflate(&infstream, Z_FINISH);
-		inflateEnd(&infstream);
-
-		// if buffer is full then increase buffer size and retry decompression
-		if (NewDataSize == infstream.total_out)
-		{
-			free(NewData);
-			NewDataSize = NewDataSize * 2 + 1;		// +1 to avoid infinite loop, when StartSize = 0
-
-			Finish = false;
-		}
-		else
-		{
-			Finish = true;
-		}
-	} while (Finish == false);
-
-	// Check if output data has zero size
-	if (infstream.total_out == 0)
-		return false;
-
-	puts("Decompression is completed successfully");
-
-	// Return data pointer, data size and result
-	*OutputData = NewData;
-	*OutputDataSize = infstream.total_out;
-	return true;
-}
-
-bool ZCompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize)
+namespace pak
 {
-	// Allocate memory for compressed data
-	uchar * NewData;
-	ulong NewDataSize;
-
-	NewDataSize = InputDataSize;
-	NewData = (uchar *)malloc(NewDataSize);
-	if (NewData == NULL)
-	{
-		puts("Unable to allocate memory ...");
-		return false;
-	}
-
-	// Setting up zlib variables for compression
-	z_stream defstream;
-	defstream.zalloc = Z_NULL;
-	defstream.zfree = Z_NULL;
-	defstream.opaque = Z_NULL;
-
-	defstream.next_in = (Bytef *)InputData;			// Input data pointer (decompressed data)
-	defstream.avail_in = (ulong)InputDataSize;		// Size of input data
-	defstream.next_out = (Bytef *)NewData;			// Output data pointer (compressed data)
-	defstream.avail_out = (ulong)NewDataSize;		// Size of output data
-
-	// Compression work.
-	deflateInit(&defstream, Z_BEST_COMPRESSION);
-	deflate(&defstream, Z_FINISH);
-	deflateEnd(&defstream);
-
-	// Check if output data has zero size
-	if (defstream.total_out == 0)
-		return false;
-
-	puts("Compression is completed succesfully");
-
-	// Return data pointer, data size and result
-	*OutputData = NewData;
-	*OutputDataSize = defstream.total_out;
-	return true;
-}
 
 int CheckPAK(const char * cFile, bool PrintInfo)
 {
@@ -142,7 +26,8 @@ int CheckPAK(const char * cFile, bool PrintInfo)
 	uint FileCounter;
 
 	// Open file
-	SafeFileOpen(&ptrInputF, cFile, "rb");
+	if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		return PAK_UNKNOWN;
 
 	// Load header
 	PS2PAKHeader.UpdateFromFile(&ptrInputF);
@@ -153,31 +38,31 @@ int CheckPAK(const char * cFile, bool PrintInfo)
 	{
 		if (PAKType == PAK_NORMAL)
 		{
-			puts("\nNormal PAK");
-			printf("Table offset: 0x%X \n", PS2PAKHeader.Normal.TableOffset);
-			printf("Table size: 0x%X \n", PS2PAKHeader.Normal.TableSize);
+			LibMsg(MSG_INFO, "\nNormal PAK\n");
+			LibMsg(MSG_INFO, "Table offset: 0x%X \n", PS2PAKHeader.Normal.TableOffset);
+			LibMsg(MSG_INFO, "Table size: 0x%X \n", PS2PAKHeader.Normal.TableSize);
 			FileCounter = PS2PAKHeader.Normal.TableSize / sizeof(sPS2PAKFileEntry);
-			printf("Files in PAK: %i \n", FileCounter);
+			LibMsg(MSG_INFO, "Files in PAK: %i \n", FileCounter);
 
 			/*sPS2PAKFileEntry PS2PAKFileEntry;
-			puts("\nList of files: \n");
+			LibMsg(MSG_INFO, "\nList of files: \n\n");
 			for (int i = 0; i < FileCounter; i++)
 			{
-				printf("\nFile entry #%i\n", i);
+				LibMsg(MSG_INFO, "\nFile entry #%i\n", i);
 				PS2PAKFileEntry.UpdateFromFile(&ptrInputF, PS2PAKHeader.Normal.TableOffset + sizeof(sPS2PAKFileEntry) * i);
-				printf("File name: %s \n", PS2PAKFileEntry.FileName);
-				printf("File offset: 0x%X \n", PS2PAKFileEntry.FileOffset);
-				printf("File size: %i bytes \n\n", PS2PAKFileEntry.FileSize);
+				LibMsg(MSG_INFO, "File name: %s \n", PS2PAKFileEntry.FileName);
+				LibMsg(MSG_INFO, "File offset: 0x%X \n", PS2PAKFileEntry.FileOffset);
+				LibMsg(MSG_INFO, "File size: %i bytes \n\n", PS2PAKFileEntry.FileSize);
 			}*/
 		}
 		else if (PAKType == PAK_COMPRESSED)
 		{
-			puts("\nCompressed PAK");
-			printf("Decompressed PAK target size: %i bytes \n", PS2PAKHeader.Compressed.PAKSize);
+			LibMsg(MSG_INFO, "\nCompressed PAK\n");
+			LibMsg(MSG_INFO, "Decompressed PAK target size: %i bytes \n", PS2PAKHeader.Compressed.PAKSize);
 		}
 		else
 		{
-			puts("\nUnsupported file ...\n");
+			LibMsg(MSG_ERROR, "\nUnsupported file ...\n\n");
 		}
 	}
 
@@ -196,7 +81,7 @@ ulong CalculateFileSpace(ulong FileSize, ulong SegmentSize)
 	return (ulong) ceil((double) FileSize / (double) SegmentSize) * SegmentSize;
 }
 
-void ExtractPAK(const char * cFile)
+int ExtractPAK(const char * cFile)
 {
 	FILE * ptrInputF;		// Stream for input file (PAK)
 	FILE * ptrOutputF;		// Stream for output files
@@ -214,7 +99,8 @@ void ExtractPAK(const char * cFile)
 	char cTemp[PATH_LEN];		// Temporary string for concatenation
 
 	// Open PAK file
-	SafeFileOpen(&ptrInputF, cFile, "rb");
+	if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Read header
 	PS2PAKHeader.UpdateFromFile(&ptrInputF);
@@ -222,21 +108,23 @@ void ExtractPAK(const char * cFile)
 	// Check header, extract if PAK file is decompressed
 	if (PS2PAKHeader.CheckType() == PAK_UNKNOWN)
 	{
-		puts("\nUnsupported file ...\n");
-		return;
+		LibMsg(MSG_ERROR, "\nUnsupported file ...\n\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
 	}
 	else if (PS2PAKHeader.CheckType() == PAK_COMPRESSED)
 	{
-		puts("\nCompressed PAK. Decompress it to extract files ...\n");
-		return;
+		LibMsg(MSG_ERROR, "\nCompressed PAK. Decompress it to extract files ...\n\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
 	}
 	if (PS2PAKHeader.CheckType() == PAK_NORMAL)
 	{
-		puts("Extracting ... \n");
-		printf("Table offset: %x \n", PS2PAKHeader.Normal.TableOffset);
-		printf("Table size: %x \n", PS2PAKHeader.Normal.TableSize);
+		LibMsg(MSG_INFO, "Extracting ... \n\n");
+		LibMsg(MSG_INFO, "Table offset: %x \n", PS2PAKHeader.Normal.TableOffset);
+		LibMsg(MSG_INFO, "Table size: %x \n", PS2PAKHeader.Normal.TableSize);
 		FileCounter = PS2PAKHeader.Normal.TableSize / 0x40;
-		printf("Files in PAK: %i \n", FileCounter);
+		LibMsg(MSG_INFO, "Files in PAK: %i \n", FileCounter);
 
 		// Create directory for extracted files
 		FileGetPath(cFile, cFolder, sizeof(cFolder));
@@ -246,14 +134,14 @@ void ExtractPAK(const char * cFile)
 		NewDir(cFolder);
 
 		// Extract files
-		for (int i = 0; i < FileCounter; i++)
+		for (uint i = 0; i < FileCounter; i++)
 		{
-			printf("\nExtracting file #%i\n", i);
+			LibMsg(MSG_DEBUG, "\nExtracting file #%i\n", i);
 			PS2PAKFileEntry.UpdateFromFile(&ptrInputF, PS2PAKHeader.Normal.TableOffset + sizeof(sPS2PAKFileEntry) * i);
 
-			printf("File name: %s \n", PS2PAKFileEntry.FileName);
-			printf("File offset: 0x%X \n", PS2PAKFileEntry.FileOffset);
-			printf("File size: %i bytes \n\n", PS2PAKFileEntry.FileSize);
+			LibMsg(MSG_DEBUG, "File name: %s \n", PS2PAKFileEntry.FileName);
+			LibMsg(MSG_DEBUG, "File offset: 0x%X \n", PS2PAKFileEntry.FileOffset);
+			LibMsg(MSG_DEBUG, "File size: %i bytes \n\n", PS2PAKFileEntry.FileSize);
 
 			// Get full file name
 			strcpy(cOutFile, cFolder);
@@ -265,15 +153,21 @@ void ExtractPAK(const char * cFile)
 			GenerateFolders(cOutFile);
 
 			// Create file
-			SafeFileOpen(&ptrOutputF, cOutFile, "wb");
+			if (FileOpen(&ptrOutputF, cOutFile, "wb") == false)
+			{
+				fclose(ptrInputF);
+				return PS2HL_ERR_OPEN;
+			}
 
 			// Copy file data from PAK to RAM
 			TempBufferSize = PS2PAKFileEntry.FileSize;
-			TempBuffer = (char *)malloc(TempBufferSize);
+			TempBuffer = (char *)LibAlloc(TempBufferSize);
 			if (TempBuffer == NULL)
 			{
-				UTIL_WAIT_KEY("Unable to allocate memory ...");
-				exit(1);
+				LibMsg(MSG_ERROR | MSG_CONFIRM, "Unable to allocate memory ...\n");
+				fclose(ptrOutputF);
+				fclose(ptrInputF);
+				return PS2HL_ERR_MEMORY;
 			}
 			FileReadBlock(&ptrInputF, TempBuffer, PS2PAKFileEntry.FileOffset, PS2PAKFileEntry.FileSize);
 
@@ -281,20 +175,24 @@ void ExtractPAK(const char * cFile)
 			FileWriteBlock(&ptrOutputF, TempBuffer, PS2PAKFileEntry.FileSize);
 
 			// Destroy buffer
-			free(TempBuffer);
+			LibFree(TempBuffer);
 
 			// Close output file
 			fclose(ptrOutputF);
+
+			LibProgress(i + 1, FileCounter);
 		}
 
-		puts("\nExtraction complete\n");
+		LibMsg(MSG_INFO, "\nExtraction complete\n\n");
 	}
 
 	// Close PAK
 	fclose(ptrInputF);
+
+	return PS2HL_OK;
 }
 
-void PackPAK(const char * cFolder, ulong SegmentSize)
+int PackPAK(const char * cFolder, ulong SegmentSize)
 {
 	FILE * ptrInputF;			// Stream for input files
 	FILE * ptrOutputF;			// Stream for output file (PAK)
@@ -307,46 +205,59 @@ void PackPAK(const char * cFolder, ulong SegmentSize)
 	ulong TempBufferSize;		// Temporary buffer size
 	
 	uint FileCounter;					//
+	uint FileListSize;					//
 	ulong PS2PAKTableSizeCounter;		// Counters
 	ulong PS2PAKDataSizeCounter;		//
 
 	char cFile[PATH_LEN];			// Input file name
 	const char * NextFile;			// Next file name from iterator
+	sDirIter Iter;					// Dir iterator
 	char cOutFile[PATH_LEN];		// Output PAK file name
 
 
 	// Count files in folder
 	FileCounter = 0;
-	DirIterInit(cFolder);
-	while ( DirIterGet() )
+	DirIterInit(&Iter, cFolder);
+	while ( DirIterGet(&Iter) )
 		FileCounter++;
-	DirIterClose();
+	DirIterClose(&Iter);
 	if (FileCounter == 0)
 	{
-		puts("Empty dir, nothing to pack ...");
-		exit(1);
+		LibMsg(MSG_ERROR, "Empty dir, nothing to pack ...\n");
+		return PS2HL_ERR_PARAM;
 	}
 
 	// Allocate memory for list of files
-	FileList = (sFileListEntry *)malloc(sizeof(sFileListEntry)*FileCounter);
-	printf("Found %i file(s), packing ...\n", FileCounter);
+	FileList = (sFileListEntry *)LibAlloc(sizeof(sFileListEntry)*FileCounter);
+	if (FileList == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	LibMsg(MSG_INFO, "Found %i file(s), packing ...\n", FileCounter);
 
-	// Fill list
+	// Fill list (stop at previous count in case files were added meanwhile)
+	FileListSize = FileCounter;
 	FileCounter = 0;
-	DirIterInit(cFolder);
-	while ( (NextFile = DirIterGet()) != NULL )
+	DirIterInit(&Iter, cFolder);
+	while ( FileCounter < FileListSize && (NextFile = DirIterGet(&Iter)) != NULL )
 	{
 		strcpy(cFile, NextFile);
 
-		SafeFileOpen(&ptrInputF, cFile, "rb");
-		//printf("%s, %i\n", cFile, FileSize(&ptrInputF));
+		if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		{
+			DirIterClose(&Iter);
+			LibFree(FileList);
+			return PS2HL_ERR_OPEN;
+		}
+		//LibMsg(MSG_INFO, "%s, %i\n", cFile, FileSize(&ptrInputF));
 
 		FileList[FileCounter].Update(cFile, FileSize(&ptrInputF));
 		FileCounter++;
 
 		fclose(ptrInputF);
 	}
-	DirIterClose();
+	DirIterClose(&Iter);
 
 	// Calculate PAK size
 	PS2PAKDataSizeCounter = 0;
@@ -357,11 +268,22 @@ void PackPAK(const char * cFolder, ulong SegmentSize)
 	// Create new PAK file
 	strcpy(cOutFile, cFolder);
 	strcat(cOutFile, ".PAK");
-	SafeFileOpen(&ptrOutputF, cOutFile, "wb");
+	if (FileOpen(&ptrOutputF, cOutFile, "wb") == false)
+	{
+		LibFree(FileList);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Allocate buffer for header
 	TempBufferSize = CalculateFileSpace(sizeof(sPS2NormalPAKHeader), SegmentSize);
-	TempBuffer = (char *)malloc(TempBufferSize);
+	TempBuffer = (char *)LibAlloc(TempBufferSize);
+	if (TempBuffer == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrOutputF);
+		LibFree(FileList);
+		return PS2HL_ERR_MEMORY;
+	}
 	// Clear buffer from garbage
 	memset(TempBuffer, 0x00, TempBufferSize);
 	// Generate header
@@ -371,20 +293,33 @@ void PackPAK(const char * cFolder, ulong SegmentSize)
 	// Write buffer with header to file
 	FileWriteBlock(&ptrOutputF, TempBuffer, TempBufferSize);
 	// Destroy buffer
-	free(TempBuffer);
+	LibFree(TempBuffer);
 
 	// Write file data to PAK
 	for (uint i = 0; i < FileCounter; i++)
 	{
-		printf("\nPacking file #%i: %s \nSize: %i \n", i + 1, FileList[i].FileName, FileList[i].FileSize);
+		LibMsg(MSG_DEBUG, "\nPacking file #%i: %s \nSize: %i \n", i + 1, FileList[i].FileName, FileList[i].FileSize);
 
 		// Open file
 		strcpy(cFile, FileList[i].FileName);
-		SafeFileOpen(&ptrInputF, cFile, "rb");
+		if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		{
+			fclose(ptrOutputF);
+			LibFree(FileList);
+			return PS2HL_ERR_OPEN;
+		}
 
 		// Allocate buffer for file data
 		TempBufferSize = CalculateFileSpace(FileList[i].FileSize, SegmentSize);
-		TempBuffer = (char *)malloc(TempBufferSize);
+		TempBuffer = (char *)LibAlloc(TempBufferSize);
+		if (TempBuffer == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			fclose(ptrInputF);
+			fclose(ptrOutputF);
+			LibFree(FileList);
+			return PS2HL_ERR_MEMORY;
+		}
 
 		// Clear allocated space from garbage
 		memset(TempBuffer, 0x00, TempBufferSize);
@@ -397,14 +332,16 @@ void PackPAK(const char * cFolder, ulong SegmentSize)
 		fflush(ptrOutputF); // Write to the disk immediately
 		
 		// Destroy buffer
-		free(TempBuffer);
+		LibFree(TempBuffer);
 
 		// Close file
 		fclose(ptrInputF);
+
+		LibProgress(i + 1, FileCounter);
 	}
 
 	// Write file table to PAK
-	puts("\nWriting file table ...");
+	LibMsg(MSG_INFO, "\nWriting file table ...\n");
 	PS2PAKDataSizeCounter = CalculateFileSpace(sizeof(sPS2NormalPAKHeader), SegmentSize);	// Reset data size counter to first file's offset
 	for (uint i = 0; i < FileCounter; i++)
 	{
@@ -421,15 +358,17 @@ void PackPAK(const char * cFolder, ulong SegmentSize)
 	}
 
 	//for (int i = 0; i < FileCounter; i++)
-	//	printf("#%i - File name: %s \n File Size: %i | Reference: %i | RFName: %s \n\n", i + 1, FileList[i].FileName, FileList[i].FileSize, FileList[i].ExtReference, FileList[i].ExtFileName);
+	//	LibMsg(MSG_INFO, "#%i - File name: %s \n File Size: %i | Reference: %i | RFName: %s \n\n", i + 1, FileList[i].FileName, FileList[i].FileSize, FileList[i].ExtReference, FileList[i].ExtFileName);
 
-	printf("\nDone\n\n");
+	LibMsg(MSG_INFO, "\nDone\n\n");
 
 	fclose(ptrOutputF);
-	free(FileList);
+	LibFree(FileList);
+
+	return PS2HL_OK;
 }
 
-bool DecompressPAK(const char * cFile)
+int DecompressPAK(const char * cFile)
 {
 	FILE * ptrInputF;	// Compressed file pointer
 	FILE * ptrOutputF;	// Decompressed file pointer
@@ -444,48 +383,66 @@ bool DecompressPAK(const char * cFile)
 	char cTemp[PATH_LEN];		// Temporary string for concatenation
 
 	// Open and check compressed PAK
-	SafeFileOpen(&ptrInputF, cFile, "rb");
+	if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
 	PS2PAKHeader.UpdateFromFile(&ptrInputF);
 	if (PS2PAKHeader.CheckType() == PAK_UNKNOWN)
 	{
-		puts("Unsupported file");
-		return false;
+		LibMsg(MSG_ERROR, "Unsupported file\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
 	}
 	else if (PS2PAKHeader.CheckType() == PAK_NORMAL)
 	{
-		puts("File is already decompressed");
-		return false;
+		LibMsg(MSG_INFO, "File is already decompressed\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_SKIP;
 	}
 
-	puts("Decompressing ...");
+	LibMsg(MSG_INFO, "Decompressing ...\n");
 
 	// Allocate memory for compressed data
 	CDataSize = FileSize(&ptrInputF) - sizeof(PS2PAKHeader.Compressed.PAKSize);
-	CData = (uchar *)malloc(CDataSize);
+	CData = (uchar *)LibAlloc(CDataSize);
+	if (CData == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_MEMORY;
+	}
 
 	// Read compressed data from file
 	FileReadBlock(&ptrInputF, CData, sizeof(PS2PAKHeader.Compressed.PAKSize), CDataSize);
 
 	// Decompress data. Setting start size of decompressed data to 2 sizes of compressed file to avoid looping.
-	if (ZDecompress(CData, CDataSize, &DData, &DDataSize, CDataSize * 2) != true)
+	if (ZDecompress(CData, CDataSize, &DData, &DDataSize, CDataSize * 2) != PS2HL_OK)
 	{
-		puts("Unable to decompress file ...");
-		return false;
+		LibMsg(MSG_ERROR, "Unable to decompress file ...\n");
+		LibFree(CData);
+		fclose(ptrInputF);
+		return PS2HL_ERR_ZLIB;
 	}
+	LibMsg(MSG_INFO, "Decompression is completed successfully\n");
 
 	// Create output file
 	FileGetPath(cFile, cOutFile, sizeof(cOutFile));
 	strcat(cOutFile, "dec-");
 	FileGetName(cFile, cTemp, sizeof(cTemp), true);
 	strcat(cOutFile, cTemp);
-	SafeFileOpen(&ptrOutputF, cOutFile, "wb");
+	if (FileOpen(&ptrOutputF, cOutFile, "wb") == false)
+	{
+		LibFree(CData);
+		LibFree(DData);
+		fclose(ptrInputF);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Write decompressed data to file
 	FileWriteBlock(&ptrOutputF, DData, DDataSize);
 
 	// Free memory
-	free(CData);
-	free(DData);
+	LibFree(CData);
+	LibFree(DData);
 
 	// Close files
 	fclose(ptrOutputF);
@@ -493,14 +450,14 @@ bool DecompressPAK(const char * cFile)
 
 	// Give warning if file size is't equal to target
 	if (PS2PAKHeader.Compressed.PAKSize != DDataSize)
-		printf("\nWarning - File size mismatch! \nOriginal size: %i bytes \nTarget size: %i bytes \nActual size: %i bytes \n\n", CDataSize, PS2PAKHeader.Compressed.PAKSize, DDataSize);
+		LibMsg(MSG_WARN, "\nWarning - File size mismatch! \nOriginal size: %i bytes \nTarget size: %i bytes \nActual size: %i bytes \n\n", CDataSize, PS2PAKHeader.Compressed.PAKSize, DDataSize);
 	else
-		printf("\nFile is successfully decompressed \nOriginal size: %i bytes \nDecompressed size: %i bytes \n\n", CDataSize, DDataSize);
+		LibMsg(MSG_INFO, "\nFile is successfully decompressed \nOriginal size: %i bytes \nDecompressed size: %i bytes \n\n", CDataSize, DDataSize);
 
-	return true;
+	return PS2HL_OK;
 }
 
-bool CompressPAK(const char * cFile)
+int CompressPAK(const char * cFile)
 {
 	FILE * ptrInputF;	// Decompressed file
 	FILE * ptrOutputF;	// Compressed file
@@ -515,61 +472,79 @@ bool CompressPAK(const char * cFile)
 	char cTemp[PATH_LEN];		// Temporary string for concatenation
 
 	// Open and check PAK
-	SafeFileOpen(&ptrInputF, cFile, "rb");
+	if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
 	PS2PAKHeader.UpdateFromFile(&ptrInputF);
 	if (PS2PAKHeader.CheckType() == PAK_UNKNOWN)
 	{
-		puts("Unsupported file");
-		return false;
+		LibMsg(MSG_ERROR, "Unsupported file\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
 	}
 	else if (PS2PAKHeader.CheckType() == PAK_COMPRESSED)
 	{
-		puts("File is already compressed");
-		return false;
+		LibMsg(MSG_INFO, "File is already compressed\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_SKIP;
 	}
 
-	puts("Compressing ...");
+	LibMsg(MSG_INFO, "Compressing ...\n");
 
 	// Allocate memory for decompressed data
 	DDataSize = FileSize(&ptrInputF);
-	DData = (uchar *)malloc(DDataSize);
+	DData = (uchar *)LibAlloc(DDataSize);
+	if (DData == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_MEMORY;
+	}
 
 	// Read decompressed data from file
 	FileReadBlock(&ptrInputF, DData, 0, DDataSize);
 
 	// Compress data
-	if (ZCompress(DData, DDataSize, &CData, &CDataSize) != true)
+	if (ZCompress(DData, DDataSize, &CData, &CDataSize) != PS2HL_OK)
 	{
-		puts("Zlib: unable to compress file ...");
-		return false;
+		LibMsg(MSG_ERROR, "Zlib: unable to compress file ...\n");
+		LibFree(DData);
+		fclose(ptrInputF);
+		return PS2HL_ERR_ZLIB;
 	}
+	LibMsg(MSG_INFO, "Compression is completed succesfully\n");
 
 	// Create output file
 	FileGetPath(cFile, cOutFile, sizeof(cOutFile));
 	strcat(cOutFile, "cmp-");
 	FileGetName(cFile, cTemp, sizeof(cTemp), true);
 	strcat(cOutFile, cTemp);
-	SafeFileOpen(&ptrOutputF, cOutFile, "wb");
+	if (FileOpen(&ptrOutputF, cOutFile, "wb") == false)
+	{
+		LibFree(CData);
+		LibFree(DData);
+		fclose(ptrInputF);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Write size of decompressed file and compressed data to file
 	FileWriteBlock(&ptrOutputF, &DDataSize, sizeof(DDataSize));
 	FileWriteBlock(&ptrOutputF, CData, CDataSize);
 
 	// Free memory
-	free(CData);
-	free(DData);
+	LibFree(CData);
+	LibFree(DData);
 
 	// Close files
 	fclose(ptrOutputF);
 	fclose(ptrInputF);
 
 	// Print some info
-	printf("\nFile is successfully compressed \nOriginal size: %i bytes \nCompressed size: %i bytes \n\n", DDataSize, CDataSize);
+	LibMsg(MSG_INFO, "\nFile is successfully compressed \nOriginal size: %i bytes \nCompressed size: %i bytes \n\n", DDataSize, CDataSize);
 
-	return true;
+	return PS2HL_OK;
 }
 
-void ConvertToGRE(const char * cFile)
+int ConvertToGRE(const char * cFile)
 {
 	FILE * ptrInPAK;						// Input file stream
 	FILE * ptrOutPAK;						// Output file stream
@@ -587,37 +562,42 @@ void ConvertToGRE(const char * cFile)
 	sSPZFrameTableEntry * SPZFrameEntry;	// Pointer to SPZ frame table
 	bool ModelFlag;							// For model detection
 
-	puts("Converting to GRESTORE ... \n");
+	LibMsg(MSG_INFO, "Converting to GRESTORE ... \n\n");
 
 	// Open input pak
-	SafeFileOpen(&ptrInPAK, cFile, "rb");
+	if (FileOpen(&ptrInPAK, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
 	
 	// Read header and check PAK
 	PS2PAKHeader.UpdateFromFile(&ptrInPAK);
 	if (PS2PAKHeader.CheckType() != PAK_NORMAL)
 	{
-		puts("Can't apply patch ...");
-		return;
+		LibMsg(MSG_ERROR, "Can't apply patch ...\n");
+		fclose(ptrInPAK);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Load PAK file data
 	PAKDataSize = FileSize(&ptrInPAK) - PS2PAKHeader.Normal.TableSize;
-	PAKData = (char *)malloc(PAKDataSize);
+	PAKData = (char *)LibAlloc(PAKDataSize);
 	if (PAKData == NULL)
 	{
-		UTIL_WAIT_KEY("Unable to allocate memory ...");
-		exit(1);
+		LibMsg(MSG_ERROR | MSG_CONFIRM, "Unable to allocate memory ...\n");
+		fclose(ptrInPAK);
+		return PS2HL_ERR_MEMORY;
 	}
 	FileReadBlock(&ptrInPAK, PAKData, 0, PAKDataSize);
 
 	// Load PAK file table
 	PAKFileTableSize = PS2PAKHeader.Normal.TableSize;
-	PAKFileTable = (sPS2PAKFileEntry *)malloc(PAKFileTableSize);
+	PAKFileTable = (sPS2PAKFileEntry *)LibAlloc(PAKFileTableSize);
 	PAKFileCount = PAKFileTableSize / sizeof(sPS2PAKFileEntry);
 	if (PAKFileTable == NULL)
 	{
-		UTIL_WAIT_KEY("Unable to allocate memory ...");
-		exit(1);
+		LibMsg(MSG_ERROR | MSG_CONFIRM, "Unable to allocate memory ...\n");
+		LibFree(PAKData);
+		fclose(ptrInPAK);
+		return PS2HL_ERR_MEMORY;
 	}
 	FileReadBlock(&ptrInPAK, PAKFileTable, PS2PAKHeader.Normal.TableOffset, PAKFileTableSize);
 
@@ -658,7 +638,13 @@ void ConvertToGRE(const char * cFile)
 	strcat(cOutFileName, "gre-");
 	FileGetName(cFile, cTemp, sizeof(cTemp), true);
 	strcat(cOutFileName, cTemp);
-	SafeFileOpen(&ptrOutPAK, cOutFileName, "wb");
+	if (FileOpen(&ptrOutPAK, cOutFileName, "wb") == false)
+	{
+		LibFree(PAKData);
+		LibFree(PAKFileTable);
+		fclose(ptrInPAK);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Write modified PAK file data and PAK file table
 	FileWriteBlock(&ptrOutPAK, PAKData, PAKDataSize);
@@ -667,283 +653,719 @@ void ConvertToGRE(const char * cFile)
 	// Show warning if found model files
 	if (ModelFlag == true)
 	{
-		puts("Warning! Model files should not be inside GLOBAL.PAK and GRESTORE.PAK.");
-		puts("You may experience problems with those PAK's.\n");
-		UTIL_WAIT_KEY("Press any key to confirm ...");
+		LibMsg(MSG_WARN | MSG_CONFIRM, "Warning! Model files should not be inside GLOBAL.PAK and GRESTORE.PAK.\n"
+			"You may experience problems with those PAK's.\n\n");
 	}
 
 	// Free memory
-	free(PAKData);
-	free(PAKFileTable);
+	LibFree(PAKData);
+	LibFree(PAKFileTable);
 
 	// Close files
 	fclose(ptrInPAK);
 	fclose(ptrOutPAK);
+
+	return PS2HL_OK;
+}
+
+
+int ExtractAnyPAK(const char * cFile)
+{
+	char cPath[PATH_LEN];
+	char cFName[PATH_LEN];
+	char cTempFileName[PATH_LEN];
+	int Result;
+
+	// Normal PAK - extract as is
+	if (CheckPAK(cFile, false) == PAK_NORMAL)
+		return ExtractPAK(cFile);
+
+	// Get path and name
+	FileGetPath(cFile, cPath, sizeof(cPath));
+	FileGetName(cFile, cFName, sizeof(cFName), true);
+
+	// Decompress
+	Result = DecompressPAK(cFile);
+	if (Result != PS2HL_OK)
+		return Result;
+
+	// Extract
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, "dec-", cFName);
+	Result = ExtractPAK(cTempFileName);
+
+	// Delete temp file
+	remove(cTempFileName);
+
+	return Result;
+}
+
+int PackCompressedPAK(const char * cFolder)
+{
+	char cPath[PATH_LEN];
+	char cFName[PATH_LEN];
+	char cTempFileName[PATH_LEN];
+	char cNewFileName[PATH_LEN];
+	int Result;
+
+	// Get path and name
+	FileGetPath(cFolder, cPath, sizeof(cPath));
+	FileGetName(cFolder, cFName, sizeof(cFName), true);
+
+	// Pack
+	Result = PackPAK(cFolder, PS2HL_CPAK_SEG_SIZE);
+	if (Result != PS2HL_OK)
+		return Result;
+
+	// Compress
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
+	Result = CompressPAK(cTempFileName);
+	if (Result != PS2HL_OK)
+		return Result;
+
+	// Delete temp file
+	remove(cTempFileName);
+
+	// Rename comressed file
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "cmp-", cFName, ".PAK");
+	snprintf(cNewFileName, sizeof(cNewFileName), "%s%s%s", cPath, cFName, ".PAK");
+	FileSafeRename(cTempFileName, cNewFileName);
+
+	return PS2HL_OK;
 }
 
-int main(int argc, char * argv[])
+int PackGlobalPAK(const char * cFolder)
 {
 	char cPath[PATH_LEN];
 	char cFName[PATH_LEN];
 	char cTempFileName[PATH_LEN];
 	char cNewFileName[PATH_LEN];
-	char Action;
+	int Result;
+
+	// Get path and name
+	FileGetPath(cFolder, cPath, sizeof(cPath));
+	FileGetName(cFolder, cFName, sizeof(cFName), true);
+
+	// Pack
+	Result = PackPAK(cFolder, PS2HL_CPAK_SEG_SIZE);
+	if (Result != PS2HL_OK)
+		return Result;
+
+	// Create GRESTORE
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
+	Result = ConvertToGRE(cTempFileName);
+	if (Result != PS2HL_OK)
+		return Result;
+
+	// Compress PAKs
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
+	Result = CompressPAK(cTempFileName);
+	if (Result != PS2HL_OK)
+		return Result;
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "gre-", cFName, ".PAK");
+	Result = CompressPAK(cTempFileName);
+	if (Result != PS2HL_OK)
+		return Result;
+
+	// Delete temp files
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
+	remove(cTempFileName);
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "gre-", cFName, ".PAK");
+	remove(cTempFileName);
+
+	// Rename comressed files
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "cmp-", cFName, ".PAK");
+	snprintf(cNewFileName, sizeof(cNewFileName), "%s%s", cPath, "GLOBAL.PAK");
+	FileSafeRename(cTempFileName, cNewFileName);
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "cmp-gre-", cFName, ".PAK");
+	snprintf(cNewFileName, sizeof(cNewFileName), "%s%s", cPath, "GRESTORE.PAK");
+	FileSafeRename(cTempFileName, cNewFileName);
+
+	return PS2HL_OK;
+}
+
 
-	puts(PROG_TITLE);
+////////// PAK image //////////
+struct sPAKImage
+{
+	uchar * Data;						// Header and file data (file table is put after it on save)
+	ulong DataSize;						// Used bytes
+	ulong DataSpace;					// Allocated bytes
+	sPS2PAKFileEntry * Table;			// File table
+	ulong FileCount;					// Entries in table
+	ulong TableSpace;					// Allocated entries
+	ulong SegmentSize;					// Entry alignment
+	ulong Holes;						// Bytes of data that no entry uses anymore
+	bool Compressed;					// Save as compressed PAK
+};
+
+static bool GrowPAKData(sPAKImage * Image, ulong Size)
+{
+	uchar * NewData;
+	ulong NewSpace;
+
+	if (Size <= Image->DataSpace)
+		return true;
+
+	NewSpace = Image->DataSpace ? Image->DataSpace : 0x10000;
+	while (NewSpace < Size)
+		NewSpace *= 2;
+
+	NewData = (uchar *)LibAlloc(NewSpace);
+	if (NewData == NULL)
+		return false;
+	memcpy(NewData, Image->Data, Image->DataSize);
+	LibFree(Image->Data);
+	Image->Data = NewData;
+	Image->DataSpace = NewSpace;
+
+	return true;
+}
 
-	if (argc == 1)
+static bool GrowPAKTable(sPAKImage * Image)
+{
+	sPS2PAKFileEntry * NewTable;
+	ulong NewSpace;
+
+	if (Image->FileCount < Image->TableSpace)
+		return true;
+
+	NewSpace = Image->TableSpace ? Image->TableSpace * 2 : 16;
+	NewTable = (sPS2PAKFileEntry *)LibAlloc(sizeof(sPS2PAKFileEntry) * NewSpace);
+	if (NewTable == NULL)
+		return false;
+	memcpy(NewTable, Image->Table, sizeof(sPS2PAKFileEntry) * Image->FileCount);
+	LibFree(Image->Table);
+	Image->Table = NewTable;
+	Image->TableSpace = NewSpace;
+
+	return true;
+}
+
+static bool CompactPAKImage(sPAKImage * Image)	// Pack entries back to back in table order
+{
+	uchar * NewData;
+	ulong Offset;
+	ulong Space;
+
+	NewData = (uchar *)LibAlloc(Image->DataSpace);
+	if (NewData == NULL)
+		return false;
+
+	Offset = CalculateFileSpace(sizeof(sPS2NormalPAKHeader), Image->SegmentSize);
+	memcpy(NewData, Image->Data, Offset);
+	for (ulong i = 0; i < Image->FileCount; i++)
 	{
-		puts(PROG_INFO);
-		UTIL_WAIT_KEY("Press any key to exit ...");
+		Space = CalculateFileSpace(Image->Table[i].FileSize, Image->SegmentSize);
+		memcpy(&NewData[Offset], &Image->Data[Image->Table[i].FileOffset], Space);
+		Image->Table[i].FileOffset = Offset;
+		Offset += Space;
 	}
-	else if (argc == 2)
+
+	LibFree(Image->Data);
+	Image->Data = NewData;
+	Image->DataSize = Offset;
+	Image->Holes = 0;
+
+	return true;
+}
+
+int FindPAKEntry(sPAKImage * Image, const char * EntryName)
+{
+	for (ulong i = 0; i < Image->FileCount; i++)
+		if (!strncmp(Image->Table[i].FileName, EntryName, sizeof(Image->Table[i].FileName)))
+			return i;
+
+	return -1;
+}
+
+int NewPAKImage(bool Compressed, sPAKImage ** ptrImage)
+{
+	sPAKImage * Image;
+
+	*ptrImage = NULL;
+	Image = (sPAKImage *)LibCalloc(1, sizeof(sPAKImage));
+	if (Image == NULL)
 	{
-		if (CheckDir(argv[1]) == true)						// Folder
-		{
-			puts("\nChoose PAK type:");
-			puts(" n - normal, align=2048 [PAK0, DECALS, UGMESAVE, DICTS]");
-			puts(" s - normal, align=16 [pausegui, discfail]");
-			puts(" c - compressed, align=16 [VALVE, DECAY, MIDHL, MIDTOH, MIDDECAY, FRONTEND,");
-			puts("\tGUISOUND, GDECALS, CGMESAVE, SYSSAVE, SYSTEM]");
-			puts(" g - global, compressed, align=16, *.spz patch [GLOBAL+GRESTORE]");
-			do
-			{
-				fflush(stdout);
-				Action = getc(stdin);
-			} while (Action != 'n' && Action != 'c' && Action != 'g' && Action != 's');
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
 
-			if (Action == 'n')
-			{
-				// Normal
-				PackPAK(argv[1], PS2HL_NPAK_SEG_SIZE);
-			}
-			else if (Action == 's')
-			{
-				// Normal with small alignment (pausegui.pak)
-				PackPAK(argv[1], PS2HL_CPAK_SEG_SIZE);
-			}
-			else if (Action == 'c')
-			{
-				// Get path and name
-				FileGetPath(argv[1], cPath, sizeof(cPath));
-				FileGetName(argv[1], cFName, sizeof(cFName), true);
-
-				// Pack
-				PackPAK(argv[1], PS2HL_CPAK_SEG_SIZE);
-				
-				// Compress
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
-				CompressPAK(cTempFileName);
-
-				// Delete temp file
-				remove(cTempFileName);
-
-				// Rename comressed file				
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "cmp-", cFName, ".PAK");
-				snprintf(cNewFileName, sizeof(cNewFileName), "%s%s%s", cPath, cFName, ".PAK");
-				FileSafeRename(cTempFileName, cNewFileName);
-			}
-			else
-			{
-				// Get path and name
-				FileGetPath(argv[1], cPath, sizeof(cPath));
-				FileGetName(argv[1], cFName, sizeof(cFName), true);
-
-				// Pack
-				PackPAK(argv[1], PS2HL_CPAK_SEG_SIZE);
-
-				// Create GRESTORE
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
-				ConvertToGRE(cTempFileName);
-
-				// Compress PAKs
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
-				CompressPAK(cTempFileName);
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "gre-", cFName, ".PAK");
-				CompressPAK(cTempFileName);
-
-				// Delete temp files
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
-				remove(cTempFileName);
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "gre-", cFName, ".PAK");
-				remove(cTempFileName);
-
-				// Rename comressed files
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "cmp-", cFName, ".PAK");
-				snprintf(cNewFileName, sizeof(cNewFileName), "%s%s", cPath, "GLOBAL.PAK");
-				FileSafeRename(cTempFileName, cNewFileName);
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "cmp-gre-", cFName, ".PAK");
-				snprintf(cNewFileName, sizeof(cNewFileName), "%s%s", cPath, "GRESTORE.PAK");
-				FileSafeRename(cTempFileName, cNewFileName);
-			}
-		}
-		else if (CheckPAK(argv[1], false) == 0)				// Normal PS2 PAK
-		{
-			// Extract
-			ExtractPAK(argv[1]);
-		}
-		else if (CheckPAK(argv[1], false) == 1)				// Compressed PS2 PAK
-		{
-			// Get path and name
-			FileGetPath(argv[1], cPath, sizeof(cPath));
-			FileGetName(argv[1], cFName, sizeof(cFName), true);
+	// Header space only, same segments as PackPAK()
+	Image->Compressed = Compressed;
+	Image->SegmentSize = Compressed ? PS2HL_CPAK_SEG_SIZE : PS2HL_NPAK_SEG_SIZE;
+	if (GrowPAKData(Image, CalculateFileSpace(sizeof(sPS2NormalPAKHeader), Image->SegmentSize)) == false)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		FreePAKImage(Image);
+		return PS2HL_ERR_MEMORY;
+	}
+	Image->DataSize = CalculateFileSpace(sizeof(sPS2NormalPAKHeader), Image->SegmentSize);
+	memset(Image->Data, 0x00, Image->DataSize);
 
-			// Decompress
-			if (DecompressPAK(argv[1]) == true)
-			{
-				// Extract
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, "dec-", cFName);
-				ExtractPAK(cTempFileName);
+	*ptrImage = Image;
+	return PS2HL_OK;
+}
 
-				// Delete temp file
-				remove(cTempFileName);
-			}
-		}
-		else if (CheckPAK(argv[1], false) == -1)			// Unsupported file
-		{
-			puts("Unsupported file ...");
-		}
+int LoadPAKImage(const char * cFile, sPAKImage ** ptrImage)
+{
+	FILE * ptrInputF;				// Input file stream
+	uPS2PAKHeader PS2PAKHeader;		// PAK header
+	uchar * FileData;				// Raw file data
+	ulong FileDataSize;				//
+	uchar * PAKData;				// Uncompressed PAK
+	ulong PAKDataSize;				//
+	sPAKImage * Image;
+
+	*ptrImage = NULL;
+
+	// Load file
+	if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	FileDataSize = FileSize(&ptrInputF);
+	if (FileDataSize < sizeof(sPS2NormalPAKHeader))
+	{
+		LibMsg(MSG_ERROR, "Unsupported file: %s \n", cFile);
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
 	}
-	else if (argc == 3)
+	FileData = (uchar *)LibAlloc(FileDataSize);
+	if (FileData == NULL)
 	{
-		if (!strcmp(argv[1], "test") == true)
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_MEMORY;
+	}
+	FileReadBlock(&ptrInputF, FileData, 0, FileDataSize);
+	fclose(ptrInputF);
+
+	Image = (sPAKImage *)LibCalloc(1, sizeof(sPAKImage));
+	if (Image == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		LibFree(FileData);
+		return PS2HL_ERR_MEMORY;
+	}
+
+	// Unpack compressed PAK (size of uncompressed data is known from header)
+	memcpy(&PS2PAKHeader, FileData, sizeof(sPS2NormalPAKHeader));
+	if (PS2PAKHeader.CheckType() == PAK_COMPRESSED)
+	{
+		if (ZDecompress(FileData + sizeof(PS2PAKHeader.Compressed.PAKSize), FileDataSize - sizeof(PS2PAKHeader.Compressed.PAKSize),
+			&PAKData, &PAKDataSize, PS2PAKHeader.Compressed.PAKSize) != PS2HL_OK)
 		{
-			CheckPAK(argv[2], true);
+			LibMsg(MSG_ERROR, "Unable to decompress file: %s \n", cFile);
+			LibFree(FileData);
+			LibFree(Image);
+			return PS2HL_ERR_ZLIB;
 		}
-		else if (!strcmp(argv[1], "extract") == true)
-		{
-			if (CheckPAK(argv[2], false) == 0)		// Normal PAK
-			{
-				// Extract
-				ExtractPAK(argv[2]);
-			}
-			else									// Compressed PAK
-			{
-				// Get path and name
-				FileGetPath(argv[2], cPath, sizeof(cPath));
-				FileGetName(argv[2], cFName, sizeof(cFName), true);
+		LibFree(FileData);
+		Image->Compressed = true;
+		if (PAKDataSize >= sizeof(sPS2NormalPAKHeader))
+			memcpy(&PS2PAKHeader, PAKData, sizeof(sPS2NormalPAKHeader));
+		else
+			memset(&PS2PAKHeader, 0x00, sizeof(sPS2NormalPAKHeader));
+	}
+	else
+	{
+		PAKData = FileData;
+		PAKDataSize = FileDataSize;
+	}
 
-				// Decompress
-				if (DecompressPAK(argv[2]) == true)
-				{
-					// Extract
-					snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, "dec-", cFName);
-					ExtractPAK(cTempFileName);
+	// Check table
+	if (PS2PAKHeader.CheckType() != PAK_NORMAL || PS2PAKHeader.Normal.TableOffset < sizeof(sPS2NormalPAKHeader) ||
+		PS2PAKHeader.Normal.TableOffset > PAKDataSize || PS2PAKHeader.Normal.TableSize > PAKDataSize - PS2PAKHeader.Normal.TableOffset ||
+		PS2PAKHeader.Normal.TableSize % sizeof(sPS2PAKFileEntry) != 0)
+	{
+		LibMsg(MSG_ERROR, "Unsupported file: %s \n", cFile);
+		LibFree(PAKData);
+		LibFree(Image);
+		return PS2HL_ERR_FORMAT;
+	}
 
-					// Delete temp file
-					remove(cTempFileName);
-				}
-			}
-		}
-		else if (!strcmp(argv[1], "pack") == true)
+	Image->Data = PAKData;
+	Image->DataSize = PS2PAKHeader.Normal.TableOffset;
+	Image->DataSpace = PAKDataSize;
+	Image->FileCount = PS2PAKHeader.Normal.TableSize / sizeof(sPS2PAKFileEntry);
+	Image->TableSpace = Image->FileCount + 16;	// Room for new entries
+	Image->Table = (sPS2PAKFileEntry *)LibAlloc(sizeof(sPS2PAKFileEntry) * Image->TableSpace);
+	if (Image->Table == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		FreePAKImage(Image);
+		return PS2HL_ERR_MEMORY;
+	}
+	memcpy(Image->Table, &PAKData[PS2PAKHeader.Normal.TableOffset], PS2PAKHeader.Normal.TableSize);
+
+	// Compressed PAKs use small segments, normal ones are usually aligned to CD sectors
+	Image->SegmentSize = PS2HL_CPAK_SEG_SIZE;
+	if (Image->Compressed == false && Image->FileCount != 0 && Image->DataSize % PS2HL_NPAK_SEG_SIZE == 0)
+	{
+		Image->SegmentSize = PS2HL_NPAK_SEG_SIZE;
+		for (ulong i = 0; i < Image->FileCount; i++)
+			if (Image->Table[i].FileOffset % PS2HL_NPAK_SEG_SIZE != 0)
+				Image->SegmentSize = PS2HL_CPAK_SEG_SIZE;
+	}
+
+	// Entries must stay inside of data
+	for (ulong i = 0; i < Image->FileCount; i++)
+	{
+		if (Image->Table[i].FileOffset > Image->DataSize ||
+			CalculateFileSpace(Image->Table[i].FileSize, Image->SegmentSize) > Image->DataSize - Image->Table[i].FileOffset)
 		{
-			if (CheckDir(argv[2]) == true)
-			{
-				// Pack
-				PackPAK(argv[2], PS2HL_NPAK_SEG_SIZE);
-			}
-			else
-			{
-				puts("Specified path isn't directory ...");
-			}
+			LibMsg(MSG_ERROR, "Damaged file table: %s \n", cFile);
+			FreePAKImage(Image);
+			return PS2HL_ERR_FORMAT;
 		}
-		else if (!strcmp(argv[1], "pack16") == true)
+	}
+
+	*ptrImage = Image;
+	return PS2HL_OK;
+}
+
+static uchar * PlacePAKEntry(sPAKImage * Image, const char * EntryName, ulong NewSize)	// Make room for entry contents (NULL - out of memory)
+{
+	sPS2PAKFileEntry * Entry;
+	ulong NewSpace;
+	ulong OldSpace;
+	int Index;
+
+	NewSpace = CalculateFileSpace(NewSize, Image->SegmentSize);
+
+	// New entry goes to the end of table
+	Index = FindPAKEntry(Image, EntryName);
+	if (Index < 0)
+	{
+		if (GrowPAKTable(Image) == false)
+			return NULL;
+		Index = Image->FileCount;
+		Image->Table[Index].Update(EntryName, Image->DataSize, 0);
+	}
+	Entry = &Image->Table[Index];
+	OldSpace = CalculateFileSpace(Entry->FileSize, Image->SegmentSize);
+
+	// Fits - overwrite in place, otherwise move to the end of data
+	if (NewSpace <= OldSpace && Entry->FileOffset != Image->DataSize)
+	{
+		memset(&Image->Data[Entry->FileOffset], 0x00, OldSpace);
+		Image->Holes += OldSpace - NewSpace;
+	}
+	else
+	{
+		if (GrowPAKData(Image, Image->DataSize + NewSpace) == false)
+			return NULL;
+		memset(&Image->Data[Image->DataSize], 0x00, NewSpace);
+		Image->Holes += OldSpace;
+		Entry->FileOffset = Image->DataSize;
+		Image->DataSize += NewSpace;
+	}
+
+	Entry->FileSize = NewSize;
+	if ((ulong)Index == Image->FileCount)
+		Image->FileCount++;
+
+	return &Image->Data[Entry->FileOffset];
+}
+
+int PatchPAKImage(sPAKImage * Image, const char * EntryName, const char * cFile)
+{
+	FILE * ptrInputF;
+	uchar * Place;
+	ulong NewSize;
+
+	if (strlen(EntryName) >= sizeof(Image->Table[0].FileName))
+	{
+		LibMsg(MSG_ERROR, "File name is too long for PAK: %s \n", EntryName);
+		return PS2HL_ERR_PARAM;
+	}
+
+	if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	NewSize = FileSize(&ptrInputF);
+
+	Place = PlacePAKEntry(Image, EntryName, NewSize);
+	if (Place == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_MEMORY;
+	}
+	FileReadBlock(&ptrInputF, Place, 0, NewSize);
+	fclose(ptrInputF);
+
+	return PS2HL_OK;
+}
+
+int PutPAKEntry(sPAKImage * Image, const char * EntryName, const void * Data, ulong Size)
+{
+	uchar * Place;
+
+	if (strlen(EntryName) >= sizeof(Image->Table[0].FileName))
+	{
+		LibMsg(MSG_ERROR, "File name is too long for PAK: %s \n", EntryName);
+		return PS2HL_ERR_PARAM;
+	}
+
+	Place = PlacePAKEntry(Image, EntryName, Size);
+	if (Place == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	memcpy(Place, Data, Size);
+
+	return PS2HL_OK;
+}
+
+void RemovePAKEntry(sPAKImage * Image, const char * EntryName)
+{
+	int Index = FindPAKEntry(Image, EntryName);
+
+	if (Index < 0)
+		return;
+
+	Image->Holes += CalculateFileSpace(Image->Table[Index].FileSize, Image->SegmentSize);
+	Image->FileCount--;
+	memmove(&Image->Table[Index], &Image->Table[Index + 1], sizeof(sPS2PAKFileEntry) * (Image->FileCount - Index));
+}
+
+static int ComparePAKEntries(const void * A, const void * B)
+{
+	return strncmp(((const sPS2PAKFileEntry *)A)->FileName, ((const sPS2PAKFileEntry *)B)->FileName, sizeof(((sPS2PAKFileEntry *)A)->FileName));
+}
+
+bool SortPAKImage(sPAKImage * Image)
+{
+	qsort(Image->Table, Image->FileCount, sizeof(sPS2PAKFileEntry), ComparePAKEntries);
+	return CompactPAKImage(Image);
+}
+
+int GetPAKEntryCount(sPAKImage * Image)
+{
+	return Image->FileCount;
+}
+
+const char * GetPAKEntryName(sPAKImage * Image, int Index)
+{
+	return Image->Table[Index].FileName;
+}
+
+const uchar * GetPAKEntryData(sPAKImage * Image, int Index, ulong * ptrSize)
+{
+	*ptrSize = Image->Table[Index].FileSize;
+	return &Image->Data[Image->Table[Index].FileOffset];
+}
+
+ulong GetPAKImageSize(sPAKImage * Image)
+{
+	return sizeof(sPAKImage) + Image->DataSpace + sizeof(sPS2PAKFileEntry) * Image->TableSpace;
+}
+
+int SavePAKImage(sPAKImage * Image, const char * cFile)
+{
+	FILE * ptrOutputF;
+	uPS2PAKHeader PS2PAKHeader;
+	ulong TableSize;
+	ulong PAKSize;
+	uchar * CData;
+	ulong CDataSize;
+	char cTempFileName[PATH_LEN];
+	char cNewFileName[PATH_LEN];
+	int Result;
+
+	if (Image->Holes > Image->DataSize / 2)
+		CompactPAKImage(Image);	// Not enough memory - just keep holes
+
+	// Table goes right after data
+	TableSize = sizeof(sPS2PAKFileEntry) * Image->FileCount;
+	if (GrowPAKData(Image, Image->DataSize + TableSize) == false)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	PS2PAKHeader.UpdateNormal(Image->DataSize, TableSize);
+	memcpy(Image->Data, &PS2PAKHeader, sizeof(sPS2NormalPAKHeader));
+	memcpy(&Image->Data[Image->DataSize], Image->Table, TableSize);
+	PAKSize = Image->DataSize + TableSize;
+
+	// Write temp file and replace old PAK with it
+	snprintf(cTempFileName, sizeof(cTempFileName), "%s%s", cFile, ".tmp");
+	snprintf(cNewFileName, sizeof(cNewFileName), "%s", cFile);
+	if (FileOpen(&ptrOutputF, cTempFileName, "wb") == false)
+		return PS2HL_ERR_OPEN;
+
+	if (Image->Compressed == true)
+	{
+		Result = ZCompress(Image->Data, PAKSize, &CData, &CDataSize);
+		if (Result != PS2HL_OK)
 		{
-			if (CheckDir(argv[2]) == true)
-			{
-				// Pack
-				PackPAK(argv[2], PS2HL_CPAK_SEG_SIZE);
-			}
-			else
-			{
-				puts("Specified path isn't directory ...");
-			}
+			LibMsg(MSG_ERROR, "Zlib: unable to compress file ...\n");
+			fclose(ptrOutputF);
+			remove(cTempFileName);
+			return Result;
 		}
-		else if (!strcmp(argv[1], "cpack") == true)
-		{
-			if (CheckDir(argv[2]) == true)
-			{
-				// Get path and name
-				FileGetPath(argv[2], cPath, sizeof(cPath));
-				FileGetName(argv[2], cFName, sizeof(cFName), true);
+		FileWriteBlock(&ptrOutputF, &PAKSize, sizeof(PAKSize));
+		FileWriteBlock(&ptrOutputF, CData, CDataSize);
+		LibFree(CData);
+	}
+	else
+	{
+		FileWriteBlock(&ptrOutputF, Image->Data, PAKSize);
+	}
 
-				// Pack
-				PackPAK(argv[2], PS2HL_CPAK_SEG_SIZE);
+	if (fclose(ptrOutputF) != 0)
+	{
+		LibMsg(MSG_ERROR, "Can't write file: %s \n", cTempFileName);
+		remove(cTempFileName);
+		return PS2HL_ERR_OPEN;
+	}
+	FileSafeRename(cTempFileName, cNewFileName);
 
-				// Compress
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
-				CompressPAK(cTempFileName);
+	return PS2HL_OK;
+}
 
-				// Delete temp file
-				remove(cTempFileName);
+void FreePAKImage(sPAKImage * Image)
+{
+	if (Image == NULL)
+		return;
 
-				// Rename comressed file				
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "cmp-", cFName, ".PAK");
-				snprintf(cNewFileName, sizeof(cNewFileName), "%s%s%s", cPath, cFName, ".PAK");
-				FileSafeRename(cTempFileName, cNewFileName);
-			}
-			else
-			{
-				puts("Specified path isn't directory ...");
-			}
+	LibFree(Image->Data);
+	LibFree(Image->Table);
+	LibFree(Image);
+}
+
+
+////////// Batch jobs //////////
+int RunJob(const char * Command, const char * FileName)
+{
+	// Default action - extract PAK (directories need explicit PAK type)
+	if (JobIsAuto(Command) == true)
+	{
+		if (CheckDir(FileName) == true)
+		{
+			LibMsg(MSG_ERROR, "Choose PAK type for directory (pack, pack16, cpack or gpack) ...\n");
+			return PS2HL_ERR_PARAM;
 		}
-		else if (!strcmp(argv[1], "gpack") == true)
+		if (CheckPAK(FileName, false) == PAK_UNKNOWN)
 		{
-			if (CheckDir(argv[2]) == true)
-			{
-				// Get path and name
-				FileGetPath(argv[2], cPath, sizeof(cPath));
-				FileGetName(argv[2], cFName, sizeof(cFName), true);
-
-				// Pack
-				PackPAK(argv[2], PS2HL_CPAK_SEG_SIZE);
-
-				// Create GRESTORE
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
-				ConvertToGRE(cTempFileName);
-
-				// Compress PAKs
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
-				CompressPAK(cTempFileName);
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "gre-", cFName, ".PAK");
-				CompressPAK(cTempFileName);
-
-				// Delete temp files
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s", cPath, cFName, ".PAK");
-				remove(cTempFileName);
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "gre-", cFName, ".PAK");
-				remove(cTempFileName);
-
-				// Rename comressed files
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "cmp-", cFName, ".PAK");
-				snprintf(cNewFileName, sizeof(cNewFileName), "%s%s", cPath, "GLOBAL.PAK");
-				FileSafeRename(cTempFileName, cNewFileName);
-				snprintf(cTempFileName, sizeof(cTempFileName), "%s%s%s%s", cPath, "cmp-gre-", cFName, ".PAK");
-				snprintf(cNewFileName, sizeof(cNewFileName), "%s%s", cPath, "GRESTORE.PAK");
-				FileSafeRename(cTempFileName, cNewFileName);
-			}
-			else
-			{
-				puts("Specified path isn't directory ...");
-			}
+			LibMsg(MSG_ERROR, "Unsupported file ...\n");
+			return PS2HL_ERR_FORMAT;
 		}
-		else if (!strcmp(argv[1], "decompress") == true)
+		return ExtractAnyPAK(FileName);
+	}
+
+	if (!strcmp(Command, "test"))
+		return (CheckPAK(FileName, true) != PAK_UNKNOWN) ? PS2HL_OK : PS2HL_ERR_FORMAT;
+	if (!strcmp(Command, "extract"))
+		return ExtractAnyPAK(FileName);
+	if (!strcmp(Command, "decompress"))
+		return DecompressPAK(FileName);
+	if (!strcmp(Command, "compress"))
+		return CompressPAK(FileName);
+
+	// Pack commands
+	if (!strcmp(Command, "pack") || !strcmp(Command, "pack16") || !strcmp(Command, "cpack") || !strcmp(Command, "gpack"))
+	{
+		if (CheckDir(FileName) == false)
 		{
-			DecompressPAK(argv[2]);
+			LibMsg(MSG_ERROR, "Specified path isn't directory ...\n");
+			return PS2HL_ERR_PARAM;
 		}
-		else if (!strcmp(argv[1], "compress") == true)
+
+		if (!strcmp(Command, "pack"))
+			return PackPAK(FileName, PS2HL_NPAK_SEG_SIZE);
+		if (!strcmp(Command, "pack16"))
+			return PackPAK(FileName, PS2HL_CPAK_SEG_SIZE);
+		if (!strcmp(Command, "cpack"))
+			return PackCompressedPAK(FileName);
+		return PackGlobalPAK(FileName);
+	}
+
+	LibMsg(MSG_ERROR, "Can't recognise command: %s \n", Command);
+	return PS2HL_ERR_PARAM;
+}
+
+const char * JobVersion()
+{
+	return PROG_TITLE;
+}
+
+bool SniffFile(const char * FileName)
+{
+	return CheckPAK(FileName, false) != PAK_UNKNOWN;
+}
+
+static int CompareEntryNames(const void * A, const void * B)
+{
+	const sPS2PAKFileEntry * EntryA = *(const sPS2PAKFileEntry **)A;
+	const sPS2PAKFileEntry * EntryB = *(const sPS2PAKFileEntry **)B;
+
+	return strncmp(EntryA->FileName, EntryB->FileName, sizeof(EntryA->FileName));
+}
+
+static int CompareEntryOffsets(const void * A, const void * B)
+{
+	const sPS2PAKFileEntry * EntryA = *(const sPS2PAKFileEntry **)A;
+	const sPS2PAKFileEntry * EntryB = *(const sPS2PAKFileEntry **)B;
+
+	if (EntryA->FileOffset != EntryB->FileOffset)
+		return (EntryA->FileOffset < EntryB->FileOffset) ? -1 : 1;
+	return CompareEntryNames(A, B);
+}
+
+int LintFile(const char * FileName, sLintFile * Lint)
+{
+	sPAKImage * Image;
+	sPS2PAKFileEntry ** Sorted;
+	int Result;
+
+	// Loader checks header and bounds of every entry
+	Result = LoadPAKImage(FileName, &Image);
+	if (Result == PS2HL_ERR_FORMAT || Result == PS2HL_ERR_ZLIB)
+	{
+		LintReport(Lint, LINT_ERROR, "damaged PAK (%s)", LibStatusStr(Result));
+		return PS2HL_OK;
+	}
+	if (Result != PS2HL_OK)
+		return Result;
+
+	// Names (they are looked up by game) and overlapping entries
+	Sorted = (sPS2PAKFileEntry **)LibAlloc(sizeof(sPS2PAKFileEntry *) * (Image->FileCount + 1));
+	if (Sorted == NULL)
+	{
+		FreePAKImage(Image);
+		return PS2HL_ERR_MEMORY;
+	}
+	for (ulong i = 0; i < Image->FileCount; i++)
+	{
+		sPS2PAKFileEntry * Entry = &Image->Table[i];
+
+		Sorted[i] = Entry;
+		if (memchr(Entry->FileName, '\0', sizeof(Entry->FileName)) == NULL)
 		{
-			CompressPAK(argv[2]);
+			LintReport(Lint, LINT_ERROR, "entry #%lu: name isn't terminated", (unsigned long)i);
+			Entry->FileName[sizeof(Entry->FileName) - 1] = '\0';	// Image is thrown away anyway
 		}
-		else
+		else if (Entry->FileName[0] == '\0')
 		{
-			puts("Can't recognise command ...");
+			LintReport(Lint, LINT_ERROR, "entry #%lu: empty name", (unsigned long)i);
 		}
+		if (Entry->FileOffset % PS2HL_CPAK_SEG_SIZE != 0)
+			LintReport(Lint, LINT_ERROR, "entry %s isn't aligned to 0x%X", Entry->FileName, PS2HL_CPAK_SEG_SIZE);
 	}
-	else
-	{
-		puts("Too many arguments ...");
-	}
-	
-	return 0;
+	qsort(Sorted, Image->FileCount, sizeof(sPS2PAKFileEntry *), CompareEntryNames);
+	for (ulong i = 1; i < Image->FileCount; i++)
+		if (Sorted[i]->FileName[0] != '\0' && CompareEntryNames(&Sorted[i - 1], &Sorted[i]) == 0)
+			LintReport(Lint, LINT_ERROR, "duplicate entry: %s", Sorted[i]->FileName);
+	qsort(Sorted, Image->FileCount, sizeof(sPS2PAKFileEntry *), CompareEntryOffsets);
+	for (ulong i = 1; i < Image->FileCount; i++)
+		if (Sorted[i]->FileSize != 0 && Sorted[i - 1]->FileOffset + Sorted[i - 1]->FileSize > Sorted[i]->FileOffset)
+			LintReport(Lint, LINT_ERROR, "entries %s and %s overlap", Sorted[i - 1]->FileName, Sorted[i]->FileName);
+	LibFree(Sorted);
+
+	LintEntries(Lint, Image);
+	FreePAKImage(Image);
+
+	return PS2HL_OK;
 }
+
+} // namespace pak
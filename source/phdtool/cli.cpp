@@ -0,0 +1,88 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+// 
+// This file contains command line front-end of decal tool
+// 
+
+////////// Includes //////////
+#include "util.h"
+#include "main.h"
+#include "perf.h"
+#include "log.h"
+#include "cache.h"
+
+using namespace phd;
+
+int main(int argc, char * argv[])
+{
+	char Extension[5];
+
+	// Output info
+	argc = PerfParseArgs(argc, argv);	// --stats, --trace <file>
+	argc = LogParseArgs(argc, argv, false);	// -q, -v, --log-format=jsonl
+	argc = CacheParseArgs(argc, argv);	// --cache <dir>, --cache-size <MiB>, --cache-link
+	LibSetInteractive(true);
+	LibMsg(MSG_INFO, "%s\n", PROG_TITLE);
+
+	// Cached conversion goes through job dispatch ("phdtool (command) file")
+	if (CacheEnabled() == true && (argc == 2 || argc == 3))
+		return (JobRun("phd", (argc == 3) ? argv[1] : JOB_CMD_AUTO, argv[argc - 1]) == PS2HL_OK) ? 0 : 1;
+
+	// Check arguments
+	if (argc == 1)
+	{
+		// No arguments - show help screen
+		puts(PROG_INFO);
+		UTIL_WAIT_KEY("Press any key to exit ...");
+	}
+	else if (argc == 2)
+	{
+		FileGetExtension(argv[1], Extension, sizeof(Extension));
+
+		LibMsg(MSG_INFO, "Processing file: %s \n", argv[1]);
+		if (!strcmp(Extension, ".png"))				// Convert PNG to PS2 HL Decal
+		{
+			if (ConvertPNGtoPHD(argv[1]) == PS2HL_OK)
+				return 0;
+			else
+				LibMsg(MSG_ERROR, "Can't convert decal ... \n\n");
+		}
+		else if (!strcmp(Extension, ".bmp"))		// Convert BMP to PS2 HL Decal
+		{
+			if (ConvertBMPtoPHD(argv[1], true) == PS2HL_OK)
+				return 0;
+			else
+				LibMsg(MSG_ERROR, "Can't convert decal ... \n\n");
+		}
+		else										// Convert PS2 HL Decal to BMP
+		{
+			// Convert PS2 decals to bmp by default
+			if (ConvertPHDtoBMP(argv[1], true) == PS2HL_OK)
+				return 0;
+			else
+				LibMsg(MSG_ERROR, "Can't convert decal ... \n\n");
+		}
+	}
+	else if (argc == 3)
+	{
+		if (!strcmp(argv[1], "topng"))
+		{
+			LibMsg(MSG_INFO, "Processing file: %s \n", argv[2]);
+			if (ConvertPHDtoPNG(argv[2]) == PS2HL_OK)				// Convert PS2 HL Decal to PNG
+				return 0;
+			else
+				LibMsg(MSG_ERROR, "Can't convert decal ... \n\n");
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Wrong arguments ... \n\n");
+		}
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Too many arguments ... \n\n");
+	}
+	
+	return 1;
+}
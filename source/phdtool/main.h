@@ -5,14 +5,14 @@
 // This file contains all definitions and declarations
 //
 
-#ifndef MAIN_H
-#define MAIN_H
+#ifndef PHDTOOL_MAIN_H
+#define PHDTOOL_MAIN_H
 
 ////////// Includes //////////
 #include <stdio.h>		// puts(), printf(), snprintf()
 #include <string.h>		// strcpy(), strcat(), strlen(), strncpy()
 #include <malloc.h>		// malloc(), free()
-#include <stdlib.h>		// exit()
+#include <stdlib.h>		// exit() (front-end only)
 #include <math.h>		// floor(), round()
 #include <ctype.h>		// tolower()
 
@@ -54,6 +54,29 @@ For more info check out readme.txt\n\
 // PNG Functions
 #include "pngtool.h"
 
+// Library glue (status codes, messages, allocations)
+#include "ps2hl.h"
+
+// Performance counters
+#include "perf.h"
+
+namespace phd
+{
+
+int ConvertPNGtoPHD(const char * FileName);
+int ConvertPHDtoPNG(const char * FileName);
+uint PSIProperSize(uint Size);
+bool ScaleBitmap(uchar ** Bitmap, ulong * BitmapSize, uint OldWidth, uint OldHeight, uint NewWidth, uint NewHeight, bool Linear);
+int BilinearPixel(uchar * Bitmap, int Width, int Height, int NewWidth, int NewHeight, int nx, int ny);
+uchar LinFilter(uchar PxBegin, uchar PxEnd, float Ratio);
+bool CreateMIPs(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height, uchar * ptrMIPCount);
+void PaletteFix(uchar * RGBAPalette, ulong RGBAPaletteSize, bool MulDiv);
+int ConvertBMPtoPHD(const char * FileName, bool Linear);
+int ConvertPHDtoBMP(const char * FileName, bool Linear);
+void ConvertDecalPalette(uchar * RGBAPalette, ulong RGBAPaletteSize, bool ToBMP);
+void PaletteSwapRedAndGreen(uchar * RGBAPalette, ulong RGBAPaletteSize);
+bool FlipBitmap(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height);
+
 ////////// Structures //////////
 
 // PS2 HL Decal header
@@ -189,4 +212,6 @@ struct sBMPHeader
 	}
 };
 
-#endif // MAIN_H
+} // namespace phd
+
+#endif // PHDTOOL_MAIN_H
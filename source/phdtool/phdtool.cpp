@@ -8,34 +8,28 @@
 ////////// Includes //////////
 #include "util.h"
 #include "main.h"
+#include "jobs.h"
+#include "lint.h"
+#include "catalog.h"
+#include "corpus.h"
+#include "bench.h"
+#include "texdec.h"
+
+namespace phd
+{
 
-////////// Functions //////////
-bool ConvertPNGtoPHD(const char * FileName);
-bool ConvertPHDtoPNG(const char * FileName);
-uint PSIProperSize(uint Size);
-void ScaleBitmap(uchar ** Bitmap, ulong * BitmapSize, uint OldWidth, uint OldHeight, uint NewWidth, uint NewHeight, bool Linear);
-int BilinearPixel(uchar * Bitmap, int Width, int Height, int NewWidth, int NewHeight, int nx, int ny);
-uchar LinFilter(uchar PxBegin, uchar PxEnd, float Ratio);
-uchar CreateMIPs(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height);
-void PaletteFix(uchar * RGBAPalette, ulong RGBAPaletteSize, bool MulDiv);
-bool ConvertBMPtoPHD(const char * FileName, bool Linear);
-bool ConvertPHDtoBMP(const char * FileName, bool Linear);
-void ConvertDecalPalette(uchar * RGBAPalette, ulong RGBAPaletteSize, bool ToBMP);
-void PaletteSwapRedAndGreen(uchar * RGBAPalette, ulong RGBAPaletteSize);
-void FlipBitmap(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height);
-
-
-bool ConvertPNGtoPHD(const char * FileName)
+int ConvertPNGtoPHD(const char * FileName)
 {
 	FILE *ptrInputF;						// Input file
 	FILE *ptrOutputF;						// Output file
 
 	sPNGHeader PNGHeader;
+	sPNGFile PNGFile;
 	sPHDHeader PHDHeader;
 	sPSIHeader PSIHeader;
 	uchar MIPCount;
 
-	sPNGData * PNGPalette;
+	uchar CLUT[PNG_CLUT_SIZE];				// Palette
 	sPNGData * PNGBitmap;
 	uchar BytesPerPixel;
 
@@ -43,37 +37,64 @@ bool ConvertPNGtoPHD(const char * FileName)
 	char TexName[64];
 
 	// Open file
-	SafeFileOpen(&ptrInputF, FileName, "rb");
+	if (FileOpen(&ptrInputF, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Read PNG header
 	PNGHeader.UpdateFromFile(&ptrInputF);
 	PNGHeader.SwapEndian();
 
+	// Read chunks (whole file at once)
+	if (PNGLoadFile(&ptrInputF, &PNGFile) == false)
+	{
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
+	}
+	fclose(ptrInputF);
+
 	// Check PNG header
 	if (PNGHeader.CheckType() == PNG_INDEXED)
 	{
-		printf("8-bit PNG \nParameters - Width: %i, Height: %i \n", PNGHeader.Width, PNGHeader.Height);
+		LibMsg(MSG_INFO, "%i-bit PNG \nParameters - Width: %i, Height: %i \n", PNGHeader.BitDepth, PNGHeader.Width, PNGHeader.Height);
 		BytesPerPixel = 1;
 
 		// Prepare PSI palette
-		PNGPalette = PNGReadPalette(&ptrInputF);
-		PaletteFix(PNGPalette->Data, PNGPalette->DataSize, false);
+		if (PNGReadCLUT(&PNGFile, CLUT, PNG_CLUT_HALF) == false)
+		{
+			PNGFreeFile(&PNGFile);
+			return PS2HL_ERR_FORMAT;
+		}
 
 		// Prepare PSI bitmap
-		PNGBitmap = PNGReadBitmap(&ptrInputF, PNGHeader.Width, PNGHeader.Height, BytesPerPixel, PNGHeader.BitDepth);
+		PNGBitmap = PNGReadBitmap(&PNGFile, PNGHeader.Width, PNGHeader.Height, BytesPerPixel, PNGHeader.BitDepth, PNGHeader.Interlacing);
+		if (PNGBitmap == NULL)
+		{
+			PNGFreeFile(&PNGFile);
+			return PS2HL_ERR_FORMAT;
+		}
 
 		// Resize bitmap to proper size
 		uint OriginalWidth = PNGHeader.Width;
 		uint OriginalHeight = PNGHeader.Height;
 		PNGHeader.Update(PSIProperSize(OriginalWidth), PSIProperSize(OriginalHeight), PNG_INDEXED);
-		ScaleBitmap(&PNGBitmap->Data, &PNGBitmap->DataSize, OriginalWidth, OriginalHeight, PSIProperSize(OriginalWidth), PSIProperSize(OriginalHeight), false);
 
-		// Create MIPs
-		MIPCount = CreateMIPs(&PNGBitmap->Data, &PNGBitmap->DataSize, PNGHeader.Width, PNGHeader.Height);
+		// Resize bitmap and create MIPs
+		if (ScaleBitmap(&PNGBitmap->Data, &PNGBitmap->DataSize, OriginalWidth, OriginalHeight, PSIProperSize(OriginalWidth), PSIProperSize(OriginalHeight), false) == false ||
+			CreateMIPs(&PNGBitmap->Data, &PNGBitmap->DataSize, PNGHeader.Width, PNGHeader.Height, &MIPCount) == false)
+		{
+			PNGFreeData(PNGBitmap);
+			PNGFreeFile(&PNGFile);
+			return PS2HL_ERR_MEMORY;
+		}
 
 		// Create output file
 		FileGetFullName(FileName, OutFile, sizeof(OutFile));
-		SafeFileOpen(&ptrOutputF, OutFile, "wb");
+		if (FileOpen(&ptrOutputF, OutFile, "wb") == false)
+		{
+			PNGFreeData(PNGBitmap);
+			PNGFreeFile(&PNGFile);
+			return PS2HL_ERR_OPEN;
+		}
 
 		// Write PHD header
 		PHDHeader.Update();
@@ -86,31 +107,31 @@ bool ConvertPNGtoPHD(const char * FileName)
 		FileWriteBlock(&ptrOutputF, &PSIHeader, sizeof(sPSIHeader));
 
 		// Write PSI data
-		FileWriteBlock(&ptrOutputF, PNGPalette->Data, PNGPalette->DataSize);
+		FileWriteBlock(&ptrOutputF, CLUT, sizeof(CLUT));
 		FileWriteBlock(&ptrOutputF, PNGBitmap->Data, PNGBitmap->DataSize);
 
 		// Free memory
-		free(PNGBitmap->Data);
-		free(PNGPalette->Data);
+		PNGFreeData(PNGBitmap);
 
 		// Close files
 		fclose(ptrOutputF);
 
-		puts("Done\n\n");
+		LibMsg(MSG_INFO, "Done\n\n\n");
 	}
 	else
 	{
-		puts("8 bit PNG reqired ...");
-		return false;
+		LibMsg(MSG_ERROR, "8 bit PNG reqired ...\n");
+		PNGFreeFile(&PNGFile);
+		return PS2HL_ERR_FORMAT;
 	}
 
-	// Close files
-	fclose(ptrInputF);
+	// Free file image
+	PNGFreeFile(&PNGFile);
 
-	return true;
+	return PS2HL_OK;
 }
 
-bool ConvertPHDtoPNG(const char * FileName)
+int ConvertPHDtoPNG(const char * FileName)
 {
 	FILE *ptrInputF;						// Input file
 	FILE *ptrOutputF;						// Output file
@@ -131,15 +152,19 @@ bool ConvertPHDtoPNG(const char * FileName)
 	uchar * RGBAPalette;
 	ulong RGBAPaletteSize;
 
+	bool Result;
+
 	// Open PHD
-	SafeFileOpen(&ptrInputF, FileName, "rb");
+	if (FileOpen(&ptrInputF, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Read and check PHD header
 	PHDHeader.UpdateFromFile(&ptrInputF);
 	if (PHDHeader.Check() != true)
 	{
-		puts("Invalid decal file ...");
-		return false;
+		LibMsg(MSG_ERROR, "Invalid decal file ...\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Read PSI Header
@@ -148,16 +173,17 @@ bool ConvertPHDtoPNG(const char * FileName)
 	// Check PSI Header
 	if (PSIHeader.CheckType() == PSI_INDEXED)
 	{
-		printf("Parameters - Width: %i, Height: %i \n", PSIHeader.Width, PSIHeader.Height);
+		LibMsg(MSG_INFO, "Parameters - Width: %i, Height: %i \n", PSIHeader.Width, PSIHeader.Height);
 		BytesPerPixel = 1;
 
 		// Prepare PNG palette
 		RGBAPaletteSize = 0x400;
-		RGBAPalette = (uchar *)malloc(RGBAPaletteSize);
+		RGBAPalette = (uchar *)LibAlloc(RGBAPaletteSize);
 		if (RGBAPalette == NULL)
 		{
-			puts("Unable to allocate memory! \n");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
 		}
 		FileReadBlock(&ptrInputF, RGBAPalette, sizeof(sPHDHeader) + sizeof(sPSIHeader), RGBAPaletteSize);
 		PaletteFix(RGBAPalette, RGBAPaletteSize, true);
@@ -166,21 +192,35 @@ bool ConvertPHDtoPNG(const char * FileName)
 
 		// Prepare PNG bitmap
 		RawBitmapSize = PSIHeader.Height * PSIHeader.Width * BytesPerPixel;
-		RawBitmap = (uchar *)malloc(RawBitmapSize);
+		RawBitmap = (uchar *)LibAlloc(RawBitmapSize);
 		if (RawBitmap == NULL)
 		{
-			puts("Unable to allocate memory! \n");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+			LibFree(RGBAPalette);
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
 		}
 		FileReadBlock(&ptrInputF, RawBitmap, sizeof(sPHDHeader) + sizeof(sPSIHeader) + RGBAPaletteSize, RawBitmapSize);
-		ScaleBitmap(&RawBitmap, &RawBitmapSize, PSIHeader.Width, PSIHeader.Height, PSIHeader.UpWidth, PSIHeader.UpHeight, false);	// Resize bitmap to it's original size
+		if (ScaleBitmap(&RawBitmap, &RawBitmapSize, PSIHeader.Width, PSIHeader.Height, PSIHeader.UpWidth, PSIHeader.UpHeight, false) == false)	// Resize bitmap to it's original size
+		{
+			LibFree(RawBitmap);
+			LibFree(RGBAPalette);
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
+		}
 		PNGBitmap.Data = RawBitmap;
 		PNGBitmap.DataSize = RawBitmapSize;
 
 		// Create output file
 		FileGetFullName(FileName, OutFile, sizeof(OutFile));
 		strcat(OutFile, ".png");
-		SafeFileOpen(&ptrOutputF, OutFile, "wb");
+		if (FileOpen(&ptrOutputF, OutFile, "wb") == false)
+		{
+			LibFree(RawBitmap);
+			LibFree(RGBAPalette);
+			fclose(ptrInputF);
+			return PS2HL_ERR_OPEN;
+		}
 
 		// Write PNG header
 		PNGHeader.Update(PSIHeader.UpWidth, PSIHeader.UpHeight, PNG_INDEXED);
@@ -190,28 +230,35 @@ bool ConvertPHDtoPNG(const char * FileName)
 		// Write PNG data
 		PNGWriteChunk(&ptrOutputF, "iTXt", "Comment\0\0\0\0\0Converted with PS2 Half-life PHD tool", strlen("CommentConverted with PS2 Half-life PHD tool") + 5);
 		PNGWritePalette(&ptrOutputF, &PNGPalette);
-		PNGWriteBitmap(&ptrOutputF, PSIHeader.UpWidth, PSIHeader.UpHeight, BytesPerPixel, &PNGBitmap);
-		PNGWriteChunk(&ptrOutputF, "IEND", NULL, NULL);
+		Result = PNGWriteBitmap(&ptrOutputF, PSIHeader.UpWidth, PSIHeader.UpHeight, BytesPerPixel, &PNGBitmap);
+		PNGWriteChunk(&ptrOutputF, "IEND", NULL, 0);
 
 		// Free memory
-		free(PNGBitmap.Data);
-		free(RGBAPalette);
+		LibFree(PNGBitmap.Data);
+		LibFree(RGBAPalette);
 
 		// Close file
 		fclose(ptrOutputF);
 
-		puts("Done\n\n");
+		if (Result == false)
+		{
+			fclose(ptrInputF);
+			return PS2HL_ERR_ZLIB;
+		}
+
+		LibMsg(MSG_INFO, "Done\n\n\n");
 	}
 	else
 	{
-		puts("Can't recognise decal");
-		return false;
+		LibMsg(MSG_ERROR, "Can't recognise decal\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Close file
 	fclose(ptrInputF);
 
-	return true;
+	return PS2HL_OK;
 }
 
 uint PSIProperSize(uint Size)	// Function returns closest proper dimension. PS2 HL proper PSI dimensions: 8 (min), 16, 32, 64, 128, 256, 512, ...
@@ -237,20 +284,20 @@ uint PSIProperSize(uint Size)	// Function returns closest proper dimension. PS2
 	}
 }
 
-void ScaleBitmap(uchar ** Bitmap, ulong * BitmapSize, uint OldWidth, uint OldHeight, uint NewWidth, uint NewHeight, bool Linear)
+bool ScaleBitmap(uchar ** Bitmap, ulong * BitmapSize, uint OldWidth, uint OldHeight, uint NewWidth, uint NewHeight, bool Linear)
 {
 	uchar * NewBitmap;
 
 	// Skip if image has target size already
 	if (OldWidth == NewWidth && OldHeight == NewHeight)
-		return;
+		return true;
 
 	// Allocate memory for new bitmap
-	NewBitmap = (uchar *)malloc(NewWidth * NewHeight);
+	NewBitmap = (uchar *)LibAlloc(NewWidth * NewHeight);
 	if (NewBitmap == NULL)
 	{
-		UTIL_WAIT_KEY("Unable to allocate memory ...");
-		exit(EXIT_FAILURE);
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return false;
 	}
 
 	// Resize bitmap
@@ -279,13 +326,15 @@ void ScaleBitmap(uchar ** Bitmap, ulong * BitmapSize, uint OldWidth, uint OldHei
 	}
 
 	// Destroy old bitmap
-	free(*Bitmap);
+	LibFree(*Bitmap);
 
 	// Set pointer to resized bitmap
 	*Bitmap = NewBitmap;
 
 	// Update bitmap size
 	*BitmapSize = NewWidth * NewHeight;
+
+	return true;
 }
 
 // Args:
@@ -340,7 +389,7 @@ int BilinearPixel(uchar * Bitmap, int Width, int Height, int NewWidth, int NewHe
 	return LinFilter(hSampleTop, hSampleBot, RatioY);
 }
 
-uchar CreateMIPs(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height)			// Create MIPs for decal. Function overrides old bitmap and returns MIP count.
+bool CreateMIPs(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height, uchar * ptrMIPCount)			// Create MIPs for decal. Function overrides old bitmap and outputs MIP count.
 {
 	uint a;
 	uint b;
@@ -365,7 +414,12 @@ uchar CreateMIPs(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height)
 
 	// Allocate memory for new bitmap
 	NewBitmapSize = *BitmapSize + MIPSize;
-	NewBitmap = (uchar *)malloc(NewBitmapSize);
+	NewBitmap = (uchar *)LibAlloc(NewBitmapSize);
+	if (NewBitmap == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return false;
+	}
 
 	// Actual MIP creation work
 	ulong Offset = 0;
@@ -392,17 +446,20 @@ uchar CreateMIPs(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height)
 
 
 	// Destroy old bitmap
-	free(OldBitmap);
+	LibFree(OldBitmap);
 
 	// Save pointer to new bitmap
 	*Bitmap = NewBitmap;
 	*BitmapSize = NewBitmapSize;
+	*ptrMIPCount = MIPCount;
 
-	return MIPCount;
+	return true;
 }
 
 void PaletteFix(uchar * RGBAPalette, ulong RGBAPaletteSize,  bool MulDiv)			// Fix/unfix color table
 {
+	PERF_SCOPE(PERF_PH_PALETTE);
+
 	uchar Remainder;
 	uchar Temp;
 
@@ -430,7 +487,7 @@ void PaletteFix(uchar * RGBAPalette, ulong RGBAPaletteSize,  bool MulDiv)			// F
 	}
 }
 
-bool ConvertBMPtoPHD(const char * FileName, bool Linear)
+int ConvertBMPtoPHD(const char * FileName, bool Linear)
 {
 	FILE *ptrInputF;						// Input file
 	FILE *ptrOutputF;						// Output file
@@ -450,7 +507,8 @@ bool ConvertBMPtoPHD(const char * FileName, bool Linear)
 	char TexName[64];
 
 	// Open file
-	SafeFileOpen(&ptrInputF, FileName, "rb");
+	if (FileOpen(&ptrInputF, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Read BMP header
 	BMPHeader.UpdateFromFile(&ptrInputF);
@@ -458,29 +516,38 @@ bool ConvertBMPtoPHD(const char * FileName, bool Linear)
 	// Check BMP header
 	if (BMPHeader.Check() == true)
 	{
-		printf("8-bit BMP \nParameters - Width: %i, Height: %i \n", BMPHeader.Width, BMPHeader.Height);
+		LibMsg(MSG_INFO, "8-bit BMP \nParameters - Width: %i, Height: %i \n", BMPHeader.Width, BMPHeader.Height);
 
 		// Prepare PSI palette
 		RGBAPaletteSize = 0x400;
-		RGBAPalette = (uchar *)malloc(RGBAPaletteSize);
+		RGBAPalette = (uchar *)LibAlloc(RGBAPaletteSize);
 		if (RGBAPalette == NULL)
 		{
-			puts("Unable to allocate memory! \n");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
 		}
 		FileReadBlock(&ptrInputF, RGBAPalette, sizeof(sBMPHeader), RGBAPaletteSize);
 		PaletteSwapRedAndGreen(RGBAPalette, RGBAPaletteSize);
 
 		// Prepare PSI bitmap
 		RawBitmapSize = BMPHeader.Height * BMPHeader.Width;
-		RawBitmap = (uchar *)malloc(RawBitmapSize);
+		RawBitmap = (uchar *)LibAlloc(RawBitmapSize);
 		if (RawBitmap == NULL)
 		{
-			puts("Unable to allocate memory! \n");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+			LibFree(RGBAPalette);
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
 		}
 		FileReadBlock(&ptrInputF, RawBitmap, sizeof(sBMPHeader) + RGBAPaletteSize, RawBitmapSize);
-		FlipBitmap(&RawBitmap, &RawBitmapSize, BMPHeader.Width, BMPHeader.Height);
+		if (FlipBitmap(&RawBitmap, &RawBitmapSize, BMPHeader.Width, BMPHeader.Height) == false)
+		{
+			LibFree(RawBitmap);
+			LibFree(RGBAPalette);
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
+		}
 
 		// Fix palette
 		ConvertDecalPalette(RGBAPalette, RGBAPaletteSize, false);
@@ -490,14 +557,26 @@ bool ConvertBMPtoPHD(const char * FileName, bool Linear)
 		uint OriginalWidth = BMPHeader.Width;
 		uint OriginalHeight = BMPHeader.Height;
 		BMPHeader.Update(PSIProperSize(OriginalWidth), PSIProperSize(OriginalHeight));
-		ScaleBitmap(&RawBitmap, &RawBitmapSize, OriginalWidth, OriginalHeight, PSIProperSize(OriginalWidth), PSIProperSize(OriginalHeight), Linear);
 
-		// Create MIPs
-		MIPCount = CreateMIPs(&RawBitmap, &RawBitmapSize, BMPHeader.Width, BMPHeader.Height);
+		// Resize bitmap and create MIPs
+		if (ScaleBitmap(&RawBitmap, &RawBitmapSize, OriginalWidth, OriginalHeight, PSIProperSize(OriginalWidth), PSIProperSize(OriginalHeight), Linear) == false ||
+			CreateMIPs(&RawBitmap, &RawBitmapSize, BMPHeader.Width, BMPHeader.Height, &MIPCount) == false)
+		{
+			LibFree(RawBitmap);
+			LibFree(RGBAPalette);
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
+		}
 
 		// Create output file
 		FileGetFullName(FileName, OutFile, sizeof(OutFile));
-		SafeFileOpen(&ptrOutputF, OutFile, "wb");
+		if (FileOpen(&ptrOutputF, OutFile, "wb") == false)
+		{
+			LibFree(RawBitmap);
+			LibFree(RGBAPalette);
+			fclose(ptrInputF);
+			return PS2HL_ERR_OPEN;
+		}
 
 		// Write PHD header
 		PHDHeader.Update();
@@ -514,27 +593,28 @@ bool ConvertBMPtoPHD(const char * FileName, bool Linear)
 		FileWriteBlock(&ptrOutputF, RawBitmap, RawBitmapSize);
 
 		// Free memory
-		free(RGBAPalette);
-		free(RawBitmap);
+		LibFree(RGBAPalette);
+		LibFree(RawBitmap);
 
 		// Close files
 		fclose(ptrOutputF);
 
-		puts("Done\n\n");
+		LibMsg(MSG_INFO, "Done\n\n\n");
 	}
 	else
 	{
-		puts("8 bit BMP reqired ...");
-		return false;
+		LibMsg(MSG_ERROR, "8 bit BMP reqired ...\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Close files
 	fclose(ptrInputF);
 
-	return true;
+	return PS2HL_OK;
 }
 
-bool ConvertPHDtoBMP(const char * FileName, bool Linear)
+int ConvertPHDtoBMP(const char * FileName, bool Linear)
 {
 	FILE *ptrInputF;						// Input file
 	FILE *ptrOutputF;						// Output file
@@ -552,14 +632,16 @@ bool ConvertPHDtoBMP(const char * FileName, bool Linear)
 	char OutFile[PATH_LEN];
 
 	// Open PHD
-	SafeFileOpen(&ptrInputF, FileName, "rb");
+	if (FileOpen(&ptrInputF, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Read and check PHD header
 	PHDHeader.UpdateFromFile(&ptrInputF);
 	if (PHDHeader.Check() != true)
 	{
-		puts("Invalid decal file ...");
-		return false;
+		LibMsg(MSG_ERROR, "Invalid decal file ...\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Read PSI Header
@@ -568,15 +650,16 @@ bool ConvertPHDtoBMP(const char * FileName, bool Linear)
 	// Check PSI Header
 	if (PSIHeader.CheckType() == PSI_INDEXED)
 	{
-		printf("Parameters - Width: %i, Height: %i \n", PSIHeader.Width, PSIHeader.Height);
+		LibMsg(MSG_INFO, "Parameters - Width: %i, Height: %i \n", PSIHeader.Width, PSIHeader.Height);
 
 		// Prepare BMP palette
 		RGBAPaletteSize = 0x400;
-		RGBAPalette = (uchar *)malloc(RGBAPaletteSize);
+		RGBAPalette = (uchar *)LibAlloc(RGBAPaletteSize);
 		if (RGBAPalette == NULL)
 		{
-			puts("Unable to allocate memory! \n");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
 		}
 		FileReadBlock(&ptrInputF, RGBAPalette, sizeof(sPHDHeader) + sizeof(sPSIHeader), RGBAPaletteSize);
 		PaletteFix(RGBAPalette, RGBAPaletteSize, true);
@@ -584,25 +667,39 @@ bool ConvertPHDtoBMP(const char * FileName, bool Linear)
 
 		// Prepare BMP bitmap
 		RawBitmapSize = PSIHeader.Height * PSIHeader.Width;
-		RawBitmap = (uchar *)malloc(RawBitmapSize);
+		RawBitmap = (uchar *)LibAlloc(RawBitmapSize);
 		if (RawBitmap == NULL)
 		{
-			puts("Unable to allocate memory! \n");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+			LibFree(RGBAPalette);
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
 		}
 		FileReadBlock(&ptrInputF, RawBitmap, sizeof(sPHDHeader) + sizeof(sPSIHeader) + RGBAPaletteSize, RawBitmapSize);
-		FlipBitmap(&RawBitmap, &RawBitmapSize, PSIHeader.Width, PSIHeader.Height);		
 
 		// Fix palette
 		ConvertDecalPalette(RGBAPalette, RGBAPaletteSize, true);
 
-		// Resize bitmap to it's original size
-		ScaleBitmap(&RawBitmap, &RawBitmapSize, PSIHeader.Width, PSIHeader.Height, PSIHeader.UpWidth, PSIHeader.UpHeight, Linear);
+		// Flip bitmap and resize it to it's original size
+		if (FlipBitmap(&RawBitmap, &RawBitmapSize, PSIHeader.Width, PSIHeader.Height) == false ||
+			ScaleBitmap(&RawBitmap, &RawBitmapSize, PSIHeader.Width, PSIHeader.Height, PSIHeader.UpWidth, PSIHeader.UpHeight, Linear) == false)
+		{
+			LibFree(RawBitmap);
+			LibFree(RGBAPalette);
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
+		}
 
 		// Create output file
 		FileGetFullName(FileName, OutFile, sizeof(OutFile));
 		strcat(OutFile, ".bmp");
-		SafeFileOpen(&ptrOutputF, OutFile, "wb");
+		if (FileOpen(&ptrOutputF, OutFile, "wb") == false)
+		{
+			LibFree(RawBitmap);
+			LibFree(RGBAPalette);
+			fclose(ptrInputF);
+			return PS2HL_ERR_OPEN;
+		}
 
 		// Write BMP header
 		BMPHeader.Update(PSIHeader.UpWidth, PSIHeader.UpHeight);
@@ -613,36 +710,37 @@ bool ConvertPHDtoBMP(const char * FileName, bool Linear)
 		FileWriteBlock(&ptrOutputF, RawBitmap, RawBitmapSize);
 
 		// Free memory
-		free(RawBitmap);
-		free(RGBAPalette);
+		LibFree(RawBitmap);
+		LibFree(RGBAPalette);
 
 		// Close file
 		fclose(ptrOutputF);
 
-		puts("Done\n\n");
+		LibMsg(MSG_INFO, "Done\n\n\n");
 	}
 	else
 	{
-		puts("Can't recognise decal");
-		return false;
+		LibMsg(MSG_ERROR, "Can't recognise decal\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
 	}
 
 	// Close file
 	fclose(ptrInputF);
 
-	return true;
+	return PS2HL_OK;
 }
 
-void FlipBitmap(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height)		// Flip bitmap vertically. Needed for conversion to\from BMP
+bool FlipBitmap(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height)		// Flip bitmap vertically. Needed for conversion to\from BMP
 {
 	uchar * NewBitmap;
 
 	// Allocate memory for new bitmap
-	NewBitmap = (uchar *)malloc(Width * Height);
+	NewBitmap = (uchar *)LibAlloc(Width * Height);
 	if (NewBitmap == NULL)
 	{
-		UTIL_WAIT_KEY("Unable to allocate memory ...");
-		exit(EXIT_FAILURE);
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return false;
 	}
 
 	// Copy flipped bitmap to new place
@@ -651,14 +749,18 @@ void FlipBitmap(uchar ** Bitmap, ulong * BitmapSize, uint Width, uint Height)		/
 			NewBitmap[(Width * y) + x] = (*Bitmap)[(Width * ((Height - 1) - y)) + x];
 
 	// Destroy old bitmap
-	free(*Bitmap);
+	LibFree(*Bitmap);
 
 	// Save pointer to new bitmap
 	*Bitmap = NewBitmap;
+
+	return true;
 }
 
 void ConvertDecalPalette(uchar * RGBAPalette, ulong RGBAPaletteSize, bool ToBMP)
 {
+	PERF_SCOPE(PERF_PH_PALETTE);
+
 	// Get decal color from the last entry in palette
 	uchar PaletteElementSize = 4;
 	int LastBase = (EIGHT_BIT_PALETTE_ELEMENTS_COUNT - 1) * PaletteElementSize;
@@ -723,67 +825,386 @@ void PaletteSwapRedAndGreen(uchar * RGBAPalette, ulong RGBAPaletteSize)
 	}
 }
 
-int main(int argc, char * argv[])
+
+////////// Decoding //////////
+bool SniffPHD(const uchar * Data, ulong DataSize)
 {
-	char Extension[5];
+	sPHDHeader PHDHeader;
+	sPSIHeader PSIHeader;
+
+	if (DataSize < sizeof(sPHDHeader) + sizeof(sPSIHeader))
+		return false;
+	memcpy(&PHDHeader, Data, sizeof(sPHDHeader));
+	memcpy(&PSIHeader, &Data[sizeof(sPHDHeader)], sizeof(sPSIHeader));
 
-	// Output info
-	puts(PROG_TITLE);
+	return PHDHeader.Check() == true && PSIHeader.CheckType() == PSI_INDEXED;
+}
 
-	// Check arguments
-	if (argc == 1)
+int DecodePHDPalette(const uchar * Data, ulong DataSize, uchar * Palette)
+{
+	if (SniffPHD(Data, DataSize) == false || DataSize < sizeof(sPHDHeader) + sizeof(sPSIHeader) + TEX_PALETTE_SIZE)
+		return PS2HL_ERR_FORMAT;
+
+	memcpy(Palette, &Data[sizeof(sPHDHeader) + sizeof(sPSIHeader)], TEX_PALETTE_SIZE);
+	PaletteFix(Palette, TEX_PALETTE_SIZE, true);
+
+	return PS2HL_OK;
+}
+
+int DecodePHD(const uchar * Data, ulong DataSize, const uchar * Palette, uchar ** ptrRGBA, uint * ptrWidth, uint * ptrHeight)
+{
+	sPSIHeader PSIHeader;
+	uchar OwnPalette[TEX_PALETTE_SIZE];
+	ulong Offset = sizeof(sPHDHeader) + sizeof(sPSIHeader) + TEX_PALETTE_SIZE;
+	uchar * Bitmap;
+	ulong BitmapSize;
+	uchar * RGBA;
+	int Result;
+
+	if (SniffPHD(Data, DataSize) == false)
+		return PS2HL_ERR_FORMAT;
+	memcpy(&PSIHeader, &Data[sizeof(sPHDHeader)], sizeof(sPSIHeader));
+	BitmapSize = PSIHeader.Width * PSIHeader.Height;
+	if (DataSize < Offset + BitmapSize)
+		return PS2HL_ERR_FORMAT;
+	if (Palette == NULL)
 	{
-		// No arguments - show help screen
-		puts(PROG_INFO);
-		UTIL_WAIT_KEY("Press any key to exit ...");
+		Result = DecodePHDPalette(Data, DataSize, OwnPalette);
+		if (Result != PS2HL_OK)
+			return Result;
+		Palette = OwnPalette;
 	}
-	else if (argc == 2)
+
+	// Biggest MIP, resized to original size (same as PHD -> PNG)
+	Bitmap = (uchar *)LibAlloc(BitmapSize);
+	if (Bitmap == NULL)
+		return PS2HL_ERR_MEMORY;
+	memcpy(Bitmap, &Data[Offset], BitmapSize);
+	if (ScaleBitmap(&Bitmap, &BitmapSize, PSIHeader.Width, PSIHeader.Height, PSIHeader.UpWidth, PSIHeader.UpHeight, false) == false)
 	{
-		FileGetExtension(argv[1], Extension, sizeof(Extension));
+		LibFree(Bitmap);
+		return PS2HL_ERR_MEMORY;
+	}
 
-		printf("Processing file: %s \n", argv[1]);
-		if (!strcmp(Extension, ".png"))				// Convert PNG to PS2 HL Decal
-		{
-			if (ConvertPNGtoPHD(argv[1]) == true)
-				return 0;
-			else
-				puts("Can't convert decal ... \n");
-		}
-		else if (!strcmp(Extension, ".bmp"))		// Convert BMP to PS2 HL Decal
-		{
-			if (ConvertBMPtoPHD(argv[1], true) == true)
-				return 0;
-			else
-				puts("Can't convert decal ... \n");
-		}
-		else										// Convert PS2 HL Decal to BMP
-		{
-			// Convert PS2 decals to bmp by default
-			if (ConvertPHDtoBMP(argv[1], true) == true)
-				return 0;
-			else
-				puts("Can't convert decal ... \n");
-		}
+	RGBA = (uchar *)LibAlloc(BitmapSize * 4);
+	if (RGBA == NULL)
+	{
+		LibFree(Bitmap);
+		return PS2HL_ERR_MEMORY;
 	}
-	else if (argc == 3)
+	for (ulong i = 0; i < BitmapSize; i++)
+		memcpy(&RGBA[i * 4], &Palette[Bitmap[i] * 4], 4);
+	LibFree(Bitmap);
+
+	*ptrRGBA = RGBA;
+	*ptrWidth = PSIHeader.UpWidth;
+	*ptrHeight = PSIHeader.UpHeight;
+	return PS2HL_OK;
+}
+
+
+////////// Batch jobs //////////
+int RunJob(const char * Command, const char * FileName)
+{
+	char Extension[5];
+
+	LibMsg(MSG_INFO, "Processing file: %s \n", FileName);
+
+	// Convert PS2 HL Decal to PNG
+	if (JobIsAuto(Command) == false)
 	{
-		if (!strcmp(argv[1], "topng"))
-		{
-			printf("Processing file: %s \n", argv[2]);
-			if (ConvertPHDtoPNG(argv[2]) == true)				// Convert PS2 HL Decal to PNG
-				return 0;
-			else
-				puts("Can't convert decal ... \n");
-		}
-		else
+		if (!strcmp(Command, "topng"))
+			return ConvertPHDtoPNG(FileName);
+
+		LibMsg(MSG_ERROR, "Can't recognise command: %s \n", Command);
+		return PS2HL_ERR_PARAM;
+	}
+
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (!strcmp(Extension, ".png"))				// Convert PNG to PS2 HL Decal
+		return ConvertPNGtoPHD(FileName);
+	if (!strcmp(Extension, ".bmp"))				// Convert BMP to PS2 HL Decal
+		return ConvertBMPtoPHD(FileName, true);
+
+	// Convert PS2 decals to bmp by default
+	return ConvertPHDtoBMP(FileName, true);
+}
+
+const char * JobVersion()
+{
+	return PROG_TITLE;
+}
+
+bool SniffFile(const char * FileName)
+{
+	char Extension[5];
+	FILE * ptrFile;
+	bool Result;
+
+	// *.png is ambiguous (PSI or decal), so it isn't recognised
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (!strcmp(Extension, ".png"))
+		return false;
+
+	ptrFile = FileProbe(FileName, "rb");
+	if (ptrFile == NULL)
+		return false;
+
+	if (!strcmp(Extension, ".bmp"))
+	{
+		// 8-bit BMP
+		sBMPHeader BMPHeader;
+		memset(&BMPHeader, 0x00, sizeof(BMPHeader));
+		BMPHeader.UpdateFromFile(&ptrFile);
+		Result = BMPHeader.Check();
+	}
+	else
+	{
+		// Decal (zero filled header, so at least header should fit)
+		sPHDHeader PHDHeader;
+		Result = false;
+		if (FileSize(&ptrFile) > sizeof(PHDHeader))
 		{
-			puts("Wrong arguments ... \n");
+			PHDHeader.Update();
+			PHDHeader.UpdateFromFile(&ptrFile);
+			Result = PHDHeader.Check();
 		}
 	}
-	else
+
+	fclose(ptrFile);
+	return Result;
+}
+
+int LintFile(const char * FileName, sLintFile * Lint)
+{
+	char Extension[5];
+	FILE * ptrFile;
+	sBMPHeader BMPHeader;
+	sPHDHeader PHDHeader;
+	sPSIHeader PSIHeader;
+	ulong Size;
+	ulong BitmapSize;
+	uchar MIPCount;
+
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	Size = FileSize(&ptrFile);
+
+	// Source of decal
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (!strcmp(Extension, ".bmp"))
+	{
+		memset(&BMPHeader, 0x00, sizeof(BMPHeader));
+		BMPHeader.UpdateFromFile(&ptrFile);
+		fclose(ptrFile);
+
+		if (Size < sizeof(sBMPHeader) || BMPHeader.Check() == false)
+			LintReport(Lint, LINT_ERROR, "not an uncompressed 8-bit BMP (%d bits per pixel)", BMPHeader.BitsPerPixel);
+		else if (BMPHeader.Offset + BMPHeader.Width * BMPHeader.Height > Size)
+			LintReport(Lint, LINT_ERROR, "bitmap (%lux%lu) is truncated", (unsigned long)BMPHeader.Width, (unsigned long)BMPHeader.Height);
+		return PS2HL_OK;
+	}
+
+	// Decal
+	memset(&PHDHeader, 0x00, sizeof(PHDHeader));
+	memset(&PSIHeader, 0x00, sizeof(PSIHeader));
+	PHDHeader.UpdateFromFile(&ptrFile);
+	PSIHeader.UpdateFromFile(&ptrFile, sizeof(sPHDHeader));
+	fclose(ptrFile);
+
+	if (Size < sizeof(sPHDHeader) + sizeof(sPSIHeader) || PHDHeader.Check() == false)
+	{
+		LintReport(Lint, LINT_ERROR, "not a PS2 decal (header isn't zero filled)");
+		return PS2HL_OK;
+	}
+	if (PSIHeader.CheckType() != PSI_INDEXED)
+	{
+		LintReport(Lint, LINT_ERROR, "decal isn't 8-bit indexed (type %lu)", (unsigned long)PSIHeader.Type);
+		return PS2HL_OK;
+	}
+	if (PSIHeader.Width != PSIProperSize(PSIHeader.Width) || PSIHeader.Height != PSIProperSize(PSIHeader.Height))
+	{
+		LintReport(Lint, LINT_ERROR, "decal is %dx%d, PS2 needs power of two (%d or more)", PSIHeader.Width, PSIHeader.Height, PSI_MIN_DIMENSION);
+		return PS2HL_OK;
+	}
+
+	// Same MIP chain as CreateMIPs() makes
+	BitmapSize = (ulong)PSIHeader.Width * PSIHeader.Height;
+	MIPCount = 0;
+	for (uint a = PSIHeader.Width, b = PSIHeader.Height; a > 8 && b > 8; a /= 2, b /= 2, MIPCount++)
+		BitmapSize += (a / 2) * (b / 2);
+	if (PSIHeader.MIPCount != MIPCount)
+		LintReport(Lint, LINT_WARN, "decal has %d MIPs, %d expected for %dx%d", PSIHeader.MIPCount, MIPCount, PSIHeader.Width, PSIHeader.Height);
+	if (sizeof(sPHDHeader) + sizeof(sPSIHeader) + TEX_PALETTE_SIZE + BitmapSize > Size)
+		LintReport(Lint, LINT_ERROR, "decal data is truncated (%lu bytes, %lu expected)", (unsigned long)Size,
+			(unsigned long)(sizeof(sPHDHeader) + sizeof(sPSIHeader) + TEX_PALETTE_SIZE + BitmapSize));
+
+	return PS2HL_OK;
+}
+
+int DescribeFile(const char * FileName, sCatalogInfo * Info)
+{
+	char Extension[5];
+	FILE * ptrFile;
+	sBMPHeader BMPHeader;
+	sPHDHeader PHDHeader;
+	sPSIHeader PSIHeader;
+
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	Info->Palette = CAT_PAL_INDEXED;
+
+	// Source of decal
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (!strcmp(Extension, ".bmp"))
+	{
+		memset(&BMPHeader, 0x00, sizeof(BMPHeader));
+		BMPHeader.UpdateFromFile(&ptrFile);
+		fclose(ptrFile);
+		if (BMPHeader.Check() == false)
+			return PS2HL_ERR_FORMAT;
+
+		Info->Width = BMPHeader.Width;
+		Info->Height = BMPHeader.Height;
+		return PS2HL_OK;
+	}
+
+	// Decal
+	memset(&PHDHeader, 0x00, sizeof(PHDHeader));
+	memset(&PSIHeader, 0x00, sizeof(PSIHeader));
+	PHDHeader.UpdateFromFile(&ptrFile);
+	PSIHeader.UpdateFromFile(&ptrFile, sizeof(sPHDHeader));
+	fclose(ptrFile);
+	if (PHDHeader.Check() == false || PSIHeader.CheckType() != PSI_INDEXED)
+		return PS2HL_ERR_FORMAT;
+
+	Info->PS2 = 1;
+	Info->Width = PSIHeader.Width;
+	Info->Height = PSIHeader.Height;
+	Info->Frames = PSIHeader.MIPCount;
+	return PS2HL_OK;
+}
+
+int GenerateFile(const char * FileName, sCorpusSpec * Spec)
+{
+	FILE * ptrFile;
+	sBMPHeader BMPHeader;
+	char Extension[5];
+	uchar * Bitmap;
+	ulong BitmapSize = (ulong)Spec->Width * Spec->Height;
+
+	// Decals are made as 8-bit BMP (width has to be multiple of 4, BMP rows aren't padded here)
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (strcmp(Extension, ".bmp") || Spec->Width % 4 != 0)
+		return PS2HL_ERR_PARAM;
+
+	Bitmap = (uchar *)LibAlloc(BitmapSize + 0x400);
+	if (Bitmap == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	if (FileOpen(&ptrFile, FileName, "wb") == false)
+	{
+		LibFree(Bitmap);
+		return PS2HL_ERR_OPEN;
+	}
+
+	BMPHeader.Update(Spec->Width, Spec->Height);
+	FileWriteBlock(&ptrFile, &BMPHeader, sizeof(sBMPHeader));
+	CorpusFill(Spec, Bitmap, BitmapSize + 0x400, 256);		// Palette and bitmap
+	FileWriteBlock(&ptrFile, Bitmap, BitmapSize + 0x400);
+	fclose(ptrFile);
+
+	LibFree(Bitmap);
+	return PS2HL_OK;
+}
+
+
+// Decal kernel input: bitmap is restored from Source before each run
+struct sBenchDecal
+{
+	uchar * Bitmap;
+	ulong BitmapSize;
+	uchar * Source;
+	uint SourceWidth;
+	uint SourceHeight;
+	uint Width;					// Target size
+	uint Height;				//
+};
+
+static void BenchDecalPrepare(void * Ctx)
+{
+	sBenchDecal * Kernel = (sBenchDecal *)Ctx;
+
+	LibFree(Kernel->Bitmap);
+	Kernel->BitmapSize = Kernel->SourceWidth * Kernel->SourceHeight;
+	Kernel->Bitmap = (uchar *)LibAlloc(Kernel->BitmapSize);
+	if (Kernel->Bitmap != NULL)
+		memcpy(Kernel->Bitmap, Kernel->Source, Kernel->BitmapSize);
+}
+
+static void BenchCreateMIPs(void * Ctx)
+{
+	sBenchDecal * Kernel = (sBenchDecal *)Ctx;
+	uchar MIPCount;
+
+	if (Kernel->Bitmap != NULL)
+		CreateMIPs(&Kernel->Bitmap, &Kernel->BitmapSize, Kernel->SourceWidth, Kernel->SourceHeight, &MIPCount);
+}
+
+static void BenchBilinearPixel(void * Ctx)
+{
+	sBenchDecal * Kernel = (sBenchDecal *)Ctx;
+	int Sum = 0;
+
+	// Same loop as linear ScaleBitmap()
+	for (uint y = 0; y < Kernel->Height; y++)
+		for (uint x = 0; x < Kernel->Width; x++)
+			Sum += BilinearPixel(Kernel->Source, Kernel->SourceWidth, Kernel->SourceHeight, Kernel->Width, Kernel->Height, x, y);
+	BenchSink = Sum;
+}
+
+void BenchKernels(sBench * Bench)
+{
+	sBenchDecal Kernel;
+	char Case[32];
+	ulong Pixels;
+
+	if (BenchWants(Bench, "phd.") == false)
+		return;
+
+	memset(&Kernel, 0x00, sizeof(Kernel));
+	for (int i = 0; i < BENCH_DIM_COUNT; i++)
 	{
-		puts("Too many arguments ... \n");
+		Kernel.Width = BenchDims[i];
+		Kernel.Height = BenchDims[i];
+
+		// MIPs are made of decals with power of two sizes
+		Kernel.SourceWidth = Kernel.Width;
+		Kernel.SourceHeight = Kernel.Height;
+		Kernel.Source = (uchar *)LibAlloc(Kernel.SourceWidth * Kernel.SourceHeight);
+		if (Kernel.Source == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			return;
+		}
+		BenchFillImage(Kernel.Source, Kernel.SourceWidth * Kernel.SourceHeight, 256, i + 1);
+
+		Pixels = Kernel.Width * Kernel.Height;
+		snprintf(Case, sizeof(Case), "%ux%u", Kernel.Width, Kernel.Height);
+		BenchRun(Bench, "phd.CreateMIPs", Case, Pixels, Pixels, BenchDecalPrepare, BenchCreateMIPs, &Kernel);
+
+		// Linear resize of odd sizes (from 3/4 of target here)
+		Kernel.SourceWidth = Kernel.Width * 3 / 4;
+		Kernel.SourceHeight = Kernel.Height * 3 / 4;
+		snprintf(Case, sizeof(Case), "%ux%u->%ux%u", Kernel.SourceWidth, Kernel.SourceHeight, Kernel.Width, Kernel.Height);
+		BenchRun(Bench, "phd.BilinearPixel", Case, Pixels, Pixels, NULL, BenchBilinearPixel, &Kernel);
+
+		LibFree(Kernel.Bitmap);
+		Kernel.Bitmap = NULL;
+		LibFree(Kernel.Source);
 	}
-	
-	return 1;
 }
+
+} // namespace phd
@@ -0,0 +1,408 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains command line front-end of multi-call PS2 HL tool:
+// all tools in one binary, jobs run in one process on a thread pool
+//
+
+////////// Includes //////////
+#include "util.h"
+#include "main.h"
+#include "zlib.h"
+#include "pngtool.h"		// PNGSetThreads() (goes last: leaves "#pragma pack(1)" on)
+
+////////// Globals //////////
+static sJobList JobList;
+
+////////// Functions //////////
+static void JobTask(void * Arg)
+{
+	sJob * Job = (sJob *)Arg;
+
+	Job->Result = JobRun(Job->Tool, Job->Command, Job->FileName);
+
+	// Report progress (failed jobs always, the rest in verbose mode)
+	MutexLock(&JobList.Lock);
+	JobList.Done++;
+	if (Job->Result != PS2HL_OK)
+		JobList.Failed++;
+	LibMsg((Job->Result != PS2HL_OK) ? MSG_ERROR : MSG_DEBUG, "[%d/%d] %s: %s \n", JobList.Done, JobList.Count, Job->FileName, LibStatusStr(Job->Result));
+	LogProgress(JobList.Done, JobList.Count);
+	MutexUnlock(&JobList.Lock);
+}
+
+static char * SkipSpaces(char * Str)
+{
+	while (*Str != '\0' && isspace((uchar)*Str))
+		Str++;
+
+	return Str;
+}
+
+static char * GetWord(char * Str, char * Word, int WordSize)	// Copies first word, returns rest of the string
+{
+	int Len = 0;
+
+	while (*Str != '\0' && !isspace((uchar)*Str))
+	{
+		if (Len < WordSize - 1)
+			Word[Len++] = *Str;
+		Str++;
+	}
+	Word[Len] = '\0';
+
+	return SkipSpaces(Str);
+}
+
+static bool AddJobLine(char * Line)	// Parse "[tool [command]] file" line
+{
+	const char * Tool = JOB_CMD_AUTO;
+	const char * Command = JOB_CMD_AUTO;
+	const sJobTool * JobTool;
+	char ToolBuf[16];
+	char CommandBuf[16];
+	char * Next;
+	int Len;
+
+	// Trim
+	Line = SkipSpaces(Line);
+	Len = strlen(Line);
+	while (Len > 0 && isspace((uchar)Line[Len - 1]))
+		Line[--Len] = '\0';
+
+	// Skip empty lines and comments
+	if (Line[0] == '\0' || Line[0] == '#')
+		return true;
+
+	// Tool (optional, file name is the rest of the line and may contain spaces)
+	Next = GetWord(Line, ToolBuf, sizeof(ToolBuf));
+	JobTool = JobFindTool(ToolBuf);
+	if (Next[0] != '\0' && (JobTool != NULL || !strcmp(ToolBuf, JOB_CMD_AUTO)))
+	{
+		Tool = ToolBuf;
+		Line = Next;
+
+		// Command (optional)
+		Next = GetWord(Line, CommandBuf, sizeof(CommandBuf));
+		if (Next[0] != '\0' && ((JobTool != NULL && JobHasCommand(JobTool, CommandBuf)) || !strcmp(CommandBuf, JOB_CMD_AUTO)))
+		{
+			Command = CommandBuf;
+			Line = Next;
+		}
+	}
+
+	return JobList.Add(Tool, Command, Line);
+}
+
+static bool ReadManifest(const char * FileName)
+{
+	FILE * ptrFile;
+	char Line[JOB_LINE_LEN];
+
+	// "-" - stdin
+	if (!strcmp(FileName, "-"))
+		ptrFile = stdin;
+	else if (FileOpen(&ptrFile, FileName, "r") == false)
+		return false;
+
+	while (fgets(Line, sizeof(Line), ptrFile) != NULL)
+	{
+		if (AddJobLine(Line) == false)
+		{
+			if (ptrFile != stdin)
+				fclose(ptrFile);
+			return false;
+		}
+	}
+
+	if (ptrFile != stdin)
+		fclose(ptrFile);
+
+	return true;
+}
+
+int main(int argc, char * argv[])
+{
+	const char * Tool = JOB_CMD_AUTO;
+	const char * Command = JOB_CMD_AUTO;
+	const char * Manifest = NULL;
+	const sJobTool * JobTool = NULL;
+	char ProgName[PATH_LEN];
+	int Threads = 0;
+	int Spare;
+	int Arg = 1;
+	int Result;
+
+	argc = PerfParseArgs(argc, argv);	// --stats, --trace <file>
+	argc = LogParseArgs(argc, argv, true);	// -q, -v, --log-format=jsonl
+	argc = CacheParseArgs(argc, argv);	// --cache <dir>, --cache-size <MiB>, --cache-link
+	LibMsg(MSG_INFO, "%s\n", PROG_TITLE);
+
+	// Multi-call: started as "<tool>tool" (copy or link), so tool is implied
+	FileGetName(argv[0], ProgName, sizeof(ProgName), false);
+	if (strlen(ProgName) == 7 && !strcmp(&ProgName[3], "tool"))
+	{
+		ProgName[3] = '\0';
+		JobTool = JobFindTool(ProgName);
+		if (JobTool != NULL)
+			Tool = JobTool->Name;
+	}
+
+	if (argc == 1)
+	{
+		LogFlush();
+		puts(PROG_INFO);
+		UTIL_WAIT_KEY("Press any key to exit ...");
+		return 0;
+	}
+
+	// Options
+	while (Arg < argc && argv[Arg][0] == '-' && argv[Arg][1] != '\0')
+	{
+		if (!strcmp(argv[Arg], "-j") && Arg + 1 < argc)
+		{
+			Threads = atoi(argv[Arg + 1]);
+			Arg += 2;
+		}
+		else if (!strcmp(argv[Arg], "-m") && Arg + 1 < argc)
+		{
+			Manifest = argv[Arg + 1];
+			Arg += 2;
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Can't recognise option: %s \n", argv[Arg]);
+			return 1;
+		}
+	}
+
+	// Incremental build of mod sources (once or on every change)
+	if (Manifest == NULL && Arg < argc && (!strcmp(argv[Arg], "build") || !strcmp(argv[Arg], "watch")))
+	{
+		if (Arg + 3 != argc)
+		{
+			LibMsg(MSG_ERROR, "Usage: ps2hl %s [source_dir] [output_dir] \n", argv[Arg]);
+			return 1;
+		}
+
+		if (Threads <= 0)
+			Threads = ThreadCPUCount();
+		LibSetProgressCallback(NULL, NULL);
+
+		if (!strcmp(argv[Arg], "watch"))
+			return (WatchRun(argv[Arg + 1], argv[Arg + 2], Threads) == PS2HL_OK) ? 0 : 1;
+		return (BuildRun(argv[Arg + 1], argv[Arg + 2], Threads) == PS2HL_OK) ? 0 : 1;
+	}
+
+	// One PAK in single pass, converted files never touch disk
+	if (Manifest == NULL && Arg < argc && !strcmp(argv[Arg], "topak"))
+	{
+		if (Arg + 3 != argc)
+		{
+			LibMsg(MSG_ERROR, "Usage: ps2hl topak [source_dir] [file.PAK] \n");
+			return 1;
+		}
+
+		if (Threads <= 0)
+			Threads = ThreadCPUCount();
+		LibSetProgressCallback(NULL, NULL);
+
+		return (BuildStreamPak(argv[Arg + 1], argv[Arg + 2], Threads) == PS2HL_OK) ? 0 : 1;
+	}
+
+	// Whole game to PC formats
+	if (Manifest == NULL && Arg < argc && !strcmp(argv[Arg], "dump"))
+	{
+		if (Arg + 3 != argc)
+		{
+			LibMsg(MSG_ERROR, "Usage: ps2hl dump [game_dir] [output_dir] \n");
+			return 1;
+		}
+
+		if (Threads <= 0)
+			Threads = ThreadCPUCount();
+		LibSetProgressCallback(NULL, NULL);
+
+		return (DumpRun(argv[Arg + 1], argv[Arg + 2], Threads) == PS2HL_OK) ? 0 : 1;
+	}
+
+	// Check whole tree against PS2 limits
+	if (Manifest == NULL && Arg < argc && !strcmp(argv[Arg], "lint"))
+	{
+		if (Arg + 2 != argc)
+		{
+			LibMsg(MSG_ERROR, "Usage: ps2hl lint [dir] \n");
+			return 1;
+		}
+
+		if (Threads <= 0)
+			Threads = ThreadCPUCount();
+		LibSetProgressCallback(NULL, NULL);
+
+		return (LintRun(argv[Arg + 1], Threads) == PS2HL_OK) ? 0 : 1;
+	}
+
+	// Index of every file and PAK entry
+	if (Manifest == NULL && Arg < argc && !strcmp(argv[Arg], "catalog"))
+	{
+		if (Arg + 2 != argc && Arg + 3 != argc)
+		{
+			LibMsg(MSG_ERROR, "Usage: ps2hl catalog [dir] (index_file) \n");
+			return 1;
+		}
+
+		if (Threads <= 0)
+			Threads = ThreadCPUCount();
+		LibSetProgressCallback(NULL, NULL);
+
+		return (CatalogBuild(argv[Arg + 1], (Arg + 2 < argc) ? argv[Arg + 2] : NULL, Threads) == PS2HL_OK) ? 0 : 1;
+	}
+
+	// Filters and aggregates over catalog
+	if (Manifest == NULL && Arg < argc && !strcmp(argv[Arg], "query"))
+	{
+		if (Arg + 2 > argc)
+		{
+			LibMsg(MSG_ERROR, "Usage: ps2hl query [dir|index_file] (filters) (--count) (--group column) (--sort column) \n");
+			return 1;
+		}
+
+		return (CatalogQuery(argv[Arg + 1], argc - Arg - 2, &argv[Arg + 2]) == PS2HL_OK) ? 0 : 1;
+	}
+
+	// Synthetic files for benchmarks
+	if (Manifest == NULL && Arg < argc && !strcmp(argv[Arg], "corpus"))
+	{
+		if (Arg + 2 > argc)
+		{
+			LibMsg(MSG_ERROR, "Usage: ps2hl corpus [output_dir] (key=value ...) \n");
+			return 1;
+		}
+
+		if (Threads <= 0)
+			Threads = ThreadCPUCount();
+		LibSetProgressCallback(NULL, NULL);
+
+		return (CorpusRun(argv[Arg + 1], argc - Arg - 2, &argv[Arg + 2], Threads) == PS2HL_OK) ? 0 : 1;
+	}
+
+	// Kernel microbenchmarks (single thread, so numbers don't depend on -j)
+	if (Manifest == NULL && Arg < argc && !strcmp(argv[Arg], "bench"))
+	{
+		LibSetProgressCallback(NULL, NULL);
+
+		return (BenchMain(argc - Arg - 1, &argv[Arg + 1]) == PS2HL_OK) ? 0 : 1;
+	}
+
+	// End-to-end throughput of tools on corpus
+	if (Manifest == NULL && Arg < argc && !strcmp(argv[Arg], "regress"))
+	{
+		if (Arg + 2 > argc)
+		{
+			LibMsg(MSG_ERROR, "Usage: ps2hl (-j N) regress [corpus_dir] (--runs N) (--json file) (--baseline file) (--threshold %%) (--rss-threshold %%) (scenario ...) \n");
+			return 1;
+		}
+
+		if (Threads <= 0)
+			Threads = ThreadCPUCount();
+		LibSetProgressCallback(NULL, NULL);
+
+		return (RegressRun(argv[Arg + 1], argc - Arg - 2, &argv[Arg + 2], Threads) == PS2HL_OK) ? 0 : 1;
+	}
+
+	// Requests from editors over local socket
+	if (Manifest == NULL && Arg < argc && !strcmp(argv[Arg], "serve"))
+	{
+		if (Arg + 2 < argc)
+		{
+			LibMsg(MSG_ERROR, "Usage: ps2hl serve (socket) \n");
+			return 1;
+		}
+
+		if (Threads <= 0)
+			Threads = ThreadCPUCount();
+		LibSetProgressCallback(NULL, NULL);
+
+		return (ServeRun((Arg + 1 < argc) ? argv[Arg + 1] : SERVE_DEFAULT, Threads) == PS2HL_OK) ? 0 : 1;
+	}
+
+	// Collect jobs
+	JobList.Init();
+	if (Manifest != NULL)
+	{
+		if (ReadManifest(Manifest) == false)
+		{
+			JobList.Clear();
+			return 1;
+		}
+	}
+	else
+	{
+		// Tool and command (optional)
+		if (JobTool == NULL && Arg + 1 < argc && (JobFindTool(argv[Arg]) != NULL || !strcmp(argv[Arg], JOB_CMD_AUTO)))
+		{
+			Tool = argv[Arg++];
+			JobTool = JobFindTool(Tool);
+		}
+		if (Arg + 1 < argc && ((JobTool != NULL && JobHasCommand(JobTool, argv[Arg])) || !strcmp(argv[Arg], JOB_CMD_AUTO)))
+			Command = argv[Arg++];
+
+		// Files
+		for (; Arg < argc; Arg++)
+		{
+			if (JobList.Add(Tool, Command, argv[Arg]) == false)
+			{
+				JobList.Clear();
+				return 1;
+			}
+		}
+	}
+
+	if (JobList.Count == 0)
+	{
+		LibMsg(MSG_ERROR, "Nothing to do ...\n");
+		JobList.Clear();
+		return 1;
+	}
+
+	// Run jobs (one thread per CPU by default, no more threads than jobs)
+	if (Threads <= 0)
+		Threads = ThreadCPUCount();
+	Spare = Threads;
+	if (Threads > JobList.Count)
+		Threads = JobList.Count;
+
+	// Threads that jobs leave idle deflate strips of big PNGs
+	PNGSetThreads(Spare / Threads);
+
+	// Progress of items inside jobs would mix up with job progress, show only job count
+	if (JobList.Count > 1)
+		LibSetProgressCallback(NULL, NULL);
+
+	sThreadPool Pool;
+	if (Threads > 1 && PoolStart(&Pool, Threads) == true)
+	{
+		for (int i = 0; i < JobList.Count; i++)
+			if (PoolAdd(&Pool, JobTask, &JobList.Jobs[i]) == false)
+				JobTask(&JobList.Jobs[i]);	// Out of memory - run in place
+		PoolWait(&Pool);
+		PoolStop(&Pool);
+	}
+	else
+	{
+		for (int i = 0; i < JobList.Count; i++)
+			JobTask(&JobList.Jobs[i]);
+	}
+
+	// Summary
+	LibMsg(MSG_INFO, "\nJobs: %d, failed: %d \n", JobList.Count, JobList.Failed);
+	for (int i = 0; i < JobList.Count; i++)
+		if (JobList.Jobs[i].Result != PS2HL_OK)
+			LibMsg(MSG_WARN, "  %s: %s \n", JobList.Jobs[i].FileName, LibStatusStr(JobList.Jobs[i].Result));
+
+	Result = (JobList.Failed == 0) ? 0 : 1;
+	JobList.Clear();
+
+	return Result;
+}
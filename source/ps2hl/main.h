@@ -0,0 +1,161 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains all definitions and declarations
+//
+
+#ifndef PS2HL_MAIN_H
+#define PS2HL_MAIN_H
+
+////////// Includes //////////
+#include <stdio.h>		// puts(), printf(), fgets()
+#include <string.h>		// strcpy(), strcmp(), strlen(), strncpy()
+#include <stdlib.h>		// atoi()
+#include <ctype.h>		// isspace()
+
+////////// Definitions //////////
+#define PROG_TITLE "\nPS2 HL tools v1.0\n"
+#define PROG_INFO "\
+Developed by supadupaplex, 2017-2021\n\
+License: BSD-3-Clause (check out license.txt)\n\
+Zlib library is used to perform deflate/inflate operations\n\
+\n\
+How to use:\n\
+1) Windows explorer - drag and drop files on ps2hl.exe\n\
+2) Command line\\Batch:\n\
+\tps2hl (-j N) [tool] (command) [file1] (file2) ...\n\
+\tps2hl (-j N) -m [manifest_file]\n\
+\tps2hl (-j N) build [source_dir] [output_dir]\n\
+\tps2hl (-j N) watch [source_dir] [output_dir]\n\
+\tps2hl (-j N) topak [source_dir] [file.PAK]\n\
+\tps2hl (-j N) serve (socket)\n\
+\tps2hl (-j N) dump [game_dir] [output_dir]\n\
+\tps2hl (-j N) lint [dir]\n\
+\tps2hl (-j N) catalog [dir] (index_file)\n\
+\tps2hl query [dir|index_file] (filters) (--count) (--group column) (--sort column)\n\
+\tps2hl (-j N) corpus [output_dir] (key=value ...)\n\
+\tps2hl bench (--quick) (--runs N) (--json file) (--compare file) (kernel ...)\n\
+\tps2hl (-j N) regress [corpus_dir] (--runs N) (--json file) (--baseline file) (--threshold %) (--rss-threshold %) (scenario ...)\n\
+\n\
+Tools: pak, mdl, spr, phd, psi, txt, mus, nod, epc, auto\n\
+Use \"-m -\" to read jobs from stdin\n\
+Add --stats or --trace [file.json] to profile a run\n\
+Add -q (errors only), -v (verbose) or --log-format=jsonl to change output\n\
+Add --cache [dir] to reuse results of previous runs\n\
+\n\
+For more info check out readme.txt\n\
+"
+#define JOB_LINE_LEN 1024		// Max manifest line length
+
+////////// Typedefs //////////
+#include "types.h"
+
+////////// Functions //////////
+#include "fops.h"
+#include "ps2hl.h"
+#include "jobs.h"
+#include "cache.h"
+#include "build.h"
+#include "watch.h"
+#include "serve.h"
+#include "dump.h"
+#include "lint.h"
+#include "catalog.h"
+#include "corpus.h"
+#include "bench.h"
+#include "regress.h"
+#include "thpool.h"
+#include "perf.h"
+#include "log.h"
+
+////////// Structures //////////
+
+// Single batch job
+struct sJob
+{
+	char Tool[8];			// Tool name ("auto" - sniff file)
+	char Command[16];		// Tool command ("auto" - default action)
+	char * FileName;		// Input file or directory
+	int Result;				// PS2HL_OK or error code
+};
+
+// Job list
+struct sJobList
+{
+	sJob * Jobs;			// Array of jobs
+	int Count;				// Jobs in array
+	int Size;				// Allocated entries
+	int Done;				// Finished jobs
+	int Failed;				// Jobs that returned error
+	tMutex Lock;			// Protects Done/Failed and progress output
+
+
+
+	void Init()
+	{
+		Jobs = NULL;
+		Count = Size = Done = Failed = 0;
+		MutexInit(&Lock);
+	}
+
+	bool Add(const char * NewTool, const char * NewCommand, const char * NewFileName)
+	{
+		size_t ToolLen = strlen(NewTool);
+		size_t CommandLen = strlen(NewCommand);
+
+		// Names are never cut, so unknown one can't turn into known one
+		if (ToolLen >= sizeof(Jobs->Tool) || CommandLen >= sizeof(Jobs->Command))
+		{
+			LibMsg(MSG_ERROR, "Unknown tool or command: %s %s \n", NewTool, NewCommand);
+			return false;
+		}
+
+		// Grow array
+		if (Count == Size)
+		{
+			int NewSize = Size ? Size * 2 : 64;
+			sJob * NewJobs = (sJob *)LibCalloc(NewSize, sizeof(sJob));
+			if (NewJobs == NULL)
+			{
+				LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+				return false;
+			}
+			if (Jobs != NULL)
+				memcpy(NewJobs, Jobs, sizeof(sJob) * Count);
+			LibFree(Jobs);
+			Jobs = NewJobs;
+			Size = NewSize;
+		}
+
+		// Copy file name
+		char * Name = (char *)LibAlloc(strlen(NewFileName) + 1);
+		if (Name == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			return false;
+		}
+		strcpy(Name, NewFileName);
+
+		memcpy(Jobs[Count].Tool, NewTool, ToolLen + 1);
+		memcpy(Jobs[Count].Command, NewCommand, CommandLen + 1);
+		Jobs[Count].FileName = Name;
+		Jobs[Count].Result = PS2HL_OK;
+		Count++;
+
+		return true;
+	}
+
+	void Clear()
+	{
+		for (int i = 0; i < Count; i++)
+			LibFree(Jobs[i].FileName);
+		LibFree(Jobs);
+		MutexDestroy(&Lock);
+
+		Jobs = NULL;
+		Count = Size = 0;
+	}
+};
+
+#endif // PS2HL_MAIN_H
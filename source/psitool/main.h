@@ -5,14 +5,14 @@
 // This file contains all definitions and declarations
 //
 
-#ifndef MAIN_H
-#define MAIN_H
+#ifndef PSITOOL_MAIN_H
+#define PSITOOL_MAIN_H
 
 ////////// Includes //////////
 #include <stdio.h>		// puts(), printf(), snprintf()
 #include <string.h>		// strcpy(), strcat(), strlen(), strncpy()
 #include <malloc.h>		// malloc(), free()
-#include <stdlib.h>		// exit()
+#include <stdlib.h>		// exit() (front-end only)
 #include <math.h>		// floor(), ceil()
 #include <ctype.h>		// tolower()
 
@@ -50,6 +50,19 @@ For more info check out readme.txt \n\
 // PNG Functions
 #include "pngtool.h"
 
+// Library glue (status codes, messages, allocations)
+#include "ps2hl.h"
+
+// Performance counters
+#include "perf.h"
+
+namespace psi
+{
+
+int ConvertPNGtoPSI(const char * FileName);											// PNG -> PSI
+int ConvertPSItoPNG(const char * FileName);											// PSI -> PNG
+void PatchRGBAPalette(uchar * RGBAPalette, ulong RGBAPaletteSize, bool MulDiv);		// Swizzle palette and scale colors to PS2 range (or back)
+
 ////////// Structures //////////
 
 // *.psi image header
@@ -95,4 +108,6 @@ struct sPSIHeader
 	}
 };
 
-#endif // MAIN_H
+} // namespace psi
+
+#endif // PSITOOL_MAIN_H
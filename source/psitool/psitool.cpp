@@ -8,144 +8,213 @@
 ////////// Includes //////////
 #include "util.h"
 #include "main.h"
+#include "jobs.h"
+#include "lint.h"
+#include "catalog.h"
+#include "corpus.h"
+#include "texdec.h"
+#include "pngfilt.h"
+
+namespace psi
+{
+
+// Writes decoded PNG rows straight to PSI file
+struct sPSIRowWriter
+{
+	FILE * ptrFile;
+	uchar * Row;				// RGBA row (NULL - indexed, rows are written as is)
+	uint Width;
+	uchar BytesPerPixel;		// Of PNG rows
+};
+
+static bool PSIWriteRow(void * Ctx, uint Row, const uchar * Data)
+{
+	sPSIRowWriter * Writer = (sPSIRowWriter *)Ctx;
+
+	if (Writer->Row == NULL)
+	{
+		FileWriteBlock(&Writer->ptrFile, Data, Writer->Width);
+		return true;
+	}
+
+	// 24 bit rows get opaque alpha first
+	if (Writer->BytesPerPixel == 3)
+	{
+		PNGExpandRGB(Writer->Row, Data, Writer->Width);
+		Data = Writer->Row;
+	}
 
-////////// Functions //////////
-bool ConvertPNGtoPSI(const char * FileName);
-bool ConvertPSItoPNG(const char * FileName);
-void PatchRGBAPalette(uchar * RGBAPalette, ulong RGBAPaletteSize, bool MulDiv);
+	// Divide PNG bitmap bytes by 2 to match PSI
+	for (ulong i = 0; i < (ulong)Writer->Width * 4; i++)
+		Writer->Row[i] = Data[i] / 2;
+	FileWriteBlock(&Writer->ptrFile, Writer->Row, Writer->Width * 4);
 
-bool ConvertPNGtoPSI(const char * FileName)
+	return true;
+}
+
+int ConvertPNGtoPSI(const char * FileName)
 {
 	FILE *ptrInputF;						// Input file
 	FILE *ptrOutputF;						// Output file
 
 	sPNGHeader PNGHeader;
+	sPNGFile PNGFile;
 	sPSIHeader PSIHeader;
+	sPSIRowWriter Writer;
 
-	sPNGData * PNGPalette;
-	sPNGData * PNGBitmap;
+	uchar CLUT[PNG_CLUT_SIZE];				// Palette of indexed image
 	uchar BytesPerPixel;
+	bool Success;
 
 	char OutFile[PATH_LEN];
 	char TexName[64];
 
 	// Open file
-	SafeFileOpen(&ptrInputF, FileName, "rb");
+	if (FileOpen(&ptrInputF, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Read PNG header
 	PNGHeader.UpdateFromFile(&ptrInputF);
 	PNGHeader.SwapEndian();
 
-	// Check PNG header
-	if (PNGHeader.CheckType() == PNG_RGBA || PNGHeader.CheckType() == PNG_RGB)
+	// Read chunks (whole file at once)
+	if (PNGLoadFile(&ptrInputF, &PNGFile) == false)
 	{
-		if (PNGHeader.CheckType() == PNG_RGBA)
-		{
-			printf("32-bit PNG \nParameters - Width: %i, Height: %i \n", PNGHeader.Width, PNGHeader.Height);
-			BytesPerPixel = 4;
-		}
-		else
-		{
-			printf("24-bit PNG \nParameters - Width: %i, Height: %i \n", PNGHeader.Width, PNGHeader.Height);
-			BytesPerPixel = 3;
-		}
-
-
-		// Prepare PSI data
-		PNGBitmap = PNGReadBitmap(&ptrInputF, PNGHeader.Width, PNGHeader.Height, BytesPerPixel, PNGHeader.BitDepth);
-		for (ulong i = 0; i < PNGBitmap->DataSize; i++)			// Divide PNG bitmap bytes by 2 to match PSI
-			PNGBitmap->Data[i] /= 2;
-
-		// Create output file
-		FileGetFullName(FileName, OutFile, sizeof(OutFile));
-		strcat(OutFile, ".psi");
-		SafeFileOpen(&ptrOutputF, OutFile, "wb");
-
-		// Write PSI header
-		FileGetName(FileName, TexName, sizeof(TexName), false);
-		PSIHeader.Update(TexName, PNGHeader.Width, PNGHeader.Height, PSI_RGBA);
-		FileWriteBlock(&ptrOutputF, &PSIHeader, sizeof(sPSIHeader));
-
-		// Write PSI data
-		FileWriteBlock(&ptrOutputF, PNGBitmap->Data, PNGBitmap->DataSize);
-
-		// Free memory
-		free(PNGBitmap->Data);
-
-		// Close files
-		fclose(ptrOutputF);
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
+	}
+	fclose(ptrInputF);
 
-		puts("Done\n\n");
+	// Check PNG header
+	if (PNGHeader.CheckType() == PNG_RGBA)
+	{
+		LibMsg(MSG_INFO, "32-bit PNG \nParameters - Width: %i, Height: %i \n", PNGHeader.Width, PNGHeader.Height);
+		BytesPerPixel = 4;
+	}
+	else if (PNGHeader.CheckType() == PNG_RGB)
+	{
+		LibMsg(MSG_INFO, "24-bit PNG \nParameters - Width: %i, Height: %i \n", PNGHeader.Width, PNGHeader.Height);
+		LibMsg(MSG_INFO, "Converting 24 bit bitmap to 32 bit format ...\n");
+		BytesPerPixel = 3;
 	}
 	else if (PNGHeader.CheckType() == PNG_INDEXED)
 	{
-		printf("8-bit PNG \nParameters - Width: %i, Height: %i \n", PNGHeader.Width, PNGHeader.Height);
+		LibMsg(MSG_INFO, "%i-bit PNG \nParameters - Width: %i, Height: %i \n", PNGHeader.BitDepth, PNGHeader.Width, PNGHeader.Height);
 		BytesPerPixel = 1;
 
 		// Prepare PSI palette
-		PNGPalette = PNGReadPalette(&ptrInputF);
-		PatchRGBAPalette(PNGPalette->Data, PNGPalette->DataSize, false);
+		if (PNGReadCLUT(&PNGFile, CLUT, PNG_CLUT_ALPHA) == false)
+		{
+			PNGFreeFile(&PNGFile);
+			return PS2HL_ERR_FORMAT;
+		}
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Unsupported PNG ...\n");
+		PNGFreeFile(&PNGFile);
+		return PS2HL_ERR_FORMAT;
+	}
 
-		// Prepare PSI bitmap
-		PNGBitmap = PNGReadBitmap(&ptrInputF, PNGHeader.Width, PNGHeader.Height, BytesPerPixel, PNGHeader.BitDepth);
+	// Row buffer for RGBA output
+	Writer.Width = PNGHeader.Width;
+	Writer.BytesPerPixel = BytesPerPixel;
+	Writer.Row = NULL;
+	if (BytesPerPixel != 1)
+	{
+		Writer.Row = (uchar *)LibAlloc((ulong)PNGHeader.Width * 4 + 1);
+		if (Writer.Row == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unable to allocate memory ... \n\n");
+			PNGFreeFile(&PNGFile);
+			return PS2HL_ERR_MEMORY;
+		}
+	}
 
-		// Create output file
-		FileGetFullName(FileName, OutFile, sizeof(OutFile));
-		strcat(OutFile, ".psi");
-		SafeFileOpen(&ptrOutputF, OutFile, "wb");
+	// Create output file
+	FileGetFullName(FileName, OutFile, sizeof(OutFile));
+	strcat(OutFile, ".psi");
+	if (FileOpen(&ptrOutputF, OutFile, "wb") == false)
+	{
+		LibFree(Writer.Row);
+		PNGFreeFile(&PNGFile);
+		return PS2HL_ERR_OPEN;
+	}
 
-		// Write PSI header
-		FileGetName(FileName, TexName, sizeof(TexName), false);
-		PSIHeader.Update(TexName, PNGHeader.Width, PNGHeader.Height, PSI_INDEXED);
-		FileWriteBlock(&ptrOutputF, &PSIHeader, sizeof(sPSIHeader));
+	// Write PSI header
+	FileGetName(FileName, TexName, sizeof(TexName), false);
+	PSIHeader.Update(TexName, PNGHeader.Width, PNGHeader.Height, (BytesPerPixel == 1) ? PSI_INDEXED : PSI_RGBA);
+	FileWriteBlock(&ptrOutputF, &PSIHeader, sizeof(sPSIHeader));
 
-		// Write PSI data
-		FileWriteBlock(&ptrOutputF, PNGPalette->Data, PNGPalette->DataSize);
-		FileWriteBlock(&ptrOutputF, PNGBitmap->Data, PNGBitmap->DataSize);
+	// Write PSI data (bitmap is decoded row by row straight to file)
+	if (BytesPerPixel == 1)
+		FileWriteBlock(&ptrOutputF, CLUT, sizeof(CLUT));
+	Writer.ptrFile = ptrOutputF;
+	Success = PNGDecodeRows(&PNGFile, PNGHeader.Width, PNGHeader.Height, BytesPerPixel, PNGHeader.BitDepth, PNGHeader.Interlacing, PSIWriteRow, &Writer);
 
-		// Free memory
-		free(PNGBitmap->Data);
-		free(PNGPalette->Data);
+	// Free memory
+	LibFree(Writer.Row);
+	PNGFreeFile(&PNGFile);
 
-		// Close files
-		fclose(ptrOutputF);
+	// Close files
+	fclose(ptrOutputF);
 
-		puts("Done\n\n");
-	}
-	else
+	// Don't leave incomplete output
+	if (Success == false)
 	{
-		puts("Unsupported PNG ...");
-		return false;
+		remove(OutFile);
+		return PS2HL_ERR_FORMAT;
 	}
 
-	// Close files
-	fclose(ptrInputF);
+	LibMsg(MSG_INFO, "Done\n\n\n");
 
-	return true;
+	return PS2HL_OK;
+}
+
+// Reads PSI bitmap rows for PNG encoder
+struct sPSIRowReader
+{
+	FILE * ptrFile;
+	uchar * Row;
+	ulong Offset;				// Bitmap offset in file
+	ulong RowLength;
+	bool Scale;					// Multiply bytes by 2 (RGBA)
+};
+
+static const uchar * PSIReadRow(void * Ctx, uint Row)
+{
+	sPSIRowReader * Reader = (sPSIRowReader *)Ctx;
+
+	FileReadBlock(&Reader->ptrFile, Reader->Row, Reader->Offset + Row * Reader->RowLength, Reader->RowLength);
+	if (Reader->Scale == true)
+		for (ulong i = 0; i < Reader->RowLength; i++)		// Multiply bitmap bytes by 2
+			Reader->Row[i] *= 2;
+
+	return Reader->Row;
 }
 
-bool ConvertPSItoPNG(const char * FileName)
+int ConvertPSItoPNG(const char * FileName)
 {
 	FILE *ptrInputF;						// Input file
 	FILE *ptrOutputF;						// Output file
 
 	sPNGHeader PNGHeader;
 	sPSIHeader PSIHeader;
+	sPSIRowReader Reader;
 
 	sPNGData PNGPalette;
-	sPNGData PNGBitmap;
 	uchar BytesPerPixel;
 
 	char OutFile[PATH_LEN];
 
-	uchar * RawBitmap;
-	ulong RawBitmapSize;
+	uchar * RGBAPalette = NULL;
+	ulong RGBAPaletteSize = 0;
 
-	uchar * RGBAPalette;
-	ulong RGBAPaletteSize;
+	bool Result;
 
 	// Open PSI
-	SafeFileOpen(&ptrInputF, FileName, "rb");
+	if (FileOpen(&ptrInputF, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Read PSI Header
 	PSIHeader.UpdateFromFile(&ptrInputF, 0);
@@ -153,115 +222,96 @@ bool ConvertPSItoPNG(const char * FileName)
 	// Check PSI Header
 	if (PSIHeader.CheckType() == PSI_RGBA)
 	{
-		printf("32-bit PSI image \nParameters - Width: %i, Height: %i \n", PSIHeader.Width1, PSIHeader.Height1);
+		LibMsg(MSG_INFO, "32-bit PSI image \nParameters - Width: %i, Height: %i \n", PSIHeader.Width1, PSIHeader.Height1);
 		BytesPerPixel = 4;
-
-		// Prepare PNG data
-		RawBitmapSize = PSIHeader.Height1 * PSIHeader.Width1 * BytesPerPixel;
-		RawBitmap = (uchar *)malloc(RawBitmapSize);
-		if (RawBitmap == NULL)
-		{
-			puts("Unable to allocate memory! \n");
-			exit(EXIT_FAILURE);
-		}
-		FileReadBlock(&ptrInputF, RawBitmap, sizeof(sPSIHeader), RawBitmapSize);
-		for (ulong i = 0; i < RawBitmapSize; i++)		// Multiply bitmap bytes by 2
-			RawBitmap[i] *= 2;
-		PNGBitmap.Data = RawBitmap;
-		PNGBitmap.DataSize = RawBitmapSize;
-
-		// Create output file
-		FileGetFullName(FileName, OutFile, sizeof(OutFile));
-		strcat(OutFile, ".png");
-		SafeFileOpen(&ptrOutputF, OutFile, "wb");
-
-		// Write PNG header
-		PNGHeader.Update(PSIHeader.Width1, PSIHeader.Height1, PNG_RGBA);
-		PNGHeader.SwapEndian();
-		FileWriteBlock(&ptrOutputF, &PNGHeader, sizeof(sPNGHeader));
-
-		// Write PNG Data
-		PNGWriteChunk(&ptrOutputF, "iTXt", "Comment\0\0\0\0\0Converted with PS2 Half-life PSI tool", strlen("CommentConverted with PS2 Half-life PSI tool") + 5);
-		PNGWriteBitmap(&ptrOutputF, PSIHeader.Width1, PSIHeader.Height1, BytesPerPixel, &PNGBitmap);
-		PNGWriteChunk(&ptrOutputF, "IEND", NULL, NULL);
-
-		// Free memory
-		free(PNGBitmap.Data);
-
-		// Close file
-		fclose(ptrOutputF);
-
-		puts("Done\n\n");
 	}
 	else if (PSIHeader.CheckType() == PSI_INDEXED)
 	{
-		printf("8-bit PSI image \nParameters - Width: %i, Height: %i \n", PSIHeader.Width1, PSIHeader.Height1);
+		LibMsg(MSG_INFO, "8-bit PSI image \nParameters - Width: %i, Height: %i \n", PSIHeader.Width1, PSIHeader.Height1);
 		BytesPerPixel = 1;
 
 		// Prepare PNG palette
 		RGBAPaletteSize = 0x400;
-		RGBAPalette = (uchar *)malloc(RGBAPaletteSize);
+		RGBAPalette = (uchar *)LibAlloc(RGBAPaletteSize);
 		if (RGBAPalette == NULL)
 		{
-			puts("Unable to allocate memory! \n");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+			fclose(ptrInputF);
+			return PS2HL_ERR_MEMORY;
 		}
 		FileReadBlock(&ptrInputF, RGBAPalette, sizeof(sPSIHeader), RGBAPaletteSize);
 		PatchRGBAPalette(RGBAPalette, RGBAPaletteSize, true);
 		PNGPalette.Data = RGBAPalette;
 		PNGPalette.DataSize = RGBAPaletteSize;
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Unknown image type.\n");
+		fclose(ptrInputF);
+		return PS2HL_ERR_FORMAT;
+	}
 
-		// Prepare PNG bitmap
-		RawBitmapSize = PSIHeader.Height1 * PSIHeader.Width1 * BytesPerPixel;
-		RawBitmap = (uchar *)malloc(RawBitmapSize);
-		if (RawBitmap == NULL)
-		{
-			puts("Unable to allocate memory! \n");
-			exit(EXIT_FAILURE);
-		}
-		FileReadBlock(&ptrInputF, RawBitmap, sizeof(sPSIHeader) + RGBAPaletteSize, RawBitmapSize);
-		PNGBitmap.Data = RawBitmap;
-		PNGBitmap.DataSize = RawBitmapSize;
-
-		// Create output file
-		FileGetFullName(FileName, OutFile, sizeof(OutFile));
-		strcat(OutFile, ".png");
-		SafeFileOpen(&ptrOutputF, OutFile, "wb");
-
-		// Write PNG header
-		PNGHeader.Update(PSIHeader.Width1, PSIHeader.Height1, PNG_INDEXED);
-		PNGHeader.SwapEndian();
-		FileWriteBlock(&ptrOutputF, &PNGHeader, sizeof(sPNGHeader));
-
-		// Write PNG data
-		PNGWriteChunk(&ptrOutputF, "iTXt", "Comment\0\0\0\0\0Converted with PS2 Half-life PSI tool", strlen("CommentConverted with PS2 Half-life PSI tool") + 5);
+	// Prepare row buffer (bitmap is read row by row while encoding)
+	Reader.ptrFile = ptrInputF;
+	Reader.Offset = sizeof(sPSIHeader) + RGBAPaletteSize;
+	Reader.RowLength = PSIHeader.Width1 * BytesPerPixel;
+	Reader.Scale = (BytesPerPixel == 4);
+	Reader.Row = (uchar *)LibAlloc(Reader.RowLength + 1);
+	if (Reader.Row == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory! \n\n");
+		LibFree(RGBAPalette);
+		fclose(ptrInputF);
+		return PS2HL_ERR_MEMORY;
+	}
+
+	// Create output file
+	FileGetFullName(FileName, OutFile, sizeof(OutFile));
+	strcat(OutFile, ".png");
+	if (FileOpen(&ptrOutputF, OutFile, "wb") == false)
+	{
+		LibFree(Reader.Row);
+		LibFree(RGBAPalette);
+		fclose(ptrInputF);
+		return PS2HL_ERR_OPEN;
+	}
+
+	// Write PNG header
+	PNGHeader.Update(PSIHeader.Width1, PSIHeader.Height1, (BytesPerPixel == 4) ? PNG_RGBA : PNG_INDEXED);
+	PNGHeader.SwapEndian();
+	FileWriteBlock(&ptrOutputF, &PNGHeader, sizeof(sPNGHeader));
+
+	// Write PNG data
+	PNGWriteChunk(&ptrOutputF, "iTXt", "Comment\0\0\0\0\0Converted with PS2 Half-life PSI tool", strlen("CommentConverted with PS2 Half-life PSI tool") + 5);
+	if (RGBAPalette != NULL)
 		PNGWritePalette(&ptrOutputF, &PNGPalette);
-		PNGWriteBitmap(&ptrOutputF, PSIHeader.Width1, PSIHeader.Height1, BytesPerPixel, &PNGBitmap);
-		PNGWriteChunk(&ptrOutputF, "IEND", NULL, NULL);
+	Result = PNGEncodeRows(&ptrOutputF, PSIHeader.Width1, PSIHeader.Height1, BytesPerPixel, PNG_FILTER_ADAPTIVE, PSIReadRow, &Reader);
+	PNGWriteChunk(&ptrOutputF, "IEND", NULL, 0);
 
-		// Free memory
-		free(PNGBitmap.Data);
-		free(RGBAPalette);
+	// Free memory
+	LibFree(Reader.Row);
+	LibFree(RGBAPalette);
 
-		// Close file
-		fclose(ptrOutputF);
+	// Close files
+	fclose(ptrOutputF);
+	fclose(ptrInputF);
 
-		puts("Done\n\n");
-	}
-	else
+	if (Result == false)
 	{
-		puts("Unknown image type.");
-		return false;
+		LibMsg(MSG_ERROR, "Zlib: can't compress image ... \n\n");
+		remove(OutFile);
+		return PS2HL_ERR_ZLIB;
 	}
 
-	// Close file
-	fclose(ptrInputF);
+	LibMsg(MSG_INFO, "Done\n\n\n");
 
-	return true;
+	return PS2HL_OK;
 }
 
 void PatchRGBAPalette(uchar * RGBAPalette, ulong RGBAPaletteSize, bool MulDiv)			// Patch color table.
 {
+	PERF_SCOPE(PERF_PH_PALETTE);
+
 	uchar Remainder;
 	uchar Temp;
 
@@ -317,48 +367,241 @@ void PatchRGBAPalette(uchar * RGBAPalette, ulong RGBAPaletteSize, bool MulDiv)
 	}
 }
 
-int main(int argc, char * argv[])
+
+////////// Decoding //////////
+int DecodePSIPalette(const uchar * Data, ulong DataSize, uchar * Palette)
 {
-	char Extension[5];
+	sPSIHeader PSIHeader;
 
-	// Output info
-	puts(PROG_TITLE);
+	if (DataSize < sizeof(sPSIHeader))
+		return PS2HL_ERR_FORMAT;
+	memcpy(&PSIHeader, Data, sizeof(sPSIHeader));
+	if (PSIHeader.CheckType() == PSI_RGBA)
+		return PS2HL_ERR_SKIP;
+	if (PSIHeader.CheckType() != PSI_INDEXED || DataSize < sizeof(sPSIHeader) + TEX_PALETTE_SIZE)
+		return PS2HL_ERR_FORMAT;
+
+	memcpy(Palette, &Data[sizeof(sPSIHeader)], TEX_PALETTE_SIZE);
+	PatchRGBAPalette(Palette, TEX_PALETTE_SIZE, true);
+
+	return PS2HL_OK;
+}
 
-	// Check arguments
-	if (argc == 1)
+int DecodePSI(const uchar * Data, ulong DataSize, const uchar * Palette, uchar ** ptrRGBA, uint * ptrWidth, uint * ptrHeight)
+{
+	sPSIHeader PSIHeader;
+	uchar OwnPalette[TEX_PALETTE_SIZE];
+	const uchar * Indices;
+	uchar * RGBA;
+	ulong PixelCount;
+	int Result;
+
+	if (DataSize < sizeof(sPSIHeader))
+		return PS2HL_ERR_FORMAT;
+	memcpy(&PSIHeader, Data, sizeof(sPSIHeader));
+	PixelCount = PSIHeader.Width1 * PSIHeader.Height1;
+
+	if (PSIHeader.CheckType() == PSI_RGBA)
 	{
-		// No arguments - show help screen
-		puts(PROG_INFO);
-		UTIL_WAIT_KEY("Press any key to exit ...");
+		if (DataSize < sizeof(sPSIHeader) + PixelCount * 4)
+			return PS2HL_ERR_FORMAT;
+
+		RGBA = (uchar *)LibAlloc(PixelCount * 4);
+		if (RGBA == NULL)
+			return PS2HL_ERR_MEMORY;
+		for (ulong i = 0; i < PixelCount * 4; i++)		// Same as PSI -> PNG
+			RGBA[i] = Data[sizeof(sPSIHeader) + i] * 2;
 	}
-	else if (argc == 2)
+	else if (PSIHeader.CheckType() == PSI_INDEXED)
 	{
-		FileGetExtension(argv[1], Extension, sizeof(Extension));
-
-		printf("Processing file: %s \n", argv[1]);
-		if (!strcmp(Extension, ".png"))				// Convert PNG to PSI
+		if (DataSize < sizeof(sPSIHeader) + TEX_PALETTE_SIZE + PixelCount)
+			return PS2HL_ERR_FORMAT;
+		if (Palette == NULL)
 		{
-			if (ConvertPNGtoPSI(argv[1]) == true)
-				return 0;
-			else
-				puts("Can't convert image ... \n");
-		}
-		else if (!strcmp(Extension, ".psi"))		// Convert PSI to PNG
-		{
-			if (ConvertPSItoPNG(argv[1]) == true)
-				return 0;
-			else
-				puts("Can't convert image ... \n");
-		}
-		else
-		{
-			puts("Wrong file extension ... \n");
+			Result = DecodePSIPalette(Data, DataSize, OwnPalette);
+			if (Result != PS2HL_OK)
+				return Result;
+			Palette = OwnPalette;
 		}
+
+		RGBA = (uchar *)LibAlloc(PixelCount * 4);
+		if (RGBA == NULL)
+			return PS2HL_ERR_MEMORY;
+		Indices = &Data[sizeof(sPSIHeader) + TEX_PALETTE_SIZE];
+		for (ulong i = 0; i < PixelCount; i++)
+			memcpy(&RGBA[i * 4], &Palette[Indices[i] * 4], 4);
+	}
+	else
+	{
+		return PS2HL_ERR_FORMAT;
+	}
+
+	*ptrRGBA = RGBA;
+	*ptrWidth = PSIHeader.Width1;
+	*ptrHeight = PSIHeader.Height1;
+	return PS2HL_OK;
+}
+
+
+////////// Batch jobs //////////
+int RunJob(const char * Command, const char * FileName)
+{
+	char Extension[5];
+
+	if (JobIsAuto(Command) == false)
+	{
+		LibMsg(MSG_ERROR, "Can't recognise command: %s \n", Command);
+		return PS2HL_ERR_PARAM;
+	}
+
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	LibMsg(MSG_INFO, "Processing file: %s \n", FileName);
+	if (!strcmp(Extension, ".png"))				// Convert PNG to PSI
+		return ConvertPNGtoPSI(FileName);
+	if (!strcmp(Extension, ".psi"))				// Convert PSI to PNG
+		return ConvertPSItoPNG(FileName);
+
+	LibMsg(MSG_ERROR, "Wrong file extension ... \n");
+	return PS2HL_ERR_PARAM;
+}
+
+const char * JobVersion()
+{
+	return PROG_TITLE;
+}
+
+bool SniffFile(const char * FileName)
+{
+	char Extension[5];
+	FILE * ptrFile;
+	sPSIHeader PSIHeader;
+
+	// *.png is ambiguous (PSI or decal), so only *.psi is recognised
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (strcmp(Extension, ".psi"))
+		return false;
+
+	ptrFile = FileProbe(FileName, "rb");
+	if (ptrFile == NULL)
+		return false;
+	memset(&PSIHeader, 0x00, sizeof(PSIHeader));
+	PSIHeader.UpdateFromFile(&ptrFile, 0);
+	fclose(ptrFile);
+
+	return PSIHeader.CheckType() != PSI_UNKNOWN;
+}
+
+static bool LintPowerOfTwo(ulong Size)
+{
+	return Size >= 8 && (Size & (Size - 1)) == 0;
+}
+
+int LintFile(const char * FileName, sLintFile * Lint)
+{
+	FILE * ptrFile;
+	sPSIHeader PSIHeader;
+	ulong Size;
+	ulong DataSize;
+
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	Size = FileSize(&ptrFile);
+	memset(&PSIHeader, 0x00, sizeof(PSIHeader));
+	PSIHeader.UpdateFromFile(&ptrFile, 0);
+	fclose(ptrFile);
+
+	if (Size < sizeof(sPSIHeader) || PSIHeader.CheckType() == PSI_UNKNOWN)
+	{
+		LintReport(Lint, LINT_ERROR, "unknown image type %lu (should be 2 - indexed or 5 - RGBA)", (unsigned long)PSIHeader.Type);
+		return PS2HL_OK;
+	}
+	if (PSIHeader.Width1 == 0 || PSIHeader.Height1 == 0)
+	{
+		LintReport(Lint, LINT_ERROR, "image is empty (%dx%d)", PSIHeader.Width1, PSIHeader.Height1);
+		return PS2HL_OK;
 	}
+	if (LintPowerOfTwo(PSIHeader.Width1) == false || LintPowerOfTwo(PSIHeader.Height1) == false)
+		LintReport(Lint, LINT_WARN, "image is %dx%d, PS2 textures should be power of two (8 or more)", PSIHeader.Width1, PSIHeader.Height1);
+
+	DataSize = (ulong)PSIHeader.Width1 * PSIHeader.Height1;
+	if (PSIHeader.CheckType() == PSI_RGBA)
+		DataSize *= 4;
 	else
+		DataSize += TEX_PALETTE_SIZE;
+	if (sizeof(sPSIHeader) + DataSize > Size)
+		LintReport(Lint, LINT_ERROR, "image data is truncated (%lu of %lu bytes)", (unsigned long)(Size - sizeof(sPSIHeader)), (unsigned long)DataSize);
+
+	return PS2HL_OK;
+}
+
+int DescribeFile(const char * FileName, sCatalogInfo * Info)
+{
+	FILE * ptrFile;
+	sPSIHeader PSIHeader;
+
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	memset(&PSIHeader, 0x00, sizeof(PSIHeader));
+	PSIHeader.UpdateFromFile(&ptrFile, 0);
+	fclose(ptrFile);
+
+	if (PSIHeader.CheckType() == PSI_UNKNOWN)
+		return PS2HL_ERR_FORMAT;
+
+	Info->PS2 = 1;
+	Info->Width = PSIHeader.Width1;
+	Info->Height = PSIHeader.Height1;
+	Info->Palette = (PSIHeader.CheckType() == PSI_INDEXED) ? CAT_PAL_INDEXED : CAT_PAL_RGBA;
+	return PS2HL_OK;
+}
+
+int GenerateFile(const char * FileName, sCorpusSpec * Spec)
+{
+	FILE * ptrFile;
+	sPNGHeader PNGHeader;
+	sPNGData PNGPalette;
+	sPNGData PNGBitmap;
+	char Extension[5];
+	uchar Palette[0x400];
+	uchar BytesPerPixel;
+	bool Result;
+
+	// Images are made as PNG, PSI of both types come from it
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (strcmp(Extension, ".png"))
+		return PS2HL_ERR_PARAM;
+
+	BytesPerPixel = (Spec->Palette == CAT_PAL_RGBA) ? 4 : 1;
+	PNGBitmap.DataSize = (ulong)Spec->Width * Spec->Height * BytesPerPixel;
+	PNGBitmap.Data = (uchar *)LibAlloc(PNGBitmap.DataSize);
+	if (PNGBitmap.Data == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
+	}
+	CorpusFill(Spec, PNGBitmap.Data, PNGBitmap.DataSize, 256);
+
+	if (FileOpen(&ptrFile, FileName, "wb") == false)
 	{
-		puts("Too many arguments ... \n");
+		LibFree(PNGBitmap.Data);
+		return PS2HL_ERR_OPEN;
 	}
-	
-	return 1;
+	PNGHeader.Update(Spec->Width, Spec->Height, (BytesPerPixel == 4) ? PNG_RGBA : PNG_INDEXED);
+	PNGHeader.SwapEndian();
+	FileWriteBlock(&ptrFile, &PNGHeader, sizeof(sPNGHeader));
+	if (BytesPerPixel == 1)
+	{
+		CorpusFill(Spec, Palette, sizeof(Palette), 256);
+		PNGPalette.Data = Palette;
+		PNGPalette.DataSize = sizeof(Palette);
+		PNGWritePalette(&ptrFile, &PNGPalette);
+	}
+	Result = PNGWriteBitmap(&ptrFile, Spec->Width, Spec->Height, BytesPerPixel, &PNGBitmap);
+	PNGWriteChunk(&ptrFile, "IEND", NULL, 0);
+	fclose(ptrFile);
+
+	LibFree(PNGBitmap.Data);
+	return (Result == true) ? PS2HL_OK : PS2HL_ERR_ZLIB;
 }
+
+} // namespace psi
@@ -0,0 +1,118 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This file contains command line front-end of sprite tool
+//
+
+////////// Includes //////////
+#include "util.h"
+#include "main.h"
+#include "perf.h"
+#include "log.h"
+#include "cache.h"
+
+using namespace spr;
+
+int main(int argc, char * argv[])
+{
+	argc = PerfParseArgs(argc, argv);	// --stats, --trace <file>
+	argc = LogParseArgs(argc, argv, false);	// -q, -v, --log-format=jsonl
+	argc = CacheParseArgs(argc, argv);	// --cache <dir>, --cache-size <MiB>, --cache-link
+	LibSetInteractive(true);
+	LibMsg(MSG_INFO, "%s\n", PROG_TITLE);
+
+	// Cached conversion goes through job dispatch ("sprtool (command) file")
+	if (CacheEnabled() == true && (argc == 2 || argc == 3))
+		return (JobRun("spr", (argc == 3) ? argv[1] : JOB_CMD_AUTO, argv[argc - 1]) == PS2HL_OK) ? 0 : 1;
+
+	if (argc == 1)
+	{
+		puts(PROG_INFO);
+		UTIL_WAIT_KEY("Press any key to exit ...");
+	}
+	else if (argc == 2)
+	{
+		char Extension[5];
+		FileGetExtension(argv[1], Extension, sizeof(Extension));
+
+		if (!strcmp(Extension, ".spr") == true)
+		{
+			LibMsg(MSG_INFO, "Proccessing file: %s \n", argv[1]);
+			if (ConvertSPRToSPZ(argv[1], false) != PS2HL_OK)
+				return 1;
+			LibMsg(MSG_INFO, "Done! \n\n");
+			return 0;
+		}
+		else if (!strcmp(Extension, ".spz") == true)
+		{
+			LibMsg(MSG_INFO, "Proccessing file: %s \n", argv[1]);
+			if (ConvertSPZToSPR(argv[1], true, false) != PS2HL_OK)
+				return 1;
+			LibMsg(MSG_INFO, "Done! \n\n");
+			return 0;
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Wrong file extension.\n");
+		}
+
+	}
+	else if (argc == 3)
+	{
+		char Extension[5];
+		FileGetExtension(argv[2], Extension, sizeof(Extension));
+
+		if (!strcmp(argv[1], "noresize") == true)
+		{
+			if (!strcmp(Extension, ".spz") == true)
+			{
+				LibMsg(MSG_INFO, "Proccessing file: %s \n", argv[2]);
+				LibMsg(MSG_INFO, "No resize mode ...\n");
+				if (ConvertSPZToSPR(argv[2], false, false) != PS2HL_OK)
+					return 1;
+				LibMsg(MSG_INFO, "Done! \n\n");
+				return 0;
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Nope! \n\n");
+			}
+		}
+		else if (!strcmp(argv[1], "lin"))
+		{
+			if (!strcmp(Extension, ".spz") == true)
+			{
+				LibMsg(MSG_INFO, "Proccessing file: %s \n", argv[2]);
+				LibMsg(MSG_INFO, "Linear resize mode ...\n");
+				if (ConvertSPZToSPR(argv[2], true, true) != PS2HL_OK)
+					return 1;
+				LibMsg(MSG_INFO, "Done! \n\n");
+				return 0;
+			}
+			if (!strcmp(Extension, ".spr") == true)
+			{
+				LibMsg(MSG_INFO, "Proccessing file: %s \n", argv[2]);
+				LibMsg(MSG_INFO, "Linear resize mode ...\n");
+				if (ConvertSPRToSPZ(argv[2], true) != PS2HL_OK)
+					return 1;
+				LibMsg(MSG_INFO, "Done! \n\n");
+				return 0;
+			}
+			else
+			{
+				LibMsg(MSG_ERROR, "Nope! \n\n");
+			}
+		}
+		else
+		{
+			LibMsg(MSG_ERROR, "Bad arguments! \n\n");
+		}
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Wrong command line parameters.\n");
+	}
+	
+	return 1;
+}
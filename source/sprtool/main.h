@@ -5,14 +5,13 @@
 // This file contains all definitions and declarations
 //
 
-#ifndef MAIN_H
-#define MAIN_H
+#ifndef SPRTOOL_MAIN_H
+#define SPRTOOL_MAIN_H
 
 ////////// Includes //////////
 #include <stdio.h>	// puts(), printf(), sscanf(), snprintf()
 #include <string.h>	// strcpy(), strcat(), strlen(), strtok(), strncpy()
 #include <malloc.h> // malloc(), free()
-#include <stdlib.h> // exit()
 #include <math.h>	// round(), sqrt()
 #include <ctype.h>	// tolower()
 
@@ -44,6 +43,15 @@ enum eSPZFormat { SPZ_ADDITIVE = 0, SPZ_INDEXALPHA = 1, SPZ_ALPHATEST = 2 };
 
 ////////// Functions //////////
 #include "fops.h"
+#include "ps2hl.h"
+#include "perf.h"
+
+namespace spr
+{
+
+int ConvertSPZToSPR(const char * cFile, bool Resize, bool Linear);
+int ConvertSPRToSPZ(const char * cFile, bool Linear);
+uint PSIProperSize(uint Size);
 
 ////////// Structures //////////
 
@@ -299,19 +307,27 @@ struct sTexture
 		this->BitmapSize = 0;
 	}
 
-	void UpdateFromFile(FILE ** ptrFile, ulong FileBitmapOffset, ulong FileBitmapSize, ulong FilePaletteOffset, ulong FilePaletteSize, const char * NewName, ulong NewWidth, ulong NewHeight)	// Update from file
+	void Deinit()				// Free palette and bitmap
+	{
+		LibFree(this->Palette);
+		LibFree(this->Bitmap);
+		this->Palette = NULL;
+		this->Bitmap = NULL;
+	}
+
+	bool UpdateFromFile(FILE ** ptrFile, ulong FileBitmapOffset, ulong FileBitmapSize, ulong FilePaletteOffset, ulong FilePaletteSize, const char * NewName, ulong NewWidth, ulong NewHeight)	// Update from file
 	{
 		// Destroy old palette and bitmap
-		free(Palette);
-		free(Bitmap);
+		Deinit();
 
 		// Allocate memory for new ones
-		Palette = (uchar *)malloc(FilePaletteSize);
-		Bitmap = (uchar *)malloc(FileBitmapSize);
+		Palette = (uchar *)LibAlloc(FilePaletteSize);
+		Bitmap = (uchar *)LibAlloc(FileBitmapSize);
 		if (Palette == NULL || Bitmap == NULL)
 		{
-			UTIL_WAIT_KEY("Unable to allocate memory ...");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			Deinit();
+			return false;
 		}
 
 		// Copy data from file to memory
@@ -324,6 +340,8 @@ struct sTexture
 		this->Height = NewHeight;
 		this->PaletteSize = FilePaletteSize;
 		this->BitmapSize = this->Width * this->Height;
+
+		return true;
 	}
 
 	/*void PatchBitmap()	// Patch bitmap byte data. Needed for BMP\SPR to SPZ conversion and vice versa.
@@ -377,19 +395,21 @@ struct sTexture
 		}
 	}
 
-	void PaletteRemoveAlpha()	// Convert palette to SPR format
+	bool PaletteRemoveAlpha()	// Convert palette to SPR format
 	{
+		PERF_SCOPE(PERF_PH_PALETTE);
+
 		uchar * NewPalette;
 		ulong NewPaletteSize = EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPR_PALETTE_ELEMENT_SIZE;
 
 		if (this->PaletteSize == EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPZ_PALETTE_ELEMENT_SIZE)
 		{
 			// Allocate memory for new palette
-			NewPalette = (uchar *)malloc(NewPaletteSize);
+			NewPalette = (uchar *)LibAlloc(NewPaletteSize);
 			if (NewPalette == NULL)
 			{
-				UTIL_WAIT_KEY("Unable to allocate memory ...");
-				exit(EXIT_FAILURE);
+				LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+				return false;
 			}
 
 			// Copy palette without alpha to new place
@@ -405,7 +425,7 @@ struct sTexture
 			}
 
 			// Destroy old palette
-			free(this->Palette);
+			LibFree(this->Palette);
 
 			// Save pointer to new palette
 			this->Palette = NewPalette;
@@ -413,6 +433,8 @@ struct sTexture
 			// Update size
 			this->PaletteSize = NewPaletteSize;
 		}
+
+		return true;
 	}
 
 	eSPZFormat PaletteCheckSPZFormat()						// Analyze SPZ palette and return it's tranparency format
@@ -440,19 +462,21 @@ struct sTexture
 		}
 	}
 
-	void PaletteAddSPZAlpha(eSPZFormat SPZFormat)		// Add alpha channel to palette (used for conversion to to *.SPZ format).
+	bool PaletteAddSPZAlpha(eSPZFormat SPZFormat)		// Add alpha channel to palette (used for conversion to to *.SPZ format).
 	{													// !!! Apply this to *.SPR palette BEFORE reformatting !!!
+		PERF_SCOPE(PERF_PH_PALETTE);
+
 		uchar * NewPalette;
 		ulong NewPaletteSize = EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPZ_PALETTE_ELEMENT_SIZE;
 
 		if (this->PaletteSize == EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPR_PALETTE_ELEMENT_SIZE)
 		{
 			// Allocate memory for new palette
-			NewPalette = (uchar *)malloc(NewPaletteSize);
+			NewPalette = (uchar *)LibAlloc(NewPaletteSize);
 			if (NewPalette == NULL)
 			{
-				UTIL_WAIT_KEY("Unable to allocate memory ...");
-				exit(EXIT_FAILURE);
+				LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+				return false;
 			}
 
 			// Add transparency info to the palette and copy it to new place
@@ -498,7 +522,7 @@ struct sTexture
 			}
 
 			// Destroy old palette
-			free(this->Palette);
+			LibFree(this->Palette);
 
 			// Save pointer to new palette
 			this->Palette = NewPalette;
@@ -506,6 +530,8 @@ struct sTexture
 			// Update size
 			this->PaletteSize = NewPaletteSize;
 		}
+
+		return true;
 	}
 
 	void PalettePatchIAColors(uint PaletteElementSize, bool ToSPR)			// Patch indexalpha sprite's color table to SPR's (true) or SPZ's (false) format.
@@ -533,16 +559,16 @@ struct sTexture
 		}
 	}
 
-	void NearestResize(ulong NewWidth, ulong NewHeight)			// Resize bitmap.
+	bool NearestResize(ulong NewWidth, ulong NewHeight)			// Resize bitmap.
 	{
 		uchar * NewBitmap;
 
 		// Allocate memory for new bitmap
-		NewBitmap = (uchar *)malloc(NewWidth * NewHeight);
+		NewBitmap = (uchar *)LibAlloc(NewWidth * NewHeight);
 		if (NewBitmap == NULL)
 		{
-			UTIL_WAIT_KEY("Unable to allocate memory ...");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			return false;
 		}
 
 		// Resize bitmap
@@ -557,7 +583,7 @@ struct sTexture
 
 
 		// Destroy old bitmap
-		free(this->Bitmap);
+		LibFree(this->Bitmap);
 
 		// Set pointer to resized bitmap
 		this->Bitmap = NewBitmap;
@@ -566,6 +592,8 @@ struct sTexture
 		this->Width = NewWidth;
 		this->Height = NewHeight;
 		this->BitmapSize = this->Width * this->Height;
+
+		return true;
 	}
 
 	/*
@@ -583,49 +611,6 @@ struct sTexture
 		this->PaletteSize = NewPaletteSize;
 	}
 
-	void PaletteAddSpacers(uchar Spacer)		// Add spacers to to BMP's palette
-	{
-		uchar * NewPalette;
-		ulong NewPaletteSize = EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPZ_BMP_PALETTE_ELEMENT_SIZE;
-
-		if (this->PaletteSize == EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPR_PALETTE_ELEMENT_SIZE)
-		{
-			// Allocate memory for new palette
-			NewPalette = (uchar *)malloc(NewPaletteSize);
-			if (NewPalette == NULL)
-			{
-				puts("Unable to allocate memory!");
-				_getch();
-				exit(EXIT_FAILURE);
-			}
-
-			// Copy palette with spacers to new place
-			ulong ByteCounterOld = 0;
-			ulong ByteCounterNew = 0;
-			for (ByteCounterNew = 0; ByteCounterNew < NewPaletteSize; ByteCounterNew++)	// Copy 3 bytes from old palette + Spacer to new one
-			{
-				if ((ByteCounterNew + 1) % 4 != 0)
-				{
-					NewPalette[ByteCounterNew] = this->Palette[ByteCounterOld];
-					ByteCounterOld++;
-				}
-				else
-				{
-					NewPalette[ByteCounterNew] = Spacer;
-				}
-			}
-
-			// Destroy old palette
-			free(this->Palette);
-
-			// Save pointer to new palette
-			this->Palette = NewPalette;
-
-			// Update size
-			this->PaletteSize = NewPaletteSize;
-		}
-	}
-
 	void PaletteSwapRedAndGreen(uint ElementSize)		// Needed for SPR\SPZ to BMP conversion and vice versa.
 	{
 		uchar Temp;
@@ -643,80 +628,6 @@ struct sTexture
 		strcpy(this->Name, NewName);
 	}
 
-	void TileResize(ulong NewWidth, ulong NewHeight)			// Resize bitmap by tiling old in new one.
-	{
-		uchar * NewBitmap;
-
-		// Allocate memory for new bitmap
-		NewBitmap = (uchar *)malloc(NewWidth * NewHeight);
-		if (NewBitmap == NULL)
-		{
-			puts("Unable to allocate memory!");
-			_getch();
-			exit(EXIT_FAILURE);
-		}
-
-		// Tile new bitmap with old one
-		ulong NewX, NewY, OldX, OldY;
-		OldX = 0;
-		OldY = 0;
-		for (NewY = 0; NewY < NewHeight; NewY++)
-		{
-			for (NewX = 0; NewX < NewWidth; NewX++)
-			{
-				if (NewX == 0)
-					OldX = 0;
-
-				NewBitmap[(NewWidth * NewY) + NewX] = this->Bitmap[(this->Width * OldY) + OldX];
-
-				OldX++;
-				if (OldX >= this->Width)
-					OldX = 0;
-			}
-			OldY++;
-			if (OldY >= this->Height)
-				OldY = 0;
-
-		}
-
-
-
-		// Destroy old bitmap
-		free(this->Bitmap);
-
-		// Save pointer to new bitmap
-		this->Bitmap = NewBitmap;
-
-		// Update bitmap size
-		this->Width = NewWidth;
-		this->Height = NewHeight;
-		this->BitmapSize = this->Width * this->Height;
-	}
-
-	void FlipBitmap()		// Flip bitmap vertically. Needed for SPZ\SPR to BMP conversion and vice versa.
-	{
-		uchar * NewBitmap;
-
-		// Allocate memory for new bitmap
-		NewBitmap = (uchar *)malloc(this->Width * this->Height);
-		if (NewBitmap == NULL)
-		{
-			puts("Unable to allocate memory!");
-			_getch();
-			exit(EXIT_FAILURE);
-		}
-
-		// Copy flipped bitmap to new place
-		for (uint y = 0; y < this->Height; y++)
-			for (uint x = 0; x < this->Width; x++)
-				NewBitmap[(this->Width * y) + x] = this->Bitmap[(this->Width * ((this->Height - 1) - y)) + x];
-
-		// Destroy old bitmap
-		free(this->Bitmap);
-
-		// Save pointer to new bitmap
-		this->Bitmap = NewBitmap;
-	}
 	*/
 	
 	////////////////////////////////////////
@@ -733,7 +644,7 @@ struct sTexture
 		char ElementSize = PaletteSize / EIGHT_BIT_PALETTE_ELEMENTS_COUNT;
 		if (ElementSize != 3 && ElementSize != 4)
 		{
-			puts("Unknown color format");
+			LibMsg(MSG_ERROR, "Unknown color format\n");
 			return 0;
 		}
 
@@ -773,19 +684,23 @@ struct sTexture
 		return Index;
 	}
 
-	void LinearResize(short NewWidth, short NewHeight)			// Smooth linear resize
+	bool LinearResize(short NewWidth, short NewHeight)			// Smooth linear resize
 	{
 		ulong * NewRGBABitmap;
+		uchar * NewBitmap;
 
 		if (NewWidth == Width && NewHeight == Height)
-			return;
+			return true;
 
-		// Allocate memory for new RGBA bitmap
-		NewRGBABitmap = (ulong *)malloc(NewWidth * NewHeight * 4);
-		if (NewRGBABitmap == NULL)
+		// Allocate memory for new RGBA and indexed bitmaps
+		NewRGBABitmap = (ulong *)LibAlloc(NewWidth * NewHeight * 4);
+		NewBitmap = (uchar *)LibAlloc(NewWidth * NewHeight);
+		if (NewRGBABitmap == NULL || NewBitmap == NULL)
 		{
-			UTIL_WAIT_KEY("Unable to allocate memory ...");
-			exit(EXIT_FAILURE);
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			LibFree(NewRGBABitmap);
+			LibFree(NewBitmap);
+			return false;
 		}
 
 		// Convet to RGBA and resize
@@ -802,11 +717,9 @@ struct sTexture
 				memcpy(&NewRGBABitmap[(NewWidth * NewY) + NewX], &Pixel, sizeof(Pixel));
 			}
 
-		// Reallocate indexed bitmap and update size
-		free(Bitmap);
-		Bitmap = (uchar *)malloc(NewWidth * NewHeight);
-		if (!Bitmap)
-			exit(EXIT_FAILURE);
+		// Replace indexed bitmap and update size
+		LibFree(Bitmap);
+		Bitmap = NewBitmap;
 		this->Width = NewWidth;
 		this->Height = NewHeight;
 		this->BitmapSize = this->Width * this->Height;
@@ -832,10 +745,10 @@ struct sTexture
 		}
 
 		// Free memory
-		free(NewRGBABitmap);
+		LibFree(NewRGBABitmap);
 
 		// Result is achieved - exit function
-		return;
+		return true;
 	}
 
 	void GetResizedPixel(float PixX, float PixY, short NewWidth, short NewHeight, sRGBAPixel * Result)
@@ -973,4 +886,6 @@ struct sTexture
 	}
 };
 
-#endif // MAIN_H
+} // namespace spr
+
+#endif // SPRTOOL_MAIN_H
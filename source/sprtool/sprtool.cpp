@@ -8,13 +8,28 @@
 ////////// Includes //////////
 #include "util.h"
 #include "main.h"
+#include "jobs.h"
+#include "lint.h"
+#include "catalog.h"
+#include "corpus.h"
+#include "bench.h"
+
+namespace spr
+{
 
 ////////// Functions //////////
-void ConvertSPZToSPR(const char * cFile, bool Resize, bool Linear);
-void ConvertSPRToSPZ(const char * cFile, bool Linear);
-uint PSIProperSize(uint Size);
+static void FreeTextures(sTexture * Textures, int Count)	// Free frames loaded by converters below
+{
+	if (Textures == NULL)
+		return;
+
+	for (int i = 0; i < Count; i++)
+		Textures[i].Deinit();
 
-void ConvertSPZToSPR(const char * cFile, bool Resize, bool Linear)
+	LibFree(Textures);
+}
+
+int ConvertSPZToSPR(const char * cFile, bool Resize, bool Linear)
 {
 	FILE * ptrSPZ;
 	FILE * ptrSPR;
@@ -30,37 +45,52 @@ void ConvertSPZToSPR(const char * cFile, bool Resize, bool Linear)
 	eSPRFormat SPRFormat;
 
 	sTexture * Textures;
+	int Result = PS2HL_OK;
 
 	// Open *.spz file
-	SafeFileOpen(&ptrSPZ, cFile, "rb");
+	if (FileOpen(&ptrSPZ, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
 	// Load header from file
 	SPZHeader.UpdateFromFile(&ptrSPZ);
 	// Check file
 	if (SPZHeader.CheckSignature() == false)
 	{
-		puts("Incorrect file.");
-		return;
+		LibMsg(MSG_ERROR, "Incorrect file.\n");
+		fclose(ptrSPZ);
+		return PS2HL_ERR_FORMAT;
 	}
 	if (SPZHeader.FrameCount == 0)
 	{
-		puts("Empty sprite file.");
-		return;
+		LibMsg(MSG_ERROR, "Empty sprite file.\n");
+		fclose(ptrSPZ);
+		return PS2HL_ERR_FORMAT;
+	}
+
+	// Allocate memory for frame table, frame headers and frames
+	SPZFrameTable = (sSPZFrameTableEntry *)LibAlloc(sizeof(sSPZFrameTableEntry) * SPZHeader.FrameCount);
+	SPZFrameHeaders = (sSPZFrameHeader *)LibAlloc(sizeof(sSPZFrameHeader) * SPZHeader.FrameCount);
+	Textures = (sTexture *)LibCalloc(SPZHeader.FrameCount, sizeof(sTexture));
+	if (SPZFrameTable == NULL || SPZFrameHeaders == NULL || Textures == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		LibFree(SPZFrameTable);
+		LibFree(SPZFrameHeaders);
+		LibFree(Textures);
+		fclose(ptrSPZ);
+		return PS2HL_ERR_MEMORY;
 	}
 
 	// Load frame table from *.spz file
-	SPZFrameTable = (sSPZFrameTableEntry *)malloc(sizeof(sSPZFrameTableEntry) * SPZHeader.FrameCount);
 	for (int i = 0; i < SPZHeader.FrameCount; i++)
 		SPZFrameTable[i].UpdateFromFile(&ptrSPZ, sizeof(sSPZHeader) + i * sizeof(sSPZFrameTableEntry));
 
 
 	// Load frame headers from *.spz file
-	SPZFrameHeaders = (sSPZFrameHeader *)malloc(sizeof(sSPZFrameHeader) * SPZHeader.FrameCount);
 	for (int i = 0; i < SPZHeader.FrameCount; i++)
 		SPZFrameHeaders[i].UpdateFromFile(&ptrSPZ, SPZFrameTable[i].FrameOffset);
 
 
 	// Load frames from *.spz file
-	Textures = (sTexture *)malloc(sizeof(sTexture) * SPZHeader.FrameCount);
 	uint BitmapOffset;
 	uint BitmapSize;
 	uint PaletteOffset;
@@ -76,16 +106,26 @@ void ConvertSPZToSPR(const char * cFile, bool Resize, bool Linear)
 		PaletteSize = EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPZ_PALETTE_ELEMENT_SIZE;
 
 		Textures[i].Initialize();
-		Textures[i].UpdateFromFile(&ptrSPZ, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, SPZFrameHeaders[i].Name, SPZFrameHeaders[i].Width, SPZFrameHeaders[i].Height);
+		if (Textures[i].UpdateFromFile(&ptrSPZ, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, SPZFrameHeaders[i].Name, SPZFrameHeaders[i].Width, SPZFrameHeaders[i].Height) == false)
+			Result = PS2HL_ERR_MEMORY;
 
 		// Resize frame to it's original size (if specified)
-		if (Resize == true)
+		if (Result == PS2HL_OK && Resize == true)
 		{
 			Textures[i].PaletteReformat(SPZ_PALETTE_ELEMENT_SIZE);	// Linear resize requires proper palette
 			if (Linear)
-				Textures[i].LinearResize(SPZFrameHeaders[i].UpWidth, SPZFrameHeaders[i].UpHeight);
+				Result = Textures[i].LinearResize(SPZFrameHeaders[i].UpWidth, SPZFrameHeaders[i].UpHeight) ? PS2HL_OK : PS2HL_ERR_MEMORY;
 			else
-				Textures[i].NearestResize(SPZFrameHeaders[i].UpWidth, SPZFrameHeaders[i].UpHeight);
+				Result = Textures[i].NearestResize(SPZFrameHeaders[i].UpWidth, SPZFrameHeaders[i].UpHeight) ? PS2HL_OK : PS2HL_ERR_MEMORY;
+		}
+
+		if (Result != PS2HL_OK)
+		{
+			FreeTextures(Textures, i + 1);
+			LibFree(SPZFrameHeaders);
+			LibFree(SPZFrameTable);
+			fclose(ptrSPZ);
+			return Result;
 		}
 
 		// Find maximum frame sizes
@@ -98,67 +138,88 @@ void ConvertSPZToSPR(const char * cFile, bool Resize, bool Linear)
 	// Create new *.spr file
 	FileGetFullName(cFile, cOutputFileName, sizeof(cOutputFileName));
 	strcat(cOutputFileName, ".spr");
-	SafeFileOpen(&ptrSPR, cOutputFileName, "wb");
+	if (FileOpen(&ptrSPR, cOutputFileName, "wb") == false)
+	{
+		FreeTextures(Textures, SPZHeader.FrameCount);
+		LibFree(SPZFrameHeaders);
+		LibFree(SPZFrameTable);
+		fclose(ptrSPZ);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Detect *.spz format
 	if (Textures[0].PaletteCheckSPZFormat() == SPZ_ADDITIVE)
 	{
-		puts("Format: additive");
+		LibMsg(MSG_INFO, "Format: additive\n");
 		SPRFormat = SPR_ADDITIVE;
 	}
 	else if (Textures[0].PaletteCheckSPZFormat() == SPZ_ALPHATEST)
 	{
-		puts("Format: alphatest");
+		LibMsg(MSG_INFO, "Format: alphatest\n");
 		SPRFormat = SPR_ALPHATEST;
 	}
 	else if (Textures[0].PaletteCheckSPZFormat() == SPZ_INDEXALPHA)
 	{
-		puts("Format: indexalpha");
+		LibMsg(MSG_INFO, "Format: indexalpha\n");
 		SPRFormat = SPR_INDEXALPHA;
 	}
 	else
 	{
-		printf("Detected unknown format: [0x%X]. Treating as additive \n", Textures[0].PaletteCheckSPZFormat());
+		LibMsg(MSG_WARN, "Detected unknown format: [0x%X]. Treating as additive \n", Textures[0].PaletteCheckSPZFormat());
 		SPRFormat = SPR_ADDITIVE;
 	}
 
 	// Detect *.spz type
 	if (SPZHeader.Type == SPZ_VP_PARALLEL)
 	{
-		puts("Type: vp_parallel");
+		LibMsg(MSG_INFO, "Type: vp_parallel\n");
 		SPRType = SPR_VP_PARALLEL;
 	}
 	else if (SPZHeader.Type == SPZ_VP_PARALLEL_UPRIGHT)
 	{
-		puts("Type: vp_parallel_upright");
+		LibMsg(MSG_INFO, "Type: vp_parallel_upright\n");
 		SPRType = SPR_VP_PARALLEL_UPRIGHT;
 	}
 	else if (SPZHeader.Type == SPZ_ORIENTED)
 	{
-		puts("Type: oriented");
+		LibMsg(MSG_INFO, "Type: oriented\n");
 		SPRType = SPR_ORIENTED;
 	}
 	else if (SPZHeader.Type == SPZ_VP_PARALLEL_ORIENTED)
 	{
-		puts("Type: vp_parallel_oriented");
+		LibMsg(MSG_INFO, "Type: vp_parallel_oriented\n");
 		SPRType = SPR_VP_PARALLEL_ORIENTED;
 	}
 	else
 	{
-		printf("Detected unknown type: [0x%X]. Treating as vp_parellel \n", SPZHeader.Type);
+		LibMsg(MSG_WARN, "Detected unknown type: [0x%X]. Treating as vp_parellel \n", SPZHeader.Type);
 		SPRType = SPR_VP_PARALLEL;
 	}
 
 	// Convert frames to appropriate format
 	for (int i = 0; i < SPZHeader.FrameCount; i++)
 	{
-		Textures[i].PaletteRemoveAlpha();
+		if (Textures[i].PaletteRemoveAlpha() == false)
+		{
+			Result = PS2HL_ERR_MEMORY;
+			break;
+		}
 		//Textures[i].PaletteReformat(SPR_PALETTE_ELEMENT_SIZE);	// Moved this line as it should be before the linear resize
 		Textures[i].PaletteMulDiv(true);
 		if (SPRFormat == SPR_INDEXALPHA)
 			Textures[i].PalettePatchIAColors(SPR_PALETTE_ELEMENT_SIZE, true);
 	}
 
+	if (Result != PS2HL_OK)
+	{
+		FreeTextures(Textures, SPZHeader.FrameCount);
+		LibFree(SPZFrameHeaders);
+		LibFree(SPZFrameTable);
+		fclose(ptrSPZ);
+		fclose(ptrSPR);
+		return Result;
+	}
+
 	// Write header
 	SPRHeader.Update(MaxWidth, MaxHeight, SPZHeader.FrameCount, SPRType, SPRFormat);
 	FileWriteBlock(&ptrSPR, &SPRHeader, sizeof(sSPRHeader));
@@ -173,19 +234,22 @@ void ConvertSPZToSPR(const char * cFile, bool Resize, bool Linear)
 		FileWriteBlock(&ptrSPR, &SPRFrameHeader, sizeof(sSPRFrameHeader));
 
 		FileWriteBlock(&ptrSPR, Textures[i].Bitmap, Textures[i].BitmapSize);	// Write bitmap
+		LibProgress(i + 1, SPZHeader.FrameCount);
 	}
 
 	// Free memory
-	free(SPZFrameHeaders);
-	free(SPZFrameTable);
-	free(Textures);
+	FreeTextures(Textures, SPZHeader.FrameCount);
+	LibFree(SPZFrameHeaders);
+	LibFree(SPZFrameTable);
 
 	// Close files
 	fclose(ptrSPZ);
 	fclose(ptrSPR);
+
+	return PS2HL_OK;
 }
 
-void ConvertSPRToSPZ(const char * cFile, bool Linear)
+int ConvertSPRToSPZ(const char * cFile, bool Linear)
 {
 	FILE * ptrSPZ;
 	FILE * ptrSPR;
@@ -201,25 +265,40 @@ void ConvertSPRToSPZ(const char * cFile, bool Linear)
 	eSPZFormat SPZFormat;
 
 	sTexture * Textures;
+	int Result = PS2HL_OK;
 
 	// Open *.spr file
-	SafeFileOpen(&ptrSPR, cFile, "rb");
+	if (FileOpen(&ptrSPR, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
 	// Load header from file
 	SPRHeader.UpdateFromFile(&ptrSPR);
 	// Check file
 	if (SPRHeader.CheckSignature() == false)
 	{
-		puts("Incorrect file.");
-		return;
+		LibMsg(MSG_ERROR, "Incorrect file.\n");
+		fclose(ptrSPR);
+		return PS2HL_ERR_FORMAT;
 	}
 	if (SPRHeader.FrameCount == 0)
 	{
-		puts("Empty sprite file.");
-		return;
+		LibMsg(MSG_ERROR, "Empty sprite file.\n");
+		fclose(ptrSPR);
+		return PS2HL_ERR_FORMAT;
+	}
+
+	// Allocate memory for frame headers and frames
+	SPRFrameHeaders = (sSPRFrameHeader *)LibAlloc(sizeof(sSPRFrameHeader) * SPRHeader.FrameCount);
+	Textures = (sTexture *)LibCalloc(SPRHeader.FrameCount, sizeof(sTexture));
+	if (SPRFrameHeaders == NULL || Textures == NULL)
+	{
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		LibFree(SPRFrameHeaders);
+		LibFree(Textures);
+		fclose(ptrSPR);
+		return PS2HL_ERR_MEMORY;
 	}
 
 	// Load frame headers from *.spr file
-	SPRFrameHeaders = (sSPRFrameHeader *)malloc(sizeof(sSPRFrameHeader) * SPRHeader.FrameCount);
 	ulong HeaderOffset = sizeof(sSPRHeader) + EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPR_PALETTE_ELEMENT_SIZE;
 	for (int i = 0; i < SPRHeader.FrameCount; i++)
 	{
@@ -230,7 +309,6 @@ void ConvertSPRToSPZ(const char * cFile, bool Linear)
 	}
 
 	// Load frames from *.spr file
-	Textures = (sTexture *)malloc(sizeof(sTexture) * SPRHeader.FrameCount);
 	uint BitmapOffset;
 	uint BitmapSize;
 	uint PaletteOffset;
@@ -251,7 +329,13 @@ void ConvertSPRToSPZ(const char * cFile, bool Linear)
 		Textures[i].Initialize();
 		snprintf(ShortName, sizeof(ShortName), "%s", FileName); // snprintf is used to cut big names
 		snprintf(TextureName, sizeof(TextureName), "%s%03i", ShortName, i + 1);
-		Textures[i].UpdateFromFile(&ptrSPR, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, TextureName, SPRFrameHeaders[i].Width, SPRFrameHeaders[i].Height);
+		if (Textures[i].UpdateFromFile(&ptrSPR, BitmapOffset, BitmapSize, PaletteOffset, PaletteSize, TextureName, SPRFrameHeaders[i].Width, SPRFrameHeaders[i].Height) == false)
+		{
+			FreeTextures(Textures, i + 1);
+			LibFree(SPRFrameHeaders);
+			fclose(ptrSPR);
+			return PS2HL_ERR_MEMORY;
+		}
 
 		// Calculate offset for next frame
 		FrameOffset += sizeof(sSPRFrameHeader) + SPRFrameHeaders[i].Width * SPRFrameHeaders[i].Height;
@@ -260,54 +344,60 @@ void ConvertSPRToSPZ(const char * cFile, bool Linear)
 	// Create new *.spz file
 	FileGetFullName(cFile, cOutputFileName, sizeof(cOutputFileName));
 	strcat(cOutputFileName, ".spz");
-	SafeFileOpen(&ptrSPZ, cOutputFileName, "wb");
+	if (FileOpen(&ptrSPZ, cOutputFileName, "wb") == false)
+	{
+		FreeTextures(Textures, SPRHeader.FrameCount);
+		LibFree(SPRFrameHeaders);
+		fclose(ptrSPR);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Detect format
 	if (SPRHeader.Format == SPR_ADDITIVE)
 	{
-		puts("Format: additive");
+		LibMsg(MSG_INFO, "Format: additive\n");
 		SPZFormat = SPZ_ADDITIVE;
 	}
 	else if (SPRHeader.Format == SPR_ALPHATEST)
 	{
-		puts("Format: alphatest");
+		LibMsg(MSG_INFO, "Format: alphatest\n");
 		SPZFormat = SPZ_ALPHATEST;
 	}
 	else if (SPRHeader.Format == SPR_INDEXALPHA)
 	{
-		puts("Format: indexalpa");
+		LibMsg(MSG_INFO, "Format: indexalpa\n");
 		SPZFormat = SPZ_INDEXALPHA;
 	}
 	else
 	{
-		puts("Unappropriate format for conversion to *.spz. Treating as additive.");
+		LibMsg(MSG_WARN, "Unappropriate format for conversion to *.spz. Treating as additive.\n");
 		SPZFormat = SPZ_ADDITIVE;
 	}
 
 	// Detect type
 	if (SPRHeader.Type == SPR_VP_PARALLEL_UPRIGHT || SPRHeader.Type == SPR_FACING_UPRIGHT)
 	{
-		puts("Type: vp_parallel_upright");
+		LibMsg(MSG_INFO, "Type: vp_parallel_upright\n");
 		SPZType = SPZ_VP_PARALLEL_UPRIGHT;
 	}
 	else if (SPRHeader.Type == SPR_VP_PARALLEL)
 	{
-		puts("Type: vp_parallel");
+		LibMsg(MSG_INFO, "Type: vp_parallel\n");
 		SPZType = SPZ_VP_PARALLEL;
 	}
 	else if (SPRHeader.Type == SPR_ORIENTED)
 	{
-		puts("Type: oriented");
+		LibMsg(MSG_INFO, "Type: oriented\n");
 		SPZType = SPZ_ORIENTED;
 	}
 	else if (SPRHeader.Type == SPR_VP_PARALLEL_ORIENTED)
 	{
-		puts("Type: vp_parallel_oriented");
+		LibMsg(MSG_INFO, "Type: vp_parallel_oriented\n");
 		SPZType = SPZ_VP_PARALLEL_ORIENTED;
 	}
 	else
 	{
-		puts("Unappropriate type for conversion to *.spz. Treating as vp_parallel.");
+		LibMsg(MSG_WARN, "Unappropriate type for conversion to *.spz. Treating as vp_parallel.\n");
 		SPZType = SPZ_VP_PARALLEL;
 	}
 
@@ -315,12 +405,25 @@ void ConvertSPRToSPZ(const char * cFile, bool Linear)
 	for (int i = 0; i < SPRHeader.FrameCount; i++)
 	{
 		Textures[i].PaletteMulDiv(false);
-		Textures[i].PaletteAddSPZAlpha(SPZFormat);
+		if (Textures[i].PaletteAddSPZAlpha(SPZFormat) == false)
+		{
+			Result = PS2HL_ERR_MEMORY;
+			break;
+		}
 		if (SPZFormat == SPZ_INDEXALPHA)
 			Textures[i].PalettePatchIAColors(SPZ_PALETTE_ELEMENT_SIZE, false);
 		Textures[i].PaletteReformat(SPZ_PALETTE_ELEMENT_SIZE);
 	}
 
+	if (Result != PS2HL_OK)
+	{
+		FreeTextures(Textures, SPRHeader.FrameCount);
+		LibFree(SPRFrameHeaders);
+		fclose(ptrSPR);
+		fclose(ptrSPZ);
+		return Result;
+	}
+
 	// Write header
 	SPZHeader.Update(SPRHeader.FrameCount, SPZType);
 	FileWriteBlock(&ptrSPZ, &SPZHeader, sizeof(sSPZHeader));
@@ -353,9 +456,11 @@ void ConvertSPRToSPZ(const char * cFile, bool Linear)
 		OriginalWidth = Textures[i].Width;
 		OriginalHeight = Textures[i].Height;
 		if (Linear)
-			Textures[i].LinearResize(PSIProperSize(OriginalWidth), PSIProperSize(OriginalHeight));
+			Result = Textures[i].LinearResize(PSIProperSize(OriginalWidth), PSIProperSize(OriginalHeight)) ? PS2HL_OK : PS2HL_ERR_MEMORY;
 		else
-			Textures[i].NearestResize(PSIProperSize(OriginalWidth), PSIProperSize(OriginalHeight));
+			Result = Textures[i].NearestResize(PSIProperSize(OriginalWidth), PSIProperSize(OriginalHeight)) ? PS2HL_OK : PS2HL_ERR_MEMORY;
+		if (Result != PS2HL_OK)
+			break;
 
 		// Write header
 		SPZFrameHeader.Update(Textures[i].Name, Textures[i].Width, Textures[i].Height);
@@ -367,15 +472,18 @@ void ConvertSPRToSPZ(const char * cFile, bool Linear)
 
 		// Write bitmap
 		FileWriteBlock(&ptrSPZ, Textures[i].Bitmap, Textures[i].BitmapSize);
+		LibProgress(i + 1, SPRHeader.FrameCount);
 	}
 
 	// Free memory
-	free(SPRFrameHeaders);
-	free(Textures);
+	FreeTextures(Textures, SPRHeader.FrameCount);
+	LibFree(SPRFrameHeaders);
 
 	// Close files
 	fclose(ptrSPR);
 	fclose(ptrSPZ);
+
+	return Result;
 }
 
 uint PSIProperSize(uint Size)	// Function returns closest proper dimension. PS2 HL proper PSI dimensions: 16 (min), 32, 64, 128, 256, 512, ...
@@ -401,92 +509,384 @@ uint PSIProperSize(uint Size)	// Function returns closest proper dimension. PS2
 	}
 }
 
-int main(int argc, char * argv[])
+
+////////// Batch jobs //////////
+int RunJob(const char * Command, const char * FileName)
 {
-	puts(PROG_TITLE);
+	char Extension[5];
+	bool IsSPR, IsSPZ;
+
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	IsSPR = !strcmp(Extension, ".spr");
+	IsSPZ = !strcmp(Extension, ".spz");
 
-	if (argc == 1)
+	// Default action - convert with nearest resize
+	if (JobIsAuto(Command) == true)
 	{
-		puts(PROG_INFO);
-		UTIL_WAIT_KEY("Press any key to exit ...");
+		LibMsg(MSG_INFO, "Proccessing file: %s \n", FileName);
+		if (IsSPR)
+			return ConvertSPRToSPZ(FileName, false);
+		if (IsSPZ)
+			return ConvertSPZToSPR(FileName, true, false);
+
+		LibMsg(MSG_ERROR, "Wrong file extension.\n");
+		return PS2HL_ERR_PARAM;
 	}
-	else if (argc == 2)
-	{
-		char Extension[5];
-		FileGetExtension(argv[1], Extension, sizeof(Extension));
 
-		if (!strcmp(Extension, ".spr") == true)
-		{
-			printf("Proccessing file: %s \n", argv[1]);
-			ConvertSPRToSPZ(argv[1], false);
-			puts("Done! \n");
-			return 0;
-		}
-		else if (!strcmp(Extension, ".spz") == true)
-		{
-			printf("Proccessing file: %s \n", argv[1]);
-			ConvertSPZToSPR(argv[1], true, false);
-			puts("Done! \n");
-			return 0;
-		}
-		else
+	if (!strcmp(Command, "noresize"))
+	{
+		if (IsSPZ == false)
 		{
-			puts("Wrong file extension.");
+			LibMsg(MSG_ERROR, "No resize mode needs *.spz file ...\n");
+			return PS2HL_ERR_PARAM;
 		}
+		LibMsg(MSG_INFO, "Proccessing file: %s \nNo resize mode ...\n", FileName);
+		return ConvertSPZToSPR(FileName, false, false);
+	}
+
+	if (!strcmp(Command, "lin"))
+	{
+		LibMsg(MSG_INFO, "Proccessing file: %s \nLinear resize mode ...\n", FileName);
+		if (IsSPZ)
+			return ConvertSPZToSPR(FileName, true, true);
+		if (IsSPR)
+			return ConvertSPRToSPZ(FileName, true);
 
+		LibMsg(MSG_ERROR, "Wrong file extension.\n");
+		return PS2HL_ERR_PARAM;
 	}
-	else if (argc == 3)
+
+	LibMsg(MSG_ERROR, "Can't recognise command: %s \n", Command);
+	return PS2HL_ERR_PARAM;
+}
+
+const char * JobVersion()
+{
+	return PROG_TITLE;
+}
+
+bool SniffFile(const char * FileName)
+{
+	char Extension[5];
+	FILE * ptrFile;
+	bool Result = false;
+
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (strcmp(Extension, ".spr") && strcmp(Extension, ".spz"))
+		return false;
+
+	ptrFile = FileProbe(FileName, "rb");
+	if (ptrFile == NULL)
+		return false;
+
+	if (!strcmp(Extension, ".spr"))
 	{
-		char Extension[5];
-		FileGetExtension(argv[2], Extension, sizeof(Extension));
+		sSPRHeader SPRHeader;
+		memset(&SPRHeader, 0x00, sizeof(SPRHeader));
+		SPRHeader.UpdateFromFile(&ptrFile);
+		Result = SPRHeader.CheckSignature();
+	}
+	else
+	{
+		sSPZHeader SPZHeader;
+		memset(&SPZHeader, 0x00, sizeof(SPZHeader));
+		SPZHeader.UpdateFromFile(&ptrFile);
+		Result = SPZHeader.CheckSignature();
+	}
 
-		if (!strcmp(argv[1], "noresize") == true)
-		{
-			if (!strcmp(Extension, ".spz") == true)
-			{
-				printf("Proccessing file: %s \n", argv[2]);
-				puts("No resize mode ...");
-				ConvertSPZToSPR(argv[2], false, false);
-				puts("Done! \n");
-				return 0;
-			}
-			else
-			{
-				puts("Nope! \n");
-			}
-		}
-		else if (!strcmp(argv[1], "lin"))
+	fclose(ptrFile);
+	return Result;
+}
+
+static void LintSPZ(FILE ** ptrFile, ulong Size, sLintFile * Lint)
+{
+	sSPZHeader SPZHeader;
+	sSPZFrameTableEntry Frame;
+	sSPZFrameHeader FrameHeader;
+
+	memset(&SPZHeader, 0x00, sizeof(SPZHeader));
+	SPZHeader.UpdateFromFile(ptrFile);
+	if (!strncmp(SPZHeader.Signature, "SPAZ", 4) && SPZHeader.RAMFlag != 0)
+		return;		// GRESTORE.PAK: offsets point to RAM
+	if (Size < sizeof(sSPZHeader) || SPZHeader.CheckSignature() == false)
+	{
+		LintReport(Lint, LINT_ERROR, "not a PS2 sprite (no \"SPAZ\" signature)");
+		return;
+	}
+	if (SPZHeader.FrameCount == 0)
+	{
+		LintReport(Lint, LINT_ERROR, "sprite has no frames");
+		return;
+	}
+	if (sizeof(sSPZHeader) + SPZHeader.FrameCount * sizeof(sSPZFrameTableEntry) > Size)
+	{
+		LintReport(Lint, LINT_ERROR, "frame table is out of file (%d frames)", SPZHeader.FrameCount);
+		return;
+	}
+
+	for (int i = 0; i < SPZHeader.FrameCount; i++)
+	{
+		Frame.UpdateFromFile(ptrFile, sizeof(sSPZHeader) + i * sizeof(sSPZFrameTableEntry));
+		if (Frame.FrameOffset > Size || Size - Frame.FrameOffset < sizeof(sSPZFrameHeader))
 		{
-			if (!strcmp(Extension, ".spz") == true)
-			{
-				printf("Proccessing file: %s \n", argv[2]);
-				puts("Linear resize mode ...");
-				ConvertSPZToSPR(argv[2], true, true);
-				puts("Done! \n");
-				return 0;
-			}
-			if (!strcmp(Extension, ".spr") == true)
-			{
-				printf("Proccessing file: %s \n", argv[2]);
-				puts("Linear resize mode ...");
-				ConvertSPRToSPZ(argv[2], true);
-				puts("Done! \n");
-				return 0;
-			}
-			else
-			{
-				puts("Nope! \n");
-			}
+			LintReport(Lint, LINT_ERROR, "frame %d is out of file", i);
+			continue;
 		}
-		else
+		FrameHeader.UpdateFromFile(ptrFile, Frame.FrameOffset);
+		if (FrameHeader.Type != 2)
+			LintReport(Lint, LINT_ERROR, "frame %d isn't 8-bit indexed (type %lu)", i, (unsigned long)FrameHeader.Type);
+		if (FrameHeader.Width != PSIProperSize(FrameHeader.Width) || FrameHeader.Height != PSIProperSize(FrameHeader.Height))
+			LintReport(Lint, LINT_ERROR, "frame %d is %dx%d, PS2 needs power of two (%d or more)", i, FrameHeader.Width, FrameHeader.Height, PSI_MIN_DIMENSION);
+		if (sizeof(sSPZFrameHeader) + EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPZ_PALETTE_ELEMENT_SIZE + (ulong)FrameHeader.Width * FrameHeader.Height > Size - Frame.FrameOffset)
+			LintReport(Lint, LINT_ERROR, "frame %d (%dx%d) is out of file", i, FrameHeader.Width, FrameHeader.Height);
+	}
+}
+
+static void LintSPR(FILE ** ptrFile, ulong Size, sLintFile * Lint)
+{
+	sSPRHeader SPRHeader;
+
+	memset(&SPRHeader, 0x00, sizeof(SPRHeader));
+	SPRHeader.UpdateFromFile(ptrFile);
+	if (Size < sizeof(sSPRHeader) || SPRHeader.CheckSignature() == false)
+	{
+		LintReport(Lint, LINT_ERROR, "not a Half-Life sprite (signature \"%.4s\", version %lu, should be \"IDSP\", 2)",
+			SPRHeader.Signature, (unsigned long)SPRHeader.Version);
+		return;
+	}
+	if (SPRHeader.FrameCount == 0)
+		LintReport(Lint, LINT_ERROR, "sprite has no frames");
+	if (SPRHeader.FrameCount > 255)
+		LintReport(Lint, LINT_ERROR, "%lu frames, PS2 sprite can hold 255 at most", (unsigned long)SPRHeader.FrameCount);
+	if (SPRHeader.PaletteSize != EIGHT_BIT_PALETTE_ELEMENTS_COUNT)
+		LintReport(Lint, LINT_WARN, "palette has %d colors, %d expected", SPRHeader.PaletteSize, EIGHT_BIT_PALETTE_ELEMENTS_COUNT);
+}
+
+int LintFile(const char * FileName, sLintFile * Lint)
+{
+	char Extension[5];
+	FILE * ptrFile;
+	ulong Size;
+
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	Size = FileSize(&ptrFile);
+
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (!strcmp(Extension, ".spz"))
+		LintSPZ(&ptrFile, Size, Lint);
+	else
+		LintSPR(&ptrFile, Size, Lint);
+	fclose(ptrFile);
+
+	return PS2HL_OK;
+}
+
+int DescribeFile(const char * FileName, sCatalogInfo * Info)
+{
+	char Extension[5];
+	FILE * ptrFile;
+	ulong Size;
+	sSPRHeader SPRHeader;
+	sSPZHeader SPZHeader;
+	sSPZFrameTableEntry Frame;
+	sSPZFrameHeader FrameHeader;
+
+	if (FileOpen(&ptrFile, FileName, "rb") == false)
+		return PS2HL_ERR_OPEN;
+	Size = FileSize(&ptrFile);
+	Info->Palette = CAT_PAL_INDEXED;
+
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (strcmp(Extension, ".spz"))
+	{
+		memset(&SPRHeader, 0x00, sizeof(SPRHeader));
+		SPRHeader.UpdateFromFile(&ptrFile);
+		fclose(ptrFile);
+		if (SPRHeader.CheckSignature() == false)
+			return PS2HL_ERR_FORMAT;
+
+		Info->Frames = SPRHeader.FrameCount;
+		Info->Width = SPRHeader.MaxWidth;
+		Info->Height = SPRHeader.MaxHeight;
+		return PS2HL_OK;
+	}
+
+	memset(&SPZHeader, 0x00, sizeof(SPZHeader));
+	SPZHeader.UpdateFromFile(&ptrFile);
+	if (strncmp(SPZHeader.Signature, "SPAZ", 4))
+	{
+		fclose(ptrFile);
+		return PS2HL_ERR_FORMAT;
+	}
+	Info->PS2 = 1;
+	Info->Frames = SPZHeader.FrameCount;
+
+	// Biggest frame (GRESTORE.PAK: offsets point to RAM, so there is nothing to read)
+	for (int i = 0; i < SPZHeader.FrameCount && SPZHeader.RAMFlag == 0; i++)
+	{
+		if (sizeof(sSPZHeader) + (i + 1) * sizeof(sSPZFrameTableEntry) > Size)
+			break;
+		Frame.UpdateFromFile(&ptrFile, sizeof(sSPZHeader) + i * sizeof(sSPZFrameTableEntry));
+		if (Frame.FrameOffset > Size || Size - Frame.FrameOffset < sizeof(sSPZFrameHeader))
+			continue;
+		FrameHeader.UpdateFromFile(&ptrFile, Frame.FrameOffset);
+		if ((ulong)FrameHeader.Width * FrameHeader.Height > (ulong)Info->Width * Info->Height)
 		{
-			puts("Bad arguments! \n");
+			Info->Width = FrameHeader.Width;
+			Info->Height = FrameHeader.Height;
 		}
 	}
-	else
+	fclose(ptrFile);
+
+	return PS2HL_OK;
+}
+
+int GenerateFile(const char * FileName, sCorpusSpec * Spec)
+{
+	FILE * ptrFile;
+	sSPRHeader SPRHeader;
+	sSPRFrameHeader SPRFrameHeader;
+	char Extension[5];
+	uchar * Bitmap;
+	ulong BitmapSize = (ulong)Spec->Width * Spec->Height;
+
+	FileGetExtension(FileName, Extension, sizeof(Extension));
+	if (strcmp(Extension, ".spr") || Spec->Count == 0)
+		return PS2HL_ERR_PARAM;
+
+	Bitmap = (uchar *)LibAlloc(BitmapSize + EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPR_PALETTE_ELEMENT_SIZE);
+	if (Bitmap == NULL)
 	{
-		puts("Wrong command line parameters.");
+		LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+		return PS2HL_ERR_MEMORY;
 	}
-	
-	return 1;
+	if (FileOpen(&ptrFile, FileName, "wb") == false)
+	{
+		LibFree(Bitmap);
+		return PS2HL_ERR_OPEN;
+	}
+
+	// Header and palette
+	memset(&SPRHeader, 0x00, sizeof(SPRHeader));
+	SPRHeader.Update(Spec->Width, Spec->Height, Spec->Count, SPR_VP_PARALLEL, (eSPRFormat)CorpusRange(Spec, SPR_ADDITIVE, SPR_ALPHATEST));
+	FileWriteBlock(&ptrFile, &SPRHeader, sizeof(SPRHeader));
+	CorpusFill(Spec, Bitmap, EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPR_PALETTE_ELEMENT_SIZE, 256);
+	FileWriteBlock(&ptrFile, Bitmap, EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPR_PALETTE_ELEMENT_SIZE);
+
+	// Frames of the same size
+	SPRFrameHeader.Update(Spec->Width, Spec->Height);
+	for (int i = 0; i < Spec->Count; i++)
+	{
+		CorpusFill(Spec, Bitmap, BitmapSize, 256);
+		FileWriteBlock(&ptrFile, &SPRFrameHeader, sizeof(SPRFrameHeader));
+		FileWriteBlock(&ptrFile, Bitmap, BitmapSize);
+	}
+	fclose(ptrFile);
+
+	LibFree(Bitmap);
+	return PS2HL_OK;
+}
+
+
+// Frame kernel input: bitmap is restored from Source before each run
+struct sBenchTexture
+{
+	sTexture Texture;
+	uchar * Source;
+	ulong SourceWidth;
+	ulong SourceHeight;
+	ulong Width;				// Target size
+	ulong Height;				//
+	sRGBAPixel * Colors;		// FindClosestColor() targets
+	ulong ColorCount;			//
+};
+
+static void BenchTexturePrepare(void * Ctx)
+{
+	sBenchTexture * Kernel = (sBenchTexture *)Ctx;
+
+	LibFree(Kernel->Texture.Bitmap);
+	Kernel->Texture.Bitmap = (uchar *)LibAlloc(Kernel->SourceWidth * Kernel->SourceHeight);
+	if (Kernel->Texture.Bitmap != NULL)
+		memcpy(Kernel->Texture.Bitmap, Kernel->Source, Kernel->SourceWidth * Kernel->SourceHeight);
+	Kernel->Texture.Width = Kernel->SourceWidth;
+	Kernel->Texture.Height = Kernel->SourceHeight;
+	Kernel->Texture.BitmapSize = Kernel->SourceWidth * Kernel->SourceHeight;
 }
+
+static void BenchLinearResize(void * Ctx)
+{
+	sBenchTexture * Kernel = (sBenchTexture *)Ctx;
+
+	if (Kernel->Texture.Bitmap != NULL)
+		Kernel->Texture.LinearResize(Kernel->Width, Kernel->Height);
+}
+
+static void BenchFindClosestColor(void * Ctx)
+{
+	sBenchTexture * Kernel = (sBenchTexture *)Ctx;
+	uchar Index = 0;
+
+	for (ulong i = 0; i < Kernel->ColorCount; i++)
+		Index ^= Kernel->Texture.FindClosestColor(&Kernel->Colors[i]);
+	BenchSink = Index;
+}
+
+static void BenchPaletteReformat(void * Ctx)
+{
+	((sBenchTexture *)Ctx)->Texture.PaletteReformat(SPZ_PALETTE_ELEMENT_SIZE);
+}
+
+void BenchKernels(sBench * Bench)
+{
+	sBenchTexture Kernel;
+	uchar Palette[EIGHT_BIT_PALETTE_ELEMENTS_COUNT * SPZ_PALETTE_ELEMENT_SIZE];
+	char Case[48];
+	ulong Pixels;
+
+	if (BenchWants(Bench, "spr.") == false)
+		return;
+
+	memset(&Kernel, 0x00, sizeof(Kernel));
+	Kernel.Texture.Initialize();
+	BenchFillImage(Palette, sizeof(Palette), 256, 1);
+	Kernel.Texture.Palette = Palette;
+	Kernel.Texture.PaletteSize = sizeof(Palette);
+	BenchRun(Bench, "spr.PaletteReformat", "256 rgba", EIGHT_BIT_PALETTE_ELEMENTS_COUNT, sizeof(Palette), NULL, BenchPaletteReformat, &Kernel);
+
+	// Frames of odd sizes are resized up to power of two (from 3/4 of it here) and reindexed with the same palette
+	for (int i = 0; i < BENCH_DIM_COUNT; i++)
+	{
+		Kernel.Width = BenchDims[i];
+		Kernel.Height = BenchDims[i];
+		Kernel.SourceWidth = BenchDims[i] * 3 / 4;
+		Kernel.SourceHeight = BenchDims[i] * 3 / 4;
+		Kernel.ColorCount = Kernel.Width * Kernel.Height;
+		Kernel.Source = (uchar *)LibAlloc(Kernel.SourceWidth * Kernel.SourceHeight);
+		Kernel.Colors = (sRGBAPixel *)LibAlloc(Kernel.ColorCount * sizeof(sRGBAPixel));
+		if (Kernel.Source == NULL || Kernel.Colors == NULL)
+		{
+			LibMsg(MSG_ERROR, "Unable to allocate memory ...\n");
+			LibFree(Kernel.Source);
+			LibFree(Kernel.Colors);
+			return;
+		}
+		BenchFillImage(Kernel.Source, Kernel.SourceWidth * Kernel.SourceHeight, 256, i + 1);
+		BenchFillImage((uchar *)Kernel.Colors, Kernel.ColorCount * sizeof(sRGBAPixel), 256, i + 1);
+
+		Pixels = Kernel.Width * Kernel.Height;
+		snprintf(Case, sizeof(Case), "%lux%lu", (unsigned long)Kernel.Width, (unsigned long)Kernel.Height);
+		BenchRun(Bench, "spr.FindClosestColor", Case, Pixels, Pixels * sizeof(sRGBAPixel), NULL, BenchFindClosestColor, &Kernel);
+		snprintf(Case, sizeof(Case), "%lux%lu->%lux%lu", (unsigned long)Kernel.SourceWidth, (unsigned long)Kernel.SourceHeight,
+			(unsigned long)Kernel.Width, (unsigned long)Kernel.Height);
+		BenchRun(Bench, "spr.LinearResize", Case, Pixels, Pixels, BenchTexturePrepare, BenchLinearResize, &Kernel);
+
+		LibFree(Kernel.Texture.Bitmap);
+		Kernel.Texture.Bitmap = NULL;
+		LibFree(Kernel.Source);
+		LibFree(Kernel.Colors);
+	}
+}
+
+} // namespace spr
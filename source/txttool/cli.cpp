@@ -0,0 +1,75 @@
+// Author:	supadupaplex
+// License:	BSD-3-Clause (check out license.txt)
+
+//
+// This module contains command line front-end of TXT tool
+//
+
+////////// Includes //////////
+#include "main.h"				// Main header
+#include "perf.h"
+#include "log.h"
+#include "util.h"
+
+using namespace txt;
+
+int main(int argc, char * argv[])
+{
+	char cExtension[5];
+
+	argc = PerfParseArgs(argc, argv);	// --stats, --trace <file>
+	argc = LogParseArgs(argc, argv, false);	// -q, -v, --log-format=jsonl
+	LibSetInteractive(true);
+
+	LibMsg(MSG_INFO, "%s\n", PROG_TITLE);
+
+	if (argc == 1)
+	{
+		puts(PROG_INFO);
+		UTIL_WAIT_KEY("Press any key to exit ...");
+	}
+	else if (argc == 2)
+	{
+		FileGetExtension(argv[1], cExtension, sizeof(cExtension));
+
+		if (!strcmp(cExtension, ".txt") == true)
+		{
+			LibMsg(MSG_INFO, "Processing file: %s \n", argv[1]);
+
+			if (CheckTXT(argv[1]) == true)					// Compressed PS2 TXT
+			{
+				if (DecompressTxt(argv[1]) == PS2HL_OK)
+				{
+					LibMsg(MSG_INFO, "Done! \n\n");
+					return 0;
+				}
+				else
+				{
+					LibMsg(MSG_ERROR, "Decompression failed! \n\n");
+				}
+			}
+			else											// Normal TXT
+			{
+				if (CompressTxt(argv[1]) == PS2HL_OK)
+				{
+					LibMsg(MSG_INFO, "Done! \n\n");
+					return 0;
+				}
+				else
+				{
+					LibMsg(MSG_ERROR, "Compression failed! \n\n");
+				}
+			}
+		}
+		else												// Unsupported file
+		{
+			LibMsg(MSG_ERROR, "Unsupported file ...\n");
+		}
+	}
+	else
+	{
+		LibMsg(MSG_ERROR, "Too many arguments ...\n");
+	}
+	
+	return 1;
+}
@@ -5,19 +5,20 @@
 // This file contains all definitions and declarations
 //
 
-#ifndef MAIN_H
-#define MAIN_H
+#ifndef TXTTOOL_MAIN_H
+#define TXTTOOL_MAIN_H
 
 ////////// Includes //////////
 #include <stdio.h>		// puts(), printf(), sscanf(), snprintf(), rename(), remove()
 #include <string.h>		// strcpy(), strcat(), strlen(), strtok(), strncpy(), memset()
 #include <malloc.h>		// malloc(), free()
-#include <stdlib.h>		// exit()
+#include <stdlib.h>		// exit() (front-end only)
 #include <math.h>		// round(), sqrt(), ceil()
 #include <ctype.h>		// tolower()
 
 ////////// Zlib stuff //////////
 #include "zlib.h"
+#include "ztool.h"
 #include <assert.h>
 
 ////////// Definitions //////////
@@ -39,6 +40,14 @@ For more info check out readme.txt\n\
 
 ////////// Functions //////////
 #include "fops.h"
+#include "ps2hl.h"
+
+namespace txt
+{
+
+bool CheckTXT(const char * cFile);				// Check if *.txt is compressed
+int CompressTxt(const char * cFile);			// Compress *.txt in place
+int DecompressTxt(const char * cFile);			// Decompress *.txt in place
 
 ////////// Structures //////////
 
@@ -74,4 +83,6 @@ struct sPS2CmpTxtHeader
 
 };
 
-#endif // MAIN_H
+} // namespace txt
+
+#endif // TXTTOOL_MAIN_H
@@ -10,123 +10,10 @@
 ////////// Includes //////////
 #include "main.h"				// Main header
 #include "util.h"
+#include "jobs.h"
 
-////////// Functions //////////
-bool CheckTXT(const char * cFile);
-bool ZDecompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize, ulong StartSize);		// Compress data with zlib
-bool ZCompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize);						// Decompress data with zlib
-bool CompressTxt(const char * cFile);
-bool DecompressTxt(const char * cFile);
-
-
-bool ZDecompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize, ulong StartSize)
-{
-	// Setting up zlib variables for decomression
-	z_stream infstream;
-	infstream.zalloc = Z_NULL;
-	infstream.zfree = Z_NULL;
-	infstream.opaque = Z_NULL;
-
-	// Setting up other variables
-	uchar * NewData;
-	ulong NewDataSize;
-	bool Finish;
-
-	// Set starting size of decompressed data (would be increased if bigger)
-	NewDataSize = StartSize;
-
-	// Decompression loop
-	do
-	{
-		// Allocate memory for decompressed data
-		NewData = (uchar *)malloc(NewDataSize);
-		if (NewData == NULL)
-		{
-			puts("Unable to allocate memory ...");
-			return false;
-		}
-
-		infstream.next_in = (Bytef *)InputData;			// Input data pointer (compressed data)
-		infstream.avail_in = (uint)InputDataSize;		// Size of input data
-		infstream.next_out = (Bytef *)NewData;			// Output data pointer (decompressed data)
-		infstream.avail_out = (uint)NewDataSize;		// Size of output data
-
-		// Decompression work
-		if (inflateInit(&infstream) != Z_OK)
-		{
-			puts("Zlib: can't decompress data ...");
-			return false;
-		}
-		inflate(&infstream, Z_FINISH);
-		inflateEnd(&infstream);
-
-		// if buffer is full then increase buffer size and retry decompression
-		if (NewDataSize == infstream.total_out)
-		{
-			free(NewData);
-			NewDataSize = NewDataSize * 2 + 1;		// +1 to avoid infinite loop, when StartSize = 0
-
-			Finish = false;
-		}
-		else
-		{
-			Finish = true;
-		}
-	} while (Finish == false);
-
-	// Check if output data has zero size
-	if (infstream.total_out == 0)
-		return false;
-
-	puts("Decompression is completed successfully.");
-
-	// Return data pointer, data size and result
-	*OutputData = NewData;
-	*OutputDataSize = infstream.total_out;
-	return true;
-}
-
-bool ZCompress(uchar * InputData, ulong InputDataSize, uchar ** OutputData, ulong * OutputDataSize)
+namespace txt
 {
-	// Allocate memory for compressed data
-	uchar * NewData;
-	ulong NewDataSize;
-
-	NewDataSize = InputDataSize;
-	NewData = (uchar *)malloc(NewDataSize);
-	if (NewData == NULL)
-	{
-		puts("Unable to allocate memory ...");
-		return false;
-	}
-
-	// Setting up zlib variables for compression
-	z_stream defstream;
-	defstream.zalloc = Z_NULL;
-	defstream.zfree = Z_NULL;
-	defstream.opaque = Z_NULL;
-
-	defstream.next_in = (Bytef *)InputData;			// Input data pointer (decompressed data)
-	defstream.avail_in = (ulong)InputDataSize;		// Size of input data
-	defstream.next_out = (Bytef *)NewData;			// Output data pointer (compressed data)
-	defstream.avail_out = (ulong)NewDataSize;		// Size of output data
-
-	// Compression work.
-	deflateInit(&defstream, Z_BEST_COMPRESSION);
-	deflate(&defstream, Z_FINISH);
-	deflateEnd(&defstream);
-
-	// Check if output data has zero size
-	if (defstream.total_out == 0)
-		return false;
-
-	puts("Compression is completed succesfully.");
-
-	// Return data pointer, data size and result
-	*OutputData = NewData;
-	*OutputDataSize = defstream.total_out;
-	return true;
-}
 
 bool CheckTXT(const char * cFile)
 {
@@ -134,7 +21,8 @@ bool CheckTXT(const char * cFile)
 	sPS2CmpTxtHeader PS2CmpTxtHeader;	// Compressed *.txt header
 
 	// Open file
-	SafeFileOpen(&ptrInputF, cFile, "rb");
+	if (FileOpen(&ptrInputF, cFile, "rb") == false)
+		return false;
 
 	// Load header
 	PS2CmpTxtHeader.UpdateFromFile(&ptrInputF);
@@ -145,7 +33,7 @@ bool CheckTXT(const char * cFile)
 	return PS2CmpTxtHeader.Check();
 }
 
-bool CompressTxt(const char * cFile)
+int CompressTxt(const char * cFile)
 {
 	FILE * ptrInFile;
 	FILE * ptrOutFile;
@@ -156,33 +44,48 @@ bool CompressTxt(const char * cFile)
 	ulong DDataSize;
 	uchar * CData;
 	ulong CDataSize;
+	int Result;
 
 	// Open input file
-	SafeFileOpen(&ptrInFile, cFile, "rb");
+	if (FileOpen(&ptrInFile, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Update and check header
 	PS2CmpTxtHeader.UpdateFromFile(&ptrInFile);
 	if (PS2CmpTxtHeader.Check() == true)
-		return false;
+	{
+		fclose(ptrInFile);
+		return PS2HL_ERR_SKIP;
+	}
 
 	// Allocate memory
 	DDataSize = FileSize(&ptrInFile);
-	DData = (uchar *)malloc(DDataSize);
+	DData = (uchar *)LibAlloc(DDataSize);
 	if (DData == NULL)
-		return false;
+	{
+		fclose(ptrInFile);
+		return PS2HL_ERR_MEMORY;
+	}
 
 	// Get compressed data
 	FileReadBlock(&ptrInFile, DData, 0, DDataSize);
 
-	// Compress data
-	if (ZCompress(DData, DDataSize, &CData, &CDataSize) == false)
-		return false;
-
 	// Close input file
 	fclose(ptrInFile);
 
+	// Compress data
+	Result = ZCompress(DData, DDataSize, &CData, &CDataSize);
+	LibFree(DData);
+	if (Result != PS2HL_OK)
+		return Result;
+	LibMsg(MSG_INFO, "Compression is completed succesfully.\n");
+
 	// Open output file
-	SafeFileOpen(&ptrOutFile, cFile, "wb");
+	if (FileOpen(&ptrOutFile, cFile, "wb") == false)
+	{
+		LibFree(CData);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Generate proper header for compressed *.txt
 	PS2CmpTxtHeader.Update();
@@ -192,16 +95,15 @@ bool CompressTxt(const char * cFile)
 	FileWriteBlock(&ptrOutFile, CData, CDataSize);
 
 	// Free memory
-	free(DData);
-	free(CData);
+	LibFree(CData);
 
 	// Close output file
 	fclose(ptrOutFile);
 
-	return true;
+	return PS2HL_OK;
 }
 
-bool DecompressTxt(const char * cFile)
+int DecompressTxt(const char * cFile)
 {
 	FILE * ptrInFile;
 	FILE * ptrOutFile;
@@ -212,100 +114,99 @@ bool DecompressTxt(const char * cFile)
 	ulong CDataSize;
 	uchar * DData;
 	ulong DDataSize;
+	int Result;
 
 	// Open input file
-	SafeFileOpen(&ptrInFile, cFile, "rb");
+	if (FileOpen(&ptrInFile, cFile, "rb") == false)
+		return PS2HL_ERR_OPEN;
 
 	// Update and check header
 	PS2CmpTxtHeader.UpdateFromFile(&ptrInFile);
 	if (PS2CmpTxtHeader.Check() == false)
-		return false;
+	{
+		fclose(ptrInFile);
+		return PS2HL_ERR_FORMAT;
+	}
 
 	// Allocate memory
 	CDataSize = FileSize(&ptrInFile) - sizeof(sPS2CmpTxtHeader);
-	CData = (uchar *) malloc(CDataSize);
+	CData = (uchar *) LibAlloc(CDataSize);
 	if (CData == NULL)
-		return false;
+	{
+		fclose(ptrInFile);
+		return PS2HL_ERR_MEMORY;
+	}
 
 	// Get compressed data
 	FileReadBlock(&ptrInFile, CData, sizeof(sPS2CmpTxtHeader), CDataSize);
 
-	// Decompress data
-	if (ZDecompress(CData, CDataSize, &DData, &DDataSize, 0x100000) == false)
-		return false;
-
 	// Close input file
 	fclose(ptrInFile);
 
+	// Decompress data
+	Result = ZDecompress(CData, CDataSize, &DData, &DDataSize, 0x100000);
+	LibFree(CData);
+	if (Result != PS2HL_OK)
+		return Result;
+	LibMsg(MSG_INFO, "Decompression is completed successfully.\n");
+
 	// Open output file
-	SafeFileOpen(&ptrOutFile, cFile, "wb");
+	if (FileOpen(&ptrOutFile, cFile, "wb") == false)
+	{
+		LibFree(DData);
+		return PS2HL_ERR_OPEN;
+	}
 
 	// Write decompressed data
 	FileWriteBlock(&ptrOutFile, DData, DDataSize);
 
 	// Free memory
-	free(CData);
-	free(DData);
+	LibFree(DData);
 
 	// Close output file
 	fclose(ptrOutFile);
 
-	return true;
+	return PS2HL_OK;
 }
 
-int main(int argc, char * argv[])
+
+////////// Batch jobs //////////
+int RunJob(const char * Command, const char * FileName)
 {
 	char cExtension[5];
 
-	puts(PROG_TITLE);
-
-	if (argc == 1)
-	{
-		puts(PROG_INFO);
-		UTIL_WAIT_KEY("Press any key to exit ...");
-	}
-	else if (argc == 2)
+	if (JobIsAuto(Command) == false)
 	{
-		FileGetExtension(argv[1], cExtension, sizeof(cExtension));
-
-		if (!strcmp(cExtension, ".txt") == true)
-		{
-			printf("Processing file: %s \n", argv[1]);
-
-			if (CheckTXT(argv[1]) == true)					// Compressed PS2 TXT
-			{
-				if (DecompressTxt(argv[1]) == true)
-				{
-					puts("Done! \n");
-					return 0;
-				}
-				else
-				{
-					puts("Decompression failed! \n");
-				}
-			}
-			else											// Normal TXT
-			{
-				if (CompressTxt(argv[1]) == true)
-				{
-					puts("Done! \n");
-					return 0;
-				}
-				else
-				{
-					puts("Compression failed! \n");
-				}
-			}
-		}
-		else												// Unsupported file
-		{
-			puts("Unsupported file ...");
-		}
+		LibMsg(MSG_ERROR, "Can't recognise command: %s \n", Command);
+		return PS2HL_ERR_PARAM;
 	}
-	else
+
+	FileGetExtension(FileName, cExtension, sizeof(cExtension));
+	if (strcmp(cExtension, ".txt"))
 	{
-		puts("Too many arguments ...");
+		LibMsg(MSG_ERROR, "Unsupported file ...\n");
+		return PS2HL_ERR_PARAM;
 	}
-	
-	return 1;
+
+	LibMsg(MSG_INFO, "Processing file: %s \n", FileName);
+	if (CheckTXT(FileName) == true)		// Compressed PS2 TXT
+		return DecompressTxt(FileName);
+	else								// Normal TXT
+		return CompressTxt(FileName);
 }
+
+const char * JobVersion()
+{
+	return PROG_TITLE;
+}
+
+bool SniffFile(const char * FileName)
+{
+	char cExtension[5];
+
+	// Any *.txt goes here (use "epc" explicitly for precache lists)
+	FileGetExtension(FileName, cExtension, sizeof(cExtension));
+	return !strcmp(cExtension, ".txt");
+}
+
+} // namespace txt